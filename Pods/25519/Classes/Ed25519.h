@@ -34,4 +34,46 @@
 
 +(BOOL)verifySignature:(NSData*)signature publicKey:(NSData*)pubKey data:(NSData*)data;
 
+/**
+ *  Verifies many ed25519 signatures at once, each with its own Curve25519 public key and data, with randomized
+ *  batch verification. About twice as fast as verifying them one by one; when the batch fails, the signatures
+ *  are checked individually to find the bad ones. Throws NSInvalidArgumentException like the method above, or
+ *  if the arrays' counts differ.
+ *
+ *  The batch check is cofactored, so unlike the method above it ignores small-order components of R and the
+ *  key. A signature that's only wrong by one, which only the key's owner can make, may be reported valid.
+ *
+ *  @param signatures ed25519 64-byte signatures.
+ *  @param pubKeys    public keys of the signers.
+ *  @param data       data to be checked against each signature.
+ *
+ *  @return The indexes of the signatures which aren't valid; empty if every one is.
+ */
+
++(NSIndexSet*)indexesOfInvalidSignatures:(NSArray<NSData*>*)signatures
+                              publicKeys:(NSArray<NSData*>*)pubKeys
+                                    data:(NSArray<NSData*>*)data;
+
+@end
+
+/**
+ *  Verifies the ed25519 signatures of one Curve25519 public key. The key's Edwards point is computed once,
+ *  rather than for every signature. +[Ed25519 verifySignature:publicKey:data:] keeps verifiers of recently
+ *  used keys, so repeated checks against the same identity key share one.
+ */
+
+@interface Ed25519Verifier : NSObject
+
+/**
+ *  @param pubKey 32-byte Curve25519 public key. Throws an NSInvalidArgumentException otherwise.
+ */
+
+-(instancetype)initWithPublicKey:(NSData*)pubKey;
+
+/**
+ *  Same as +[Ed25519 verifySignature:publicKey:data:] with the verifier's key, including the exceptions.
+ */
+
+-(BOOL)verifySignature:(NSData*)signature data:(NSData*)data;
+
 @end
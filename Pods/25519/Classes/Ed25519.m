@@ -8,14 +8,55 @@
 
 #import "Ed25519.h"
 #import "Curve25519.h"
+#import "Randomness.h"
+#import "curve_sigs.h"
+
+// Verifiers of recently used public keys, like the identity keys of a group's members.
+#define kVerifierCacheCountLimit 256
 
 @interface ECKeyPair ()
 -(NSData*) sign:(NSData*)data;
 @end
 
-extern int curve25519_verify(const unsigned char* signature, /* 64 bytes */
-                      const unsigned char* curve25519_pubkey, /* 32 bytes */
-                      const unsigned char* msg, const unsigned long msg_len);
+@interface Ed25519Verifier ()
+-(const curve25519_verifier*) verifier;
+@end
+
+@implementation Ed25519Verifier {
+    curve25519_verifier verifier;
+}
+
+-(const curve25519_verifier*) verifier{
+    return &self->verifier;
+}
+
+-(instancetype)initWithPublicKey:(NSData*)pubKey{
+    if ([pubKey length] != ECCKeyLength) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"Public Key isn't 32 bytes" userInfo:nil];
+    }
+
+    self = [super init];
+    if (self) {
+        // A key which isn't on the curve leaves the verifier rejecting every signature.
+        curve25519_verifier_init(&self->verifier, [pubKey bytes]);
+    }
+    return self;
+}
+
+-(BOOL)verifySignature:(NSData*)signature data:(NSData*)data{
+    
+    if ([data length] < 1) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"Data needs to be at least one byte" userInfo:nil];
+    }
+    
+    if ([signature length] != ECCSignatureLength) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"Signature isn't 64 bytes" userInfo:nil];
+    }
+    
+    return (curve25519_verifier_verify(&self->verifier, [signature bytes], [data bytes], [data length]) == 0);
+}
+
+@end
 
 @implementation Ed25519
 
@@ -42,9 +83,82 @@ extern int curve25519_verify(const unsigned char* signature, /* 64 bytes */
         @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"Signature isn't 64 bytes" userInfo:nil];
     }
     
-    BOOL success = (curve25519_verify([signature bytes], [pubKey bytes], [data bytes], [data length]) == 0);
+    return [[self verifierForPublicKey:pubKey] verifySignature:signature data:data];
+}
+
++(NSIndexSet*)indexesOfInvalidSignatures:(NSArray<NSData*>*)signatures
+                              publicKeys:(NSArray<NSData*>*)pubKeys
+                                    data:(NSArray<NSData*>*)data{
+    
+    NSUInteger count = [signatures count];
+    if ([pubKeys count] != count || [data count] != count) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"Counts of signatures, keys and data differ" userInfo:nil];
+    }
+    
+    if (count == 0) {
+        return [NSIndexSet indexSet];
+    }
+    
+    NSMutableArray<Ed25519Verifier*> *verifiers = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        if ([data[i] length] < 1) {
+            @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"Data needs to be at least one byte" userInfo:nil];
+        }
+        
+        if ([pubKeys[i] length] != ECCKeyLength) {
+            @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"Public Key isn't 32 bytes" userInfo:nil];
+        }
+        
+        if ([signatures[i] length] != ECCSignatureLength) {
+            @throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"Signature isn't 64 bytes" userInfo:nil];
+        }
+        
+        [verifiers addObject:[self verifierForPublicKey:pubKeys[i]]];
+    }
+    
+    NSMutableData *buffers = [NSMutableData dataWithLength:count * (sizeof(curve25519_verifier*) + 2 * sizeof(unsigned char*)
+                                                                    + sizeof(unsigned long) + sizeof(int))];
+    const curve25519_verifier **verifierPtrs = [buffers mutableBytes];
+    const unsigned char **signaturePtrs      = (const unsigned char **)(verifierPtrs + count);
+    const unsigned char **dataPtrs           = signaturePtrs + count;
+    unsigned long *dataLengths               = (unsigned long *)(dataPtrs + count);
+    int *valid                               = (int *)(dataLengths + count);
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        verifierPtrs[i]  = [verifiers[i] verifier];
+        signaturePtrs[i] = [signatures[i] bytes];
+        dataPtrs[i]      = [data[i] bytes];
+        dataLengths[i]   = [data[i] length];
+    }
+    
+    NSData *randomBytes = [Randomness generateRandomBytes:(int)(16 * count)];
     
-    return success;
+    NSMutableIndexSet *invalidIndexes = [NSMutableIndexSet indexSet];
+    if (curve25519_verifier_verify_batch(verifierPtrs, signaturePtrs, dataPtrs, dataLengths, count, [randomBytes bytes], valid) != 0) {
+        for (NSUInteger i = 0; i < count; i++) {
+            if (!valid[i]) {
+                [invalidIndexes addIndex:i];
+            }
+        }
+    }
+    
+    return invalidIndexes;
+}
+
++(Ed25519Verifier*)verifierForPublicKey:(NSData*)pubKey{
+    static NSCache<NSData *, Ed25519Verifier *> *verifiers;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        verifiers = [NSCache new];
+        verifiers.countLimit = kVerifierCacheCountLimit;
+    });
+
+    Ed25519Verifier *verifier = [verifiers objectForKey:pubKey];
+    if (!verifier) {
+        verifier = [[Ed25519Verifier alloc] initWithPublicKey:pubKey];
+        [verifiers setObject:verifier forKey:[pubKey copy]];
+    }
+    return verifier;
 }
 
 @end
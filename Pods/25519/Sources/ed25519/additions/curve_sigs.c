@@ -1,8 +1,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include "ge.h"
+#include "sc.h"
 #include "curve_sigs.h"
 #include "crypto_sign.h"
+#include "crypto_hash_sha512.h"
+#include "crypto_verify_32.h"
 
 void curve25519_keygen(unsigned char* curve25519_pubkey_out,
                        const unsigned char* curve25519_privkey_in)
@@ -67,28 +70,12 @@ int curve25519_sign(unsigned char* signature_out,
    return 0;
 }
 
-int curve25519_verify(const unsigned char* signature,
-                      const unsigned char* curve25519_pubkey,
-                      const unsigned char* msg, const unsigned long msg_len)
+int curve25519_verifier_init(curve25519_verifier* verifier_out,
+                             const unsigned char* curve25519_pubkey)
 {
   fe mont_x, mont_x_minus_one, mont_x_plus_one, inv_mont_x_plus_one;
   fe one;
   fe ed_y;
-  unsigned char ed_pubkey[32];
-  unsigned long long some_retval;
-  unsigned char *verifybuf = NULL; /* working buffer */
-  unsigned char *verifybuf2 = NULL; /* working buffer #2 */
-  int result;
-
-  if ((verifybuf = malloc(msg_len + 64)) == 0) {
-    result = -1;
-    goto err;
-  }
-
-  if ((verifybuf2 = malloc(msg_len + 64)) == 0) {
-    result = -1;
-    goto err;
-  }
 
   /* Convert the Curve25519 public key into an Ed25519 public key.  In
      particular, convert Curve25519's "montgomery" x-coordinate into an
@@ -98,7 +85,7 @@ int curve25519_verify(const unsigned char* signature,
 
      NOTE: mont_x=-1 is converted to ed_y=0 since fe_invert is mod-exp
 
-     Then move the sign bit into the pubkey from the signature.
+     The sign bit comes from each signature.
   */
   fe_frombytes(mont_x, curve25519_pubkey);
   fe_1(one);
@@ -106,32 +93,397 @@ int curve25519_verify(const unsigned char* signature,
   fe_add(mont_x_plus_one, mont_x, one);
   fe_invert(inv_mont_x_plus_one, mont_x_plus_one);
   fe_mul(ed_y, mont_x_minus_one, inv_mont_x_plus_one);
-  fe_tobytes(ed_pubkey, ed_y);
+  fe_tobytes(verifier_out->ed_pubkey, ed_y);
+  verifier_out->ed_pubkey[31] &= 0x7F;
+
+  /* Decompress once.  Flipping the sign bit only negates x, and so X and T. */
+  if (ge_frombytes_negate_vartime(&verifier_out->negated_ed_point[0], verifier_out->ed_pubkey) != 0) {
+    memset(verifier_out, 0, sizeof(*verifier_out));
+    return -1;
+  }
+  verifier_out->negated_ed_point[1] = verifier_out->negated_ed_point[0];
+  fe_neg(verifier_out->negated_ed_point[1].X, verifier_out->negated_ed_point[1].X);
+  fe_neg(verifier_out->negated_ed_point[1].T, verifier_out->negated_ed_point[1].T);
+
+  verifier_out->valid = 1;
+  return 0;
+}
+
+/* Messages up to this length are hashed from a stack buffer */
+#define VERIFY_STACK_MSG_LEN 256
+
+int curve25519_verifier_verify(const curve25519_verifier* verifier,
+                               const unsigned char* signature,
+                               const unsigned char* msg, const unsigned long msg_len)
+{
+  unsigned char stackbuf[64 + VERIFY_STACK_MSG_LEN];
+  unsigned char *hashbuf = stackbuf; /* R || ed_pubkey || msg */
+  unsigned char scopy[32];
+  unsigned char h[64];
+  unsigned char rcheck[32];
+  unsigned char sign_bit = signature[63] >> 7;
+  ge_p2 R;
+
+  if (!verifier->valid) {
+    return -1;
+  }
+
+  /* Remove the sign bit from S, which must then be fully reduced */
+  memmove(scopy, signature + 32, 32);
+  scopy[31] &= 0x7F;
+  if (scopy[31] & 224) {
+    return -1;
+  }
+
+  if (msg_len > VERIFY_STACK_MSG_LEN && (hashbuf = malloc(msg_len + 64)) == 0) {
+    return -1;
+  }
+
+  /* Then perform a normal Ed25519 verification, as crypto_sign_open does */
+  memmove(hashbuf, signature, 32);
+  memmove(hashbuf + 32, verifier->ed_pubkey, 32);
+  hashbuf[63] |= sign_bit << 7;
+  memmove(hashbuf + 64, msg, msg_len);
+  crypto_hash_sha512(h, hashbuf, 64 + msg_len);
+  sc_reduce(h);
+
+  if (hashbuf != stackbuf) {
+    free(hashbuf);
+  }
+
+  ge_double_scalarmult_vartime(&R, h, &verifier->negated_ed_point[sign_bit], scopy);
+  ge_tobytes(rcheck, &R);
+
+  return crypto_verify_32(rcheck, signature) == 0 ? 0 : -1;
+}
+
+int curve25519_verify(const unsigned char* signature,
+                      const unsigned char* curve25519_pubkey,
+                      const unsigned char* msg, const unsigned long msg_len)
+{
+  curve25519_verifier verifier;
+
+  curve25519_verifier_init(&verifier, curve25519_pubkey);
+  return curve25519_verifier_verify(&verifier, signature, msg, msg_len);
+}
+
+/* Batch verification */
+
+/* Signatures verified with one multi-scalar multiplication.  Beyond this,
+   the shared doublings barely matter and the working memory keeps growing. */
+#define VERIFY_BATCH_MAX 64
+
+/* A point, and the scalar it's multiplied by, in a multi-scalar multiplication */
+typedef struct {
+  signed char slide[256];
+  ge_cached multiples[8]; /* P,3P,5P,7P,9P,11P,13P,15P */
+} batch_term;
+
+static const ge_precomp batch_Bi[8] = {
+#include "base2.h"
+} ;
+
+/* Same as slide() in ge_double_scalarmult.c */
+static void batch_slide(signed char *r, const unsigned char *a)
+{
+  int i;
+  int b;
+  int k;
+
+  for (i = 0;i < 256;++i)
+    r[i] = 1 & (a[i >> 3] >> (i & 7));
+
+  for (i = 0;i < 256;++i)
+    if (r[i]) {
+      for (b = 1;b <= 6 && i + b < 256;++b) {
+        if (r[i + b]) {
+          if (r[i] + (r[i + b] << b) <= 15) {
+            r[i] += r[i + b] << b; r[i + b] = 0;
+          } else if (r[i] - (r[i + b] << b) >= -15) {
+            r[i] -= r[i + b] << b;
+            for (k = i + b;k < 256;++k) {
+              if (!r[k]) {
+                r[k] = 1;
+                break;
+              }
+              r[k] = 0;
+            }
+          } else
+            break;
+        }
+      }
+    }
+}
+
+static void batch_term_init(batch_term *term, const unsigned char *scalar, const ge_p3 *point)
+{
+  ge_p1p1 t;
+  ge_p3 u;
+  ge_p3 point2;
+  int i;
+
+  batch_slide(term->slide, scalar);
+
+  ge_p3_to_cached(&term->multiples[0], point);
+  ge_p3_dbl(&t, point); ge_p1p1_to_p3(&point2, &t);
+  for (i = 0; i < 7; i++) {
+    ge_add(&t, &point2, &term->multiples[i]); ge_p1p1_to_p3(&u, &t); ge_p3_to_cached(&term->multiples[i + 1], &u);
+  }
+}
+
+/*
+r = b * B + sum of each term's scalar times its point, with Straus'
+interleaved sliding windows; ge_double_scalarmult_vartime for many points
+*/
+static void batch_multi_scalarmult_vartime(ge_p2 *r, const unsigned char *b,
+                                           const batch_term *terms, unsigned long count)
+{
+  signed char bslide[256];
+  ge_p1p1 t;
+  ge_p3 u;
+  unsigned long j;
+  int i;
+
+  batch_slide(bslide, b);
 
-  /* Copy the sign bit, and remove it from signature */
-  ed_pubkey[31] &= 0x7F;  /* bit should be zero already, but just in case */
-  ed_pubkey[31] |= (signature[63] & 0x80);
-  memmove(verifybuf, signature, 64);
-  verifybuf[63] &= 0x7F;
+  ge_p2_0(r);
 
-  memmove(verifybuf+64, msg, msg_len);
+  for (i = 255; i >= 0; --i) {
+    if (bslide[i]) break;
+    for (j = 0; j < count && !terms[j].slide[i]; j++) ;
+    if (j < count) break;
+  }
+
+  for (;i >= 0;--i) {
+    ge_p2_dbl(&t,r);
+
+    for (j = 0; j < count; j++) {
+      signed char s = terms[j].slide[i];
+      if (s > 0) {
+        ge_p1p1_to_p3(&u,&t);
+        ge_add(&t,&u,&terms[j].multiples[s/2]);
+      } else if (s < 0) {
+        ge_p1p1_to_p3(&u,&t);
+        ge_sub(&t,&u,&terms[j].multiples[(-s)/2]);
+      }
+    }
+
+    if (bslide[i] > 0) {
+      ge_p1p1_to_p3(&u,&t);
+      ge_madd(&t,&u,&batch_Bi[bslide[i]/2]);
+    } else if (bslide[i] < 0) {
+      ge_p1p1_to_p3(&u,&t);
+      ge_msub(&t,&u,&batch_Bi[(-bslide[i])/2]);
+    }
+
+    ge_p1p1_to_p2(r,&t);
+  }
+}
+
+/* Whether R is the encoding verification would produce for its point: y
+   fully reduced, and no sign bit for x=0.  The batch equation works on the
+   decoded point, where crypto_sign_open compares encodings, so anything
+   else must fail the batch too. */
+static int batch_is_canonical(const unsigned char *r)
+{
+  int i;
+  unsigned char y_is_one = r[0] == 1;
+  unsigned char y_is_minus_one = r[0] == 0xec;
+  unsigned char y_is_at_least_p = r[0] >= 0xed && (r[31] & 0x7F) == 0x7F;
+
+  for (i = 1; i < 31; i++) {
+    y_is_one &= r[i] == 0;
+    y_is_minus_one &= r[i] == 0xff;
+    y_is_at_least_p &= r[i] == 0xff;
+  }
+  y_is_one &= (r[31] & 0x7F) == 0;
+  y_is_minus_one &= (r[31] & 0x7F) == 0x7F;
+
+  if (y_is_at_least_p) {
+    return 0;
+  }
+  if ((r[31] & 0x80) && (y_is_one || y_is_minus_one)) {
+    return 0;
+  }
+  return 1;
+}
+
+/* returns 0 if the batch equation holds; terms has room for 2 * count.
+
+   The equation is multiplied by the cofactor 8.  Otherwise a small-order
+   component in some R or key would be cancelled by some z_i and not by
+   others, and the outcome would be random.  This way it's ignored: a
+   signature that's only wrong by a small-order component, which only its
+   signer can produce, always passes a batch, where curve25519_verify
+   rejects it. */
+static int batch_verify(const curve25519_verifier* const* verifiers,
+                        const unsigned char* const* signatures,
+                        const unsigned char* const* msgs, const unsigned long* msg_lens,
+                        const unsigned long count, const unsigned char* random,
+                        batch_term *terms)
+{
+  static const unsigned char zero[32] = {0};
+  static const unsigned char identity[32] = {1};
+  unsigned char stackbuf[64 + VERIFY_STACK_MSG_LEN];
+  unsigned char *hashbuf;
+  unsigned char base_scalar[32] = {0}; /* sum of z_i * S_i */
+  unsigned char z[32] = {0};
+  unsigned char s[32];
+  unsigned char h[64];
+  unsigned char result[32];
+  unsigned char sign_bit;
+  ge_p3 negated_r;
+  ge_p1p1 t;
+  ge_p2 sum;
+  unsigned long i;
+
+  for (i = 0; i < count; i++) {
+    const unsigned char *signature = signatures[i];
+    const curve25519_verifier *verifier = verifiers[i];
+
+    if (!verifier->valid) {
+      return -1;
+    }
+
+    memmove(s, signature + 32, 32);
+    s[31] &= 0x7F;
+    if (s[31] & 224) {
+      return -1;
+    }
+
+    if (!batch_is_canonical(signature) || ge_frombytes_negate_vartime(&negated_r, signature) != 0) {
+      return -1;
+    }
+
+    hashbuf = stackbuf;
+    if (msg_lens[i] > VERIFY_STACK_MSG_LEN && (hashbuf = malloc(msg_lens[i] + 64)) == 0) {
+      return -1;
+    }
+    sign_bit = signature[63] >> 7;
+    memmove(hashbuf, signature, 32);
+    memmove(hashbuf + 32, verifier->ed_pubkey, 32);
+    hashbuf[63] |= sign_bit << 7;
+    memmove(hashbuf + 64, msgs[i], msg_lens[i]);
+    crypto_hash_sha512(h, hashbuf, 64 + msg_lens[i]);
+    sc_reduce(h);
+    if (hashbuf != stackbuf) {
+      free(hashbuf);
+    }
+
+    memmove(z, random + 16 * i, 16);
+
+    /* base_scalar += z_i * S_i */
+    sc_muladd(base_scalar, z, s, base_scalar);
+
+    /* z_i * -R_i */
+    batch_term_init(&terms[2 * i], z, &negated_r);
+
+    /* (z_i * H_i) * -A_i */
+    sc_muladd(h, z, h, zero);
+    batch_term_init(&terms[2 * i + 1], h, &verifier->negated_ed_point[sign_bit]);
+  }
+
+  batch_multi_scalarmult_vartime(&sum, base_scalar, terms, 2 * count);
+
+  /* Times the cofactor */
+  for (i = 0; i < 3; i++) {
+    ge_p2_dbl(&t, &sum);
+    ge_p1p1_to_p2(&sum, &t);
+  }
+  ge_tobytes(result, &sum);
+
+  return crypto_verify_32(result, identity) == 0 ? 0 : -1;
+}
+
+int curve25519_verifier_verify_batch(const curve25519_verifier* const* verifiers,
+                                     const unsigned char* const* signatures,
+                                     const unsigned char* const* msgs, const unsigned long* msg_lens,
+                                     const unsigned long count,
+                                     const unsigned char* random,
+                                     int* valid_out)
+{
+  batch_term *terms = NULL;
+  unsigned long offset;
+  unsigned long batch_count;
+  unsigned long i;
+  int result = 0;
+
+  if (count > 1) {
+    terms = malloc(2 * (count < VERIFY_BATCH_MAX ? count : VERIFY_BATCH_MAX) * sizeof(batch_term));
+  }
+
+  for (offset = 0; offset < count; offset += batch_count) {
+    batch_count = count - offset < VERIFY_BATCH_MAX ? count - offset : VERIFY_BATCH_MAX;
+
+    if (terms != NULL && batch_count > 1 &&
+        batch_verify(verifiers + offset, signatures + offset, msgs + offset, msg_lens + offset,
+                     batch_count, random + 16 * offset, terms) == 0) {
+      for (i = offset; i < offset + batch_count; i++) {
+        valid_out[i] = 1;
+      }
+      continue;
+    }
+
+    /* Find the bad signatures, or verify without the memory for a batch */
+    for (i = offset; i < offset + batch_count; i++) {
+      valid_out[i] = curve25519_verifier_verify(verifiers[i], signatures[i], msgs[i], msg_lens[i]) == 0;
+      if (!valid_out[i]) {
+        result = -1;
+      }
+    }
+  }
+
+  if (terms != NULL) {
+    free(terms);
+  }
+
+  return result;
+}
+
+int curve25519_verify_batch(const unsigned char* const* signatures,
+                            const unsigned char* const* curve25519_pubkeys,
+                            const unsigned char* const* msgs, const unsigned long* msg_lens,
+                            const unsigned long count,
+                            const unsigned char* random,
+                            int* valid_out)
+{
+  curve25519_verifier *verifiers = NULL;
+  const curve25519_verifier **verifier_ptrs = NULL;
+  unsigned long i;
+  int result = -1;
+
+  if (count == 0) {
+    return 0;
+  }
+
+  if ((verifiers = malloc(count * sizeof(curve25519_verifier))) == 0 ||
+      (verifier_ptrs = malloc(count * sizeof(curve25519_verifier *))) == 0) {
+    /* Verify each signature on its own instead */
+    result = 0;
+    for (i = 0; i < count; i++) {
+      valid_out[i] = curve25519_verify(signatures[i], curve25519_pubkeys[i], msgs[i], msg_lens[i]) == 0;
+      if (!valid_out[i]) {
+        result = -1;
+      }
+    }
+    goto err;
+  }
+
+  for (i = 0; i < count; i++) {
+    curve25519_verifier_init(&verifiers[i], curve25519_pubkeys[i]);
+    verifier_ptrs[i] = &verifiers[i];
+  }
 
-  /* Then perform a normal Ed25519 verification, return 0 on success */
-  /* The below call has a strange API: */
-  /* verifybuf = R || S || message */
-  /* verifybuf2 = internal to next call gets a copy of verifybuf, S gets 
-     replaced with pubkey for hashing, then the whole thing gets zeroized
-     (if bad sig), or contains a copy of msg (good sig) */
-  result = crypto_sign_open(verifybuf2, &some_retval, verifybuf, 64 + msg_len, ed_pubkey);
+  result = curve25519_verifier_verify_batch(verifier_ptrs, signatures, msgs, msg_lens, count, random, valid_out);
 
   err:
 
-  if (verifybuf != NULL) {
-    free(verifybuf);
+  if (verifiers != NULL) {
+    free(verifiers);
   }
 
-  if (verifybuf2 != NULL) {
-    free(verifybuf2);
+  if (verifier_ptrs != NULL) {
+    free((void *)verifier_ptrs);
   }
 
   return result;
@@ -2,6 +2,8 @@
 #ifndef __CURVE_SIGS_H__
 #define __CURVE_SIGS_H__
 
+#include "ge.h"
+
 void curve25519_keygen(unsigned char* curve25519_pubkey_out, /* 32 bytes */
                        const unsigned char* curve25519_privkey_in); /* 32 bytes */
 
@@ -16,6 +18,61 @@ int curve25519_verify(const unsigned char* signature, /* 64 bytes */
                       const unsigned char* curve25519_pubkey, /* 32 bytes */
                       const unsigned char* msg, const unsigned long msg_len);
 
+/* A Curve25519 public key prepared for verifying its signatures: its Ed25519
+   encoding, and the negated Edwards point that verification starts from, for
+   either sign bit.  Converting and decompressing the key costs two field
+   exponentiations, which curve25519_verify pays on every call. */
+typedef struct {
+  unsigned char ed_pubkey[32]; /* sign bit clear */
+  ge_p3 negated_ed_point[2];   /* indexed by the sign bit */
+  int valid;
+} curve25519_verifier;
+
+/* returns 0 on success, -1 if the key isn't on the curve; the verifier then
+   rejects every signature */
+int curve25519_verifier_init(curve25519_verifier* verifier_out,
+                             const unsigned char* curve25519_pubkey); /* 32 bytes */
+
+/* returns 0 on success, same as curve25519_verify with the verifier's key */
+int curve25519_verifier_verify(const curve25519_verifier* verifier,
+                               const unsigned char* signature, /* 64 bytes */
+                               const unsigned char* msg, const unsigned long msg_len);
+
+/* Verifies count signatures at once, each with its own key and message.
+
+   Randomized batch verification: with random 128-bit z_i, checks that
+
+   8 * ((sum z_i*S_i)B - sum z_i*R_i - sum (z_i*H(R_i || A_i || M_i))A_i) = 0
+
+   with one multi-scalar multiplication, whose doublings are shared by every
+   signature.  When that fails, each signature is verified on its own to find
+   the bad ones.
+
+   Unlike curve25519_verify, the equation is cofactored, so it ignores
+   small-order components in R and the key.  A signature that's only wrong by
+   such a component, which only the key's owner can make, is valid in a batch
+   that holds, and invalid in one that doesn't or on its own.  Every other
+   outcome is the same as curve25519_verify's.
+
+   random      : 16 * count random bytes for the z_i
+   valid_out   : for each signature, 1 if valid and 0 otherwise
+
+   returns 0 if every signature is valid */
+int curve25519_verify_batch(const unsigned char* const* signatures, /* 64 bytes each */
+                            const unsigned char* const* curve25519_pubkeys, /* 32 bytes each */
+                            const unsigned char* const* msgs, const unsigned long* msg_lens,
+                            const unsigned long count,
+                            const unsigned char* random, /* 16 * count bytes */
+                            int* valid_out);
+
+/* Same as curve25519_verify_batch, with the keys already prepared */
+int curve25519_verifier_verify_batch(const curve25519_verifier* const* verifiers,
+                                     const unsigned char* const* signatures, /* 64 bytes each */
+                                     const unsigned char* const* msgs, const unsigned long* msg_lens,
+                                     const unsigned long count,
+                                     const unsigned char* random, /* 16 * count bytes */
+                                     int* valid_out);
+
 /* helper function - modified version of crypto_sign() to use 
    explicit private key.  In particular:
 
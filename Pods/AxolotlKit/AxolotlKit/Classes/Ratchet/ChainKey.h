@@ -10,9 +10,32 @@
 #import "MessageKeys.h"
 #import <Foundation/Foundation.h>
 
+#define kChainKeyLength 32
+
+/**
+ *  A chain key by value, so the chain can be stepped on the stack.
+ */
+typedef struct {
+    uint8_t key[kChainKeyLength];
+    int     index;
+} ChainKeyMaterial;
+
+/**
+ *  Steps the chain. next may be the same struct as chainKey.
+ */
+void ChainKeyMaterialNext(const ChainKeyMaterial *chainKey, ChainKeyMaterial *next);
+
+/**
+ *  Derives the keys of the message at chainKey's index.
+ */
+void ChainKeyMaterialMessageKeys(const ChainKeyMaterial *chainKey, MessageKeysMaterial *messageKeys);
+
 @interface ChainKey : NSObject <NSSecureCoding>
 
 -(instancetype)initWithData:(NSData*)chainKey index:(int)index;
+-(instancetype)initWithMaterial:(const ChainKeyMaterial *)material;
+
+-(void)getMaterial:(ChainKeyMaterial *)material;
 
 -(instancetype)nextChainKey;
 
@@ -3,20 +3,59 @@
 //
 
 #import "ChainKey.h"
-#import "TSDerivedSecrets.h"
 #import <25519/Curve25519.h>
 #import <CommonCrypto/CommonCrypto.h>
-
-@implementation ChainKey
-
-static NSString* const kCoderKey     = @"kCoderKey";
-static NSString* const kCoderIndex   = @"kCoderIndex";
+#import <HKDFKit/HKDFKit.h>
 
 #define kTSKeySeedLength 1
 
 static uint8_t kMessageKeySeed[kTSKeySeedLength]    = {01};
 static uint8_t kChainKeySeed[kTSKeySeedLength]      = {02};
 
+// See TSDerivedSecrets derivedMessageKeysWithData:.
+static const char kMessageKeysInfo[] = "WhisperMessageKeys";
+static const uint8_t kMessageKeysSalt[32] = {0};
+
+static void ChainKeyMaterialBaseMaterial(const ChainKeyMaterial *chainKey,
+                                         const uint8_t *seed,
+                                         uint8_t result[CC_SHA256_DIGEST_LENGTH]){
+    CCHmac(kCCHmacAlgSHA256, chainKey->key, sizeof(chainKey->key), seed, kTSKeySeedLength, result);
+}
+
+void ChainKeyMaterialNext(const ChainKeyMaterial *chainKey, ChainKeyMaterial *next){
+    uint8_t nextKey[CC_SHA256_DIGEST_LENGTH];
+    ChainKeyMaterialBaseMaterial(chainKey, kChainKeySeed, nextKey);
+
+    memcpy(next->key, nextKey, sizeof(next->key));
+    next->index = chainKey->index + 1;
+    memset_s(nextKey, sizeof(nextKey), 0, sizeof(nextKey));
+}
+
+void ChainKeyMaterialMessageKeys(const ChainKeyMaterial *chainKey, MessageKeysMaterial *messageKeys){
+    uint8_t inputKeyMaterial[CC_SHA256_DIGEST_LENGTH];
+    ChainKeyMaterialBaseMaterial(chainKey, kMessageKeySeed, inputKeyMaterial);
+
+    // cipherKey, macKey and iv are laid out back to back, in the order HKDF derives them.
+    uint8_t derivedMaterial[kMessageKeysCipherKeyLength + kMessageKeysMacKeyLength + kMessageKeysIVLength];
+    HKDFKitDeriveKey(inputKeyMaterial, sizeof(inputKeyMaterial),
+                     kMessageKeysInfo, sizeof(kMessageKeysInfo) - 1,
+                     kMessageKeysSalt, sizeof(kMessageKeysSalt),
+                     derivedMaterial, sizeof(derivedMaterial));
+
+    memcpy(messageKeys->cipherKey, derivedMaterial, kMessageKeysCipherKeyLength);
+    memcpy(messageKeys->macKey, derivedMaterial + kMessageKeysCipherKeyLength, kMessageKeysMacKeyLength);
+    memcpy(messageKeys->iv, derivedMaterial + kMessageKeysCipherKeyLength + kMessageKeysMacKeyLength, kMessageKeysIVLength);
+    messageKeys->index = chainKey->index;
+
+    memset_s(inputKeyMaterial, sizeof(inputKeyMaterial), 0, sizeof(inputKeyMaterial));
+    memset_s(derivedMaterial, sizeof(derivedMaterial), 0, sizeof(derivedMaterial));
+}
+
+@implementation ChainKey
+
+static NSString* const kCoderKey     = @"kCoderKey";
+static NSString* const kCoderIndex   = @"kCoderIndex";
+
 + (BOOL)supportsSecureCoding{
     return YES;
 }
@@ -50,16 +89,39 @@ static uint8_t kChainKeySeed[kTSKeySeedLength]      = {02};
     return self;
 }
 
+-(instancetype)initWithMaterial:(const ChainKeyMaterial *)material{
+    return [self initWithData:[NSData dataWithBytes:material->key length:sizeof(material->key)] index:material->index];
+}
+
+-(void)getMaterial:(ChainKeyMaterial *)material{
+    SPKAssert(self.key.length == sizeof(material->key));
+
+    memset(material->key, 0, sizeof(material->key));
+    [self.key getBytes:material->key length:sizeof(material->key)];
+    material->index = self.index;
+}
+
 - (instancetype) nextChainKey{
-    NSData* nextCK = [self baseMaterial:[NSData dataWithBytes:kChainKeySeed length:kTSKeySeedLength]];
-    
-    return [[ChainKey alloc] initWithData:nextCK index:self.index+1];
+    ChainKeyMaterial material;
+    [self getMaterial:&material];
+    ChainKeyMaterialNext(&material, &material);
+
+    ChainKey *nextChainKey = [[ChainKey alloc] initWithMaterial:&material];
+    memset_s(&material, sizeof(material), 0, sizeof(material));
+    return nextChainKey;
 }
 
 - (MessageKeys*)messageKeys{
-    NSData *inputKeyMaterial = [self baseMaterial:[NSData dataWithBytes:kMessageKeySeed length:kTSKeySeedLength]];
-    TSDerivedSecrets *derivedSecrets = [TSDerivedSecrets derivedMessageKeysWithData:inputKeyMaterial];
-    return [[MessageKeys alloc] initWithCipherKey:derivedSecrets.cipherKey macKey:derivedSecrets.macKey iv:derivedSecrets.iv index:self.index];
+    ChainKeyMaterial material;
+    [self getMaterial:&material];
+
+    MessageKeysMaterial messageKeysMaterial;
+    ChainKeyMaterialMessageKeys(&material, &messageKeysMaterial);
+
+    MessageKeys *messageKeys = [[MessageKeys alloc] initWithMaterial:&messageKeysMaterial];
+    memset_s(&material, sizeof(material), 0, sizeof(material));
+    memset_s(&messageKeysMaterial, sizeof(messageKeysMaterial), 0, sizeof(messageKeysMaterial));
+    return messageKeys;
 }
 
 - (NSData*)baseMaterial:(NSData*)seed{
@@ -8,9 +8,24 @@
 
 #import <Foundation/Foundation.h>
 
+#define kMessageKeysCipherKeyLength 32
+#define kMessageKeysMacKeyLength    32
+#define kMessageKeysIVLength        16
+
+/**
+ *  The keys of a single message, by value, so they can be derived on the stack.
+ */
+typedef struct {
+    uint8_t cipherKey[kMessageKeysCipherKeyLength];
+    uint8_t macKey[kMessageKeysMacKeyLength];
+    uint8_t iv[kMessageKeysIVLength];
+    int     index;
+} MessageKeysMaterial;
+
 @interface MessageKeys : NSObject <NSSecureCoding>
 
 - (instancetype)initWithCipherKey:(NSData*)cipherKey macKey:(NSData*)macKey iv:(NSData*)data index:(int)index;
+- (instancetype)initWithMaterial:(const MessageKeysMaterial *)material;
 
 @property (readonly)NSData *cipherKey;
 @property (readonly)NSData *macKey;
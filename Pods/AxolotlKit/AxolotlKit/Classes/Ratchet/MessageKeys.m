@@ -14,7 +14,11 @@ static NSString* const kCoderMessageKeysIVKey     = @"kCoderMessageKeysIVKey";
 static NSString* const kCoderMessageKeysIndex     = @"kCoderMessageKeysIndex";
 
 
-@implementation MessageKeys
+// The keys are held by value, and only wrapped in NSData when they're used. Most MessageKeys are
+// derived for skipped messages and only ever stored, so that's one allocation per key instead of four.
+@implementation MessageKeys {
+    MessageKeysMaterial _material;
+}
 
 + (BOOL)supportsSecureCoding{
     return YES;
@@ -38,17 +42,48 @@ static NSString* const kCoderMessageKeysIndex     = @"kCoderMessageKeysIndex";
 
 - (instancetype)initWithCipherKey:(NSData*)cipherKey macKey:(NSData*)macKey iv:(NSData *)data index:(int)index{
     self = [super init];
-    
+
+    if (self) {
+        // Copies at most the length of each key, so malformed keys simply fail to decrypt.
+        [cipherKey getBytes:_material.cipherKey length:sizeof(_material.cipherKey)];
+        [macKey getBytes:_material.macKey length:sizeof(_material.macKey)];
+        [data getBytes:_material.iv length:sizeof(_material.iv)];
+        _material.index = index;
+    }
+
+    return self;
+}
+
+- (instancetype)initWithMaterial:(const MessageKeysMaterial *)material{
+    self = [super init];
+
     if (self) {
-        _cipherKey = cipherKey;
-        _macKey    = macKey;
-        _iv        = data;
-        _index     = index;
+        _material = *material;
     }
 
     return self;
 }
 
+- (void)dealloc{
+    memset_s(&_material, sizeof(_material), 0, sizeof(_material));
+}
+
+- (NSData *)cipherKey{
+    return [NSData dataWithBytes:_material.cipherKey length:sizeof(_material.cipherKey)];
+}
+
+- (NSData *)macKey{
+    return [NSData dataWithBytes:_material.macKey length:sizeof(_material.macKey)];
+}
+
+- (NSData *)iv{
+    return [NSData dataWithBytes:_material.iv length:sizeof(_material.iv)];
+}
+
+- (int)index{
+    return _material.index;
+}
+
 -(NSString*) debugDescription {
     return [NSString stringWithFormat:@"cipherKey: %@\n macKey %@\n",self.cipherKey,self.macKey];
 }
@@ -10,7 +10,7 @@
 #import "Chain.h"
 #import <25519/Curve25519.h>
 
-@interface ReceivingChain : NSObject <Chain, NSSecureCoding>
+@interface ReceivingChain : NSObject <Chain, NSSecureCoding, NSCopying>
 
 - (instancetype)initWithChainKey:(ChainKey*)chainKey senderRatchetKey:(NSData*)senderRatchet;
 
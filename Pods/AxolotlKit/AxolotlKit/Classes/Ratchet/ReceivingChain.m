@@ -50,4 +50,12 @@ static NSString* const kCoderMessageKeys   = @"kCoderMessageKeys";
     return self;
 }
 
+- (id)copyWithZone:(NSZone *)zone{
+    ReceivingChain *copy = [[[self class] allocWithZone:zone] initWithChainKey:self.chainKey
+                                                               senderRatchetKey:self.senderRatchetKey];
+    copy.messageKeysList = [self.messageKeysList mutableCopy];
+
+    return copy;
+}
+
 @end
@@ -11,7 +11,7 @@
 
 #import <25519/Curve25519.h>
 
-@interface SendingChain : NSObject <Chain, NSSecureCoding>
+@interface SendingChain : NSObject <Chain, NSSecureCoding, NSCopying>
 
 -(instancetype)initWithChainKey:(ChainKey*)chainKey senderRatchetKeyPair:(ECKeyPair*)keyPair;
 
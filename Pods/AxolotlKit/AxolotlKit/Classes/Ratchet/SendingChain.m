@@ -46,6 +46,10 @@ static NSString* const kCoderSenderRatchet = @"kCoderSenderRatchet";
     return self;
 }
 
+- (id)copyWithZone:(NSZone *)zone{
+    return [[[self class] allocWithZone:zone] initWithChainKey:self.chainKey senderRatchetKeyPair:self.senderRatchetKeyPair];
+}
+
 -(ChainKey *)chainKey{
     return _chainKey;
 }
@@ -13,20 +13,17 @@
 
     SPKAssert(masterKey.length == ECCKeyLength);
 
-    if (!salt) {
-        const char *HKDFDefaultSalt[4] = {0};
-        salt                           = [NSData dataWithBytes:HKDFDefaultSalt length:sizeof(HKDFDefaultSalt)];
-    }
-    
-    @try {
-        NSData *derivedMaterial = [HKDFKit deriveKey:masterKey info:info salt:salt outputSize:96];
-        secrets.cipherKey       = [derivedMaterial subdataWithRange:NSMakeRange(0, 32)];
-        secrets.macKey          = [derivedMaterial subdataWithRange:NSMakeRange(32, 32)];
-        secrets.iv              = [derivedMaterial subdataWithRange:NSMakeRange(64, 16)];
-    }
-    @catch (NSException *exception) {
-        @throw NSInvalidArgumentException;
-    }
+    static const uint8_t HKDFDefaultSalt[32] = {0};
+    const void *saltBytes = salt ? [salt bytes] : HKDFDefaultSalt;
+    size_t saltLength     = salt ? [salt length] : sizeof(HKDFDefaultSalt);
+
+    uint8_t derivedMaterial[96];
+    HKDFKitDeriveKey([masterKey bytes], [masterKey length], [info bytes], [info length], saltBytes, saltLength,
+                     derivedMaterial, sizeof(derivedMaterial));
+    secrets.cipherKey = [NSData dataWithBytes:derivedMaterial length:32];
+    secrets.macKey    = [NSData dataWithBytes:derivedMaterial + 32 length:32];
+    secrets.iv        = [NSData dataWithBytes:derivedMaterial + 64 length:16];
+    memset_s(derivedMaterial, sizeof(derivedMaterial), 0, sizeof(derivedMaterial));
 
     SPKAssert(secrets.cipherKey.length == ECCKeyLength);
     SPKAssert(secrets.macKey.length == ECCKeyLength);
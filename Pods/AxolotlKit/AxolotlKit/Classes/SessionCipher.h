@@ -20,14 +20,28 @@
 @interface SessionCipher : NSObject
 
 /**
- * To keep Session state synchronized, encryption and decryption must happen on the same (serial) dispatch queue. If no
- * queue is specified, the main queue will be used by default. We only assert that this invariant is held. Dispatching 
- * to this thread is the responsibility of the caller.
+ * Returns the serial dispatch queue on which a recipient's sessions must be used. It must always return the same queue
+ * for the same recipient; different recipients may share a queue, or not.
+ */
+typedef dispatch_queue_t (^SessionCipherDispatchQueueBlock)(NSString *recipientId);
+
+/**
+ * To keep Session state synchronized, encryption and decryption for a recipient must happen on the same (serial)
+ * dispatch queue. If no queue is specified, the main queue will be used by default. We only assert that this invariant
+ * is held. Dispatching to this thread is the responsibility of the caller.
  *
  * @param dispatchQueue    serial dispatch queue on which all encryption/decryption must be dispatched.
  */
 + (void)setSessionCipherDispatchQueue:(dispatch_queue_t)dispatchQueue;
-+ (dispatch_queue_t)getSessionCipherDispatchQueue;
+
+/**
+ * Like setSessionCipherDispatchQueue:, but with a queue per recipient, so that the sessions of different recipients can
+ * be used in parallel, while each recipient's are still used strictly in order.
+ *
+ * @param dispatchQueueBlock    returns the serial dispatch queue for a recipient.
+ */
++ (void)setSessionCipherDispatchQueueBlock:(SessionCipherDispatchQueueBlock)dispatchQueueBlock;
++ (dispatch_queue_t)getSessionCipherDispatchQueueForRecipientId:(NSString *)recipientId;
 
 - (instancetype)initWithAxolotlStore:(id<AxolotlStore>)sessionStore recipientId:(NSString*)recipientId deviceId:(int)deviceId;
 
@@ -27,7 +27,7 @@
 #define SYSTEM_VERSION_GREATER_THAN_OR_EQUAL_TO(major, minor) \
     ([[NSProcessInfo processInfo] isOperatingSystemAtLeastVersion:(NSOperatingSystemVersion){.majorVersion = major, .minorVersion = minor, .patchVersion = 0}])
 
-static dispatch_queue_t _sessionCipherDispatchQueue;
+static SessionCipherDispatchQueueBlock _sessionCipherDispatchQueueBlock;
 
 @interface SessionCipher ()
 
@@ -80,10 +80,11 @@ static dispatch_queue_t _sessionCipherDispatchQueue;
 
 #pragma mark - dispatch queue 
 
-+ (dispatch_queue_t)getSessionCipherDispatchQueue;
++ (dispatch_queue_t)getSessionCipherDispatchQueueForRecipientId:(NSString *)recipientId
 {
-    if (_sessionCipherDispatchQueue) {
-        return _sessionCipherDispatchQueue;
+    SessionCipherDispatchQueueBlock dispatchQueueBlock = _sessionCipherDispatchQueueBlock;
+    if (dispatchQueueBlock) {
+        return dispatchQueueBlock(recipientId);
     } else {
         return dispatch_get_main_queue();
     }
@@ -91,14 +92,21 @@ static dispatch_queue_t _sessionCipherDispatchQueue;
 
 + (void)setSessionCipherDispatchQueue:(dispatch_queue_t)dispatchQueue
 {
-    _sessionCipherDispatchQueue = dispatchQueue;
+    [self setSessionCipherDispatchQueueBlock:^(NSString *recipientId) {
+        return dispatchQueue;
+    }];
+}
+
++ (void)setSessionCipherDispatchQueueBlock:(SessionCipherDispatchQueueBlock)dispatchQueueBlock
+{
+    _sessionCipherDispatchQueueBlock = [dispatchQueueBlock copy];
 }
 
 - (void)assertOnSessionCipherDispatchQueue
 {
 #ifdef DEBUG
     if (SYSTEM_VERSION_GREATER_THAN_OR_EQUAL_TO(10, 0)) {
-        dispatch_assert_queue([[self class] getSessionCipherDispatchQueue]);
+        dispatch_assert_queue([[self class] getSessionCipherDispatchQueueForRecipientId:self.recipientId]);
     } // else, skip assert as it's a development convenience.
 #endif
 }
@@ -365,14 +373,32 @@ static dispatch_queue_t _sessionCipherDispatchQueue;
                                      userInfo:@{}];
     }
     
-    while (chainKey.index < counter) {
-        MessageKeys *messageKeys = [chainKey messageKeys];
-        [sessionState setMessageKeys:theirEphemeral messageKeys:messageKeys];
-        chainKey = chainKey.nextChainKey;
+    // Steps the chain on the stack; only the keys of the skipped messages, which have to be kept, are objects.
+    ChainKeyMaterial chainKeyMaterial;
+    MessageKeysMaterial messageKeysMaterial;
+    [chainKey getMaterial:&chainKeyMaterial];
+
+    if (chainKeyMaterial.index < counter) {
+        NSMutableArray<MessageKeys *> *skippedMessageKeys =
+            [NSMutableArray arrayWithCapacity:(NSUInteger)(counter - chainKeyMaterial.index)];
+        while (chainKeyMaterial.index < counter) {
+            ChainKeyMaterialMessageKeys(&chainKeyMaterial, &messageKeysMaterial);
+            [skippedMessageKeys addObject:[[MessageKeys alloc] initWithMaterial:&messageKeysMaterial]];
+            ChainKeyMaterialNext(&chainKeyMaterial, &chainKeyMaterial);
+        }
+        [sessionState setMessageKeys:theirEphemeral messageKeysList:skippedMessageKeys];
     }
-    
-    [sessionState setReceiverChainKey:theirEphemeral chainKey:[chainKey nextChainKey]];
-    return [chainKey messageKeys];
+
+    ChainKeyMaterialMessageKeys(&chainKeyMaterial, &messageKeysMaterial);
+    MessageKeys *messageKeys = [[MessageKeys alloc] initWithMaterial:&messageKeysMaterial];
+
+    ChainKeyMaterialNext(&chainKeyMaterial, &chainKeyMaterial);
+    [sessionState setReceiverChainKey:theirEphemeral chainKey:[[ChainKey alloc] initWithMaterial:&chainKeyMaterial]];
+
+    memset_s(&chainKeyMaterial, sizeof(chainKeyMaterial), 0, sizeof(chainKeyMaterial));
+    memset_s(&messageKeysMaterial, sizeof(messageKeysMaterial), 0, sizeof(messageKeysMaterial));
+
+    return messageKeys;
 }
 
 /**
@@ -28,6 +28,10 @@ extern const int kPreKeyOfLastResortId;
                             deviceId:(int)deviceId;
 
 - (void)processPrekeyBundle:(PreKeyBundle *)preKeyBundle;
+
+// Same as processPrekeyBundle:, for a bundle whose signed prekey signature the caller has already verified, e.g.
+// together with other bundles' by +[Ed25519 indexesOfInvalidSignatures:publicKeys:data:].
+- (void)processVerifiedPrekeyBundle:(PreKeyBundle *)preKeyBundle;
 - (int)processPrekeyWhisperMessage:(PreKeyWhisperMessage *)message
                        withSession:(SessionRecord *)sessionRecord;
 
@@ -70,6 +70,14 @@ const int kPreKeyOfLastResortId = 0xFFFFFF;
 }
 
 - (void)processPrekeyBundle:(PreKeyBundle*)preKeyBundle{
+    [self processPrekeyBundle:preKeyBundle verifySignature:YES];
+}
+
+- (void)processVerifiedPrekeyBundle:(PreKeyBundle*)preKeyBundle{
+    [self processPrekeyBundle:preKeyBundle verifySignature:NO];
+}
+
+- (void)processPrekeyBundle:(PreKeyBundle*)preKeyBundle verifySignature:(BOOL)verifySignature{
     NSData *theirIdentityKey  = preKeyBundle.identityKey.removeKeyType;
     NSData *theirSignedPreKey = preKeyBundle.signedPreKeyPublic.removeKeyType;
     
@@ -77,7 +85,8 @@ const int kPreKeyOfLastResortId = 0xFFFFFF;
         @throw [NSException exceptionWithName:UntrustedIdentityKeyException reason:@"Identity key is not valid" userInfo:@{}];
     }
 
-    if (![Ed25519 verifySignature:preKeyBundle.signedPreKeySignature publicKey:theirIdentityKey data:preKeyBundle.signedPreKeyPublic]) {
+    if (verifySignature &&
+        ![Ed25519 verifySignature:preKeyBundle.signedPreKeySignature publicKey:theirIdentityKey data:preKeyBundle.signedPreKeyPublic]) {
         @throw [NSException exceptionWithName:InvalidKeyException reason:@"KeyIsNotValidlySigned" userInfo:nil];
     }
     
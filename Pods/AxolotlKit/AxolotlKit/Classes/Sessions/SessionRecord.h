@@ -5,7 +5,11 @@
 #import <Foundation/Foundation.h>
 #import "SessionState.h"
 
-@interface SessionRecord : NSObject <NSSecureCoding>
+/**
+ *  Copies are deep: mutating a copy, or any of its session states, never affects the original. Session stores can use
+ *  this to hand out records from a cache without a failed encryption or decryption corrupting the cached record.
+ */
+@interface SessionRecord : NSObject <NSSecureCoding, NSCopying>
 
 - (instancetype)init;
 - (instancetype)initWithSessionState:(SessionState*)sessionState;
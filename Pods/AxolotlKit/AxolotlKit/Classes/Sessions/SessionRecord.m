@@ -54,6 +54,18 @@
 }
 
 
+#pragma mark NSCopying
+
+- (id)copyWithZone:(NSZone *)zone{
+    SessionRecord *copy = [[[self class] allocWithZone:zone] init];
+
+    copy.fresh          = self.fresh;
+    copy.sessionState   = [self.sessionState copy];
+    copy.previousStates = [[NSMutableArray alloc] initWithArray:self.previousStates copyItems:YES];
+
+    return copy;
+}
+
 - (instancetype)initWithSessionState:(SessionState *)sessionState{
     assert(sessionState);
     self = [self init];
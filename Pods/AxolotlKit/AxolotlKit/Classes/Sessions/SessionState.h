@@ -23,7 +23,7 @@
 
 @end
 
-@interface SessionState : NSObject <NSSecureCoding>
+@interface SessionState : NSObject <NSSecureCoding, NSCopying>
 
 /**
  *  AxolotlSessions are either retreived from the database or initiated on new discussions. They are serialized before being stored to make storing abstractions significantly simpler. Because we propose no abstraction for a contact and TextSecure has multi-device (multiple sessions with same identity key) support, the identityKeys need to be added manually.
@@ -63,6 +63,8 @@
 
 - (void)setMessageKeys:(NSData*)senderRatchetKey messageKeys:(MessageKeys*)messageKeys;
 
+- (void)setMessageKeys:(NSData*)senderRatchetKey messageKeysList:(NSArray<MessageKeys*>*)messageKeysList;
+
 - (void)setUnacknowledgedPreKeyMessage:(int)preKeyId signedPreKey:(int)signedPreKeyId baseKey:(NSData*)baseKey;
 - (BOOL)hasUnacknowledgedPreKeyMessage;
 - (PendingPreKey*)unacknowledgedPreKeyMessageItems;
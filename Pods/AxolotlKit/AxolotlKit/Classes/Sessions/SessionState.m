@@ -117,6 +117,27 @@ static NSString* const kCoderPendingPrekey    = @"kCoderPendingPrekey";
     [aCoder encodeObject:self.pendingPreKey forKey:kCoderPendingPrekey];
 }
 
+#pragma mark NSCopying
+
+- (id)copyWithZone:(NSZone *)zone{
+    SessionState *copy = [[[self class] allocWithZone:zone] init];
+
+    // Keys, chain keys and pending pre keys are immutable, so they can be shared; chains are not.
+    copy.version              = self.version;
+    copy.aliceBaseKey         = self.aliceBaseKey;
+    copy.remoteIdentityKey    = self.remoteIdentityKey;
+    copy.localIdentityKey     = self.localIdentityKey;
+    copy.previousCounter      = self.previousCounter;
+    copy.rootKey              = self.rootKey;
+    copy.remoteRegistrationId = self.remoteRegistrationId;
+    copy.localRegistrationId  = self.localRegistrationId;
+    copy.sendingChain         = [self.sendingChain copy];
+    copy.receivingChains      = [[NSMutableArray alloc] initWithArray:self.receivingChains copyItems:YES];
+    copy.pendingPreKey        = self.pendingPreKey;
+
+    return copy;
+}
+
 - (NSData*)senderRatchetKey{
     return [[self senderRatchetKeyPair] publicKey];
 }
@@ -260,6 +281,14 @@ static NSString* const kCoderPendingPrekey    = @"kCoderPendingPrekey";
     [self setReceiverChain:chainAndIndex.index updatedChain:chain];
 }
 
+- (void)setMessageKeys:(NSData*)senderRatchetKey messageKeysList:(NSArray<MessageKeys*>*)messageKeysList{
+    ChainAndIndex  *chainAndIndex = [self receiverChain:senderRatchetKey];
+    ReceivingChain *chain         = (ReceivingChain*)chainAndIndex.chain;
+    [chain.messageKeysList addObjectsFromArray:messageKeysList];
+    
+    [self setReceiverChain:chainAndIndex.index updatedChain:chain];
+}
+
 - (void)setUnacknowledgedPreKeyMessage:(int)preKeyId signedPreKey:(int)signedPreKeyId baseKey:(NSData*)baseKey{
     PendingPreKey *pendingPreKey = [[PendingPreKey alloc] initWithBaseKey:baseKey preKeyId:preKeyId signedPreKeyId:signedPreKeyId];
     
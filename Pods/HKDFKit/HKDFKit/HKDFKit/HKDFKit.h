@@ -12,6 +12,28 @@
 #define HKDF_HASH_ALG kCCHmacAlgSHA256
 #define HKDF_HASH_LEN CC_SHA256_DIGEST_LENGTH
 
+/**
+ *  HKDF into a caller provided buffer, without allocating. http://tools.ietf.org/html/rfc5869
+ *
+ *  @param seed       Original keying material
+ *  @param info       Expansion "salt", may be NULL
+ *  @param salt       Extraction salt, may be NULL
+ *  @param output     Buffer of at least outputSize bytes for the derived key material
+ *  @param outputSize Size of the output, at most 255 hash lengths
+ *
+ *  @return NO if outputSize is too large, in which case output is left untouched
+ */
+
+BOOL HKDFKitDeriveKey(const void *seed, size_t seedLength,
+                      const void *info, size_t infoLength,
+                      const void *salt, size_t saltLength,
+                      void *output, size_t outputSize);
+
+BOOL HKDFKitTextSecureV2DeriveKey(const void *seed, size_t seedLength,
+                                  const void *info, size_t infoLength,
+                                  const void *salt, size_t saltLength,
+                                  void *output, size_t outputSize);
+
 @interface HKDFKit : NSObject
 
 /**
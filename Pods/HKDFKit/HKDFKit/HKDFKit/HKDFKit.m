@@ -8,6 +8,63 @@
 
 #import "HKDFKit.h"
 
+#pragma mark Private Functions
+
+static BOOL HKDFKitDeriveKeyWithOffset(const void *seed, size_t seedLength,
+                                       const void *info, size_t infoLength,
+                                       const void *salt, size_t saltLength,
+                                       void *output, size_t outputSize, int offset){
+    size_t iterations = (outputSize + HKDF_HASH_LEN - 1) / HKDF_HASH_LEN;
+    if (iterations > 255) {
+        return NO;
+    }
+
+    // Extract
+    uint8_t prk[HKDF_HASH_LEN];
+    CCHmac(HKDF_HASH_ALG, salt, saltLength, seed, seedLength, prk);
+
+    // Expand, straight into the output. Each step is mixed into the next.
+    uint8_t T[HKDF_HASH_LEN];
+    size_t  mixinLength = 0;
+    size_t  written     = 0;
+
+    for (int i = offset; written < outputSize; i++) {
+        CCHmacContext ctx;
+        CCHmacInit(&ctx, HKDF_HASH_ALG, prk, sizeof(prk));
+        CCHmacUpdate(&ctx, T, mixinLength);
+        if (info != NULL) {
+            CCHmacUpdate(&ctx, info, infoLength);
+        }
+        unsigned char c = i;
+        CCHmacUpdate(&ctx, &c, 1);
+        CCHmacFinal(&ctx, T);
+        mixinLength = sizeof(T);
+
+        size_t stepLength = MIN(sizeof(T), outputSize - written);
+        memcpy((uint8_t *)output + written, T, stepLength);
+        written += stepLength;
+    }
+
+    memset_s(prk, sizeof(prk), 0, sizeof(prk));
+    memset_s(T, sizeof(T), 0, sizeof(T));
+
+    return YES;
+}
+
+BOOL HKDFKitDeriveKey(const void *seed, size_t seedLength,
+                      const void *info, size_t infoLength,
+                      const void *salt, size_t saltLength,
+                      void *output, size_t outputSize){
+    return HKDFKitDeriveKeyWithOffset(seed, seedLength, info, infoLength, salt, saltLength, output, outputSize, 1);
+}
+
+BOOL HKDFKitTextSecureV2DeriveKey(const void *seed, size_t seedLength,
+                                  const void *info, size_t infoLength,
+                                  const void *salt, size_t saltLength,
+                                  void *output, size_t outputSize){
+    return HKDFKitDeriveKeyWithOffset(seed, seedLength, info, infoLength, salt, saltLength, output, outputSize, 0);
+}
+
 @implementation HKDFKit
 
 + (NSData *)deriveKey:(NSData *)seed info:(NSData *)info salt:(NSData *)salt outputSize:(int)outputSize{
@@ -21,39 +78,12 @@
 #pragma mark Private Methods
 
 + (NSData *)deriveKey:(NSData *)seed info:(NSData *)info salt:(NSData *)salt outputSize:(int)outputSize offset:(int)offset{
-    NSData *prk = [self extract:seed salt:salt];
-    NSData *okm = [self expand:prk info:info outputSize:outputSize offset:offset];
-    return okm;
-}
-
-+ (NSData*)extract:(NSData*)data salt:(NSData*)salt{
-    char prk[HKDF_HASH_LEN] = {0};
-    CCHmac(HKDF_HASH_ALG, [salt bytes], [salt length], [data bytes], [data length], prk);
-    return [NSData dataWithBytes:prk length:sizeof(prk)];
-}
-
-+ (NSData*)expand:(NSData*)data info:(NSData*)info outputSize:(int)outputSize offset:(int)offset{
-    int             iterations = (int)ceil((double)outputSize/(double)HKDF_HASH_LEN);
-    NSData          *mixin = [NSData data];
-    NSMutableData   *results = [NSMutableData data];
-
-    for (int i=offset; i<(iterations+offset); i++) {
-        CCHmacContext ctx;
-        CCHmacInit(&ctx, HKDF_HASH_ALG, [data bytes], [data length]);
-        CCHmacUpdate(&ctx, [mixin bytes], [mixin length]);
-        if (info != nil) {
-            CCHmacUpdate(&ctx, [info bytes], [info length]);
-        }
-        unsigned char c = i;
-        CCHmacUpdate(&ctx, &c, 1);
-        unsigned char T[HKDF_HASH_LEN];
-        CCHmacFinal(&ctx, T);
-        NSData *stepResult = [NSData dataWithBytes:T length:sizeof(T)];
-        [results appendData:stepResult];
-        mixin = [stepResult copy];
-    }
-    
-    return [[NSData dataWithData:results] subdataWithRange:NSMakeRange(0, outputSize)];
+    NSMutableData *okm = [NSMutableData dataWithLength:outputSize];
+    BOOL success = HKDFKitDeriveKeyWithOffset([seed bytes], [seed length],
+                                              [info bytes], [info length],
+                                              [salt bytes], [salt length],
+                                              [okm mutableBytes], [okm length], offset);
+    return success ? okm : nil;
 }
 
 @end
@@ -0,0 +1 @@
+../../../SignalServiceKit/SignalServiceKit/src/Storage/AxolotlStore/OWSSessionStore.h
\ No newline at end of file
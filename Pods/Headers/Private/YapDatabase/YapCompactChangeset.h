@@ -0,0 +1 @@
+../../../YapDatabase/YapDatabase/Internal/YapCompactChangeset.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../YapDatabase/YapDatabase/Extensions/FullTextSearch/Internal/YapDatabaseFullTextSearchTokenizer.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../YapDatabase/YapDatabase/Internal/YapDatabaseStatementCache.h
\ No newline at end of file
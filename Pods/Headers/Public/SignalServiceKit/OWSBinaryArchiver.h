@@ -0,0 +1 @@
+../../../SignalServiceKit/SignalServiceKit/src/Storage/OWSBinaryArchiver.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../SignalServiceKit/SignalServiceKit/src/Storage/OWSDatabaseConnectionPool.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../SignalServiceKit/SignalServiceKit/src/Storage/OWSMessageSearchIndex.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../SignalServiceKit/SignalServiceKit/src/Contacts/OWSThreadSummary.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../YapDatabase/YapDatabase/Utilities/YapClockCache.h
\ No newline at end of file
@@ -0,0 +1,56 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+#import "TSYapDatabaseObject.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+extern NSString *const OWSThreadSummaryExtensionName;
+
+@class YapDatabase;
+
+// A denormalized, per-thread row holding what the inbox needs to sort and render a thread
+// without loading the thread's interactions.
+//
+// Summaries are keyed by thread id and are maintained by a hooks extension on every
+// interaction and thread write; they should never be saved by hand.
+@interface OWSThreadSummary : TSYapDatabaseObject
+
+- (instancetype)initWithUniqueId:(NSString *)uniqueId NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) NSString *threadId;
+
+// The most recent interaction for which +[TSThread shouldInteractionAppearInInbox:] is YES.
+@property (nonatomic, readonly, nullable) NSString *lastInboxInteractionId;
+
+// Mirrors -[TSThread lastMessageDate]; this is the inbox sort key. It is only ever taken from the thread,
+// never from its interactions, so that sorting on summaries orders threads exactly as sorting on threads did.
+@property (nonatomic, readonly) NSDate *lastMessageDate;
+
+// Mirrors -[TSThread archivalDate].
+@property (nonatomic, readonly, nullable) NSDate *archivalDate;
+
+// The number of items in the thread's TSUnreadDatabaseViewExtensionName group. Note that this is not
+// -[TSThread hasUnreadMessages], which only considers the thread's last interaction.
+@property (nonatomic, readonly) NSUInteger unreadCount;
+
+// YES if the thread belongs in TSArchiveGroup, i.e. it was archived and nothing
+// has appeared in the inbox since.
+@property (nonatomic, readonly) BOOL isArchived;
+
++ (nullable instancetype)summaryForThreadId:(NSString *)threadId
+                              transaction:(YapDatabaseReadTransaction *)transaction
+    NS_SWIFT_NAME(summary(threadId:transaction:));
+
+// Must be called after the thread, message and unread views are registered, since the
+// hooks read from them and need to run after they've been updated.
++ (void)syncRegisterDatabaseExtension:(YapDatabase *)database;
+
+// Builds summaries for threads which predate the extension. This is a no-op once it has
+// completed, so it is cheap to call on every launch.
++ (void)populateSummariesIfNecessaryWithTransaction:(YapDatabaseReadWriteTransaction *)transaction;
+
+@end
+
+NS_ASSUME_NONNULL_END
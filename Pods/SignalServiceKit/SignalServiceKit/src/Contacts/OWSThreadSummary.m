@@ -0,0 +1,377 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+#import "OWSThreadSummary.h"
+#import "TSDatabaseView.h"
+#import "TSInteraction.h"
+#import "TSStorageKeys.h"
+#import "TSThread.h"
+#import <YapDatabase/YapDatabase.h>
+#import <YapDatabase/YapDatabaseHooks.h>
+#import <YapDatabase/YapDatabaseView.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+NSString *const OWSThreadSummaryExtensionName = @"OWSThreadSummaryExtensionName";
+
+// Bump this to rebuild every summary on next launch.
+static NSString *const OWSThreadSummaryPopulatedVersionKey = @"OWSThreadSummaryPopulatedVersionKey";
+// Version 2 takes the sort date from the thread alone; version 1 also advanced it from interactions.
+static const NSUInteger kThreadSummaryPopulatedVersion = 2;
+
+static BOOL OWSNullableObjectsEqual(id _Nullable left, id _Nullable right)
+{
+    return left == right || [left isEqual:right];
+}
+
+@interface OWSThreadSummary ()
+
+@property (nonatomic, nullable) NSString *lastInboxInteractionId;
+@property (nonatomic) NSDate *lastMessageDate;
+@property (nonatomic, nullable) NSDate *archivalDate;
+@property (nonatomic) NSUInteger unreadCount;
+
+@end
+
+#pragma mark -
+
+@implementation OWSThreadSummary
+
+- (instancetype)initWithThread:(TSThread *)thread
+{
+    OWSAssert(thread.uniqueId);
+
+    self = [super initWithUniqueId:thread.uniqueId];
+    if (!self) {
+        return self;
+    }
+
+    _lastMessageDate = thread.lastMessageDate;
+    _archivalDate = thread.archivalDate;
+
+    return self;
+}
+
+- (nullable instancetype)initWithCoder:(NSCoder *)coder
+{
+    return [super initWithCoder:coder];
+}
+
+- (NSString *)threadId
+{
+    return self.uniqueId;
+}
+
+- (BOOL)isArchived
+{
+    // Matches +[TSDatabaseView threadShouldBeInInbox:lastMessageDate:].
+    if (!self.archivalDate) {
+        return NO;
+    }
+    return [self.lastMessageDate timeIntervalSinceDate:self.archivalDate] <= 0;
+}
+
++ (nullable instancetype)summaryForThreadId:(NSString *)threadId transaction:(YapDatabaseReadTransaction *)transaction
+{
+    OWSAssert(threadId.length > 0);
+    OWSAssert(transaction);
+
+    return [self fetchObjectWithUniqueID:threadId transaction:transaction];
+}
+
+#pragma mark - Maintenance
+
++ (nullable TSInteraction *)lastInboxInteractionForThreadId:(NSString *)threadId
+                                               excludingKey:(nullable NSString *)excludedKey
+                                                transaction:(YapDatabaseReadTransaction *)transaction
+{
+    __block TSInteraction *last = nil;
+    [[transaction ext:TSMessageDatabaseViewExtensionName]
+        enumerateRowsInGroup:threadId
+                 withOptions:NSEnumerationReverse
+                  usingBlock:^(
+                      NSString *collection, NSString *key, id object, id metadata, NSUInteger index, BOOL *stop) {
+                      if ([key isEqualToString:excludedKey]) {
+                          return;
+                      }
+
+                      OWSAssert([object isKindOfClass:[TSInteraction class]]);
+
+                      TSInteraction *interaction = (TSInteraction *)object;
+                      if ([TSThread shouldInteractionAppearInInbox:interaction]) {
+                          last = interaction;
+                          *stop = YES;
+                      }
+                  }];
+    return last;
+}
+
++ (NSUInteger)unreadCountForThreadId:(NSString *)threadId transaction:(YapDatabaseReadTransaction *)transaction
+{
+    return [[transaction ext:TSUnreadDatabaseViewExtensionName] numberOfItemsInGroup:threadId];
+}
+
+// Builds a summary from scratch. This scans the thread's interactions in reverse until it finds
+// one that belongs in the inbox, so it should only be used for threads we haven't seen before.
++ (instancetype)buildSummaryForThread:(TSThread *)thread transaction:(YapDatabaseReadTransaction *)transaction
+{
+    OWSThreadSummary *summary = [[self alloc] initWithThread:thread];
+
+    summary.lastInboxInteractionId =
+        [self lastInboxInteractionForThreadId:thread.uniqueId excludingKey:nil transaction:transaction].uniqueId;
+    summary.unreadCount = [self unreadCountForThreadId:thread.uniqueId transaction:transaction];
+
+    return summary;
+}
+
++ (void)saveNewSummary:(OWSThreadSummary *)summary transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    [summary saveWithTransaction:transaction];
+    [self touchThreadWithId:summary.threadId transaction:transaction];
+}
+
++ (void)updateSummary:(OWSThreadSummary *)summary
+    lastInboxInteractionId:(nullable NSString *)lastInboxInteractionId
+           lastMessageDate:(NSDate *)lastMessageDate
+              archivalDate:(nullable NSDate *)archivalDate
+               unreadCount:(NSUInteger)unreadCount
+               touchThread:(BOOL)touchThread
+               transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    BOOL didChange = (unreadCount != summary.unreadCount
+        || !OWSNullableObjectsEqual(lastInboxInteractionId, summary.lastInboxInteractionId)
+        || ![lastMessageDate isEqualToDate:summary.lastMessageDate]
+        || !OWSNullableObjectsEqual(archivalDate, summary.archivalDate));
+    if (!didChange) {
+        return;
+    }
+
+    // Summaries are shared through the object cache, so never modify one in place.
+    OWSThreadSummary *updatedSummary = [summary copy];
+    updatedSummary.lastInboxInteractionId = lastInboxInteractionId;
+    updatedSummary.lastMessageDate = lastMessageDate;
+    updatedSummary.archivalDate = archivalDate;
+    updatedSummary.unreadCount = unreadCount;
+    [updatedSummary saveWithTransaction:transaction];
+
+    if (touchThread) {
+        [self touchThreadWithId:summary.threadId transaction:transaction];
+    }
+}
+
+// The thread view groups and sorts on the summary, so it needs to re-evaluate the thread whenever
+// the summary changes. This also lets inbox observers know the row needs to be redrawn.
++ (void)touchThreadWithId:(NSString *)threadId transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    [transaction touchObjectForKey:threadId inCollection:[TSThread collection]];
+}
+
++ (void)didModifyThread:(TSThread *)thread transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    OWSThreadSummary *_Nullable summary = [self summaryForThreadId:thread.uniqueId transaction:transaction];
+    if (!summary) {
+        [self saveNewSummary:[self buildSummaryForThread:thread transaction:transaction] transaction:transaction];
+        return;
+    }
+
+    // The thread view has already seen this write, but it sorted the thread on the summary's old date,
+    // so it only needs to see the thread again if that date moved. It reads the archival date from the
+    // thread itself.
+    BOOL didChangeLastMessageDate = ![thread.lastMessageDate isEqualToDate:summary.lastMessageDate];
+    [self updateSummary:summary
+        lastInboxInteractionId:summary.lastInboxInteractionId
+               lastMessageDate:thread.lastMessageDate
+                  archivalDate:thread.archivalDate
+                   unreadCount:summary.unreadCount
+                   touchThread:didChangeLastMessageDate
+                   transaction:transaction];
+}
+
++ (void)didModifyInteraction:(TSInteraction *)interaction transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    NSString *threadId = interaction.uniqueThreadId;
+    if (threadId.length < 1) {
+        return;
+    }
+
+    OWSThreadSummary *_Nullable summary = [self summaryForThreadId:threadId transaction:transaction];
+    if (!summary) {
+        TSThread *_Nullable thread = [TSThread fetchObjectWithUniqueID:threadId transaction:transaction];
+        if (thread) {
+            [self saveNewSummary:[self buildSummaryForThread:thread transaction:transaction] transaction:transaction];
+        }
+        // Otherwise the summary will be built when the thread is saved.
+        return;
+    }
+
+    // The sort date is left alone: it mirrors the thread, which -[TSThread updateWithLastMessage:transaction:]
+    // saves separately, and didModifyThread: picks that up.
+    NSString *_Nullable lastInboxInteractionId = summary.lastInboxInteractionId;
+    if ([TSThread shouldInteractionAppearInInbox:interaction]) {
+        if (!lastInboxInteractionId || [lastInboxInteractionId isEqualToString:interaction.uniqueId]) {
+            lastInboxInteractionId = interaction.uniqueId;
+        } else {
+            TSInteraction *_Nullable lastInboxInteraction =
+                [TSInteraction fetchObjectWithUniqueID:lastInboxInteractionId transaction:transaction];
+            if (!lastInboxInteraction ||
+                [interaction.dateForSorting compare:lastInboxInteraction.dateForSorting] != NSOrderedAscending) {
+                lastInboxInteractionId = interaction.uniqueId;
+            }
+        }
+    } else if ([lastInboxInteractionId isEqualToString:interaction.uniqueId]) {
+        lastInboxInteractionId =
+            [self lastInboxInteractionForThreadId:threadId excludingKey:nil transaction:transaction].uniqueId;
+    }
+
+    [self updateSummary:summary
+        lastInboxInteractionId:lastInboxInteractionId
+               lastMessageDate:summary.lastMessageDate
+                  archivalDate:summary.archivalDate
+                   unreadCount:[self unreadCountForThreadId:threadId transaction:transaction]
+                   touchThread:YES
+                   transaction:transaction];
+}
+
++ (void)willRemoveInteractionWithKey:(NSString *)key transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    TSInteraction *_Nullable interaction = [TSInteraction fetchObjectWithUniqueID:key transaction:transaction];
+    NSString *threadId = interaction.uniqueThreadId;
+    if (threadId.length < 1) {
+        return;
+    }
+
+    // Summaries are removed along with their thread, before its interactions.
+    OWSThreadSummary *_Nullable summary = [self summaryForThreadId:threadId transaction:transaction];
+    if (!summary) {
+        return;
+    }
+
+    // The views haven't processed the removal yet, so account for it by hand.
+    NSUInteger unreadCount = [self unreadCountForThreadId:threadId transaction:transaction];
+    NSString *_Nullable unreadGroup = nil;
+    [[transaction ext:TSUnreadDatabaseViewExtensionName] getGroup:&unreadGroup
+                                                            index:NULL
+                                                           forKey:key
+                                                     inCollection:[TSInteraction collection]];
+    if (unreadGroup && unreadCount > 0) {
+        unreadCount--;
+    }
+
+    NSString *_Nullable lastInboxInteractionId = summary.lastInboxInteractionId;
+    if ([lastInboxInteractionId isEqualToString:key]) {
+        lastInboxInteractionId =
+            [self lastInboxInteractionForThreadId:threadId excludingKey:key transaction:transaction].uniqueId;
+    }
+
+    [self updateSummary:summary
+        lastInboxInteractionId:lastInboxInteractionId
+               lastMessageDate:summary.lastMessageDate
+                  archivalDate:summary.archivalDate
+                   unreadCount:unreadCount
+                   touchThread:YES
+                   transaction:transaction];
+}
+
+#pragma mark - Database Extension
+
++ (YapDatabaseHooks *)databaseExtension
+{
+    YapDatabaseHooks *hooks = [[YapDatabaseHooks alloc] init];
+    hooks.allowedCollections = [[YapWhitelistBlacklist alloc]
+        initWithWhitelist:[NSSet setWithArray:@[ [TSThread collection], [TSInteraction collection] ]]];
+
+    hooks.didModifyRow = ^(YapDatabaseReadWriteTransaction *transaction,
+        NSString *collection,
+        NSString *key,
+        YapProxyObject *proxyObject,
+        YapProxyObject *proxyMetadata,
+        YapDatabaseHooksBitMask flags) {
+        // Touches don't change anything we summarize, and we touch threads ourselves.
+        if (!(flags & YapDatabaseHooksChangedObject)) {
+            return;
+        }
+
+        id object = proxyObject.realObject;
+        if ([object isKindOfClass:[TSThread class]]) {
+            [self didModifyThread:(TSThread *)object transaction:transaction];
+        } else if ([object isKindOfClass:[TSInteraction class]]) {
+            [self didModifyInteraction:(TSInteraction *)object transaction:transaction];
+        }
+    };
+
+    hooks.willRemoveRow = ^(YapDatabaseReadWriteTransaction *transaction, NSString *collection, NSString *key) {
+        if ([collection isEqualToString:[TSInteraction collection]]) {
+            [self willRemoveInteractionWithKey:key transaction:transaction];
+        }
+    };
+
+    hooks.didRemoveRow = ^(YapDatabaseReadWriteTransaction *transaction, NSString *collection, NSString *key) {
+        if ([collection isEqualToString:[TSThread collection]]) {
+            [transaction removeObjectForKey:key inCollection:[OWSThreadSummary collection]];
+        }
+    };
+
+    return hooks;
+}
+
++ (void)syncRegisterDatabaseExtension:(YapDatabase *)database
+{
+    if ([database registeredExtension:OWSThreadSummaryExtensionName]) {
+        OWSFail(@"%@ was already initialized.", OWSThreadSummaryExtensionName);
+        return;
+    }
+    [database registerExtension:[self databaseExtension] withName:OWSThreadSummaryExtensionName];
+}
+
++ (void)populateSummariesIfNecessaryWithTransaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    NSNumber *_Nullable populatedVersion =
+        [transaction objectForKey:OWSThreadSummaryPopulatedVersionKey inCollection:TSStorageInternalSettingsCollection];
+    if (populatedVersion.unsignedIntegerValue >= kThreadSummaryPopulatedVersion) {
+        return;
+    }
+
+    NSMutableArray<OWSThreadSummary *> *summaries = [NSMutableArray new];
+    [TSThread enumerateCollectionObjectsWithTransaction:transaction
+                                             usingBlock:^(id object, BOOL *stop) {
+                                                 if (![object isKindOfClass:[TSThread class]]) {
+                                                     return;
+                                                 }
+                                                 [summaries addObject:[self buildSummaryForThread:(TSThread *)object
+                                                                                      transaction:transaction]];
+                                             }];
+
+    // A fresh summary sorts by the same date as -[TSThread lastMessageDate], which is what the thread view
+    // falls back to without one. Summaries from an older version may have sorted threads differently though,
+    // so in that case the thread view has to see every thread again.
+    BOOL shouldTouchThreads = populatedVersion != nil;
+    for (OWSThreadSummary *summary in summaries) {
+        [summary saveWithTransaction:transaction];
+        if (shouldTouchThreads) {
+            [self touchThreadWithId:summary.threadId transaction:transaction];
+        }
+    }
+
+    [transaction setObject:@(kThreadSummaryPopulatedVersion)
+                    forKey:OWSThreadSummaryPopulatedVersionKey
+              inCollection:TSStorageInternalSettingsCollection];
+
+    DDLogInfo(@"%@ Populated %lu thread summaries.", self.tag, (unsigned long)summaries.count);
+}
+
+#pragma mark - Logging
+
++ (NSString *)tag
+{
+    return [NSString stringWithFormat:@"[%@]", self.class];
+}
+
+- (NSString *)tag
+{
+    return self.class.tag;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
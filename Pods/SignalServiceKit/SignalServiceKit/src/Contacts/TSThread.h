@@ -68,12 +68,19 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSArray<TSInvalidIdentityKeyReceivingErrorMessage *> *)receivedMessagesForInvalidKey:(NSData *)key;
 
+// Returns YES IFF the interaction should show up in the inbox as the last message.
++ (BOOL)shouldInteractionAppearInInbox:(TSInteraction *)interaction;
+
 /**
  *  Returns whether or not the thread has unread messages.
  *
- *  @return YES if it has unread TSIncomingMessages, NO otherwise.
+ *  Only the last interaction is considered, so this is NO once anything has been added after an unread
+ *  message. Use -[OWSThreadSummary unreadCount] for the number of unread messages.
+ *
+ *  @return YES if its last interaction is an unread TSIncomingMessage, NO otherwise.
  */
 - (BOOL)hasUnreadMessages;
+- (BOOL)hasUnreadMessagesWithTransaction:(YapDatabaseReadTransaction *)transaction;
 
 - (BOOL)hasSafetyNumbers;
 
@@ -3,7 +3,9 @@
 //
 
 #import "TSThread.h"
+#import "OWSDatabaseConnectionPool.h"
 #import "OWSReadTracking.h"
+#import "OWSThreadSummary.h"
 #import "TSDatabaseView.h"
 #import "TSIncomingMessage.h"
 #import "TSInfoMessage.h"
@@ -184,7 +186,15 @@ NS_ASSUME_NONNULL_BEGIN
 }
 
 - (BOOL)hasUnreadMessages {
-    TSInteraction *interaction = self.lastInteraction;
+    __block BOOL hasUnread;
+    [TSStorageManager.sharedManager.dbReadPool readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+        hasUnread = [self hasUnreadMessagesWithTransaction:transaction];
+    }];
+    return hasUnread;
+}
+
+- (BOOL)hasUnreadMessagesWithTransaction:(YapDatabaseReadTransaction *)transaction {
+    TSInteraction *interaction = [[transaction ext:TSMessageDatabaseViewExtensionName] lastObjectInGroup:self.uniqueId];
     BOOL hasUnread = NO;
 
     if ([interaction isKindOfClass:[TSIncomingMessage class]]) {
@@ -242,7 +252,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (TSInteraction *) lastInteraction {
     __block TSInteraction *last;
-    [TSStorageManager.sharedManager.dbReadConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+    [TSStorageManager.sharedManager.dbReadPool readWithBlock:^(YapDatabaseReadTransaction *transaction) {
         last = [[transaction ext:TSMessageDatabaseViewExtensionName] lastObjectInGroup:self.uniqueId];
     }];
     return last;
@@ -251,7 +261,15 @@ NS_ASSUME_NONNULL_BEGIN
 - (TSInteraction *)lastInteractionForInbox
 {
     __block TSInteraction *last = nil;
-    [TSStorageManager.sharedManager.dbReadConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+    [TSStorageManager.sharedManager.dbReadPool readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+        OWSThreadSummary *summary = [OWSThreadSummary summaryForThreadId:self.uniqueId transaction:transaction];
+        if (summary) {
+            if (summary.lastInboxInteractionId) {
+                last = [TSInteraction fetchObjectWithUniqueID:summary.lastInboxInteractionId transaction:transaction];
+            }
+            return;
+        }
+
         [[transaction ext:TSMessageDatabaseViewExtensionName]
             enumerateRowsInGroup:self.uniqueId
                      withOptions:NSEnumerationReverse
@@ -288,7 +306,6 @@ NS_ASSUME_NONNULL_BEGIN
     }
 }
 
-// Returns YES IFF the interaction should show up in the inbox as the last message.
 + (BOOL)shouldInteractionAppearInInbox:(TSInteraction *)interaction
 {
     OWSAssert(interaction);
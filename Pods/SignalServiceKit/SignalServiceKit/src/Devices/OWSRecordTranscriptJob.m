@@ -68,7 +68,7 @@ NS_ASSUME_NONNULL_BEGIN
     TSThread *thread = [transcript threadWithTransaction:transaction];
     if (transcript.isEndSessionMessage) {
         DDLogInfo(@"%@ EndSession was sent to recipient: %@.", self.tag, transcript.recipientId);
-        dispatch_async([OWSDispatch sessionStoreQueue], ^{
+        dispatch_async([OWSDispatch sessionStoreQueueForRecipientId:transcript.recipientId], ^{
             [self.storageManager deleteAllSessionsForContact:transcript.recipientId];
         });
         [[[TSInfoMessage alloc] initWithTimestamp:transcript.timestamp
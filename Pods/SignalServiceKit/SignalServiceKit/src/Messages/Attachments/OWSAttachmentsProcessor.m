@@ -197,13 +197,13 @@ static const CGFloat kAttachmentDownloadProgressTheta = 0.001f;
             dispatch_async([OWSDispatch attachmentsQueue], ^{
                 [self downloadFromLocation:location
                     pointer:attachment
-                    success:^(NSData *_Nonnull encryptedData) {
-                        [self decryptAttachmentData:encryptedData
+                    success:^(NSString *_Nonnull encryptedFilePath) {
+                        [self decryptAttachmentFile:encryptedFilePath
                                             pointer:attachment
                                             success:markAndHandleSuccess
                                             failure:markAndHandleFailure];
                     }
-                    failure:^(NSURLSessionDataTask *_Nullable task, NSError *_Nonnull error) {
+                    failure:^(NSURLSessionTask *_Nullable task, NSError *_Nonnull error) {
                         if (attachment.serverId < 100) {
                             // This looks like the symptom of the "frequent 404
                             // downloading attachments with low server ids".
@@ -241,48 +241,39 @@ static const CGFloat kAttachmentDownloadProgressTheta = 0.001f;
         }];
 }
 
-- (void)decryptAttachmentData:(NSData *)cipherText
+- (void)decryptAttachmentFile:(NSString *)encryptedFilePath
                       pointer:(TSAttachmentPointer *)attachment
                       success:(void (^)(TSAttachmentStream *attachmentStream))successHandler
                       failure:(void (^)(NSError *error))failureHandler
 {
-    NSError *decryptError;
-    NSData *plaintext = [Cryptography decryptAttachment:cipherText
-                                                withKey:attachment.encryptionKey
-                                                 digest:attachment.digest
-                                           unpaddedSize:attachment.byteCount
-                                                  error:&decryptError];
+    TSAttachmentStream *stream = [[TSAttachmentStream alloc] initWithPointer:attachment];
 
-    if (decryptError) {
+    // The ciphertext is decrypted straight into the attachment's file.
+    NSError *decryptError;
+    BOOL success = [stream writeDecryptedDataFromFile:encryptedFilePath
+                                                  key:attachment.encryptionKey
+                                               digest:attachment.digest
+                                         unpaddedSize:attachment.byteCount
+                                                error:&decryptError];
+    [[NSFileManager defaultManager] removeItemAtPath:encryptedFilePath error:nil];
+
+    if (!success) {
         DDLogError(@"%@ failed to decrypt with error: %@", self.tag, decryptError);
-        failureHandler(decryptError);
-        return;
-    }
-
-    if (!plaintext) {
-        NSError *error = OWSErrorWithCodeDescription(OWSErrorCodeFailedToDecryptMessage, NSLocalizedString(@"ERROR_MESSAGE_INVALID_MESSAGE", @""));
+        NSError *error = decryptError
+            ?: OWSErrorWithCodeDescription(
+                   OWSErrorCodeFailedToDecryptMessage, NSLocalizedString(@"ERROR_MESSAGE_INVALID_MESSAGE", @""));
         failureHandler(error);
         return;
     }
 
-    TSAttachmentStream *stream = [[TSAttachmentStream alloc] initWithPointer:attachment];
-
-    NSError *writeError;
-    [stream writeData:plaintext error:&writeError];
-    if (writeError) {
-        DDLogError(@"%@ Failed writing attachment stream with error: %@", self.tag, writeError);
-        failureHandler(writeError);
-        return;
-    }
-
     [stream save];
     successHandler(stream);
 }
 
 - (void)downloadFromLocation:(NSString *)location
                      pointer:(TSAttachmentPointer *)pointer
-                     success:(void (^)(NSData *encryptedData))successHandler
-                     failure:(void (^)(NSURLSessionDataTask *_Nullable task, NSError *_Nonnull error))failureHandler
+                     success:(void (^)(NSString *encryptedFilePath))successHandler
+                     failure:(void (^)(NSURLSessionTask *_Nullable task, NSError *_Nonnull error))failureHandler
 {
     AFHTTPSessionManager *manager = [AFHTTPSessionManager manager];
     manager.requestSerializer     = [AFHTTPRequestSerializer serializer];
@@ -292,11 +283,22 @@ static const CGFloat kAttachmentDownloadProgressTheta = 0.001f;
 
     // We want to avoid large downloads from a compromised or buggy service.
     const long kMaxDownloadSize = 150 * 1024 * 1024;
-    // TODO stream this download rather than storing the entire blob.
-    __block NSURLSessionDataTask *task = nil;
+    NSError *requestError;
+    NSMutableURLRequest *request =
+        [manager.requestSerializer requestWithMethod:@"GET" URLString:location parameters:nil error:&requestError];
+    if (!request) {
+        DDLogError(@"%@ Failed to build attachment download request: %@", self.tag, requestError);
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            failureHandler(nil, requestError ?: OWSErrorMakeUnableToProcessServerResponseError());
+        });
+        return;
+    }
+
+    // The ciphertext is streamed to a temporary file rather than held in memory.
+    NSString *encryptedFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    __block NSURLSessionDownloadTask *task = nil;
     __block BOOL hasCheckedContentLength = NO;
-    task = [manager GET:location
-        parameters:nil
+    task = [manager downloadTaskWithRequest:request
         progress:^(NSProgress *_Nonnull progress) {
             OWSAssert(progress != nil);
             
@@ -375,22 +377,25 @@ static const CGFloat kAttachmentDownloadProgressTheta = 0.001f;
             // than our max download size.  Proceed with the download.
             hasCheckedContentLength = YES;
         }
-        success:^(NSURLSessionDataTask *_Nonnull task, id _Nullable responseObject) {
+        destination:^NSURL *_Nonnull(NSURL *_Nonnull targetPath, NSURLResponse *_Nonnull response) {
+            return [NSURL fileURLWithPath:encryptedFilePath];
+        }
+        completionHandler:^(NSURLResponse *_Nonnull response, NSURL *_Nullable filePath, NSError *_Nullable error) {
             dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-                if (![responseObject isKindOfClass:[NSData class]]) {
-                    DDLogError(@"%@ Failed retrieval of attachment. Response had unexpected format.", self.tag);
-                    NSError *error = OWSErrorMakeUnableToProcessServerResponseError();
+                if (error) {
+                    DDLogError(@"Failed to retrieve attachment with error: %@", error.description);
+                    [[NSFileManager defaultManager] removeItemAtPath:encryptedFilePath error:nil];
                     return failureHandler(task, error);
                 }
-                successHandler((NSData *)responseObject);
-            });
-        }
-        failure:^(NSURLSessionDataTask *_Nullable task, NSError *_Nonnull error) {
-            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-                DDLogError(@"Failed to retrieve attachment with error: %@", error.description);
-                return failureHandler(task, error);
+                if (![[NSFileManager defaultManager] fileExistsAtPath:encryptedFilePath]) {
+                    DDLogError(@"%@ Failed retrieval of attachment. Download has no file.", self.tag);
+                    NSError *missingFileError = OWSErrorMakeUnableToProcessServerResponseError();
+                    return failureHandler(task, missingFileError);
+                }
+                successHandler(encryptedFilePath);
             });
         }];
+    [task resume];
 }
 
 - (void)fireProgressNotification:(CGFloat)progress attachmentId:(NSString *)attachmentId
@@ -48,6 +48,20 @@ NS_ASSUME_NONNULL_BEGIN
 - (BOOL)writeData:(NSData *)data error:(NSError **)error;
 - (BOOL)writeDataSource:(DataSource *)dataSource;
 
+// Decrypts an encrypted attachment file straight into this attachment's file,
+// without loading either into memory.
+- (BOOL)writeDecryptedDataFromFile:(NSString *)encryptedFilePath
+                               key:(NSData *)key
+                            digest:(nullable NSData *)digest
+                      unpaddedSize:(UInt32)unpaddedSize
+                             error:(NSError **)error;
+
+// Encrypts this attachment's file for upload, without loading either into memory.
+- (BOOL)writeEncryptedDataToFile:(NSString *)encryptedFilePath
+                          outKey:(NSData *_Nonnull *_Nullable)outKey
+                       outDigest:(NSData *_Nonnull *_Nullable)outDigest
+                           error:(NSError **)error;
+
 + (void)deleteAttachments;
 + (NSString *)attachmentsFolder;
 
@@ -3,8 +3,10 @@
 //
 
 #import "TSAttachmentStream.h"
+#import "Cryptography.h"
 #import "MIMETypeUtil.h"
 #import "NSData+Image.h"
+#import "OWSError.h"
 #import "TSAttachmentPointer.h"
 #import <AVFoundation/AVFoundation.h>
 #import <ImageIO/ImageIO.h>
@@ -179,6 +181,57 @@ NS_ASSUME_NONNULL_BEGIN
     return [dataSource writeToPath:filePath];
 }
 
+- (BOOL)writeDecryptedDataFromFile:(NSString *)encryptedFilePath
+                               key:(NSData *)key
+                            digest:(nullable NSData *)digest
+                      unpaddedSize:(UInt32)unpaddedSize
+                             error:(NSError **)error
+{
+    OWSAssert(encryptedFilePath.length > 0);
+
+    *error = nil;
+    NSString *_Nullable filePath = self.filePath;
+    if (!filePath) {
+        OWSFail(@"%@ Missing path for attachment.", self.tag);
+        *error = OWSErrorMakeWriteAttachmentDataError();
+        return NO;
+    }
+    DDLogInfo(@"%@ Decrypting attachment to file: %@", self.tag, filePath);
+    return [Cryptography decryptAttachmentAtPath:encryptedFilePath
+                                          toPath:filePath
+                                         withKey:key
+                                          digest:digest
+                                    unpaddedSize:unpaddedSize
+                                           error:error];
+}
+
+- (BOOL)writeEncryptedDataToFile:(NSString *)encryptedFilePath
+                          outKey:(NSData *_Nonnull *_Nullable)outKey
+                       outDigest:(NSData *_Nonnull *_Nullable)outDigest
+                           error:(NSError **)error
+{
+    OWSAssert(encryptedFilePath.length > 0);
+
+    *error = nil;
+    NSString *_Nullable filePath = self.filePath;
+    if (!filePath) {
+        OWSFail(@"%@ Missing path for attachment.", self.tag);
+        *error = OWSErrorMakeWriteAttachmentDataError();
+        return NO;
+    }
+    NSInputStream *_Nullable inputStream = [NSInputStream inputStreamWithFileAtPath:filePath];
+    if (!inputStream) {
+        DDLogError(@"%@ Could not open attachment file: %@", self.tag, filePath);
+        *error = OWSErrorMakeWriteAttachmentDataError();
+        return NO;
+    }
+    return [Cryptography encryptAttachmentStream:inputStream
+                                          toPath:encryptedFilePath
+                                          outKey:outKey
+                                       outDigest:outDigest
+                                           error:error];
+}
+
 + (NSString *)attachmentsFolder
 {
     static NSString *attachmentsFolder = nil;
@@ -80,8 +80,8 @@ NS_ASSUME_NONNULL_BEGIN
         return;
     }
 
-    // Saving a new identity mutates the session store so it must happen on the sessionStoreQueue
-    dispatch_async([OWSDispatch sessionStoreQueue], ^{
+    // Saving a new identity mutates the session store so it must happen on the sender's session store queue
+    dispatch_async([OWSDispatch sessionStoreQueueForRecipientId:self.envelope.source], ^{
         [[OWSIdentityManager sharedManager] saveRemoteIdentity:newKey recipientId:self.envelope.source];
 
         dispatch_async(dispatch_get_main_queue(), ^{
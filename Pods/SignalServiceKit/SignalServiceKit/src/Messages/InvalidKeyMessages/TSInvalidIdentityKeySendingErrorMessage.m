@@ -50,14 +50,14 @@ NSString *TSInvalidRecipientKey = @"TSInvalidRecipientKey";
     // But there may still be some old unaccepted SN errors in the wild that need to be accepted.
     OWSFail(@"accepting new identity key is deprecated.");
 
-    // Saving a new identity mutates the session store so it must happen on the sessionStoreQueue
+    // Saving a new identity mutates the session store so it must happen on the recipient's session store queue
     NSData *_Nullable newIdentityKey = self.newIdentityKey;
     if (!newIdentityKey) {
         OWSFail(@"newIdentityKey is unexpectedly nil. Bad Prekey bundle?: %@", self.preKeyBundle);
         return;
     }
 
-    dispatch_async([OWSDispatch sessionStoreQueue], ^{
+    dispatch_async([OWSDispatch sessionStoreQueueForRecipientId:self.recipientId], ^{
         [[OWSIdentityManager sharedManager] saveRemoteIdentity:newIdentityKey recipientId:self.recipientId];
     });
 }
@@ -2,22 +2,47 @@
 //  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
 //
 
+#import "OWSMessageReceiver.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 @class OWSSignalServiceProtosEnvelope;
 @class YapDatabase;
+@class YapDatabaseReadWriteTransaction;
 
 // This class is used to write incoming (decrypted, unprocessed)
 // messages to a durable queue and then process them in batches,
 // in the order in which they were received.
-@interface OWSBatchMessageProcessor : NSObject
+@interface OWSBatchMessageProcessor : NSObject <OWSMessageReceiverProcessor>
 
 + (instancetype)sharedInstance;
 + (void)syncRegisterDatabaseExtension:(YapDatabase *)database;
 
+// Persists the decrypted envelope asynchronously, then processes it.
+//
+// Callers that must know when the envelope is durable should use the transactional variant below.
 - (void)enqueueEnvelopeData:(NSData *)envelopeData plaintextData:(NSData *_Nullable)plaintextData;
+
+// Persists the decrypted envelope as part of the caller's transaction.
+//
+// Callers are responsible for calling handleAnyUnprocessedEnvelopesAsync
+// once the transaction has been committed.
+- (void)enqueueEnvelopeData:(NSData *)envelopeData
+              plaintextData:(NSData *_Nullable)plaintextData
+                transaction:(YapDatabaseReadWriteTransaction *)transaction;
 - (void)handleAnyUnprocessedEnvelopesAsync;
 
+#pragma mark - Stats
+
+// These properties can be read from any thread and are intended for diagnostics.
+
+// The number of jobs waiting to be processed, as of the most recent batch.
+@property (atomic, readonly) NSUInteger pendingJobCount;
+// The total number of jobs processed since launch.
+@property (atomic, readonly) NSUInteger processedJobCount;
+// A moving average of the recent processing rate, in jobs per second.
+@property (atomic, readonly) double recentJobsPerSecond;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -110,11 +110,15 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
 }
 
 - (NSArray<OWSMessageContentJob *> *)nextJobsForBatchSize:(NSUInteger)maxBatchSize
+                                          pendingJobCount:(NSUInteger *)pendingJobCount
 {
+    OWSAssert(pendingJobCount);
+
     NSMutableArray<OWSMessageContentJob *> *jobs = [NSMutableArray new];
     [self.dbConnection readWithBlock:^(YapDatabaseReadTransaction *_Nonnull transaction) {
         YapDatabaseViewTransaction *viewTransaction = [transaction ext:OWSMessageContentJobFinderExtensionName];
         OWSAssert(viewTransaction != nil);
+        *pendingJobCount = [viewTransaction numberOfItemsInGroup:OWSMessageContentJobFinderExtensionGroup];
         [viewTransaction enumerateKeysAndObjectsInGroup:OWSMessageContentJobFinderExtensionGroup
                                              usingBlock:^(NSString *_Nonnull collection,
                                                           NSString *_Nonnull key,
@@ -132,21 +136,35 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
     return [jobs copy];
 }
 
-- (void)addJobWithEnvelopeData:(NSData *)envelopeData plaintextData:(NSData *_Nullable)plaintextData
+- (void)addJobWithEnvelopeData:(NSData *)envelopeData
+                 plaintextData:(NSData *_Nullable)plaintextData
+                    completion:(dispatch_block_t)completion
 {
+    OWSAssert(completion);
+
     // We need to persist the decrypted envelope data ASAP to prevent data loss.
-    [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
-        OWSMessageContentJob *job =
-        [[OWSMessageContentJob alloc] initWithEnvelopeData:envelopeData plaintextData:plaintextData];
-        [job saveWithTransaction:transaction];
-    }];
+    // The write is queued right away, and shares its transaction with the jobs queued alongside it.
+    [self.dbConnection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
+        [self addJobWithEnvelopeData:envelopeData plaintextData:plaintextData transaction:transaction];
+    }
+        completionQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+        completionBlock:completion];
 }
 
-- (void)removeJobsWithIds:(NSArray<NSString *> *)uniqueIds
+- (void)addJobWithEnvelopeData:(NSData *)envelopeData
+                 plaintextData:(NSData *_Nullable)plaintextData
+                   transaction:(YapDatabaseReadWriteTransaction *)transaction
 {
-    [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
-        [transaction removeObjectsForKeys:uniqueIds inCollection:[OWSMessageContentJob collection]];
-    }];
+    OWSAssert(transaction);
+
+    OWSMessageContentJob *job =
+    [[OWSMessageContentJob alloc] initWithEnvelopeData:envelopeData plaintextData:plaintextData];
+    [job saveWithTransaction:transaction];
+}
+
+- (void)removeJobsWithIds:(NSArray<NSString *> *)uniqueIds transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    [transaction removeObjectsForKeys:uniqueIds inCollection:[OWSMessageContentJob collection]];
 }
 
 + (YapDatabaseView *)databaseExtension
@@ -225,6 +243,18 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
 
 #pragma mark - Queue Processing
 
+// The batch size adapts to how long each batch's write transaction takes:
+// long transactions block other writers, while tiny ones waste commits.
+static const NSUInteger kIncomingMessageInitialBatchSize = 32;
+static const NSUInteger kIncomingMessageMinBatchSize = 8;
+static const NSUInteger kIncomingMessageMaxBatchSize = 512;
+static const NSTimeInterval kIncomingMessageTargetBatchDuration = 0.1f;
+
+// While at least this many jobs are pending, we process the next batch immediately.
+// Below that, we wait a bit in hopes of increasing the batch size.
+static const NSUInteger kIncomingMessageImmediateDrainThreshold = 8;
+static const NSTimeInterval kIncomingMessageCoalescingDelay = 0.1f;
+
 @interface OWSMessageContentQueue : NSObject
 
 @property (nonatomic, readonly) OWSMessageManager *messagesManager;
@@ -232,6 +262,13 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
 @property (nonatomic, readonly) OWSMessageContentJobFinder *finder;
 @property (nonatomic) BOOL isDrainingQueue;
 
+// This property should only be accessed on the serialQueue.
+@property (nonatomic) NSUInteger batchSize;
+
+@property (atomic) NSUInteger pendingJobCount;
+@property (atomic) NSUInteger processedJobCount;
+@property (atomic) double recentJobsPerSecond;
+
 - (instancetype)initWithMessagesManager:(OWSMessageManager *)messagesManager
                          storageManager:(TSStorageManager *)storageManager
                                  finder:(OWSMessageContentJobFinder *)finder NS_DESIGNATED_INITIALIZER;
@@ -258,6 +295,7 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
     _dbReadWriteConnection = [storageManager newDatabaseConnection];
     _finder = finder;
     _isDrainingQueue = NO;
+    _batchSize = kIncomingMessageInitialBatchSize;
 
     [[NSNotificationCenter defaultCenter] addObserver:self
                                              selector:@selector(databaseViewRegistrationComplete)
@@ -294,7 +332,11 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
     OWSAssert(envelopeData);
 
     // We need to persist the decrypted envelope data ASAP to prevent data loss.
-    [self.finder addJobWithEnvelopeData:envelopeData plaintextData:plaintextData];
+    [self.finder addJobWithEnvelopeData:envelopeData
+                          plaintextData:plaintextData
+                             completion:^{
+                                 [self drainQueue];
+                             }];
 }
 
 - (void)drainQueue
@@ -319,45 +361,92 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
 {
     AssertOnDispatchQueue(self.serialQueue);
 
-    // We want a value that is just high enough to yield perf benefits.
-    const NSUInteger kIncomingMessageBatchSize = 32;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
 
-    NSArray<OWSMessageContentJob *> *jobs = [self.finder nextJobsForBatchSize:kIncomingMessageBatchSize];
+    NSUInteger pendingJobCount = 0;
+    NSArray<OWSMessageContentJob *> *jobs =
+        [self.finder nextJobsForBatchSize:self.batchSize pendingJobCount:&pendingJobCount];
     OWSAssert(jobs);
+    self.pendingJobCount = pendingJobCount;
     if (jobs.count < 1) {
         self.isDrainingQueue = NO;
         DDLogVerbose(@"%@ Queue is drained", self.tag);
         return;
     }
 
+    CFAbsoluteTime transactionStartTime = CFAbsoluteTimeGetCurrent();
     [self processJobs:jobs];
+    CFAbsoluteTime endTime = CFAbsoluteTimeGetCurrent();
 
-    [self.finder removeJobsWithIds:jobs.uniqueIds];
+    NSUInteger remainingJobCount = pendingJobCount - jobs.count;
+    self.pendingJobCount = remainingJobCount;
+    self.processedJobCount += jobs.count;
+    [self updateStatsWithJobCount:jobs.count duration:endTime - startTime];
+    [self updateBatchSizeWithJobCount:jobs.count transactionDuration:endTime - transactionStartTime];
 
-    DDLogVerbose(@"%@ completed %zd jobs. %zd jobs left.",
+    DDLogVerbose(@"%@ completed %zd jobs. %zd jobs left. next batch size: %zd.",
                  self.tag,
                  jobs.count,
-                 [OWSMessageContentJob numberOfKeysInCollection]);
+                 remainingJobCount,
+                 self.batchSize);
+
+    if (remainingJobCount >= kIncomingMessageImmediateDrainThreshold) {
+        dispatch_async(self.serialQueue, ^{
+            [self drainQueueWorkStep];
+        });
+        return;
+    }
 
     // Wait a bit in hopes of increasing the batch size.
     // This delay won't affect the first message to arrive when this queue is idle,
     // so by definition we're receiving more than one message and can benefit from
     // batching.
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.5f * NSEC_PER_SEC)), self.serialQueue, ^{
-        [self drainQueueWorkStep];
-    });
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kIncomingMessageCoalescingDelay * NSEC_PER_SEC)),
+        self.serialQueue,
+        ^{
+            [self drainQueueWorkStep];
+        });
+}
+
+- (void)updateBatchSizeWithJobCount:(NSUInteger)jobCount transactionDuration:(NSTimeInterval)transactionDuration
+{
+    AssertOnDispatchQueue(self.serialQueue);
+
+    if (transactionDuration > kIncomingMessageTargetBatchDuration) {
+        self.batchSize = MAX(kIncomingMessageMinBatchSize, self.batchSize / 2);
+    } else if (jobCount >= self.batchSize && transactionDuration < kIncomingMessageTargetBatchDuration * 0.5f) {
+        // Only grow when the batch was full; a partial batch tells us nothing about larger ones.
+        self.batchSize = MIN(kIncomingMessageMaxBatchSize, self.batchSize * 2);
+    }
+}
+
+- (void)updateStatsWithJobCount:(NSUInteger)jobCount duration:(NSTimeInterval)duration
+{
+    if (duration <= 0) {
+        return;
+    }
+
+    const double kSmoothingFactor = 0.25;
+    double jobsPerSecond = jobCount / duration;
+    double previousJobsPerSecond = self.recentJobsPerSecond;
+    self.recentJobsPerSecond = (previousJobsPerSecond > 0
+            ? (kSmoothingFactor * jobsPerSecond + (1 - kSmoothingFactor) * previousJobsPerSecond)
+            : jobsPerSecond);
 }
 
 - (void)processJobs:(NSArray<OWSMessageContentJob *> *)jobs
 {
     AssertOnDispatchQueue(self.serialQueue);
 
+    // Processing the jobs and removing them share a transaction, so a job
+    // is never processed twice or dropped.
     [self.dbReadWriteConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
         for (OWSMessageContentJob *job in jobs) {
             [self.messagesManager processEnvelope:job.envelopeProto
                                     plaintextData:job.plaintextData
                                       transaction:transaction];
         }
+        [self.finder removeJobsWithIds:jobs.uniqueIds transaction:transaction];
     }];
 }
 
@@ -413,6 +502,8 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
 {
     // For concurrency coherency we use the same dbConnection to persist and read the unprocessed envelopes
     YapDatabaseConnection *dbConnection = [[TSStorageManager sharedManager].database newConnection];
+    // Envelopes that are enqueued while the connection is busy are persisted in one transaction.
+    dbConnection.groupCommitLimit = 32;
     OWSMessageManager *messagesManager = [OWSMessageManager sharedManager];
     TSStorageManager *storageManager = [TSStorageManager sharedManager];
 
@@ -449,9 +540,37 @@ NSString *const OWSMessageContentJobFinderExtensionGroup = @"OWSMessageContentJo
 {
     OWSAssert(envelopeData);
 
-    // We need to persist the decrypted envelope data ASAP to prevent data loss.
+    // The queue drains once the envelope has been persisted.
     [self.processingQueue enqueueEnvelopeData:envelopeData plaintextData:plaintextData];
-    [self.processingQueue drainQueue];
+}
+
+- (void)enqueueEnvelopeData:(NSData *)envelopeData
+              plaintextData:(NSData *_Nullable)plaintextData
+                transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    OWSAssert(envelopeData);
+    OWSAssert(transaction);
+
+    [self.processingQueue.finder addJobWithEnvelopeData:envelopeData
+                                          plaintextData:plaintextData
+                                            transaction:transaction];
+}
+
+#pragma mark - Stats
+
+- (NSUInteger)pendingJobCount
+{
+    return self.processingQueue.pendingJobCount;
+}
+
+- (NSUInteger)processedJobCount
+{
+    return self.processingQueue.processedJobCount;
+}
+
+- (double)recentJobsPerSecond
+{
+    return self.processingQueue.recentJobsPerSecond;
 }
 
 @end
@@ -8,7 +8,11 @@ NS_ASSUME_NONNULL_BEGIN
 @class TSMessage;
 @class TSThread;
 @class YapDatabaseReadTransaction;
+@class YapDatabaseSecondaryIndex;
 
+// NOTE: When registered async, the index is populated in batches afterwards (see
+//       TSDatabaseExtensionPopulationBatchSize). Until isIndexPopulatedWithTransaction: returns YES,
+//       these methods may miss older messages.
 @interface OWSDisappearingMessagesFinder : NSObject
 
 - (void)enumerateExpiredMessagesWithBlock:(void (^_Nonnull)(TSMessage *message))block
@@ -24,6 +28,11 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (nullable NSNumber *)nextExpirationTimestampWithTransaction:(YapDatabaseReadTransaction *_Nonnull)transaction;
 
+- (BOOL)isIndexPopulatedWithTransaction:(YapDatabaseReadTransaction *)transaction;
+
++ (NSString *)databaseExtensionName;
++ (YapDatabaseSecondaryIndex *)indexDatabaseExtension;
+
 /**
  * Database extensions required for class to work.
  */
@@ -18,6 +18,9 @@ static NSString *const OWSDisappearingMessageFinderThreadIdColumn = @"thread_id"
 static NSString *const OWSDisappearingMessageFinderExpiresAtColumn = @"expires_at";
 static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_messages_on_expires_at_and_thread_id_v2";
 
+// Messages are fetched in batches of this size, rather than one at a time, or all at once.
+static const NSUInteger OWSDisappearingMessageFinderFetchBatchSize = 100;
+
 @implementation OWSDisappearingMessagesFinder
 
 - (NSArray<NSString *> *)fetchUnstartedExpiringMessageIdsInThread:(TSThread *)thread
@@ -26,12 +29,11 @@ static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_mess
     OWSAssert(transaction);
 
     NSMutableArray<NSString *> *messageIds = [NSMutableArray new];
-    NSString *formattedString = [NSString stringWithFormat:@"WHERE %@ = 0 AND %@ = \"%@\"",
+    NSString *formattedString = [NSString stringWithFormat:@"WHERE %@ = 0 AND %@ = ?",
                                           OWSDisappearingMessageFinderExpiresAtColumn,
-                                          OWSDisappearingMessageFinderThreadIdColumn,
-                                          thread.uniqueId];
+                                          OWSDisappearingMessageFinderThreadIdColumn];
 
-    YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:formattedString];
+    YapDatabaseQuery *query = [YapDatabaseQuery queryWithString:formattedString parameters:@[ thread.uniqueId ]];
     [[transaction ext:OWSDisappearingMessageFinderExpiresAtIndex]
         enumerateKeysMatchingQuery:query
                         usingBlock:^void(NSString *collection, NSString *key, BOOL *stop) {
@@ -49,11 +51,11 @@ static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_mess
 
     uint64_t now = [NSDate ows_millisecondTimeStamp];
     // When (expiresAt == 0) the message SHOULD NOT expire. Careful ;)
-    NSString *formattedString = [NSString stringWithFormat:@"WHERE %@ > 0 AND %@ <= %lld",
-                                          OWSDisappearingMessageFinderExpiresAtColumn,
+    // The keys come straight out of the (expires_at, collection, key) index, so this is a single range scan.
+    NSString *formattedString = [NSString stringWithFormat:@"WHERE %@ > 0 AND %@ <= ?",
                                           OWSDisappearingMessageFinderExpiresAtColumn,
-                                          now];
-    YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:formattedString];
+                                          OWSDisappearingMessageFinderExpiresAtColumn];
+    YapDatabaseQuery *query = [YapDatabaseQuery queryWithString:formattedString parameters:@[ @(now) ]];
     [[transaction ext:OWSDisappearingMessageFinderExpiresAtIndex]
         enumerateKeysMatchingQuery:query
                         usingBlock:^void(NSString *collection, NSString *key, BOOL *stop) {
@@ -67,21 +69,19 @@ static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_mess
 {
     OWSAssert(transaction);
 
-    NSString *formattedString = [NSString stringWithFormat:@"WHERE %@ > 0 ORDER BY %@ ASC",
-                                          OWSDisappearingMessageFinderExpiresAtColumn,
-                                          OWSDisappearingMessageFinderExpiresAtColumn];
-    YapDatabaseQuery *query = [YapDatabaseQuery queryWithFormat:formattedString];
+    // The index holds the expiration itself, so there's no need to load the message.
+    NSString *aggregateFunction =
+        [NSString stringWithFormat:@"MIN(%@)", OWSDisappearingMessageFinderExpiresAtColumn];
+    NSString *formattedString =
+        [NSString stringWithFormat:@"WHERE %@ > 0", OWSDisappearingMessageFinderExpiresAtColumn];
+    YapDatabaseQuery *query =
+        [YapDatabaseQuery queryWithAggregateFunction:aggregateFunction string:formattedString parameters:@[]];
 
-    __block TSMessage *firstMessage;
-    [[transaction ext:OWSDisappearingMessageFinderExpiresAtIndex]
-        enumerateKeysAndObjectsMatchingQuery:query
-                                  usingBlock:^void(NSString *collection, NSString *key, id object, BOOL *stop) {
-                                      firstMessage = (TSMessage *)object;
-                                      *stop = YES;
-                                  }];
-
-    if (firstMessage && firstMessage.expiresAt > 0) {
-        return [NSNumber numberWithUnsignedLongLong:firstMessage.expiresAt];
+    id result = [[transaction ext:OWSDisappearingMessageFinderExpiresAtIndex] performAggregateQuery:query];
+
+    // MIN() over no rows is NULL.
+    if ([result isKindOfClass:[NSNumber class]] && [result longLongValue] > 0) {
+        return [NSNumber numberWithUnsignedLongLong:[result unsignedLongLongValue]];
     }
 
     return nil;
@@ -93,15 +93,9 @@ static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_mess
 {
     OWSAssert(transaction);
 
-    for (NSString *expiringMessageId in
-        [self fetchUnstartedExpiringMessageIdsInThread:thread transaction:transaction]) {
-        TSMessage *_Nullable message = [TSMessage fetchObjectWithUniqueID:expiringMessageId transaction:transaction];
-        if ([message isKindOfClass:[TSMessage class]]) {
-            block(message);
-        } else {
-            DDLogError(@"%@ unexpected object: %@", self.tag, message);
-        }
-    }
+    [self enumerateMessagesWithIds:[self fetchUnstartedExpiringMessageIdsInThread:thread transaction:transaction]
+                             block:block
+                       transaction:transaction];
 }
 
 /**
@@ -130,13 +124,30 @@ static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_mess
     OWSAssert(transaction);
 
     // Since we can't directly mutate the enumerated expired messages, we store only their ids in hopes of saving a
-    // little memory and then enumerate the (larger) TSMessage objects one at a time.
-    for (NSString *expiredMessageId in [self fetchExpiredMessageIdsWithTransaction:transaction]) {
-        TSMessage *_Nullable message = [TSMessage fetchObjectWithUniqueID:expiredMessageId transaction:transaction];
-        if ([message isKindOfClass:[TSMessage class]]) {
-            block(message);
-        } else {
-            DDLogError(@"%@ unexpected object: %@", self.tag, message);
+    // little memory and then enumerate the (larger) TSMessage objects a batch at a time.
+    [self enumerateMessagesWithIds:[self fetchExpiredMessageIdsWithTransaction:transaction]
+                             block:block
+                       transaction:transaction];
+}
+
+// Fetches the messages in batches, and passes them to the block in the order of messageIds.
+// Messages which have been removed in the meantime are skipped.
+- (void)enumerateMessagesWithIds:(NSArray<NSString *> *)messageIds
+                           block:(void (^_Nonnull)(TSMessage *message))block
+                     transaction:(YapDatabaseReadTransaction *)transaction
+{
+    for (NSUInteger offset = 0; offset < messageIds.count; offset += OWSDisappearingMessageFinderFetchBatchSize) {
+        NSUInteger batchSize = MIN(OWSDisappearingMessageFinderFetchBatchSize, messageIds.count - offset);
+        NSArray<NSString *> *batch = [messageIds subarrayWithRange:NSMakeRange(offset, batchSize)];
+        NSDictionary<NSString *, id> *messages = [TSMessage fetchObjectsWithUniqueIDs:batch transaction:transaction];
+
+        for (NSString *messageId in batch) {
+            id _Nullable message = messages[messageId];
+            if ([message isKindOfClass:[TSMessage class]]) {
+                block(message);
+            } else {
+                DDLogError(@"%@ unexpected object: %@", self.tag, message);
+            }
         }
     }
 }
@@ -160,12 +171,31 @@ static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_mess
 
 #pragma mark - YapDatabaseExtension
 
+- (BOOL)isIndexPopulatedWithTransaction:(YapDatabaseReadTransaction *)transaction
+{
+    OWSAssert(transaction);
+
+    YapDatabaseSecondaryIndexTransaction *_Nullable ext = [transaction ext:OWSDisappearingMessageFinderExpiresAtIndex];
+
+    return ext != nil && ext.isPopulated;
+}
+
++ (NSString *)databaseExtensionName
+{
+    return OWSDisappearingMessageFinderExpiresAtIndex;
+}
+
 + (YapDatabaseSecondaryIndex *)indexDatabaseExtension
 {
     YapDatabaseSecondaryIndexSetup *setup = [YapDatabaseSecondaryIndexSetup new];
     [setup addColumn:OWSDisappearingMessageFinderExpiresAtColumn withType:YapDatabaseSecondaryIndexTypeInteger];
     [setup addColumn:OWSDisappearingMessageFinderThreadIdColumn withType:YapDatabaseSecondaryIndexTypeText];
 
+    // thread_id is TEXT, so this can't use an integers block. But the keys are included in the index, so that the
+    // expiration sweep reads them straight out of the expires_at index.
+    YapDatabaseSecondaryIndexOptions *options = [YapDatabaseSecondaryIndexOptions new];
+    options.includesKeys = YES;
+
     YapDatabaseSecondaryIndexHandler *handler =
         [YapDatabaseSecondaryIndexHandler withObjectBlock:^(YapDatabaseReadTransaction *transaction,
             NSMutableDictionary *dict,
@@ -185,7 +215,7 @@ static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_mess
             dict[OWSDisappearingMessageFinderThreadIdColumn] = message.uniqueThreadId;
         }];
 
-    return [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler];
+    return [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"1" options:options];
 }
 
 // Useful for tests, don't use in app startup path because it's slow.
@@ -197,7 +227,10 @@ static NSString *const OWSDisappearingMessageFinderExpiresAtIndex = @"index_mess
 
 + (void)asyncRegisterDatabaseExtensions:(TSStorageManager *)storageManager
 {
-    [storageManager.database asyncRegisterExtension:[self indexDatabaseExtension]
+    YapDatabaseSecondaryIndex *index = [self indexDatabaseExtension];
+    index.populationBatchSize = TSDatabaseExtensionPopulationBatchSize;
+
+    [storageManager.database asyncRegisterExtension:index
                                            withName:OWSDisappearingMessageFinderExpiresAtIndex
                                     completionBlock:^(BOOL ready) {
                                         if (ready) {
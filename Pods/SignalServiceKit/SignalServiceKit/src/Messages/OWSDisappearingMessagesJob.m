@@ -62,6 +62,10 @@ NS_ASSUME_NONNULL_BEGIN
                                              selector:@selector(applicationWillResignActive:)
                                                  name:UIApplicationWillResignActiveNotification
                                                object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(databaseExtensionPopulated:)
+                                                 name:YapDatabaseExtensionPopulatedNotification
+                                               object:storageManager.database];
 
     return self;
 }
@@ -403,6 +407,19 @@ NS_ASSUME_NONNULL_BEGIN
     [self resetTimer];
 }
 
+- (void)databaseExtensionPopulated:(NSNotification *)notification
+{
+    OWSAssert([NSThread isMainThread]);
+
+    // Until the index is populated, runs can miss older messages which have expired.
+    if (![notification.userInfo[YapDatabaseExtensionNameKey]
+            isEqualToString:[OWSDisappearingMessagesFinder databaseExtensionName]]) {
+        return;
+    }
+
+    [self runNow];
+}
+
 #pragma mark - Logging
 
 + (NSString *)tag
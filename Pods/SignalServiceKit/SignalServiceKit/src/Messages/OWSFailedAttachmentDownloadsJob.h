@@ -11,6 +11,9 @@ NS_ASSUME_NONNULL_BEGIN
 - (instancetype)init NS_UNAVAILABLE;
 - (instancetype)initWithStorageManager:(TSStorageManager *)storageManager NS_DESIGNATED_INITIALIZER;
 
+// NOTE: When registered async, the index is populated in batches afterwards (see
+//       TSDatabaseExtensionPopulationBatchSize). Until it isPopulated, this misses older attachments,
+//       so don't run it before then.
 - (void)run;
 
 /**
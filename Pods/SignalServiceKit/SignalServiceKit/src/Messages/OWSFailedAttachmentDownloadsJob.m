@@ -127,7 +127,10 @@ static NSString *const OWSFailedAttachmentDownloadsJobAttachmentStateIndex = @"i
 
 - (void)asyncRegisterDatabaseExtensions
 {
-    [self.storageManager.database asyncRegisterExtension:[self indexDatabaseExtension]
+    YapDatabaseSecondaryIndex *index = [self indexDatabaseExtension];
+    index.populationBatchSize = TSDatabaseExtensionPopulationBatchSize;
+
+    [self.storageManager.database asyncRegisterExtension:index
                                                 withName:OWSFailedAttachmentDownloadsJobAttachmentStateIndex
                                          completionBlock:^(BOOL ready) {
                                              if (ready) {
@@ -135,7 +135,10 @@ static NSString *const OWSFailedMessagesJobMessageStateIndex = @"index_outoing_m
 
 - (void)asyncRegisterDatabaseExtensions
 {
-    [self.storageManager.database asyncRegisterExtension:[self indexDatabaseExtension]
+    YapDatabaseSecondaryIndex *index = [self indexDatabaseExtension];
+    index.populationBatchSize = TSDatabaseExtensionPopulationBatchSize;
+
+    [self.storageManager.database asyncRegisterExtension:index
                                                 withName:OWSFailedMessagesJobMessageStateIndex
                                          completionBlock:^(BOOL ready) {
                                              if (ready) {
@@ -195,7 +195,7 @@ NSString *const kNSNotificationName_IdentityStateDidChange = @"kNSNotificationNa
                                                      createdAt:[NSDate new]
                                              verificationState:verificationState] save];
 
-            dispatch_async([OWSDispatch sessionStoreQueue], ^{
+            dispatch_async([OWSDispatch sessionStoreQueueForRecipientId:recipientId], ^{
                 [self.storageManager archiveAllSessionsForContact:recipientId];
             });
 
@@ -3,6 +3,7 @@
 //
 
 #import "OWSMessageHandler.h"
+#import "OWSMessageReceiver.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -11,7 +12,7 @@ NS_ASSUME_NONNULL_BEGIN
 typedef void (^DecryptSuccessBlock)(NSData *_Nullable plaintextData);
 typedef void (^DecryptFailureBlock)();
 
-@interface OWSMessageDecrypter : OWSMessageHandler
+@interface OWSMessageDecrypter : OWSMessageHandler <OWSMessageReceiverDecrypter>
 
 - (instancetype)init NS_UNAVAILABLE;
 + (instancetype)sharedManager;
@@ -25,6 +26,9 @@ typedef void (^DecryptFailureBlock)();
            successBlock:(DecryptSuccessBlock)successBlock
            failureBlock:(DecryptFailureBlock)failureBlock;
 
+// Writes the sessions advanced by decrypting to the keys database. See -[TSStorageManager flushDirtySessions].
+- (void)flushDirtySessions;
+
 @end
 
 NS_ASSUME_NONNULL_END
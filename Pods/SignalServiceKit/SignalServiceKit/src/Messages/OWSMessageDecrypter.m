@@ -88,6 +88,11 @@ NS_ASSUME_NONNULL_BEGIN
 
 #pragma mark - Decryption
 
+- (void)flushDirtySessions
+{
+    [self.storageManager flushDirtySessions];
+}
+
 - (void)decryptEnvelope:(OWSSignalServiceProtosEnvelope *)envelope
            successBlock:(DecryptSuccessBlock)successBlockParameter
            failureBlock:(DecryptFailureBlock)failureBlockParameter
@@ -234,7 +239,7 @@ NS_ASSUME_NONNULL_BEGIN
         return;
     }
 
-    dispatch_async([OWSDispatch sessionStoreQueue], ^{
+    dispatch_async([OWSDispatch sessionStoreQueueForRecipientId:recipientId], ^{
         @try {
             id<CipherMessage> cipherMessage = cipherMessageBlock(encryptedData);
             SessionCipher *cipher = [[SessionCipher alloc] initWithSessionStore:storageManager
@@ -676,7 +676,7 @@ NS_ASSUME_NONNULL_BEGIN
                                      inThread:thread
                                   messageType:TSInfoMessageTypeSessionDidEnd] saveWithTransaction:transaction];
 
-    dispatch_async([OWSDispatch sessionStoreQueue], ^{
+    dispatch_async([OWSDispatch sessionStoreQueueForRecipientId:envelope.source], ^{
         [self.storageManager deleteAllSessionsForContact:envelope.source];
     });
 }
@@ -6,6 +6,31 @@ NS_ASSUME_NONNULL_BEGIN
 
 @class OWSSignalServiceProtosEnvelope;
 @class YapDatabase;
+@class YapDatabaseConnection;
+@class YapDatabaseReadWriteTransaction;
+
+// What the receiver needs from OWSMessageDecrypter.
+@protocol OWSMessageReceiverDecrypter <NSObject>
+
+// successBlock & failureBlock may be called on any thread. Exactly one of them is called, once.
+- (void)decryptEnvelope:(OWSSignalServiceProtosEnvelope *)envelope
+           successBlock:(void (^)(NSData *_Nullable plaintextData))successBlock
+           failureBlock:(void (^)())failureBlock;
+
+// Makes the sessions advanced by every envelope decrypted so far durable.
+- (void)flushDirtySessions;
+
+@end
+
+// What the receiver needs from OWSBatchMessageProcessor.
+@protocol OWSMessageReceiverProcessor <NSObject>
+
+- (void)enqueueEnvelopeData:(NSData *)envelopeData
+              plaintextData:(NSData *_Nullable)plaintextData
+                transaction:(YapDatabaseReadWriteTransaction *)transaction;
+- (void)handleAnyUnprocessedEnvelopesAsync;
+
+@end
 
 // This class is used to write incoming (encrypted, unprocessed)
 // messages to a durable queue and then decrypt them in the order
@@ -16,6 +41,13 @@ NS_ASSUME_NONNULL_BEGIN
 + (instancetype)sharedInstance;
 + (void)syncRegisterDatabaseExtension:(YapDatabase *)database;
 
+// Only the shared instance may be used with the shared database. Other instances, like the benchmarks',
+// are bound to a database of their own, which must have had the receiver's extension registered.
+- (instancetype)initWithDBConnection:(YapDatabaseConnection *)dbConnection
+                    messageDecrypter:(id<OWSMessageReceiverDecrypter>)messageDecrypter
+               batchMessageProcessor:(id<OWSMessageReceiverProcessor>)batchMessageProcessor NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
 - (void)handleReceivedEnvelope:(OWSSignalServiceProtosEnvelope *)envelope;
 - (void)handleAnyUnprocessedEnvelopesAsync;
 
@@ -91,8 +91,6 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
 
 - (instancetype)initWithDBConnection:(YapDatabaseConnection *)dbConnection
 {
-    OWSSingletonAssert();
-
     self = [super init];
     if (!self) {
         return self;
@@ -105,16 +103,50 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
     return self;
 }
 
-- (OWSMessageDecryptJob *_Nullable)nextJob
+- (NSArray<OWSMessageDecryptJob *> *)nextJobsForBatchSize:(NSUInteger)maxBatchSize
+                                           excludingJobIds:(NSSet<NSString *> *)excludedJobIds
 {
-    __block OWSMessageDecryptJob *_Nullable job = nil;
+    NSMutableArray<OWSMessageDecryptJob *> *jobs = [NSMutableArray new];
     [self.dbConnection readWithBlock:^(YapDatabaseReadTransaction *_Nonnull transaction) {
         YapDatabaseViewTransaction *viewTransaction = [transaction ext:OWSMessageDecryptJobFinderExtensionName];
         OWSAssert(viewTransaction != nil);
-        job = [viewTransaction firstObjectInGroup:OWSMessageDecryptJobFinderExtensionGroup];
+        [viewTransaction enumerateKeysInGroup:OWSMessageDecryptJobFinderExtensionGroup
+                                   usingBlock:^(NSString *_Nonnull collection,
+                                                NSString *_Nonnull key,
+                                                NSUInteger index,
+                                                BOOL *_Nonnull stop) {
+                                       // Jobs which are still being decrypted (or whose results haven't
+                                       // been committed yet) remain at the head of the view.
+                                       if ([excludedJobIds containsObject:key]) {
+                                           return;
+                                       }
+                                       OWSMessageDecryptJob *_Nullable job =
+                                           [transaction objectForKey:key inCollection:collection];
+                                       if (!job) {
+                                           OWSFail(@"Missing job for key: %@", key);
+                                           return;
+                                       }
+                                       [jobs addObject:job];
+                                       if (jobs.count >= maxBatchSize) {
+                                           *stop = YES;
+                                       }
+                                   }];
     }];
 
-    return job;
+    return [jobs copy];
+}
+
+- (BOOL)isReadyToDrain
+{
+    YapDatabase *database = self.dbConnection.database;
+    if (database == [TSStorageManager sharedManager].database) {
+        // We don't want to process incoming messages until database
+        // view registration is complete.
+        return ![TSDatabaseView hasPendingViewRegistrations];
+    }
+
+    // Registration is only tracked for the shared database; elsewhere, our view is all we need.
+    return [database registeredExtension:OWSMessageDecryptJobFinderExtensionName] != nil;
 }
 
 - (void)addJobForEnvelope:(OWSSignalServiceProtosEnvelope *)envelope
@@ -124,11 +156,9 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
     }];
 }
 
-- (void)removeJobWithId:(NSString *)uniqueId
+- (void)removeJobsWithIds:(NSArray<NSString *> *)uniqueIds transaction:(YapDatabaseReadWriteTransaction *)transaction
 {
-    [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
-        [transaction removeObjectForKey:uniqueId inCollection:[OWSMessageDecryptJob collection]];
-    }];
+    [transaction removeObjectsForKeys:uniqueIds inCollection:[OWSMessageDecryptJob collection]];
 }
 
 + (YapDatabaseView *)databaseExtension
@@ -205,15 +235,78 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
 
 #pragma mark - Queue Processing
 
+// A job read from the finder, and the outcome of decrypting it.
+@interface OWSMessageDecryptTask : NSObject
+
+@property (nonatomic, readonly) OWSMessageDecryptJob *job;
+@property (nonatomic, readonly) OWSSignalServiceProtosEnvelope *envelope;
+// The sender device, whose envelopes must be decrypted in the order they were received.
+@property (nonatomic, readonly) NSString *senderKey;
+
+// These properties are set on the task's shard queue.
+@property (nonatomic) BOOL success;
+@property (nonatomic, nullable) NSData *plaintextData;
+
+- (instancetype)initWithJob:(OWSMessageDecryptJob *)job NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+#pragma mark -
+
+@implementation OWSMessageDecryptTask
+
+- (instancetype)initWithJob:(OWSMessageDecryptJob *)job
+{
+    OWSAssert(job);
+
+    self = [super init];
+    if (!self) {
+        return self;
+    }
+
+    _job = job;
+    _envelope = job.envelopeProto;
+    _senderKey = [NSString stringWithFormat:@"%@.%u", _envelope.source, (unsigned int)_envelope.sourceDevice];
+
+    return self;
+}
+
+@end
+
+#pragma mark -
+
+// Jobs are decrypted in rounds, on a fixed set of serial "shard" queues.
+//
+// The ratchet only requires that messages from a given sender device be
+// decrypted in the order they were received, so each round takes the oldest
+// pending job of up to kMaxRoundJobCount different senders, and jobs are
+// assigned to a shard by (recipientId, deviceId) so that different senders
+// are decrypted concurrently.
+//
+// Once every job in a round has been decrypted, the round is committed: the
+// sessions are flushed once, and the plaintexts are persisted for the batch
+// processor in the same write transaction that removes the decrypt jobs. The
+// next round, which may hold the same senders' next envelopes, only starts
+// after that, so nothing is decrypted ahead of a commit from the same sender.
 @interface OWSMessageDecryptQueue : NSObject
 
-@property (nonatomic, readonly) OWSMessageDecrypter *messageDecrypter;
-@property (nonatomic, readonly) OWSBatchMessageProcessor *batchMessageProcessor;
+@property (nonatomic, readonly) id<OWSMessageReceiverDecrypter> messageDecrypter;
+@property (nonatomic, readonly) id<OWSMessageReceiverProcessor> batchMessageProcessor;
 @property (nonatomic, readonly) OWSMessageDecryptJobFinder *finder;
 @property (nonatomic) BOOL isDrainingQueue;
 
-- (instancetype)initWithMessageDecrypter:(OWSMessageDecrypter *)messageDecrypter
-                   batchMessageProcessor:(OWSBatchMessageProcessor *)batchMessageProcessor
+// These properties should only be accessed on the serialQueue.
+//
+// The jobs read from the finder that haven't been handed to a shard queue yet, in the order they were received.
+@property (nonatomic, readonly) NSMutableArray<OWSMessageDecryptTask *> *pendingTasks;
+// The ids of the pending jobs and of the jobs in the current round.
+@property (nonatomic, readonly) NSMutableSet<NSString *> *pendingJobIds;
+
+@property (nonatomic, readonly) NSArray<dispatch_queue_t> *shardQueues;
+
+- (instancetype)initWithMessageDecrypter:(id<OWSMessageReceiverDecrypter>)messageDecrypter
+                   batchMessageProcessor:(id<OWSMessageReceiverProcessor>)batchMessageProcessor
                                   finder:(OWSMessageDecryptJobFinder *)finder NS_DESIGNATED_INITIALIZER;
 - (instancetype)init NS_UNAVAILABLE;
 
@@ -223,12 +316,10 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
 
 @implementation OWSMessageDecryptQueue
 
-- (instancetype)initWithMessageDecrypter:(OWSMessageDecrypter *)messageDecrypter
-                   batchMessageProcessor:(OWSBatchMessageProcessor *)batchMessageProcessor
+- (instancetype)initWithMessageDecrypter:(id<OWSMessageReceiverDecrypter>)messageDecrypter
+                   batchMessageProcessor:(id<OWSMessageReceiverProcessor>)batchMessageProcessor
                                   finder:(OWSMessageDecryptJobFinder *)finder
 {
-    OWSSingletonAssert();
-
     self = [super init];
     if (!self) {
         return self;
@@ -238,6 +329,15 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
     _batchMessageProcessor = batchMessageProcessor;
     _finder = finder;
     _isDrainingQueue = NO;
+    _pendingTasks = [NSMutableArray new];
+    _pendingJobIds = [NSMutableSet new];
+
+    NSMutableArray<dispatch_queue_t> *shardQueues = [NSMutableArray new];
+    for (NSUInteger i = 0; i < self.class.shardCount; i++) {
+        NSString *label = [NSString stringWithFormat:@"org.whispersystems.message.decrypt.shard.%lu", (unsigned long)i];
+        [shardQueues addObject:dispatch_queue_create(label.UTF8String, DISPATCH_QUEUE_SERIAL)];
+    }
+    _shardQueues = [shardQueues copy];
 
     [[NSNotificationCenter defaultCenter] addObserver:self
                                              selector:@selector(databaseViewRegistrationComplete)
@@ -257,6 +357,14 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
     [self drainQueue];
 }
 
+#pragma mark - class methods
+
++ (NSUInteger)shardCount
+{
+    // Decryption is CPU-bound, so there's no benefit to having more shards than cores.
+    return MAX((NSUInteger)2, MIN((NSUInteger)4, [NSProcessInfo processInfo].activeProcessorCount));
+}
+
 #pragma mark - instance methods
 
 - (dispatch_queue_t)serialQueue
@@ -269,6 +377,11 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
     return queue;
 }
 
+- (dispatch_queue_t)shardQueueForTask:(OWSMessageDecryptTask *)task
+{
+    return self.shardQueues[task.senderKey.hash % self.shardQueues.count];
+}
+
 - (void)enqueueEnvelopeForProcessing:(OWSSignalServiceProtosEnvelope *)envelope
 {
     [self.finder addJobForEnvelope:envelope];
@@ -277,9 +390,7 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
 - (void)drainQueue
 {
     dispatch_async(self.serialQueue, ^{
-        if ([TSDatabaseView hasPendingViewRegistrations]) {
-            // We don't want to process incoming messages until database
-            // view registration is complete.
+        if (![self.finder isReadyToDrain]) {
             return;
         }
 
@@ -296,46 +407,124 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
 {
     AssertOnDispatchQueue(self.serialQueue);
 
-    OWSMessageDecryptJob *_Nullable job = [self.finder nextJob];
-    if (!job) {
+    // Each round is committed in one write transaction, so we want rounds large
+    // enough to amortize it, but no larger than a transaction we'd want to redo.
+    const NSUInteger kMaxRoundJobCount = 32;
+    // We read ahead so that a round can find other senders behind a run of
+    // envelopes from the same sender.
+    const NSUInteger kMaxPendingJobCount = 256;
+
+    if (self.pendingTasks.count < kMaxRoundJobCount) {
+        NSArray<OWSMessageDecryptJob *> *jobs =
+            [self.finder nextJobsForBatchSize:kMaxPendingJobCount - self.pendingTasks.count
+                              excludingJobIds:self.pendingJobIds];
+        for (OWSMessageDecryptJob *job in jobs) {
+            [self.pendingTasks addObject:[[OWSMessageDecryptTask alloc] initWithJob:job]];
+            [self.pendingJobIds addObject:job.uniqueId];
+        }
+    }
+    if (self.pendingTasks.count < 1) {
         self.isDrainingQueue = NO;
         DDLogVerbose(@"%@ Queue is drained.", self.tag);
         return;
     }
 
-    [self processJob:job
-          completion:^(BOOL success) {
-              [self.finder removeJobWithId:job.uniqueId];
-              DDLogVerbose(@"%@ %@ job. %lu jobs left.",
-                           self.tag,
-                           success ? @"decrypted" : @"failed to decrypt",
-                           (unsigned long)[OWSMessageDecryptJob numberOfKeysInCollection]);
-              [self drainQueueWorkStep];
-          }];
+    // Take the oldest pending job of each sender.
+    NSMutableArray<OWSMessageDecryptTask *> *tasks = [NSMutableArray new];
+    NSMutableSet<NSString *> *senderKeys = [NSMutableSet new];
+    NSMutableIndexSet *taskIndexes = [NSMutableIndexSet new];
+    [self.pendingTasks enumerateObjectsUsingBlock:^(OWSMessageDecryptTask *task, NSUInteger index, BOOL *stop) {
+        if ([senderKeys containsObject:task.senderKey]) {
+            return;
+        }
+        [senderKeys addObject:task.senderKey];
+        [taskIndexes addIndex:index];
+        [tasks addObject:task];
+        if (tasks.count >= kMaxRoundJobCount) {
+            *stop = YES;
+        }
+    }];
+    [self.pendingTasks removeObjectsAtIndexes:taskIndexes];
+
+    [self processTasks:tasks];
 }
 
-- (void)processJob:(OWSMessageDecryptJob *)job completion:(void (^)(BOOL))completion
+- (void)processTasks:(NSArray<OWSMessageDecryptTask *> *)tasks
 {
     AssertOnDispatchQueue(self.serialQueue);
-    OWSAssert(job);
+    OWSAssert(tasks.count > 0);
+
+    dispatch_group_t group = dispatch_group_create();
+    for (OWSMessageDecryptTask *task in tasks) {
+        dispatch_group_enter(group);
+        dispatch_async([self shardQueueForTask:task], ^{
+            // Block this shard until the job has been decrypted so that each
+            // shard decrypts one job at a time.
+            dispatch_semaphore_t sema = dispatch_semaphore_create(0);
+            [self.messageDecrypter decryptEnvelope:task.envelope
+                                      successBlock:^(NSData *_Nullable plaintextData) {
+                                          task.success = YES;
+                                          task.plaintextData = plaintextData;
+                                          dispatch_semaphore_signal(sema);
+                                      }
+                                      failureBlock:^{
+                                          dispatch_semaphore_signal(sema);
+                                      }];
+            dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
+            dispatch_group_leave(group);
+        });
+    }
+
+    dispatch_group_notify(group, self.serialQueue, ^{
+        [self commitTasks:tasks];
+    });
+}
+
+- (void)commitTasks:(NSArray<OWSMessageDecryptTask *> *)tasks
+{
+    AssertOnDispatchQueue(self.serialQueue);
+
+    // Decrypting has already advanced the senders' sessions, so the envelopes can't be decrypted again and we need to
+    // persist the plaintexts ASAP to prevent data loss. The sessions live in the keys database and can't share the
+    // transaction below, so they are made durable first: once the jobs are removed, nothing would repair them.
+    [self.messageDecrypter flushDirtySessions];
+
+    NSMutableArray<NSString *> *jobIds = [NSMutableArray new];
+    NSUInteger decryptedJobCount = 0;
+    for (OWSMessageDecryptTask *task in tasks) {
+        [jobIds addObject:task.job.uniqueId];
+        if (task.success) {
+            decryptedJobCount++;
+        }
+    }
 
-    OWSSignalServiceProtosEnvelope *envelope = job.envelopeProto;
-    [self.messageDecrypter decryptEnvelope:envelope
-                              successBlock:^(NSData *_Nullable plaintextData) {
+    [self.finder.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
+        for (OWSMessageDecryptTask *task in tasks) {
+            if (task.success) {
+                [self.batchMessageProcessor enqueueEnvelopeData:task.job.envelopeData
+                                                  plaintextData:task.plaintextData
+                                                    transaction:transaction];
+            }
+        }
+        [self.finder removeJobsWithIds:jobIds transaction:transaction];
+    }];
+
+    for (NSString *jobId in jobIds) {
+        OWSAssert([self.pendingJobIds containsObject:jobId]);
+        [self.pendingJobIds removeObject:jobId];
+    }
+
+    DDLogVerbose(@"%@ decrypted %lu of %lu jobs. %lu jobs read ahead.",
+        self.tag,
+        (unsigned long)decryptedJobCount,
+        (unsigned long)tasks.count,
+        (unsigned long)self.pendingTasks.count);
 
-                                  // We can't decrypt the same message twice, so we need to persist
-                                  // the decrypted envelope data ASAP to prevent data loss.
-                                  [self.batchMessageProcessor enqueueEnvelopeData:job.envelopeData plaintextData:plaintextData];
+    if (decryptedJobCount > 0) {
+        [self.batchMessageProcessor handleAnyUnprocessedEnvelopesAsync];
+    }
 
-                                  dispatch_async(self.serialQueue, ^{
-                                      completion(YES);
-                                  });
-                              }
-                              failureBlock:^{
-                                  dispatch_async(self.serialQueue, ^{
-                                      completion(NO);
-                                  });
-                              }];
+    [self drainQueueWorkStep];
 }
 
 #pragma mark Logging
@@ -366,11 +555,9 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
 @implementation OWSMessageReceiver
 
 - (instancetype)initWithDBConnection:(YapDatabaseConnection *)dbConnection
-                    messageDecrypter:(OWSMessageDecrypter *)messageDecrypter
-               batchMessageProcessor:(OWSBatchMessageProcessor *)batchMessageProcessor
+                    messageDecrypter:(id<OWSMessageReceiverDecrypter>)messageDecrypter
+               batchMessageProcessor:(id<OWSMessageReceiverProcessor>)batchMessageProcessor
 {
-    OWSSingletonAssert();
-
     self = [super init];
     if (!self) {
         return self;
@@ -389,6 +576,9 @@ NSString *const OWSMessageDecryptJobFinderExtensionGroup = @"OWSMessageProcessin
 
 - (instancetype)initDefault
 {
+    // Only one receiver may drain the shared database's jobs.
+    OWSSingletonAssert();
+
     // For concurrency coherency we use the same dbConnection to persist and read the unprocessed envelopes
     YapDatabaseConnection *dbConnection = [[TSStorageManager sharedManager].database newConnection];
     OWSMessageDecrypter *messageDecrypter = [OWSMessageDecrypter sharedManager];
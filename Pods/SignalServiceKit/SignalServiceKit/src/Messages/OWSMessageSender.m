@@ -33,6 +33,8 @@
 #import "TSStorageManager.h"
 #import "TSThread.h"
 #import "Threading.h"
+#import <25519/Curve25519.h>
+#import <25519/Ed25519.h>
 #import <AxolotlKit/AxolotlExceptions.h>
 #import <AxolotlKit/CipherMessage.h>
 #import <AxolotlKit/PreKeyBundle.h>
@@ -43,6 +45,22 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+typedef NSArray<NSDictionary *> *_Nonnull (^OWSDeviceMessagesBlock)(void);
+
+// The prekey bundle of a device without a session, fetched before a group message is encrypted for it so that the
+// signatures of every recipient's bundles are verified in one batch; or the exception fetching it threw.
+@interface OWSPrefetchedPreKeyBundle : NSObject
+
+@property (nonatomic, nullable) PreKeyBundle *bundle;
+@property (nonatomic, nullable) NSException *exception;
+@property (nonatomic) BOOL isSignatureVerified;
+
+@end
+
+@implementation OWSPrefetchedPreKeyBundle
+
+@end
+
 void AssertIsOnSendingQueue()
 {
 #ifdef DEBUG
@@ -706,21 +724,23 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
 - (TOCFuture *)sendMessageFuture:(TSOutgoingMessage *)message
                        recipient:(SignalRecipient *)recipient
                           thread:(TSThread *)thread
+             deviceMessagesBlock:(nullable OWSDeviceMessagesBlock)deviceMessagesBlock
 {
     TOCFutureSource *futureSource = [[TOCFutureSource alloc] init];
 
     [self sendMessage:message
-            recipient:recipient
-               thread:thread
-             attempts:OWSMessageSenderRetryAttempts
-              success:^{
-                  DDLogInfo(@"%@ Marking group message as sent to recipient: %@", self.tag, recipient.uniqueId);
-                  [message updateWithSentRecipient:recipient.uniqueId];
-                  [futureSource trySetResult:@1];
-              }
-              failure:^(NSError *error) {
-                  [futureSource trySetFailure:error];
-              }];
+                  recipient:recipient
+                     thread:thread
+                   attempts:OWSMessageSenderRetryAttempts
+        deviceMessagesBlock:deviceMessagesBlock
+                    success:^{
+                        DDLogInfo(@"%@ Marking group message as sent to recipient: %@", self.tag, recipient.uniqueId);
+                        [message updateWithSentRecipient:recipient.uniqueId];
+                        [futureSource trySetResult:@1];
+                    }
+                    failure:^(NSError *error) {
+                        [futureSource trySetFailure:error];
+                    }];
 
     return futureSource.future;
 }
@@ -732,7 +752,7 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
           failure:(RetryableFailureHandler)failureHandler
 {
     [self saveGroupMessage:message inThread:thread];
-    NSMutableArray<TOCFuture *> *futures = [NSMutableArray array];
+    NSMutableArray<SignalRecipient *> *recipientsToSend = [NSMutableArray array];
 
     for (SignalRecipient *recipient in recipients) {
         NSString *recipientId = recipient.recipientId;
@@ -754,7 +774,18 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
         }
 
         // ...otherwise we send.
-        [futures addObject:[self sendMessageFuture:message recipient:recipient thread:thread]];
+        [recipientsToSend addObject:recipient];
+    }
+
+    NSDictionary<NSString *, OWSDeviceMessagesBlock> *deviceMessagesBlocks =
+        [self deviceMessagesBlocks:message forRecipients:recipientsToSend];
+
+    NSMutableArray<TOCFuture *> *futures = [NSMutableArray array];
+    for (SignalRecipient *recipient in recipientsToSend) {
+        [futures addObject:[self sendMessageFuture:message
+                                         recipient:recipient
+                                            thread:thread
+                               deviceMessagesBlock:deviceMessagesBlocks[recipient.uniqueId]]];
     }
 
     TOCFuture *completionFuture = futures.toc_thenAll;
@@ -843,6 +874,25 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
            attempts:(int)remainingAttempts
             success:(void (^)())successHandler
             failure:(RetryableFailureHandler)failureHandler
+{
+    [self sendMessage:message
+                  recipient:recipient
+                     thread:thread
+                   attempts:remainingAttempts
+        deviceMessagesBlock:nil
+                    success:successHandler
+                    failure:failureHandler];
+}
+
+// deviceMessagesBlock, if any, returns (or throws) the result of encrypting the message for the recipient ahead of
+// time. It's only used for this attempt; any retries encrypt the message again.
+- (void)sendMessage:(TSOutgoingMessage *)message
+              recipient:(SignalRecipient *)recipient
+                 thread:(TSThread *)thread
+               attempts:(int)remainingAttempts
+    deviceMessagesBlock:(nullable OWSDeviceMessagesBlock)deviceMessagesBlock
+                success:(void (^)())successHandler
+                failure:(RetryableFailureHandler)failureHandler
 {
     DDLogInfo(@"%@ attempting to send message: %@, timestamp: %llu, recipient: %@",
               self.tag,
@@ -884,7 +934,8 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
 
     NSArray<NSDictionary *> *deviceMessages;
     @try {
-        deviceMessages = [self deviceMessages:message forRecipient:recipient];
+        deviceMessages
+            = deviceMessagesBlock ? deviceMessagesBlock() : [self deviceMessages:message forRecipient:recipient];
     } @catch (NSException *exception) {
         deviceMessages = @[];
         if ([exception.name isEqualToString:UntrustedIdentityKeyException]) {
@@ -962,6 +1013,9 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
         }
     }
 
+    // The recipient's sessions must be durable before a message encrypted with them leaves the device.
+    [self.storageManager flushDirtySessions];
+
     TSSubmitMessageRequest *request = [[TSSubmitMessageRequest alloc] initWithRecipient:recipient.uniqueId
                                                                                messages:deviceMessages
                                                                                   relay:recipient.relay
@@ -1069,7 +1123,7 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
     NSArray *extraDevices = [dictionary objectForKey:@"extraDevices"];
     NSArray *missingDevices = [dictionary objectForKey:@"missingDevices"];
 
-    dispatch_async([OWSDispatch sessionStoreQueue], ^{
+    dispatch_async([OWSDispatch sessionStoreQueueForRecipientId:recipient.uniqueId], ^{
         if (extraDevices.count < 1 && missingDevices.count < 1) {
             OWSProdFail([OWSAnalyticsEvents messageSenderErrorNoMissingOrExtraDevices]);
         }
@@ -1170,34 +1224,194 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
     OWSAssert(message);
     OWSAssert(recipient);
 
-    NSMutableArray *messagesArray = [NSMutableArray arrayWithCapacity:recipient.devices.count];
-
     NSData *plainText = [message buildPlainTextData:recipient];
     DDLogDebug(@"%@ built message: %@ plainTextData.length: %lu", self.tag, [message class], (unsigned long)plainText.length);
 
-    for (NSNumber *deviceNumber in recipient.devices) {
+    __block NSArray<NSDictionary *> *messages;
+    __block NSException *encryptionException;
+    // Mutating session state is not thread safe, so we operate on the recipient's serial queue, shared with
+    // decryption operations.
+    dispatch_sync([OWSDispatch sessionStoreQueueForRecipientId:recipient.uniqueId], ^{
         @try {
-            __block NSDictionary *messageDict;
-            __block NSException *encryptionException;
-            // Mutating session state is not thread safe, so we operate on a serial queue, shared with decryption
-            // operations.
-            dispatch_sync([OWSDispatch sessionStoreQueue], ^{
+            messages = [self deviceMessagesWithPlainText:plainText
+                                            forRecipient:recipient
+                                                isSilent:message.isSilent
+                                       prefetchedBundles:nil];
+        } @catch (NSException *exception) {
+            encryptionException = exception;
+        }
+    });
+
+    if (encryptionException) {
+        DDLogInfo(@"%@ Exception during encryption: %@", self.tag, encryptionException);
+        @throw encryptionException;
+    }
+
+    return messages;
+}
+
+// Encrypts the message for every recipient at once, each on its own session store queue, so that a group send
+// isn't limited to one core. Returns a block per recipient, which returns that recipient's device messages, or
+// throws whatever encrypting them threw.
+- (NSDictionary<NSString *, OWSDeviceMessagesBlock> *)deviceMessagesBlocks:(TSOutgoingMessage *)message
+                                                             forRecipients:(NSArray<SignalRecipient *> *)recipients
+{
+    OWSAssert(message);
+    AssertIsOnSendingQueue();
+
+    if (recipients.count < 2 || [TSPreKeyManager isAppLockedDueToPreKeyUpdateFailures]) {
+        // Nothing to parallelize, or nothing will be sent; sendMessage: encrypts as usual.
+        return @{};
+    }
+
+    NSDictionary<NSString *, NSDictionary<NSNumber *, OWSPrefetchedPreKeyBundle *> *> *prefetchedBundles =
+        [self prefetchedPreKeyBundlesForRecipients:recipients];
+
+    NSMutableDictionary<NSString *, OWSDeviceMessagesBlock> *deviceMessagesBlocks = [NSMutableDictionary new];
+    dispatch_group_t group = dispatch_group_create();
+    BOOL isSilent = message.isSilent;
+
+    for (SignalRecipient *recipient in recipients) {
+        NSData *plainText = [message buildPlainTextData:recipient];
+        NSDictionary<NSNumber *, OWSPrefetchedPreKeyBundle *> *recipientBundles = prefetchedBundles[recipient.uniqueId];
+
+        dispatch_group_async(group, [OWSDispatch sessionStoreQueueForRecipientId:recipient.uniqueId], ^{
+            OWSDeviceMessagesBlock deviceMessagesBlock;
+            @try {
+                NSArray<NSDictionary *> *messages = [self deviceMessagesWithPlainText:plainText
+                                                                         forRecipient:recipient
+                                                                             isSilent:isSilent
+                                                                    prefetchedBundles:recipientBundles];
+                deviceMessagesBlock = ^{
+                    return messages;
+                };
+            } @catch (NSException *exception) {
+                DDLogInfo(@"%@ Exception during encryption: %@", self.tag, exception);
+                deviceMessagesBlock = ^NSArray<NSDictionary *> *{
+                    @throw exception;
+                };
+            }
+
+            @synchronized(deviceMessagesBlocks)
+            {
+                deviceMessagesBlocks[recipient.uniqueId] = deviceMessagesBlock;
+            }
+        });
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+
+    // Writes the sessions of every recipient in one transaction, leaving nothing for each send to flush.
+    [self.storageManager flushDirtySessions];
+
+    return [deviceMessagesBlocks copy];
+}
+
+// Fetches the prekey bundles of the recipients' devices which have no session yet, each recipient on its own session
+// store queue, then verifies all of their signatures in one batch. Fetching stops at a recipient's first failure, like
+// encrypting does, and the exception is rethrown when the message is encrypted for that device.
+- (NSDictionary<NSString *, NSDictionary<NSNumber *, OWSPrefetchedPreKeyBundle *> *> *)
+    prefetchedPreKeyBundlesForRecipients:(NSArray<SignalRecipient *> *)recipients
+{
+    NSMutableDictionary<NSString *, NSDictionary<NSNumber *, OWSPrefetchedPreKeyBundle *> *> *prefetchedBundles =
+        [NSMutableDictionary new];
+    dispatch_group_t group = dispatch_group_create();
+
+    for (SignalRecipient *recipient in recipients) {
+        dispatch_group_async(group, [OWSDispatch sessionStoreQueueForRecipientId:recipient.uniqueId], ^{
+            NSMutableDictionary<NSNumber *, OWSPrefetchedPreKeyBundle *> *recipientBundles = [NSMutableDictionary new];
+
+            for (NSNumber *deviceNumber in recipient.devices) {
+                if ([self.storageManager containsSession:recipient.uniqueId deviceId:[deviceNumber intValue]]) {
+                    continue;
+                }
+
+                OWSPrefetchedPreKeyBundle *prefetchedBundle = [OWSPrefetchedPreKeyBundle new];
+                recipientBundles[deviceNumber] = prefetchedBundle;
                 @try {
-                    messageDict = [self encryptedMessageWithPlaintext:plainText
-                                                          toRecipient:recipient.uniqueId
-                                                             deviceId:deviceNumber
-                                                        keyingStorage:self.storageManager
-                                                             isSilent:message.isSilent];
+                    prefetchedBundle.bundle = [self preKeyBundleForRecipient:recipient.uniqueId deviceId:deviceNumber];
                 } @catch (NSException *exception) {
-                    encryptionException = exception;
+                    prefetchedBundle.exception = exception;
+                    if (![exception.name isEqualToString:OWSMessageSenderInvalidDeviceException]) {
+                        break;
+                    }
                 }
-            });
+            }
+
+            @synchronized(prefetchedBundles)
+            {
+                prefetchedBundles[recipient.uniqueId] = [recipientBundles copy];
+            }
+        });
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
 
-            if (encryptionException) {
-                DDLogInfo(@"%@ Exception during encryption: %@", self.tag, encryptionException);
-                @throw encryptionException;
+    NSMutableArray<OWSPrefetchedPreKeyBundle *> *batch = [NSMutableArray new];
+    NSMutableArray<NSData *> *signatures = [NSMutableArray new];
+    NSMutableArray<NSData *> *identityKeys = [NSMutableArray new];
+    NSMutableArray<NSData *> *signedPreKeys = [NSMutableArray new];
+
+    for (NSDictionary<NSNumber *, OWSPrefetchedPreKeyBundle *> *recipientBundles in prefetchedBundles.allValues) {
+        for (OWSPrefetchedPreKeyBundle *prefetchedBundle in recipientBundles.allValues) {
+            PreKeyBundle *_Nullable bundle = prefetchedBundle.bundle;
+            if (!bundle) {
+                continue;
+            }
+
+            // Malformed bundles are left to processPrekeyBundle:, which throws the usual exceptions for them.
+            NSData *identityKey;
+            @try {
+                identityKey = [bundle.identityKey removeKeyType];
+            } @catch (NSException *exception) {
+                continue;
+            }
+            if (identityKey.length != ECCKeyLength || bundle.signedPreKeySignature.length != ECCSignatureLength
+                || bundle.signedPreKeyPublic.length < 1) {
+                continue;
             }
 
+            [batch addObject:prefetchedBundle];
+            [signatures addObject:bundle.signedPreKeySignature];
+            [identityKeys addObject:identityKey];
+            [signedPreKeys addObject:bundle.signedPreKeyPublic];
+        }
+    }
+
+    if (batch.count > 0) {
+        NSIndexSet *invalidIndexes =
+            [Ed25519 indexesOfInvalidSignatures:signatures publicKeys:identityKeys data:signedPreKeys];
+
+        // Bundles with a bad signature are checked again, and rejected, when they're processed.
+        [batch enumerateObjectsUsingBlock:^(OWSPrefetchedPreKeyBundle *prefetchedBundle, NSUInteger index, BOOL *stop) {
+            prefetchedBundle.isSignatureVerified = ![invalidIndexes containsIndex:index];
+        }];
+    }
+
+    return [prefetchedBundles copy];
+}
+
+// Must be called on the recipient's session store queue.
+- (NSArray<NSDictionary *> *)deviceMessagesWithPlainText:(NSData *)plainText
+                                            forRecipient:(SignalRecipient *)recipient
+                                                isSilent:(BOOL)isSilent
+                                       prefetchedBundles:
+                                           (nullable NSDictionary<NSNumber *, OWSPrefetchedPreKeyBundle *> *)prefetchedBundles
+{
+    OWSAssert(plainText);
+    OWSAssert(recipient);
+
+    NSMutableArray *messagesArray = [NSMutableArray arrayWithCapacity:recipient.devices.count];
+
+    for (NSNumber *deviceNumber in recipient.devices) {
+        @try {
+            NSDictionary *messageDict = [self encryptedMessageWithPlaintext:plainText
+                                                                toRecipient:recipient.uniqueId
+                                                                   deviceId:deviceNumber
+                                                              keyingStorage:self.storageManager
+                                                                   isSilent:isSilent
+                                                           prefetchedBundle:prefetchedBundles[deviceNumber]];
+
             if (messageDict) {
                 [messagesArray addObject:messageDict];
             } else {
@@ -1217,11 +1431,60 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
     return [messagesArray copy];
 }
 
+// Fetches the prekey bundle of a recipient's device from the service, or throws.
+- (PreKeyBundle *)preKeyBundleForRecipient:(NSString *)identifier deviceId:(NSNumber *)deviceNumber
+{
+    OWSAssert(identifier.length > 0);
+    OWSAssert(deviceNumber);
+
+    __block dispatch_semaphore_t sema = dispatch_semaphore_create(0);
+    __block PreKeyBundle *_Nullable bundle;
+    __block NSException *_Nullable exception;
+    [self.networkManager makeRequest:[[TSRecipientPrekeyRequest alloc] initWithRecipient:identifier
+                                                                                deviceId:[deviceNumber stringValue]]
+                             success:^(NSURLSessionDataTask *task, id responseObject) {
+                                 bundle = [PreKeyBundle preKeyBundleFromDictionary:responseObject forDeviceNumber:deviceNumber];
+                                 dispatch_semaphore_signal(sema);
+                             }
+                             failure:^(NSURLSessionDataTask *task, NSError *error) {
+                                 if (!IsNSErrorNetworkFailure(error)) {
+                                     OWSProdError([OWSAnalyticsEvents messageSenderErrorRecipientPrekeyRequestFailed]);
+                                 }
+                                 DDLogError(@"Server replied to PreKeyBundle request with error: %@", error);
+                                 NSHTTPURLResponse *response = (NSHTTPURLResponse *)task.response;
+                                 if (response.statusCode == 404) {
+                                     // Can't throw exception from within callback as it's probabably a different thread.
+                                     exception = [NSException exceptionWithName:OWSMessageSenderInvalidDeviceException
+                                                                         reason:@"Device not registered"
+                                                                       userInfo:nil];
+                                 } else if (response.statusCode == 413) {
+                                     // Can't throw exception from within callback as it's probabably a different thread.
+                                     exception = [NSException exceptionWithName:OWSMessageSenderRateLimitedException
+                                                                         reason:@"Too many prekey requests"
+                                                                       userInfo:nil];
+                                 }
+                                 dispatch_semaphore_signal(sema);
+                             }];
+    dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
+    if (exception) {
+        @throw exception;
+    }
+
+    if (!bundle) {
+        @throw [NSException exceptionWithName:InvalidVersionException
+                                       reason:@"Can't get a prekey bundle from the server with required information"
+                                     userInfo:nil];
+    }
+
+    return bundle;
+}
+
 - (NSDictionary *)encryptedMessageWithPlaintext:(NSData *)plainText
                                     toRecipient:(NSString *)identifier
                                        deviceId:(NSNumber *)deviceNumber
                                   keyingStorage:(TSStorageManager *)storage
                                        isSilent:(BOOL)isSilent
+                               prefetchedBundle:(nullable OWSPrefetchedPreKeyBundle *)prefetchedBundle
 {
     OWSAssert(plainText);
     OWSAssert(identifier.length > 0);
@@ -1229,64 +1492,41 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
     OWSAssert(storage);
 
     if (![storage containsSession:identifier deviceId:[deviceNumber intValue]]) {
-        __block dispatch_semaphore_t sema = dispatch_semaphore_create(0);
-        __block PreKeyBundle *_Nullable bundle;
-        __block NSException *_Nullable exception;
-        [self.networkManager makeRequest:[[TSRecipientPrekeyRequest alloc] initWithRecipient:identifier
-                                                                                    deviceId:[deviceNumber stringValue]]
-                                 success:^(NSURLSessionDataTask *task, id responseObject) {
-                                     bundle = [PreKeyBundle preKeyBundleFromDictionary:responseObject forDeviceNumber:deviceNumber];
-                                     dispatch_semaphore_signal(sema);
-                                 }
-                                 failure:^(NSURLSessionDataTask *task, NSError *error) {
-                                     if (!IsNSErrorNetworkFailure(error)) {
-                                         OWSProdError([OWSAnalyticsEvents messageSenderErrorRecipientPrekeyRequestFailed]);
-                                     }
-                                     DDLogError(@"Server replied to PreKeyBundle request with error: %@", error);
-                                     NSHTTPURLResponse *response = (NSHTTPURLResponse *)task.response;
-                                     if (response.statusCode == 404) {
-                                         // Can't throw exception from within callback as it's probabably a different thread.
-                                         exception = [NSException exceptionWithName:OWSMessageSenderInvalidDeviceException
-                                                                             reason:@"Device not registered"
-                                                                           userInfo:nil];
-                                     } else if (response.statusCode == 413) {
-                                         // Can't throw exception from within callback as it's probabably a different thread.
-                                         exception = [NSException exceptionWithName:OWSMessageSenderRateLimitedException
-                                                                             reason:@"Too many prekey requests"
-                                                                           userInfo:nil];
-                                     }
-                                     dispatch_semaphore_signal(sema);
-                                 }];
-        dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
-        if (exception) {
-            @throw exception;
+        PreKeyBundle *bundle;
+        BOOL isSignatureVerified = NO;
+        if (prefetchedBundle) {
+            if (prefetchedBundle.exception) {
+                @throw prefetchedBundle.exception;
+            }
+            bundle = prefetchedBundle.bundle;
+            isSignatureVerified = prefetchedBundle.isSignatureVerified;
+        } else {
+            bundle = [self preKeyBundleForRecipient:identifier deviceId:deviceNumber];
         }
 
-        if (!bundle) {
-            @throw [NSException exceptionWithName:InvalidVersionException
-                                           reason:@"Can't get a prekey bundle from the server with required information"
-                                         userInfo:nil];
-        } else {
-            SessionBuilder *builder = [[SessionBuilder alloc] initWithSessionStore:storage
-                                                                       preKeyStore:storage
-                                                                 signedPreKeyStore:storage
-                                                                  identityKeyStore:[OWSIdentityManager sharedManager]
-                                                                       recipientId:identifier
-                                                                          deviceId:[deviceNumber intValue]];
-            @try {
-                // Mutating session state is not thread safe.
-                @synchronized(self) {
+        SessionBuilder *builder = [[SessionBuilder alloc] initWithSessionStore:storage
+                                                                   preKeyStore:storage
+                                                             signedPreKeyStore:storage
+                                                              identityKeyStore:[OWSIdentityManager sharedManager]
+                                                                   recipientId:identifier
+                                                                      deviceId:[deviceNumber intValue]];
+        @try {
+            // Mutating session state is not thread safe.
+            @synchronized(self) {
+                if (isSignatureVerified) {
+                    [builder processVerifiedPrekeyBundle:bundle];
+                } else {
                     [builder processPrekeyBundle:bundle];
                 }
-            } @catch (NSException *exception) {
-                if ([exception.name isEqualToString:UntrustedIdentityKeyException]) {
-                    @throw [NSException
-                            exceptionWithName:UntrustedIdentityKeyException
-                            reason:nil
-                            userInfo:@{ TSInvalidPreKeyBundleKey : bundle, TSInvalidRecipientKey : identifier }];
-                }
-                @throw exception;
             }
+        } @catch (NSException *exception) {
+            if ([exception.name isEqualToString:UntrustedIdentityKeyException]) {
+                @throw [NSException
+                        exceptionWithName:UntrustedIdentityKeyException
+                        reason:nil
+                        userInfo:@{ TSInvalidPreKeyBundleKey : bundle, TSInvalidRecipientKey : identifier }];
+            }
+            @throw exception;
         }
     }
 
@@ -1365,7 +1605,7 @@ NSString *const OWSMessageSenderRateLimitedException = @"RateLimitedException";
             return;
         }
 
-        dispatch_async([OWSDispatch sessionStoreQueue], ^{
+        dispatch_async([OWSDispatch sessionStoreQueueForRecipientId:identifier], ^{
             for (NSUInteger i = 0; i < [devices count]; i++) {
                 int deviceNumber = [devices[i] intValue];
                 [[TSStorageManager sharedManager] deleteSessionForContact:identifier deviceId:deviceNumber];
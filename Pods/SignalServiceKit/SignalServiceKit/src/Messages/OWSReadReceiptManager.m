@@ -167,6 +167,9 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
 
     _messageSender = messageSender;
     _dbConnection = storageManager.newDatabaseConnection;
+    // Read receipts arrive (and are sent) in bursts, as a thread is read, so the
+    // writes queued while the connection is busy share a transaction.
+    _dbConnection.groupCommitLimit = 32;
 
     _toLinkedDevicesReadReceiptMap = [NSMutableDictionary new];
     _toSenderReadReceiptMap = [NSMutableDictionary new];
@@ -291,14 +294,12 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
 {
     OWSAssert(thread);
 
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
-            [self markAsReadBeforeTimestamp:timestamp
-                                     thread:thread
-                                   wasLocal:YES
-                                transaction:transaction];
-        }];
-    });
+    [self.dbConnection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+        [self markAsReadBeforeTimestamp:timestamp
+                                 thread:thread
+                               wasLocal:YES
+                            transaction:transaction];
+    }];
 }
 
 - (void)messageWasReadLocally:(TSIncomingMessage *)message
@@ -354,35 +355,33 @@ NSString *const OWSReadReceiptManagerAreReadReceiptsEnabled = @"areReadReceiptsE
         return;
     }
 
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
-            for (NSNumber *nsSentTimestamp in sentTimestamps) {
-                UInt64 sentTimestamp = [nsSentTimestamp unsignedLongLongValue];
-
-                NSArray<TSOutgoingMessage *> *messages
-                    = (NSArray<TSOutgoingMessage *> *)[TSInteraction interactionsWithTimestamp:sentTimestamp
-                                                                                       ofClass:[TSOutgoingMessage class]
-                                                                               withTransaction:transaction];
-                OWSAssert(messages.count <= 1);
-                if (messages.count > 0) {
-                    // TODO: We might also need to "mark as read by recipient" any older messages
-                    // from us in that thread.  Or maybe this state should hang on the thread?
-                    for (TSOutgoingMessage *message in messages) {
-                        [message updateWithReadRecipientId:recipientId
-                                             readTimestamp:readTimestamp
-                                               transaction:transaction];
-                    }
-                } else {
-                    // Persist the read receipts so that we can apply them to outgoing messages
-                    // that we learn about later through sync messages.
-                    [TSRecipientReadReceipt addRecipientId:recipientId
-                                             sentTimestamp:sentTimestamp
-                                             readTimestamp:readTimestamp
-                                               transaction:transaction];
+    [self.dbConnection asyncReadWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+        for (NSNumber *nsSentTimestamp in sentTimestamps) {
+            UInt64 sentTimestamp = [nsSentTimestamp unsignedLongLongValue];
+
+            NSArray<TSOutgoingMessage *> *messages
+                = (NSArray<TSOutgoingMessage *> *)[TSInteraction interactionsWithTimestamp:sentTimestamp
+                                                                                   ofClass:[TSOutgoingMessage class]
+                                                                           withTransaction:transaction];
+            OWSAssert(messages.count <= 1);
+            if (messages.count > 0) {
+                // TODO: We might also need to "mark as read by recipient" any older messages
+                // from us in that thread.  Or maybe this state should hang on the thread?
+                for (TSOutgoingMessage *message in messages) {
+                    [message updateWithReadRecipientId:recipientId
+                                         readTimestamp:readTimestamp
+                                           transaction:transaction];
                 }
+            } else {
+                // Persist the read receipts so that we can apply them to outgoing messages
+                // that we learn about later through sync messages.
+                [TSRecipientReadReceipt addRecipientId:recipientId
+                                         sentTimestamp:sentTimestamp
+                                         readTimestamp:readTimestamp
+                                           transaction:transaction];
             }
-        }];
-    });
+        }
+    }];
 }
 
 - (void)applyEarlyReadReceiptsForOutgoingMessageFromLinkedDevice:(TSOutgoingMessage *)message
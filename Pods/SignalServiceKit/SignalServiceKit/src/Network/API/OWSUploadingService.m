@@ -3,7 +3,6 @@
 //
 
 #import "OWSUploadingService.h"
-#import "Cryptography.h"
 #import "MIMETypeUtil.h"
 #import "NSNotificationCenter+OWS.h"
 #import "OWSError.h"
@@ -82,36 +81,39 @@ static const CGFloat kAttachmentUploadProgressTheta = 0.001f;
                 UInt64 serverId = ((NSDecimalNumber *)[responseDict objectForKey:@"id"]).unsignedLongLongValue;
                 NSString *location = [responseDict objectForKey:@"location"];
 
+                // The attachment is encrypted to a temporary file and uploaded
+                // from there, so it's never held in memory.
+                NSString *encryptedFilePath =
+                    [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+                NSData *encryptionKey;
+                NSData *digest;
                 NSError *error;
-                NSData *attachmentData = [attachmentStream readDataFromFileWithError:&error];
-                if (error) {
-                    DDLogError(@"%@ Failed to read attachment data with error:%@", self.tag, error);
+                if (![attachmentStream writeEncryptedDataToFile:encryptedFilePath
+                                                         outKey:&encryptionKey
+                                                      outDigest:&digest
+                                                          error:&error]) {
+                    DDLogError(@"%@ Failed to encrypt attachment data with error:%@", self.tag, error);
                     [error setIsRetryable:YES];
                     return failureHandlerWrapper(error);
                 }
 
-                NSData *encryptionKey;
-                NSData *digest;
-                NSData *encryptedAttachmentData =
-                    [Cryptography encryptAttachmentData:attachmentData outKey:&encryptionKey outDigest:&digest];
-
                 attachmentStream.encryptionKey = encryptionKey;
                 attachmentStream.digest = digest;
 
-                [self uploadDataWithProgress:encryptedAttachmentData
-                                    location:location
-                                attachmentId:attachmentStream.uniqueId
-                                     success:^{
-                                         OWSAssert([NSThread isMainThread]);
+                [self uploadFileWithProgress:encryptedFilePath
+                    location:location
+                    attachmentId:attachmentStream.uniqueId
+                    success:^{
+                        OWSAssert([NSThread isMainThread]);
 
-                                         DDLogInfo(@"%@ Uploaded attachment: %p.", self.tag, attachmentStream);
-                                         attachmentStream.serverId = serverId;
-                                         attachmentStream.isUploaded = YES;
-                                         [attachmentStream save];
+                        DDLogInfo(@"%@ Uploaded attachment: %p.", self.tag, attachmentStream);
+                        attachmentStream.serverId = serverId;
+                        attachmentStream.isUploaded = YES;
+                        [attachmentStream save];
 
-                                         successHandlerWrapper();
-                                     }
-                                     failure:failureHandlerWrapper];
+                        successHandlerWrapper();
+                    }
+                    failure:failureHandlerWrapper];
 
             });
         }
@@ -123,7 +125,7 @@ static const CGFloat kAttachmentUploadProgressTheta = 0.001f;
 }
 
 
-- (void)uploadDataWithProgress:(NSData *)cipherText
+- (void)uploadFileWithProgress:(NSString *)encryptedFilePath
                       location:(NSString *)location
                   attachmentId:(NSString *)attachmentId
                        success:(void (^)())successHandler
@@ -131,7 +133,6 @@ static const CGFloat kAttachmentUploadProgressTheta = 0.001f;
 {
     NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:[NSURL URLWithString:location]];
     request.HTTPMethod = @"PUT";
-    request.HTTPBody = cipherText;
     [request setValue:OWSMimeTypeApplicationOctetStream forHTTPHeaderField:@"Content-Type"];
 
     AFURLSessionManager *manager = [[AFURLSessionManager alloc]
@@ -139,13 +140,14 @@ static const CGFloat kAttachmentUploadProgressTheta = 0.001f;
 
     NSURLSessionUploadTask *uploadTask;
     uploadTask = [manager uploadTaskWithRequest:request
-        fromData:cipherText
+        fromFile:[NSURL fileURLWithPath:encryptedFilePath]
         progress:^(NSProgress *_Nonnull uploadProgress) {
             [self fireProgressNotification:MAX(kAttachmentUploadProgressTheta, uploadProgress.fractionCompleted)
                               attachmentId:attachmentId];
         }
         completionHandler:^(NSURLResponse *_Nonnull response, id _Nullable responseObject, NSError *_Nullable error) {
             OWSAssert([NSThread isMainThread]);
+            [[NSFileManager defaultManager] removeItemAtPath:encryptedFilePath error:nil];
             if (error) {
                 [error setIsRetryable:YES];
                 return failureHandler(error);
@@ -0,0 +1,56 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class SessionRecord;
+@class YapDatabase;
+@class YapDatabaseConnection;
+
+/**
+ * Write-back cache in front of the per-device session rows of one keys database.
+ *
+ * Stored sessions are held as dirty, and never evicted, until flush writes them all in one
+ * transaction. Callers are always handed a copy: a session is mutated in place while encrypting or
+ * decrypting, and a failed attempt mustn't leave its half-ratcheted state behind in the cache.
+ *
+ * Sessions of a contact must only be stored from its session store queue.
+ */
+@interface OWSSessionStore : NSObject
+
+@property (nonatomic, readonly) YapDatabase *database;
+
+/**
+ * Special purpose dbConnection which disables the object cache to better enforce transaction semantics on the store.
+ * Note that it's still technically possible to access this collection from a different collection,
+ * but that should be considered a bug.
+ */
+@property (nonatomic, readonly) YapDatabaseConnection *dbConnection;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+// Migrates any sessions in the legacy per-contact collection.
+- (instancetype)initWithDatabase:(YapDatabase *)database NS_DESIGNATED_INITIALIZER;
+
+- (nullable SessionRecord *)sessionForContact:(NSString *)contactIdentifier deviceId:(int)deviceId;
+
+// Takes ownership of record, which the caller mustn't mutate afterwards.
+- (void)setSession:(SessionRecord *)record forContact:(NSString *)contactIdentifier deviceId:(int)deviceId;
+
+// Devices with a session, stored or not yet flushed, in ascending order.
+- (NSArray<NSNumber *> *)deviceIdsForContact:(NSString *)contactIdentifier;
+
+- (void)removeSessionForContact:(NSString *)contactIdentifier deviceId:(int)deviceId;
+- (void)removeAllSessionsForContact:(NSString *)contactIdentifier;
+- (void)removeAllSessions;
+
+// Writes every session stored since the last flush, in a single transaction.
+- (void)flush;
+
+// Sessions which have been stored but not yet flushed.
+- (NSUInteger)dirtySessionCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,375 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+#import "OWSSessionStore.h"
+#import "TSStorageManager+SessionStore.h"
+#import <AxolotlKit/SessionRecord.h>
+#import <YapDatabase/YapCache.h>
+#import <YapDatabase/YapDatabase.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Clean sessions kept in memory. Most recipients have one to three devices.
+static const NSUInteger kSessionCacheCountLimit = 256;
+
+static NSString *OWSSessionKey(NSString *contactIdentifier, int deviceId)
+{
+    return [NSString stringWithFormat:@"%@.%d", contactIdentifier, deviceId];
+}
+
+// Splits "<contactIdentifier>.<deviceId>" at its last dot.
+static BOOL OWSParseSessionKey(NSString *key, NSString *_Nullable *_Nullable contactIdentifierOut, int *deviceIdOut)
+{
+    NSRange dot = [key rangeOfString:@"." options:NSBackwardsSearch];
+    if (dot.location == NSNotFound || dot.location == 0 || NSMaxRange(dot) == key.length) {
+        return NO;
+    }
+
+    NSString *deviceString = [key substringFromIndex:NSMaxRange(dot)];
+    NSCharacterSet *nonDigits = [NSCharacterSet decimalDigitCharacterSet].invertedSet;
+    if ([deviceString rangeOfCharacterFromSet:nonDigits].location != NSNotFound) {
+        return NO;
+    }
+
+    if (contactIdentifierOut) {
+        *contactIdentifierOut = [key substringToIndex:dot.location];
+    }
+    *deviceIdOut = deviceString.intValue;
+    return YES;
+}
+
+@interface OWSSessionStore ()
+
+// Both guarded by @synchronized(self).
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, SessionRecord *> *dirtySessions;
+@property (nonatomic, readonly) YapCache<NSString *, SessionRecord *> *cleanSessions;
+
+// Serializes writes, so that an older snapshot of a session is never written over a newer one.
+@property (nonatomic, readonly) NSObject *writeLock;
+
+@end
+
+#pragma mark -
+
+@implementation OWSSessionStore
+
+- (instancetype)initWithDatabase:(YapDatabase *)database
+{
+    self = [super init];
+    if (!self) {
+        return self;
+    }
+
+    OWSAssert(database);
+
+    _database = database;
+    _dbConnection = [database newConnection];
+    _dbConnection.objectCacheEnabled = NO;
+#if DEBUG
+    _dbConnection.permittedTransactions = YDB_AnySyncTransaction;
+#endif
+    _dirtySessions = [NSMutableDictionary new];
+    _cleanSessions = [[YapCache alloc] initWithCountLimit:kSessionCacheCountLimit];
+    _writeLock = [NSObject new];
+
+    [self migrateLegacySessions];
+
+    return self;
+}
+
+// Splits the legacy per-contact dictionaries into per-device rows, so that storing one session no longer rewrites
+// every session of the contact, and lists the devices of each contact.
+- (void)migrateLegacySessions
+{
+    [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+        if ([transaction numberOfKeysInCollection:TSStorageManagerSessionStoreCollection] > 0) {
+            [self migrateLegacySessionsWithTransaction:transaction];
+        }
+
+        // Sessions migrated before the device lists existed have none.
+        if ([transaction numberOfKeysInCollection:TSStorageManagerSessionDevicesCollection] == 0
+            && [transaction numberOfKeysInCollection:TSStorageManagerDeviceSessionStoreCollection] > 0) {
+            [self rebuildDeviceListsWithTransaction:transaction];
+        }
+    }];
+}
+
+- (void)migrateLegacySessionsWithTransaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    NSMutableDictionary<NSString *, SessionRecord *> *sessions = [NSMutableDictionary new];
+    [transaction
+        enumerateKeysAndObjectsInCollection:TSStorageManagerSessionStoreCollection
+                                 usingBlock:^(NSString *contactIdentifier, id object, BOOL *stop) {
+                                     if (![object isKindOfClass:[NSDictionary class]]) {
+                                         OWSFail(@"%@ Unexpected type: %@ in collection.", self.tag, object);
+                                         return;
+                                     }
+                                     [(NSDictionary *)object enumerateKeysAndObjectsUsingBlock:^(
+                                         id deviceId, id record, BOOL *innerStop) {
+                                         if (![deviceId isKindOfClass:[NSNumber class]]
+                                             || ![record isKindOfClass:[SessionRecord class]]) {
+                                             OWSFail(@"%@ Unexpected session: %@", self.tag, record);
+                                             return;
+                                         }
+                                         NSString *key = OWSSessionKey(contactIdentifier, [deviceId intValue]);
+                                         sessions[key] = record;
+                                     }];
+                                 }];
+
+    [sessions enumerateKeysAndObjectsUsingBlock:^(NSString *key, SessionRecord *record, BOOL *stop) {
+        [transaction setObject:record forKey:key inCollection:TSStorageManagerDeviceSessionStoreCollection];
+    }];
+    [transaction removeAllObjectsInCollection:TSStorageManagerSessionStoreCollection];
+
+    DDLogInfo(@"%@ migrated %lu sessions to per-device rows.", self.tag, (unsigned long)sessions.count);
+}
+
+- (void)rebuildDeviceListsWithTransaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    NSMutableDictionary<NSString *, NSMutableSet<NSNumber *> *> *deviceIdsByContact = [NSMutableDictionary new];
+    [transaction enumerateKeysInCollection:TSStorageManagerDeviceSessionStoreCollection
+                                usingBlock:^(NSString *key, BOOL *stop) {
+                                    NSString *_Nullable contactIdentifier;
+                                    int deviceId;
+                                    if (!OWSParseSessionKey(key, &contactIdentifier, &deviceId)) {
+                                        OWSFail(@"%@ Unexpected session key: %@", self.tag, key);
+                                        return;
+                                    }
+                                    NSMutableSet<NSNumber *> *deviceIds = deviceIdsByContact[contactIdentifier];
+                                    if (!deviceIds) {
+                                        deviceIds = [NSMutableSet new];
+                                        deviceIdsByContact[contactIdentifier] = deviceIds;
+                                    }
+                                    [deviceIds addObject:@(deviceId)];
+                                }];
+
+    [deviceIdsByContact enumerateKeysAndObjectsUsingBlock:^(
+        NSString *contactIdentifier, NSMutableSet<NSNumber *> *deviceIds, BOOL *stop) {
+        [self setDeviceIds:deviceIds forContact:contactIdentifier transaction:transaction];
+    }];
+
+    DDLogInfo(@"%@ listed the devices of %lu contacts.", self.tag, (unsigned long)deviceIdsByContact.count);
+}
+
+#pragma mark - Device lists
+
+// The devices of each contact with a session row, so that finding them doesn't scan every session.
+- (NSArray<NSNumber *> *)storedDeviceIdsForContact:(NSString *)contactIdentifier
+                                       transaction:(YapDatabaseReadTransaction *)transaction
+{
+    NSArray<NSNumber *> *_Nullable deviceIds =
+        [transaction objectForKey:contactIdentifier inCollection:TSStorageManagerSessionDevicesCollection];
+    return deviceIds ?: @[];
+}
+
+- (void)setDeviceIds:(NSSet<NSNumber *> *)deviceIds
+          forContact:(NSString *)contactIdentifier
+         transaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+    if (deviceIds.count < 1) {
+        [transaction removeObjectForKey:contactIdentifier inCollection:TSStorageManagerSessionDevicesCollection];
+        return;
+    }
+
+    NSArray<NSNumber *> *sortedDeviceIds = [deviceIds.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    [transaction setObject:sortedDeviceIds forKey:contactIdentifier inCollection:TSStorageManagerSessionDevicesCollection];
+}
+
+#pragma mark - Sessions
+
+- (nullable SessionRecord *)sessionForContact:(NSString *)contactIdentifier deviceId:(int)deviceId
+{
+    NSString *key = OWSSessionKey(contactIdentifier, deviceId);
+
+    @synchronized(self)
+    {
+        SessionRecord *_Nullable record = self.dirtySessions[key] ?: [self.cleanSessions objectForKey:key];
+        if (record) {
+            return [record copy];
+        }
+    }
+
+    // Sessions of a recipient are only stored on its session store queue, which we're on, so nothing can be stored
+    // for this key between this read and the cache insert below.
+    __block SessionRecord *_Nullable record;
+    [self.dbConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+        record = [transaction objectForKey:key inCollection:TSStorageManagerDeviceSessionStoreCollection];
+    }];
+    if (!record) {
+        return nil;
+    }
+
+    @synchronized(self)
+    {
+        [self.cleanSessions setObject:record forKey:key];
+    }
+    return [record copy];
+}
+
+- (void)setSession:(SessionRecord *)record forContact:(NSString *)contactIdentifier deviceId:(int)deviceId
+{
+    NSString *key = OWSSessionKey(contactIdentifier, deviceId);
+
+    @synchronized(self)
+    {
+        self.dirtySessions[key] = record;
+        [self.cleanSessions removeObjectForKey:key];
+    }
+}
+
+- (NSArray<NSNumber *> *)deviceIdsForContact:(NSString *)contactIdentifier
+{
+    __block NSMutableSet<NSNumber *> *deviceIds;
+    [self.dbConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+        deviceIds = [NSMutableSet setWithArray:[self storedDeviceIdsForContact:contactIdentifier transaction:transaction]];
+    }];
+
+    // Few sessions are dirty at a time; they're flushed after every message.
+    @synchronized(self)
+    {
+        for (NSString *key in self.dirtySessions) {
+            NSString *_Nullable keyContactIdentifier;
+            int deviceId;
+            if (OWSParseSessionKey(key, &keyContactIdentifier, &deviceId) &&
+                [keyContactIdentifier isEqualToString:contactIdentifier]) {
+                [deviceIds addObject:@(deviceId)];
+            }
+        }
+    }
+
+    return [deviceIds.allObjects sortedArrayUsingSelector:@selector(compare:)];
+}
+
+- (NSUInteger)dirtySessionCount
+{
+    @synchronized(self)
+    {
+        return self.dirtySessions.count;
+    }
+}
+
+- (void)flush
+{
+    @synchronized(self.writeLock)
+    {
+        NSDictionary<NSString *, SessionRecord *> *sessions;
+        @synchronized(self)
+        {
+            sessions = [self.dirtySessions copy];
+        }
+        if (sessions.count < 1) {
+            return;
+        }
+
+        [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+            NSMutableDictionary<NSString *, NSMutableSet<NSNumber *> *> *addedDeviceIds = [NSMutableDictionary new];
+            [sessions enumerateKeysAndObjectsUsingBlock:^(NSString *key, SessionRecord *record, BOOL *stop) {
+                [transaction setObject:record forKey:key inCollection:TSStorageManagerDeviceSessionStoreCollection];
+
+                NSString *_Nullable contactIdentifier;
+                int deviceId;
+                if (OWSParseSessionKey(key, &contactIdentifier, &deviceId)) {
+                    NSMutableSet<NSNumber *> *deviceIds = addedDeviceIds[contactIdentifier];
+                    if (!deviceIds) {
+                        deviceIds = [NSMutableSet new];
+                        addedDeviceIds[contactIdentifier] = deviceIds;
+                    }
+                    [deviceIds addObject:@(deviceId)];
+                }
+            }];
+
+            [addedDeviceIds enumerateKeysAndObjectsUsingBlock:^(
+                NSString *contactIdentifier, NSMutableSet<NSNumber *> *deviceIds, BOOL *stop) {
+                NSArray<NSNumber *> *storedDeviceIds =
+                    [self storedDeviceIdsForContact:contactIdentifier transaction:transaction];
+                if ([deviceIds isSubsetOfSet:[NSSet setWithArray:storedDeviceIds]]) {
+                    return;
+                }
+                [deviceIds addObjectsFromArray:storedDeviceIds];
+                [self setDeviceIds:deviceIds forContact:contactIdentifier transaction:transaction];
+            }];
+        }];
+
+        @synchronized(self)
+        {
+            [sessions enumerateKeysAndObjectsUsingBlock:^(NSString *key, SessionRecord *record, BOOL *stop) {
+                // Sessions stored again during the write stay dirty.
+                if (self.dirtySessions[key] != record) {
+                    return;
+                }
+                [self.dirtySessions removeObjectForKey:key];
+                [self.cleanSessions setObject:record forKey:key];
+            }];
+        }
+    }
+}
+
+- (void)removeSessionForContact:(NSString *)contactIdentifier deviceId:(int)deviceId
+{
+    [self removeSessionsForContact:contactIdentifier deviceIds:@[ @(deviceId) ]];
+}
+
+- (void)removeAllSessionsForContact:(NSString *)contactIdentifier
+{
+    [self removeSessionsForContact:contactIdentifier deviceIds:[self deviceIdsForContact:contactIdentifier]];
+}
+
+- (void)removeSessionsForContact:(NSString *)contactIdentifier deviceIds:(NSArray<NSNumber *> *)deviceIds
+{
+    NSMutableArray<NSString *> *keys = [NSMutableArray new];
+    for (NSNumber *deviceId in deviceIds) {
+        [keys addObject:OWSSessionKey(contactIdentifier, deviceId.intValue)];
+    }
+
+    @synchronized(self.writeLock)
+    {
+        @synchronized(self)
+        {
+            [self.dirtySessions removeObjectsForKeys:keys];
+            [self.cleanSessions removeObjectsForKeys:keys];
+        }
+
+        [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+            [transaction removeObjectsForKeys:keys inCollection:TSStorageManagerDeviceSessionStoreCollection];
+
+            NSMutableSet<NSNumber *> *remainingDeviceIds =
+                [NSMutableSet setWithArray:[self storedDeviceIdsForContact:contactIdentifier transaction:transaction]];
+            [remainingDeviceIds minusSet:[NSSet setWithArray:deviceIds]];
+            [self setDeviceIds:remainingDeviceIds forContact:contactIdentifier transaction:transaction];
+        }];
+    }
+}
+
+- (void)removeAllSessions
+{
+    @synchronized(self.writeLock)
+    {
+        @synchronized(self)
+        {
+            [self.dirtySessions removeAllObjects];
+            [self.cleanSessions removeAllObjects];
+        }
+
+        [self.dbConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+            [transaction removeAllObjectsInCollection:TSStorageManagerDeviceSessionStoreCollection];
+            [transaction removeAllObjectsInCollection:TSStorageManagerSessionDevicesCollection];
+        }];
+    }
+}
+
+#pragma mark - Logging
+
++ (NSString *)tag
+{
+    return [NSString stringWithFormat:@"[%@]", self.class];
+}
+
+- (NSString *)tag
+{
+    return self.class.tag;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -3,6 +3,7 @@
 //
 
 #import "TSStorageManager+PreKeyStore.h"
+#import "TSStorageManager+SessionStore.h"
 #import "TSStorageManager+keyFromIntLong.h"
 #import <AxolotlKit/AxolotlExceptions.h>
 #import <AxolotlKit/SessionBuilder.h>
@@ -78,6 +79,9 @@
 }
 
 - (void)removePreKey:(int)preKeyId {
+    // The session built from this prekey must be durable before the prekey is gone.
+    [self flushDirtySessions];
+
     [self removeKeysObjectForKey:[self keyFromInt:preKeyId] inCollection:TSStorageManagerPreKeyStoreCollection];
 }
 
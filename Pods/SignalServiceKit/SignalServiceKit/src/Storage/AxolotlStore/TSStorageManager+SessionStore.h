@@ -5,10 +5,32 @@
 #import <AxolotlKit/SessionStore.h>
 #import "TSStorageManager.h"
 
+// Legacy collection of one NSDictionary<deviceId, SessionRecord> per contact.
+// Migrated to TSStorageManagerDeviceSessionStoreCollection on first use.
+extern NSString *const TSStorageManagerSessionStoreCollection;
+
+// One SessionRecord per (contact, device), keyed by "<contactIdentifier>.<deviceId>".
+extern NSString *const TSStorageManagerDeviceSessionStoreCollection;
+
+// The ascending NSArray<NSNumber> of device ids with a session in TSStorageManagerDeviceSessionStoreCollection,
+// keyed by contactIdentifier.
+extern NSString *const TSStorageManagerSessionDevicesCollection;
+
 @interface TSStorageManager (SessionStore) <SessionStore>
 
 - (void)archiveAllSessionsForContact:(NSString *)contactIdentifier;
 
+/**
+ * Sessions are stored to an in-memory cache and only written to the keys database by this method,
+ * which writes every session stored since the last flush in a single transaction.
+ *
+ * It must be called before anything which depends on those sessions is persisted or leaves the device:
+ * before a message encrypted with them is sent, before the envelopes decrypted with them are committed
+ * and before a prekey consumed by them is removed. Otherwise a crash could leave us unable to decrypt
+ * the replies, or the retransmission, of a message.
+ */
+- (void)flushDirtySessions;
+
 #pragma mark - debug
 
 - (void)resetSessionStore;
@@ -3,64 +3,52 @@
 //
 
 #import "TSStorageManager+SessionStore.h"
+#import "OWSSessionStore.h"
 #import <AxolotlKit/SessionRecord.h>
 
+NS_ASSUME_NONNULL_BEGIN
+
 NSString *const TSStorageManagerSessionStoreCollection = @"TSStorageManagerSessionStoreCollection";
-NSString *const kSessionStoreDBConnectionKey = @"kSessionStoreDBConnectionKey";
+NSString *const TSStorageManagerDeviceSessionStoreCollection = @"TSStorageManagerDeviceSessionStoreCollection";
+NSString *const TSStorageManagerSessionDevicesCollection = @"TSStorageManagerSessionDevicesCollection";
 
-void AssertIsOnSessionStoreQueue()
+void AssertIsOnSessionStoreQueue(NSString *contactIdentifier)
 {
 #ifdef DEBUG
     if (SYSTEM_VERSION_GREATER_THAN_OR_EQUAL_TO(10, 0)) {
-        dispatch_assert_queue([OWSDispatch sessionStoreQueue]);
+        dispatch_assert_queue([OWSDispatch sessionStoreQueueForRecipientId:contactIdentifier]);
     } // else, skip assert as it's a development convenience.
 #endif
 }
 
+#pragma mark -
+
 @implementation TSStorageManager (SessionStore)
 
-/**
- * Special purpose dbConnection which disables the object cache to better enforce transaction semantics on the store.
- * Note that it's still technically possible to access this collection from a different collection,
- * but that should be considered a bug.
- */
-+ (YapDatabaseConnection *)sessionDBConnection
+// The store of the current keys database, which changes when storage is reset.
+- (OWSSessionStore *)sessionStore
 {
-    static dispatch_once_t onceToken;
-    static YapDatabaseConnection *sessionDBConnection;
-    dispatch_once(&onceToken, ^{
-        sessionDBConnection = [TSStorageManager sharedManager].newKeysDatabaseConnection;
-        sessionDBConnection.objectCacheEnabled = NO;
-#if DEBUG
-        sessionDBConnection.permittedTransactions = YDB_AnySyncTransaction;
-#endif
-    });
+    static OWSSessionStore *sessionStore;
 
-    return sessionDBConnection;
-}
+    YapDatabase *keysDatabase = self.keysDBReadWriteConnection.database;
+    OWSAssert(keysDatabase);
 
-- (YapDatabaseConnection *)sessionDBConnection
-{
-    return [[self class] sessionDBConnection];
+    @synchronized([OWSSessionStore class])
+    {
+        if (sessionStore.database != keysDatabase) {
+            sessionStore = [[OWSSessionStore alloc] initWithDatabase:keysDatabase];
+        }
+        return sessionStore;
+    }
 }
 
 #pragma mark - SessionStore
 
 - (SessionRecord *)loadSession:(NSString *)contactIdentifier deviceId:(int)deviceId
 {
-    AssertIsOnSessionStoreQueue();
-
-    __block NSDictionary *dictionary;
-    [self.sessionDBConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
-        dictionary = [transaction objectForKey:contactIdentifier inCollection:TSStorageManagerSessionStoreCollection];
-    }];
-
-    SessionRecord *record;
-
-    if (dictionary) {
-        record = [dictionary objectForKey:@(deviceId)];
-    }
+    AssertIsOnSessionStoreQueue(contactIdentifier);
 
+    SessionRecord *_Nullable record = [self.sessionStore sessionForContact:contactIdentifier deviceId:deviceId];
     if (!record) {
         return [SessionRecord new];
     }
@@ -73,118 +61,73 @@ void AssertIsOnSessionStoreQueue()
     // Deprecated. We aren't currently using this anywhere, but it's "required" by the SessionStore protocol.
     // If we are going to start using it I'd want to re-verify it works as intended.
     OWSFail(@"%@ subDevicesSessions is deprecated", self.tag);
-    AssertIsOnSessionStoreQueue();
+    AssertIsOnSessionStoreQueue(contactIdentifier);
 
-    __block NSDictionary *dictionary;
-    [self.sessionDBConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
-        dictionary = [transaction objectForKey:contactIdentifier inCollection:TSStorageManagerSessionStoreCollection];
-    }];
-
-    return dictionary ? dictionary.allKeys : @[];
+    return [self.sessionStore deviceIdsForContact:contactIdentifier];
 }
 
 - (void)storeSession:(NSString *)contactIdentifier deviceId:(int)deviceId session:(SessionRecord *)session
 {
-    AssertIsOnSessionStoreQueue();
+    AssertIsOnSessionStoreQueue(contactIdentifier);
 
     // We need to ensure subsequent usage of this SessionRecord does not consider this session as "fresh". Normally this
     // is achieved by marking things as "not fresh" at the point of deserialization - when we fetch a SessionRecord from
-    // YapDB (initWithCoder:). However, because YapDB has an object cache, rather than fetching/deserializing, it's
-    // possible we'd get back *this* exact instance of the object (which, at this point, is still potentially "fresh"),
-    // thus we explicitly mark this instance as "unfresh", any time we save.
-    // NOTE: this may no longer be necessary now that we have a non-caching session db connection.
+    // YapDB (initWithCoder:). However, the session cache hands out copies of this exact instance, which at this point
+    // is still potentially "fresh", thus we explicitly mark this instance as "unfresh", any time we save.
     [session markAsUnFresh];
 
-    __block NSDictionary *immutableDictionary;
-    [self.sessionDBConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
-        immutableDictionary =
-        [transaction objectForKey:contactIdentifier inCollection:TSStorageManagerSessionStoreCollection];
-    }];
-
-    NSMutableDictionary *dictionary = [immutableDictionary mutableCopy];
-
-    if (!dictionary) {
-        dictionary = [NSMutableDictionary dictionary];
-    }
-
-    [dictionary setObject:session forKey:@(deviceId)];
-
-    [self.sessionDBConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
-        [transaction setObject:[dictionary copy]
-                        forKey:contactIdentifier
-                  inCollection:TSStorageManagerSessionStoreCollection];
-    }];
+    [self.sessionStore setSession:session forContact:contactIdentifier deviceId:deviceId];
 }
 
 - (BOOL)containsSession:(NSString *)contactIdentifier deviceId:(int)deviceId
 {
-    AssertIsOnSessionStoreQueue();
+    AssertIsOnSessionStoreQueue(contactIdentifier);
 
     return [self loadSession:contactIdentifier deviceId:deviceId].sessionState.hasSenderChain;
 }
 
 - (void)deleteSessionForContact:(NSString *)contactIdentifier deviceId:(int)deviceId
 {
-    AssertIsOnSessionStoreQueue();
+    AssertIsOnSessionStoreQueue(contactIdentifier);
     DDLogInfo(
               @"[TSStorageManager (SessionStore)] deleting session for contact: %@ device: %d", contactIdentifier, deviceId);
 
-    __block NSDictionary *immutableDictionary;
-    [self.sessionDBConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
-        immutableDictionary =
-        [transaction objectForKey:contactIdentifier inCollection:TSStorageManagerSessionStoreCollection];
-    }];
-    NSMutableDictionary *dictionary = [immutableDictionary mutableCopy];
-
-    if (!dictionary) {
-        dictionary = [NSMutableDictionary dictionary];
-    }
-
-    [dictionary removeObjectForKey:@(deviceId)];
-
-    [self.sessionDBConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
-        [transaction setObject:[dictionary copy]
-                        forKey:contactIdentifier
-                  inCollection:TSStorageManagerSessionStoreCollection];
-    }];
+    [self.sessionStore removeSessionForContact:contactIdentifier deviceId:deviceId];
 }
 
 - (void)deleteAllSessionsForContact:(NSString *)contactIdentifier
 {
-    AssertIsOnSessionStoreQueue();
+    AssertIsOnSessionStoreQueue(contactIdentifier);
     DDLogInfo(@"[TSStorageManager (SessionStore)] deleting all sessions for contact:%@", contactIdentifier);
 
-    [self.sessionDBConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
-        [transaction removeObjectForKey:contactIdentifier inCollection:TSStorageManagerSessionStoreCollection];
-    }];
+    [self.sessionStore removeAllSessionsForContact:contactIdentifier];
 }
 
 - (void)archiveAllSessionsForContact:(NSString *)contactIdentifier
 {
-    AssertIsOnSessionStoreQueue();
+    AssertIsOnSessionStoreQueue(contactIdentifier);
 
     DDLogInfo(@"[TSStorageManager (SessionStore)] archiving all sessions for contact: %@", contactIdentifier);
 
-    __block NSDictionary<NSNumber *, SessionRecord *> *sessionRecords;
-    [self.sessionDBConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
-        sessionRecords =
-        [transaction objectForKey:contactIdentifier inCollection:TSStorageManagerSessionStoreCollection];
+    OWSSessionStore *sessionStore = self.sessionStore;
+    for (NSNumber *deviceId in [sessionStore deviceIdsForContact:contactIdentifier]) {
+        SessionRecord *_Nullable sessionRecord =
+            [sessionStore sessionForContact:contactIdentifier deviceId:deviceId.intValue];
+        if (!sessionRecord) {
+            continue;
+        }
 
-        for (id deviceId in sessionRecords) {
-            id object = sessionRecords[deviceId];
-            if (![object isKindOfClass:[SessionRecord class]]) {
-                OWSFail(@"Unexpected object in session dict: %@", object);
-                continue;
-            }
+        [sessionRecord archiveCurrentState];
+        [sessionStore setSession:sessionRecord forContact:contactIdentifier deviceId:deviceId.intValue];
+    }
 
-            SessionRecord *sessionRecord = (SessionRecord *)object;
-            [sessionRecord archiveCurrentState];
-        }
+    // Archiving is rare, and usually follows an identity change, so we persist it right away.
+    [sessionStore flush];
+}
 
-        [transaction setObject:sessionRecords
-                        forKey:contactIdentifier
-                  inCollection:TSStorageManagerSessionStoreCollection];
-    }];
+- (void)flushDirtySessions
+{
+    [self.sessionStore flush];
 }
 
 #pragma mark - debug
@@ -192,51 +135,39 @@ void AssertIsOnSessionStoreQueue()
 - (void)resetSessionStore
 {
     DDLogWarn(@"%@ resetting session store", self.tag);
-    [self.sessionDBConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
-        [transaction removeAllObjectsInCollection:TSStorageManagerSessionStoreCollection];
-    }];
+    [self.sessionStore removeAllSessions];
 }
 
 - (void)printAllSessions
 {
-    AssertIsOnSessionStoreQueue();
-
     NSString *tag = @"[TSStorageManager (SessionStore)]";
-    [self.sessionDBConnection readWithBlock:^(YapDatabaseReadTransaction *_Nonnull transaction) {
+
+    OWSSessionStore *sessionStore = self.sessionStore;
+    [sessionStore flush];
+    [sessionStore.dbConnection readWithBlock:^(YapDatabaseReadTransaction *_Nonnull transaction) {
         DDLogDebug(@"%@ All Sessions:", tag);
         [transaction
-         enumerateKeysAndObjectsInCollection:TSStorageManagerSessionStoreCollection
+         enumerateKeysAndObjectsInCollection:TSStorageManagerDeviceSessionStoreCollection
          usingBlock:^(NSString *_Nonnull key,
-                      id _Nonnull deviceSessionsObject,
+                      id _Nonnull sessionRecordObject,
                       BOOL *_Nonnull stop) {
-             if (![deviceSessionsObject isKindOfClass:[NSDictionary class]]) {
-                 OWSFail(
-                         @"%@ Unexpected type: %@ in collection.", tag, deviceSessionsObject);
+             if (![sessionRecordObject isKindOfClass:[SessionRecord class]]) {
+                 OWSFail(@"%@ Unexpected type: %@ in collection.",
+                         tag,
+                         sessionRecordObject);
                  return;
              }
-             NSDictionary *deviceSessions = (NSDictionary *)deviceSessionsObject;
-
-             DDLogDebug(@"%@     Sessions for recipient: %@", tag, key);
-             [deviceSessions enumerateKeysAndObjectsUsingBlock:^(
-                                                                 id _Nonnull key, id _Nonnull sessionRecordObject, BOOL *_Nonnull stop) {
-                 if (![sessionRecordObject isKindOfClass:[SessionRecord class]]) {
-                     OWSFail(@"%@ Unexpected type: %@ in collection.",
-                             tag,
-                             sessionRecordObject);
-                     return;
-                 }
-                 SessionRecord *sessionRecord = (SessionRecord *)sessionRecordObject;
-                 SessionState *activeState = [sessionRecord sessionState];
-                 NSArray<SessionState *> *previousStates =
-                 [sessionRecord previousSessionStates];
-                 DDLogDebug(@"%@         Device: %@ SessionRecord: %@ activeSessionState: "
-                            @"%@ previousSessionStates: %@",
-                            tag,
-                            key,
-                            sessionRecord,
-                            activeState,
-                            previousStates);
-             }];
+             SessionRecord *sessionRecord = (SessionRecord *)sessionRecordObject;
+             SessionState *activeState = [sessionRecord sessionState];
+             NSArray<SessionState *> *previousStates =
+             [sessionRecord previousSessionStates];
+             DDLogDebug(@"%@     Recipient.Device: %@ SessionRecord: %@ activeSessionState: "
+                        @"%@ previousSessionStates: %@",
+                        tag,
+                        key,
+                        sessionRecord,
+                        activeState,
+                        previousStates);
          }];
     }];
 }
@@ -255,3 +186,4 @@ void AssertIsOnSessionStoreQueue()
 
 @end
 
+NS_ASSUME_NONNULL_END
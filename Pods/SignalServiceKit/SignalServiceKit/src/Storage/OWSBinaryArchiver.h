@@ -0,0 +1,52 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A compact keyed coder for database rows, used in place of NSKeyedArchiver on hot collections.
+//
+// * Any NSCoding object that only uses keyed coding can be archived; no changes to models are required.
+// * Property lists (strings, numbers, data, dates, arrays, dictionaries, sets) are written natively,
+//   preserving mutability, rather than going through their NSCoding implementations.
+// * Class names and keys are written once per archive and referred to by index after that,
+//   so there are no per-object class or key tables to parse.
+// * Archives start with a magic prefix and a format version; see isBinaryArchive:.
+//
+// Object graphs are written as trees. Conditional objects are encoded unconditionally, and
+// shared references are decoded as separate copies, which is fine for our models.
+@interface OWSBinaryArchiver : NSCoder
+
+- (instancetype)init NS_UNAVAILABLE;
+
+// Raises NSInvalidArgumentException if the graph contains an object that doesn't support NSCoding.
++ (NSData *)archivedDataWithRootObject:(id)rootObject;
+
+@end
+
+#pragma mark -
+
+@interface OWSBinaryUnarchiver : NSCoder
+
+- (instancetype)init NS_UNAVAILABLE;
+
+// Returns YES if data was produced by OWSBinaryArchiver (of any format version).
++ (BOOL)isBinaryArchive:(NSData *)data;
++ (BOOL)isBinaryArchiveBytes:(const void *)bytes length:(NSUInteger)length;
+
+// Raises NSInvalidArchiveOperationException if data is malformed.
+//
+// unknownClassBlock, if present, is consulted for class names that can't be resolved at runtime,
+// mirroring -[NSKeyedUnarchiverDelegate unarchiver:cannotDecodeObjectOfClassName:originalClasses:].
++ (nullable id)unarchiveObjectWithData:(NSData *)data
+                     unknownClassBlock:(nullable Class _Nullable (^)(NSString *className))unknownClassBlock;
+
+// Parses the archive in place. Everything decoded is copied out of the buffer, so the buffer
+// may be freed (or reused, e.g. by sqlite) as soon as this returns.
++ (nullable id)unarchiveObjectWithBytes:(const void *)bytes
+                                 length:(NSUInteger)length
+                      unknownClassBlock:(nullable Class _Nullable (^)(NSString *className))unknownClassBlock;
+
+@end
+
+NS_ASSUME_NONNULL_END
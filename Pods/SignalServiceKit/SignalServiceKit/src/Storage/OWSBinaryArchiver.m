@@ -0,0 +1,773 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+#import "OWSBinaryArchiver.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Archive layout (format version 1):
+//
+//   archive := magic(4) version(1) value
+//   value   := tag(1) payload
+//   object  := classRef field* 0
+//   field   := keyRef value
+//
+// Strings, data and collections are prefixed with a varint length or count.
+// Integers are zigzag varints and doubles are 8 little-endian bytes.
+//
+// A classRef of 0 is followed by the class name inline, which is assigned the next class index;
+// otherwise it's the class index + 1. A keyRef of 0 ends the object, 1 introduces a new key inline,
+// and otherwise it's the key index + 2.
+static const uint8_t kOWSBinaryArchiveMagic[4] = { 'O', 'W', 'S', 'B' };
+static const uint8_t kOWSBinaryArchiveFormatVersion = 1;
+
+// Guards against stack exhaustion on corrupt input or cyclic graphs.
+static const NSUInteger kOWSBinaryArchiveMaxDepth = 256;
+
+typedef NS_ENUM(uint8_t, OWSBinaryArchiveTag) {
+    OWSBinaryArchiveTagNil = 0,
+    OWSBinaryArchiveTagFalse,
+    OWSBinaryArchiveTagTrue,
+    OWSBinaryArchiveTagInteger,
+    OWSBinaryArchiveTagUnsignedInteger,
+    OWSBinaryArchiveTagDouble,
+    OWSBinaryArchiveTagString,
+    OWSBinaryArchiveTagMutableString,
+    OWSBinaryArchiveTagData,
+    OWSBinaryArchiveTagMutableData,
+    OWSBinaryArchiveTagDate,
+    OWSBinaryArchiveTagNull,
+    OWSBinaryArchiveTagArray,
+    OWSBinaryArchiveTagMutableArray,
+    OWSBinaryArchiveTagDictionary,
+    OWSBinaryArchiveTagMutableDictionary,
+    OWSBinaryArchiveTagSet,
+    OWSBinaryArchiveTagMutableSet,
+    OWSBinaryArchiveTagObject,
+};
+
+static inline uint64_t OWSZigZagEncode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t OWSZigZagDecode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+@interface OWSBinaryArchiver ()
+
+@property (nonatomic, readonly) NSMutableData *output;
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, NSNumber *> *classIndexMap;
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, NSNumber *> *keyIndexMap;
+@property (nonatomic) NSUInteger depth;
+
+@end
+
+#pragma mark -
+
+@implementation OWSBinaryArchiver
+
++ (NSData *)archivedDataWithRootObject:(id)rootObject
+{
+    OWSBinaryArchiver *archiver = [[OWSBinaryArchiver alloc] initPrivate];
+    [archiver.output appendBytes:kOWSBinaryArchiveMagic length:sizeof(kOWSBinaryArchiveMagic)];
+    [archiver.output appendBytes:&kOWSBinaryArchiveFormatVersion length:1];
+    [archiver writeValue:rootObject];
+    return [archiver.output copy];
+}
+
+- (instancetype)initPrivate
+{
+    self = [super init];
+    if (!self) {
+        return self;
+    }
+
+    _output = [NSMutableData dataWithCapacity:256];
+    _classIndexMap = [NSMutableDictionary new];
+    _keyIndexMap = [NSMutableDictionary new];
+
+    return self;
+}
+
+#pragma mark - Primitives
+
+- (void)writeTag:(OWSBinaryArchiveTag)tag
+{
+    [self.output appendBytes:&tag length:1];
+}
+
+- (void)writeVarint:(uint64_t)value
+{
+    uint8_t buffer[10];
+    size_t length = 0;
+    while (value >= 0x80) {
+        buffer[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (uint8_t)value;
+    [self.output appendBytes:buffer length:length];
+}
+
+- (void)writeDouble:(double)value
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = CFSwapInt64HostToLittle(bits);
+    [self.output appendBytes:&bits length:sizeof(bits)];
+}
+
+- (void)writeString:(NSString *)string
+{
+    // Transcode directly into the output buffer rather than via an intermediate NSData.
+    NSUInteger length = [string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    if (length == 0 && string.length > 0) {
+        [NSException raise:NSInvalidArgumentException format:@"Could not encode string as UTF-8"];
+    }
+    [self writeVarint:length];
+    if (length == 0) {
+        return;
+    }
+
+    NSUInteger offset = self.output.length;
+    [self.output increaseLengthBy:length];
+    NSUInteger usedLength = 0;
+    BOOL success = [string getBytes:(uint8_t *)self.output.mutableBytes + offset
+                          maxLength:length
+                         usedLength:&usedLength
+                           encoding:NSUTF8StringEncoding
+                            options:0
+                              range:NSMakeRange(0, string.length)
+                     remainingRange:NULL];
+    if (!success || usedLength != length) {
+        [NSException raise:NSInvalidArgumentException format:@"Could not encode string as UTF-8"];
+    }
+}
+
+- (void)writeBytes:(const void *)bytes length:(NSUInteger)length
+{
+    [self writeVarint:length];
+    [self.output appendBytes:bytes length:length];
+}
+
+- (void)writeKey:(NSString *)key
+{
+    if (self.depth == 0) {
+        [NSException raise:NSInvalidArgumentException format:@"Keyed value encoded outside of an object: %@", key];
+    }
+
+    NSNumber *_Nullable keyIndex = self.keyIndexMap[key];
+    if (keyIndex) {
+        [self writeVarint:keyIndex.unsignedLongLongValue + 2];
+    } else {
+        self.keyIndexMap[key] = @(self.keyIndexMap.count);
+        [self writeVarint:1];
+        [self writeString:key];
+    }
+}
+
+- (void)writeClassName:(NSString *)className
+{
+    NSNumber *_Nullable classIndex = self.classIndexMap[className];
+    if (classIndex) {
+        [self writeVarint:classIndex.unsignedLongLongValue + 1];
+    } else {
+        self.classIndexMap[className] = @(self.classIndexMap.count);
+        [self writeVarint:0];
+        [self writeString:className];
+    }
+}
+
+#pragma mark - Values
+
+- (void)writeValue:(nullable id)value
+{
+    if (value == nil) {
+        [self writeTag:OWSBinaryArchiveTagNil];
+        return;
+    }
+
+    if (++self.depth > kOWSBinaryArchiveMaxDepth) {
+        [NSException raise:NSInvalidArgumentException format:@"Object graph is too deep to archive"];
+    }
+
+    Class classForCoder = [value classForCoder];
+
+    if ([value isKindOfClass:[NSString class]]) {
+        [self writeTag:(classForCoder == [NSMutableString class] ? OWSBinaryArchiveTagMutableString
+                                                                  : OWSBinaryArchiveTagString)];
+        [self writeString:value];
+    } else if ([value isKindOfClass:[NSNumber class]]) {
+        [self writeNumber:value];
+    } else if ([value isKindOfClass:[NSData class]]) {
+        NSData *data = value;
+        [self writeTag:(classForCoder == [NSMutableData class] ? OWSBinaryArchiveTagMutableData
+                                                                : OWSBinaryArchiveTagData)];
+        [self writeBytes:data.bytes length:data.length];
+    } else if ([value isKindOfClass:[NSDate class]]) {
+        [self writeTag:OWSBinaryArchiveTagDate];
+        [self writeDouble:[(NSDate *)value timeIntervalSinceReferenceDate]];
+    } else if ([value isKindOfClass:[NSNull class]]) {
+        [self writeTag:OWSBinaryArchiveTagNull];
+    } else if ([value isKindOfClass:[NSArray class]]) {
+        NSArray *array = value;
+        [self writeTag:(classForCoder == [NSMutableArray class] ? OWSBinaryArchiveTagMutableArray
+                                                                 : OWSBinaryArchiveTagArray)];
+        [self writeVarint:array.count];
+        for (id element in array) {
+            [self writeValue:element];
+        }
+    } else if ([value isKindOfClass:[NSDictionary class]]) {
+        NSDictionary *dictionary = value;
+        [self writeTag:(classForCoder == [NSMutableDictionary class] ? OWSBinaryArchiveTagMutableDictionary
+                                                                      : OWSBinaryArchiveTagDictionary)];
+        [self writeVarint:dictionary.count];
+        [dictionary enumerateKeysAndObjectsUsingBlock:^(id dictionaryKey, id dictionaryValue, BOOL *stop) {
+            [self writeValue:dictionaryKey];
+            [self writeValue:dictionaryValue];
+        }];
+    } else if ([value isKindOfClass:[NSSet class]]) {
+        NSSet *set = value;
+        [self writeTag:(classForCoder == [NSMutableSet class] ? OWSBinaryArchiveTagMutableSet
+                                                               : OWSBinaryArchiveTagSet)];
+        [self writeVarint:set.count];
+        for (id element in set) {
+            [self writeValue:element];
+        }
+    } else if ([value conformsToProtocol:@protocol(NSCoding)]) {
+        [self writeTag:OWSBinaryArchiveTagObject];
+        [self writeClassName:NSStringFromClass(classForCoder)];
+        [(id<NSCoding>)value encodeWithCoder:self];
+        [self writeVarint:0];
+    } else {
+        [NSException raise:NSInvalidArgumentException format:@"Cannot archive object of class: %@", [value class]];
+    }
+
+    self.depth--;
+}
+
+- (void)writeNumber:(NSNumber *)number
+{
+    if ((__bridge CFBooleanRef)number == kCFBooleanTrue) {
+        [self writeTag:OWSBinaryArchiveTagTrue];
+        return;
+    }
+    if ((__bridge CFBooleanRef)number == kCFBooleanFalse) {
+        [self writeTag:OWSBinaryArchiveTagFalse];
+        return;
+    }
+
+    switch (number.objCType[0]) {
+        case 'f':
+        case 'd':
+            [self writeTag:OWSBinaryArchiveTagDouble];
+            [self writeDouble:number.doubleValue];
+            break;
+        case 'Q':
+        case 'L':
+            if (number.unsignedLongLongValue > INT64_MAX) {
+                [self writeTag:OWSBinaryArchiveTagUnsignedInteger];
+                [self writeVarint:number.unsignedLongLongValue];
+                break;
+            }
+            // Fall through.
+        default:
+            [self writeTag:OWSBinaryArchiveTagInteger];
+            [self writeVarint:OWSZigZagEncode(number.longLongValue)];
+            break;
+    }
+}
+
+#pragma mark - NSCoder
+
+- (BOOL)allowsKeyedCoding
+{
+    return YES;
+}
+
+- (void)encodeObject:(nullable id)object forKey:(NSString *)key
+{
+    [self writeKey:key];
+    [self writeValue:object];
+}
+
+- (void)encodeConditionalObject:(nullable id)object forKey:(NSString *)key
+{
+    [self encodeObject:object forKey:key];
+}
+
+- (void)encodeBool:(BOOL)value forKey:(NSString *)key
+{
+    [self writeKey:key];
+    [self writeTag:(value ? OWSBinaryArchiveTagTrue : OWSBinaryArchiveTagFalse)];
+}
+
+- (void)encodeInt:(int)value forKey:(NSString *)key
+{
+    [self encodeInt64:value forKey:key];
+}
+
+- (void)encodeInt32:(int32_t)value forKey:(NSString *)key
+{
+    [self encodeInt64:value forKey:key];
+}
+
+- (void)encodeInteger:(NSInteger)value forKey:(NSString *)key
+{
+    [self encodeInt64:value forKey:key];
+}
+
+- (void)encodeInt64:(int64_t)value forKey:(NSString *)key
+{
+    [self writeKey:key];
+    [self writeTag:OWSBinaryArchiveTagInteger];
+    [self writeVarint:OWSZigZagEncode(value)];
+}
+
+- (void)encodeFloat:(float)value forKey:(NSString *)key
+{
+    [self encodeDouble:value forKey:key];
+}
+
+- (void)encodeDouble:(double)value forKey:(NSString *)key
+{
+    [self writeKey:key];
+    [self writeTag:OWSBinaryArchiveTagDouble];
+    [self writeDouble:value];
+}
+
+- (void)encodeBytes:(nullable const uint8_t *)bytes length:(NSUInteger)length forKey:(NSString *)key
+{
+    [self writeKey:key];
+    [self writeTag:OWSBinaryArchiveTagData];
+    [self writeBytes:bytes length:length];
+}
+
+- (void)encodeValueOfObjCType:(const char *)type at:(const void *)addr
+{
+    [NSException raise:NSInvalidArgumentException format:@"%@ only supports keyed coding", self.class];
+}
+
+- (void)encodeDataObject:(NSData *)data
+{
+    [NSException raise:NSInvalidArgumentException format:@"%@ only supports keyed coding", self.class];
+}
+
+@end
+
+#pragma mark -
+
+@interface OWSBinaryUnarchiver ()
+
+@property (nonatomic, readonly) const uint8_t *bytes;
+@property (nonatomic, readonly) NSUInteger length;
+@property (nonatomic) NSUInteger offset;
+@property (nonatomic) NSUInteger depth;
+
+@property (nonatomic, readonly) NSMutableArray<Class> *classes;
+@property (nonatomic, readonly) NSMutableArray<NSString *> *keys;
+@property (nonatomic, readonly) NSMutableArray<NSDictionary<NSString *, id> *> *frames;
+
+@property (nonatomic, nullable, readonly) Class _Nullable (^unknownClassBlock)(NSString *className);
+
+@end
+
+#pragma mark -
+
+@implementation OWSBinaryUnarchiver
+
++ (BOOL)isBinaryArchive:(NSData *)data
+{
+    return [self isBinaryArchiveBytes:data.bytes length:data.length];
+}
+
++ (BOOL)isBinaryArchiveBytes:(const void *)bytes length:(NSUInteger)length
+{
+    return (length > sizeof(kOWSBinaryArchiveMagic)
+        && memcmp(bytes, kOWSBinaryArchiveMagic, sizeof(kOWSBinaryArchiveMagic)) == 0);
+}
+
++ (nullable id)unarchiveObjectWithData:(NSData *)data
+                     unknownClassBlock:(nullable Class _Nullable (^)(NSString *className))unknownClassBlock
+{
+    return [self unarchiveObjectWithBytes:data.bytes length:data.length unknownClassBlock:unknownClassBlock];
+}
+
++ (nullable id)unarchiveObjectWithBytes:(const void *)bytes
+                                 length:(NSUInteger)length
+                      unknownClassBlock:(nullable Class _Nullable (^)(NSString *className))unknownClassBlock
+{
+    if (![self isBinaryArchiveBytes:bytes length:length]) {
+        [NSException raise:NSInvalidArchiveOperationException format:@"Data is not a binary archive"];
+    }
+
+    OWSBinaryUnarchiver *unarchiver =
+        [[OWSBinaryUnarchiver alloc] initWithBytes:bytes length:length unknownClassBlock:unknownClassBlock];
+    unarchiver.offset = sizeof(kOWSBinaryArchiveMagic);
+
+    uint8_t formatVersion = [unarchiver readByte];
+    if (formatVersion > kOWSBinaryArchiveFormatVersion) {
+        [NSException raise:NSInvalidArchiveOperationException
+                    format:@"Unsupported binary archive version: %d", (int)formatVersion];
+    }
+
+    return [unarchiver readValue];
+}
+
+- (instancetype)initWithBytes:(const void *)bytes
+                       length:(NSUInteger)length
+            unknownClassBlock:(nullable Class _Nullable (^)(NSString *className))unknownClassBlock
+{
+    self = [super init];
+    if (!self) {
+        return self;
+    }
+
+    // The bytes may be a buffer we don't own (e.g. an sqlite row), so everything
+    // we decode is copied out of it before we return.
+    _bytes = bytes;
+    _length = length;
+    _classes = [NSMutableArray new];
+    _keys = [NSMutableArray new];
+    _frames = [NSMutableArray new];
+    _unknownClassBlock = unknownClassBlock;
+
+    return self;
+}
+
+#pragma mark - Primitives
+
+- (void)raiseMalformed
+{
+    [NSException raise:NSInvalidArchiveOperationException format:@"Malformed binary archive at offset: %zd", self.offset];
+}
+
+- (const uint8_t *)consumeLength:(NSUInteger)length
+{
+    if (length > self.length - self.offset) {
+        [self raiseMalformed];
+    }
+    const uint8_t *result = self.bytes + self.offset;
+    self.offset += length;
+    return result;
+}
+
+- (uint8_t)readByte
+{
+    return *[self consumeLength:1];
+}
+
+- (uint64_t)readVarint
+{
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = [self readByte];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return result;
+        }
+    }
+    [self raiseMalformed];
+    return 0;
+}
+
+- (NSUInteger)readLength
+{
+    uint64_t length = [self readVarint];
+    if (length > self.length - self.offset) {
+        [self raiseMalformed];
+    }
+    return (NSUInteger)length;
+}
+
+- (double)readDouble
+{
+    uint64_t bits;
+    memcpy(&bits, [self consumeLength:sizeof(bits)], sizeof(bits));
+    bits = CFSwapInt64LittleToHost(bits);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+- (NSString *)readString
+{
+    NSUInteger length = [self readLength];
+    NSString *_Nullable string =
+        [[NSString alloc] initWithBytes:[self consumeLength:length] length:length encoding:NSUTF8StringEncoding];
+    if (!string) {
+        [self raiseMalformed];
+    }
+    return string;
+}
+
+- (nullable NSString *)readKey
+{
+    uint64_t keyRef = [self readVarint];
+    if (keyRef == 0) {
+        return nil;
+    }
+    if (keyRef == 1) {
+        NSString *key = [self readString];
+        [self.keys addObject:key];
+        return key;
+    }
+    if (keyRef - 2 >= self.keys.count) {
+        [self raiseMalformed];
+    }
+    return self.keys[(NSUInteger)(keyRef - 2)];
+}
+
+- (Class)readClass
+{
+    uint64_t classRef = [self readVarint];
+    if (classRef > 0) {
+        if (classRef - 1 >= self.classes.count) {
+            [self raiseMalformed];
+        }
+        return self.classes[(NSUInteger)(classRef - 1)];
+    }
+
+    NSString *className = [self readString];
+    Class _Nullable cls = NSClassFromString(className);
+    if (!cls && self.unknownClassBlock) {
+        cls = self.unknownClassBlock(className);
+    }
+    if (!cls || ![cls conformsToProtocol:@protocol(NSCoding)]) {
+        [NSException raise:NSInvalidArchiveOperationException format:@"Cannot decode object of class: %@", className];
+    }
+    [self.classes addObject:cls];
+    return cls;
+}
+
+#pragma mark - Values
+
+- (nullable id)readValue
+{
+    if (++self.depth > kOWSBinaryArchiveMaxDepth) {
+        [self raiseMalformed];
+    }
+
+    id _Nullable value = nil;
+    OWSBinaryArchiveTag tag = [self readByte];
+    switch (tag) {
+        case OWSBinaryArchiveTagNil:
+            break;
+        case OWSBinaryArchiveTagFalse:
+            value = @NO;
+            break;
+        case OWSBinaryArchiveTagTrue:
+            value = @YES;
+            break;
+        case OWSBinaryArchiveTagInteger:
+            value = @(OWSZigZagDecode([self readVarint]));
+            break;
+        case OWSBinaryArchiveTagUnsignedInteger:
+            value = @([self readVarint]);
+            break;
+        case OWSBinaryArchiveTagDouble:
+            value = @([self readDouble]);
+            break;
+        case OWSBinaryArchiveTagString:
+            value = [self readString];
+            break;
+        case OWSBinaryArchiveTagMutableString:
+            value = [[self readString] mutableCopy];
+            break;
+        case OWSBinaryArchiveTagData:
+        case OWSBinaryArchiveTagMutableData: {
+            NSUInteger length = [self readLength];
+            const uint8_t *bytes = [self consumeLength:length];
+            value = (tag == OWSBinaryArchiveTagData ? [NSData dataWithBytes:bytes length:length]
+                                                    : [NSMutableData dataWithBytes:bytes length:length]);
+            break;
+        }
+        case OWSBinaryArchiveTagDate:
+            value = [NSDate dateWithTimeIntervalSinceReferenceDate:[self readDouble]];
+            break;
+        case OWSBinaryArchiveTagNull:
+            value = [NSNull null];
+            break;
+        case OWSBinaryArchiveTagArray:
+        case OWSBinaryArchiveTagMutableArray: {
+            NSUInteger count = [self readLength];
+            NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+            for (NSUInteger i = 0; i < count; i++) {
+                [array addObject:[self readNonNilValue]];
+            }
+            value = (tag == OWSBinaryArchiveTagArray ? [array copy] : array);
+            break;
+        }
+        case OWSBinaryArchiveTagDictionary:
+        case OWSBinaryArchiveTagMutableDictionary: {
+            NSUInteger count = [self readLength];
+            NSMutableDictionary *dictionary = [NSMutableDictionary dictionaryWithCapacity:count];
+            for (NSUInteger i = 0; i < count; i++) {
+                id dictionaryKey = [self readNonNilValue];
+                id dictionaryValue = [self readNonNilValue];
+                dictionary[dictionaryKey] = dictionaryValue;
+            }
+            value = (tag == OWSBinaryArchiveTagDictionary ? [dictionary copy] : dictionary);
+            break;
+        }
+        case OWSBinaryArchiveTagSet:
+        case OWSBinaryArchiveTagMutableSet: {
+            NSUInteger count = [self readLength];
+            NSMutableSet *set = [NSMutableSet setWithCapacity:count];
+            for (NSUInteger i = 0; i < count; i++) {
+                [set addObject:[self readNonNilValue]];
+            }
+            value = (tag == OWSBinaryArchiveTagSet ? [set copy] : set);
+            break;
+        }
+        case OWSBinaryArchiveTagObject:
+            value = [self readObject];
+            break;
+        default:
+            [self raiseMalformed];
+    }
+
+    self.depth--;
+    return value;
+}
+
+- (id)readNonNilValue
+{
+    id _Nullable value = [self readValue];
+    if (!value) {
+        [self raiseMalformed];
+    }
+    return value;
+}
+
+- (nullable id)readObject
+{
+    Class cls = [self readClass];
+
+    // Fields are decoded up front, so nested objects are fully initialized before their parent.
+    NSMutableDictionary<NSString *, id> *frame = [NSMutableDictionary new];
+    NSString *_Nullable key;
+    while ((key = [self readKey])) {
+        id _Nullable fieldValue = [self readValue];
+        if (fieldValue) {
+            frame[key] = fieldValue;
+        }
+    }
+
+    [self.frames addObject:frame];
+    id _Nullable object = [(id<NSCoding>)[cls alloc] initWithCoder:self];
+    [self.frames removeLastObject];
+
+    return [object awakeAfterUsingCoder:self];
+}
+
+- (nullable id)fieldForKey:(NSString *)key
+{
+    NSDictionary<NSString *, id> *_Nullable frame = self.frames.lastObject;
+    if (!frame) {
+        [NSException raise:NSInvalidArchiveOperationException format:@"Keyed value decoded outside of an object: %@", key];
+    }
+    return frame[key];
+}
+
+- (nullable NSNumber *)numberForKey:(NSString *)key
+{
+    id _Nullable value = [self fieldForKey:key];
+    return ([value isKindOfClass:[NSNumber class]] ? value : nil);
+}
+
+#pragma mark - NSCoder
+
+- (BOOL)allowsKeyedCoding
+{
+    return YES;
+}
+
+- (BOOL)requiresSecureCoding
+{
+    return NO;
+}
+
+- (BOOL)containsValueForKey:(NSString *)key
+{
+    return [self fieldForKey:key] != nil;
+}
+
+- (nullable id)decodeObjectForKey:(NSString *)key
+{
+    return [self fieldForKey:key];
+}
+
+- (nullable id)decodeObjectOfClass:(Class)aClass forKey:(NSString *)key
+{
+    return [self fieldForKey:key];
+}
+
+- (nullable id)decodeObjectOfClasses:(nullable NSSet<Class> *)classes forKey:(NSString *)key
+{
+    return [self fieldForKey:key];
+}
+
+- (BOOL)decodeBoolForKey:(NSString *)key
+{
+    return [self numberForKey:key].boolValue;
+}
+
+- (int)decodeIntForKey:(NSString *)key
+{
+    return [self numberForKey:key].intValue;
+}
+
+- (int32_t)decodeInt32ForKey:(NSString *)key
+{
+    return [self numberForKey:key].intValue;
+}
+
+- (int64_t)decodeInt64ForKey:(NSString *)key
+{
+    return [self numberForKey:key].longLongValue;
+}
+
+- (NSInteger)decodeIntegerForKey:(NSString *)key
+{
+    return [self numberForKey:key].integerValue;
+}
+
+- (float)decodeFloatForKey:(NSString *)key
+{
+    return [self numberForKey:key].floatValue;
+}
+
+- (double)decodeDoubleForKey:(NSString *)key
+{
+    return [self numberForKey:key].doubleValue;
+}
+
+- (nullable const uint8_t *)decodeBytesForKey:(NSString *)key returnedLength:(nullable NSUInteger *)lengthp
+{
+    id _Nullable value = [self fieldForKey:key];
+    NSData *_Nullable data = ([value isKindOfClass:[NSData class]] ? value : nil);
+    if (lengthp) {
+        *lengthp = data.length;
+    }
+    // The frame retains the data until the enclosing initWithCoder: returns, matching NSKeyedUnarchiver.
+    return data.bytes;
+}
+
+- (void)decodeValueOfObjCType:(const char *)type at:(void *)data
+{
+    [NSException raise:NSInvalidArchiveOperationException format:@"%@ only supports keyed coding", self.class];
+}
+
+- (nullable NSData *)decodeDataObject
+{
+    [NSException raise:NSInvalidArchiveOperationException format:@"%@ only supports keyed coding", self.class];
+    return nil;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,72 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class YapDatabase;
+@class YapDatabaseReadTransaction;
+
+// A point-in-time copy of a pool's telemetry.
+@interface OWSDatabaseConnectionPoolStats : NSObject
+
+// The number of read transactions executed through the pool.
+@property (nonatomic, readonly) NSUInteger readCount;
+
+// The number of reads which found no idle connection and had to wait for one.
+@property (nonatomic, readonly) NSUInteger waitCount;
+
+// Time spent waiting for an idle connection, summed over all reads, and the longest single wait.
+@property (nonatomic, readonly) NSTimeInterval totalWaitTime;
+@property (nonatomic, readonly) NSTimeInterval maxWaitTime;
+
+// The number of connections the pool currently owns, and the most reads it has had in flight at once.
+@property (nonatomic, readonly) NSUInteger connectionCount;
+@property (nonatomic, readonly) NSUInteger peakConcurrentReads;
+
+@end
+
+#pragma mark -
+
+// Hands out idle read-only connections so that reads on different threads can run in parallel
+// (sqlite's WAL mode allows any number of concurrent readers), rather than serializing on the
+// queue of a single shared connection.
+//
+// Every read gets its own transaction, so it sees a consistent snapshot that includes every
+// commit which completed before the read began; this is the same guarantee as a read on any
+// other connection. Reads should not rely on running on a particular connection, and should
+// not be used to begin long-lived read transactions.
+//
+// Connections are created lazily, up to maxConnections. Each one gets an equal share of the
+// pool's cache budget, so the pool's memory use doesn't grow with its size. A read issued from
+// within another pool read on the same thread never waits, since the outer read may be the one
+// holding the connection it would wait for; if the pool is exhausted, it gets a temporary
+// connection instead.
+@interface OWSDatabaseConnectionPool : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+// objectCacheCostLimit is the budget for the whole pool (see -[YapDatabaseConnection objectCacheCostLimit]).
+- (instancetype)initWithDatabase:(YapDatabase *)database
+                  maxConnections:(NSUInteger)maxConnections
+            objectCacheCostLimit:(NSUInteger)objectCacheCostLimit NS_DESIGNATED_INITIALIZER;
+
+@property (nonatomic, readonly) NSUInteger maxConnections;
+
+// Synchronous; blocks until a connection is available and the read has completed.
+- (void)readWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block;
+
+// Asynchronous reads may run concurrently with (and so complete in a different order than)
+// other asynchronous reads. The completion block is invoked on the main queue.
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block;
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+           completionBlock:(nullable dispatch_block_t)completionBlock;
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+           completionQueue:(nullable dispatch_queue_t)completionQueue
+           completionBlock:(nullable dispatch_block_t)completionBlock;
+
+- (OWSDatabaseConnectionPoolStats *)stats;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,260 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+#import "OWSDatabaseConnectionPool.h"
+#import <YapDatabase/YapDatabase.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// No connection's cache should be so small that it's useless, however large the pool.
+static const NSUInteger kMinimumObjectCacheCostLimit = 128 * 1024;
+
+// Waits longer than this are logged, since they mean the pool is too small for its readers.
+static const NSTimeInterval kSlowWaitThreshold = 0.1;
+
+@interface OWSDatabaseConnectionPoolStats ()
+
+@property (nonatomic) NSUInteger readCount;
+@property (nonatomic) NSUInteger waitCount;
+@property (nonatomic) NSTimeInterval totalWaitTime;
+@property (nonatomic) NSTimeInterval maxWaitTime;
+@property (nonatomic) NSUInteger connectionCount;
+@property (nonatomic) NSUInteger peakConcurrentReads;
+
+@end
+
+#pragma mark -
+
+@implementation OWSDatabaseConnectionPoolStats
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ reads: %lu, waits: %lu, totalWait: %.3fs, maxWait: %.3fs, connections: %lu, "
+                                      @"peakConcurrentReads: %lu>",
+                     self.class,
+                     (unsigned long)self.readCount,
+                     (unsigned long)self.waitCount,
+                     self.totalWaitTime,
+                     self.maxWaitTime,
+                     (unsigned long)self.connectionCount,
+                     (unsigned long)self.peakConcurrentReads];
+}
+
+@end
+
+#pragma mark -
+
+@interface OWSDatabaseConnectionPool ()
+
+@property (nonatomic, readonly, weak) YapDatabase *database;
+@property (nonatomic, readonly) NSUInteger connectionObjectCacheCostLimit;
+@property (nonatomic, readonly) dispatch_queue_t asyncReadQueue;
+
+// Key into -[NSThread threadDictionary] for the number of pool reads in progress on a thread.
+@property (nonatomic, readonly) NSString *threadDepthKey;
+
+// All of the following are guarded by `condition`.
+@property (nonatomic, readonly) NSCondition *condition;
+@property (nonatomic, readonly) NSMutableArray<YapDatabaseConnection *> *idleConnections;
+@property (nonatomic) NSUInteger connectionCount;
+@property (nonatomic) NSUInteger activeReadCount;
+@property (nonatomic, readonly) OWSDatabaseConnectionPoolStats *mutableStats;
+
+@end
+
+#pragma mark -
+
+@implementation OWSDatabaseConnectionPool
+
+- (instancetype)initWithDatabase:(YapDatabase *)database
+                  maxConnections:(NSUInteger)maxConnections
+            objectCacheCostLimit:(NSUInteger)objectCacheCostLimit
+{
+    self = [super init];
+    if (!self) {
+        return self;
+    }
+
+    OWSAssert(database);
+    OWSAssert(maxConnections > 0);
+
+    _database = database;
+    _maxConnections = MAX(maxConnections, (NSUInteger)1);
+    _connectionObjectCacheCostLimit = MAX(objectCacheCostLimit / _maxConnections, kMinimumObjectCacheCostLimit);
+    _asyncReadQueue = dispatch_queue_create("org.whispersystems.signal.readPool", DISPATCH_QUEUE_CONCURRENT);
+    _threadDepthKey = [NSString stringWithFormat:@"%@.%p.depth", self.class, self];
+
+    _condition = [NSCondition new];
+    _idleConnections = [NSMutableArray new];
+    _mutableStats = [OWSDatabaseConnectionPoolStats new];
+
+    return self;
+}
+
+#pragma mark - Reads
+
+- (void)readWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+{
+    OWSAssert(block);
+
+    NSMutableDictionary *threadDictionary = [NSThread currentThread].threadDictionary;
+    NSUInteger depth = [threadDictionary[self.threadDepthKey] unsignedIntegerValue];
+
+    YapDatabaseConnection *connection = [self acquireConnectionIsNested:(depth > 0)];
+    if (!connection) {
+        DDLogError(@"%@ Database has been closed; skipping read.", self.tag);
+        return;
+    }
+
+    threadDictionary[self.threadDepthKey] = @(depth + 1);
+    [connection readWithBlock:block];
+    threadDictionary[self.threadDepthKey] = depth > 0 ? @(depth) : nil;
+
+    [self releaseConnection:connection];
+}
+
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+{
+    [self asyncReadWithBlock:block completionQueue:nil completionBlock:nil];
+}
+
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+           completionBlock:(nullable dispatch_block_t)completionBlock
+{
+    [self asyncReadWithBlock:block completionQueue:nil completionBlock:completionBlock];
+}
+
+- (void)asyncReadWithBlock:(void (^)(YapDatabaseReadTransaction *transaction))block
+           completionQueue:(nullable dispatch_queue_t)completionQueue
+           completionBlock:(nullable dispatch_block_t)completionBlock
+{
+    OWSAssert(block);
+
+    dispatch_queue_t queue = completionQueue ?: dispatch_get_main_queue();
+
+    dispatch_async(self.asyncReadQueue, ^{
+        [self readWithBlock:block];
+
+        if (completionBlock) {
+            dispatch_async(queue, completionBlock);
+        }
+    });
+}
+
+#pragma mark - Connections
+
+- (nullable YapDatabaseConnection *)acquireConnectionIsNested:(BOOL)isNested
+{
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    BOOL didWait = NO;
+    BOOL shouldCreateConnection = NO;
+    YapDatabaseConnection *_Nullable connection = nil;
+
+    [self.condition lock];
+    while (YES) {
+        connection = [self.idleConnections lastObject];
+        if (connection) {
+            [self.idleConnections removeLastObject];
+            break;
+        }
+        if (self.connectionCount < self.maxConnections || isNested) {
+            self.connectionCount++;
+            shouldCreateConnection = YES;
+            break;
+        }
+        didWait = YES;
+        [self.condition wait];
+    }
+
+    NSTimeInterval waitTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    self.activeReadCount++;
+    OWSDatabaseConnectionPoolStats *stats = self.mutableStats;
+    stats.readCount++;
+    stats.peakConcurrentReads = MAX(stats.peakConcurrentReads, self.activeReadCount);
+    if (didWait) {
+        stats.waitCount++;
+        stats.totalWaitTime += waitTime;
+        stats.maxWaitTime = MAX(stats.maxWaitTime, waitTime);
+    }
+    [self.condition unlock];
+
+    if (didWait && waitTime > kSlowWaitThreshold) {
+        DDLogWarn(@"%@ Waited %.3fs for a read connection (%lu connections).",
+            self.tag,
+            waitTime,
+            (unsigned long)self.maxConnections);
+    }
+
+    if (shouldCreateConnection) {
+        connection = [self newConnection];
+
+        if (!connection) {
+            [self.condition lock];
+            self.connectionCount--;
+            self.activeReadCount--;
+            [self.condition signal];
+            [self.condition unlock];
+        }
+    }
+
+    return connection;
+}
+
+- (void)releaseConnection:(YapDatabaseConnection *)connection
+{
+    [self.condition lock];
+    self.activeReadCount--;
+    if (self.connectionCount > self.maxConnections) {
+        // A temporary connection created for a nested read; let it go.
+        self.connectionCount--;
+    } else {
+        [self.idleConnections addObject:connection];
+        [self.condition signal];
+    }
+    [self.condition unlock];
+}
+
+- (nullable YapDatabaseConnection *)newConnection
+{
+    YapDatabaseConnection *connection = [self.database newConnection];
+    connection.name = [NSString stringWithFormat:@"%@ read pool", self.database.databasePath.lastPathComponent];
+    connection.objectCacheCostLimit = self.connectionObjectCacheCostLimit;
+
+    return connection;
+}
+
+#pragma mark - Telemetry
+
+- (OWSDatabaseConnectionPoolStats *)stats
+{
+    OWSDatabaseConnectionPoolStats *stats = [OWSDatabaseConnectionPoolStats new];
+
+    [self.condition lock];
+    stats.readCount = self.mutableStats.readCount;
+    stats.waitCount = self.mutableStats.waitCount;
+    stats.totalWaitTime = self.mutableStats.totalWaitTime;
+    stats.maxWaitTime = self.mutableStats.maxWaitTime;
+    stats.peakConcurrentReads = self.mutableStats.peakConcurrentReads;
+    stats.connectionCount = self.connectionCount;
+    [self.condition unlock];
+
+    return stats;
+}
+
+#pragma mark - Logging
+
++ (NSString *)tag
+{
+    return [NSString stringWithFormat:@"[%@]", self.class];
+}
+
+- (NSString *)tag
+{
+    return self.class.tag;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -95,6 +95,9 @@ NSString *const OWSIncomingMessageFinderColumnSourceDeviceId = @"OWSIncomingMess
 - (void)asyncRegisterExtension
 {
     DDLogInfo(@"%@ registering async.", self.tag);
+    // Unlike the other async extensions, this index is populated during registration, not in batches
+    // afterwards: incoming messages are de-duplicated against it, so it must be complete before
+    // message processing starts.
     [self.database asyncRegisterExtension:self.indexExtension
                                  withName:OWSIncomingMessageFinderExtensionName
                           completionBlock:^(BOOL ready) {
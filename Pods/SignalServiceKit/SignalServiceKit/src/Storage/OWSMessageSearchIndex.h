@@ -0,0 +1,69 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+NS_ASSUME_NONNULL_BEGIN
+
+extern NSString *const OWSMessageSearchIndexExtensionName;
+
+@class YapDatabase;
+@class YapDatabaseFullTextSearchSnippetOptions;
+@class YapDatabaseReadTransaction;
+
+@interface OWSMessageSearchResult : NSObject
+
+// Identifies the match across pages of results for the same search.
+@property (nonatomic, readonly) int64_t rowid;
+
+// [TSInteraction collection] for a message, or [TSThread collection] for a thread whose name or
+// contact address matched.
+@property (nonatomic, readonly) NSString *collection;
+@property (nonatomic, readonly) NSString *uniqueId;
+
+// The best matching text, with the matches wrapped in the snippet options' startMatchText and endMatchText.
+@property (nonatomic, readonly) NSString *snippet;
+
+@end
+
+#pragma mark -
+
+// A full text (FTS5) index over message bodies, including the text of SOFA messages and the addresses
+// in SOFA payments, and over group names and contact thread addresses.
+//
+// Text is tokenized with YapDatabaseFullTextSearchUnicodeTokenizer, so searches ignore case and
+// diacritics, emoji can be searched for, and addresses match with or without their "0x" prefix.
+//
+// Registering the extension doesn't index anything. The messages which predate it are indexed
+// afterwards by the extension's batched population (see TSDatabaseExtensionPopulationBatchSize), so that
+// neither launch nor message processing waits on it. Messages written after registration are indexed
+// as they're written.
+@interface OWSMessageSearchIndex : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+- (instancetype)initWithDatabase:(YapDatabase *)database NS_DESIGNATED_INITIALIZER;
+
+// Registers the extension, then indexes the existing messages in the background.
+- (void)asyncRegisterExtension;
+
+// Only use the sync version for testing; it indexes the existing messages within the registration transaction.
+- (void)blockingRegisterExtension;
+
+// YES once every message which predates the extension has been indexed.
+- (BOOL)hasIndexedExistingMessagesWithTransaction:(YapDatabaseReadTransaction *)transaction;
+
+// Returns up to `limit` matches for searchText, best first, after skipping the first `offset`.
+// Every word of searchText must match (the last one as a prefix, for search-as-you-type).
+// Until hasIndexedExistingMessagesWithTransaction: returns YES, older messages may be missing.
+- (NSArray<OWSMessageSearchResult *> *)resultsForSearchText:(NSString *)searchText
+                                                   offset:(NSUInteger)offset
+                                                    limit:(NSUInteger)limit
+                                           snippetOptions:(nullable YapDatabaseFullTextSearchSnippetOptions *)snippetOptions
+                                              transaction:(YapDatabaseReadTransaction *)transaction;
+
+// Converts user input into an FTS5 query. Every word is quoted, so that punctuation is never mistaken
+// for query syntax, and the last word is made a prefix query. Returns nil if there are no words.
++ (nullable NSString *)queryForSearchText:(NSString *)searchText;
+
+@end
+
+NS_ASSUME_NONNULL_END
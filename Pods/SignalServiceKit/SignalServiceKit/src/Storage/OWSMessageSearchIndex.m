@@ -0,0 +1,287 @@
+//
+//  Copyright (c) 2017 Open Whisper Systems. All rights reserved.
+//
+
+#import "OWSMessageSearchIndex.h"
+#import "TSContactThread.h"
+#import "TSGroupModel.h"
+#import "TSGroupThread.h"
+#import "TSMessage.h"
+#import "TSStorageManager.h"
+#import <YapDatabase/YapDatabase.h>
+#import <YapDatabase/YapDatabaseFullTextSearch.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+NSString *const OWSMessageSearchIndexExtensionName = @"OWSMessageSearchIndexExtensionName";
+
+static NSString *const OWSMessageSearchIndexColumnBody = @"body";
+static NSString *const OWSMessageSearchIndexColumnName = @"name";
+static NSString *const OWSMessageSearchIndexColumnAddress = @"address";
+
+// Bump this after changing what gets indexed; the index will be rebuilt from scratch.
+//
+// Version 1 was filled in by hand rather than by the extension's batched population, and may be incomplete.
+static NSString *const OWSMessageSearchIndexVersionTag = @"2";
+
+// SOFA message bodies look like "SOFA::Message:{...json...}".
+static NSString *const OWSSofaPrefix = @"SOFA::";
+
+@interface OWSMessageSearchResult ()
+
+@property (nonatomic) int64_t rowid;
+@property (nonatomic) NSString *collection;
+@property (nonatomic) NSString *uniqueId;
+@property (nonatomic) NSString *snippet;
+
+@end
+
+#pragma mark -
+
+@implementation OWSMessageSearchResult
+
+@end
+
+#pragma mark -
+
+@interface OWSMessageSearchIndex ()
+
+@property (nonatomic, readonly) YapDatabase *database;
+
+@end
+
+#pragma mark -
+
+@implementation OWSMessageSearchIndex
+
+- (instancetype)initWithDatabase:(YapDatabase *)database
+{
+    self = [super init];
+    if (!self) {
+        return self;
+    }
+
+    OWSAssert(database);
+
+    _database = database;
+
+    return self;
+}
+
+#pragma mark - YAP integration
+
++ (YapDatabaseFullTextSearch *)indexExtension
+{
+    // Touching a row doesn't change its text, so only modifications need to be indexed.
+    YapDatabaseFullTextSearchHandler *handler = [YapDatabaseFullTextSearchHandler
+        withOptions:YapDatabaseBlockInvokeIfObjectModified
+        objectBlock:^(NSMutableDictionary *dict, NSString *collection, NSString *key, id object) {
+            if ([object isKindOfClass:[TSMessage class]]) {
+                [self addColumnsForMessage:(TSMessage *)object toDictionary:dict];
+            } else if ([object isKindOfClass:[TSThread class]]) {
+                [self addColumnsForThread:(TSThread *)object toDictionary:dict];
+            }
+        }];
+
+    NSString *tokenize =
+        [NSString stringWithFormat:@"'%@ remove_diacritics 1'", YapDatabaseFullTextSearchUnicodeTokenizer];
+
+    YapDatabaseFullTextSearch *extension = [[YapDatabaseFullTextSearch alloc] initWithColumnNames:@[
+        OWSMessageSearchIndexColumnBody,
+        OWSMessageSearchIndexColumnName,
+        OWSMessageSearchIndexColumnAddress,
+    ]
+                                                                                        options:@{ @"tokenize" : tokenize }
+                                                                                        handler:handler
+                                                                                     ftsVersion:YapDatabaseFullTextSearchFTS5Version
+                                                                                     versionTag:OWSMessageSearchIndexVersionTag];
+
+    return extension;
+}
+
++ (void)addColumnsForMessage:(TSMessage *)message toDictionary:(NSMutableDictionary *)dict
+{
+    NSString *_Nullable body = message.body;
+    if (body.length < 1) {
+        return;
+    }
+
+    if (![body hasPrefix:OWSSofaPrefix]) {
+        dict[OWSMessageSearchIndexColumnBody] = body;
+        return;
+    }
+
+    // The SOFA type runs from the prefix up to the next colon, and is followed by the JSON payload.
+    NSRange typeRange = NSMakeRange(OWSSofaPrefix.length, body.length - OWSSofaPrefix.length);
+    NSRange separatorRange = [body rangeOfString:@":" options:NSLiteralSearch range:typeRange];
+    if (separatorRange.location == NSNotFound) {
+        return;
+    }
+    typeRange.length = separatorRange.location - typeRange.location;
+    NSString *type = [body substringWithRange:typeRange];
+
+    NSData *_Nullable jsonData =
+        [[body substringFromIndex:NSMaxRange(separatorRange)] dataUsingEncoding:NSUTF8StringEncoding];
+    id _Nullable json = jsonData ? [NSJSONSerialization JSONObjectWithData:jsonData options:0 error:nil] : nil;
+    if (![json isKindOfClass:[NSDictionary class]]) {
+        return;
+    }
+
+    // Only the parts of a SOFA message that are shown to the user are worth searching;
+    // init requests, statuses and the like are skipped altogether.
+    NSArray<NSString *> *textKeys = @[];
+    NSArray<NSString *> *addressKeys = @[];
+    if ([type isEqualToString:@"Message"] || [type isEqualToString:@"Command"]) {
+        textKeys = @[ @"body" ];
+    } else if ([type isEqualToString:@"PaymentRequest"]) {
+        textKeys = @[ @"body" ];
+        addressKeys = @[ @"destinationAddress" ];
+    } else if ([type isEqualToString:@"Payment"]) {
+        addressKeys = @[ @"toAddress", @"fromAddress" ];
+    }
+
+    NSString *_Nullable text = [self joinedStringsForKeys:textKeys inJSON:json];
+    if (text) {
+        dict[OWSMessageSearchIndexColumnBody] = text;
+    }
+    NSString *_Nullable addresses = [self joinedStringsForKeys:addressKeys inJSON:json];
+    if (addresses) {
+        dict[OWSMessageSearchIndexColumnAddress] = addresses;
+    }
+}
+
++ (void)addColumnsForThread:(TSThread *)thread toDictionary:(NSMutableDictionary *)dict
+{
+    // Contact display names live in the app's own database, so contact threads are found by address.
+    if ([thread isKindOfClass:[TSGroupThread class]]) {
+        NSString *_Nullable groupName = ((TSGroupThread *)thread).groupModel.groupName;
+        if (groupName.length > 0) {
+            dict[OWSMessageSearchIndexColumnName] = groupName;
+        }
+    } else if ([thread isKindOfClass:[TSContactThread class]]) {
+        NSString *_Nullable contactIdentifier = thread.contactIdentifier;
+        if (contactIdentifier.length > 0) {
+            dict[OWSMessageSearchIndexColumnAddress] = contactIdentifier;
+        }
+    }
+}
+
++ (nullable NSString *)joinedStringsForKeys:(NSArray<NSString *> *)keys inJSON:(NSDictionary *)json
+{
+    NSMutableArray<NSString *> *strings = [NSMutableArray new];
+    for (NSString *key in keys) {
+        id _Nullable value = json[key];
+        if ([value isKindOfClass:[NSString class]] && [(NSString *)value length] > 0) {
+            [strings addObject:value];
+        }
+    }
+
+    return strings.count > 0 ? [strings componentsJoinedByString:@" "] : nil;
+}
+
+- (void)asyncRegisterExtension
+{
+    DDLogInfo(@"%@ registering async.", self.tag);
+
+    // Indexing every existing message during registration would mean one very long write transaction,
+    // so they're indexed in batches afterwards instead.
+    YapDatabaseFullTextSearch *extension = [self.class indexExtension];
+    extension.populationBatchSize = TSDatabaseExtensionPopulationBatchSize;
+
+    [self.database asyncRegisterExtension:extension
+                                 withName:OWSMessageSearchIndexExtensionName
+                          completionBlock:^(BOOL ready) {
+                              if (!ready) {
+                                  DDLogError(@"%@ failed to register extension.", self.tag);
+                                  return;
+                              }
+                              DDLogInfo(@"%@ finished registering async.", self.tag);
+                          }];
+}
+
+- (void)blockingRegisterExtension
+{
+    [self.database registerExtension:[self.class indexExtension] withName:OWSMessageSearchIndexExtensionName];
+}
+
+- (BOOL)hasIndexedExistingMessagesWithTransaction:(YapDatabaseReadTransaction *)transaction
+{
+    YapDatabaseFullTextSearchTransaction *_Nullable ext = [transaction ext:OWSMessageSearchIndexExtensionName];
+
+    return ext != nil && ext.isPopulated;
+}
+
+#pragma mark - Searching
+
+- (NSArray<OWSMessageSearchResult *> *)resultsForSearchText:(NSString *)searchText
+                                                   offset:(NSUInteger)offset
+                                                    limit:(NSUInteger)limit
+                                           snippetOptions:(nullable YapDatabaseFullTextSearchSnippetOptions *)snippetOptions
+                                              transaction:(YapDatabaseReadTransaction *)transaction
+{
+    NSString *_Nullable query = [self.class queryForSearchText:searchText];
+    if (!query) {
+        return @[];
+    }
+
+    YapDatabaseFullTextSearchTransaction *_Nullable ext = [transaction ext:OWSMessageSearchIndexExtensionName];
+    if (!ext) {
+        DDLogWarn(@"%@ searching before the extension has been registered.", self.tag);
+        return @[];
+    }
+
+    NSMutableArray<OWSMessageSearchResult *> *results = [NSMutableArray new];
+    [ext enumerateBm25OrderedKeysMatching:query
+                              withWeights:nil
+                           snippetOptions:snippetOptions
+                                   offset:offset
+                                    limit:limit
+                               usingBlock:^(
+                                   NSString *snippet, int64_t rowid, NSString *collection, NSString *key, BOOL *stop) {
+                                   OWSMessageSearchResult *result = [OWSMessageSearchResult new];
+                                   result.rowid = rowid;
+                                   result.collection = collection;
+                                   result.uniqueId = key;
+                                   result.snippet = snippet;
+                                   [results addObject:result];
+                               }];
+
+    return [results copy];
+}
+
++ (nullable NSString *)queryForSearchText:(NSString *)searchText
+{
+    NSMutableArray<NSString *> *terms = [NSMutableArray new];
+    for (NSString *word in
+        [searchText componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]]) {
+        if (word.length < 1) {
+            continue;
+        }
+        NSString *escapedWord = [word stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""];
+        [terms addObject:[NSString stringWithFormat:@"\"%@\"", escapedWord]];
+    }
+
+    if (terms.count < 1) {
+        return nil;
+    }
+
+    terms[terms.count - 1] = [terms.lastObject stringByAppendingString:@"*"];
+
+    return [terms componentsJoinedByString:@" "];
+}
+
+#pragma mark - Logging
+
++ (NSString *)tag
+{
+    return [NSString stringWithFormat:@"[%@]", self.class];
+}
+
+- (NSString *)tag
+{
+    return self.class.tag;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -12,6 +12,8 @@ NS_ASSUME_NONNULL_BEGIN
 //   it's attachments might not be cleaned up until the next pass.
 //   If an attachment is cleaned up, it's file on disk might not
 //   be cleaned up until the next pass.
+// * Audits are scanned in chunks and their progress is persisted, so an audit
+//   interrupted by suspension or termination resumes on the next call.
 @interface OWSOrphanedDataCleaner : NSObject
 
 - (instancetype)init NS_UNAVAILABLE;
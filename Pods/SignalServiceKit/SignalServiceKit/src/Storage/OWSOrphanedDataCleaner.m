@@ -9,6 +9,9 @@
 #import "TSMessage.h"
 #import "TSStorageManager.h"
 #import "TSThread.h"
+#import "TSYapDatabaseObject.h"
+#import <YapDatabase/YapDatabaseConnection.h>
+#import <YapDatabase/YapDatabaseTransaction.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -20,18 +23,162 @@ NS_ASSUME_NONNULL_BEGIN
 #define CleanupLogInfo DDLogInfo
 #endif
 
+// We need to avoid cleaning up new attachments and files that are still in the process of
+// being created/written, so we don't clean up anything created shortly before the audit began.
+#ifdef SSK_BUILDING_FOR_TESTS
+static const NSTimeInterval kMinimumOrphanAge = 0.f;
+#else
+static const NSTimeInterval kMinimumOrphanAge = 15 * kMinuteInterval;
+#endif
+
+// Rows scanned per read transaction.
+static const NSUInteger kOrphanScanChunkSize = 500;
+// Scanned chunks between persisted checkpoints; an interrupted audit repeats at most this many.
+static const NSUInteger kOrphanCheckpointChunkInterval = 20;
+// Orphans removed per read-write transaction.
+static const NSUInteger kOrphanRemovalBatchSize = 50;
+// A persisted audit older than this is discarded rather than resumed.
+static const NSTimeInterval kOrphanMaxResumableAuditAge = kDayInterval;
+
+static NSString *const OWSOrphanedDataCleanerStateId = @"OWSOrphanedDataCleanerState";
+
+typedef NS_ENUM(NSUInteger, OWSOrphanedDataCleanerPhase) {
+    OWSOrphanedDataCleanerPhaseScanMessages = 0,
+    OWSOrphanedDataCleanerPhaseScanAttachments,
+    OWSOrphanedDataCleanerPhaseRemoveOrphans,
+    OWSOrphanedDataCleanerPhaseScanFiles,
+};
+
+#pragma mark - Hashes
+
+// Referenced attachment ids and file paths are tracked as sorted arrays of 64-bit hashes
+// rather than string sets: 8 bytes per entry and trivially persisted.
+//
+// A hash collision can only make an orphan look referenced, in which case it isn't cleaned up.
+// It can never cause referenced data to be removed.
+
+static uint64_t OWSOrphanHash(NSString *string)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *c = string.UTF8String; c && *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void OWSOrphanHashesAppend(NSMutableData *hashes, NSString *string)
+{
+    uint64_t hash = OWSOrphanHash(string);
+    [hashes appendBytes:&hash length:sizeof(hash)];
+}
+
+static int OWSOrphanHashCompare(const void *lhs, const void *rhs)
+{
+    uint64_t left = *(const uint64_t *)lhs;
+    uint64_t right = *(const uint64_t *)rhs;
+    return (left < right) ? -1 : (left > right ? 1 : 0);
+}
+
+static void OWSOrphanHashesSort(NSMutableData *hashes)
+{
+    if (hashes.length == 0) {
+        return;
+    }
+    qsort(hashes.mutableBytes, hashes.length / sizeof(uint64_t), sizeof(uint64_t), OWSOrphanHashCompare);
+}
+
+static BOOL OWSOrphanHashesContain(NSData *sortedHashes, NSString *string)
+{
+    if (sortedHashes.length == 0) {
+        return NO;
+    }
+    uint64_t hash = OWSOrphanHash(string);
+    return bsearch(
+               &hash, sortedHashes.bytes, sortedHashes.length / sizeof(uint64_t), sizeof(uint64_t), OWSOrphanHashCompare)
+        != NULL;
+}
+
+#pragma mark -
+
+// The progress of an audit, persisted so that it can resume after the app is suspended or terminated.
+@interface OWSOrphanedDataCleanerState : TSYapDatabaseObject
+
+@property (nonatomic) OWSOrphanedDataCleanerPhase phase;
+// The rowid scanned up to in the current phase's collection.
+@property (nonatomic) int64_t cursor;
+@property (nonatomic) BOOL shouldCleanup;
+@property (nonatomic) NSDate *auditStartDate;
+
+@property (nonatomic) NSMutableData *referencedAttachmentIdHashes;
+@property (nonatomic) NSMutableData *attachmentFilePathHashes;
+@property (nonatomic) NSMutableArray<NSString *> *orphanInteractionIds;
+@property (nonatomic) NSMutableArray<NSString *> *orphanAttachmentIds;
+
+@property (nonatomic) NSUInteger attachmentStreamCount;
+@property (nonatomic) NSUInteger missingAttachmentFileCount;
+
+- (instancetype)initWithShouldCleanup:(BOOL)shouldCleanup NS_DESIGNATED_INITIALIZER;
+- (nullable instancetype)initWithCoder:(NSCoder *)coder NS_DESIGNATED_INITIALIZER;
+- (instancetype)initWithUniqueId:(NSString *)uniqueId NS_UNAVAILABLE;
+
+@end
+
+#pragma mark -
+
+@implementation OWSOrphanedDataCleanerState
+
+- (instancetype)initWithShouldCleanup:(BOOL)shouldCleanup
+{
+    self = [super initWithUniqueId:OWSOrphanedDataCleanerStateId];
+    if (!self) {
+        return self;
+    }
+
+    _phase = OWSOrphanedDataCleanerPhaseScanMessages;
+    _shouldCleanup = shouldCleanup;
+    _auditStartDate = [NSDate new];
+    _referencedAttachmentIdHashes = [NSMutableData new];
+    _attachmentFilePathHashes = [NSMutableData new];
+    _orphanInteractionIds = [NSMutableArray new];
+    _orphanAttachmentIds = [NSMutableArray new];
+
+    return self;
+}
+
+- (nullable instancetype)initWithCoder:(NSCoder *)coder
+{
+    return [super initWithCoder:coder];
+}
+
+@end
+
+#pragma mark -
+
 @implementation OWSOrphanedDataCleaner
 
+// Audits share persisted state, so they must not run concurrently.
++ (dispatch_queue_t)serialQueue
+{
+    static dispatch_queue_t queue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("org.whispersystems.orphaned.data.cleaner", DISPATCH_QUEUE_SERIAL);
+    });
+    return queue;
+}
+
 + (void)auditAsync
 {
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+    dispatch_async(self.serialQueue, ^{
         [OWSOrphanedDataCleaner auditAndCleanup:NO completion:nil];
     });
 }
 
 + (void)auditAndCleanupAsync:(void (^_Nullable)())completion
 {
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+    dispatch_async(self.serialQueue, ^{
         [OWSOrphanedDataCleaner auditAndCleanup:YES completion:completion];
     });
 }
@@ -47,51 +194,112 @@ NS_ASSUME_NONNULL_BEGIN
 //   They can't be cleaned up - we don't want to delete the TSAttachmentStream or
 //   its corresponding message.  Better that the broken message shows up in the
 //   conversation view.
+//
+// Collections are scanned in rowid order, a chunk per read transaction, and orphans are removed
+// in small read-write transactions, so neither memory use nor writer stalls grow with the database.
 + (void)auditAndCleanup:(BOOL)shouldCleanup completion:(void (^_Nullable)())completion
 {
-    NSSet<NSString *> *diskFilePaths = [self filePathsInAttachmentsFolder];
-    long long totalFileSize = [self fileSizeOfFilePaths:diskFilePaths.allObjects];
-    NSUInteger fileCount = diskFilePaths.count;
+    YapDatabaseConnection *databaseConnection = [TSStorageManager sharedManager].newDatabaseConnection;
+
+    OWSOrphanedDataCleanerState *state = [self loadStateWithShouldCleanup:shouldCleanup connection:databaseConnection];
+
+    if (state.phase == OWSOrphanedDataCleanerPhaseScanMessages) {
+        [self scanMessagesWithState:state connection:databaseConnection];
+    }
+    if (state.phase == OWSOrphanedDataCleanerPhaseScanAttachments) {
+        [self scanAttachmentsWithState:state connection:databaseConnection];
+    }
+    if (state.phase == OWSOrphanedDataCleanerPhaseRemoveOrphans) {
+        [self removeOrphansWithState:state connection:databaseConnection];
+    }
+    if (state.phase == OWSOrphanedDataCleanerPhaseScanFiles) {
+        [self scanFilesWithState:state];
+    }
+
+    // The next audit starts from scratch.
+    [databaseConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
+        [state removeWithTransaction:transaction];
+    }];
+
+    if (completion) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion();
+        });
+    }
+}
 
-    TSStorageManager *storageManager = [TSStorageManager sharedManager];
-    YapDatabaseConnection *databaseConnection = storageManager.newDatabaseConnection;
+#pragma mark - State
 
-    __block int attachmentStreamCount = 0;
-    NSMutableSet<NSString *> *attachmentFilePaths = [NSMutableSet new];
-    NSMutableSet<NSString *> *attachmentIds = [NSMutableSet new];
++ (OWSOrphanedDataCleanerState *)loadStateWithShouldCleanup:(BOOL)shouldCleanup
+                                                 connection:(YapDatabaseConnection *)databaseConnection
+{
+    __block OWSOrphanedDataCleanerState *_Nullable state;
     [databaseConnection readWithBlock:^(YapDatabaseReadTransaction *_Nonnull transaction) {
-        [transaction enumerateKeysAndObjectsInCollection:TSAttachmentStream.collection
-                                              usingBlock:^(NSString *key, TSAttachment *attachment, BOOL *stop) {
-                                                  [attachmentIds addObject:attachment.uniqueId];
-                                                  if (![attachment isKindOfClass:[TSAttachmentStream class]]) {
-                                                      return;
-                                                  }
-                                                  TSAttachmentStream *attachmentStream
-                                                      = (TSAttachmentStream *)attachment;
-                                                  attachmentStreamCount++;
-                                                  NSString *_Nullable filePath = [attachmentStream filePath];
-                                                  OWSAssert(filePath);
-                                                  [attachmentFilePaths addObject:filePath];
-                                              }];
+        state = [OWSOrphanedDataCleanerState fetchObjectWithUniqueID:OWSOrphanedDataCleanerStateId
+                                                         transaction:transaction];
     }];
 
-    CleanupLogDebug(@"fileCount: %zd", fileCount);
-    CleanupLogDebug(@"totalFileSize: %lld", totalFileSize);
-    CleanupLogDebug(@"attachmentStreams: %d", attachmentStreamCount);
-    CleanupLogDebug(@"attachmentStreams with file paths: %zd", attachmentFilePaths.count);
+    if (state && fabs([state.auditStartDate timeIntervalSinceNow]) > kOrphanMaxResumableAuditAge) {
+        CleanupLogInfo(@"Discarding stale audit from: %@", state.auditStartDate);
+        state = nil;
+    }
+    if (state && shouldCleanup && !state.shouldCleanup) {
+        // An audit-only pass may have already skipped the removal phase.
+        CleanupLogInfo(@"Discarding audit-only pass in favor of cleanup.");
+        state = nil;
+    }
+
+    if (state) {
+        CleanupLogInfo(@"Resuming audit in phase: %lu", (unsigned long)state.phase);
+        return state;
+    }
+    return [[OWSOrphanedDataCleanerState alloc] initWithShouldCleanup:shouldCleanup];
+}
+
++ (void)saveState:(OWSOrphanedDataCleanerState *)state connection:(YapDatabaseConnection *)databaseConnection
+{
+    [databaseConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
+        [state saveWithTransaction:transaction];
+    }];
+}
 
-    NSMutableSet<NSString *> *orphanDiskFilePaths = [diskFilePaths mutableCopy];
-    [orphanDiskFilePaths minusSet:attachmentFilePaths];
-    NSMutableSet<NSString *> *missingAttachmentFilePaths = [attachmentFilePaths mutableCopy];
-    [missingAttachmentFilePaths minusSet:diskFilePaths];
+// Enumerates the collection a chunk at a time from state.cursor, checkpointing state periodically.
++ (void)scanCollection:(NSString *)collection
+             withState:(OWSOrphanedDataCleanerState *)state
+            connection:(YapDatabaseConnection *)databaseConnection
+            usingBlock:(void (^)(id object))block
+{
+    NSUInteger chunkCount = 0;
+    while (YES) {
+        __block int64_t lastRowid = state.cursor;
+        @autoreleasepool {
+            [databaseConnection readWithBlock:^(YapDatabaseReadTransaction *_Nonnull transaction) {
+                lastRowid = [transaction enumerateKeysAndObjectsInCollection:collection
+                                                                  afterRowid:state.cursor
+                                                                       limit:kOrphanScanChunkSize
+                                                                  usingBlock:^(NSString *key, id object, BOOL *stop) {
+                                                                      block(object);
+                                                                  }];
+            }];
+        }
+        if (lastRowid == state.cursor) {
+            break;
+        }
+        state.cursor = lastRowid;
 
-    CleanupLogDebug(@"orphan disk file paths: %zd", orphanDiskFilePaths.count);
-    CleanupLogDebug(@"missing attachment file paths: %zd", missingAttachmentFilePaths.count);
+        if (++chunkCount % kOrphanCheckpointChunkInterval == 0) {
+            [self saveState:state connection:databaseConnection];
+        }
+    }
+}
 
-    [self printPaths:orphanDiskFilePaths.allObjects label:@"orphan disk file paths"];
-    [self printPaths:missingAttachmentFilePaths.allObjects label:@"missing attachment file paths"];
+#pragma mark - Phases
 
-    NSMutableSet *threadIds = [NSMutableSet new];
++ (void)scanMessagesWithState:(OWSOrphanedDataCleanerState *)state
+                   connection:(YapDatabaseConnection *)databaseConnection
+{
+    // Unlike messages, threads are few enough to hold in memory.
+    NSMutableSet<NSString *> *threadIds = [NSMutableSet new];
     [databaseConnection readWithBlock:^(YapDatabaseReadTransaction *_Nonnull transaction) {
         [transaction enumerateKeysInCollection:TSThread.collection
                                     usingBlock:^(NSString *_Nonnull key, BOOL *_Nonnull stop) {
@@ -99,116 +307,191 @@ NS_ASSUME_NONNULL_BEGIN
                                     }];
     }];
 
-    NSMutableSet<NSString *> *orphanInteractionIds = [NSMutableSet new];
-    NSMutableSet<NSString *> *messageAttachmentIds = [NSMutableSet new];
-    [databaseConnection readWithBlock:^(YapDatabaseReadTransaction *_Nonnull transaction) {
-        [transaction enumerateKeysAndObjectsInCollection:TSMessage.collection
-                                              usingBlock:^(NSString *key, TSInteraction *interaction, BOOL *stop) {
-                                                  if (![threadIds containsObject:interaction.uniqueThreadId]) {
-                                                      [orphanInteractionIds addObject:interaction.uniqueId];
-                                                  }
-
-                                                  if (![interaction isKindOfClass:[TSMessage class]]) {
-                                                      return;
-                                                  }
-                                                  TSMessage *message = (TSMessage *)interaction;
-                                                  if (message.attachmentIds.count > 0) {
-                                                      [messageAttachmentIds addObjectsFromArray:message.attachmentIds];
-                                                  }
-                                              }];
-    }];
-
-    CleanupLogDebug(@"attachmentIds: %zd", attachmentIds.count);
-    CleanupLogDebug(@"messageAttachmentIds: %zd", messageAttachmentIds.count);
+    [self scanCollection:TSMessage.collection
+               withState:state
+              connection:databaseConnection
+              usingBlock:^(TSInteraction *interaction) {
+                  if (![threadIds containsObject:interaction.uniqueThreadId]) {
+                      [state.orphanInteractionIds addObject:interaction.uniqueId];
+                  }
+
+                  if (![interaction isKindOfClass:[TSMessage class]]) {
+                      return;
+                  }
+                  for (NSString *attachmentId in ((TSMessage *)interaction).attachmentIds) {
+                      OWSOrphanHashesAppend(state.referencedAttachmentIdHashes, attachmentId);
+                  }
+              }];
+
+    CleanupLogDebug(@"messageAttachmentIds: %zd", state.referencedAttachmentIdHashes.length / sizeof(uint64_t));
+    CleanupLogDebug(@"orphan interactions: %zd", state.orphanInteractionIds.count);
+
+    OWSOrphanHashesSort(state.referencedAttachmentIdHashes);
+    state.phase = OWSOrphanedDataCleanerPhaseScanAttachments;
+    state.cursor = 0;
+    [self saveState:state connection:databaseConnection];
+}
 
-    NSMutableSet<NSString *> *orphanAttachmentIds = [attachmentIds mutableCopy];
-    [orphanAttachmentIds minusSet:messageAttachmentIds];
-    NSMutableSet<NSString *> *missingAttachmentIds = [messageAttachmentIds mutableCopy];
-    [missingAttachmentIds minusSet:attachmentIds];
++ (void)scanAttachmentsWithState:(OWSOrphanedDataCleanerState *)state
+                      connection:(YapDatabaseConnection *)databaseConnection
+{
+    [self scanCollection:TSAttachmentStream.collection
+               withState:state
+              connection:databaseConnection
+              usingBlock:^(TSAttachment *attachment) {
+                  if (!OWSOrphanHashesContain(state.referencedAttachmentIdHashes, attachment.uniqueId)) {
+                      [state.orphanAttachmentIds addObject:attachment.uniqueId];
+                  }
+
+                  if (![attachment isKindOfClass:[TSAttachmentStream class]]) {
+                      return;
+                  }
+                  state.attachmentStreamCount++;
+                  NSString *_Nullable filePath = [(TSAttachmentStream *)attachment filePath];
+                  OWSAssert(filePath);
+                  if (!filePath) {
+                      return;
+                  }
+                  OWSOrphanHashesAppend(state.attachmentFilePathHashes, filePath);
+                  if (![[NSFileManager defaultManager] fileExistsAtPath:filePath]) {
+                      state.missingAttachmentFileCount++;
+                      CleanupLogDebug(@"missing attachment file path: %@", filePath);
+                  }
+              }];
+
+    CleanupLogDebug(@"attachmentStreams: %zd", state.attachmentStreamCount);
+    CleanupLogDebug(@"missing attachment file paths: %zd", state.missingAttachmentFileCount);
+    CleanupLogDebug(@"orphan attachmentIds: %zd", state.orphanAttachmentIds.count);
+
+    // Referenced ids are no longer needed; don't keep persisting them.
+    state.referencedAttachmentIdHashes = [NSMutableData new];
+    OWSOrphanHashesSort(state.attachmentFilePathHashes);
+    state.phase = OWSOrphanedDataCleanerPhaseRemoveOrphans;
+    state.cursor = 0;
+    [self saveState:state connection:databaseConnection];
+}
 
-    CleanupLogDebug(@"orphan attachmentIds: %zd", orphanAttachmentIds.count);
-    CleanupLogDebug(@"missing attachmentIds: %zd", missingAttachmentIds.count);
-    CleanupLogDebug(@"orphan interactions: %zd", orphanInteractionIds.count);
++ (void)removeOrphansWithState:(OWSOrphanedDataCleanerState *)state
+                    connection:(YapDatabaseConnection *)databaseConnection
+{
+    if (!state.shouldCleanup) {
+        state.phase = OWSOrphanedDataCleanerPhaseScanFiles;
+        return;
+    }
 
-    // We need to avoid cleaning up new attachments and files that are still in the process of
-    // being created/written, so we don't clean up anything recent.
-#ifdef SSK_BUILDING_FOR_TESTS
-    const NSTimeInterval kMinimumOrphanAge = 0.f;
-#else
-    const NSTimeInterval kMinimumOrphanAge = 15 * kMinuteInterval;
-#endif
+    NSDate *cutoffDate = [state.auditStartDate dateByAddingTimeInterval:-kMinimumOrphanAge];
+
+    // Each batch removes its orphans and records its progress in the same transaction.
+    while (state.orphanInteractionIds.count > 0) {
+        NSArray<NSString *> *batch = [state.orphanInteractionIds
+            subarrayWithRange:NSMakeRange(0, MIN(kOrphanRemovalBatchSize, state.orphanInteractionIds.count))];
+        [databaseConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
+            NSDictionary<NSString *, TSInteraction *> *interactions =
+                [TSInteraction fetchObjectsWithUniqueIDs:batch transaction:transaction];
+            for (NSString *interactionId in batch) {
+                TSInteraction *_Nullable interaction = interactions[interactionId];
+                if (!interaction) {
+                    // Removed since the scan.
+                    continue;
+                }
+                // The thread may have been created since the scan.
+                if ([TSThread fetchObjectWithUniqueID:interaction.uniqueThreadId transaction:transaction]) {
+                    CleanupLogInfo(@"Skipping orphan message whose thread now exists: %@", interaction.uniqueId);
+                    continue;
+                }
+                CleanupLogInfo(@"Removing orphan message: %@", interaction.uniqueId);
+                [interaction removeWithTransaction:transaction];
+            }
+            [state.orphanInteractionIds removeObjectsInRange:NSMakeRange(0, batch.count)];
+            [state saveWithTransaction:transaction];
+        }];
+    }
 
-    if (!shouldCleanup) {
-        return;
+    while (state.orphanAttachmentIds.count > 0) {
+        NSArray<NSString *> *batch = [state.orphanAttachmentIds
+            subarrayWithRange:NSMakeRange(0, MIN(kOrphanRemovalBatchSize, state.orphanAttachmentIds.count))];
+        [databaseConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
+            NSDictionary<NSString *, TSAttachment *> *attachments =
+                [TSAttachment fetchObjectsWithUniqueIDs:batch transaction:transaction];
+            for (NSString *attachmentId in batch) {
+                TSAttachment *_Nullable attachment = attachments[attachmentId];
+                if (![attachment isKindOfClass:[TSAttachmentStream class]]) {
+                    continue;
+                }
+                TSAttachmentStream *attachmentStream = (TSAttachmentStream *)attachment;
+                // Don't delete attachments which may have been referenced after the scan.
+                if ([attachmentStream.creationTimestamp compare:cutoffDate] != NSOrderedAscending) {
+                    CleanupLogInfo(@"Skipping orphan attachment due to age: %f",
+                        fabs([attachmentStream.creationTimestamp timeIntervalSinceNow]));
+                    continue;
+                }
+                CleanupLogInfo(@"Removing orphan attachment: %@", attachmentStream.uniqueId);
+                [attachmentStream removeWithTransaction:transaction];
+            }
+            [state.orphanAttachmentIds removeObjectsInRange:NSMakeRange(0, batch.count)];
+            [state saveWithTransaction:transaction];
+        }];
     }
 
-    [databaseConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *_Nonnull transaction) {
-        for (NSString *interactionId in orphanInteractionIds) {
-            TSInteraction *interaction = [TSInteraction fetchObjectWithUniqueID:interactionId transaction:transaction];
-            if (!interaction) {
-                // This could just be a race condition, but it should be very unlikely.
-                OWSFail(@"Could not load interaction: %@", interactionId);
+    state.phase = OWSOrphanedDataCleanerPhaseScanFiles;
+    [self saveState:state connection:databaseConnection];
+}
+
+// The disk walk is cheap relative to the database scans, so it simply restarts if interrupted.
++ (void)scanFilesWithState:(OWSOrphanedDataCleanerState *)state
+{
+    NSString *attachmentsFolder = [TSAttachmentStream attachmentsFolder];
+    CleanupLogDebug(@"attachmentsFolder: %@", attachmentsFolder);
+
+    NSDate *cutoffDate = [state.auditStartDate dateByAddingTimeInterval:-kMinimumOrphanAge];
+
+    NSUInteger fileCount = 0;
+    NSUInteger orphanFileCount = 0;
+    long long totalFileSize = 0;
+
+    NSDirectoryEnumerator<NSString *> *enumerator =
+        [[NSFileManager defaultManager] enumeratorAtPath:attachmentsFolder];
+    for (NSString *relativePath in enumerator) {
+        @autoreleasepool {
+            NSDictionary<NSString *, id> *attributes = enumerator.fileAttributes;
+            if ([attributes.fileType isEqualToString:NSFileTypeDirectory]) {
                 continue;
             }
-            CleanupLogInfo(@"Removing orphan message: %@", interaction.uniqueId);
-            [interaction removeWithTransaction:transaction];
-        }
-        for (NSString *attachmentId in orphanAttachmentIds) {
-            TSAttachment *attachment = [TSAttachment fetchObjectWithUniqueID:attachmentId transaction:transaction];
-            if (!attachment) {
-                // This could just be a race condition, but it should be very unlikely.
-                OWSFail(@"Could not load attachment: %@", attachmentId);
+            fileCount++;
+            totalFileSize += (long long)attributes.fileSize;
+
+            NSString *filePath = [attachmentsFolder stringByAppendingPathComponent:relativePath];
+            if (OWSOrphanHashesContain(state.attachmentFilePathHashes, filePath)) {
                 continue;
             }
-            if (![attachment isKindOfClass:[TSAttachmentStream class]]) {
+            orphanFileCount++;
+            CleanupLogDebug(@"orphan disk file path: %@", filePath);
+
+            if (!state.shouldCleanup) {
                 continue;
             }
-            TSAttachmentStream *attachmentStream = (TSAttachmentStream *)attachment;
-            // Don't delete attachments which were created in the last N minutes.
-            if (fabs([attachmentStream.creationTimestamp timeIntervalSinceNow]) < kMinimumOrphanAge) {
-                CleanupLogInfo(@"Skipping orphan attachment due to age: %f",
-                    fabs([attachmentStream.creationTimestamp timeIntervalSinceNow]));
+            // Don't delete files which may have been written after the scan.
+            if ([attributes.fileModificationDate compare:cutoffDate] != NSOrderedAscending) {
+                CleanupLogInfo(@"Skipping orphan attachment file due to age: %f",
+                    fabs([attributes.fileModificationDate timeIntervalSinceNow]));
                 continue;
             }
-            CleanupLogInfo(@"Removing orphan attachment: %@", attachmentStream.uniqueId);
-            [attachmentStream removeWithTransaction:transaction];
-        }
-    }];
 
-    for (NSString *filePath in orphanDiskFilePaths) {
-        NSError *error;
-        NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:filePath error:&error];
-        if (!attributes || error) {
-            OWSFail(@"Could not get attributes of file at: %@", filePath);
-            continue;
-        }
-        // Don't delete files which were created in the last N minutes.
-        if (fabs([attributes.fileModificationDate timeIntervalSinceNow]) < kMinimumOrphanAge) {
-            CleanupLogInfo(@"Skipping orphan attachment file due to age: %f",
-                fabs([attributes.fileModificationDate timeIntervalSinceNow]));
-            continue;
-        }
-
-        CleanupLogInfo(@"Removing orphan attachment file: %@", filePath);
-        [[NSFileManager defaultManager] removeItemAtPath:filePath error:&error];
-        if (error) {
-            OWSFail(@"Could not remove orphan file at: %@", filePath);
+            CleanupLogInfo(@"Removing orphan attachment file: %@", filePath);
+            NSError *error;
+            [[NSFileManager defaultManager] removeItemAtPath:filePath error:&error];
+            if (error) {
+                OWSFail(@"Could not remove orphan file at: %@", filePath);
+            }
         }
     }
 
-    if (completion) {
-        dispatch_async(dispatch_get_main_queue(), ^{
-            completion();
-        });
-    }
+    CleanupLogDebug(@"fileCount: %zd", fileCount);
+    CleanupLogDebug(@"totalFileSize: %lld", totalFileSize);
+    CleanupLogDebug(@"orphan disk file paths: %zd", orphanFileCount);
 }
 
-+ (void)printPaths:(NSArray<NSString *> *)paths label:(NSString *)label
-{
-    for (NSString *path in [paths sortedArrayUsingSelector:@selector(compare:)]) {
-        CleanupLogDebug(@"%@: %@", label, path);
-    }
-}
+#pragma mark - Files
 
 + (NSSet<NSString *> *)filePathsInAttachmentsFolder
 {
@@ -12,21 +12,29 @@
 
 + (YapDatabaseSecondaryIndex *)registerTimeStampIndex {
     YapDatabaseSecondaryIndexSetup *setup = [[YapDatabaseSecondaryIndexSetup alloc] init];
-    [setup addColumn:TSTimeStampSQLiteIndex withType:YapDatabaseSecondaryIndexTypeReal];
+    [setup addColumn:TSTimeStampSQLiteIndex withType:YapDatabaseSecondaryIndexTypeInteger];
 
-    YapDatabaseSecondaryIndexWithObjectBlock block =
-        ^(YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object) {
+    // The timestamp is written straight into the column, without boxing it in an NSNumber and a dictionary, and the
+    // keys are stored in the index, so that looking up messages by timestamp never touches the database table.
+    YapDatabaseSecondaryIndexWithObjectIntegersBlock block =
+        ^BOOL(YapDatabaseReadTransaction *transaction, int64_t *values, NSString *collection, NSString *key, id object) {
 
-          if ([object isKindOfClass:[TSInteraction class]]) {
-              TSInteraction *interaction = (TSInteraction *)object;
-
-              [dict setObject:@(interaction.timestamp) forKey:TSTimeStampSQLiteIndex];
+          if (![object isKindOfClass:[TSInteraction class]]) {
+              return NO;
           }
+
+          TSInteraction *interaction = (TSInteraction *)object;
+          values[0] = (int64_t)interaction.timestamp;
+          return YES;
         };
 
-    YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectBlock:block];
+    YapDatabaseSecondaryIndexHandler *handler = [YapDatabaseSecondaryIndexHandler withObjectIntegersBlock:block];
+
+    YapDatabaseSecondaryIndexOptions *options = [[YapDatabaseSecondaryIndexOptions alloc] init];
+    options.includesKeys = YES;
 
-    YapDatabaseSecondaryIndex *secondaryIndex = [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler];
+    YapDatabaseSecondaryIndex *secondaryIndex =
+        [[YapDatabaseSecondaryIndex alloc] initWithSetup:setup handler:handler versionTag:@"2" options:options];
 
     return secondaryIndex;
 }
@@ -35,8 +43,8 @@
 + (void)enumerateMessagesWithTimestamp:(uint64_t)timestamp
                              withBlock:(void (^)(NSString *collection, NSString *key, BOOL *stop))block
                       usingTransaction:(YapDatabaseReadWriteTransaction *)transaction {
-    NSString *formattedString = [NSString stringWithFormat:@"WHERE %@ = %lld", TSTimeStampSQLiteIndex, timestamp];
-    YapDatabaseQuery *query   = [YapDatabaseQuery queryWithFormat:formattedString];
+    NSString *formattedString = [NSString stringWithFormat:@"WHERE %@ = ?", TSTimeStampSQLiteIndex];
+    YapDatabaseQuery *query   = [YapDatabaseQuery queryWithString:formattedString parameters:@[ @(timestamp) ]];
     [[transaction ext:@"idx"] enumerateKeysMatchingQuery:query usingBlock:block];
 }
 
@@ -23,6 +23,20 @@ extern NSString *const TSSecondaryDevicesDatabaseViewExtensionName;
 - (instancetype)init NS_UNAVAILABLE;
 
 // This method can be called from any thread.
+//
+// The async views are populated in batches after they've been registered, so this
+// only covers their registration, not their population. Message processing and read
+// receipts wait on it, but none of what they read depends on that population:
+//
+// * The unseen view falls back to the unread view until it isPopulated
+//   (see unseenDatabaseViewExtension:).
+// * The outgoing messages, special messages and secondary devices views, and the
+//   failed message and failed attachment download indexes, may be missing older rows
+//   until they're populated. Nothing reads them during processing.
+// * The disappearing messages index may be missing older messages until it's
+//   populated. OWSDisappearingMessagesJob runs again once it is.
+// * The message search index may be missing older messages until
+//   -[OWSMessageSearchIndex hasIndexedExistingMessagesWithTransaction:].
 + (BOOL)hasPendingViewRegistrations;
 
 // This method must be called _AFTER_ registerThreadInteractionsDatabaseView.
@@ -45,14 +59,16 @@ extern NSString *const TSSecondaryDevicesDatabaseViewExtensionName;
 
 + (void)asyncRegisterSecondaryDevicesDatabaseView;
 
-// Returns the "unseen" database view if it is ready;
+// Returns the "unseen" database view if it is registered and populated;
 // otherwise it returns the "unread" database view.
 + (id)unseenDatabaseViewExtension:(YapDatabaseReadTransaction *)transaction;
 
 // NOTE: It is not safe to call this method while hasPendingViewRegistrations is YES.
+//       Until the view isPopulated, it may be missing older messages.
 + (id)threadOutgoingMessageDatabaseView:(YapDatabaseReadTransaction *)transaction;
 
 // NOTE: It is not safe to call this method while hasPendingViewRegistrations is YES.
+//       Until the view isPopulated, it may be missing older messages.
 + (id)threadSpecialMessagesDatabaseView:(YapDatabaseReadTransaction *)transaction;
 
 // This method should be called _after_ all async database registrations have been started.
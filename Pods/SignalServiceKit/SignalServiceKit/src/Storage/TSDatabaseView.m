@@ -6,6 +6,7 @@
 #import "NSNotificationCenter+OWS.h"
 #import "OWSDevice.h"
 #import "OWSReadTracking.h"
+#import "OWSThreadSummary.h"
 #import "TSIncomingMessage.h"
 #import "TSInvalidIdentityKeyErrorMessage.h"
 #import "TSOutgoingMessage.h"
@@ -33,6 +34,36 @@ NSString *const TSUnseenDatabaseViewExtensionName = @"TSUnseenDatabaseViewExtens
 NSString *const TSThreadSpecialMessagesDatabaseViewExtensionName = @"TSThreadSpecialMessagesDatabaseViewExtensionName";
 NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevicesDatabaseViewExtensionName";
 
+// Orders dates like -[NSDate compare:], with a nil date sorting before every other date.
+// Messaging nil would otherwise report NSOrderedSame, which OWSSortKeyForDate can't express.
+static NSComparisonResult OWSCompareDates(NSDate *_Nullable date1, NSDate *_Nullable date2)
+{
+    if (!date1 || !date2) {
+        if (date1 == date2) {
+            return NSOrderedSame;
+        }
+        return date1 ? NSOrderedDescending : NSOrderedAscending;
+    }
+
+    return [date1 compare:date2];
+}
+
+// Maps a date to an int64 which sorts in the same order as OWSCompareDates.
+// The bits of a double sort correctly as integers once negative values are flipped.
+static int64_t OWSSortKeyForDate(NSDate *_Nullable date)
+{
+    if (!date) {
+        return INT64_MIN;
+    }
+
+    double interval = date.timeIntervalSinceReferenceDate;
+    uint64_t bits;
+    memcpy(&bits, &interval, sizeof(bits));
+    bits = (bits & (1ULL << 63)) ? ~bits : (bits | (1ULL << 63));
+
+    return (int64_t)(bits ^ (1ULL << 63));
+}
+
 @interface TSDatabaseView ()
 
 @property (nonatomic) BOOL areAllAsyncRegistrationsComplete;
@@ -115,6 +146,8 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
     [[YapDatabaseAutoView alloc] initWithGrouping:viewGrouping sorting:viewSorting versionTag:version options:options];
 
     if (async) {
+        view.populationBatchSize = TSDatabaseExtensionPopulationBatchSize;
+
         [[TSStorageManager sharedManager].database
          asyncRegisterExtension:view
          withName:viewName
@@ -203,9 +236,10 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
         return interaction.uniqueThreadId;
     }];
 
+    // Version 2 rebuilds the view (in bulk), so that its pages store the sort key of every message.
     [self registerMessageDatabaseViewWithName:TSMessageDatabaseViewExtensionName
                                  viewGrouping:viewGrouping
-                                      version:@"1"
+                                      version:@"2"
                                         async:NO];
 }
 
@@ -256,7 +290,9 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
         }
 
         if (thread.archivalDate) {
-            return ([self threadShouldBeInInbox:thread]) ? TSInboxGroup : TSArchiveGroup;
+            NSDate *lastMessageDate = [self lastMessageDateForThreadId:key transaction:transaction];
+            return ([self threadShouldBeInInbox:thread lastMessageDate:lastMessageDate]) ? TSInboxGroup
+                                                                                         : TSArchiveGroup;
         } else if (thread.archivalDate) {
             return TSArchiveGroup;
         } else {
@@ -272,7 +308,7 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
     [[YapWhitelistBlacklist alloc] initWithWhitelist:[NSSet setWithObject:[TSThread collection]]];
 
     YapDatabaseView *databaseView =
-    [[YapDatabaseAutoView alloc] initWithGrouping:viewGrouping sorting:viewSorting versionTag:@"3" options:options];
+    [[YapDatabaseAutoView alloc] initWithGrouping:viewGrouping sorting:viewSorting versionTag:@"5" options:options];
 
     [[TSStorageManager sharedManager].database registerExtension:databaseView
                                                         withName:TSThreadDatabaseViewExtensionName];
@@ -282,12 +318,12 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
  *  Determines whether a thread belongs to the archive or inbox
  *
  *  @param thread TSThread
+ *  @param lastMessageDate The thread's sort date, from its summary if it has one
  *
  *  @return Inbox if true, Archive if false
  */
 
-+ (BOOL)threadShouldBeInInbox:(TSThread *)thread {
-    NSDate *lastMessageDate = thread.lastMessageDate;
++ (BOOL)threadShouldBeInInbox:(TSThread *)thread lastMessageDate:(NSDate *)lastMessageDate {
     NSDate *archivalDate    = thread.archivalDate;
     if (lastMessageDate && archivalDate) { // this is what is called
         return ([lastMessageDate timeIntervalSinceDate:archivalDate] > 0)
@@ -301,37 +337,69 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
     return YES;
 }
 
+// Reads the sort date from the thread's summary so that sorting the inbox doesn't need to
+// deserialize any threads. Threads which predate their summary fall back to the thread itself.
++ (NSDate *)lastMessageDateForThreadId:(NSString *)threadId transaction:(YapDatabaseReadTransaction *)transaction
+{
+    OWSThreadSummary *summary = [OWSThreadSummary summaryForThreadId:threadId transaction:transaction];
+    if (summary) {
+        return summary.lastMessageDate;
+    }
+
+    TSThread *thread = [TSThread fetchObjectWithUniqueID:threadId transaction:transaction];
+    return thread.lastMessageDate;
+}
+
 + (YapDatabaseViewSorting *)threadSorting {
-    return [YapDatabaseViewSorting withObjectBlock:^NSComparisonResult(YapDatabaseReadTransaction *transaction,
-                                                                       NSString *group,
-                                                                       NSString *collection1,
-                                                                       NSString *key1,
-                                                                       id object1,
-                                                                       NSString *collection2,
-                                                                       NSString *key2,
-                                                                       id object2) {
+    // Key blocks are normally only invoked on insert, but the summary changes independently of the
+    // thread's key, so re-sort whenever the thread is saved or touched.
+    YapDatabaseBlockInvoke invokeOptions =
+        YapDatabaseBlockInvokeIfObjectModified | YapDatabaseBlockInvokeIfObjectTouched;
+    YapDatabaseViewSorting *sorting =
+        [YapDatabaseViewSorting withOptions:invokeOptions
+                                   keyBlock:^NSComparisonResult(YapDatabaseReadTransaction *transaction,
+                                       NSString *group,
+                                       NSString *collection1,
+                                       NSString *key1,
+                                       NSString *collection2,
+                                       NSString *key2) {
         if ([group isEqualToString:TSArchiveGroup] || [group isEqualToString:TSInboxGroup]) {
-            if ([object1 isKindOfClass:[TSThread class]] && [object2 isKindOfClass:[TSThread class]]) {
-                TSThread *thread1 = (TSThread *)object1;
-                TSThread *thread2 = (TSThread *)object2;
+            NSDate *lastMessageDate1 = [self lastMessageDateForThreadId:key1 transaction:transaction];
+            NSDate *lastMessageDate2 = [self lastMessageDateForThreadId:key2 transaction:transaction];
 
-                return [thread1.lastMessageDate compare:thread2.lastMessageDate];
-            }
+            return OWSCompareDates(lastMessageDate1, lastMessageDate2);
         }
 
         return NSOrderedSame;
     }];
+
+    // Lets the view populate itself in bulk, rather than sorting every thread with the block above.
+    sorting.sortKeyBlock = ^int64_t(YapDatabaseReadTransaction *transaction,
+        NSString *group,
+        NSString *collection,
+        NSString *key,
+        id _Nullable object,
+        id _Nullable metadata) {
+        if ([group isEqualToString:TSArchiveGroup] || [group isEqualToString:TSInboxGroup]) {
+            return OWSSortKeyForDate([self lastMessageDateForThreadId:key transaction:transaction]);
+        }
+
+        return 0;
+    };
+
+    return sorting;
 }
 
 + (YapDatabaseViewSorting *)messagesSorting {
-    return [YapDatabaseViewSorting withObjectBlock:^NSComparisonResult(YapDatabaseReadTransaction *transaction,
-                                                                       NSString *group,
-                                                                       NSString *collection1,
-                                                                       NSString *key1,
-                                                                       id object1,
-                                                                       NSString *collection2,
-                                                                       NSString *key2,
-                                                                       id object2) {
+    YapDatabaseViewSorting *sorting =
+        [YapDatabaseViewSorting withObjectBlock:^NSComparisonResult(YapDatabaseReadTransaction *transaction,
+                                                                    NSString *group,
+                                                                    NSString *collection1,
+                                                                    NSString *key1,
+                                                                    id object1,
+                                                                    NSString *collection2,
+                                                                    NSString *key2,
+                                                                    id object2) {
         if ([object1 isKindOfClass:[TSInteraction class]] && [object2 isKindOfClass:[TSInteraction class]]) {
             TSInteraction *message1 = (TSInteraction *)object1;
             TSInteraction *message2 = (TSInteraction *)object2;
@@ -341,6 +409,22 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
 
         return NSOrderedSame;
     }];
+
+    // Must agree with -[TSInteraction compareForSorting:].
+    sorting.sortKeyBlock = ^int64_t(YapDatabaseReadTransaction *transaction,
+        NSString *group,
+        NSString *collection,
+        NSString *key,
+        id _Nullable object,
+        id _Nullable metadata) {
+        if ([object isKindOfClass:[TSInteraction class]]) {
+            return (int64_t)((TSInteraction *)object).timestampForSorting;
+        }
+
+        return 0;
+    };
+
+    return sorting;
 }
 
 + (void)asyncRegisterSecondaryDevicesDatabaseView
@@ -387,6 +471,7 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
 
     YapDatabaseView *view =
     [[YapDatabaseAutoView alloc] initWithGrouping:viewGrouping sorting:viewSorting versionTag:@"3" options:options];
+    view.populationBatchSize = TSDatabaseExtensionPopulationBatchSize;
 
     [[TSStorageManager sharedManager].database
      asyncRegisterExtension:view
@@ -404,9 +489,9 @@ NSString *const TSSecondaryDevicesDatabaseViewExtensionName = @"TSSecondaryDevic
 {
     OWSAssert(transaction);
 
-    id result = [transaction ext:TSUnseenDatabaseViewExtensionName];
+    YapDatabaseViewTransaction *result = [transaction ext:TSUnseenDatabaseViewExtensionName];
 
-    if (!result) {
+    if (!result || !result.isPopulated) {
         result = [transaction ext:TSUnreadDatabaseViewExtensionName];
         OWSAssert(result);
     }
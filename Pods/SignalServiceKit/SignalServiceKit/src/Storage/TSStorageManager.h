@@ -7,11 +7,18 @@
 #import <YapDatabase/YapDatabase.h>
 
 @class ECKeyPair;
+@class OWSDatabaseConnectionPool;
+@class OWSMessageSearchIndex;
 @class PreKeyRecord;
 @class SignedPreKeyRecord;
 
 NS_ASSUME_NONNULL_BEGIN
 
+// Extensions registered asynchronously at launch are populated afterwards, this many rows per write
+// transaction, so that other writes (e.g. message processing) never wait long on them.
+// See -[YapDatabaseExtension populationBatchSize].
+extern const NSUInteger TSDatabaseExtensionPopulationBatchSize;
+
 @interface TSStorageManager : NSObject
 
 - (instancetype)init NS_UNAVAILABLE;
@@ -72,6 +79,14 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nullable, nonatomic, readonly) YapDatabaseConnection *dbReadConnection;
 @property (nullable, nonatomic, readonly) YapDatabaseConnection *dbReadWriteConnection;
 
+// Prefer this to dbReadConnection for short reads which may happen on several threads at once
+// (e.g. from UI data sources); reads on the pool run in parallel rather than queueing behind
+// each other on a single connection.
+@property (nullable, nonatomic, readonly) OWSDatabaseConnectionPool *dbReadPool;
+
+// Full text search over messages and threads; registered along with the other async extensions.
+@property (nullable, nonatomic, readonly) OWSMessageSearchIndex *messageSearchIndex;
+
 @property (nullable, nonatomic, readonly) YapDatabaseConnection *keysDBReadConnection;
 @property (nullable, nonatomic, readonly) YapDatabaseConnection *keysDBReadWriteConnection;
 
@@ -5,15 +5,21 @@
 #import "TSStorageManager.h"
 #import "NSData+Base64.h"
 #import "OWSAnalytics.h"
+#import "OWSBinaryArchiver.h"
+#import "OWSDatabaseConnectionPool.h"
 #import "OWSDisappearingMessagesFinder.h"
 #import "OWSFailedAttachmentDownloadsJob.h"
 #import "OWSFailedMessagesJob.h"
 #import "OWSIncomingMessageFinder.h"
+#import "OWSMessageSearchIndex.h"
+#import "OWSThreadSummary.h"
 #import "SignalRecipient.h"
 #import "TSAttachmentStream.h"
 #import "TSDatabaseSecondaryIndexes.h"
 #import "TSDatabaseView.h"
 #import "TSInteraction.h"
+#import "TSMessage.h"
+#import "TSStorageManager+SessionStore.h"
 #import "TSThread.h"
 #import <25519/Randomness.h>
 #import "TSAccountManager.h"
@@ -31,11 +37,22 @@ NSString *const TSStorageManagerExceptionNameDatabasePasswordInaccessibleWhileBa
 NSString *const TSStorageManagerExceptionNameDatabasePasswordUnwritable = @"TSStorageManagerExceptionNameDatabasePasswordUnwritable";
 NSString *const TSStorageManagerExceptionNameNoDatabase = @"TSStorageManagerExceptionNameNoDatabase";
 
+const NSUInteger TSDatabaseExtensionPopulationBatchSize = 500;
+
 static const NSString *const databaseName = @"Signal.sqlite";
 static const NSString *const keysDBName = @"SignalKeys.sqlite";
 static NSString *keychainService          = @"TSKeyChainService";
 static NSString *keychainDBPassAccount    = @"TSDatabasePass";
 
+// Each connection's object cache is bounded by approximate bytes as well as by count.
+static const NSUInteger kObjectCacheCostLimit = 1024 * 1024;
+static const NSUInteger kCacheBaseObjectCost = 256;
+static const NSUInteger kCacheAttachmentIdCost = 64;
+
+// The read pool gets twice the cache budget of a single connection, shared between its connections.
+static const NSUInteger kReadPoolObjectCacheCostLimit = 2 * kObjectCacheCostLimit;
+static const NSUInteger kReadPoolMaxConnections = 4;
+
 #pragma mark -
 
 // This flag is only used in DEBUG builds.
@@ -191,6 +208,11 @@ void setDatabaseInitialized()
 @implementation OWSUnarchiverDelegate
 
 - (nullable Class)unarchiver:(NSKeyedUnarchiver *)unarchiver cannotDecodeObjectOfClassName:(NSString *)name originalClasses:(NSArray<NSString *> *)classNames
+{
+    return [self classForUndecodableClassName:name];
+}
+
+- (Class)classForUndecodableClassName:(NSString *)name
 {
     DDLogError(@"%@ Could not decode object: %@", self.tag, name);
     OWSProdError([OWSAnalyticsEvents storageErrorCouldNotDecodeClass]);
@@ -294,6 +316,7 @@ void setDatabaseInitialized()
 
     YapDatabaseOptions *options = [[YapDatabaseOptions alloc] init];
     options.corruptAction       = YapDatabaseCorruptAction_Fail;
+    options.objectBytesDeserializer = [[self class] logOnFailureBytesDeserializer];
 
     __weak typeof (self)weakSelf = self;
     options.cipherKeyBlock = ^{
@@ -301,8 +324,11 @@ void setDatabaseInitialized()
         return [strongSelf databasePasswordForKey:strongSelf.accountName];
     };
 
+    YapDatabaseSerializer serializer =
+        [[self class] binaryCodingSerializerForCollections:[[self class] binaryCodedCollections]];
+
     _database = [[YapDatabase alloc] initWithPath:[self dbPathWithName:databaseName]
-                                       serializer:NULL
+                                       serializer:serializer
                                      deserializer:[[self class] logOnFailureDeserializer]
                                           options:options];
     if (!_database) {
@@ -314,7 +340,7 @@ void setDatabaseInitialized()
         };
 
         _database = [[YapDatabase alloc] initWithPath:[self dbPathWithName:databaseName]
-                                           serializer:NULL
+                                           serializer:serializer
                                          deserializer:[[self class] logOnFailureDeserializer]
                                               options:options];
 
@@ -331,11 +357,19 @@ void setDatabaseInitialized()
         }
     }
 
+    [self configureCacheDefaultsForDatabase:_database];
+
     _dbReadConnection = self.newDatabaseConnection;
     _dbReadWriteConnection = self.newDatabaseConnection;
+    _dbReadPool = [[OWSDatabaseConnectionPool alloc]
+            initWithDatabase:_database
+              maxConnections:MIN(MAX([NSProcessInfo processInfo].activeProcessorCount, (NSUInteger)2),
+                                 kReadPoolMaxConnections)
+        objectCacheCostLimit:kReadPoolObjectCacheCostLimit];
 
     YapDatabaseOptions *keysDBOptions = [[YapDatabaseOptions alloc] init];
     keysDBOptions.corruptAction       = YapDatabaseCorruptAction_Fail;
+    keysDBOptions.objectBytesDeserializer = [[self class] logOnFailureBytesDeserializer];
 
     keysDBOptions.cipherKeyBlock = ^{
         typeof(self)strongSelf = weakSelf;
@@ -343,7 +377,7 @@ void setDatabaseInitialized()
     };
 
     _keysDatabase = [[YapDatabase alloc] initWithPath:[self dbPathWithName:keysDBName]
-                                           serializer:NULL
+                                           serializer:serializer
                                          deserializer:[[self class] logOnFailureDeserializer]
                                               options:keysDBOptions];
     _keysDatabase.defaultObjectCacheEnabled = NO;
@@ -378,6 +412,67 @@ void setDatabaseInitialized()
     return corruptedDBFilePath;
 }
 
+- (void)configureCacheDefaultsForDatabase:(YapDatabase *)database
+{
+    // A few long messages shouldn't be able to use as much memory as hundreds of short ones,
+    // so bound the object cache by cost rather than by count alone.
+    database.defaultCacheType = YapDatabaseConnectionCacheType_Clock;
+    database.defaultObjectCacheCostLimit = kObjectCacheCostLimit;
+    database.defaultCacheCostBlock = [[self class] cacheCostBlock];
+}
+
+// Approximates the in-memory size, in bytes, of a cached row. Only interactions vary enough in
+// size to be worth inspecting; everything else is charged a flat cost.
++ (YapDatabaseCacheCostBlock)cacheCostBlock
+{
+    NSString *interactionCollection = [TSInteraction collection];
+
+    return ^NSUInteger(NSString *collection, NSString __unused *key, id object) {
+        NSUInteger cost = kCacheBaseObjectCost;
+
+        if ([collection isEqualToString:interactionCollection] && [object isKindOfClass:[TSMessage class]]) {
+            TSMessage *message = (TSMessage *)object;
+            cost += message.body.length * sizeof(unichar);
+            cost += message.attachmentIds.count * kCacheAttachmentIdCost;
+        } else if ([object isKindOfClass:[NSData class]]) {
+            cost += ((NSData *)object).length;
+        }
+
+        return cost;
+    };
+}
+
+// Hot collections whose rows are written with OWSBinaryArchiver rather than NSKeyedArchiver.
++ (NSSet<NSString *> *)binaryCodedCollections
+{
+    return [NSSet setWithArray:@[
+        [TSInteraction collection],
+        [TSThread collection],
+        TSStorageManagerDeviceSessionStoreCollection,
+        // OWSMessageDecryptJob
+        @"OWSMessageProcessingJob",
+        // OWSMessageContentJob
+        @"OWSBatchMessageProcessingJob",
+    ]];
+}
+
++ (YapDatabaseSerializer)binaryCodingSerializerForCollections:(NSSet<NSString *> *)collections
+{
+    YapDatabaseSerializer defaultSerializer = [YapDatabase defaultSerializer];
+
+    return ^NSData *(NSString *collection, NSString *key, id object) {
+        if ([collections containsObject:collection]) {
+            @try {
+                return [OWSBinaryArchiver archivedDataWithRootObject:object];
+            } @catch (NSException *exception) {
+                // The deserializer understands both formats, so we can always fall back.
+                DDLogError(@"%@ Could not binary archive %@ in %@: %@", self.tag, [object class], collection, exception);
+            }
+        }
+        return defaultSerializer(collection, key, object);
+    };
+}
+
 /**
  * NSCoding sometimes throws exceptions killing our app. We want to log that exception.
  **/
@@ -391,6 +486,15 @@ void setDatabaseInitialized()
         }
 
         @try {
+            // Rows in binary coded collections are only rewritten when they're next saved,
+            // so both formats are expected here. See binaryCodingSerializerForCollections:.
+            if ([OWSBinaryUnarchiver isBinaryArchive:data]) {
+                return [OWSBinaryUnarchiver unarchiveObjectWithData:data
+                                                  unknownClassBlock:^(NSString *className) {
+                                                      return [unarchiverDelegate classForUndecodableClassName:className];
+                                                  }];
+            }
+
             NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingWithData:data];
             unarchiver.delegate = unarchiverDelegate;
             return [unarchiver decodeObjectForKey:@"root"];
@@ -402,6 +506,34 @@ void setDatabaseInitialized()
     };
 }
 
+// Binary archives are parsed in place, straight out of sqlite's row buffer, which saves wrapping
+// every row in an NSData. Anything else goes through logOnFailureDeserializer, which is handed the
+// same buffer without copying it, just as YapDatabase does for an ordinary deserializer.
++ (YapDatabaseBytesDeserializer)logOnFailureBytesDeserializer
+{
+    YapDatabaseDeserializer dataDeserializer = [self logOnFailureDeserializer];
+    OWSUnarchiverDelegate *unarchiverDelegate = [OWSUnarchiverDelegate new];
+
+    return ^id(NSString *collection, NSString *key, const void *bytes, NSUInteger length) {
+        if (![OWSBinaryUnarchiver isBinaryArchiveBytes:bytes length:length]) {
+            NSData *data = [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+            return dataDeserializer(collection, key, data);
+        }
+
+        @try {
+            return [OWSBinaryUnarchiver unarchiveObjectWithBytes:bytes
+                                                          length:length
+                                               unknownClassBlock:^(NSString *className) {
+                                                   return [unarchiverDelegate classForUndecodableClassName:className];
+                                               }];
+        } @catch (NSException *exception) {
+            // Sync log in case we bail.
+            OWSProdError([OWSAnalyticsEvents storageErrorDeserialization]);
+            @throw exception;
+        }
+    };
+}
+
 - (void)setupForAccountName:(NSString *)accountName isFirstLaunch:(BOOL)isFirstLaunch
 {
     self.accountName = [accountName copy];
@@ -450,6 +582,7 @@ void setDatabaseInitialized()
     [TSDatabaseView registerThreadInteractionsDatabaseView];
     [TSDatabaseView registerThreadDatabaseView];
     [TSDatabaseView registerUnreadDatabaseView];
+    [OWSThreadSummary syncRegisterDatabaseExtension:self.database];
     [self.database registerExtension:[TSDatabaseSecondaryIndexes registerTimeStampIndex] withName:@"idx"];
     [OWSMessageReceiver syncRegisterDatabaseExtension:self.database];
     [OWSBatchMessageProcessor syncRegisterDatabaseExtension:self.database];
@@ -462,6 +595,11 @@ void setDatabaseInitialized()
     // consequences.
     setDatabaseInitialized();
 
+    // The thread view sorts on thread summaries, so build any that are missing before the inbox is shown.
+    [self.dbReadWriteConnection readWriteWithBlock:^(YapDatabaseReadWriteTransaction *transaction) {
+        [OWSThreadSummary populateSummariesIfNecessaryWithTransaction:transaction];
+    }];
+
     // Run the blocking migrations.
     //
     // These need to run _before_ the async registered database views or
@@ -474,12 +612,18 @@ void setDatabaseInitialized()
     //
     // All sync registrations must be done before all async registrations,
     // or the sync registrations will block on the async registrations.
+    //
+    // Most of these are populated in batches after they've been registered (see
+    // TSDatabaseExtensionPopulationBatchSize), so registration itself is quick, and
+    // may complete before they've seen every existing row.
     [TSDatabaseView asyncRegisterUnseenDatabaseView];
     [TSDatabaseView asyncRegisterThreadOutgoingMessagesDatabaseView];
     [TSDatabaseView asyncRegisterThreadSpecialMessagesDatabaseView];
 
     // Register extensions which aren't essential for rendering threads async.
     [[OWSIncomingMessageFinder new] asyncRegisterExtension];
+    _messageSearchIndex = [[OWSMessageSearchIndex alloc] initWithDatabase:self.database];
+    [self.messageSearchIndex asyncRegisterExtension];
     [TSDatabaseView asyncRegisterSecondaryDevicesDatabaseView];
     [OWSDisappearingMessagesFinder asyncRegisterDatabaseExtensions:self];
     OWSFailedMessagesJob *failedMessagesJob = [[OWSFailedMessagesJob alloc] initWithStorageManager:self];
@@ -704,7 +848,7 @@ void setDatabaseInitialized()
 - (id)objectForKey:(NSString *)key inCollection:(NSString *)collection {
     __block NSString *object;
 
-    [self.dbReadConnection readWithBlock:^(YapDatabaseReadTransaction *transaction) {
+    [self.dbReadPool readWithBlock:^(YapDatabaseReadTransaction *transaction) {
         object = [transaction objectForKey:key inCollection:collection];
     }];
 
@@ -840,6 +984,8 @@ void setDatabaseInitialized()
     self.database = nil;
     _dbReadConnection = nil;
     _dbReadWriteConnection = nil;
+    _dbReadPool = nil;
+    _messageSearchIndex = nil;
 
     [TSAttachmentStream deleteAttachments];
 
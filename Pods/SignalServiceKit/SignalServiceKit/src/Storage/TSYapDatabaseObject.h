@@ -80,6 +80,18 @@
 + (instancetype)fetchObjectWithUniqueID:(NSString *)uniqueID transaction:(YapDatabaseReadTransaction *)transaction NS_SWIFT_NAME(fetch(uniqueId:transaction:));
 + (instancetype)fetchObjectWithUniqueID:(NSString *)uniqueID NS_SWIFT_NAME(fetch(uniqueId:));
 
+/**
+ *  Fetches the objects with the provided identifiers in a single batch
+ *
+ *  @param uniqueIDs   Unique identifiers of the entries in a collection
+ *  @param transaction Transaction used for fetching the objects
+ *
+ *  @return Instances keyed by unique identifier; identifiers that don't exist are absent
+ */
++ (NSDictionary<NSString *, id> *)fetchObjectsWithUniqueIDs:(NSArray<NSString *> *)uniqueIDs
+                                                transaction:(YapDatabaseReadTransaction *)transaction
+    NS_SWIFT_NAME(fetch(uniqueIds:transaction:));
+
 /**
  *  Saves the object with a new YapDatabaseConnection
  */
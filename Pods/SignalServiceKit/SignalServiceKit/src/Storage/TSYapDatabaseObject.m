@@ -173,6 +173,12 @@
     return [transaction objectForKey:uniqueID inCollection:[self collection]];
 }
 
++ (NSDictionary<NSString *, id> *)fetchObjectsWithUniqueIDs:(NSArray<NSString *> *)uniqueIDs
+                                                transaction:(YapDatabaseReadTransaction *)transaction
+{
+    return [transaction objectsForKeys:uniqueIDs inCollection:[self collection]];
+}
+
 + (instancetype)fetchObjectWithUniqueID:(NSString *)uniqueID
 {
     __block id object;
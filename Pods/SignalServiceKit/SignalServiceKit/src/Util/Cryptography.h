@@ -66,6 +66,32 @@ typedef NS_ENUM(NSInteger, TSMACType) {
                            outKey:(NSData *_Nonnull *_Nullable)outKey
                         outDigest:(NSData *_Nonnull *_Nullable)outDigest;
 
+#pragma mark streaming attachment encryption and decryption
+
+// These methods produce and consume the same format as the methods above:
+//
+//     iv || AES256-CBC(plaintext) || HMAC-SHA256(iv || ciphertext)
+//
+// but stream through a fixed-size buffer, so their memory use doesn't depend on
+// the size of the attachment. The AES-CBC, HMAC and digest are all computed in
+// a single pass.
+
+// The plaintext is only moved to plaintextFilePath once the HMAC and digest have been verified.
+// On failure, plaintextFilePath is left untouched.
++ (BOOL)decryptAttachmentAtPath:(NSString *)encryptedFilePath
+                         toPath:(NSString *)plaintextFilePath
+                        withKey:(NSData *)key
+                         digest:(nullable NSData *)digest
+                   unpaddedSize:(UInt32)unpaddedSize
+                          error:(NSError **)error;
+
+// On failure, nothing is left at encryptedFilePath.
++ (BOOL)encryptAttachmentStream:(NSInputStream *)inputStream
+                         toPath:(NSString *)encryptedFilePath
+                         outKey:(NSData *_Nonnull *_Nullable)outKey
+                      outDigest:(NSData *_Nonnull *_Nullable)outDigest
+                          error:(NSError **)error;
+
 + (nullable NSData *)encryptAESGCMWithData:(NSData *)plaintextData key:(OWSAES256Key *)key;
 + (nullable NSData *)decryptAESGCMWithData:(NSData *)encryptedData key:(OWSAES256Key *)key;
 
@@ -29,6 +29,9 @@ static const NSUInteger kAESGCM256_TagLength = 16;
 
 const NSUInteger kAES256_KeyByteLength = 32;
 
+// The buffer size used when streaming attachments.
+static const NSUInteger kAttachmentStreamBufferLength = 64 * 1024;
+
 @implementation OWSAES256Key
 
 + (nullable instancetype)keyWithData:(NSData *)data
@@ -443,6 +446,406 @@ const NSUInteger kAES256_KeyByteLength = 32;
     return [encryptedPaddedData copy];
 }
 
+#pragma mark streaming attachment encryption and decryption
+
+// Returns the number of bytes read, which will be less than length only if
+// the end of the stream is reached, or -1 on error.
+static NSInteger ReadFromStream(NSInputStream *stream, uint8_t *buffer, NSUInteger length)
+{
+    NSUInteger totalBytesRead = 0;
+    while (totalBytesRead < length) {
+        NSInteger bytesRead = [stream read:buffer + totalBytesRead maxLength:length - totalBytesRead];
+        if (bytesRead < 0) {
+            return -1;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        totalBytesRead += (NSUInteger)bytesRead;
+    }
+    return (NSInteger)totalBytesRead;
+}
+
+static BOOL WriteToStream(NSOutputStream *stream, const uint8_t *bytes, NSUInteger length)
+{
+    NSUInteger totalBytesWritten = 0;
+    while (totalBytesWritten < length) {
+        NSInteger bytesWritten = [stream write:bytes + totalBytesWritten maxLength:length - totalBytesWritten];
+        if (bytesWritten <= 0) {
+            return NO;
+        }
+        totalBytesWritten += (NSUInteger)bytesWritten;
+    }
+    return YES;
+}
+
++ (BOOL)decryptAttachmentAtPath:(NSString *)encryptedFilePath
+                         toPath:(NSString *)plaintextFilePath
+                        withKey:(NSData *)key
+                         digest:(nullable NSData *)digest
+                   unpaddedSize:(UInt32)unpaddedSize
+                          error:(NSError **)error
+{
+    OWSAssert(encryptedFilePath.length > 0);
+    OWSAssert(plaintextFilePath.length > 0);
+
+    NSError *invalidMessageError = OWSErrorWithCodeDescription(
+        OWSErrorCodeFailedToDecryptMessage, NSLocalizedString(@"ERROR_MESSAGE_INVALID_MESSAGE", @""));
+
+    if (digest.length <= 0) {
+        // This *could* happen with sufficiently outdated clients.
+        DDLogError(@"%@ Refusing to decrypt attachment without a digest.", self.tag);
+        *error = OWSErrorWithCodeDescription(OWSErrorCodeFailedToDecryptMessage,
+            NSLocalizedString(@"ERROR_MESSAGE_ATTACHMENT_FROM_OLD_CLIENT",
+                @"Error message when unable to receive an attachment because the sending client is too old."));
+        return NO;
+    }
+
+    NSError *attributesError;
+    NSDictionary *attributes =
+        [[NSFileManager defaultManager] attributesOfItemAtPath:encryptedFilePath error:&attributesError];
+    if (!attributes) {
+        DDLogError(@"%@ Could not read encrypted attachment attributes: %@", self.tag, attributesError);
+        *error = invalidMessageError;
+        return NO;
+    }
+    unsigned long long encryptedLength = attributes.fileSize;
+    if ((encryptedLength < AES_CBC_IV_LENGTH + HMAC256_OUTPUT_LENGTH) || ([key length] < AES_KEY_SIZE + HMAC256_KEY_LENGTH)) {
+        DDLogError(@"%@ Message shorter than crypto overhead!", self.tag);
+        *error = invalidMessageError;
+        return NO;
+    }
+    unsigned long long ciphertextLength = encryptedLength - AES_CBC_IV_LENGTH - HMAC256_OUTPUT_LENGTH;
+
+    // The HMAC and digest can only be verified once all of the plaintext has been written, so we decrypt to a
+    // temporary file next to the destination and only move it into place once the attachment is authenticated.
+    NSString *temporaryFilePath = [plaintextFilePath.stringByDeletingLastPathComponent
+        stringByAppendingPathComponent:[NSString stringWithFormat:@".%@.decrypting", [NSUUID UUID].UUIDString]];
+
+    NSInputStream *inputStream = [NSInputStream inputStreamWithFileAtPath:encryptedFilePath];
+    NSOutputStream *outputStream = [NSOutputStream outputStreamToFileAtPath:temporaryFilePath append:NO];
+    [inputStream open];
+    [outputStream open];
+
+    BOOL success = [self decryptAttachmentStream:inputStream
+                                ciphertextLength:ciphertextLength
+                                  toOutputStream:outputStream
+                                         withKey:key
+                                          digest:digest
+                                    unpaddedSize:unpaddedSize];
+
+    [inputStream close];
+    [outputStream close];
+
+    // rename(2) replaces any existing file at plaintextFilePath atomically.
+    if (success && rename(temporaryFilePath.fileSystemRepresentation, plaintextFilePath.fileSystemRepresentation) != 0) {
+        DDLogError(@"%@ Could not move decrypted attachment into place: %d", self.tag, errno);
+        success = NO;
+    }
+
+    if (!success) {
+        [[NSFileManager defaultManager] removeItemAtPath:temporaryFilePath error:nil];
+        *error = invalidMessageError;
+        return NO;
+    }
+    return YES;
+}
+
++ (BOOL)decryptAttachmentStream:(NSInputStream *)inputStream
+               ciphertextLength:(unsigned long long)ciphertextLength
+                 toOutputStream:(NSOutputStream *)outputStream
+                        withKey:(NSData *)key
+                         digest:(NSData *)digest
+                   unpaddedSize:(UInt32)unpaddedSize
+{
+    // key: 32 byte AES key || 32 byte Hmac-SHA256 key.
+    const uint8_t *encryptionKey = key.bytes;
+    const uint8_t *hmacKey = encryptionKey + AES_KEY_SIZE;
+
+    // encrypted data: IV || Ciphertext || truncated MAC(IV||Ciphertext)
+    uint8_t iv[AES_CBC_IV_LENGTH];
+    if (ReadFromStream(inputStream, iv, AES_CBC_IV_LENGTH) != AES_CBC_IV_LENGTH) {
+        DDLogError(@"%@ Failed to read attachment IV.", self.tag);
+        return NO;
+    }
+
+    CCHmacContext hmacContext;
+    CCHmacInit(&hmacContext, kCCHmacAlgSHA256, hmacKey, HMAC256_KEY_LENGTH);
+    CCHmacUpdate(&hmacContext, iv, AES_CBC_IV_LENGTH);
+
+    CC_SHA256_CTX digestContext;
+    CC_SHA256_Init(&digestContext);
+    CC_SHA256_Update(&digestContext, iv, AES_CBC_IV_LENGTH);
+
+    CCCryptorRef cryptor;
+    CCCryptorStatus cryptStatus = CCCryptorCreate(
+        kCCDecrypt, kCCAlgorithmAES128, kCCOptionPKCS7Padding, encryptionKey, AES_KEY_SIZE, iv, &cryptor);
+    if (cryptStatus != kCCSuccess) {
+        DDLogError(@"%@ Failed to create cryptor: %d", self.tag, (int32_t)cryptStatus);
+        return NO;
+    }
+
+    NSMutableData *inputBuffer = [NSMutableData dataWithLength:kAttachmentStreamBufferLength];
+    NSMutableData *outputBuffer = [NSMutableData dataWithLength:kAttachmentStreamBufferLength + kCCBlockSizeAES128];
+
+    // Padding beyond unpaddedSize is decrypted, authenticated and discarded.
+    // An unpaddedSize of zero indicates a legacy client which didn't pad.
+    __block unsigned long long plaintextLength = 0;
+    BOOL (^writePlaintext)(size_t) = ^(size_t length) {
+        unsigned long long writableLength = length;
+        if (unpaddedSize > 0) {
+            writableLength = (plaintextLength >= unpaddedSize ? 0 : MIN(writableLength, unpaddedSize - plaintextLength));
+        }
+        plaintextLength += length;
+        return WriteToStream(outputStream, outputBuffer.mutableBytes, (NSUInteger)writableLength);
+    };
+
+    BOOL success = YES;
+    unsigned long long remainingLength = ciphertextLength;
+    while (success && remainingLength > 0) {
+        NSUInteger chunkLength = (NSUInteger)MIN(remainingLength, (unsigned long long)kAttachmentStreamBufferLength);
+        if (ReadFromStream(inputStream, inputBuffer.mutableBytes, chunkLength) != (NSInteger)chunkLength) {
+            DDLogError(@"%@ Failed to read attachment ciphertext.", self.tag);
+            success = NO;
+            break;
+        }
+        remainingLength -= chunkLength;
+
+        CCHmacUpdate(&hmacContext, inputBuffer.bytes, chunkLength);
+        CC_SHA256_Update(&digestContext, inputBuffer.bytes, (CC_LONG)chunkLength);
+
+        size_t bytesDecrypted = 0;
+        cryptStatus = CCCryptorUpdate(
+            cryptor, inputBuffer.bytes, chunkLength, outputBuffer.mutableBytes, outputBuffer.length, &bytesDecrypted);
+        if (cryptStatus != kCCSuccess) {
+            DDLogError(@"%@ Failed CBC decryption", self.tag);
+            success = NO;
+            break;
+        }
+        success = writePlaintext(bytesDecrypted);
+    }
+
+    if (success) {
+        size_t bytesDecrypted = 0;
+        cryptStatus = CCCryptorFinal(cryptor, outputBuffer.mutableBytes, outputBuffer.length, &bytesDecrypted);
+        if (cryptStatus != kCCSuccess) {
+            DDLogError(@"%@ Failed CBC decryption", self.tag);
+            success = NO;
+        } else {
+            success = writePlaintext(bytesDecrypted);
+        }
+    }
+    CCCryptorRelease(cryptor);
+    if (!success) {
+        return NO;
+    }
+
+    uint8_t theirHmac[HMAC256_OUTPUT_LENGTH];
+    if (ReadFromStream(inputStream, theirHmac, HMAC256_OUTPUT_LENGTH) != HMAC256_OUTPUT_LENGTH) {
+        DDLogError(@"%@ Failed to read attachment HMAC.", self.tag);
+        return NO;
+    }
+    uint8_t ourHmac[CC_SHA256_DIGEST_LENGTH];
+    CCHmacFinal(&hmacContext, ourHmac);
+    NSData *theirHmacData = [NSData dataWithBytes:theirHmac length:HMAC256_OUTPUT_LENGTH];
+    NSData *ourHmacData = [NSData dataWithBytes:ourHmac length:HMAC256_OUTPUT_LENGTH];
+    if (![ourHmacData ows_constantTimeIsEqualToData:theirHmacData]) {
+        DDLogError(@"%@ %s Bad HMAC on decrypting payload. Their MAC: %@, our MAC: %@",
+            self.tag,
+            __PRETTY_FUNCTION__,
+            theirHmacData,
+            ourHmacData);
+        return NO;
+    }
+
+    // Verify digest of: iv || encrypted data || hmac
+    CC_SHA256_Update(&digestContext, ourHmac, HMAC256_OUTPUT_LENGTH);
+    uint8_t ourDigest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(ourDigest, &digestContext);
+    NSData *ourDigestData = [NSData dataWithBytes:ourDigest length:CC_SHA256_DIGEST_LENGTH];
+    if (![ourDigestData ows_constantTimeIsEqualToData:digest]) {
+        DDLogWarn(@"%@ Bad digest on decrypting payload. Their digest: %@, our digest: %@",
+            self.tag,
+            digest,
+            ourDigestData);
+        return NO;
+    }
+
+    if (unpaddedSize == 0) {
+        // Work around for legacy iOS client's which weren't setting padding size.
+        // Since we know those clients pre-date attachment padding we keep the entire data.
+        DDLogWarn(@"%@ Decrypted attachment with unspecified size.", self.tag);
+    } else if (unpaddedSize > plaintextLength) {
+        DDLogError(@"%@ Decrypted attachment is shorter than its unpadded size: %llu < %u",
+            self.tag,
+            plaintextLength,
+            (unsigned int)unpaddedSize);
+        return NO;
+    } else {
+        DDLogInfo(@"%@ decrypted attachment with unpaddedSize: %u, paddingSize: %llu",
+            self.tag,
+            (unsigned int)unpaddedSize,
+            plaintextLength - unpaddedSize);
+    }
+
+    return YES;
+}
+
++ (BOOL)encryptAttachmentStream:(NSInputStream *)inputStream
+                         toPath:(NSString *)encryptedFilePath
+                         outKey:(NSData *_Nonnull *_Nullable)outKey
+                      outDigest:(NSData *_Nonnull *_Nullable)outDigest
+                          error:(NSError **)error
+{
+    OWSAssert(inputStream);
+    OWSAssert(encryptedFilePath.length > 0);
+
+    NSData *iv = [Cryptography generateRandomBytes:AES_CBC_IV_LENGTH];
+    NSData *encryptionKey = [Cryptography generateRandomBytes:AES_KEY_SIZE];
+    NSData *hmacKey = [Cryptography generateRandomBytes:HMAC256_KEY_LENGTH];
+
+    NSOutputStream *outputStream = [NSOutputStream outputStreamToFileAtPath:encryptedFilePath append:NO];
+    if (inputStream.streamStatus == NSStreamStatusNotOpen) {
+        [inputStream open];
+    }
+    [outputStream open];
+
+    NSData *_Nullable digest = [self encryptAttachmentStream:inputStream
+                                              toOutputStream:outputStream
+                                                          iv:iv
+                                               encryptionKey:encryptionKey
+                                                     hmacKey:hmacKey];
+
+    [inputStream close];
+    [outputStream close];
+
+    if (!digest) {
+        [[NSFileManager defaultManager] removeItemAtPath:encryptedFilePath error:nil];
+        *error = OWSErrorWithCodeDescription(OWSErrorCodeFailedToEncryptMessage,
+            NSLocalizedString(@"ERROR_DESCRIPTION_CLIENT_SENDING_FAILURE", @"Generic notice when message failed to send."));
+        return NO;
+    }
+
+    // The concatenated key for storage
+    NSMutableData *attachmentKey = [NSMutableData data];
+    [attachmentKey appendData:encryptionKey];
+    [attachmentKey appendData:hmacKey];
+    *outKey = [attachmentKey copy];
+    *outDigest = digest;
+    DDLogVerbose(@"%@ computed digest: %@", self.tag, *outDigest);
+
+    return YES;
+}
+
+// Returns the digest of the encrypted output, or nil on failure.
++ (nullable NSData *)encryptAttachmentStream:(NSInputStream *)inputStream
+                              toOutputStream:(NSOutputStream *)outputStream
+                                          iv:(NSData *)iv
+                               encryptionKey:(NSData *)encryptionKey
+                                     hmacKey:(NSData *)hmacKey
+{
+    if (!WriteToStream(outputStream, iv.bytes, iv.length)) {
+        DDLogError(@"%@ Failed to write attachment IV.", self.tag);
+        return nil;
+    }
+
+    // compute hmac of: iv || encrypted data
+    __block CCHmacContext hmacContext;
+    CCHmacInit(&hmacContext, kCCHmacAlgSHA256, hmacKey.bytes, hmacKey.length);
+    CCHmacUpdate(&hmacContext, iv.bytes, iv.length);
+
+    // compute digest of: iv || encrypted data || hmac
+    __block CC_SHA256_CTX digestContext;
+    CC_SHA256_Init(&digestContext);
+    CC_SHA256_Update(&digestContext, iv.bytes, (CC_LONG)iv.length);
+
+    CCCryptorRef cryptor;
+    CCCryptorStatus cryptStatus = CCCryptorCreate(kCCEncrypt,
+        kCCAlgorithmAES128,
+        kCCOptionPKCS7Padding,
+        encryptionKey.bytes,
+        encryptionKey.length,
+        iv.bytes,
+        &cryptor);
+    if (cryptStatus != kCCSuccess) {
+        DDLogError(@"%@ %s CCCryptorCreate failed with status: %d", self.tag, __PRETTY_FUNCTION__, (int32_t)cryptStatus);
+        return nil;
+    }
+
+    NSMutableData *inputBuffer = [NSMutableData dataWithLength:kAttachmentStreamBufferLength];
+    NSMutableData *outputBuffer = [NSMutableData dataWithLength:kAttachmentStreamBufferLength + kCCBlockSizeAES128];
+
+    BOOL (^encryptAndWrite)(NSUInteger) = ^(NSUInteger length) {
+        size_t bytesEncrypted = 0;
+        CCCryptorStatus status = CCCryptorUpdate(
+            cryptor, inputBuffer.bytes, length, outputBuffer.mutableBytes, outputBuffer.length, &bytesEncrypted);
+        if (status != kCCSuccess) {
+            DDLogError(@"%@ %s CCCryptorUpdate failed with status: %d", self.tag, __PRETTY_FUNCTION__, (int32_t)status);
+            return NO;
+        }
+        CCHmacUpdate(&hmacContext, outputBuffer.bytes, bytesEncrypted);
+        CC_SHA256_Update(&digestContext, outputBuffer.bytes, (CC_LONG)bytesEncrypted);
+        return WriteToStream(outputStream, outputBuffer.bytes, bytesEncrypted);
+    };
+
+    BOOL success = YES;
+    unsigned long long plaintextLength = 0;
+    while (success) {
+        NSInteger bytesRead = ReadFromStream(inputStream, inputBuffer.mutableBytes, inputBuffer.length);
+        if (bytesRead < 0) {
+            DDLogError(@"%@ Failed to read attachment data: %@", self.tag, inputStream.streamError);
+            success = NO;
+            break;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        plaintextLength += (unsigned long long)bytesRead;
+        success = encryptAndWrite((NSUInteger)bytesRead);
+    }
+
+    // Apply any padding
+    unsigned long long paddingLength = [self paddedSize:plaintextLength] - plaintextLength;
+    if (success && paddingLength > 0) {
+        memset(inputBuffer.mutableBytes, 0, inputBuffer.length);
+        while (success && paddingLength > 0) {
+            NSUInteger chunkLength = (NSUInteger)MIN(paddingLength, (unsigned long long)inputBuffer.length);
+            paddingLength -= chunkLength;
+            success = encryptAndWrite(chunkLength);
+        }
+    }
+
+    if (success) {
+        size_t bytesEncrypted = 0;
+        cryptStatus = CCCryptorFinal(cryptor, outputBuffer.mutableBytes, outputBuffer.length, &bytesEncrypted);
+        if (cryptStatus != kCCSuccess) {
+            DDLogError(
+                @"%@ %s CCCryptorFinal failed with status: %d", self.tag, __PRETTY_FUNCTION__, (int32_t)cryptStatus);
+            success = NO;
+        } else {
+            CCHmacUpdate(&hmacContext, outputBuffer.bytes, bytesEncrypted);
+            CC_SHA256_Update(&digestContext, outputBuffer.bytes, (CC_LONG)bytesEncrypted);
+            success = WriteToStream(outputStream, outputBuffer.bytes, bytesEncrypted);
+        }
+    }
+    CCCryptorRelease(cryptor);
+    if (!success) {
+        return nil;
+    }
+
+    uint8_t hmac[CC_SHA256_DIGEST_LENGTH];
+    CCHmacFinal(&hmacContext, hmac);
+    if (!WriteToStream(outputStream, hmac, HMAC256_OUTPUT_LENGTH)) {
+        DDLogError(@"%@ Failed to write attachment HMAC.", self.tag);
+        return nil;
+    }
+    CC_SHA256_Update(&digestContext, hmac, HMAC256_OUTPUT_LENGTH);
+
+    uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &digestContext);
+    return [NSData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH];
+}
+
 + (nullable NSData *)encryptAESGCMWithData:(NSData *)plaintext key:(OWSAES256Key *)key
 {
     NSData *initializationVector = [Cryptography generateRandomBytes:kAESGCM256_IVLength];
@@ -12,10 +12,12 @@ NS_ASSUME_NONNULL_BEGIN
 + (dispatch_queue_t)attachmentsQueue;
 
 /**
- * Signal protocol session state must be coordinated on a serial queue. This is sometimes used synchronously,
- * so never dispatching sync *from* this queue to avoid deadlock.
+ * Signal protocol session state must be coordinated on a serial queue per recipient. A recipient always gets the
+ * same queue, and recipients are spread over a fixed number of queues, so that sessions with different recipients
+ * can be used in parallel. These are sometimes used synchronously, so never dispatch sync *from* one of these queues
+ * to avoid deadlock.
  */
-+ (dispatch_queue_t)sessionStoreQueue;
++ (dispatch_queue_t)sessionStoreQueueForRecipientId:(NSString *)recipientId;
 
 /**
  * Serial message sending queue
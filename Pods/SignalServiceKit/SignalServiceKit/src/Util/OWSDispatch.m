@@ -18,14 +18,26 @@ NS_ASSUME_NONNULL_BEGIN
     return queue;
 }
 
-+ (dispatch_queue_t)sessionStoreQueue
++ (dispatch_queue_t)sessionStoreQueueForRecipientId:(NSString *)recipientId
 {
+    OWSAssert(recipientId.length > 0);
+
+    // Enough queues that a group send to many recipients keeps every core busy, and that unrelated recipients
+    // rarely share a queue.
+    static const NSUInteger kSessionStoreQueueCount = 16;
+
     static dispatch_once_t onceToken;
-    static dispatch_queue_t queue;
+    static NSArray<dispatch_queue_t> *queues;
     dispatch_once(&onceToken, ^{
-        queue = dispatch_queue_create("org.whispersystems.signal.sessionStoreQueue", NULL);
+        NSMutableArray<dispatch_queue_t> *mutableQueues = [NSMutableArray arrayWithCapacity:kSessionStoreQueueCount];
+        for (NSUInteger i = 0; i < kSessionStoreQueueCount; i++) {
+            NSString *label =
+                [NSString stringWithFormat:@"org.whispersystems.signal.sessionStoreQueue.%lu", (unsigned long)i];
+            [mutableQueues addObject:dispatch_queue_create(label.UTF8String, NULL)];
+        }
+        queues = [mutableQueues copy];
     });
-    return queue;
+    return queues[recipientId.hash % kSessionStoreQueueCount];
 }
 
 + (dispatch_queue_t)sendingQueue
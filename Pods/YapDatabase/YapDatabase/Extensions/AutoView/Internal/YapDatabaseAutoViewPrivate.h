@@ -18,6 +18,12 @@
 @class YapCache;
 @class YapCollectionKey;
 
+/**
+ * Savepoint keys (in addition to those in YapDatabaseViewPrivate.h)
+**/
+static NSString *const savepoint_key_groupingChanged = @"groupingChanged";
+static NSString *const savepoint_key_sortingChanged  = @"sortingChanged";
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -38,6 +44,7 @@
 	YapDatabaseViewSortingBlock block;
 	YapDatabaseBlockType        blockType;
 	YapDatabaseBlockInvoke      blockInvokeOptions;
+	YapDatabaseViewSortKeyBlock sortKeyBlock;
 }
 
 @end
@@ -125,6 +125,40 @@
 	sortingChanged = NO;
 }
 
+- (NSMutableDictionary *)savepointState
+{
+	YDBLogAutoTrace();
+	
+	NSMutableDictionary *savepointState = [super savepointState];
+	
+	if (grouping)
+		savepointState[changeset_key_grouping] = grouping;
+	if (sorting)
+		savepointState[changeset_key_sorting] = sorting;
+	
+	savepointState[savepoint_key_groupingChanged] = @(groupingChanged);
+	savepointState[savepoint_key_sortingChanged] = @(sortingChanged);
+	
+	return savepointState;
+}
+
+- (void)rollbackToSavepointState:(NSDictionary *)savepointState
+{
+	YDBLogAutoTrace();
+	[super rollbackToSavepointState:savepointState];
+	
+	grouping = savepointState[changeset_key_grouping];
+	sorting = savepointState[changeset_key_sorting];
+	
+	groupingChanged = [savepointState[savepoint_key_groupingChanged] boolValue];
+	sortingChanged = [savepointState[savepoint_key_sortingChanged] boolValue];
+	
+	// These are hints about the pages, which may no longer hold.
+	
+	lastInsertWasAtFirstIndex = NO;
+	lastInsertWasAtLastIndex = NO;
+}
+
 - (void)getInternalChangeset:(NSMutableDictionary **)internalChangesetPtr
            externalChangeset:(NSMutableDictionary **)externalChangesetPtr
               hasDiskChanges:(BOOL *)hasDiskChangesPtr
@@ -142,6 +142,20 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (NSUInteger)findFirstMatchInGroup:(NSString *)group using:(YapDatabaseViewFind *)find;
 
+/**
+ * Finds the range of items whose sort keys are within [minSortKey, maxSortKey] (inclusive).
+ * 
+ * This only works if the view's sorting has a sortKeyBlock (see YapDatabaseViewTypes.h).
+ * It's a binary search over the sort keys stored in the view's pages,
+ * so it doesn't invoke any blocks, or load any objects.
+ * 
+ * @return
+ *   If found, the range of matching items.
+ *   If not found, or if the pages of the group don't have sort keys, returns NSMakeRange(NSNotFound, 0).
+ *   (Pages written before the sortKeyBlock was set don't have sort keys until the view is repopulated.)
+**/
+- (NSRange)findRangeInGroup:(NSString *)group minSortKey:(int64_t)minSortKey maxSortKey:(int64_t)maxSortKey;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
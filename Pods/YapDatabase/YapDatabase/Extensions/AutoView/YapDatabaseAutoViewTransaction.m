@@ -26,6 +26,93 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+/**
+ * Used when populating a view in bulk (see YapDatabaseViewSorting.sortKeyBlock).
+ * 
+ * The sortKey is biased (xor'd with the sign bit), so that unsigned order matches signed order.
+ * The ordinal is the index of the row's collectionKey within the group's list of collectionKeys.
+**/
+typedef struct {
+	uint64_t sortKey;
+	int64_t rowid;
+	NSUInteger ordinal;
+} YapDatabaseAutoViewBulkEntry;
+
+/**
+ * Stable LSD radix sort (by sortKey).
+ * Being stable, rows with equal sort keys retain their enumeration order,
+ * which matches where insertRowid:... would have placed them (at the end of their equal range).
+**/
+static void YapDatabaseAutoViewSortBulkEntries(YapDatabaseAutoViewBulkEntry *entries, NSUInteger count)
+{
+	BOOL isSorted = YES;
+	for (NSUInteger i = 1; i < count; i++)
+	{
+		if (entries[i-1].sortKey > entries[i].sortKey)
+		{
+			isSorted = NO;
+			break;
+		}
+	}
+	
+	if (isSorted) return;
+	
+	YapDatabaseAutoViewBulkEntry *scratch = malloc(count * sizeof(YapDatabaseAutoViewBulkEntry));
+	
+	YapDatabaseAutoViewBulkEntry *src = entries;
+	YapDatabaseAutoViewBulkEntry *dst = scratch;
+	
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		NSUInteger offsets[256] = { 0 };
+		
+		for (NSUInteger i = 0; i < count; i++) {
+			offsets[(src[i].sortKey >> shift) & 0xFF]++;
+		}
+		
+		// Skip the pass if every key has the same byte at this position (e.g. the high bytes of timestamps)
+		if (offsets[(src[0].sortKey >> shift) & 0xFF] == count) continue;
+		
+		NSUInteger offset = 0;
+		for (NSUInteger b = 0; b < 256; b++)
+		{
+			NSUInteger bucketCount = offsets[b];
+			offsets[b] = offset;
+			offset += bucketCount;
+		}
+		
+		for (NSUInteger i = 0; i < count; i++) {
+			dst[offsets[(src[i].sortKey >> shift) & 0xFF]++] = src[i];
+		}
+		
+		YapDatabaseAutoViewBulkEntry *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+	
+	if (src != entries) {
+		memcpy(entries, src, count * sizeof(YapDatabaseAutoViewBulkEntry));
+	}
+	
+	free(scratch);
+}
+
+/**
+ * The rows gathered for a single group, during a bulk population.
+**/
+@interface YapDatabaseAutoViewBulkGroup : NSObject {
+@public
+	
+	NSString *group;
+	NSMutableArray<YapCollectionKey *> *collectionKeys;
+	NSMutableData *entries;
+}
+@end
+
+@implementation YapDatabaseAutoViewBulkGroup
+@end
+
+
 
 @implementation YapDatabaseAutoViewTransaction
 
@@ -59,6 +146,63 @@
 	BOOL needsObject = groupingNeedsObject || sortingNeedsObject;
 	BOOL needsMetadata = groupingNeedsMetadata || sortingNeedsMetadata;
 	
+	// If the sorting provides a sort key, then we can populate the view in bulk.
+	// That is, gather every row (and its sort key) per group, sort each group in memory,
+	// and then write out full pages in a single pass.
+	// This avoids invoking the sorting block log(n) times per row, and rewriting pages over and over.
+	
+	YapDatabaseViewSortKeyBlock sortKeyBlock = sorting->sortKeyBlock;
+	
+	NSMutableArray<YapDatabaseAutoViewBulkGroup *> *bulkGroups = nil;
+	NSMutableDictionary<NSString *, YapDatabaseAutoViewBulkGroup *> *bulkGroupsDict = nil;
+	
+	void (^insertRow)(int64_t rowid, YapCollectionKey *collectionKey, id object, id metadata, NSString *group);
+	
+	if (sortKeyBlock)
+	{
+		bulkGroups = [[NSMutableArray alloc] init];
+		bulkGroupsDict = [[NSMutableDictionary alloc] init];
+		
+		insertRow = ^(int64_t rowid, YapCollectionKey *collectionKey, id object, id metadata, NSString *group){
+			
+			YapDatabaseAutoViewBulkGroup *bulkGroup = bulkGroupsDict[group];
+			if (bulkGroup == nil)
+			{
+				bulkGroup = [[YapDatabaseAutoViewBulkGroup alloc] init];
+				bulkGroup->group = group;
+				bulkGroup->collectionKeys = [[NSMutableArray alloc] init];
+				bulkGroup->entries = [[NSMutableData alloc] init];
+				
+				bulkGroupsDict[group] = bulkGroup;
+				[bulkGroups addObject:bulkGroup];
+			}
+			
+			int64_t sortKey = sortKeyBlock(databaseTransaction, group, collectionKey.collection, collectionKey.key,
+			                               (sortingNeedsObject ? object : nil), (sortingNeedsMetadata ? metadata : nil));
+			
+			YapDatabaseAutoViewBulkEntry entry;
+			entry.sortKey = ((uint64_t)sortKey ^ (1ULL << 63));
+			entry.rowid = rowid;
+			entry.ordinal = [bulkGroup->collectionKeys count];
+			
+			[bulkGroup->entries appendBytes:&entry length:sizeof(entry)];
+			[bulkGroup->collectionKeys addObject:collectionKey];
+		};
+	}
+	else
+	{
+		YapDatabaseViewChangesBitMask flags = (YapDatabaseViewChangedObject | YapDatabaseViewChangedMetadata);
+		
+		insertRow = ^(int64_t rowid, YapCollectionKey *collectionKey, id object, id metadata, NSString *group){
+			
+			[self insertRowid:rowid
+			    collectionKey:collectionKey
+			           object:object
+			         metadata:metadata
+			          inGroup:group withChanges:flags isNew:YES];
+		};
+	}
+	
 	NSString *(^getGroup)(NSString *collection, NSString *key, id object, id metadata);
 	
 	if (grouping->blockType == YapDatabaseBlockTypeWithKey)
@@ -106,8 +250,6 @@
 		};
 	}
 	
-	YapDatabaseViewChangesBitMask flags = (YapDatabaseViewChangedObject | YapDatabaseViewChangedMetadata);
-	
 	if (needsObject && needsMetadata)
 	{
 		if (groupingNeedsObject || groupingNeedsMetadata)
@@ -120,11 +262,7 @@
 				{
 					YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 					
-					[self insertRowid:rowid
-					    collectionKey:collectionKey
-					           object:object
-					         metadata:metadata
-					          inGroup:group withChanges:flags isNew:YES];
+					insertRow(rowid, collectionKey, object, metadata, group);
 				}
 			};
 			
@@ -162,11 +300,7 @@
 				
 				YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 					
-				[self insertRowid:rowid
-				    collectionKey:collectionKey
-				           object:object
-				         metadata:metadata
-				          inGroup:group withChanges:flags isNew:YES];
+				insertRow(rowid, collectionKey, object, metadata, group);
 			};
 			
 			YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
@@ -200,11 +334,7 @@
 				{
 					YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 					
-					[self insertRowid:rowid
-					    collectionKey:collectionKey
-					           object:object
-					          metadata:nil
-					           inGroup:group withChanges:flags isNew:YES];
+					insertRow(rowid, collectionKey, object, nil, group);
 				}
 			};
 			
@@ -244,11 +374,7 @@
 				
 				YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 				
-				[self insertRowid:rowid
-				    collectionKey:collectionKey
-				           object:object
-				          metadata:nil
-				        inGroup:group withChanges:flags isNew:YES];
+				insertRow(rowid, collectionKey, object, nil, group);
 			};
 			
 			YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
@@ -282,11 +408,7 @@
 				{
 					YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 					
-					[self insertRowid:rowid
-					    collectionKey:collectionKey
-					           object:nil
-					         metadata:metadata
-					          inGroup:group withChanges:flags isNew:YES];
+					insertRow(rowid, collectionKey, nil, metadata, group);
 				}
 			};
 			
@@ -327,11 +449,7 @@
 				
 				YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 				
-				[self insertRowid:rowid
-				    collectionKey:collectionKey
-				           object:nil
-				         metadata:metadata
-				          inGroup:group withChanges:flags isNew:YES];
+				insertRow(rowid, collectionKey, nil, metadata, group);
 			};
 			
 			YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
@@ -363,11 +481,7 @@
 			{
 				YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 				
-				[self insertRowid:rowid
-				    collectionKey:collectionKey
-				           object:nil
-				         metadata:nil
-				          inGroup:group withChanges:flags isNew:YES];
+				insertRow(rowid, collectionKey, nil, nil, group);
 			}
 		};
 		
@@ -388,6 +502,46 @@
 		}
 	}
 	
+	if (sortKeyBlock)
+	{
+		// Sort each group (in parallel, as the sorting is pure C and doesn't touch the transaction),
+		// and then write out the pages.
+		
+		dispatch_apply([bulkGroups count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i){
+			
+			YapDatabaseAutoViewBulkGroup *bulkGroup = bulkGroups[i];
+			NSUInteger count = [bulkGroup->collectionKeys count];
+			
+			YapDatabaseAutoViewSortBulkEntries((YapDatabaseAutoViewBulkEntry *)[bulkGroup->entries mutableBytes], count);
+		});
+		
+		for (YapDatabaseAutoViewBulkGroup *bulkGroup in bulkGroups)
+		{
+			NSUInteger count = [bulkGroup->collectionKeys count];
+			const YapDatabaseAutoViewBulkEntry *entries = (const YapDatabaseAutoViewBulkEntry *)[bulkGroup->entries bytes];
+			
+			int64_t *rowids = malloc(count * sizeof(int64_t));
+			int64_t *sortKeys = malloc(count * sizeof(int64_t));
+			NSMutableArray<YapCollectionKey *> *collectionKeys = [[NSMutableArray alloc] initWithCapacity:count];
+			
+			for (NSUInteger i = 0; i < count; i++)
+			{
+				rowids[i] = entries[i].rowid;
+				sortKeys[i] = (int64_t)(entries[i].sortKey ^ (1ULL << 63));
+				[collectionKeys addObject:bulkGroup->collectionKeys[entries[i].ordinal]];
+			}
+			
+			[self insertRowids:rowids
+			          sortKeys:sortKeys
+			    collectionKeys:collectionKeys
+			             count:count
+			      intoNewGroup:bulkGroup->group];
+			
+			free(rowids);
+			free(sortKeys);
+		}
+	}
+	
 	return YES;
 }
 
@@ -442,6 +596,61 @@
 	isRepopulate = NO;
 }
 
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+**/
+- (BOOL)supportsBatchedPopulation
+{
+	return YES;
+}
+
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+**/
+- (BOOL)shouldPopulateCollection:(NSString *)collection
+{
+	YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
+	
+	return (allowedCollections == nil) || [allowedCollections isAllowed:collection];
+}
+
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+ *
+ * The row may already be in the view (if it was modified since the view was registered),
+ * so it's handled as an update which always invokes the grouping & sorting blocks.
+**/
+- (void)populateRowid:(int64_t)rowid
+        collectionKey:(YapCollectionKey *)collectionKey
+               object:(id)object
+             metadata:(id)metadata
+{
+	YDBLogAutoTrace();
+	
+	__unsafe_unretained YapDatabaseAutoViewConnection *viewConnection =
+	  (YapDatabaseAutoViewConnection *)parentConnection;
+	
+	YapDatabaseViewGrouping *grouping = nil;
+	YapDatabaseViewSorting  *sorting  = nil;
+	
+	[viewConnection getGrouping:&grouping
+	                    sorting:&sorting];
+	
+	isBatchPopulate = YES;
+	{
+		[self _handleChangeWithRowid:rowid
+		               collectionKey:collectionKey
+		                      object:object
+		                    metadata:metadata
+		                    grouping:grouping
+		                     sorting:sorting
+		          blockInvokeBitMask:YapDatabaseBlockInvokeIfObjectModified | YapDatabaseBlockInvokeIfMetadataModified
+		              changesBitMask:YapDatabaseViewChangedObject | YapDatabaseViewChangedMetadata
+		                    isInsert:NO];
+	}
+	isBatchPopulate = NO;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Logic
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -469,6 +678,23 @@
 	YapDatabaseViewSorting *sorting = nil;
 	[viewConnection getGrouping:NULL sorting:&sorting];
 	
+	// If the sorting provides a sort key, it's stored alongside the rowid in the page.
+	// Comparisons against rows in such pages are then integer comparisons, which don't load any objects.
+	
+	BOOL hasSortKey = (sorting->sortKeyBlock != nil);
+	int64_t sortKey = 0;
+	
+	if (hasSortKey)
+	{
+		BOOL sortingNeedsObject   = (sorting->blockType & YapDatabaseBlockType_ObjectFlag);
+		BOOL sortingNeedsMetadata = (sorting->blockType & YapDatabaseBlockType_MetadataFlag);
+		
+		sortKey = sorting->sortKeyBlock(databaseTransaction, group, collectionKey.collection, collectionKey.key,
+		                                (sortingNeedsObject ? object : nil), (sortingNeedsMetadata ? metadata : nil));
+	}
+	
+	const int64_t *sortKeyPtr = hasSortKey ? &sortKey : NULL;
+	
 	// Is the key already in the group?
 	// If so:
 	// - its index within the group may or may not have changed.
@@ -509,7 +735,7 @@
 	{
 		// First object added to group.
 		
-		[self insertRowid:rowid collectionKey:collectionKey inGroup:group atIndex:0];
+		[self insertRowid:rowid collectionKey:collectionKey sortKey:sortKeyPtr inGroup:group atIndex:0];
 		return;
 	}
 	
@@ -520,6 +746,18 @@
 	
 	NSComparisonResult (^compare)(NSUInteger) = ^NSComparisonResult (NSUInteger index){
 		
+		if (hasSortKey)
+		{
+			int64_t anotherSortKey = 0;
+			if ([self getSortKey:&anotherSortKey atIndex:index inGroup:group])
+			{
+				if (sortKey < anotherSortKey) return NSOrderedAscending;
+				if (sortKey > anotherSortKey) return NSOrderedDescending;
+				
+				return NSOrderedSame;
+			}
+		}
+		
 		int64_t anotherRowid = 0;
 		[self getRowid:&anotherRowid atIndex:index inGroup:group];
 		
@@ -619,6 +857,10 @@
 			
 			YDBLogVerbose(@"Updated key(%@) in group(%@) maintains current index", collectionKey.key, group);
 			
+			if (hasSortKey) {
+				[self setSortKey:sortKey forRowid:rowid withLocator:existingLocator];
+			}
+			
 			[parentConnection->changes addObject:
 			  [YapDatabaseViewRowChange updateCollectionKey:collectionKey
 			                                        inGroup:group
@@ -651,6 +893,7 @@
 			              collectionKey.key, collectionKey.collection, group);
 			
 			[self insertRowid:rowid collectionKey:collectionKey
+			                              sortKey:sortKeyPtr
 			                              inGroup:group
 			                              atIndex:0];
 			return;
@@ -667,12 +910,37 @@
 			              collectionKey.key, collectionKey.collection, group);
 			
 			[self insertRowid:rowid collectionKey:collectionKey
+			                              sortKey:sortKeyPtr
 			                              inGroup:group
 			                              atIndex:count];
 			return;
 		}
 	}
 	
+	// Optimization 3:
+	//
+	// If every page we'd need to look at has sort keys, then we can binary search the sort keys directly.
+	// We want the index just past any equal keys, to match the binary search below.
+	
+	if (hasSortKey)
+	{
+		NSUInteger index = 0;
+		if ([self getIndex:&index ofSortKey:sortKey upper:YES inGroup:group])
+		{
+			YDBLogVerbose(@"Insert key(%@) collection(%@) in group(%@) at index(%lu) (sort key)",
+			              collectionKey.key, collectionKey.collection, group, (unsigned long)index);
+			
+			[self insertRowid:rowid collectionKey:collectionKey
+			                              sortKey:sortKeyPtr
+			                              inGroup:group
+			                              atIndex:index];
+			
+			viewConnection->lastInsertWasAtFirstIndex = (index == 0);
+			viewConnection->lastInsertWasAtLastIndex  = (index == count);
+			return;
+		}
+	}
+	
 	// Otherwise:
 	//
 	// Binary search operation.
@@ -704,6 +972,7 @@
 	              collectionKey.key, collectionKey.collection, group, (unsigned long)loopCount);
 	
 	[self insertRowid:rowid collectionKey:collectionKey
+	                              sortKey:sortKeyPtr
 	                              inGroup:group
 	                              atIndex:min];
 	
@@ -746,7 +1015,7 @@
 	BOOL groupingMayHaveChanged;
 	BOOL sortingMayHaveChanged;
 	
-	if (isInsert)
+	if (isInsert || isBatchPopulate)
 	{
 		groupingMayHaveChanged = YES;
 		sortingMayHaveChanged  = YES;
@@ -1290,6 +1559,29 @@
 	return range.location;
 }
 
+/**
+ * See header file for extensive documentation for this method.
+**/
+- (NSRange)findRangeInGroup:(NSString *)group minSortKey:(int64_t)minSortKey maxSortKey:(int64_t)maxSortKey
+{
+	if (group == nil || minSortKey > maxSortKey)
+		return NSMakeRange(NSNotFound, 0);
+	
+	NSUInteger start = 0;
+	NSUInteger end = 0;
+	
+	if (![self getIndex:&start ofSortKey:minSortKey upper:NO inGroup:group])
+		return NSMakeRange(NSNotFound, 0);
+	
+	if (![self getIndex:&end ofSortKey:maxSortKey upper:YES inGroup:group])
+		return NSMakeRange(NSNotFound, 0);
+	
+	if (end <= start)
+		return NSMakeRange(NSNotFound, 0);
+	
+	return NSMakeRange(start, end - start);
+}
+
 /**
  * See header file for extensive documentation for this method.
 **/
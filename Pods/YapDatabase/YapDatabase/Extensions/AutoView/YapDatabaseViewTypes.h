@@ -148,6 +148,34 @@ typedef NSComparisonResult (^YapDatabaseViewSortingWithRowBlock)
 @property (nonatomic, assign, readonly) YapDatabaseBlockType        blockType;
 @property (nonatomic, assign, readonly) YapDatabaseBlockInvoke      blockInvokeOptions;
 
+/**
+ * A sort key block maps a row to a single int64_t, such that rows are ordered by their sort keys.
+ *
+ * The object & metadata parameters are only provided if the sorting block requires them.
+ * (e.g. if you use withObjectBlock:, then the metadata parameter is always nil.)
+ *
+ * The sort key MUST agree with the sorting block.
+ * That is, for any 2 rows in the same group, comparing their sort keys must give the same result
+ * as invoking the sorting block. Rows with equal sort keys must compare as NSOrderedSame.
+ *
+ * This is optional. But if you set it, the view can populate itself in bulk.
+ * Rather than inserting every row with a binary search (invoking the sorting block log(n) times per row),
+ * the view extracts the sort key of every row once, sorts the keys in memory, and writes out full pages.
+ * This turns a (re)population from minutes into seconds for large views.
+ *
+ * The view also stores the sort key of every row within its pages.
+ * So inserting a row is a binary search over integers, rather than invoking the sorting block
+ * (and loading the objects of neighboring rows). It also enables findRangeInGroup:minSortKey:maxSortKey:.
+ * Pages written before the sortKeyBlock was set only gain sort keys when the view is repopulated.
+ *
+ * The sortKeyBlock must be set before the sorting is handed to the view.
+**/
+typedef int64_t (^YapDatabaseViewSortKeyBlock)
+                 (YapDatabaseReadTransaction *transaction, NSString *group,
+                      NSString *collection, NSString *key, _Nullable id object, _Nullable id metadata);
+
+@property (nonatomic, copy, readwrite, nullable) YapDatabaseViewSortKeyBlock sortKeyBlock;
+
 @end
 
 #pragma mark -
@@ -150,6 +150,7 @@
 @synthesize block = block;
 @synthesize blockType = blockType;
 @synthesize blockInvokeOptions = blockInvokeOptions;
+@synthesize sortKeyBlock = sortKeyBlock;
 
 + (instancetype)withKeyBlock:(YapDatabaseViewSortingWithKeyBlock)block
 {
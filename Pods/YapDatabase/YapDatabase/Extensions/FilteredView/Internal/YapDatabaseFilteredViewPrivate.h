@@ -21,6 +21,11 @@ static NSString *const ext_key_parentViewName = @"parentViewName";
 **/
 static NSString *const changeset_key_filtering = @"filtering";
 
+/**
+ * Savepoint keys (in addition to those in YapDatabaseViewPrivate.h)
+**/
+static NSString *const savepoint_key_filteringChanged = @"filteringChanged";
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
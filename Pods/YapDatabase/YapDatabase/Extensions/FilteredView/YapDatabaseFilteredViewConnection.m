@@ -109,6 +109,28 @@
 	[super postCommitCleanup];
 }
 
+- (NSMutableDictionary *)savepointState
+{
+	YDBLogAutoTrace();
+	
+	NSMutableDictionary *savepointState = [super savepointState];
+	
+	if (filtering)
+		savepointState[changeset_key_filtering] = filtering;
+	savepointState[savepoint_key_filteringChanged] = @(filteringChanged);
+	
+	return savepointState;
+}
+
+- (void)rollbackToSavepointState:(NSDictionary *)savepointState
+{
+	YDBLogAutoTrace();
+	[super rollbackToSavepointState:savepointState];
+	
+	filtering = savepointState[changeset_key_filtering];
+	filteringChanged = [savepointState[savepoint_key_filteringChanged] boolValue];
+}
+
 - (void)getInternalChangeset:(NSMutableDictionary **)internalChangesetPtr
            externalChangeset:(NSMutableDictionary **)externalChangesetPtr
               hasDiskChanges:(BOOL *)hasDiskChangesPtr
@@ -2,6 +2,7 @@
 #import "YapDatabaseFullTextSearchHandler.h"
 #import "YapDatabaseFullTextSearchConnection.h"
 #import "YapDatabaseFullTextSearchTransaction.h"
+#import "YapDatabaseFullTextSearchTokenizer.h"
 
 #import "YapDatabase.h"
 #import "YapDatabaseConnection.h"
@@ -77,9 +78,11 @@
 - (sqlite3_stmt *)setRowidStatement;
 - (sqlite3_stmt *)removeRowidStatement;
 - (sqlite3_stmt *)removeAllStatement;
+- (sqlite3_stmt *)containsRowidStatement;
 - (sqlite3_stmt *)queryStatement;
 - (sqlite3_stmt *)bm25QueryStatement;
 - (sqlite3_stmt *)bm25QueryStatementWithWeights:(NSArray<NSNumber *> *)weights;
+- (sqlite3_stmt *)bm25QuerySnippetStatementWithWeights:(NSArray<NSNumber *> *)weights;
 - (sqlite3_stmt *)querySnippetStatement;
 - (sqlite3_stmt *)rowidQueryStatement;
 - (sqlite3_stmt *)rowidQuerySnippetStatement;
@@ -0,0 +1,18 @@
+#import <Foundation/Foundation.h>
+
+#import "sqlite3.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Registers the tokenizers listed in YapDatabaseFullTextSearch.h (e.g. YapDatabaseFullTextSearchUnicodeTokenizer)
+ * with the given sqlite connection, if they're not already registered.
+ *
+ * Custom FTS5 tokenizers are per-connection state,
+ * so this must be done on every connection before it touches a table that uses them.
+ *
+ * Returns NO if the FTS5 module isn't available.
+**/
+BOOL YapDatabaseFullTextSearchRegisterTokenizers(sqlite3 *db);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,327 @@
+#import "YapDatabaseFullTextSearchTokenizer.h"
+#import "YapDatabaseFullTextSearch.h"
+
+#import "YapDatabaseLogging.h"
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+/**
+ * Hex identifiers shorter than this (after the "0x") aren't worth a second token.
+**/
+#define YAP_FTS_MIN_HEX_IDENTIFIER_DIGITS 8
+
+/**
+ * The yap_unicode tokenizer wraps sqlite's builtin unicode61 tokenizer,
+ * which does the case & diacritic folding, and to which all arguments are passed.
+ *
+ * The text is scanned for emoji, which unicode61 would otherwise treat as separators.
+ * The text between them is handed to unicode61, and each emoji becomes a token of its own.
+ *
+ * Every token produced by unicode61 passes through yapUnicodeBaseToken on its way out,
+ * which is where hex identifiers get their second token.
+**/
+typedef struct {
+	fts5_tokenizer base;
+	Fts5Tokenizer *baseInstance;
+} YapUnicodeTokenizer;
+
+typedef struct {
+	void *ctx;
+	int (*xToken)(void *ctx, int tflags, const char *token, int nToken, int iStart, int iEnd);
+	int flags;
+	int offset;
+} YapUnicodeTokenizeContext;
+
+/**
+ * Decodes a single codepoint, and returns the number of bytes it occupied (always at least 1).
+ * Malformed sequences decode to U+FFFD, one byte at a time.
+**/
+NS_INLINE int YapUnicodeDecode(const unsigned char *s, int n, uint32_t *cp)
+{
+	unsigned char c = s[0];
+	if (c < 0x80)
+	{
+		*cp = c;
+		return 1;
+	}
+
+	int length;
+	uint32_t value;
+
+	if      ((c & 0xE0) == 0xC0) { length = 2; value = c & 0x1F; }
+	else if ((c & 0xF0) == 0xE0) { length = 3; value = c & 0x0F; }
+	else if ((c & 0xF8) == 0xF0) { length = 4; value = c & 0x07; }
+	else
+	{
+		*cp = 0xFFFD;
+		return 1;
+	}
+
+	if (length > n)
+	{
+		*cp = 0xFFFD;
+		return 1;
+	}
+
+	for (int i = 1; i < length; i++)
+	{
+		if ((s[i] & 0xC0) != 0x80)
+		{
+			*cp = 0xFFFD;
+			return 1;
+		}
+		value = (value << 6) | (s[i] & 0x3F);
+	}
+
+	*cp = value;
+	return length;
+}
+
+NS_INLINE BOOL YapUnicodeIsRegionalIndicator(uint32_t cp)
+{
+	return (cp >= 0x1F1E6 && cp <= 0x1F1FF);
+}
+
+/**
+ * Codepoints which modify the emoji before them, and are folded away (so that 👍🏽 matches 👍).
+**/
+NS_INLINE BOOL YapUnicodeIsEmojiModifier(uint32_t cp)
+{
+	return (cp >= 0x1F3FB && cp <= 0x1F3FF)  // skin tones
+	    || (cp == 0xFE0E || cp == 0xFE0F)    // variation selectors
+	    || (cp == 0x200D)                    // zero width joiner
+	    || (cp == 0x20E3)                    // combining enclosing keycap
+	    || (cp >= 0xE0020 && cp <= 0xE007F); // tags
+}
+
+NS_INLINE BOOL YapUnicodeIsEmoji(uint32_t cp)
+{
+	return (cp >= 0x1F000 && cp <= 0x1FAFF && !(cp >= 0x1F3FB && cp <= 0x1F3FF))
+	    || (cp >= 0x2300 && cp <= 0x23FF)    // misc technical (⌚, ⏰, ...)
+	    || (cp >= 0x2600 && cp <= 0x27BF)    // misc symbols & dingbats
+	    || (cp >= 0x2B00 && cp <= 0x2BFF)    // misc symbols & arrows (⭐, ...)
+	    || (cp == 0x3030 || cp == 0x303D || cp == 0x3297 || cp == 0x3299);
+}
+
+/**
+ * Matches tokens such as "0x3f2a9c01...".
+ * unicode61 has already folded the case.
+**/
+NS_INLINE BOOL YapUnicodeIsHexIdentifier(const char *token, int nToken)
+{
+	if (nToken < 2 + YAP_FTS_MIN_HEX_IDENTIFIER_DIGITS) return NO;
+	if (token[0] != '0' || token[1] != 'x') return NO;
+
+	for (int i = 2; i < nToken; i++)
+	{
+		char c = token[i];
+		if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return NO;
+	}
+
+	return YES;
+}
+
+static int yapUnicodeCreate(void *context, const char **azArg, int nArg, Fts5Tokenizer **ppOut)
+{
+	fts5_api *api = (fts5_api *)context;
+
+	YapUnicodeTokenizer *tokenizer = sqlite3_malloc(sizeof(YapUnicodeTokenizer));
+	if (tokenizer == NULL) return SQLITE_NOMEM;
+
+	memset(tokenizer, 0, sizeof(YapUnicodeTokenizer));
+
+	void *baseContext = NULL;
+	int rc = api->xFindTokenizer(api, "unicode61", &baseContext, &tokenizer->base);
+	if (rc == SQLITE_OK)
+	{
+		rc = tokenizer->base.xCreate(baseContext, azArg, nArg, &tokenizer->baseInstance);
+	}
+
+	if (rc != SQLITE_OK)
+	{
+		sqlite3_free(tokenizer);
+		tokenizer = NULL;
+	}
+
+	*ppOut = (Fts5Tokenizer *)tokenizer;
+	return rc;
+}
+
+static void yapUnicodeDelete(Fts5Tokenizer *pTok)
+{
+	YapUnicodeTokenizer *tokenizer = (YapUnicodeTokenizer *)pTok;
+	if (tokenizer == NULL) return;
+
+	if (tokenizer->baseInstance) {
+		tokenizer->base.xDelete(tokenizer->baseInstance);
+	}
+	sqlite3_free(tokenizer);
+}
+
+static int yapUnicodeBaseToken(void *ctx, int tflags, const char *token, int nToken, int iStart, int iEnd)
+{
+	YapUnicodeTokenizeContext *context = (YapUnicodeTokenizeContext *)ctx;
+
+	iStart += context->offset;
+	iEnd += context->offset;
+
+	int rc = context->xToken(context->ctx, tflags, token, nToken, iStart, iEnd);
+
+	// Index hex identifiers with and without their prefix, so that either one matches.
+	// Queries are left alone: "0x..." in a query matches the first token, and the bare digits match the second.
+
+	if (rc == SQLITE_OK &&
+	    !(context->flags & FTS5_TOKENIZE_QUERY) &&
+	    YapUnicodeIsHexIdentifier(token, nToken))
+	{
+		rc = context->xToken(context->ctx, FTS5_TOKEN_COLOCATED, token + 2, nToken - 2, iStart, iEnd);
+	}
+
+	return rc;
+}
+
+static int yapUnicodeTokenize(Fts5Tokenizer *pTok, void *ctx, int flags, const char *text, int nText,
+                              int (*xToken)(void *ctx, int tflags, const char *token, int nToken, int iStart, int iEnd))
+{
+	YapUnicodeTokenizer *tokenizer = (YapUnicodeTokenizer *)pTok;
+
+	YapUnicodeTokenizeContext context;
+	context.ctx = ctx;
+	context.xToken = xToken;
+	context.flags = flags;
+	context.offset = 0;
+
+	const unsigned char *bytes = (const unsigned char *)text;
+
+	int rc = SQLITE_OK;
+	int pending = 0; // start of the text that has yet to be handed to unicode61
+	int i = 0;
+
+	while (i < nText)
+	{
+		uint32_t cp;
+		int length = YapUnicodeDecode(bytes + i, nText - i, &cp);
+
+		if (!YapUnicodeIsEmoji(cp))
+		{
+			i += length;
+			continue;
+		}
+
+		if (i > pending)
+		{
+			context.offset = pending;
+			rc = tokenizer->base.xTokenize(tokenizer->baseInstance, &context, flags,
+			                               text + pending, i - pending, yapUnicodeBaseToken);
+			if (rc != SQLITE_OK) break;
+		}
+
+		int tokenStart = i;
+		int tokenLength = length;
+		i += length;
+
+		// A flag is a pair of regional indicators.
+
+		if (YapUnicodeIsRegionalIndicator(cp) && i < nText)
+		{
+			uint32_t next;
+			int nextLength = YapUnicodeDecode(bytes + i, nText - i, &next);
+
+			if (YapUnicodeIsRegionalIndicator(next))
+			{
+				tokenLength += nextLength;
+				i += nextLength;
+			}
+		}
+
+		// Modifiers are part of the emoji's span in the text (for snippets), but not of the token.
+
+		while (i < nText)
+		{
+			uint32_t next;
+			int nextLength = YapUnicodeDecode(bytes + i, nText - i, &next);
+
+			if (!YapUnicodeIsEmojiModifier(next)) break;
+			i += nextLength;
+		}
+
+		rc = xToken(ctx, 0, text + tokenStart, tokenLength, tokenStart, i);
+		if (rc != SQLITE_OK) break;
+
+		pending = i;
+	}
+
+	if (rc == SQLITE_OK && nText > pending)
+	{
+		context.offset = pending;
+		rc = tokenizer->base.xTokenize(tokenizer->baseInstance, &context, flags,
+		                               text + pending, nText - pending, yapUnicodeBaseToken);
+	}
+
+	return rc;
+}
+
+/**
+ * Prior to sqlite 3.20, the fts5_api pointer is returned (as a blob) by "SELECT fts5()".
+**/
+static fts5_api *YapDatabaseFullTextSearchAPI(sqlite3 *db)
+{
+	fts5_api *api = NULL;
+	sqlite3_stmt *statement = NULL;
+
+	if (sqlite3_prepare_v2(db, "SELECT fts5();", -1, &statement, NULL) == SQLITE_OK &&
+	    sqlite3_step(statement) == SQLITE_ROW &&
+	    sqlite3_column_bytes(statement, 0) == sizeof(api))
+	{
+		memcpy(&api, sqlite3_column_blob(statement, 0), sizeof(api));
+	}
+
+	sqlite3_finalize(statement);
+	return api;
+}
+
+BOOL YapDatabaseFullTextSearchRegisterTokenizers(sqlite3 *db)
+{
+	fts5_api *api = YapDatabaseFullTextSearchAPI(db);
+	if (api == NULL)
+	{
+		YDBLogWarn(@"%s - FTS5 is not available: %s", __FUNCTION__, sqlite3_errmsg(db));
+		return NO;
+	}
+
+	const char *name = [YapDatabaseFullTextSearchUnicodeTokenizer UTF8String];
+
+	void *existingContext = NULL;
+	fts5_tokenizer existing;
+	if (api->xFindTokenizer(api, name, &existingContext, &existing) == SQLITE_OK)
+	{
+		return YES;
+	}
+
+	fts5_tokenizer tokenizer;
+	tokenizer.xCreate = yapUnicodeCreate;
+	tokenizer.xDelete = yapUnicodeDelete;
+	tokenizer.xTokenize = yapUnicodeTokenize;
+
+	int status = api->xCreateTokenizer(api, name, (void *)api, &tokenizer, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%s - Error registering tokenizer (%s): %d %s", __FUNCTION__, name, status, sqlite3_errmsg(db));
+		return NO;
+	}
+
+	return YES;
+}
@@ -24,6 +24,20 @@ extern NSString *const YapDatabaseFullTextSearchFTS5Version;
 extern NSString *const YapDatabaseFullTextSearchFTS4Version;
 extern NSString *const YapDatabaseFullTextSearchFTS3Version;
 
+/**
+ * The name of an FTS5 tokenizer, which is registered on every connection that uses an FTS5 extension.
+ *
+ * It's sqlite's unicode61 tokenizer (which folds case, and optionally diacritics), with two additions:
+ * - Emoji are indexed as tokens, rather than being discarded as separators.
+ *   Skin tone modifiers and variation selectors are ignored, and a flag is a single token.
+ * - Hex identifiers (such as "0x3f2a9c01...") are indexed both with and without the "0x" prefix,
+ *   so that a search for either form matches.
+ *
+ * To use it, specify it in the options (any arguments are passed along to unicode61):
+ * options:@{ @"tokenize": @"'yap_unicode remove_diacritics 1'" }
+**/
+extern NSString *const YapDatabaseFullTextSearchUnicodeTokenizer;
+
 
 @interface YapDatabaseFullTextSearch : YapDatabaseExtension
 
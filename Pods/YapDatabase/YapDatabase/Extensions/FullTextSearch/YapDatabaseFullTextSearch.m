@@ -26,6 +26,8 @@ NSString *const YapDatabaseFullTextSearchFTS5Version = @"fts5";
 NSString *const YapDatabaseFullTextSearchFTS4Version = @"fts4";
 NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
 
+NSString *const YapDatabaseFullTextSearchUnicodeTokenizer = @"yap_unicode";
+
 
 @implementation YapDatabaseFullTextSearch
 
@@ -35,6 +37,10 @@ NSString *const YapDatabaseFullTextSearchFTS3Version = @"fts3";
 {
 	sqlite3 *db = transaction->connection->db;
 	
+	// Dropping an FTS5 table requires its tokenizer to be available.
+	// This connection may not have set up the extension, so it may not have been registered yet.
+	YapDatabaseFullTextSearchRegisterTokenizers(db);
+	
 	NSString *tableName = [self tableNameForRegisteredName:registeredName];
 	NSString *dropTable = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\";", tableName];
 	
@@ -29,8 +29,11 @@
 	sqlite3_stmt *setRowidStatement;
 	sqlite3_stmt *removeRowidStatement;
 	sqlite3_stmt *removeAllStatement;
+	sqlite3_stmt *containsRowidStatement;
 	sqlite3_stmt *queryStatement;
 	sqlite3_stmt *bm25QueryStatement;
+	sqlite3_stmt *bm25QuerySnippetStatement;
+	NSArray<NSNumber *> *bm25QuerySnippetWeights;
 	sqlite3_stmt *querySnippetStatement;
 	sqlite3_stmt *rowidQueryStatement;
 	sqlite3_stmt *rowidQuerySnippetStatement;
@@ -45,6 +48,11 @@
 	{
 		parent = inParent;
 		databaseConnection = inDatabaseConnection;
+		
+		if ([parent->ftsVersion isEqualToString:YapDatabaseFullTextSearchFTS5Version])
+		{
+			YapDatabaseFullTextSearchRegisterTokenizers(databaseConnection->db);
+		}
 	}
 	return self;
 }
@@ -60,8 +68,10 @@
 	sqlite_finalize_null(&setRowidStatement);
 	sqlite_finalize_null(&removeRowidStatement);
 	sqlite_finalize_null(&removeAllStatement);
+	sqlite_finalize_null(&containsRowidStatement);
 	sqlite_finalize_null(&queryStatement);
 	sqlite_finalize_null(&bm25QueryStatement);
+	sqlite_finalize_null(&bm25QuerySnippetStatement);
 	sqlite_finalize_null(&querySnippetStatement);
 	sqlite_finalize_null(&rowidQueryStatement);
 	sqlite_finalize_null(&rowidQuerySnippetStatement);
@@ -283,6 +293,25 @@
 	return *statement;
 }
 
+- (sqlite3_stmt *)containsRowidStatement
+{
+	sqlite3_stmt **statement = &containsRowidStatement;
+	if (*statement == NULL)
+	{
+		NSString *string = [NSString stringWithFormat:@"SELECT 1 FROM \"%@\" WHERE \"rowid\" = ?;", [parent tableName]];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+	}
+	
+	return *statement;
+}
+
 - (sqlite3_stmt *)queryStatement
 {
 	sqlite3_stmt **statement = &queryStatement;
@@ -346,6 +375,45 @@
     return statement;
 }
 
+/**
+ * The statement is cached, along with the weights it was prepared with,
+ * as callers tend to use the same weights for every query.
+**/
+- (sqlite3_stmt *)bm25QuerySnippetStatementWithWeights:(NSArray<NSNumber *> *)weights
+{
+	if (weights == nil) weights = @[];
+	
+	sqlite3_stmt **statement = &bm25QuerySnippetStatement;
+	if (*statement != NULL && ![bm25QuerySnippetWeights isEqualToArray:weights])
+	{
+		sqlite_finalize_null(statement);
+	}
+	
+	if (*statement == NULL)
+	{
+		NSString *bm25 = [weights count] > 0
+		  ? [NSString stringWithFormat:@"bm25(\"%@\", %@)", [parent tableName], [weights componentsJoinedByString:@", "]]
+		  : [NSString stringWithFormat:@"bm25(\"%@\")", [parent tableName]];
+		
+		NSString *string = [NSString stringWithFormat:
+		  @"SELECT \"rowid\", %2$@ AS \"score\", snippet(\"%1$@\", ?, ?, ?, ?, ?) FROM \"%1$@\""
+		  @" WHERE \"%1$@\" MATCH ? ORDER BY \"score\" LIMIT ? OFFSET ?;",
+		  [parent tableName], bm25];
+		
+		sqlite3 *db = databaseConnection->db;
+		
+		int status = sqlite3_prepare_v2(db, [string UTF8String], -1, statement, NULL);
+		if (status != SQLITE_OK)
+		{
+			YDBLogError(@"%@: Error creating prepared statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		bm25QuerySnippetWeights = [weights copy];
+	}
+	
+	return *statement;
+}
+
 - (sqlite3_stmt *)querySnippetStatement
 {
 	sqlite3_stmt **statement = &querySnippetStatement;
@@ -62,6 +62,18 @@ NS_ASSUME_NONNULL_BEGIN
                              withWeights:(nullable NSArray<NSNumber *> *)weights
                               usingBlock:(void (^)(NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block;
 
+// FTS5 bm25 ordering + Snippets, a page at a time.
+// The rows are ranked by bm25, skipping the first `offset` of them, and enumerating at most `limit` (zero for no limit).
+// The rowid may be used to identify a row across pages, as it doesn't change while the row exists.
+
+- (void)enumerateBm25OrderedKeysMatching:(NSString *)query
+                             withWeights:(nullable NSArray<NSNumber *> *)weights
+                          snippetOptions:(nullable YapDatabaseFullTextSearchSnippetOptions *)options
+                                  offset:(NSUInteger)offset
+                                   limit:(NSUInteger)limit
+                              usingBlock:
+            (void (^)(NSString *snippet, int64_t rowid, NSString *collection, NSString *key, BOOL *stop))block;
+
 // Query matching + Snippets
 
 - (void)enumerateKeysMatching:(NSString *)query
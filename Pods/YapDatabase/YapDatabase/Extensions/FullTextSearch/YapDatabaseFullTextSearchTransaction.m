@@ -64,7 +64,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 		}
 		
 		if (![self createTable]) return NO;
-		if (![self populate]) return NO;
+		if (![self populateOrBeginBatchedPopulation]) return NO;
 		
 		[self setIntValue:classVersion forExtensionKey:ext_key__classVersion persistent:YES];
 		
@@ -105,7 +105,7 @@ static NSString *const ext_key__version_deprecated = @"version";
 		{
 			if (![self dropTable]) return NO;
 			if (![self createTable]) return NO;
-			if (![self populate]) return NO;
+			if (![self populateOrBeginBatchedPopulation]) return NO;
 			
 			[self setStringValue:versionTag forExtensionKey:ext_key__versionTag persistent:YES];
 			
@@ -309,6 +309,53 @@ static NSString *const ext_key__version_deprecated = @"version";
 	return YES;
 }
 
+/**
+ * Internal method.
+ *
+ * If the extension was registered with a populationBatchSize, then the table is emptied here,
+ * and populated afterwards in batches. Otherwise the table is populated now, within the registration transaction.
+**/
+- (BOOL)populateOrBeginBatchedPopulation
+{
+	if ([self populatesInBatches])
+	{
+		[self removeAllRowids];
+		[self beginBatchedPopulation];
+		
+		return YES;
+	}
+	else
+	{
+		return [self populate];
+	}
+}
+
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+**/
+- (BOOL)supportsBatchedPopulation
+{
+	return YES;
+}
+
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+ *
+ * The row may already be in the index (if it was modified since the extension was registered),
+ * so it's handled as an update.
+**/
+- (void)populateRowid:(int64_t)rowid
+        collectionKey:(YapCollectionKey *)collectionKey
+               object:(id)object
+             metadata:(id)metadata
+{
+	[self _handleChangeWithRowid:rowid
+	               collectionKey:collectionKey
+	                      object:object
+	                    metadata:metadata
+	                    isInsert:NO];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -387,6 +434,36 @@ static NSString *const ext_key__version_deprecated = @"version";
 	[parentConnection->mutationStack markAsMutated];
 }
 
+- (BOOL)containsRowid:(int64_t)rowid
+{
+	sqlite3_stmt *statement = [parentConnection containsRowidStatement];
+	if (statement == NULL) return YES;
+	
+	// SELECT 1 FROM "tableName" WHERE "rowid" = ?;
+	
+	sqlite3_bind_int64(statement, SQLITE_BIND_START, rowid);
+	
+	BOOL result = NO;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		result = YES;
+	}
+	else if (status != SQLITE_DONE)
+	{
+		YDBLogError(@"Error executing 'containsRowidStatement': %d %s",
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		
+		result = YES; // Err on the side of removing it
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	return result;
+}
+
 - (void)removeRowid:(int64_t)rowid
 {
 	YDBLogAutoTrace();
@@ -449,13 +526,9 @@ static NSString *const ext_key__version_deprecated = @"version";
 	
 	[query appendString:@");"];
 	
-	sqlite3_stmt *statement;
-	
-	int status = sqlite3_prepare_v2(databaseTransaction->connection->db, [query UTF8String], -1, &statement, NULL);
-	if (status != SQLITE_OK)
+	sqlite3_stmt *statement = [databaseTransaction->connection cachedStatementForQuery:query];
+	if (statement == NULL)
 	{
-		YDBLogError(@"Error creating 'removeRowids' statement: %d %s",
-		            status, sqlite3_errmsg(databaseTransaction->connection->db));
 		return;
 	}
 	
@@ -466,14 +539,15 @@ static NSString *const ext_key__version_deprecated = @"version";
 		sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
 	}
 	
-	status = sqlite3_step(statement);
+	int status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
 	{
 		YDBLogError(@"Error executing 'removeRowids' statement: %d %s",
 		            status, sqlite3_errmsg(databaseTransaction->connection->db));
 	}
 	
-	sqlite3_finalize(statement);
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
 	
 	[parentConnection->mutationStack markAsMutated];
 }
@@ -545,6 +619,14 @@ static NSString *const ext_key__version_deprecated = @"version";
 	databaseTransaction = nil; // Do not remove !
 }
 
+/**
+ * Every change is written straight to the fts table, so the savepoint takes care of everything.
+**/
+- (BOOL)supportsSavepoints
+{
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Transaction Hooks
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -598,7 +680,14 @@ static NSString *const ext_key__version_deprecated = @"version";
 	
 	if ([parentConnection->blockDict count] == 0)
 	{
-		// This was an insert operation, so we don't have to worry about removing anything.
+		// If this was an insert operation, we don't have to worry about removing anything.
+		// Otherwise the row may have been indexed previously, and no longer should be.
+		// (Most rows never are, so check first, rather than issuing a delete for every update.)
+		
+		if (!isInsert && [self containsRowid:rowid])
+		{
+			[self removeRowid:rowid];
+		}
 	}
 	else
 	{
@@ -1015,6 +1104,12 @@ static NSString *const ext_key__version_deprecated = @"version";
     sqlite3_reset(statement);
     FreeYapDatabaseString(&_query);
     
+    if ([weights count] > 0)
+    {
+        // Statements with weights aren't cached (see bm25QueryStatementWithWeights:)
+        sqlite3_finalize(statement);
+    }
+    
     if (!stop && mutation.isMutated)
     {
         @throw [databaseTransaction mutationDuringEnumerationException];
@@ -1072,6 +1167,146 @@ static NSString *const ext_key__version_deprecated = @"version";
     }];
 }
 
+- (void)enumerateBm25OrderedRowidsMatching:(NSString *)query
+                               withWeights:(nullable NSArray<NSNumber *> *)weights
+                            snippetOptions:(nullable YapDatabaseFullTextSearchSnippetOptions *)inOptions
+                                    offset:(NSUInteger)offset
+                                     limit:(NSUInteger)limit
+                                usingBlock:(void (^)(NSString *snippet, int64_t rowid, BOOL *stop))block
+{
+	if (![parentConnection->parent.ftsVersion isEqualToString:YapDatabaseFullTextSearchFTS5Version]) {
+		NSString *reason = [NSString stringWithFormat:
+		                    @"bm25 ordering used on non fts5 extension %@", parentConnection->parent.registeredName];
+		
+		NSDictionary *userInfo = @{ NSLocalizedRecoverySuggestionErrorKey:
+		                            @"You may want to initialize that extension with YapDatabaseFullTextSearchFTS5Version" };
+		
+		@throw [NSException exceptionWithName:@"YapDatabaseFullTextSearch" reason:reason userInfo:userInfo];
+		return;
+	}
+	
+	if (block == nil) return;
+	if ([query length] == 0) return;
+	
+	sqlite3_stmt *statement = [parentConnection bm25QuerySnippetStatementWithWeights:weights];
+	if (statement == NULL) return;
+	
+	YapDatabaseFullTextSearchSnippetOptions *options;
+	if (inOptions)
+		options = [inOptions copy];
+	else
+		options = [[YapDatabaseFullTextSearchSnippetOptions alloc] init]; // default snippet options
+	
+	BOOL stop = NO;
+	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
+	
+	// SELECT "rowid", bm25("tableName", ...) AS "score", snippet("tableName", ?, ?, ?, ?, ?) FROM "tableName"
+	//   WHERE "tableName" MATCH ? ORDER BY "score" LIMIT ? OFFSET ?;
+	//
+	// Note: FTS5's snippet() takes the column index first, unlike FTS3/4's.
+	
+	int const column_idx_rowid        = SQLITE_COLUMN_START + 0;
+	int const column_idx_snippet      = SQLITE_COLUMN_START + 2;
+	
+	int const bind_idx_columnIndex    = SQLITE_BIND_START + 0;
+	int const bind_idx_startMatchText = SQLITE_BIND_START + 1;
+	int const bind_idx_endMatchText   = SQLITE_BIND_START + 2;
+	int const bind_idx_ellipsesText   = SQLITE_BIND_START + 3;
+	int const bind_idx_numTokens      = SQLITE_BIND_START + 4;
+	int const bind_idx_query          = SQLITE_BIND_START + 5;
+	int const bind_idx_limit          = SQLITE_BIND_START + 6;
+	int const bind_idx_offset         = SQLITE_BIND_START + 7;
+	
+	YapDatabaseString _startMatchText; MakeYapDatabaseString(&_startMatchText, options.startMatchText);
+	sqlite3_bind_text(statement, bind_idx_startMatchText, _startMatchText.str, _startMatchText.length, SQLITE_STATIC);
+	
+	YapDatabaseString _endMatchText; MakeYapDatabaseString(&_endMatchText, options.endMatchText);
+	sqlite3_bind_text(statement, bind_idx_endMatchText, _endMatchText.str, _endMatchText.length, SQLITE_STATIC);
+	
+	YapDatabaseString _ellipsesText; MakeYapDatabaseString(&_ellipsesText, options.ellipsesText);
+	sqlite3_bind_text(statement, bind_idx_ellipsesText, _ellipsesText.str, _ellipsesText.length, SQLITE_STATIC);
+	
+	int columnIndex = -1;
+	if (options.columnName)
+	{
+		NSUInteger index = [parentConnection->parent->columnNames indexOfObject:options.columnName];
+		if (index == NSNotFound)
+		{
+			YDBLogWarn(@"Invalid snippet option: columnName(%@) not found", options.columnName);
+		}
+		else
+		{
+			columnIndex = (int)index;
+		}
+	}
+	sqlite3_bind_int(statement, bind_idx_columnIndex, columnIndex);
+	sqlite3_bind_int(statement, bind_idx_numTokens, options.numberOfTokens);
+	
+	YapDatabaseString _query; MakeYapDatabaseString(&_query, query);
+	sqlite3_bind_text(statement, bind_idx_query, _query.str, _query.length, SQLITE_STATIC);
+	
+	// A negative limit means no limit.
+	sqlite3_bind_int64(statement, bind_idx_limit, (limit > 0) ? (sqlite3_int64)limit : -1);
+	sqlite3_bind_int64(statement, bind_idx_offset, (sqlite3_int64)offset);
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+		
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_snippet);
+		int textSize = sqlite3_column_bytes(statement, column_idx_snippet);
+		
+		NSString *snippet = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		block(snippet, rowid, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	FreeYapDatabaseString(&_startMatchText);
+	FreeYapDatabaseString(&_endMatchText);
+	FreeYapDatabaseString(&_ellipsesText);
+	FreeYapDatabaseString(&_query);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [databaseTransaction mutationDuringEnumerationException];
+	}
+}
+
+- (void)enumerateBm25OrderedKeysMatching:(NSString *)query
+                             withWeights:(nullable NSArray<NSNumber *> *)weights
+                          snippetOptions:(nullable YapDatabaseFullTextSearchSnippetOptions *)options
+                                  offset:(NSUInteger)offset
+                                   limit:(NSUInteger)limit
+                              usingBlock:
+            (void (^)(NSString *snippet, int64_t rowid, NSString *collection, NSString *key, BOOL *stop))block
+{
+	if (block == nil) return;
+	
+	[self enumerateBm25OrderedRowidsMatching:query
+	                             withWeights:weights
+	                          snippetOptions:options
+	                                  offset:offset
+	                                   limit:limit
+	                              usingBlock:^(NSString *snippet, int64_t rowid, BOOL *stop)
+	{
+		YapCollectionKey *ck = [databaseTransaction collectionKeyForRowid:rowid];
+		
+		block(snippet, rowid, ck.collection, ck.key, stop);
+	}];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Queries with Snippets
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
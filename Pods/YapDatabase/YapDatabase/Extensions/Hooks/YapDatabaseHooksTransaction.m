@@ -60,6 +60,14 @@
 	databaseTransaction = nil;
 }
 
+/**
+ * Hooks don't hold any state. (Changes made by the hook blocks go through the database transaction.)
+**/
+- (BOOL)supportsSavepoints
+{
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Generic Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
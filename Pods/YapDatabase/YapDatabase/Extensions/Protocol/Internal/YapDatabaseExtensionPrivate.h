@@ -104,6 +104,10 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 - (void)didCommitTransaction;
 - (void)didRollbackTransaction;
 
+- (BOOL)supportsSavepoints;
+- (id)savepointState;
+- (void)rollbackToSavepointState:(id)state;
+
 #pragma mark Hooks
 
 /**
@@ -164,6 +168,26 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 - (void)willRemoveAllObjectsInAllCollections;
 
 
+#pragma mark Batched Population
+
+/**
+ * See YapDatabaseExtensionTransaction.m for discussion of these methods
+**/
+
+- (BOOL)supportsBatchedPopulation;
+- (BOOL)populatesInBatches;
+
+- (void)beginBatchedPopulation;
+- (BOOL)populateNextBatchOfSize:(NSUInteger)batchSize;
+
+- (BOOL)shouldPopulateCollection:(NSString *)collection;
+
+- (void)populateRowid:(int64_t)rowid
+        collectionKey:(YapCollectionKey *)collectionKey
+               object:(id)object
+             metadata:(id)metadata;
+
+
 #pragma mark Configuration Values
 
 /**
@@ -178,6 +202,10 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags_Extension)
 - (int)intValueForExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
 - (void)setIntValue:(int)value forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
 
+- (BOOL)getInt64Value:(int64_t *)valuePtr forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
+- (int64_t)int64ValueForExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
+- (void)setInt64Value:(int64_t)value forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
+
 - (BOOL)getDoubleValue:(double *)valuePtr forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
 - (double)doubleValueForExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
 - (void)setDoubleValue:(double)value forExtensionKey:(NSString *)key persistent:(BOOL)inDatabaseOrMemoryTable;
@@ -22,6 +22,32 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (atomic, weak, readonly, nullable) YapDatabase *registeredDatabase;
 
+/**
+ * Normally, when an extension needs to be populated (the first time it's registered, or when its versionTag changes),
+ * it enumerates the existing rows in the database from within the registration transaction.
+ * Which blocks all other write transactions until it's done.
+ *
+ * If populationBatchSize is non-zero, the registration transaction only prepares the (empty) extension,
+ * and records the range of rowids which need to be processed.
+ * The database then processes that range in the background, populationBatchSize rows at a time,
+ * each batch in its own short readWrite transaction, so that other write transactions can run in between.
+ * Rows which are modified in the meantime are handled by the extension as usual, whether or not they've been reached.
+ *
+ * Progress is saved with each batch.
+ * So if the app is terminated, population picks up where it left off the next time the extension is registered.
+ *
+ * Until population is complete, the extension reflects only the rows it has processed so far.
+ * See -[YapDatabaseExtensionTransaction isPopulated], and YapDatabaseExtensionPopulatedNotification.
+ *
+ * Currently supported by YapDatabaseAutoView, YapDatabaseSecondaryIndex and YapDatabaseFullTextSearch.
+ * Other extensions ignore this property.
+ *
+ * This property must be set before the extension is registered.
+ *
+ * The default value is zero.
+**/
+@property (atomic, assign, readwrite) NSUInteger populationBatchSize;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -61,6 +61,7 @@
 **/
 @synthesize registeredName;
 @synthesize registeredDatabase;
+@synthesize populationBatchSize;
 
 /**
  * Subclasses may OPTIONALLY implement this method.
@@ -5,10 +5,19 @@ NS_ASSUME_NONNULL_BEGIN
 @interface YapDatabaseExtensionTransaction : NSObject
 
 /**
- * This class is abstract and has no public API.
+ * This class is abstract.
  * See concrete implementations such as YapDatabaseViewTransaction, YapDatabaseSecondaryIndexTransaction, etc.
 **/
 
+/**
+ * Returns NO while the extension is populating itself in batches (see -[YapDatabaseExtension populationBatchSize]).
+ * Until then, the extension reflects only some of the rows that existed when it was registered,
+ * along with any rows that have been modified since.
+ *
+ * Returns YES otherwise.
+**/
+- (BOOL)isPopulated;
+
 @end
 
 NS_ASSUME_NONNULL_END
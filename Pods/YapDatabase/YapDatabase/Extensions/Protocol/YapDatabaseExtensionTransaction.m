@@ -193,6 +193,33 @@
 	// databaseTransaction = nil;
 }
 
+/**
+ * Subclasses may OPTIONALLY implement these methods.
+ * They're only called within a readwrite transaction that's executing a group commit.
+ *
+ * Each block in a group commit runs within its own sqlite savepoint.
+ * If a block rolls back, the database is rolled back to the savepoint, and every extension is handed back
+ * the state it returned from savepointState (just before the block ran), via rollbackToSavepointState:.
+ *
+ * So an extension supports savepoints if any change it has made to its own tables is undone by sqlite,
+ * and any change it's holding in memory can be undone by restoring the returned state.
+ * Otherwise, group commit executes each block in its own transaction.
+**/
+- (BOOL)supportsSavepoints
+{
+	return NO;
+}
+
+- (id)savepointState
+{
+	return nil;
+}
+
+- (void)rollbackToSavepointState:(id __unused)state
+{
+	// Override me if needed
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Generic Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -493,6 +520,151 @@
 	// Override me if needed
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Batched Population
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * An extension registered with a populationBatchSize doesn't populate itself within the registration transaction.
+ * Instead, createIfNeeded invokes beginBatchedPopulation (rather than its usual populate method),
+ * which records the range of rowids to be processed: everything up to the largest rowid at that moment.
+ * Rows inserted after that are handled by the extension's hooks, like any other insert.
+ *
+ * The database then invokes populateNextBatchOfSize: repeatedly, each time within a new readWrite transaction,
+ * until it returns YES. Each batch invokes populateRowid:collectionKey:object:metadata: for the next rows in the range,
+ * and saves its progress alongside the extension's other configuration values.
+ *
+ * Rows may be modified or removed between batches, and so may already have been handled by the hooks
+ * by the time their batch comes around. Subclasses MUST handle populateRowid:... accordingly,
+ * in the same way they'd handle an update to a row which they may or may not already include.
+**/
+
+static NSString *const ext_key_populationRowid    = @"populationRowid";
+static NSString *const ext_key_populationMaxRowid = @"populationMaxRowid";
+
+/**
+ * Subclasses which support batched population override this method to return YES,
+ * and implement populateRowid:collectionKey:object:metadata:.
+**/
+- (BOOL)supportsBatchedPopulation
+{
+	return NO;
+}
+
+/**
+ * Subclasses invoke this method from within createIfNeeded,
+ * to decide between populating themselves, or invoking beginBatchedPopulation.
+**/
+- (BOOL)populatesInBatches
+{
+	return [self supportsBatchedPopulation] && ([[[self extensionConnection] extension] populationBatchSize] > 0);
+}
+
+- (void)beginBatchedPopulation
+{
+	YDBLogAutoTrace();
+	
+	BOOL persistent = [[[self extensionConnection] extension] isPersistent];
+	int64_t maxRowid = [[self databaseTransaction] _maxRowid];
+	
+	if (maxRowid > 0)
+	{
+		[self setInt64Value:0        forExtensionKey:ext_key_populationRowid    persistent:persistent];
+		[self setInt64Value:maxRowid forExtensionKey:ext_key_populationMaxRowid persistent:persistent];
+	}
+	else
+	{
+		// Nothing to populate
+		
+		[self removeValueForExtensionKey:ext_key_populationRowid    persistent:persistent];
+		[self removeValueForExtensionKey:ext_key_populationMaxRowid persistent:persistent];
+	}
+}
+
+/**
+ * Processes up to batchSize of the remaining rows.
+ * Returns YES if the extension is fully populated.
+**/
+- (BOOL)populateNextBatchOfSize:(NSUInteger)batchSize
+{
+	YDBLogAutoTrace();
+	
+	YapDatabaseReadTransaction *databaseTransaction = [self databaseTransaction];
+	if (!databaseTransaction->isReadWriteTransaction)
+	{
+		YDBLogWarn(@"%@ - Method only allowed in readWrite transaction", THIS_METHOD);
+		return NO;
+	}
+	
+	BOOL persistent = [[[self extensionConnection] extension] isPersistent];
+	
+	int64_t maxRowid = 0;
+	if (![self getInt64Value:&maxRowid forExtensionKey:ext_key_populationMaxRowid persistent:persistent])
+	{
+		// Not populating in batches (or already done)
+		return YES;
+	}
+	
+	int64_t rowid = [self int64ValueForExtensionKey:ext_key_populationRowid persistent:persistent];
+	
+	int64_t lastRowid =
+	  [databaseTransaction _enumerateRowsAfterRowid:rowid
+	                                      upToRowid:maxRowid
+	                                          limit:MAX(batchSize, (NSUInteger)1)
+	      usingBlock:^(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL __unused *stop)
+	  {
+		  YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		  
+		  [self populateRowid:rowid collectionKey:collectionKey object:object metadata:metadata];
+	  }
+	      withFilter:^BOOL(int64_t __unused rowid, NSString *collection, NSString __unused *key)
+	  {
+		  return [self shouldPopulateCollection:collection];
+	  }];
+	
+	if (lastRowid == rowid || lastRowid >= maxRowid)
+	{
+		[self removeValueForExtensionKey:ext_key_populationRowid    persistent:persistent];
+		[self removeValueForExtensionKey:ext_key_populationMaxRowid persistent:persistent];
+		
+		return YES;
+	}
+	else
+	{
+		[self setInt64Value:lastRowid forExtensionKey:ext_key_populationRowid persistent:persistent];
+		
+		return NO;
+	}
+}
+
+- (BOOL)isPopulated
+{
+	BOOL persistent = [[[self extensionConnection] extension] isPersistent];
+	
+	return ![self getInt64Value:NULL forExtensionKey:ext_key_populationMaxRowid persistent:persistent];
+}
+
+/**
+ * Subclasses MAY override this method, in order to skip the deserialization of rows they're not interested in.
+**/
+- (BOOL)shouldPopulateCollection:(NSString __unused *)collection
+{
+	return YES;
+}
+
+/**
+ * Subclasses which support batched population MUST implement this method.
+ *
+ * See the discussion above.
+**/
+- (void)populateRowid:(int64_t __unused)rowid
+        collectionKey:(YapCollectionKey __unused *)collectionKey
+               object:(id __unused)object
+             metadata:(id __unused)metadata
+{
+	NSAssert(NO, @"Missing required override method(%@) in class(%@)", NSStringFromSelector(_cmd), [self class]);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Configuration Values
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -647,6 +819,66 @@
 	}
 }
 
+- (BOOL)getInt64Value:(int64_t *)valuePtr forExtensionKey:(NSString *)key persistent:(BOOL)persistent
+{
+	NSString *registeredName = [[[self extensionConnection] extension] registeredName];
+	
+	if (persistent)
+	{
+		return [[self databaseTransaction] getInt64Value:valuePtr forKey:key extension:registeredName];
+	}
+	else
+	{
+		YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:registeredName key:key];
+		
+		id object = [[[self databaseTransaction] yapMemoryTableTransaction] objectForKey:ck];
+		if (object)
+		{
+			if (valuePtr) *valuePtr = [object longLongValue];
+			return YES;
+		}
+		else
+		{
+			if (valuePtr) *valuePtr = 0;
+			return NO;
+		}
+	}
+}
+
+- (int64_t)int64ValueForExtensionKey:(NSString *)key persistent:(BOOL)persistent
+{
+	int64_t value = 0;
+	[self getInt64Value:&value forExtensionKey:key persistent:persistent];
+	return value;
+}
+
+- (void)setInt64Value:(int64_t)value forExtensionKey:(NSString *)key persistent:(BOOL)persistent
+{
+	YapDatabaseReadTransaction *databaseTransaction = [self databaseTransaction];
+	if (databaseTransaction->isReadWriteTransaction)
+	{
+		NSString *registeredName = [[[self extensionConnection] extension] registeredName];
+		
+		if (persistent)
+		{
+			__unsafe_unretained YapDatabaseReadWriteTransaction *rwDatabaseTransaction =
+			  (YapDatabaseReadWriteTransaction *)databaseTransaction;
+			
+			[rwDatabaseTransaction setInt64Value:value forKey:key extension:registeredName];
+		}
+		else
+		{
+			YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:registeredName key:key];
+			
+			[[databaseTransaction yapMemoryTableTransaction] setObject:@(value) forKey:ck];
+		}
+	}
+	else
+	{
+		NSAssert(NO, @"Cannot modify database outside of readWrite transaction!");
+	}
+}
+
 - (BOOL)getDoubleValue:(double *)valuePtr forExtensionKey:(NSString *)key persistent:(BOOL)persistent
 {
 	NSString *registeredName = [[[self extensionConnection] extension] registeredName];
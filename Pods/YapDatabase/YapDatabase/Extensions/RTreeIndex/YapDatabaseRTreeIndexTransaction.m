@@ -554,13 +554,9 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 	[query appendString:@");"];
 
-	sqlite3_stmt *statement;
-
-	int status = sqlite3_prepare_v2(databaseTransaction->connection->db, [query UTF8String], -1, &statement, NULL);
-	if (status != SQLITE_OK)
+	sqlite3_stmt *statement = [databaseTransaction->connection cachedStatementForQuery:query];
+	if (statement == NULL)
 	{
-		YDBLogError(@"Error creating 'removeRowids' statement: %d %s",
-		            status, sqlite3_errmsg(databaseTransaction->connection->db));
 		return;
 	}
 
@@ -571,14 +567,15 @@ static NSString *const ext_key_version_deprecated = @"version";
 		sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
 	}
 
-	status = sqlite3_step(statement);
+	int status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
 	{
 		YDBLogError(@"Error executing 'removeRowids' statement: %d %s",
 		            status, sqlite3_errmsg(databaseTransaction->connection->db));
 	}
 
-	sqlite3_finalize(statement);
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
 
 	[parentConnection->mutationStack markAsMutated];
 }
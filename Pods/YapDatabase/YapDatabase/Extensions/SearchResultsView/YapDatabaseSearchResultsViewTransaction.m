@@ -503,6 +503,14 @@ static NSString *const ext_key_query           = @"query";
 	[super flushPendingChangesToExtensionTables];
 }
 
+/**
+ * The connection's query isn't part of the view's savepoint state.
+**/
+- (BOOL)supportsSavepoints
+{
+	return NO;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Logic
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
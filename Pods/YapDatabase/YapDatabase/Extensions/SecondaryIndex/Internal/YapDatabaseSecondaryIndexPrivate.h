@@ -9,6 +9,7 @@
 #import "YapDatabaseSecondaryIndexTransaction.h"
 
 #import "YapCache.h"
+#import "YapCollectionKey.h"
 #import "YapMutationStack.h"
 #import "YapDatabaseStatement.h"
 
@@ -31,6 +32,8 @@
 	YapDatabaseSecondaryIndexBlock block;
 	YapDatabaseBlockType           blockType;
 	YapDatabaseBlockInvoke         blockInvokeOptions;
+	
+	BOOL isIntegersBlock; // block is a YapDatabaseSecondaryIndexWithObjectIntegersBlock
 }
 
 @end
@@ -48,9 +51,13 @@
  *   
  *   Dictionary of column names and affinity.
  * 
+ * @param includesKeys
+ *
+ *   Whether the table also has the collection & key columns (YapDatabaseSecondaryIndexOptions.includesKeys).
+ * 
  * @see YapDatabase columnNamesAndAffinityForTable:using:
 **/
-- (BOOL)matchesExistingColumnNamesAndAffinity:(NSDictionary *)columns;
+- (BOOL)matchesExistingColumnNamesAndAffinity:(NSDictionary *)columns includesKeys:(BOOL)includesKeys;
 
 @end
 
@@ -79,6 +86,68 @@
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * A change to the index table which has yet to be written.
+**/
+typedef struct {
+	int64_t rowid;
+	BOOL isNew;     // Row isn't in the table yet (so it can be inserted rather than replaced)
+	BOOL isRemoval; // Row is to be removed from the table (rather than written)
+	BOOL isLive;    // NO once the change has been cancelled out (an insert followed by a removal)
+} YapDatabaseSecondaryIndexPendingRow;
+
+/**
+ * The changes to the index table which have yet to be written.
+ * 
+ * Changes are queued up within the read-write transaction, keyed by rowid,
+ * so that several changes to the same row only result in a single write.
+ * 
+ * Each change takes a slot in flat buffers, which are allocated once (at capacity) and reused for every transaction.
+ * So queuing up a row for an objectIntegersBlock doesn't allocate anything.
+ * (A dictionary-based block is different: its values have to be copied out of the shared blockDict.)
+**/
+@interface YapDatabaseSecondaryIndexPendingRows : NSObject <NSCopying> {
+@public
+	
+	NSUInteger capacity;       // The queue must be flushed once count reaches this
+	NSUInteger count;          // Slots used, including any whose change was cancelled out
+	NSUInteger integersPerRow; // Number of columns, for an objectIntegersBlock (otherwise zero)
+	
+	YapDatabaseSecondaryIndexPendingRow *rows; // Per slot
+	int64_t *integers;                         // Per slot, integersPerRow values
+	
+	NSMutableArray *dicts;          // Per slot, NSDictionary (or NSNull), unless integersPerRow
+	NSMutableArray *collectionKeys; // Per slot, YapCollectionKey (or NSNull), only when options.includesKeys
+	
+	NSMutableDictionary<NSNumber *, NSNumber *> *slots; // rowid -> slot, for each live change
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+                  integersPerRow:(NSUInteger)integersPerRow
+                    includesKeys:(BOOL)includesKeys;
+
+/**
+ * Queues up a write of the row, replacing any pending change to it.
+ * Returns the slot, whose integers (if any) the caller fills in.
+**/
+- (NSUInteger)addRowid:(int64_t)rowid
+                 isNew:(BOOL)isNew
+                  dict:(NSDictionary *)dict
+         collectionKey:(YapCollectionKey *)collectionKey;
+
+/**
+ * Queues up a removal of the row, replacing any pending change to it.
+**/
+- (void)removeRowid:(int64_t)rowid;
+
+- (void)removeAllRows;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @interface YapDatabaseSecondaryIndexConnection () {
 @public
 	
@@ -86,8 +155,11 @@
 	__unsafe_unretained YapDatabaseConnection *databaseConnection;
 	
 	NSMutableDictionary *blockDict;
+	int64_t *blockIntegers;
+	
+	YapDatabaseSecondaryIndexPendingRows *pendingRows;
 	
-	YapCache<NSString *, YapDatabaseStatement *> *queryCache;
+	BOOL queryCacheEnabled;
 	NSUInteger queryCacheLimit;
 	
 	YapMutationStack_Bool *mutationStack;
@@ -107,6 +107,38 @@
 		return nil;
 	}
 	
+	if (inHandler->isIntegersBlock)
+	{
+		for (YapDatabaseSecondaryIndexColumn *column in inSetup)
+		{
+			if (column.type != YapDatabaseSecondaryIndexTypeInteger)
+			{
+				NSAssert(NO, @"Invalid setup: an integers block requires every column to be an INTEGER");
+				
+				YDBLogError(@"%@: Invalid setup: an integers block requires every column to be an INTEGER,"
+				            @" but column(%@) is %@", THIS_METHOD, column.name,
+				            NSStringFromYapDatabaseSecondaryIndexType(column.type));
+				return nil;
+			}
+		}
+	}
+	
+	if (inOptions.includesKeys)
+	{
+		for (NSString *columnName in [inSetup columnNames])
+		{
+			if ([columnName caseInsensitiveCompare:@"collection"] == NSOrderedSame ||
+			    [columnName caseInsensitiveCompare:@"key"] == NSOrderedSame)
+			{
+				NSAssert(NO, @"Invalid setup: columnName is reserved when options.includesKeys is enabled");
+				
+				YDBLogError(@"%@: Invalid setup: columnName(%@) is reserved when options.includesKeys is enabled",
+				            THIS_METHOD, columnName);
+				return nil;
+			}
+		}
+	}
+	
 	// Looks sane, proceed with normal init
 	
 	if ((self = [super init]))
@@ -27,6 +27,11 @@ NS_ASSUME_NONNULL_BEGIN
  *
  * To disable the cache entirely, set queryCacheEnabled to NO.
  * To use an inifinite cache size, set the queryCacheLimit to ZERO.
+ *
+ * Compiled queries are stored in the database connection's shared statement cache,
+ * so they count against (and are bounded by) YapDatabaseConnection.statementCacheLimit.
+ * When the queryCache is disabled, each query is compiled from scratch and finalized after use.
+ * The queryCacheLimit is retained for compatibility, and no longer has any effect.
 **/
 @property (atomic, assign, readwrite) BOOL queryCacheEnabled;
 @property (atomic, assign, readwrite) NSUInteger queryCacheLimit;
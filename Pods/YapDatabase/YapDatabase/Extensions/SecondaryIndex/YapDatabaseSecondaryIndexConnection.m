@@ -1,6 +1,5 @@
 #import "YapDatabaseSecondaryIndexConnection.h"
 #import "YapDatabaseSecondaryIndexPrivate.h"
-#import "YapDatabaseStatement.h"
 
 #import "YapDatabasePrivate.h"
 #import "YapDatabaseExtensionPrivate.h"
@@ -24,6 +23,170 @@
 #pragma unused(ydbLogLevel)
 
 
+/**
+ * Changes to the index table are queued up during a read-write transaction (see YapDatabaseSecondaryIndexTransaction),
+ * and written in rowid order before the index is queried, and when the transaction is committed.
+ * The queue is also written out whenever it reaches this size, to bound the memory used when populating.
+**/
+static NSUInteger const YDB_MaxPendingRows = 1000;
+
+
+@implementation YapDatabaseSecondaryIndexPendingRows
+
+- (instancetype)initWithCapacity:(NSUInteger)inCapacity
+                  integersPerRow:(NSUInteger)inIntegersPerRow
+                    includesKeys:(BOOL)includesKeys
+{
+	if ((self = [super init]))
+	{
+		capacity = inCapacity;
+		integersPerRow = inIntegersPerRow;
+		
+		rows = malloc(capacity * sizeof(YapDatabaseSecondaryIndexPendingRow));
+		
+		if (integersPerRow > 0)
+			integers = malloc(capacity * integersPerRow * sizeof(int64_t));
+		else
+			dicts = [[NSMutableArray alloc] initWithCapacity:capacity];
+		
+		if (includesKeys)
+			collectionKeys = [[NSMutableArray alloc] initWithCapacity:capacity];
+		
+		slots = [[NSMutableDictionary alloc] initWithCapacity:capacity];
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	if (rows) {
+		free(rows);
+	}
+	if (integers) {
+		free(integers);
+	}
+}
+
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	YapDatabaseSecondaryIndexPendingRows *copy =
+	  [[YapDatabaseSecondaryIndexPendingRows alloc] initWithCapacity:capacity
+	                                                  integersPerRow:integersPerRow
+	                                                    includesKeys:(collectionKeys != nil)];
+	
+	copy->count = count;
+	memcpy(copy->rows, rows, count * sizeof(YapDatabaseSecondaryIndexPendingRow));
+	
+	if (integers)
+		memcpy(copy->integers, integers, count * integersPerRow * sizeof(int64_t));
+	
+	[copy->dicts setArray:dicts];
+	[copy->collectionKeys setArray:collectionKeys];
+	[copy->slots setDictionary:slots];
+	
+	return copy;
+}
+
+/**
+ * Returns the slot to use for a change to the given row,
+ * along with whether the row is new (taking into account any pending change it replaces).
+**/
+- (NSUInteger)slotForRowid:(int64_t)rowid isNew:(BOOL *)isNewPtr
+{
+	NSNumber *slotNumber = [slots objectForKey:@(rowid)];
+	if (slotNumber)
+	{
+		// The row is only new if the pending change is a (not yet written) insert.
+		// A pending removal means the row may well be in the table.
+		
+		NSUInteger slot = [slotNumber unsignedIntegerValue];
+		
+		*isNewPtr = rows[slot].isNew && !rows[slot].isRemoval;
+		return slot;
+	}
+	
+	NSAssert(count < capacity, @"Pending rows must be flushed once they reach capacity");
+	
+	NSUInteger slot = count++;
+	[slots setObject:@(slot) forKey:@(rowid)];
+	
+	// Keep the per-slot arrays in step, so that a slot can be replaced in place.
+	[dicts addObject:[NSNull null]];
+	[collectionKeys addObject:[NSNull null]];
+	
+	return slot;
+}
+
+- (NSUInteger)addRowid:(int64_t)rowid
+                 isNew:(BOOL)isNew
+                  dict:(NSDictionary *)dict
+         collectionKey:(YapCollectionKey *)collectionKey
+{
+	BOOL pendingIsNew = isNew;
+	NSUInteger slot = [self slotForRowid:rowid isNew:&pendingIsNew];
+	
+	rows[slot] = (YapDatabaseSecondaryIndexPendingRow){
+		.rowid = rowid,
+		.isNew = pendingIsNew,
+		.isRemoval = NO,
+		.isLive = YES,
+	};
+	
+	if (dicts)
+		[dicts replaceObjectAtIndex:slot withObject:(dict ?: [NSNull null])];
+	
+	if (collectionKeys)
+		[collectionKeys replaceObjectAtIndex:slot withObject:(collectionKey ?: [NSNull null])];
+	
+	return slot;
+}
+
+- (void)removeRowid:(int64_t)rowid
+{
+	NSNumber *rowidNumber = @(rowid);
+	NSNumber *slotNumber = [slots objectForKey:rowidNumber];
+	
+	if (slotNumber)
+	{
+		NSUInteger slot = [slotNumber unsignedIntegerValue];
+		
+		if (rows[slot].isNew && !rows[slot].isRemoval)
+		{
+			// The row never made it into the table, so there's nothing to remove.
+			// Its slot stays used until the queue is flushed.
+			
+			rows[slot].isLive = NO;
+			[slots removeObjectForKey:rowidNumber];
+			return;
+		}
+	}
+	
+	BOOL unusedIsNew = NO;
+	NSUInteger slot = [self slotForRowid:rowid isNew:&unusedIsNew];
+	
+	rows[slot] = (YapDatabaseSecondaryIndexPendingRow){
+		.rowid = rowid,
+		.isNew = NO,
+		.isRemoval = YES,
+		.isLive = YES,
+	};
+}
+
+- (void)removeAllRows
+{
+	count = 0;
+	
+	[dicts removeAllObjects];
+	[collectionKeys removeAllObjects];
+	[slots removeAllObjects];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @implementation YapDatabaseSecondaryIndexConnection
 {
 	sqlite3_stmt *insertStatement;
@@ -42,18 +205,19 @@
 		parent = inParent;
 		databaseConnection = inDatabaseConnection;
 		
+		queryCacheEnabled = YES;
 		queryCacheLimit = 10;
-		queryCache = [[YapCache alloc] initWithCountLimit:queryCacheLimit];
-		queryCache.allowedKeyClasses = [NSSet setWithObject:[NSString class]];
-		queryCache.allowedObjectClasses = [NSSet setWithObject:[YapDatabaseStatement class]];
 	}
 	return self;
 }
 
 - (void)dealloc
 {
-	[queryCache removeAllObjects];
 	[self _flushStatements];
+	
+	if (blockIntegers) {
+		free(blockIntegers);
+	}
 }
 
 - (void)_flushStatements
@@ -69,11 +233,6 @@
 **/
 - (void)_flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags
 {
-	if (flags & YapDatabaseConnectionFlushMemoryFlags_Caches)
-	{
-		[queryCache removeAllObjects];
-	}
-	
 	if (flags & YapDatabaseConnectionFlushMemoryFlags_Statements)
 	{
 		[self _flushStatements];
@@ -102,7 +261,7 @@
 	
 	dispatch_block_t block = ^{
 		
-		result = (queryCache == nil) ? NO : YES;
+		result = queryCacheEnabled;
 	};
 	
 	if (dispatch_get_specific(databaseConnection->IsOnConnectionQueueKey))
@@ -113,23 +272,11 @@
 	return result;
 }
 
-- (void)setQueryCacheEnabled:(BOOL)queryCacheEnabled
+- (void)setQueryCacheEnabled:(BOOL)flag
 {
 	dispatch_block_t block = ^{
 		
-		if (queryCacheEnabled)
-		{
-			if (queryCache == nil)
-			{
-				queryCache = [[YapCache alloc] initWithCountLimit:queryCacheLimit];
-				queryCache.allowedKeyClasses = [NSSet setWithObject:[NSString class]];
-				queryCache.allowedObjectClasses = [NSSet setWithObject:[YapDatabaseStatement class]];
-			}
-		}
-		else
-		{
-			queryCache = nil;
-		}
+		queryCacheEnabled = flag;
 	};
 	
 	if (dispatch_get_specific(databaseConnection->IsOnConnectionQueueKey))
@@ -160,7 +307,6 @@
 	dispatch_block_t block = ^{
 		
 		queryCacheLimit = newQueryCacheLimit;
-		queryCache.countLimit = queryCacheLimit;
 	};
 	
 	if (dispatch_get_specific(databaseConnection->IsOnConnectionQueueKey))
@@ -210,17 +356,31 @@
 	if (blockDict == nil)
 		blockDict = [NSMutableDictionary dictionaryWithSharedKeySet:parent->columnNamesSharedKeySet];
 	
+	if (blockIntegers == NULL && parent->handler->isIntegersBlock)
+		blockIntegers = calloc([parent->setup count], sizeof(int64_t));
+	
+	if (pendingRows == nil)
+	{
+		NSUInteger integersPerRow = parent->handler->isIntegersBlock ? [parent->setup count] : 0;
+		
+		pendingRows = [[YapDatabaseSecondaryIndexPendingRows alloc] initWithCapacity:YDB_MaxPendingRows
+		                                                              integersPerRow:integersPerRow
+		                                                                includesKeys:parent->options.includesKeys];
+	}
+	
 	if (mutationStack == nil)
 		mutationStack = [[YapMutationStack_Bool alloc] init];
 }
 
 - (void)postCommitCleanup
 {
+	[pendingRows removeAllRows];
 	[mutationStack clear];
 }
 
 - (void)postRollbackCleanup
 {
+	[pendingRows removeAllRows];
 	[mutationStack clear];
 }
 
@@ -275,6 +435,11 @@
 		NSMutableString *string = [NSMutableString stringWithCapacity:100];
 		[string appendFormat:@"INSERT INTO \"%@\" (\"rowid\"", [parent tableName]];
 		
+		if (parent->options.includesKeys)
+		{
+			[string appendString:@", \"collection\", \"key\""];
+		}
+		
 		for (YapDatabaseSecondaryIndexColumn *column in parent->setup)
 		{
 			[string appendFormat:@", \"%@\"", column.name];
@@ -283,6 +448,11 @@
 		[string appendString:@") VALUES (?"];
 		
 		NSUInteger count = [parent->setup count];
+		if (parent->options.includesKeys)
+		{
+			count += 2;
+		}
+		
 		NSUInteger i;
 		for (i = 0; i < count; i++)
 		{
@@ -305,6 +475,11 @@
 		NSMutableString *string = [NSMutableString stringWithCapacity:100];
 		[string appendFormat:@"INSERT OR REPLACE INTO \"%@\" (\"rowid\"", [parent tableName]];
 		
+		if (parent->options.includesKeys)
+		{
+			[string appendString:@", \"collection\", \"key\""];
+		}
+		
 		for (YapDatabaseSecondaryIndexColumn *column in parent->setup)
 		{
 			[string appendFormat:@", \"%@\"", column.name];
@@ -313,6 +488,11 @@
 		[string appendString:@") VALUES (?"];
 		
 		NSUInteger count = [parent->setup count];
+		if (parent->options.includesKeys)
+		{
+			count += 2;
+		}
+		
 		NSUInteger i;
 		for (i = 0; i < count; i++)
 		{
@@ -36,6 +36,20 @@ typedef void (^YapDatabaseSecondaryIndexWithMetadataBlock)
 typedef void (^YapDatabaseSecondaryIndexWithRowBlock)
                             (YapDatabaseReadTransaction *transaction, NSMutableDictionary *dict, NSString *collection, NSString *key, id object, __nullable id metadata);
 
+/**
+ * A typed alternative to YapDatabaseSecondaryIndexWithObjectBlock, for setups in which every column is an INTEGER.
+ *
+ * Rather than filling a dictionary with NSNumbers, the block writes the column values directly into the given array,
+ * in the same order as the columns were added to the setup. The values are zeroed before each invocation.
+ * Return YES to index the row with the given values, or NO to exclude it from the index.
+ *
+ * This avoids the dictionary, the boxing of every value, and the type inspection of every NSNumber,
+ * for each row that's written. The values are queued up in a flat buffer until they're written,
+ * so indexing a row doesn't allocate any objects (unless options.includesKeys, which needs the collection & key).
+**/
+typedef BOOL (^YapDatabaseSecondaryIndexWithObjectIntegersBlock)
+                            (YapDatabaseReadTransaction *transaction, int64_t *values, NSString *collection, NSString *key, id object);
+
 + (instancetype)withKeyBlock:(YapDatabaseSecondaryIndexWithKeyBlock)block;
 + (instancetype)withObjectBlock:(YapDatabaseSecondaryIndexWithObjectBlock)block;
 + (instancetype)withMetadataBlock:(YapDatabaseSecondaryIndexWithMetadataBlock)block;
@@ -46,6 +60,9 @@ typedef void (^YapDatabaseSecondaryIndexWithRowBlock)
 + (instancetype)withOptions:(YapDatabaseBlockInvoke)ops metadataBlock:(YapDatabaseSecondaryIndexWithMetadataBlock)block;
 + (instancetype)withOptions:(YapDatabaseBlockInvoke)ops rowBlock:(YapDatabaseSecondaryIndexWithRowBlock)block;
 
++ (instancetype)withObjectIntegersBlock:(YapDatabaseSecondaryIndexWithObjectIntegersBlock)block;
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)ops objectIntegersBlock:(YapDatabaseSecondaryIndexWithObjectIntegersBlock)block;
+
 @property (nonatomic, strong, readonly) YapDatabaseSecondaryIndexBlock block;
 @property (nonatomic, assign, readonly) YapDatabaseBlockType           blockType;
 @property (nonatomic, assign, readonly) YapDatabaseBlockInvoke         blockInvokeOptions;
@@ -32,6 +32,12 @@
 	return [self withOptions:ops rowBlock:block];
 }
 
++ (instancetype)withObjectIntegersBlock:(YapDatabaseSecondaryIndexWithObjectIntegersBlock)block
+{
+	YapDatabaseBlockInvoke ops = YapDatabaseBlockInvokeDefaultForBlockTypeWithObject;
+	return [self withOptions:ops objectIntegersBlock:block];
+}
+
 + (instancetype)withOptions:(YapDatabaseBlockInvoke)ops keyBlock:(YapDatabaseSecondaryIndexWithKeyBlock)block
 {
 	if (block == NULL) return nil;
@@ -80,4 +86,17 @@
 	return handler;
 }
 
++ (instancetype)withOptions:(YapDatabaseBlockInvoke)ops objectIntegersBlock:(YapDatabaseSecondaryIndexWithObjectIntegersBlock)block
+{
+	if (block == NULL) return nil;
+	
+	YapDatabaseSecondaryIndexHandler *handler = [[YapDatabaseSecondaryIndexHandler alloc] init];
+	handler->block = block;
+	handler->blockType = YapDatabaseBlockTypeWithObject;
+	handler->blockInvokeOptions = ops;
+	handler->isIntegersBlock = YES;
+	
+	return handler;
+}
+
 @end
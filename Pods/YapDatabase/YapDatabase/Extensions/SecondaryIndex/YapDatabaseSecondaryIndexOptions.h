@@ -40,6 +40,24 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 @property (nonatomic, strong, readwrite, nullable) YapWhitelistBlacklist *allowedCollections;
 
+/**
+ * If YES, the collection & key of each row are stored in the index table alongside its values,
+ * and every column's sqlite index is extended to (column, collection, key).
+ *
+ * This makes the indexes "covering" for key queries.
+ * That is, enumerateKeysMatchingQuery: (and the batched object enumeration) can read the matching keys
+ * straight out of the index, without a lookup in the main database table for each matching row.
+ * The cost is a larger table, and larger indexes.
+ *
+ * When this option is enabled, the names "collection" and "key" are reserved,
+ * and can't be used for columns in the setup.
+ *
+ * If you change this option for an existing index, you MUST change the versionTag as well.
+ *
+ * The default value is NO.
+**/
+@property (nonatomic, assign, readwrite) BOOL includesKeys;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -15,11 +15,13 @@
 @implementation YapDatabaseSecondaryIndexOptions
 
 @synthesize allowedCollections = allowedCollections;
+@synthesize includesKeys = includesKeys;
 
 - (id)copyWithZone:(NSZone __unused *)zone
 {
 	YapDatabaseSecondaryIndexOptions *copy = [[YapDatabaseSecondaryIndexOptions alloc] init];
 	copy->allowedCollections = allowedCollections;
+	copy->includesKeys = includesKeys;
 	
 	return copy;
 }
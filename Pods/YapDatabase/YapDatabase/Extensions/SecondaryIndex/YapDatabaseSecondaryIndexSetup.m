@@ -183,15 +183,24 @@ NSString* NSStringFromYapDatabaseSecondaryIndexType(YapDatabaseSecondaryIndexTyp
  * The columns parameter comes from:
  * [YapDatabase columnNamesAndAffinityForTable:using:]
 **/
-- (BOOL)matchesExistingColumnNamesAndAffinity:(NSDictionary *)columns
+- (BOOL)matchesExistingColumnNamesAndAffinity:(NSDictionary *)columns includesKeys:(BOOL)includesKeys
 {
 	// The columns parameter will include the 'rowid' column, which we need to ignore.
+	// As well as the 'collection' & 'key' columns, if the table includes them.
 	
-	if (([setup count] + 1) != [columns count])
+	NSUInteger extraCount = includesKeys ? 3 : 1;
+	
+	if (([setup count] + extraCount) != [columns count])
 	{
 		return NO;
 	}
 	
+	if (includesKeys)
+	{
+		if (![[columns objectForKey:@"collection"] isEqualToString:@"TEXT"]) return NO;
+		if (![[columns objectForKey:@"key"] isEqualToString:@"TEXT"]) return NO;
+	}
+	
 	for (YapDatabaseSecondaryIndexColumn *setupColumn in setup)
 	{
 		NSString *existingAffinity = [columns objectForKey:setupColumn.name];
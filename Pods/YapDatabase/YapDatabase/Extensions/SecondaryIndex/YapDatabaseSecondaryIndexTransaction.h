@@ -31,6 +31,10 @@ NS_ASSUME_NONNULL_BEGIN
  *
  * For more information, and more examples, please see YapDatabaseQuery.
  * 
+ * If the index was created with YapDatabaseSecondaryIndexOptions.includesKeys,
+ * then the collection & key of each match come straight from the index,
+ * rather than from a lookup in the database table.
+ * 
  * @return NO if there was a problem with the given query. YES otherwise.
  * 
  * @see YapDatabaseQuery
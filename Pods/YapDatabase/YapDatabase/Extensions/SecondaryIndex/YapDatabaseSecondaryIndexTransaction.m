@@ -5,6 +5,7 @@
 #import "YapDatabasePrivate.h"
 #import "YapDatabaseExtensionPrivate.h"
 
+#import "YapDatabaseString.h"
 #import "YapDatabaseLogging.h"
 
 #if ! __has_feature(objc_arc)
@@ -66,7 +67,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 		}
 		
 		if (![self createTable]) return NO;
-		if (![self populate]) return NO;
+		if (![self populateOrBeginBatchedPopulation]) return NO;
 		
 		[self setIntValue:classVersion forExtensionKey:ext_key_classVersion persistent:YES];
 		
@@ -99,7 +100,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 		{
 			if (![self dropTable]) return NO;
 			if (![self createTable]) return NO;
-			if (![self populate]) return NO;
+			if (![self populateOrBeginBatchedPopulation]) return NO;
 			
 			[self setStringValue:versionTag forExtensionKey:ext_key_versionTag persistent:YES];
 			
@@ -145,8 +146,9 @@ static NSString *const ext_key_version_deprecated = @"version";
 			NSDictionary *columns = [YapDatabase columnNamesAndAffinityForTable:[self tableName] using:db];
 			
 			YapDatabaseSecondaryIndexSetup *setup = parentConnection->parent->setup;
+			BOOL includesKeys = parentConnection->parent->options.includesKeys;
 			
-			if (![setup matchesExistingColumnNamesAndAffinity:columns])
+			if (![setup matchesExistingColumnNamesAndAffinity:columns includesKeys:includesKeys])
 			{
 				YDBLogError(@"Error creating secondary index extension (%@):"
 				            @" The given setup doesn't match the previously registered setup."
@@ -212,14 +214,24 @@ static NSString *const ext_key_version_deprecated = @"version";
 	
 	NSString *tableName = [self tableName];
 	YapDatabaseSecondaryIndexSetup *setup = parentConnection->parent->setup;
+	BOOL includesKeys = parentConnection->parent->options.includesKeys;
 	
 	YDBLogVerbose(@"Creating secondary index table for registeredName(%@): %@", [self registeredName], tableName);
 	
 	// CREATE TABLE  IF NOT EXISTS "tableName" ("rowid" INTEGER PRIMARY KEY, index1, index2...);
+	//
+	// Or, if includesKeys:
+	//
+	// CREATE TABLE  IF NOT EXISTS "tableName" ("rowid" INTEGER PRIMARY KEY, "collection" TEXT, "key" TEXT, index1, ...);
 	
 	NSMutableString *createTable = [NSMutableString stringWithCapacity:100];
 	[createTable appendFormat:@"CREATE TABLE IF NOT EXISTS \"%@\" (\"rowid\" INTEGER PRIMARY KEY", tableName];
 	
+	if (includesKeys)
+	{
+		[createTable appendString:@", \"collection\" TEXT, \"key\" TEXT"];
+	}
+	
 	for (YapDatabaseSecondaryIndexColumn *column in setup)
 	{
 		if (column.type == YapDatabaseSecondaryIndexTypeInteger)
@@ -254,11 +266,20 @@ static NSString *const ext_key_version_deprecated = @"version";
 		return NO;
 	}
 	
+	// The rowid is implicitly part of every index.
+	// So with the collection & key appended, a key query over a single column never has to touch the table.
+	
 	for (YapDatabaseSecondaryIndexColumn *column in setup)
 	{
-		NSString *createIndex =
-		    [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS \"%@\" ON \"%@\" (\"%@\");",
-		        column.name, tableName, column.name];
+		NSString *createIndex = nil;
+		if (includesKeys)
+			createIndex =
+			  [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS \"%@\" ON \"%@\" (\"%@\", \"collection\", \"key\");",
+			      column.name, tableName, column.name];
+		else
+			createIndex =
+			  [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS \"%@\" ON \"%@\" (\"%@\");",
+			      column.name, tableName, column.name];
 		
 		status = sqlite3_exec(db, [createIndex UTF8String], NULL, NULL, NULL);
 		if (status != SQLITE_OK)
@@ -303,7 +324,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 			
 			if ([parentConnection->blockDict count] > 0)
 			{
-				[self addRowid:rowid isNew:YES];
+				[self addRowid:rowid collection:collection key:key isNew:YES];
 				[parentConnection->blockDict removeAllObjects];
 			}
 		};
@@ -325,20 +346,42 @@ static NSString *const ext_key_version_deprecated = @"version";
 	}
 	else if (blockType == YapDatabaseBlockTypeWithObject)
 	{
-		__unsafe_unretained YapDatabaseSecondaryIndexWithObjectBlock secondaryIndexBlock =
-		    (YapDatabaseSecondaryIndexWithObjectBlock)handler->block;
-		
 		void (^enumBlock)(int64_t rowid, NSString *collection, NSString *key, id object, BOOL *stop);
-		enumBlock = ^(int64_t rowid, NSString *collection, NSString *key, id object, BOOL __unused *stop) {
+		
+		if (handler->isIntegersBlock)
+		{
+			__unsafe_unretained YapDatabaseSecondaryIndexWithObjectIntegersBlock secondaryIndexBlock =
+			    (YapDatabaseSecondaryIndexWithObjectIntegersBlock)handler->block;
 			
-			secondaryIndexBlock(databaseTransaction, parentConnection->blockDict, collection, key, object);
+			int64_t *values = parentConnection->blockIntegers;
+			size_t valuesSize = [secondaryIndex->setup count] * sizeof(int64_t);
 			
-			if ([parentConnection->blockDict count] > 0)
-			{
-				[self addRowid:rowid isNew:YES];
-				[parentConnection->blockDict removeAllObjects];
-			}
-		};
+			enumBlock = ^(int64_t rowid, NSString *collection, NSString *key, id object, BOOL __unused *stop) {
+				
+				memset(values, 0, valuesSize);
+				
+				if (secondaryIndexBlock(databaseTransaction, values, collection, key, object))
+				{
+					[self addRowid:rowid collection:collection key:key isNew:YES];
+				}
+			};
+		}
+		else
+		{
+			__unsafe_unretained YapDatabaseSecondaryIndexWithObjectBlock secondaryIndexBlock =
+			    (YapDatabaseSecondaryIndexWithObjectBlock)handler->block;
+			
+			enumBlock = ^(int64_t rowid, NSString *collection, NSString *key, id object, BOOL __unused *stop) {
+				
+				secondaryIndexBlock(databaseTransaction, parentConnection->blockDict, collection, key, object);
+				
+				if ([parentConnection->blockDict count] > 0)
+				{
+					[self addRowid:rowid collection:collection key:key isNew:YES];
+					[parentConnection->blockDict removeAllObjects];
+				}
+			};
+		}
 		
 		if (allowedCollections)
 		{
@@ -368,7 +411,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 			
 			if ([parentConnection->blockDict count] > 0)
 			{
-				[self addRowid:rowid isNew:YES];
+				[self addRowid:rowid collection:collection key:key isNew:YES];
 				[parentConnection->blockDict removeAllObjects];
 			}
 		};
@@ -401,7 +444,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 			
 			if ([parentConnection->blockDict count] > 0)
 			{
-				[self addRowid:rowid isNew:YES];
+				[self addRowid:rowid collection:collection key:key isNew:YES];
 				[parentConnection->blockDict removeAllObjects];
 			}
 		};
@@ -425,6 +468,63 @@ static NSString *const ext_key_version_deprecated = @"version";
 	return YES;
 }
 
+/**
+ * Internal method.
+ *
+ * If the index was registered with a populationBatchSize, then the table is emptied here,
+ * and populated afterwards in batches. Otherwise the table is populated now, within the registration transaction.
+**/
+- (BOOL)populateOrBeginBatchedPopulation
+{
+	if ([self populatesInBatches])
+	{
+		[self removeAllRowids];
+		[self beginBatchedPopulation];
+		
+		return YES;
+	}
+	else
+	{
+		return [self populate];
+	}
+}
+
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+**/
+- (BOOL)supportsBatchedPopulation
+{
+	return YES;
+}
+
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+**/
+- (BOOL)shouldPopulateCollection:(NSString *)collection
+{
+	__unsafe_unretained YapWhitelistBlacklist *allowedCollections = parentConnection->parent->options.allowedCollections;
+	
+	return (allowedCollections == nil) || [allowedCollections isAllowed:collection];
+}
+
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+ *
+ * The row may already be in the index (if it was modified since the index was registered),
+ * so it's handled as an update.
+**/
+- (void)populateRowid:(int64_t)rowid
+        collectionKey:(YapCollectionKey *)collectionKey
+               object:(id)object
+             metadata:(id)metadata
+{
+	[self _handleChangeWithRowid:rowid
+	               collectionKey:collectionKey
+	                      object:object
+	                    metadata:metadata
+	                    isInsert:NO];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -460,246 +560,430 @@ static NSString *const ext_key_version_deprecated = @"version";
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * Adds a row to the table, using the given rowid along with the values in the 'blockDict' ivar.
+ * Queues up a row to be added to the table (or updated),
+ * using the given rowid along with the values in the 'blockDict' ivar (or the 'blockIntegers' ivar).
+ *
+ * The collection & key are only stored if the table includes them (options.includesKeys).
 **/
-- (void)addRowid:(int64_t)rowid isNew:(BOOL)isNew
+- (void)addRowid:(int64_t)rowid collection:(NSString *)collection key:(NSString *)key isNew:(BOOL)isNew
 {
 	YDBLogAutoTrace();
 	
-	sqlite3_stmt *statement = NULL;
-	if (isNew)
-		statement = [parentConnection insertStatement];
-	else
-		statement = [parentConnection updateStatement];
-	
-	if (statement == NULL)
-		return;
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	__unsafe_unretained YapDatabaseSecondaryIndexPendingRows *pendingRows = parentConnection->pendingRows;
 	
-	//  isNew : INSERT            INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
-	// !isNew : INSERT OR REPLACE INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+	NSDictionary *dict = nil;
+	if (!secondaryIndex->handler->isIntegersBlock)
+		dict = [parentConnection->blockDict copy];
 	
-	int bind_idx = SQLITE_BIND_START;
+	YapCollectionKey *collectionKey = nil;
+	if (secondaryIndex->options.includesKeys)
+		collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 	
-	sqlite3_bind_int64(statement, bind_idx, rowid);
-	bind_idx++;
+	NSUInteger slot = [pendingRows addRowid:rowid isNew:isNew dict:dict collectionKey:collectionKey];
 	
-	for (YapDatabaseSecondaryIndexColumn *column in parentConnection->parent->setup)
+	if (secondaryIndex->handler->isIntegersBlock)
 	{
-		id columnValue = [parentConnection->blockDict objectForKey:column.name];
-		if (columnValue && columnValue != [NSNull null])
-		{
-			if (column.type == YapDatabaseSecondaryIndexTypeInteger ||
-			    column.type == YapDatabaseSecondaryIndexTypeReal    ||
-			    column.type == YapDatabaseSecondaryIndexTypeNumeric  )
-			{
-				if ([columnValue isKindOfClass:[NSNumber class]])
-				{
-					__unsafe_unretained NSNumber *number = (NSNumber *)columnValue;
-					
-					CFNumberType numberType = CFNumberGetType((CFNumberRef)number);
-					
-					if (numberType == kCFNumberFloat32Type ||
-						numberType == kCFNumberFloat64Type ||
-						numberType == kCFNumberFloatType   ||
-						numberType == kCFNumberDoubleType  ||
-						numberType == kCFNumberCGFloatType  )
-					{
-						double num = [number doubleValue];
-						sqlite3_bind_double(statement, bind_idx, num);
-					}
-					else
-					{
-						int64_t num = [number longLongValue];
-						sqlite3_bind_int64(statement, bind_idx, (sqlite3_int64)num);
-					}
-				}
-				else if ([columnValue isKindOfClass:[NSDate class]])
-				{
-					__unsafe_unretained NSDate *date = (NSDate *)columnValue;
-					
-					double num = [date timeIntervalSinceReferenceDate];
-					sqlite3_bind_double(statement, bind_idx, num);
-				}
-				else
-				{
-					YDBLogWarn(@"Unable to bind value for column(name=%@, type=%@) with unsupported class: %@."
-					           @" Column requires NSNumber or NSDate.",
-					           column.name,
-					           NSStringFromYapDatabaseSecondaryIndexType(column.type),
-					           NSStringFromClass([columnValue class]));
-				}
-			}
-			else if (column.type == YapDatabaseSecondaryIndexTypeText)
-			{
-				if ([columnValue isKindOfClass:[NSString class]])
-				{
-					__unsafe_unretained NSString *string = (NSString *)columnValue;
-					
-					sqlite3_bind_text(statement, bind_idx, [string UTF8String], -1, SQLITE_TRANSIENT);
-				}
-				else
-				{
-					YDBLogWarn(@"Unable to bind value for column(name=%@, type=text) with unsupported class: %@."
-					           @" Column requires NSString.",
-					           column.name, NSStringFromClass([columnValue class]));
-				}
-			}
-			else if (column.type == YapDatabaseSecondaryIndexTypeBlob)
-			{
-				if ([columnValue isKindOfClass:[NSData class]])
-				{
-					__unsafe_unretained NSData *data = (NSData *)columnValue;
-					
-					sqlite3_bind_blob(statement, bind_idx, [data bytes], (int)[data length], SQLITE_STATIC);
-				}
-				else
-				{
-					YDBLogWarn(@"Unable to bind value for column(name=%@, type=text) with unsupported class: %@."
-					           @" Column requires NSData.",
-					           column.name, NSStringFromClass([columnValue class]));
-				}
-			}
-		}
-		
-		bind_idx++;
+		memcpy(pendingRows->integers + (slot * pendingRows->integersPerRow),
+		       parentConnection->blockIntegers,
+		       pendingRows->integersPerRow * sizeof(int64_t));
 	}
 	
-	int status = sqlite3_step(statement);
-	if (status != SQLITE_DONE)
+	[parentConnection->mutationStack markAsMutated];
+	
+	if (pendingRows->count >= pendingRows->capacity)
 	{
-		YDBLogError(@"Error executing '%s': %d %s",
-		            isNew ? "insertStatement" : "updateStatement",
-		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		[self flushPendingRows];
 	}
+}
+
+/**
+ * Queues up the removal of a row from the table.
+**/
+- (void)removeRowid:(int64_t)rowid
+{
+	YDBLogAutoTrace();
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
+	__unsafe_unretained YapDatabaseSecondaryIndexPendingRows *pendingRows = parentConnection->pendingRows;
 	
+	[pendingRows removeRowid:rowid];
 	[parentConnection->mutationStack markAsMutated];
+	
+	if (pendingRows->count >= pendingRows->capacity)
+	{
+		[self flushPendingRows];
+	}
 }
 
-- (void)removeRowid:(int64_t)rowid
+- (void)removeRowids:(NSArray *)rowids
 {
 	YDBLogAutoTrace();
 	
-	sqlite3_stmt *statement = [parentConnection removeStatement];
-	if (statement == NULL) return;
+	for (NSNumber *rowidNumber in rowids)
+	{
+		[self removeRowid:[rowidNumber longLongValue]];
+	}
+}
+
+- (void)removeAllRowids
+{
+	YDBLogAutoTrace();
 	
-	// DELETE FROM "tableName" WHERE "rowid" = ?;
+	// Anything still queued up would be removed anyway.
 	
-	int const bind_idx_rowid = SQLITE_BIND_START;
+	[parentConnection->pendingRows removeAllRows];
 	
-	sqlite3_bind_int64(statement, bind_idx_rowid, rowid);
+	sqlite3_stmt *statement = [parentConnection removeAllStatement];
+	if (statement == NULL)
+		return;
 	
-	int status = sqlite3_step(statement);
+	int status;
+	
+	// DELETE FROM "tableName";
+	
+	YDBLogVerbose(@"DELETE FROM '%@';", [self tableName]);
+	
+	status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
 	{
-		YDBLogError(@"Error executing 'removeStatement': %d %s",
+		YDBLogError(@"%@ (%@): Error in removeAllStatement: %d %s",
+		            THIS_METHOD, [self registeredName],
 		            status, sqlite3_errmsg(databaseTransaction->connection->db));
 	}
 	
-	sqlite3_clear_bindings(statement);
 	sqlite3_reset(statement);
 	
 	[parentConnection->mutationStack markAsMutated];
 }
 
-- (void)removeRowids:(NSArray *)rowids
+/**
+ * Writes all the queued up changes to the table.
+ *
+ * Each row is written once, regardless of how many times it was changed within the transaction.
+ * The rows are written in ascending rowid order, so sqlite walks the b-trees sequentially,
+ * and the removals are grouped into as few statements as possible.
+ *
+ * This must be invoked before the table is read, and before the transaction is committed.
+**/
+- (void)flushPendingRows
 {
+	__unsafe_unretained YapDatabaseSecondaryIndexPendingRows *pendingRows = parentConnection->pendingRows;
+	if (pendingRows->count == 0) return;
+	
 	YDBLogAutoTrace();
 	
-	NSUInteger count = [rowids count];
+	NSUInteger count = pendingRows->count;
+	NSUInteger *sortedSlots = malloc(count * sizeof(NSUInteger));
+	NSUInteger liveCount = 0;
 	
-	if (count == 0) return;
-	if (count == 1)
+	for (NSUInteger slot = 0; slot < count; slot++)
 	{
-		int64_t rowid = [[rowids objectAtIndex:0] longLongValue];
-		
-		[self removeRowid:rowid];
-		return;
+		if (pendingRows->rows[slot].isLive)
+		{
+			sortedSlots[liveCount] = slot;
+			liveCount++;
+		}
 	}
 	
-	// DELETE FROM "tableName" WHERE "rowid" in (?, ?, ...);
-	//
-	// Note: We don't have to worry sqlite's max number of host parameters.
-	// YapDatabase gives us the rowids in batches where each batch is already capped at this number.
-	
-	NSUInteger capacity = 50 + (count * 3);
-	NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
+	const YapDatabaseSecondaryIndexPendingRow *rows = pendingRows->rows;
+	qsort_b(sortedSlots, liveCount, sizeof(NSUInteger), ^int(const void *slot1, const void *slot2) {
+		
+		int64_t rowid1 = rows[*(const NSUInteger *)slot1].rowid;
+		int64_t rowid2 = rows[*(const NSUInteger *)slot2].rowid;
+		
+		return (rowid1 < rowid2) ? -1 : ((rowid1 > rowid2) ? 1 : 0);
+	});
 	
-	[query appendFormat:@"DELETE FROM \"%@\" WHERE \"rowid\" IN (", [self tableName]];
+	NSMutableArray *removedRowids = nil;
 	
-	NSUInteger i;
-	for (i = 0; i < count; i++)
+	for (NSUInteger i = 0; i < liveCount; i++)
 	{
-		if (i == 0)
-			[query appendString:@"?"];
+		NSUInteger slot = sortedSlots[i];
+		
+		if (rows[slot].isRemoval)
+		{
+			if (removedRowids == nil)
+				removedRowids = [NSMutableArray array];
+			
+			[removedRowids addObject:@(rows[slot].rowid)];
+		}
 		else
-			[query appendString:@", ?"];
+		{
+			[self writePendingRowAtSlot:slot];
+		}
 	}
 	
-	[query appendString:@");"];
-	
-	sqlite3_stmt *statement;
+	free(sortedSlots);
 	
-	int status = sqlite3_prepare_v2(databaseTransaction->connection->db, [query UTF8String], -1, &statement, NULL);
-	if (status != SQLITE_OK)
+	if (removedRowids)
 	{
-		YDBLogError(@"Error creating 'removeRowids' statement: %d %s",
-		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		[self deleteRowids:removedRowids];
+	}
+	
+	[pendingRows removeAllRows];
+}
+
+/**
+ * Inserts (or replaces) the given row in the table.
+**/
+- (void)writePendingRowAtSlot:(NSUInteger)slot
+{
+	__unsafe_unretained YapDatabaseSecondaryIndex *secondaryIndex = parentConnection->parent;
+	__unsafe_unretained YapDatabaseSecondaryIndexPendingRows *pendingRows = parentConnection->pendingRows;
+	
+	const YapDatabaseSecondaryIndexPendingRow *row = &pendingRows->rows[slot];
+	
+	sqlite3_stmt *statement = NULL;
+	if (row->isNew)
+		statement = [parentConnection insertStatement];
+	else
+		statement = [parentConnection updateStatement];
+	
+	if (statement == NULL)
 		return;
+	
+	//  isNew : INSERT            INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+	// !isNew : INSERT OR REPLACE INTO "tableName" ("rowid", "column1", "column2", ...) VALUES (?, ?, ? ...);
+	//
+	// If includesKeys, then "collection" & "key" follow the "rowid".
+	
+	int bind_idx = SQLITE_BIND_START;
+	
+	sqlite3_bind_int64(statement, bind_idx, row->rowid);
+	bind_idx++;
+	
+	YapCollectionKey *collectionKey = nil;
+	if (secondaryIndex->options.includesKeys)
+		collectionKey = [pendingRows->collectionKeys objectAtIndex:slot];
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collectionKey.collection);
+	YapDatabaseString _key;        MakeYapDatabaseString(&_key,        collectionKey.key);
+	
+	if (secondaryIndex->options.includesKeys)
+	{
+		sqlite3_bind_text(statement, bind_idx, _collection.str, _collection.length, SQLITE_STATIC);
+		bind_idx++;
+		
+		sqlite3_bind_text(statement, bind_idx, _key.str, _key.length, SQLITE_STATIC);
+		bind_idx++;
 	}
 	
-	for (i = 0; i < count; i++)
+	if (secondaryIndex->handler->isIntegersBlock)
 	{
-		int64_t rowid = [[rowids objectAtIndex:i] longLongValue];
+		const int64_t *values = pendingRows->integers + (slot * pendingRows->integersPerRow);
+		NSUInteger count = pendingRows->integersPerRow;
 		
-		sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			sqlite3_bind_int64(statement, bind_idx, (sqlite3_int64)values[i]);
+			bind_idx++;
+		}
+	}
+	else
+	{
+		__unsafe_unretained NSDictionary *blockDict = (NSDictionary *)[pendingRows->dicts objectAtIndex:slot];
+		
+		for (YapDatabaseSecondaryIndexColumn *column in secondaryIndex->setup)
+		{
+			id columnValue = [blockDict objectForKey:column.name];
+			if (columnValue && columnValue != [NSNull null])
+			{
+				if (column.type == YapDatabaseSecondaryIndexTypeInteger ||
+				    column.type == YapDatabaseSecondaryIndexTypeReal    ||
+				    column.type == YapDatabaseSecondaryIndexTypeNumeric  )
+				{
+					if ([columnValue isKindOfClass:[NSNumber class]])
+					{
+						__unsafe_unretained NSNumber *number = (NSNumber *)columnValue;
+						
+						CFNumberType numberType = CFNumberGetType((CFNumberRef)number);
+						
+						if (numberType == kCFNumberFloat32Type ||
+							numberType == kCFNumberFloat64Type ||
+							numberType == kCFNumberFloatType   ||
+							numberType == kCFNumberDoubleType  ||
+							numberType == kCFNumberCGFloatType  )
+						{
+							double num = [number doubleValue];
+							sqlite3_bind_double(statement, bind_idx, num);
+						}
+						else
+						{
+							int64_t num = [number longLongValue];
+							sqlite3_bind_int64(statement, bind_idx, (sqlite3_int64)num);
+						}
+					}
+					else if ([columnValue isKindOfClass:[NSDate class]])
+					{
+						__unsafe_unretained NSDate *date = (NSDate *)columnValue;
+						
+						double num = [date timeIntervalSinceReferenceDate];
+						sqlite3_bind_double(statement, bind_idx, num);
+					}
+					else
+					{
+						YDBLogWarn(@"Unable to bind value for column(name=%@, type=%@) with unsupported class: %@."
+						           @" Column requires NSNumber or NSDate.",
+						           column.name,
+						           NSStringFromYapDatabaseSecondaryIndexType(column.type),
+						           NSStringFromClass([columnValue class]));
+					}
+				}
+				else if (column.type == YapDatabaseSecondaryIndexTypeText)
+				{
+					if ([columnValue isKindOfClass:[NSString class]])
+					{
+						__unsafe_unretained NSString *string = (NSString *)columnValue;
+						
+						sqlite3_bind_text(statement, bind_idx, [string UTF8String], -1, SQLITE_TRANSIENT);
+					}
+					else
+					{
+						YDBLogWarn(@"Unable to bind value for column(name=%@, type=text) with unsupported class: %@."
+						           @" Column requires NSString.",
+						           column.name, NSStringFromClass([columnValue class]));
+					}
+				}
+				else if (column.type == YapDatabaseSecondaryIndexTypeBlob)
+				{
+					if ([columnValue isKindOfClass:[NSData class]])
+					{
+						__unsafe_unretained NSData *data = (NSData *)columnValue;
+						
+						sqlite3_bind_blob(statement, bind_idx, [data bytes], (int)[data length], SQLITE_STATIC);
+					}
+					else
+					{
+						YDBLogWarn(@"Unable to bind value for column(name=%@, type=text) with unsupported class: %@."
+						           @" Column requires NSData.",
+						           column.name, NSStringFromClass([columnValue class]));
+					}
+				}
+			}
+			
+			bind_idx++;
+		}
 	}
 	
-	status = sqlite3_step(statement);
+	int status = sqlite3_step(statement);
 	if (status != SQLITE_DONE)
 	{
-		YDBLogError(@"Error executing 'removeRowids' statement: %d %s",
+		YDBLogError(@"Error executing '%s': %d %s",
+		            row->isNew ? "insertStatement" : "updateStatement",
 		            status, sqlite3_errmsg(databaseTransaction->connection->db));
 	}
 	
-	sqlite3_finalize(statement);
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
 	
-	[parentConnection->mutationStack markAsMutated];
+	FreeYapDatabaseString(&_collection);
+	FreeYapDatabaseString(&_key);
 }
 
-- (void)removeAllRowids
+/**
+ * Deletes the given rows from the table.
+**/
+- (void)deleteRowids:(NSArray *)rowids
 {
-	YDBLogAutoTrace();
+	NSUInteger count = [rowids count];
+	if (count == 0) return;
 	
-	sqlite3_stmt *statement = [parentConnection removeAllStatement];
-	if (statement == NULL)
+	if (count == 1)
+	{
+		sqlite3_stmt *statement = [parentConnection removeStatement];
+		if (statement == NULL) return;
+		
+		// DELETE FROM "tableName" WHERE "rowid" = ?;
+		
+		int const bind_idx_rowid = SQLITE_BIND_START;
+		
+		sqlite3_bind_int64(statement, bind_idx_rowid, [[rowids objectAtIndex:0] longLongValue]);
+		
+		int status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error executing 'removeStatement': %d %s",
+			            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
 		return;
+	}
 	
-	int status;
-	
-	// DELETE FROM "tableName";
+	// DELETE FROM "tableName" WHERE "rowid" in (?, ?, ...);
+	//
+	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
+	// The rowids may have been queued up from many changes, so they're deleted in chunks.
 	
-	YDBLogVerbose(@"DELETE FROM '%@';", [self tableName]);
+	sqlite3 *db = databaseTransaction->connection->db;
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
 	
-	status = sqlite3_step(statement);
-	if (status != SQLITE_DONE)
+	NSUInteger offset = 0;
+	while (offset < count)
 	{
-		YDBLogError(@"%@ (%@): Error in removeAllStatement: %d %s",
-		            THIS_METHOD, [self registeredName],
-		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+		NSUInteger numParams = MIN(count - offset, maxHostParams);
+		
+		NSUInteger capacity = 50 + (numParams * 3);
+		NSMutableString *query = [NSMutableString stringWithCapacity:capacity];
+		
+		[query appendFormat:@"DELETE FROM \"%@\" WHERE \"rowid\" IN (", [self tableName]];
+		
+		NSUInteger i;
+		for (i = 0; i < numParams; i++)
+		{
+			if (i == 0)
+				[query appendString:@"?"];
+			else
+				[query appendString:@", ?"];
+		}
+		
+		[query appendString:@");"];
+		
+		sqlite3_stmt *statement = [databaseTransaction->connection cachedStatementForQuery:query];
+		if (statement == NULL)
+		{
+			return;
+		}
+		
+		for (i = 0; i < numParams; i++)
+		{
+			int64_t rowid = [[rowids objectAtIndex:(offset + i)] longLongValue];
+			
+			sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
+		}
+		
+		int status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"Error executing 'removeRowids' statement: %d %s",
+			            status, sqlite3_errmsg(db));
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		
+		offset += numParams;
 	}
-	
-	sqlite3_reset(statement);
-	
-	[parentConnection->mutationStack markAsMutated];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Cleanup & Commit
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Overrides method in YapDatabaseExtensionTransaction.
+**/
+- (void)flushPendingChangesToExtensionTables
+{
+	YDBLogAutoTrace();
+	
+	[self flushPendingRows];
+	
+	// This must be done LAST.
+	[super flushPendingChangesToExtensionTables];
+}
+
 /**
  * Required override method from YapDatabaseExtension
 **/
@@ -736,6 +1020,25 @@ static NSString *const ext_key_version_deprecated = @"version";
 	databaseTransaction = nil; // Do not remove !
 }
 
+/**
+ * Rows are either pending (in memory), or have been flushed to our table (which the savepoint takes care of).
+ * Pending rows are modified in place, so the state is a copy of the queue.
+**/
+- (BOOL)supportsSavepoints
+{
+	return YES;
+}
+
+- (id)savepointState
+{
+	return [parentConnection->pendingRows copy];
+}
+
+- (void)rollbackToSavepointState:(id)state
+{
+	parentConnection->pendingRows = [(YapDatabaseSecondaryIndexPendingRows *)state copy];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Transaction Hooks
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -767,6 +1070,26 @@ static NSString *const ext_key_version_deprecated = @"version";
 	YapDatabaseSecondaryIndexHandler *handler = secondaryIndex->handler;
 	YapDatabaseBlockType blockType = handler->blockType;
 	
+	if (handler->isIntegersBlock)
+	{
+		__unsafe_unretained YapDatabaseSecondaryIndexWithObjectIntegersBlock block =
+		    (YapDatabaseSecondaryIndexWithObjectIntegersBlock)handler->block;
+		
+		int64_t *values = parentConnection->blockIntegers;
+		memset(values, 0, [secondaryIndex->setup count] * sizeof(int64_t));
+		
+		if (block(databaseTransaction, values, collection, key, object))
+		{
+			[self addRowid:rowid collection:collection key:key isNew:isInsert];
+		}
+		else if (!isInsert)
+		{
+			[self removeRowid:rowid];
+		}
+		
+		return;
+	}
+	
 	if (blockType == YapDatabaseBlockTypeWithKey)
 	{
 		__unsafe_unretained YapDatabaseSecondaryIndexWithKeyBlock block =
@@ -810,7 +1133,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 		// Add values to index (or update them).
 		// This was an update operation, so we need to insert or update.
 		
-		[self addRowid:rowid isNew:isInsert];
+		[self addRowid:rowid collection:collection key:key isNew:isInsert];
 		[parentConnection->blockDict removeAllObjects];
 	}
 }
@@ -1083,37 +1406,35 @@ static NSString *const ext_key_version_deprecated = @"version";
 #pragma mark Utilities
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-- (sqlite3_stmt *)prepareQueryString:(NSString *)fullQueryString
+/**
+ * Compiles the query (using the connection's statement cache if possible).
+ * 
+ * When done with the statement, pass it to sqlite_enum_reset along with the returned needsFinalize value.
+**/
+- (sqlite3_stmt *)prepareQueryString:(NSString *)fullQueryString needsFinalize:(BOOL *)needsFinalizePtr
 {
-	sqlite3_stmt *statement = NULL;
+	NSParameterAssert(needsFinalizePtr != NULL);
 	
-	YapDatabaseStatement *wrapper = [parentConnection->queryCache objectForKey:fullQueryString];
-	if (wrapper)
+	if (parentConnection->queryCacheEnabled)
 	{
-		statement = wrapper.stmt;
+		*needsFinalizePtr = NO;
+		return [databaseTransaction->connection cachedStatementForQuery:fullQueryString];
 	}
-	else
+	
+	sqlite3 *db = databaseTransaction->connection->db;
+	sqlite3_stmt *statement = NULL;
+	
+	int status = sqlite3_prepare_v2(db, [fullQueryString UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
 	{
-		sqlite3 *db = databaseTransaction->connection->db;
+		YDBLogError(@"%@: Error creating query:\n query: '%@'\n error: %d %s",
+					THIS_METHOD, fullQueryString, status, sqlite3_errmsg(db));
 		
-		int status = sqlite3_prepare_v2(db, [fullQueryString UTF8String], -1, &statement, NULL);
-		if (status == SQLITE_OK)
-		{
-			if (parentConnection->queryCache)
-			{
-				wrapper = [[YapDatabaseStatement alloc] initWithStatement:statement];
-				[parentConnection->queryCache setObject:wrapper forKey:fullQueryString];
-			}
-		}
-		else
-		{
-			YDBLogError(@"%@: Error creating query:\n query: '%@'\n error: %d %s",
-						THIS_METHOD, fullQueryString, status, sqlite3_errmsg(db));
-			
-			return NULL;
-		}
+		sqlite_finalize_null(&statement);
+		return NULL;
 	}
 	
+	*needsFinalizePtr = YES;
 	return statement;
 }
 
@@ -1176,6 +1497,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	if (query == nil) return NO;
 	if (query.isAggregateQuery) return NO;
 	
+	// Write any changes which are still queued up
+	
+	[self flushPendingRows];
+	
 	// Create full query using given filtering clause(s)
 	
 	NSString *fullQueryString =
@@ -1183,7 +1508,8 @@ static NSString *const ext_key_version_deprecated = @"version";
 	
 	// Turn query into compiled sqlite statement (using cache if possible)
 	
-	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString];
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString needsFinalize:&needsFinalize];
 	if (statement == NULL)
 	{
 		return NO;
@@ -1214,8 +1540,88 @@ static NSString *const ext_key_version_deprecated = @"version";
 		            status, sqlite3_errmsg(databaseTransaction->connection->db));
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
+	sqlite_enum_reset(statement, needsFinalize);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+	
+	return (status == SQLITE_DONE);
+}
+
+/**
+ * Only for tables which include the collection & key (options.includesKeys).
+ * 
+ * The keys are read straight out of the index table (and, if the query allows, straight out of the sqlite index),
+ * rather than being looked up in the database table for every matching rowid.
+**/
+- (BOOL)_enumerateCollectionKeysMatchingQuery:(YapDatabaseQuery *)query
+                                   usingBlock:(void (^)(int64_t rowid, YapCollectionKey *ck, BOOL *stop))block
+{
+	if (query == nil) return NO;
+	if (query.isAggregateQuery) return NO;
+	
+	// Write any changes which are still queued up
+	
+	[self flushPendingRows];
+	
+	// Create full query using given filtering clause(s)
+	
+	NSString *fullQueryString =
+	    [NSString stringWithFormat:@"SELECT \"rowid\", \"collection\", \"key\" FROM \"%@\" %@;",
+	                                                                        [self tableName], query.queryString];
+	
+	// Turn query into compiled sqlite statement (using cache if possible)
+	
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString needsFinalize:&needsFinalize];
+	if (statement == NULL)
+	{
+		return NO;
+	}
+	
+	// Bind query parameters appropriately.
+	
+	[self bindQueryParameters:query.queryParameters forStatement:statement withOffset:SQLITE_BIND_START];
+	
+	// Enumerate query results
+	
+	int const column_idx_rowid      = SQLITE_COLUMN_START + 0;
+	int const column_idx_collection = SQLITE_COLUMN_START + 1;
+	int const column_idx_key        = SQLITE_COLUMN_START + 2;
+	
+	BOOL stop = NO;
+	YapMutationStackItem_Bool *mutation = [parentConnection->mutationStack push]; // mutation during enum protection
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+		
+		const unsigned char *text0 = sqlite3_column_text(statement, column_idx_collection);
+		int textSize0 = sqlite3_column_bytes(statement, column_idx_collection);
+		
+		const unsigned char *text1 = sqlite3_column_text(statement, column_idx_key);
+		int textSize1 = sqlite3_column_bytes(statement, column_idx_key);
+		
+		NSString *collection = [[NSString alloc] initWithBytes:text0 length:textSize0 encoding:NSUTF8StringEncoding];
+		NSString *key        = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
+		
+		YapCollectionKey *ck = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		block(rowid, ck, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD,
+		            status, sqlite3_errmsg(databaseTransaction->connection->db));
+	}
+	
+	sqlite_enum_reset(statement, needsFinalize);
 	
 	if (!stop && mutation.isMutated)
 	{
@@ -1228,6 +1634,21 @@ static NSString *const ext_key_version_deprecated = @"version";
 - (BOOL)enumerateKeysMatchingQuery:(YapDatabaseQuery *)query
                         usingBlock:(void (^)(NSString *collection, NSString *key, BOOL *stop))block
 {
+	if (parentConnection->parent->options.includesKeys)
+	{
+		return [self _enumerateCollectionKeysMatchingQuery:query
+		                                        usingBlock:^(int64_t __unused rowid, YapCollectionKey *ck, BOOL *stop)
+		{
+			if (block == NULL) // Query test : caller still wants BOOL result
+			{
+				*stop = YES;
+				return; // from block
+			}
+			
+			block(ck.collection, ck.key, stop);
+		}];
+	}
+	
 	BOOL result = [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t rowid, BOOL *stop) {
 		
 		if (block == NULL) // Query test : caller still wants BOOL result
@@ -1248,6 +1669,23 @@ static NSString *const ext_key_version_deprecated = @"version";
                                    usingBlock:
                             (void (^)(NSString *collection, NSString *key, id metadata, BOOL *stop))block
 {
+	if (parentConnection->parent->options.includesKeys)
+	{
+		return [self _enumerateCollectionKeysMatchingQuery:query
+		                                        usingBlock:^(int64_t rowid, YapCollectionKey *ck, BOOL *stop)
+		{
+			if (block == NULL) // Query test : caller still wants BOOL result
+			{
+				*stop = YES;
+				return; // from block
+			}
+			
+			id metadata = [databaseTransaction metadataForCollectionKey:ck withRowid:rowid];
+			
+			block(ck.collection, ck.key, metadata, stop);
+		}];
+	}
+	
 	BOOL result = [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t rowid, BOOL *stop) {
 		
 		if (block == NULL) // Query test : caller still wants BOOL result
@@ -1270,6 +1708,23 @@ static NSString *const ext_key_version_deprecated = @"version";
                                   usingBlock:
                             (void (^)(NSString *collection, NSString *key, id object, BOOL *stop))block
 {
+	if (parentConnection->parent->options.includesKeys)
+	{
+		return [self _enumerateCollectionKeysMatchingQuery:query
+		                                        usingBlock:^(int64_t rowid, YapCollectionKey *ck, BOOL *stop)
+		{
+			if (block == NULL) // Query test : caller still wants BOOL result
+			{
+				*stop = YES;
+				return; // from block
+			}
+			
+			id object = [databaseTransaction objectForCollectionKey:ck withRowid:rowid];
+			
+			block(ck.collection, ck.key, object, stop);
+		}];
+	}
+	
 	BOOL result = [self _enumerateRowidsMatchingQuery:query usingBlock:^(int64_t rowid, BOOL *stop) {
 		
 		if (block == NULL) // Query test : caller still wants BOOL result
@@ -1319,6 +1774,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 	if (query == nil) return NO;
 	if (query.isAggregateQuery) return NO;
 
+	// Write any changes which are still queued up
+
+	[self flushPendingRows];
+
 	// Create full query using given filtering clause(s)
 
 	NSString *fullQueryString =
@@ -1327,7 +1786,8 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 	// Turn query into compiled sqlite statement (using cache if possible)
 
-	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString];
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString needsFinalize:&needsFinalize];
 	if (statement == NULL)
 	{
 		return NO;
@@ -1391,8 +1851,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 					status, sqlite3_errmsg(databaseTransaction->connection->db));
 	}
 
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
+	sqlite_enum_reset(statement, needsFinalize);
 
 	if (!stop && mutation.isMutated)
 	{
@@ -1428,6 +1887,10 @@ static NSString *const ext_key_version_deprecated = @"version";
 
 - (BOOL)getNumberOfRows:(NSUInteger *)countPtr matchingQuery:(YapDatabaseQuery *)query
 {
+	// Write any changes which are still queued up
+	
+	[self flushPendingRows];
+	
 	// Create full query using given filtering clause(s)
 	
 	NSString *fullQueryString =
@@ -1436,7 +1899,8 @@ static NSString *const ext_key_version_deprecated = @"version";
 	
 	// Turn query into compiled sqlite statement (using cache if possible)
 	
-	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString];
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString needsFinalize:&needsFinalize];
 	if (statement == NULL)
 	{
 		return NO;
@@ -1463,8 +1927,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 		result = NO;
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
+	sqlite_enum_reset(statement, needsFinalize);
 	
 	if (countPtr) *countPtr = count;
 	return result;
@@ -1479,13 +1942,18 @@ static NSString *const ext_key_version_deprecated = @"version";
 	if (query == nil) return nil;
 	if (query.isAggregateQuery == NO) return nil;
 	
+	// Write any changes which are still queued up
+	
+	[self flushPendingRows];
+	
 	NSString *fullQueryString =
 	    [NSString stringWithFormat:@"SELECT %@ AS Result FROM \"%@\" %@;",
 	                                        query.aggregateFunction, [self tableName], query.queryString];
 	
 	// Turn query into compiled sqlite statement (using cache if possible)
 	
-	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString];
+	BOOL needsFinalize = NO;
+	sqlite3_stmt *statement = [self prepareQueryString:fullQueryString needsFinalize:&needsFinalize];
 	if (statement == NULL)
 	{
 		return nil;
@@ -1540,8 +2008,7 @@ static NSString *const ext_key_version_deprecated = @"version";
 		            status, sqlite3_errmsg(databaseTransaction->connection->db));
 	}
 	
-	sqlite3_clear_bindings(statement);
-	sqlite3_reset(statement);
+	sqlite_enum_reset(statement, needsFinalize);
 	
 	return result;
 }
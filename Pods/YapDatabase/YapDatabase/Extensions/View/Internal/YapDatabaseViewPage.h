@@ -15,6 +15,29 @@
 - (void)addRowid:(int64_t)rowid;
 - (void)insertRowid:(int64_t)rowid atIndex:(NSUInteger)index;
 
+/**
+ * A page may store a sort key alongside every rowid (see YapDatabaseViewSorting.sortKeyBlock).
+ * Either every rowid in the page has a sort key, or none do.
+ *
+ * Adding a rowid without a sort key (or merging in rowids from a page without sort keys)
+ * discards the sort keys of the page.
+ * Adding a rowid with a sort key to a non-empty page without sort keys simply ignores the sort key.
+**/
+- (BOOL)hasSortKeys;
+
+- (int64_t)sortKeyAtIndex:(NSUInteger)index;
+- (void)setSortKey:(int64_t)sortKey atIndex:(NSUInteger)index;
+
+- (void)addRowid:(int64_t)rowid sortKey:(int64_t)sortKey;
+- (void)insertRowid:(int64_t)rowid sortKey:(int64_t)sortKey atIndex:(NSUInteger)index;
+
+/**
+ * Binary search over the sort keys of the page (which must have sort keys).
+ * Returns the index of the first sort key that is >= (or > if upper) the given sort key,
+ * or the page count if there isn't one.
+**/
+- (NSUInteger)indexOfSortKey:(int64_t)sortKey upper:(BOOL)upper;
+
 - (void)removeRowidAtIndex:(NSUInteger)index;
 - (void)removeRange:(NSRange)range;
 - (void)removeAllRowids;
@@ -1,10 +1,12 @@
 #import "YapDatabaseViewPage.h"
+#include <algorithm>
 #include <vector>
 
 
 @implementation YapDatabaseViewPage
 {
 	std::vector<int64_t> *vector;
+	std::vector<int64_t> *sortKeys; // parallel to vector, or NULL if the page doesn't have sort keys
 }
 
 - (id)init
@@ -17,6 +19,7 @@
 	if ((self = [super init]))
 	{
 		vector = new std::vector<int64_t>();
+		sortKeys = NULL;
 		
 		if (capacity > 0)
 			vector->reserve(capacity);
@@ -30,6 +33,9 @@
 	
 	copy->vector->insert(copy->vector->begin(), vector->begin(), vector->end());
 	
+	if (sortKeys)
+		copy->sortKeys = new std::vector<int64_t>(*sortKeys);
+	
 	return copy;
 }
 
@@ -37,45 +43,238 @@
 {
 	if (vector)
 		delete vector;
+	if (sortKeys)
+		delete sortKeys;
 }
 
-- (NSData *)serialize
+- (void)discardSortKeys
 {
-	NSUInteger count = vector->size();
-	NSUInteger numBytes = count * sizeof(int64_t);
+	if (sortKeys)
+	{
+		delete sortKeys;
+		sortKeys = NULL;
+	}
+}
+
+/**
+ * Used when rowids from another page are merged into this page.
+ * An empty page simply adopts the sort keys (or lack thereof) of the other page.
+ * Otherwise the sort keys are kept only if both pages have them.
+**/
+- (BOOL)prepareToMergeFromPage:(YapDatabaseViewPage *)page
+{
+	if (vector->empty())
+	{
+		if (page->sortKeys && !sortKeys)
+			sortKeys = new std::vector<int64_t>();
+		else if (!page->sortKeys)
+			[self discardSortKeys];
+		
+		if (sortKeys)
+			sortKeys->clear();
+	}
+	else if (!page->sortKeys)
+	{
+		[self discardSortKeys];
+	}
+	
+	return (sortKeys != NULL);
+}
+
+/**
+ * Pages are serialized in a compact format:
+ *
+ * - an 8 byte header (YapDatabaseViewPage_CompactHeader)
+ * - the number of rowids, as a varint
+ * - each rowid as the (zigzag encoded) delta from the previous rowid, as a varint
+ * - if the page has sort keys (format version 2), each sort key as the (zigzag encoded) delta
+ *   from the previous sort key, as a varint
+ *
+ * Rowids within a page tend to be close together, so most deltas fit in 1-3 bytes rather than 8.
+ *
+ * The original format was simply an array of little-endian int64_t's.
+ * We still read it, and a page is rewritten in the compact format the next time it's modified.
+ * So existing views stay readable, but older builds can't read compact pages (see YAP_DATABASE_VIEW_CLASS_VERSION).
+ * The header can't be confused with the first rowid of an original page,
+ * since it's negative when read as an int64_t, and sqlite never assigns negative rowids.
+**/
+static const uint8_t YapDatabaseViewPage_CompactHeader[8] = { 'Y', 'V', 'P', 1, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static const NSUInteger YapDatabaseViewPage_VersionOffset = 3;
+static const uint8_t YapDatabaseViewPage_VersionWithSortKeys = 2;
+
+static const NSUInteger YapDatabaseViewPage_MaxVarintLength = 10;
+
+NS_INLINE uint8_t * YapDatabaseViewPage_WriteVarint(uint8_t *ptr, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		*ptr++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*ptr++ = (uint8_t)value;
 	
-	int64_t *buffer = (int64_t *)malloc(numBytes);
-	memcpy(buffer, vector->data(), numBytes);
+	return ptr;
+}
+
+NS_INLINE BOOL YapDatabaseViewPage_ReadVarint(const uint8_t **ptrPtr, const uint8_t *end, uint64_t *valuePtr)
+{
+	const uint8_t *ptr = *ptrPtr;
+	uint64_t value = 0;
+	int shift = 0;
 	
-	if (CFByteOrderGetCurrent() == CFByteOrderBigEndian)
+	while (ptr < end && shift < 64)
 	{
-		for (NSUInteger i = 0; i < count; i++)
+		uint8_t byte = *ptr++;
+		value |= ((uint64_t)(byte & 0x7F) << shift);
+		
+		if ((byte & 0x80) == 0)
 		{
-			buffer[i] = CFSwapInt64HostToLittle(buffer[i]);
+			*ptrPtr = ptr;
+			*valuePtr = value;
+			return YES;
 		}
+		shift += 7;
 	}
 	
-	return [NSData dataWithBytesNoCopy:buffer length:numBytes freeWhenDone:YES];
+	return NO; // truncated or malformed
+}
+
+NS_INLINE uint64_t YapDatabaseViewPage_ZigZagEncode(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+NS_INLINE int64_t YapDatabaseViewPage_ZigZagDecode(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static uint8_t * YapDatabaseViewPage_WriteDeltas(uint8_t *ptr, const int64_t *values, NSUInteger count)
+{
+	int64_t previous = 0;
+	
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		// Wrapping subtraction (via uint64_t) so that extreme deltas don't overflow
+		int64_t delta = (int64_t)((uint64_t)values[i] - (uint64_t)previous);
+		
+		ptr = YapDatabaseViewPage_WriteVarint(ptr, YapDatabaseViewPage_ZigZagEncode(delta));
+		previous = values[i];
+	}
+	
+	return ptr;
+}
+
+static BOOL YapDatabaseViewPage_ReadDeltas(const uint8_t **ptrPtr, const uint8_t *end,
+                                           uint64_t count, std::vector<int64_t> *values)
+{
+	// Every value takes at least one byte, which bounds the reservation for corrupt input
+	values->reserve((size_t)MIN(count, (uint64_t)(end - *ptrPtr)));
+	
+	int64_t previous = 0;
+	for (uint64_t i = 0; i < count; i++)
+	{
+		uint64_t encoded = 0;
+		if (!YapDatabaseViewPage_ReadVarint(ptrPtr, end, &encoded)) return NO;
+		
+		previous = (int64_t)((uint64_t)previous + (uint64_t)YapDatabaseViewPage_ZigZagDecode(encoded));
+		values->push_back(previous);
+	}
+	
+	return YES;
+}
+
+- (NSData *)serialize
+{
+	NSUInteger count = vector->size();
+	NSUInteger maxLength = sizeof(YapDatabaseViewPage_CompactHeader)
+	                     + ((count * (sortKeys ? 2 : 1) + 1) * YapDatabaseViewPage_MaxVarintLength);
+	
+	uint8_t *buffer = (uint8_t *)malloc(maxLength);
+	uint8_t *ptr = buffer;
+	
+	memcpy(ptr, YapDatabaseViewPage_CompactHeader, sizeof(YapDatabaseViewPage_CompactHeader));
+	if (sortKeys) {
+		ptr[YapDatabaseViewPage_VersionOffset] = YapDatabaseViewPage_VersionWithSortKeys;
+	}
+	ptr += sizeof(YapDatabaseViewPage_CompactHeader);
+	
+	ptr = YapDatabaseViewPage_WriteVarint(ptr, (uint64_t)count);
+	ptr = YapDatabaseViewPage_WriteDeltas(ptr, vector->data(), count);
+	
+	if (sortKeys) {
+		ptr = YapDatabaseViewPage_WriteDeltas(ptr, sortKeys->data(), count);
+	}
+	
+	NSUInteger length = (NSUInteger)(ptr - buffer);
+	buffer = (uint8_t *)reallocf(buffer, MAX(length, (NSUInteger)1));
+	
+	return [NSData dataWithBytesNoCopy:buffer length:length freeWhenDone:YES];
 }
 
 - (void)deserialize:(NSData *)data
 {
 	vector->clear();
+	[self discardSortKeys];
 	
-	NSUInteger count = [data length] / sizeof(int64_t);
-	int64_t *bytes = (int64_t *)[data bytes];
+	const uint8_t *bytes = (const uint8_t *)[data bytes];
+	NSUInteger length = [data length];
 	
-	if (vector->capacity() < count)
-		vector->reserve(count);
+	uint8_t version = 0;
+	if (length >= sizeof(YapDatabaseViewPage_CompactHeader))
+	{
+		version = bytes[YapDatabaseViewPage_VersionOffset];
+		
+		BOOL isCompact =
+		  (version == 1 || version == YapDatabaseViewPage_VersionWithSortKeys) &&
+		  memcmp(bytes, YapDatabaseViewPage_CompactHeader, YapDatabaseViewPage_VersionOffset) == 0 &&
+		  memcmp(bytes + YapDatabaseViewPage_VersionOffset + 1,
+		         YapDatabaseViewPage_CompactHeader + YapDatabaseViewPage_VersionOffset + 1,
+		         sizeof(YapDatabaseViewPage_CompactHeader) - YapDatabaseViewPage_VersionOffset - 1) == 0;
+		
+		if (!isCompact) version = 0;
+	}
 	
-	for (NSUInteger i = 0; i < count; i++)
+	if (version > 0)
+	{
+		const uint8_t *ptr = bytes + sizeof(YapDatabaseViewPage_CompactHeader);
+		const uint8_t *end = bytes + length;
+		
+		uint64_t count = 0;
+		if (!YapDatabaseViewPage_ReadVarint(&ptr, end, &count)) return;
+		
+		if (!YapDatabaseViewPage_ReadDeltas(&ptr, end, count, vector)) return;
+		
+		if (version == YapDatabaseViewPage_VersionWithSortKeys)
+		{
+			sortKeys = new std::vector<int64_t>();
+			
+			if (!YapDatabaseViewPage_ReadDeltas(&ptr, end, count, sortKeys))
+			{
+				// Truncated sort keys are useless, but the rowids are still good
+				[self discardSortKeys];
+			}
+		}
+	}
+	else
 	{
-		int64_t rowid = bytes[i];
+		// Original format
+		
+		NSUInteger count = length / sizeof(int64_t);
+		
+		if (count == 0) return;
+		
+		vector->resize(count);
+		memcpy(vector->data(), bytes, count * sizeof(int64_t));
 		
 		if (CFByteOrderGetCurrent() == CFByteOrderBigEndian)
-			vector->push_back(CFSwapInt64LittleToHost(rowid));
-		else
-			vector->push_back(rowid);
+		{
+			for (NSUInteger i = 0; i < count; i++)
+			{
+				(*vector)[i] = CFSwapInt64LittleToHost((*vector)[i]);
+			}
+		}
 	}
 }
 
@@ -91,17 +290,73 @@
 
 - (void)addRowid:(int64_t)rowid
 {
+	[self discardSortKeys];
 	vector->push_back(rowid);
 }
 
 - (void)insertRowid:(int64_t)rowid atIndex:(NSUInteger)index
 {
+	[self discardSortKeys];
+	vector->insert(vector->begin() + index, rowid);
+}
+
+- (BOOL)hasSortKeys
+{
+	return (sortKeys != NULL);
+}
+
+- (int64_t)sortKeyAtIndex:(NSUInteger)index
+{
+	return sortKeys->at(index);
+}
+
+- (void)setSortKey:(int64_t)sortKey atIndex:(NSUInteger)index
+{
+	if (sortKeys)
+		sortKeys->at(index) = sortKey;
+}
+
+- (void)addRowid:(int64_t)rowid sortKey:(int64_t)sortKey
+{
+	if (vector->empty() && !sortKeys)
+		sortKeys = new std::vector<int64_t>();
+	
+	if (sortKeys)
+		sortKeys->push_back(sortKey);
+	
+	vector->push_back(rowid);
+}
+
+- (void)insertRowid:(int64_t)rowid sortKey:(int64_t)sortKey atIndex:(NSUInteger)index
+{
+	if (vector->empty() && !sortKeys)
+		sortKeys = new std::vector<int64_t>();
+	
+	if (sortKeys)
+		sortKeys->insert(sortKeys->begin() + index, sortKey);
+	
 	vector->insert(vector->begin() + index, rowid);
 }
 
+- (NSUInteger)indexOfSortKey:(int64_t)sortKey upper:(BOOL)upper
+{
+	NSAssert(sortKeys != NULL, @"Page doesn't have sort keys");
+	
+	// A plain binary search over contiguous int64_t's (which the compiler is free to vectorize).
+	
+	std::vector<int64_t>::iterator it = upper
+	  ? std::upper_bound(sortKeys->begin(), sortKeys->end(), sortKey)
+	  : std::lower_bound(sortKeys->begin(), sortKeys->end(), sortKey);
+	
+	return (NSUInteger)(it - sortKeys->begin());
+}
+
 - (void)removeRowidAtIndex:(NSUInteger)index
 {
 	vector->erase(vector->begin() + index);
+	
+	if (sortKeys)
+		sortKeys->erase(sortKeys->begin() + index);
 }
 
 - (void)removeRange:(NSRange)range
@@ -109,25 +364,42 @@
 	std::vector<int64_t>::iterator it = vector->begin();
 	
 	vector->erase(it+range.location, it+range.location+range.length);
+	
+	if (sortKeys)
+	{
+		std::vector<int64_t>::iterator keyIt = sortKeys->begin();
+		
+		sortKeys->erase(keyIt+range.location, keyIt+range.location+range.length);
+	}
 }
 
 - (void)removeAllRowids
 {
 	vector->clear();
+	
+	if (sortKeys)
+		sortKeys->clear();
 }
 
 - (void)appendPage:(YapDatabaseViewPage *)page
 {
-	vector->insert(vector->end(), page->vector->begin(), page->vector->end());
+	[self appendRange:NSMakeRange(0, page->vector->size()) ofPage:page];
 }
 
 - (void)prependPage:(YapDatabaseViewPage *)page
 {
-	vector->insert(vector->begin(), page->vector->begin(), page->vector->end());
+	[self prependRange:NSMakeRange(0, page->vector->size()) ofPage:page];
 }
 
 - (void)appendRange:(NSRange)range ofPage:(YapDatabaseViewPage *)page
 {
+	if ([self prepareToMergeFromPage:page])
+	{
+		std::vector<int64_t>::iterator keysBegin = page->sortKeys->begin() + range.location;
+		
+		sortKeys->insert(sortKeys->end(), keysBegin, keysBegin + range.length);
+	}
+	
 	std::vector<int64_t>::iterator rangeBegin = page->vector->begin();
 	std::vector<int64_t>::iterator rangeEnd;
 	
@@ -139,6 +411,13 @@
 
 - (void)prependRange:(NSRange)range ofPage:(YapDatabaseViewPage *)page
 {
+	if ([self prepareToMergeFromPage:page])
+	{
+		std::vector<int64_t>::iterator keysBegin = page->sortKeys->begin() + range.location;
+		
+		sortKeys->insert(sortKeys->begin(), keysBegin, keysBegin + range.length);
+	}
+	
 	std::vector<int64_t>::iterator rangeBegin = page->vector->begin();
 	std::vector<int64_t>::iterator rangeEnd;
 	
@@ -297,7 +576,10 @@
 	
 	while (iterator != end)
 	{
-		[string appendFormat:@"  %lu: %lld\n", (unsigned long)index, *iterator];
+		if (sortKeys)
+			[string appendFormat:@"  %lu: %lld (sortKey %lld)\n", (unsigned long)index, *iterator, (*sortKeys)[index]];
+		else
+			[string appendFormat:@"  %lu: %lld\n", (unsigned long)index, *iterator];
 		
 		iterator++;
 		index++;
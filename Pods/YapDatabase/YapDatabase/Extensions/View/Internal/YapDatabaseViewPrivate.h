@@ -23,6 +23,10 @@
  * This version number is stored in the yap2 table.
  * If there is a major re-write to this class, then the version number will be incremented,
  * and the class can automatically rebuild the tables as needed.
+ *
+ * It wasn't bumped for the compact page format (see YapDatabaseViewPage.mm), since pages in the original format
+ * are still read, and existing views needn't be rebuilt. But a build from before the compact format can't read
+ * its pages, and wouldn't know to rebuild the view either. Downgrading requires changing every view's versionTag.
 **/
 #define YAP_DATABASE_VIEW_CLASS_VERSION 3
 
@@ -58,6 +62,15 @@ static NSString *const changeset_key_versionTag = @"versionTag";
 
 static NSString *const changeset_key_changes    = @"changes";
 
+/**
+ * Keys for savepoint state dictionary, in addition to the changeset keys above.
+**/
+
+static NSString *const savepoint_key_newPageKeys       = @"newPageKeys";
+static NSString *const savepoint_key_dirtyLinks        = @"dirtyLinks";
+static NSString *const savepoint_key_mutatedGroups     = @"mutatedGroups";
+static NSString *const savepoint_key_versionTagChanged = @"versionTagChanged";
+
 
 @interface YapDatabaseView () {
 @protected
@@ -128,6 +141,9 @@ static NSString *const changeset_key_changes    = @"changes";
 - (NSArray *)internalChangesetKeys;
 - (NSArray *)externalChangesetKeys;
 
+- (NSMutableDictionary *)savepointState;
+- (void)rollbackToSavepointState:(NSDictionary *)savepointState;
+
 - (void)prepareStatement:(sqlite3_stmt **)statement withString:(NSString *)stmtString caller:(SEL)caller_cmd;
 
 - (sqlite3_stmt *)mapTable_getPageKeyForRowidStatement;
@@ -162,6 +178,7 @@ static NSString *const changeset_key_changes    = @"changes";
 	__unsafe_unretained YapDatabaseReadTransaction *databaseTransaction;
 	
 	BOOL isRepopulate;
+	BOOL isBatchPopulate;
 }
 
 - (instancetype)initWithParentConnection:(YapDatabaseViewConnection *)parentConnection
@@ -171,6 +188,7 @@ static NSString *const changeset_key_changes    = @"changes";
 
 - (BOOL)createTables;
 - (BOOL)populateView;
+- (BOOL)populateViewOrBeginBatchedPopulation;
 
 - (NSString *)registeredName;
 - (BOOL)isPersistentView;
@@ -199,12 +217,28 @@ static NSString *const changeset_key_changes    = @"changes";
 
 - (BOOL)getRowid:(int64_t *)rowidPtr atIndex:(NSUInteger)index inGroup:(NSString *)group;
 
+- (BOOL)getSortKey:(int64_t *)sortKeyPtr atIndex:(NSUInteger)index inGroup:(NSString *)group;
+- (BOOL)getIndex:(NSUInteger *)indexPtr ofSortKey:(int64_t)sortKey upper:(BOOL)upper inGroup:(NSString *)group;
+
 // Logic - ReadWrite
 
 - (void)insertRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey
                                          inGroup:(NSString *)group
                                          atIndex:(NSUInteger)index;
 
+- (void)insertRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey
+                                         sortKey:(const int64_t *)sortKeyPtr
+                                         inGroup:(NSString *)group
+                                         atIndex:(NSUInteger)index;
+
+- (void)insertRowids:(const int64_t *)rowids
+            sortKeys:(const int64_t *)sortKeys
+      collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+               count:(NSUInteger)count
+        intoNewGroup:(NSString *)group;
+
+- (void)setSortKey:(int64_t)sortKey forRowid:(int64_t)rowid withLocator:(YapDatabaseViewLocator *)locator;
+
 - (void)removeRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey;
 
 - (void)removeRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey
@@ -141,6 +141,118 @@
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Savepoints
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns everything a block of a group commit may change in memory, for rollbackToSavepointState:.
+ * (Nothing is written to our tables until the transaction is committed.)
+ *
+ * The state, the dirty pages & the dirty maps are modified in place, so they're copied.
+ * The caches are modified in place too, but they're simply cleared on rollback instead.
+**/
+- (NSMutableDictionary *)savepointState
+{
+	YDBLogAutoTrace();
+	
+	NSMutableDictionary *savepointState = [NSMutableDictionary dictionaryWithCapacity:10];
+	
+	if (state)
+	{
+		savepointState[changeset_key_state] = [state mutableCopy];
+		
+		// The copied metadata doesn't carry the isNew flag,
+		// which is what tells us to insert (rather than update) the page's row.
+		
+		NSMutableSet *newPageKeys = [NSMutableSet set];
+		[state enumerateWithBlock:^(NSString __unused *group, NSArray *pagesMetadata, BOOL __unused *stop) {
+			
+			for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadata)
+			{
+				if (pageMetadata->isNew)
+					[newPageKeys addObject:pageMetadata->pageKey];
+			}
+		}];
+		
+		savepointState[savepoint_key_newPageKeys] = newPageKeys;
+	}
+	
+	NSMutableDictionary *dirtyPagesCopy = [NSMutableDictionary dictionaryWithCapacity:[dirtyPages count]];
+	[dirtyPages enumerateKeysAndObjectsUsingBlock:^(NSString *pageKey, id page, BOOL __unused *stop) {
+		
+		// The page may be NSNull, if it was removed.
+		dirtyPagesCopy[pageKey] = [page copy];
+	}];
+	
+	savepointState[changeset_key_dirtyPages] = dirtyPagesCopy;
+	savepointState[changeset_key_dirtyMaps] = [dirtyMaps copy] ?: [[YapDirtyDictionary alloc] init];
+	savepointState[savepoint_key_dirtyLinks] = [dirtyLinks allKeys] ?: @[];
+	savepointState[changeset_key_reset] = @(reset);
+	
+	savepointState[changeset_key_changes] = [changes copy] ?: @[];
+	savepointState[savepoint_key_mutatedGroups] = [mutatedGroups copy] ?: [NSSet set];
+	
+	if (versionTag)
+		savepointState[changeset_key_versionTag] = versionTag;
+	savepointState[savepoint_key_versionTagChanged] = @(versionTagChanged);
+	
+	return savepointState;
+}
+
+- (void)rollbackToSavepointState:(NSDictionary *)savepointState
+{
+	YDBLogAutoTrace();
+	
+	state = savepointState[changeset_key_state];
+	
+	NSSet *newPageKeys = savepointState[savepoint_key_newPageKeys];
+	if ([newPageKeys count] > 0)
+	{
+		[state enumerateWithBlock:^(NSString __unused *group, NSArray *pagesMetadata, BOOL __unused *stop) {
+			
+			for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadata)
+			{
+				if ([newPageKeys containsObject:pageMetadata->pageKey])
+					pageMetadata->isNew = YES;
+			}
+		}];
+	}
+	
+	// The caches may hold pages & page keys written by the rolled back block.
+	// Everything else is found in the dirty pages & maps, or in our tables (which the savepoint took care of).
+	
+	[mapCache removeAllObjects];
+	[pageCache removeAllObjects];
+	
+	dirtyPages = [savepointState[changeset_key_dirtyPages] mutableCopy];
+	dirtyMaps = savepointState[changeset_key_dirtyMaps];
+	reset = [savepointState[changeset_key_reset] boolValue];
+	
+	// The dirty links point at metadata within the state, so they're looked up in the restored state.
+	
+	[dirtyLinks removeAllObjects];
+	for (NSString *pageKey in savepointState[savepoint_key_dirtyLinks])
+	{
+		NSString *group = [state groupForPageKey:pageKey];
+		
+		for (YapDatabaseViewPageMetadata *pageMetadata in [state pagesMetadataForGroup:group])
+		{
+			if ([pageMetadata->pageKey isEqualToString:pageKey])
+			{
+				[dirtyLinks setObject:pageMetadata forKey:pageKey];
+				break;
+			}
+		}
+	}
+	
+	[changes setArray:savepointState[changeset_key_changes]];
+	[mutatedGroups setSet:savepointState[savepoint_key_mutatedGroups]];
+	
+	versionTag = savepointState[changeset_key_versionTag];
+	versionTagChanged = [savepointState[savepoint_key_versionTagChanged] boolValue];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Changeset Architecture
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -73,7 +73,7 @@
 		
 		if (!parentConnection->parent->options.skipInitialViewPopulation)
 		{
-			if (![self populateView]) return NO;
+			if (![self populateViewOrBeginBatchedPopulation]) return NO;
 		}
 		
 		// Store initial versionTag in prefs table
@@ -180,7 +180,7 @@
 			if (parentConnection->state == nil)
 				parentConnection->state = [[YapDatabaseViewState alloc] init];
 			
-			if (![self populateView]) return NO;
+			if (![self populateViewOrBeginBatchedPopulation]) return NO;
 		}
 		
 		// Update yap2 table values (if needed)
@@ -626,6 +626,26 @@
 	return NO;
 }
 
+/**
+ * If the view was registered with a populationBatchSize (and the subclass supports it),
+ * then the view is emptied here, and populated afterwards in batches.
+ * Otherwise the view is populated now, within the registration transaction.
+**/
+- (BOOL)populateViewOrBeginBatchedPopulation
+{
+	if ([self populatesInBatches])
+	{
+		[self removeAllRowids];
+		[self beginBatchedPopulation];
+		
+		return YES;
+	}
+	else
+	{
+		return [self populateView];
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Accessors
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1172,6 +1192,106 @@
 	return found;
 }
 
+/**
+ * Returns NO if there's no such index, or if the page containing it doesn't have sort keys.
+ * See YapDatabaseViewSorting.sortKeyBlock.
+**/
+- (BOOL)getSortKey:(int64_t *)sortKeyPtr atIndex:(NSUInteger)index inGroup:(NSString *)group
+{
+	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
+	NSUInteger pageOffset = 0;
+	
+	for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadataForGroup)
+	{
+		if ((index < (pageOffset + pageMetadata->count)) && (pageMetadata->count > 0))
+		{
+			YapDatabaseViewPage *page = [self pageForPageKey:pageMetadata->pageKey];
+			
+			if ([page hasSortKeys])
+			{
+				if (sortKeyPtr) *sortKeyPtr = [page sortKeyAtIndex:(index - pageOffset)];
+				return YES;
+			}
+			
+			break;
+		}
+		else
+		{
+			pageOffset += pageMetadata->count;
+		}
+	}
+	
+	if (sortKeyPtr) *sortKeyPtr = 0;
+	return NO;
+}
+
+/**
+ * Returns the index of the first row in the group whose sort key is >= (or > if upper) the given sort key.
+ * 
+ * This is a binary search over the pages (using the last sort key of each page),
+ * followed by a binary search within a single page.
+ * So only log(pages) pages are loaded, and no objects are.
+ * 
+ * Returns NO if any page that needed to be inspected doesn't have sort keys.
+**/
+- (BOOL)getIndex:(NSUInteger *)indexPtr ofSortKey:(int64_t)sortKey upper:(BOOL)upper inGroup:(NSString *)group
+{
+	NSArray *pagesMetadataForGroup = [parentConnection->state pagesMetadataForGroup:group];
+	
+	// Skip empty pages (which only exist mid-transaction), so the binary search only sees pages with a last key.
+	
+	NSMutableArray<YapDatabaseViewPageMetadata *> *pages =
+	  [[NSMutableArray alloc] initWithCapacity:[pagesMetadataForGroup count]];
+	
+	for (YapDatabaseViewPageMetadata *pageMetadata in pagesMetadataForGroup)
+	{
+		if (pageMetadata->count > 0)
+			[pages addObject:pageMetadata];
+	}
+	
+	NSUInteger min = 0;
+	NSUInteger max = [pages count];
+	
+	YapDatabaseViewPage *foundPage = nil;
+	
+	while (min < max)
+	{
+		NSUInteger mid = (min + max) / 2;
+		
+		YapDatabaseViewPageMetadata *pageMetadata = pages[mid];
+		YapDatabaseViewPage *page = [self pageForPageKey:pageMetadata->pageKey];
+		
+		if (![page hasSortKeys]) return NO;
+		
+		int64_t lastSortKey = [page sortKeyAtIndex:([page count] - 1)];
+		BOOL pageIsBefore = upper ? (lastSortKey <= sortKey) : (lastSortKey < sortKey);
+		
+		if (pageIsBefore)
+		{
+			min = mid + 1;
+		}
+		else
+		{
+			max = mid;
+			foundPage = page;
+		}
+	}
+	
+	NSUInteger index = 0;
+	for (NSUInteger i = 0; i < min; i++)
+	{
+		index += pages[i]->count;
+	}
+	
+	if (foundPage)
+	{
+		index += [foundPage indexOfSortKey:sortKey upper:upper];
+	}
+	
+	if (indexPtr) *indexPtr = index;
+	return YES;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Logic - ReadWrite
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1189,6 +1309,18 @@
 - (void)insertRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey
                                          inGroup:(NSString *)group
                                          atIndex:(NSUInteger)index
+{
+	[self insertRowid:rowid collectionKey:collectionKey sortKey:NULL inGroup:group atIndex:index];
+}
+
+/**
+ * Same as above, but also stores the sort key of the row in its page (if sortKeyPtr is non-NULL).
+ * See YapDatabaseViewSorting.sortKeyBlock.
+**/
+- (void)insertRowid:(int64_t)rowid collectionKey:(YapCollectionKey *)collectionKey
+                                         sortKey:(const int64_t *)sortKeyPtr
+                                         inGroup:(NSString *)group
+                                         atIndex:(NSUInteger)index
 {
 	YDBLogAutoTrace();
 	
@@ -1214,7 +1346,11 @@
 		
 		YapDatabaseViewPage *page =
 		  [[YapDatabaseViewPage alloc] initWithCapacity:YAP_DATABASE_VIEW_MAX_PAGE_SIZE];
-		[page addRowid:rowid];
+		
+		if (sortKeyPtr)
+			[page addRowid:rowid sortKey:*sortKeyPtr];
+		else
+			[page addRowid:rowid];
 		
 		// Create pageMetadata
 		
@@ -1306,7 +1442,10 @@
 		
 		// Update page (insert rowid)
 		
-		[page insertRowid:rowid atIndex:(index - pageOffset)];
+		if (sortKeyPtr)
+			[page insertRowid:rowid sortKey:*sortKeyPtr atIndex:(index - pageOffset)];
+		else
+			[page insertRowid:rowid atIndex:(index - pageOffset)];
 		
 		// Update pageMetadata (increment count)
 		
@@ -1346,6 +1485,123 @@
 	}
 }
 
+/**
+ * This is an internal method that modifies the underlying structures that hold the arrays of rowids.
+ * These structures are meant to be private, and knowledge of how they work shouldn't be required by subclasses.
+ *
+ * Bulk version of insertRowid:collectionKey:sortKey:inGroup:atIndex:, for use when populating a view.
+ * The rowids must already be in their final (sorted) order, and the group must not exist yet.
+ * The sortKeys are optional (may be NULL).
+ * Rather than inserting each rowid into an existing page (and later splitting oversized pages),
+ * this method writes out full pages directly.
+**/
+- (void)insertRowids:(const int64_t *)rowids
+            sortKeys:(const int64_t *)sortKeys
+      collectionKeys:(NSArray<YapCollectionKey *> *)collectionKeys
+               count:(NSUInteger)count
+        intoNewGroup:(NSString *)group
+{
+	YDBLogAutoTrace();
+	
+	NSParameterAssert(group != nil);
+	NSParameterAssert([collectionKeys count] == count);
+	NSAssert([parentConnection->state pagesMetadataForGroup:group] == nil, @"Group(%@) already exists", group);
+	
+	if (count == 0) return;
+	
+	NSUInteger maxPageSize = YAP_DATABASE_VIEW_MAX_PAGE_SIZE;
+	NSUInteger pageCount = (count + maxPageSize - 1) / maxPageSize;
+	
+	YDBLogVerbose(@"Inserting %lu keys in new group(%@) with %lu pages",
+	              (unsigned long)count, group, (unsigned long)pageCount);
+	
+	[parentConnection->state createGroup:group withCapacity:pageCount];
+	
+	[parentConnection->changes addObject:
+	  [YapDatabaseViewSectionChange insertGroup:group]];
+	
+	NSString *prevPageKey = nil;
+	NSUInteger index = 0;
+	
+	while (index < count)
+	{
+		NSUInteger pageSize = MIN(maxPageSize, count - index);
+		
+		NSString *pageKey = [self generatePageKey];
+		YapDatabaseViewPage *page = [[YapDatabaseViewPage alloc] initWithCapacity:maxPageSize];
+		
+		for (NSUInteger i = index; i < (index + pageSize); i++)
+		{
+			int64_t rowid = rowids[i];
+			
+			if (sortKeys)
+				[page addRowid:rowid sortKey:sortKeys[i]];
+			else
+				[page addRowid:rowid];
+			
+			// Mark map as dirty.
+			// We skip the mapCache here, as the dirtyMaps are consulted first,
+			// and a large population would only churn the cache.
+			
+			[parentConnection->dirtyMaps setObject:pageKey forKey:@(rowid) withPreviousValue:nil];
+			
+			// Add change to log
+			
+			[parentConnection->changes addObject:
+			  [YapDatabaseViewRowChange insertCollectionKey:collectionKeys[i] inGroup:group atIndex:i]];
+		}
+		
+		// Create pageMetadata
+		
+		YapDatabaseViewPageMetadata *pageMetadata = [[YapDatabaseViewPageMetadata alloc] init];
+		pageMetadata->pageKey = pageKey;
+		pageMetadata->prevPageKey = prevPageKey;
+		pageMetadata->group = group;
+		pageMetadata->count = pageSize;
+		pageMetadata->isNew = YES;
+		
+		[parentConnection->state addPageMetadata:pageMetadata toGroup:group];
+		
+		// Mark page as dirty
+		
+		[parentConnection->dirtyPages setObject:page forKey:pageKey];
+		[parentConnection->pageCache setObject:page forKey:pageKey];
+		
+		prevPageKey = pageKey;
+		index += pageSize;
+	}
+	
+	[parentConnection->mutatedGroups addObject:group];
+}
+
+/**
+ * Updates the stored sort key of a row which isn't changing position (e.g. an updated object).
+ * Does nothing if the page doesn't have sort keys, or if the sort key hasn't changed.
+**/
+- (void)setSortKey:(int64_t)sortKey forRowid:(int64_t)rowid withLocator:(YapDatabaseViewLocator *)locator
+{
+	YDBLogAutoTrace();
+	
+	NSString *pageKey = locator.pageKey ?: [self pageKeyForRowid:rowid];
+	if (pageKey == nil) return;
+	
+	YapDatabaseViewPage *page = [self pageForPageKey:pageKey];
+	
+	if (![page hasSortKeys]) return;
+	
+	NSUInteger indexWithinPage = 0;
+	if (![page getIndex:&indexWithinPage ofRowid:rowid]) return;
+	
+	if ([page sortKeyAtIndex:indexWithinPage] == sortKey) return;
+	
+	[page setSortKey:sortKey atIndex:indexWithinPage];
+	
+	// Mark page as dirty
+	
+	[parentConnection->dirtyPages setObject:page forKey:pageKey];
+	[parentConnection->pageCache setObject:page forKey:pageKey];
+}
+
 /**
  * This is an internal method that modifies the underlying structures that hold the arrays of rowids.
  * These structures are meant to be private, and knowledge of how they work shouldn't be required by subclasses.
@@ -2537,6 +2793,27 @@
 	databaseTransaction = nil; // Do not remove !
 }
 
+/**
+ * A persistent view only writes to its tables when the transaction is committed,
+ * so everything a block may change is held by the connection, which takes care of the savepoint state.
+ *
+ * The memory tables of a non-persistent view can't be rolled back to a savepoint.
+**/
+- (BOOL)supportsSavepoints
+{
+	return [self isPersistentView];
+}
+
+- (id)savepointState
+{
+	return [parentConnection savepointState];
+}
+
+- (void)rollbackToSavepointState:(id)state
+{
+	[parentConnection rollbackToSavepointState:(NSDictionary *)state];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Public API - Groups
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,96 @@
+#import <Foundation/Foundation.h>
+
+#import "YapCollectionKey.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_OPTIONS(uint8_t, YapCompactChangesetFlags) {
+	YapCompactChangesetFlags_ObjectChanged   = 1 << 0,
+	YapCompactChangesetFlags_MetadataChanged = 1 << 1,
+	YapCompactChangesetFlags_Removed         = 1 << 2,
+};
+
+/**
+ * An immutable summary of the rows changed by a single read-write transaction.
+ *
+ * It's built once, when the transaction commits, and the same instance is then handed to every other connection
+ * (within the internal changeset), as well as to the YapDatabaseModifiedNotification.
+ * It only references the collection/key tuples, never the objects or metadata,
+ * so holding on to a notification doesn't keep the changed objects alive.
+ *
+ * The changes are stored as a single array, sorted by rowid, with bitflags describing what happened to each row.
+ * A key that was removed & then inserted again has 2 rows: the old one is removed, the new one changed.
+ * A second array of indexes, sorted by collection & key, answers per-key and per-collection questions
+ * with a binary search, rather than by iterating every changed key.
+ *
+ * Rows removed via removeAllObjectsInCollection: may not have a collection/key tuple.
+ * Their collection is reported by didRemoveCollection: instead.
+**/
+@interface YapCompactChangeset : NSObject
+
+/**
+ * changedRowids maps the rowid of every row that was changed or removed to its collection/key tuple.
+ * The other parameters are the read-write transaction's changeset variables.
+**/
+- (instancetype)initWithChangedRowids:(nullable NSDictionary<NSNumber *, YapCollectionKey *> *)changedRowids
+                        objectChanges:(nullable NSDictionary *)objectChanges
+                      metadataChanges:(nullable NSDictionary *)metadataChanges
+                        removedRowids:(nullable NSSet<NSNumber *> *)removedRowids
+                   removedCollections:(nullable NSSet<NSString *> *)removedCollections
+                       allKeysRemoved:(BOOL)allKeysRemoved;
+
+/**
+ * The number of distinct collection/key tuples that were changed or removed.
+**/
+@property (nonatomic, readonly) NSUInteger count;
+
+/**
+ * The union of the flags of every collection/key tuple.
+**/
+@property (nonatomic, readonly) YapCompactChangesetFlags flags;
+
+/**
+ * Whether removeAllObjectsInAllCollections was invoked.
+**/
+@property (nonatomic, readonly) BOOL allKeysRemoved;
+
+/**
+ * Returns what happened to the given collection/key tuple (zero if it wasn't changed).
+ * This doesn't take removed collections into account.
+**/
+- (YapCompactChangesetFlags)flagsForCollectionKey:(YapCollectionKey *)collectionKey;
+
+/**
+ * Returns the union of the flags of every changed collection/key tuple in the collection.
+ * This doesn't take removed collections into account.
+**/
+- (YapCompactChangesetFlags)flagsForCollection:(NSString *)collection;
+
+/**
+ * Whether removeAllObjectsInCollection: was invoked for the collection.
+**/
+- (BOOL)didRemoveCollection:(NSString *)collection;
+
+- (BOOL)hasRemovedCollections;
+
+/**
+ * Enumerates the rowids of the removed rows, in ascending order.
+**/
+- (void)enumerateRemovedRowidsUsingBlock:(void (^)(int64_t rowid, BOOL *stop))block;
+
+/**
+ * Enumerates each changed collection/key tuple once, grouped by collection.
+**/
+- (void)enumerateCollectionKeysUsingBlock:
+    (void (^)(YapCollectionKey *collectionKey, YapCompactChangesetFlags flags, BOOL *stop))block;
+
+/**
+ * Enumerates each changed collection/key tuple within the collection once.
+**/
+- (void)enumerateCollectionKeysInCollection:(NSString *)collection
+                                 usingBlock:
+    (void (^)(YapCollectionKey *collectionKey, YapCompactChangesetFlags flags, BOOL *stop))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
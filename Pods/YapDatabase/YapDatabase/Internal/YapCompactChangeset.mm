@@ -0,0 +1,370 @@
+#import "YapCompactChangeset.h"
+
+#include <algorithm>
+#include <vector>
+
+#if ! __has_feature(objc_arc)
+#warning This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+/**
+ * One per changed or removed row, sorted by rowid.
+ *
+ * Since sqlite hands out rowids in ascending order, the rows of a transaction are mostly in order already.
+ * The collection/key tuples are owned by the changedRowids dictionary, which we retain.
+**/
+struct YapCompactChangesetRow {
+	int64_t rowid;
+	__unsafe_unretained YapCollectionKey *collectionKey; // nil if unknown (removeAllObjectsInCollection:)
+	uint8_t flags;
+};
+
+/**
+ * One per row with a known collection/key tuple, sorted by (collection hash, collection, key hash, key).
+ * So every collection is a contiguous run, and both rows of a key that was removed & inserted again are adjacent.
+**/
+struct YapCompactChangesetKeyRef {
+	NSUInteger collectionHash;
+	NSUInteger keyHash;
+	uint32_t row;
+};
+
+/**
+ * One per collection, sorted by (hash, collection).
+**/
+struct YapCompactChangesetCollection {
+	NSUInteger hash;
+	__unsafe_unretained NSString *collection;
+	uint32_t start; // index of its first YapCompactChangesetKeyRef
+	uint32_t count;
+	uint8_t flags;
+	bool removed;
+};
+
+NS_INLINE int YapCompactChangesetCompareStrings(__unsafe_unretained NSString *a, __unsafe_unretained NSString *b)
+{
+	if (a == b) return 0;
+
+	return (int)[a compare:b options:NSLiteralSearch];
+}
+
+NS_INLINE BOOL YapCompactChangesetEqualStrings(__unsafe_unretained NSString *a, __unsafe_unretained NSString *b)
+{
+	return (a == b) || [a isEqualToString:b];
+}
+
+
+@implementation YapCompactChangeset
+{
+	NSDictionary *changedRowids;
+	NSSet *removedCollections;
+
+	std::vector<YapCompactChangesetRow> rows;
+	std::vector<YapCompactChangesetKeyRef> keyRefs;
+	std::vector<YapCompactChangesetCollection> collections;
+
+	NSUInteger count;
+	YapCompactChangesetFlags flags;
+	BOOL allKeysRemoved;
+}
+
+@synthesize count = count;
+@synthesize flags = flags;
+@synthesize allKeysRemoved = allKeysRemoved;
+
+- (instancetype)initWithChangedRowids:(NSDictionary *)inChangedRowids
+                        objectChanges:(NSDictionary *)objectChanges
+                      metadataChanges:(NSDictionary *)metadataChanges
+                        removedRowids:(NSSet *)removedRowids
+                   removedCollections:(NSSet *)inRemovedCollections
+                       allKeysRemoved:(BOOL)inAllKeysRemoved
+{
+	if ((self = [super init]))
+	{
+		// The connection only hands off (and stops mutating) the non-empty ones.
+		// It keeps using the empty ones, so we mustn't hold on to those.
+
+		changedRowids = ([inChangedRowids count] > 0) ? inChangedRowids : nil;
+		removedCollections = ([inRemovedCollections count] > 0) ? inRemovedCollections : nil;
+		allKeysRemoved = inAllKeysRemoved;
+
+		rows.reserve([changedRowids count] + [removedRowids count]);
+
+		// Rows with a collection/key tuple.
+		//
+		// A row that was changed, and then removed, only counts as removed.
+		// A row without any flags belonged to a collection that was removed afterwards.
+
+		[changedRowids enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL __unused *stop) {
+
+			__unsafe_unretained NSNumber *rowidNumber = (NSNumber *)key;
+			__unsafe_unretained YapCollectionKey *collectionKey = (YapCollectionKey *)obj;
+
+			uint8_t rowFlags = 0;
+			if ([removedRowids containsObject:rowidNumber])
+			{
+				rowFlags = YapCompactChangesetFlags_Removed;
+			}
+			else
+			{
+				if ([objectChanges objectForKey:collectionKey])
+					rowFlags |= YapCompactChangesetFlags_ObjectChanged;
+				if ([metadataChanges objectForKey:collectionKey])
+					rowFlags |= YapCompactChangesetFlags_MetadataChanged;
+			}
+
+			if (rowFlags != 0)
+			{
+				rows.push_back({ [rowidNumber longLongValue], collectionKey, rowFlags });
+			}
+		}];
+
+		// Removed rows without a collection/key tuple.
+
+		for (NSNumber *rowidNumber in removedRowids)
+		{
+			if ([changedRowids objectForKey:rowidNumber] == nil)
+			{
+				rows.push_back({ [rowidNumber longLongValue], nil, YapCompactChangesetFlags_Removed });
+			}
+		}
+
+		std::sort(rows.begin(), rows.end(),
+		  [](const YapCompactChangesetRow &a, const YapCompactChangesetRow &b){ return a.rowid < b.rowid; });
+
+		[self buildKeyRefs];
+		[self buildCollections];
+	}
+	return self;
+}
+
+- (void)buildKeyRefs
+{
+	keyRefs.reserve(rows.size());
+
+	for (uint32_t i = 0; i < (uint32_t)rows.size(); i++)
+	{
+		__unsafe_unretained YapCollectionKey *collectionKey = rows[i].collectionKey;
+		if (collectionKey == nil) continue;
+
+		keyRefs.push_back({ [collectionKey.collection hash], [collectionKey.key hash], i });
+	}
+
+	const std::vector<YapCompactChangesetRow> &sortedRows = rows;
+
+	std::sort(keyRefs.begin(), keyRefs.end(),
+	  [&sortedRows](const YapCompactChangesetKeyRef &a, const YapCompactChangesetKeyRef &b)
+	{
+		if (a.collectionHash != b.collectionHash) return a.collectionHash < b.collectionHash;
+
+		__unsafe_unretained YapCollectionKey *ckA = sortedRows[a.row].collectionKey;
+		__unsafe_unretained YapCollectionKey *ckB = sortedRows[b.row].collectionKey;
+
+		int cmp = YapCompactChangesetCompareStrings(ckA.collection, ckB.collection);
+		if (cmp != 0) return cmp < 0;
+
+		if (a.keyHash != b.keyHash) return a.keyHash < b.keyHash;
+
+		cmp = YapCompactChangesetCompareStrings(ckA.key, ckB.key);
+		if (cmp != 0) return cmp < 0;
+
+		return a.row < b.row;
+	});
+
+	// Count the distinct collection/key tuples.
+
+	for (size_t i = 0; i < keyRefs.size(); i++)
+	{
+		if (i == 0 || ![self isKeyRef:keyRefs[i] equalToKeyRef:keyRefs[i - 1]])
+		{
+			count++;
+		}
+
+		flags |= rows[keyRefs[i].row].flags;
+	}
+}
+
+- (void)buildCollections
+{
+	for (uint32_t i = 0; i < (uint32_t)keyRefs.size(); i++)
+	{
+		const YapCompactChangesetKeyRef &keyRef = keyRefs[i];
+		const YapCompactChangesetRow &row = rows[keyRef.row];
+
+		if (collections.empty() ||
+		    collections.back().hash != keyRef.collectionHash ||
+		    !YapCompactChangesetEqualStrings(collections.back().collection, row.collectionKey.collection))
+		{
+			collections.push_back({ keyRef.collectionHash, row.collectionKey.collection, i, 0, 0, false });
+		}
+
+		collections.back().count++;
+		collections.back().flags |= row.flags;
+	}
+
+	// The collections follow the keyRefs, so they're sorted already.
+	// The removed ones have to be merged in.
+
+	for (NSString *collection in removedCollections)
+	{
+		YapCompactChangesetCollection *existing = [self findCollection:collection];
+		if (existing)
+		{
+			existing->removed = true;
+			continue;
+		}
+
+		YapCompactChangesetCollection removed = { [collection hash], collection, 0, 0, 0, true };
+
+		auto it = std::upper_bound(collections.begin(), collections.end(), removed,
+		  [](const YapCompactChangesetCollection &a, const YapCompactChangesetCollection &b)
+		{
+			if (a.hash != b.hash) return a.hash < b.hash;
+
+			return YapCompactChangesetCompareStrings(a.collection, b.collection) < 0;
+		});
+
+		collections.insert(it, removed);
+	}
+}
+
+- (BOOL)isKeyRef:(const YapCompactChangesetKeyRef &)a equalToKeyRef:(const YapCompactChangesetKeyRef &)b
+{
+	if (a.collectionHash != b.collectionHash || a.keyHash != b.keyHash) return NO;
+
+	return YapCollectionKeyEqual(rows[a.row].collectionKey, rows[b.row].collectionKey);
+}
+
+- (YapCompactChangesetCollection *)findCollection:(NSString *)collection
+{
+	NSUInteger hash = [collection hash];
+
+	auto it = std::lower_bound(collections.begin(), collections.end(), hash,
+	  [](const YapCompactChangesetCollection &c, NSUInteger h){ return c.hash < h; });
+
+	for (; it != collections.end() && it->hash == hash; ++it)
+	{
+		if (YapCompactChangesetEqualStrings(it->collection, collection))
+		{
+			return &(*it);
+		}
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Queries
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (YapCompactChangesetFlags)flagsForCollectionKey:(YapCollectionKey *)collectionKey
+{
+	YapCompactChangesetCollection *collection = [self findCollection:collectionKey.collection];
+	if (collection == NULL || collection->count == 0) return 0;
+
+	NSUInteger keyHash = [collectionKey.key hash];
+
+	auto begin = keyRefs.begin() + collection->start;
+	auto end = begin + collection->count;
+
+	auto it = std::lower_bound(begin, end, keyHash,
+	  [](const YapCompactChangesetKeyRef &keyRef, NSUInteger h){ return keyRef.keyHash < h; });
+
+	uint8_t result = 0;
+	for (; it != end && it->keyHash == keyHash; ++it)
+	{
+		const YapCompactChangesetRow &row = rows[it->row];
+
+		if (YapCompactChangesetEqualStrings(row.collectionKey.key, collectionKey.key))
+		{
+			result |= row.flags;
+		}
+	}
+
+	return result;
+}
+
+- (YapCompactChangesetFlags)flagsForCollection:(NSString *)collection
+{
+	YapCompactChangesetCollection *found = [self findCollection:collection];
+
+	return found ? found->flags : 0;
+}
+
+- (BOOL)didRemoveCollection:(NSString *)collection
+{
+	if ([removedCollections count] == 0) return NO;
+
+	YapCompactChangesetCollection *found = [self findCollection:collection];
+
+	return found ? found->removed : NO;
+}
+
+- (BOOL)hasRemovedCollections
+{
+	return [removedCollections count] > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Enumeration
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)enumerateRemovedRowidsUsingBlock:(void (^)(int64_t rowid, BOOL *stop))block
+{
+	BOOL stop = NO;
+
+	for (const YapCompactChangesetRow &row : rows)
+	{
+		if (row.flags & YapCompactChangesetFlags_Removed)
+		{
+			block(row.rowid, &stop);
+			if (stop) break;
+		}
+	}
+}
+
+- (void)enumerateKeyRefsFrom:(size_t)start
+                          to:(size_t)end
+                  usingBlock:
+    (void (^)(YapCollectionKey *collectionKey, YapCompactChangesetFlags flags, BOOL *stop))block
+{
+	BOOL stop = NO;
+	size_t i = start;
+
+	while (i < end)
+	{
+		// Merge the rows of the same collection/key tuple.
+
+		uint8_t keyFlags = rows[keyRefs[i].row].flags;
+
+		size_t next = i + 1;
+		while (next < end && [self isKeyRef:keyRefs[next] equalToKeyRef:keyRefs[i]])
+		{
+			keyFlags |= rows[keyRefs[next].row].flags;
+			next++;
+		}
+
+		block(rows[keyRefs[i].row].collectionKey, keyFlags, &stop);
+		if (stop) break;
+
+		i = next;
+	}
+}
+
+- (void)enumerateCollectionKeysUsingBlock:
+    (void (^)(YapCollectionKey *collectionKey, YapCompactChangesetFlags flags, BOOL *stop))block
+{
+	[self enumerateKeyRefsFrom:0 to:keyRefs.size() usingBlock:block];
+}
+
+- (void)enumerateCollectionKeysInCollection:(NSString *)collection
+                                 usingBlock:
+    (void (^)(YapCollectionKey *collectionKey, YapCompactChangesetFlags flags, BOOL *stop))block
+{
+	YapCompactChangesetCollection *found = [self findCollection:collection];
+	if (found == NULL || found->count == 0) return;
+
+	[self enumerateKeyRefsFrom:found->start to:(found->start + found->count) usingBlock:block];
+}
+
+@end
@@ -56,7 +56,7 @@ extern NSString *const YapDatabaseRegisteredExtensionsKey;
 extern NSString *const YapDatabaseRegisteredMemoryTablesKey;
 extern NSString *const YapDatabaseExtensionsOrderKey;
 extern NSString *const YapDatabaseExtensionDependenciesKey;
-extern NSString *const YapDatabaseRemovedRowidsKey;
+extern NSString *const YapDatabaseCompactChangesetKey;
 extern NSString *const YapDatabaseNotificationKey;
 
 /**
@@ -85,6 +85,7 @@ static NSString *const ext_key_class = @"class";
 	
 	YapDatabaseSerializer objectSerializer;         // Read-only by transactions
 	YapDatabaseDeserializer objectDeserializer;     // Read-only by transactions
+	YapDatabaseBytesDeserializer objectBytesDeserializer; // Read-only by transactions (may be nil)
 	
 	YapDatabaseSerializer metadataSerializer;       // Read-only by transactions
 	YapDatabaseDeserializer metadataDeserializer;   // Read-only by transactions
@@ -185,7 +186,14 @@ static NSString *const ext_key_class = @"class";
  * then read-write transactions will automatically start performing checkpoint operations after each commit.
 **/
 - (BOOL)aggressiveCheckpointEnabled;
-- (void)noteCheckpointWithTotalFrames:(int)totalFrameCount checkpointedFrames:(int)checkpointedFrameCount;
+
+/**
+ * Reports a checkpoint performed by a connection (when aggressive checkpointing is enabled),
+ * along with the (mach) time it held up the writeQueue.
+**/
+- (void)noteCheckpointWithTotalFrames:(int)totalFrameCount
+                  checkpointedFrames:(int)checkpointedFrameCount
+                         writerStall:(uint64_t)writerStall;
 
 #ifdef SQLITE_HAS_CODEC
 /**
@@ -219,8 +227,8 @@ static NSString *const ext_key_class = @"class";
 	BOOL enableMultiProcessSupport;
 	
 	YapBidirectionalCache<NSNumber *, YapCollectionKey *> *keyCache;
-	YapCache<YapCollectionKey *, id> *objectCache;
-	YapCache<YapCollectionKey *, id> *metadataCache;
+	id <YapCache> objectCache;            // Either a YapCache or YapClockCache, depending on the cacheType
+	id <YapCache> metadataCache;          // Either a YapCache or YapClockCache, depending on the cacheType
 	
 	NSUInteger objectCacheLimit;          // Read-only by transaction. Use as consideration of whether to add to cache.
 	NSUInteger metadataCacheLimit;        // Read-only by transaction. Use as consideration of whether to add to cache.
@@ -235,6 +243,7 @@ static NSString *const ext_key_class = @"class";
 	NSMutableSet *removedKeys;
 	NSMutableSet *removedCollections;
 	NSMutableSet *removedRowids;
+	NSMutableDictionary *changedRowids;   // rowid -> collectionKey, for every row that was changed or removed
 	BOOL allKeysRemoved;
 	BOOL externallyModified;
 	
@@ -284,6 +293,8 @@ static NSString *const ext_key_class = @"class";
 - (sqlite3_stmt *)enumerateRowsInCollectionStatement:(BOOL *)needsFinalizePtr;
 - (sqlite3_stmt *)enumerateRowsInAllCollectionsStatement:(BOOL *)needsFinalizePtr;
 
+- (sqlite3_stmt *)cachedStatementForQuery:(NSString *)query; // Reset when done, never finalize
+
 - (void)prepare;
 
 - (YapDatabaseConnectionConfig *)copyConfig;
@@ -292,6 +303,7 @@ static NSString *const ext_key_class = @"class";
 - (NSDictionary *)extensions;
 
 - (BOOL)registerExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName;
+- (BOOL)populateExtensionWithName:(NSString *)extensionName batchSize:(NSUInteger)batchSize;
 - (void)unregisterExtensionWithName:(NSString *)extensionName;
 
 - (NSDictionary *)registeredMemoryTables;
@@ -344,6 +356,7 @@ static NSString *const ext_key_class = @"class";
 
 - (BOOL)getBoolValue:(BOOL *)valuePtr forKey:(NSString *)key extension:(NSString *)extension;
 - (BOOL)getIntValue:(int *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName;
+- (BOOL)getInt64Value:(int64_t *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName;
 - (BOOL)getDoubleValue:(double *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName;
 - (NSString *)stringValueForKey:(NSString *)key extension:(NSString *)extensionName;
 - (NSData *)dataValueForKey:(NSString *)key extension:(NSString *)extensionName;
@@ -449,6 +462,14 @@ static NSString *const ext_key_class = @"class";
                    inCollection:(NSString *)collection
             unorderedUsingBlock:(void (^)(NSUInteger keyIndex, int64_t rowid, BOOL *stop))block;
 
+- (int64_t)_enumerateRowsAfterRowid:(int64_t)minRowid
+                          upToRowid:(int64_t)maxRowid
+                              limit:(NSUInteger)limit
+     usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+     withFilter:(BOOL (^)(int64_t rowid, NSString *collection, NSString *key))filter;
+
+- (int64_t)_maxRowid;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -484,6 +505,7 @@ static NSString *const ext_key_class = @"class";
 
 - (void)setBoolValue:(BOOL)value         forKey:(NSString *)key extension:(NSString *)extensionName;
 - (void)setIntValue:(int)value           forKey:(NSString *)key extension:(NSString *)extensionName;
+- (void)setInt64Value:(int64_t)value     forKey:(NSString *)key extension:(NSString *)extensionName;
 - (void)setDoubleValue:(double)value     forKey:(NSString *)key extension:(NSString *)extensionName;
 - (void)setStringValue:(NSString *)value forKey:(NSString *)key extension:(NSString *)extensionName;
 - (void)setDataValue:(NSData *)value     forKey:(NSString *)key extension:(NSString *)extensionName;
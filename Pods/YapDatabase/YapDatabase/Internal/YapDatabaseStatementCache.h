@@ -0,0 +1,57 @@
+#import <Foundation/Foundation.h>
+#import "sqlite3.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A bounded cache of prepared statements, keyed by their SQL text.
+ *
+ * Each YapDatabaseConnection owns one of these, and it's shared by the connection's dynamic queries
+ * as well as those of its extension connections (secondary index, full text search, rtree, ...).
+ * This way repeated queries don't have to pay for sqlite3_prepare_v2 every time.
+ *
+ * A statement handed out by the cache remains owned by the cache.
+ * When you're done with it, reset it (sqlite3_clear_bindings + sqlite3_reset, i.e. sqlite_enum_reset(stmt, NO)).
+ * Never finalize it.
+ *
+ * Statements which are in use (sqlite3_stmt_busy) are never handed out twice, and are never evicted.
+ * So nested queries using the same SQL (e.g. enumerating a collection from within an enumeration of it)
+ * simply get another statement, which is also cached for next time.
+ *
+ * When the cache is over its countLimit, the least recently used idle statement is finalized.
+ *
+ * Like YapCache, this class is NOT thread-safe.
+ * It's only accessed from within the connection's serial queue.
+**/
+@interface YapDatabaseStatementCache : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+- (instancetype)initWithDatabase:(sqlite3 *)db countLimit:(NSUInteger)countLimit NS_DESIGNATED_INITIALIZER;
+
+/**
+ * The maximum number of statements to keep around.
+ * A countLimit of zero means unlimited.
+**/
+@property (nonatomic, assign, readwrite) NSUInteger countLimit;
+
+/**
+ * Returns an idle statement for the given SQL, preparing (and caching) one if needed.
+ * Returns NULL (and logs the sqlite error) if the SQL can't be prepared.
+**/
+- (nullable sqlite3_stmt *)statementForQuery:(NSString *)query;
+
+/**
+ * Finalizes every cached statement.
+ * This must not be called while any of them are in use.
+**/
+- (void)removeAllStatements;
+
+@property (nonatomic, readonly) NSUInteger count;
+
+@property (nonatomic, readonly) NSUInteger hitCount;
+@property (nonatomic, readonly) NSUInteger missCount;
+@property (nonatomic, readonly) NSUInteger evictionCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,165 @@
+#import "YapDatabaseStatementCache.h"
+#import "YapDatabaseLogging.h"
+#import "YapDatabasePrivate.h"
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_WARN;
+#endif
+#pragma unused(ydbLogLevel)
+
+
+@interface YapDatabaseStatementCacheItem : NSObject {
+@public
+	sqlite3_stmt *stmt;
+	uint64_t lastUse;
+}
+@end
+
+@implementation YapDatabaseStatementCacheItem
+
+- (void)dealloc
+{
+	sqlite_finalize_null(&stmt);
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation YapDatabaseStatementCache
+{
+	sqlite3 *db;
+
+	// Usually there's a single statement per query.
+	// Additional statements only appear when the same query is nested within itself.
+	NSMutableDictionary<NSString *, NSMutableArray<YapDatabaseStatementCacheItem *> *> *items;
+
+	// Incremented on every use, so that lastUse gives us LRU ordering without reordering anything on a hit.
+	uint64_t useCounter;
+}
+
+@synthesize countLimit = countLimit;
+@synthesize count = count;
+@synthesize hitCount = hitCount;
+@synthesize missCount = missCount;
+@synthesize evictionCount = evictionCount;
+
+- (instancetype)initWithDatabase:(sqlite3 *)inDb countLimit:(NSUInteger)inCountLimit
+{
+	if ((self = [super init]))
+	{
+		db = inDb;
+		countLimit = inCountLimit;
+		items = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (void)setCountLimit:(NSUInteger)newCountLimit
+{
+	countLimit = newCountLimit;
+	[self evictExcludingItem:nil];
+}
+
+- (sqlite3_stmt *)statementForQuery:(NSString *)query
+{
+	NSMutableArray<YapDatabaseStatementCacheItem *> *list = items[query];
+
+	for (YapDatabaseStatementCacheItem *item in list)
+	{
+		if (!sqlite3_stmt_busy(item->stmt))
+		{
+			item->lastUse = ++useCounter;
+			hitCount++;
+
+			return item->stmt;
+		}
+	}
+
+	missCount++;
+
+	sqlite3_stmt *statement = NULL;
+	int status = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating statement:\n query: '%@'\n error: %d %s",
+		            THIS_METHOD, query, status, sqlite3_errmsg(db));
+
+		sqlite_finalize_null(&statement);
+		return NULL;
+	}
+
+	YapDatabaseStatementCacheItem *item = [[YapDatabaseStatementCacheItem alloc] init];
+	item->stmt = statement;
+	item->lastUse = ++useCounter;
+
+	if (list == nil)
+	{
+		list = [[NSMutableArray alloc] initWithCapacity:1];
+		items[[query copy]] = list;
+	}
+	[list addObject:item];
+	count++;
+
+	[self evictExcludingItem:item];
+
+	return statement;
+}
+
+/**
+ * Finalizes least recently used idle statements until we're within the countLimit.
+ * Statements which are in use stay put, even if that means (temporarily) going over the limit.
+**/
+- (void)evictExcludingItem:(YapDatabaseStatementCacheItem *)excludedItem
+{
+	if (countLimit == 0) return; // unlimited
+
+	while (count > countLimit)
+	{
+		__block NSString *lruQuery = nil;
+		__block NSUInteger lruIndex = NSNotFound;
+		__block uint64_t lruUse = UINT64_MAX;
+
+		[items enumerateKeysAndObjectsUsingBlock:^(NSString *query, NSMutableArray *list, BOOL __unused *stop) {
+
+			NSUInteger index = 0;
+			for (YapDatabaseStatementCacheItem *item in list)
+			{
+				if (item != excludedItem && item->lastUse < lruUse && !sqlite3_stmt_busy(item->stmt))
+				{
+					lruQuery = query;
+					lruIndex = index;
+					lruUse = item->lastUse;
+				}
+				index++;
+			}
+		}];
+
+		if (lruQuery == nil) break; // everything else is in use
+
+		NSMutableArray *list = items[lruQuery];
+		[list removeObjectAtIndex:lruIndex]; // finalizes the statement
+		if (list.count == 0) {
+			[items removeObjectForKey:lruQuery];
+		}
+
+		count--;
+		evictionCount++;
+	}
+}
+
+- (void)removeAllStatements
+{
+	[items removeAllObjects]; // finalizes every statement
+	count = 0;
+}
+
+@end
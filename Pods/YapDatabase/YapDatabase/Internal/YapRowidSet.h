@@ -1,5 +1,5 @@
 /**
- * Wrapper for C++ code (std::unordered_set<int64_t>)
+ * Wrapper for C++ code (a compressed set of int64_t, using roaring-style containers)
 **/
 
 #import <Foundation/Foundation.h>
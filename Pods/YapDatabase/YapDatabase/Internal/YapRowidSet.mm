@@ -1,89 +1,316 @@
 #include "YapRowidSet.h"
-#include <unordered_set>
+#include <algorithm>
+#include <vector>
+
+/**
+ * Rowids are grouped into chunks of 2^16, keyed by the high bits (rowid >> 16).
+ * Each chunk has a container storing just the low 16 bits of its rowids:
+ *
+ * - A sparse chunk (up to 4096 rowids) is a sorted array of uint16_t. That's 2 bytes per rowid.
+ * - A dense chunk is a bitmap of 2^16 bits (8 KiB). That's 2 bytes per rowid, or less.
+ *
+ * This is the same layout used by "roaring" bitmaps.
+ * Compared to std::unordered_set (a heap allocated node per rowid) it's an order of magnitude smaller,
+ * and a membership test is a binary search over contiguous memory (or a single bit test),
+ * rather than a hash followed by a pointer chase.
+ *
+ * Since sqlite hands out rowids in ascending order, most sets only ever have a handful of containers.
+**/
+
+static const uint32_t YapRowidSetArrayMax = 4096;
+static const uint32_t YapRowidSetBitmapWords = (1 << 16) / 64;
+
+struct YapRowidSetContainer {
+	int64_t key;
+	uint32_t count;
+	std::vector<uint16_t> array;  // sorted, used while the bitmap is empty
+	std::vector<uint64_t> bitmap; // YapRowidSetBitmapWords, used once count exceeds YapRowidSetArrayMax
+};
 
 struct _YapRowidSet {
-    std::unordered_set<int64_t> *rowids;
+	std::vector<YapRowidSetContainer> *containers; // sorted by key
+	NSUInteger count;
+	size_t lastIndex;                              // hint, since lookups tend to hit the same container
 };
 
+NS_INLINE int64_t YapRowidSetKey(int64_t rowid)
+{
+	return rowid >> 16; // arithmetic shift, so negative rowids sort correctly too
+}
+
+NS_INLINE uint16_t YapRowidSetLow(int64_t rowid)
+{
+	return (uint16_t)(rowid & 0xFFFF);
+}
+
+NS_INLINE int64_t YapRowidSetRowid(int64_t key, uint16_t low)
+{
+	return (int64_t)(((uint64_t)key << 16) | low);
+}
+
+static BOOL YapRowidSetFindContainer(YapRowidSet *set, int64_t key, size_t *indexPtr)
+{
+	std::vector<YapRowidSetContainer> &containers = *set->containers;
+
+	size_t hint = set->lastIndex;
+	if (hint < containers.size() && containers[hint].key == key)
+	{
+		*indexPtr = hint;
+		return YES;
+	}
+
+	std::vector<YapRowidSetContainer>::iterator it =
+	  std::lower_bound(containers.begin(), containers.end(), key,
+	    [](const YapRowidSetContainer &container, int64_t k){ return container.key < k; });
+
+	size_t index = (size_t)(it - containers.begin());
+	*indexPtr = index;
+
+	if (it != containers.end() && it->key == key)
+	{
+		set->lastIndex = index;
+		return YES;
+	}
+
+	return NO;
+}
+
+static void YapRowidSetConvertToBitmap(YapRowidSetContainer &container)
+{
+	container.bitmap.assign(YapRowidSetBitmapWords, 0);
+
+	for (uint16_t low : container.array)
+	{
+		container.bitmap[low >> 6] |= (1ULL << (low & 63));
+	}
+
+	std::vector<uint16_t>().swap(container.array);
+}
+
+static void YapRowidSetConvertToArray(YapRowidSetContainer &container)
+{
+	container.array.reserve(container.count);
+
+	for (uint32_t i = 0; i < YapRowidSetBitmapWords; i++)
+	{
+		uint64_t word = container.bitmap[i];
+		while (word)
+		{
+			container.array.push_back((uint16_t)((i << 6) + __builtin_ctzll(word)));
+			word &= (word - 1);
+		}
+	}
+
+	std::vector<uint64_t>().swap(container.bitmap);
+}
+
+static BOOL YapRowidSetContainerContains(const YapRowidSetContainer &container, uint16_t low)
+{
+	if (!container.bitmap.empty())
+	{
+		return (container.bitmap[low >> 6] >> (low & 63)) & 1;
+	}
+
+	return std::binary_search(container.array.begin(), container.array.end(), low);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 YapRowidSet* YapRowidSetCreate(NSUInteger capacity)
 {
-	YapRowidSet *set = (YapRowidSet *)malloc(sizeof(YapRowidSet));
-	
-	set->rowids = new std::unordered_set<int64_t>();
+	YapRowidSet *set = new YapRowidSet();
+
+	set->containers = new std::vector<YapRowidSetContainer>();
+	set->count = 0;
+	set->lastIndex = 0;
+
 	if (capacity > 0) {
-		set->rowids->reserve(capacity);
+		set->containers->reserve((capacity >> 16) + 1);
 	}
-	
+
 	return set;
 }
 
 YapRowidSet* YapRowidSetCopy(YapRowidSet *set)
 {
 	if (set == NULL) return NULL;
-	
-	YapRowidSet *copy = (YapRowidSet *)malloc(sizeof(YapRowidSet));
-	
-	if (set->rowids) {
-		copy->rowids = new std::unordered_set<int64_t>(*(set->rowids));
-	}
-	else {
-		copy->rowids = new std::unordered_set<int64_t>();
-	}
-	
+
+	YapRowidSet *copy = new YapRowidSet();
+
+	copy->containers = new std::vector<YapRowidSetContainer>(*(set->containers));
+	copy->count = set->count;
+	copy->lastIndex = 0;
+
 	return copy;
 }
 
 void YapRowidSetRelease(YapRowidSet *set)
 {
 	if (set == NULL) return;
-	
-	if (set->rowids) {
-		free(set->rowids);
-		set->rowids = NULL;
+
+	if (set->containers) {
+		delete set->containers;
+		set->containers = NULL;
 	}
-	
-	free(set);
+
+	delete set;
 }
 
 void YapRowidSetAdd(YapRowidSet *set, int64_t rowid)
 {
-	set->rowids->insert(rowid);
+	int64_t key = YapRowidSetKey(rowid);
+	uint16_t low = YapRowidSetLow(rowid);
+
+	size_t index = 0;
+	if (!YapRowidSetFindContainer(set, key, &index))
+	{
+		YapRowidSetContainer container;
+		container.key = key;
+		container.count = 1;
+		container.array.push_back(low);
+
+		set->containers->insert(set->containers->begin() + index, std::move(container));
+		set->lastIndex = index;
+		set->count++;
+		return;
+	}
+
+	YapRowidSetContainer &container = (*set->containers)[index];
+
+	if (container.bitmap.empty())
+	{
+		// Appending is the common case (rowids are handed out in ascending order)
+		if (container.array.empty() || container.array.back() < low)
+		{
+			container.array.push_back(low);
+		}
+		else
+		{
+			std::vector<uint16_t>::iterator it =
+			  std::lower_bound(container.array.begin(), container.array.end(), low);
+
+			if (*it == low) return; // already present
+
+			container.array.insert(it, low);
+		}
+
+		container.count++;
+		set->count++;
+
+		if (container.count > YapRowidSetArrayMax) {
+			YapRowidSetConvertToBitmap(container);
+		}
+	}
+	else
+	{
+		uint64_t &word = container.bitmap[low >> 6];
+		uint64_t mask = (1ULL << (low & 63));
+
+		if ((word & mask) == 0)
+		{
+			word |= mask;
+			container.count++;
+			set->count++;
+		}
+	}
 }
 
 void YapRowidSetRemove(YapRowidSet *set, int64_t rowid)
 {
-	set->rowids->erase(rowid);
+	size_t index = 0;
+	if (!YapRowidSetFindContainer(set, YapRowidSetKey(rowid), &index)) return;
+
+	YapRowidSetContainer &container = (*set->containers)[index];
+	uint16_t low = YapRowidSetLow(rowid);
+
+	if (container.bitmap.empty())
+	{
+		std::vector<uint16_t>::iterator it =
+		  std::lower_bound(container.array.begin(), container.array.end(), low);
+
+		if (it == container.array.end() || *it != low) return; // not present
+
+		container.array.erase(it);
+	}
+	else
+	{
+		uint64_t &word = container.bitmap[low >> 6];
+		uint64_t mask = (1ULL << (low & 63));
+
+		if ((word & mask) == 0) return; // not present
+
+		word &= ~mask;
+	}
+
+	container.count--;
+	set->count--;
+
+	// Hysteresis, so that hovering around the threshold doesn't thrash between representations
+	if (!container.bitmap.empty() && container.count < (YapRowidSetArrayMax / 2)) {
+		YapRowidSetConvertToArray(container);
+	}
+
+	if (container.count == 0)
+	{
+		set->containers->erase(set->containers->begin() + index);
+		set->lastIndex = 0;
+	}
 }
 
 void YapRowidSetRemoveAll(YapRowidSet *set)
 {
-	set->rowids->clear();
+	set->containers->clear();
+	set->count = 0;
+	set->lastIndex = 0;
 }
 
 NSUInteger YapRowidSetCount(YapRowidSet *set)
 {
-	return (NSUInteger)(set->rowids->size());
+	return set->count;
 }
 
 BOOL YapRowidSetContains(YapRowidSet *set, int64_t rowid)
 {
-	return (set->rowids->find(rowid) != set->rowids->end());
+	size_t index = 0;
+	if (!YapRowidSetFindContainer(set, YapRowidSetKey(rowid), &index)) return NO;
+
+	return YapRowidSetContainerContains((*set->containers)[index], YapRowidSetLow(rowid));
 }
 
 void YapRowidSetEnumerate(YapRowidSet *set, void (^block)(int64_t rowid, BOOL *stop))
 {
 	__block BOOL stop = NO;
-	
-	std::unordered_set<int64_t>::iterator iterator = set->rowids->begin();
-	std::unordered_set<int64_t>::iterator end = set->rowids->end();
-	
-	while (iterator != end)
+
+	// Rowids are enumerated in ascending order
+
+	for (const YapRowidSetContainer &container : *set->containers)
 	{
-		int64_t rowid = *iterator;
-		
-		block(rowid, &stop);
-		
-		if (stop) break;
-		iterator++;
+		if (container.bitmap.empty())
+		{
+			for (uint16_t low : container.array)
+			{
+				block(YapRowidSetRowid(container.key, low), &stop);
+
+				if (stop) return;
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < YapRowidSetBitmapWords; i++)
+			{
+				uint64_t word = container.bitmap[i];
+				while (word)
+				{
+					uint16_t low = (uint16_t)((i << 6) + __builtin_ctzll(word));
+					word &= (word - 1);
+
+					block(YapRowidSetRowid(container.key, low), &stop);
+
+					if (stop) return;
+				}
+			}
+		}
 	}
 }
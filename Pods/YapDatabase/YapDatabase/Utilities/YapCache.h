@@ -6,6 +6,35 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * The interface shared by YapCache and YapClockCache.
+ *
+ * This allows the YapDatabaseConnection to use either one for its objectCache & metadataCache.
+ * @see YapDatabaseConnection cacheType
+**/
+@protocol YapCache <NSObject>
+
+@property (nonatomic, assign, readwrite) NSUInteger countLimit;
+
+@property (nonatomic, copy, readwrite, nullable) NSSet<Class> *allowedKeyClasses;
+@property (nonatomic, copy, readwrite, nullable) NSSet<Class> *allowedObjectClasses;
+
+- (void)setObject:(id)object forKey:(id)key;
+
+- (nullable id)objectForKey:(id)key;
+- (BOOL)containsKey:(id)key;
+
+- (NSUInteger)count;
+
+- (void)removeAllObjects;
+- (void)removeObjectForKey:(id)key;
+- (void)removeObjectsForKeys:(id <NSFastEnumeration>)keys;
+
+- (void)enumerateKeysWithBlock:(void (^)(id key, BOOL *stop))block;
+- (void)enumerateKeysAndObjectsWithBlock:(void (^)(id key, id obj, BOOL *stop))block;
+
+@end
+
 /**
  * YapCache implements a simple strict cache.
  *
@@ -36,7 +65,7 @@ NS_ASSUME_NONNULL_BEGIN
  * And thus performing this action (if desired) is up to you.
  * The various YapDatabase classes which use it do this themselves.
 **/
-@interface YapCache<KeyType, ObjectType> : NSObject
+@interface YapCache<KeyType, ObjectType> : NSObject <YapCache>
 
 /**
  * Initializes a cache.
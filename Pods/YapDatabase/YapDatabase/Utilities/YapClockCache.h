@@ -0,0 +1,114 @@
+#import <Foundation/Foundation.h>
+#import "YapCache.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Returns the cost of an item in the cache.
+ * The unit is up to you. The YapDatabaseConnection uses (approximate) bytes.
+**/
+typedef NSUInteger (^YapClockCacheCostBlock)(id key, id object);
+
+/**
+ * YapClockCache is an alternative to YapCache that bounds its contents by cost, in addition to count.
+ *
+ * YapCache evicts strictly by count. That's fine if every item is roughly the same size,
+ * but a handful of large objects can then use as much memory as thousands of small ones.
+ * YapClockCache lets you attach a cost to every item (via the costBlock),
+ * and evicts items until both the countLimit and the costLimit are satisfied.
+ *
+ * Eviction uses the CLOCK algorithm (a.k.a. second-chance) rather than a strict LRU.
+ * Items live in a flat array of slots, each with a "referenced" bit.
+ * A cache hit simply sets the bit, so there's no linked-list surgery on the (very hot) read path.
+ * When an item needs to be evicted, the clock hand sweeps the slots:
+ * referenced items have their bit cleared and are skipped, and the first unreferenced item is evicted.
+ * In practice this closely approximates LRU.
+ *
+ * As with YapCache, the item which was just added is never evicted as part of adding it.
+ * So a single item whose cost exceeds the costLimit can still be cached, at the expense of everything else.
+ *
+ * Like YapCache, this class is NOT thread-safe.
+**/
+@interface YapClockCache<KeyType, ObjectType> : NSObject <YapCache>
+
+/**
+ * Initializes a cache.
+ * If you don't define a countLimit, then the default countLimit of 40 is used.
+ * If you don't define a costLimit, then the cache is bound only by its countLimit.
+**/
+- (instancetype)init;
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit;
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit keyCallbacks:(CFDictionaryKeyCallBacks)keyCallbacks;
+
+- (instancetype)initWithCountLimit:(NSUInteger)countLimit
+                         costLimit:(NSUInteger)costLimit
+                      keyCallbacks:(CFDictionaryKeyCallBacks)keyCallbacks NS_DESIGNATED_INITIALIZER;
+
+/**
+ * The maximum number of items to keep in the cache.
+ * Set to zero for no count limit.
+ *
+ * Changes take immediate effect on the cache (before the set method returns).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger countLimit;
+
+/**
+ * The maximum total cost of the items in the cache.
+ * Set to zero for no cost limit.
+ *
+ * Changes take immediate effect on the cache (before the set method returns).
+**/
+@property (nonatomic, assign, readwrite) NSUInteger costLimit;
+
+/**
+ * Invoked once for every item added to (or replaced within) the cache.
+ * If nil, every item has a cost of 1.
+ *
+ * Changing the costBlock only affects items added afterwards.
+**/
+@property (nonatomic, copy, readwrite, nullable) YapClockCacheCostBlock costBlock;
+
+/**
+ * The sum of the costs of every item currently in the cache.
+**/
+@property (nonatomic, readonly) NSUInteger totalCost;
+
+/**
+ * See YapCache.
+**/
+@property (nonatomic, copy, readwrite, nullable) NSSet<Class> *allowedKeyClasses;
+@property (nonatomic, copy, readwrite, nullable) NSSet<Class> *allowedObjectClasses;
+
+//
+// The normal cache stuff...
+//
+
+- (void)setObject:(ObjectType)object forKey:(KeyType)key;
+
+- (nullable ObjectType)objectForKey:(KeyType)key;
+- (BOOL)containsKey:(KeyType)key;
+
+- (NSUInteger)count;
+
+- (void)removeAllObjects;
+- (void)removeObjectForKey:(KeyType)key;
+- (void)removeObjectsForKeys:(id <NSFastEnumeration>)keys;
+
+- (void)enumerateKeysWithBlock:(void (^)(KeyType key, BOOL *stop))block;
+- (void)enumerateKeysAndObjectsWithBlock:(void (^)(KeyType key, ObjectType obj, BOOL *stop))block;
+
+//
+// Some debugging stuff that gets compiled out
+//
+
+#if YapCache_Enable_Statistics
+
+@property (nonatomic, readonly) NSUInteger hitCount;
+@property (nonatomic, readonly) NSUInteger missCount;
+@property (nonatomic, readonly) NSUInteger evictionCount;
+
+#endif
+
+@end
+
+NS_ASSUME_NONNULL_END
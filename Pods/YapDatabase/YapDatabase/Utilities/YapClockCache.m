@@ -0,0 +1,455 @@
+#import "YapClockCache.h"
+#import "YapDatabaseLogging.h"
+
+/**
+ * Define log level for this file: OFF, ERROR, WARN, INFO, VERBOSE
+ * See YapDatabaseLogging.h for more information.
+**/
+#if DEBUG
+  static const int ydbLogLevel = YDB_LOG_LEVEL_OFF;
+#else
+  static const int ydbLogLevel = YDB_LOG_LEVEL_OFF;
+#endif
+
+/**
+ * Default countLimit, as specified in header file.
+**/
+static const NSUInteger YapClockCache_Default_CountLimit = 40;
+
+static const NSUInteger YapClockCache_NotFound = NSUIntegerMax;
+
+/**
+ * Memory Management Architecture & Performance note:
+ *
+ * The slots are a plain C array, so they can't hold __strong references.
+ * The key is retained by the cfdict (which maps key -> slot index).
+ * The value is retained manually (CFBridgingRetain / CFRelease).
+**/
+typedef struct {
+	__unsafe_unretained id key;  // retained by cfdict as key
+	CFTypeRef value;             // retained only by us, NULL if the slot is free
+	NSUInteger cost;
+	NSUInteger nextFree;         // only valid if the slot is free
+	BOOL referenced;
+} YapClockCacheSlot;
+
+
+@implementation YapClockCache
+{
+	CFMutableDictionaryRef cfdict;
+
+	YapClockCacheSlot *slots;
+	NSUInteger slotsCapacity;
+	NSUInteger slotsUsed;        // high water mark, slots beyond this have never been used
+	NSUInteger freeList;         // head of the list of free slots (below slotsUsed)
+	NSUInteger hand;
+
+	NSUInteger countLimit;
+	NSUInteger costLimit;
+	NSUInteger totalCost;
+}
+
+@synthesize costBlock = costBlock;
+@synthesize allowedKeyClasses = allowedKeyClasses;
+@synthesize allowedObjectClasses = allowedObjectClasses;
+
+#if YapCache_Enable_Statistics
+@synthesize hitCount = hitCount;
+@synthesize missCount = missCount;
+@synthesize evictionCount = evictionCount;
+#endif
+
+- (instancetype)init
+{
+	return [self initWithCountLimit:YapClockCache_Default_CountLimit
+	                      costLimit:0
+	                   keyCallbacks:kCFTypeDictionaryKeyCallBacks];
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)inCountLimit
+{
+	return [self initWithCountLimit:inCountLimit
+	                      costLimit:0
+	                   keyCallbacks:kCFTypeDictionaryKeyCallBacks];
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)inCountLimit keyCallbacks:(CFDictionaryKeyCallBacks)inKeyCallbacks
+{
+	return [self initWithCountLimit:inCountLimit
+	                      costLimit:0
+	                   keyCallbacks:inKeyCallbacks];
+}
+
+- (instancetype)initWithCountLimit:(NSUInteger)inCountLimit
+                         costLimit:(NSUInteger)inCostLimit
+                      keyCallbacks:(CFDictionaryKeyCallBacks)inKeyCallbacks
+{
+	if ((self = [super init]))
+	{
+		// zero is a valid countLimit & costLimit (it means unlimited)
+		countLimit = inCountLimit;
+		costLimit = inCostLimit;
+
+		// The values are slot indexes, not objects
+		cfdict = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &inKeyCallbacks, NULL);
+
+		freeList = YapClockCache_NotFound;
+	}
+	return self;
+}
+
+- (void)dealloc
+{
+	[self releaseAllSlots];
+	free(slots);
+
+	if (cfdict) CFRelease(cfdict);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Limits
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSUInteger)countLimit
+{
+	return countLimit;
+}
+
+- (void)setCountLimit:(NSUInteger)newCountLimit
+{
+	if (countLimit != newCountLimit)
+	{
+		countLimit = newCountLimit;
+		[self evictExcludingSlot:YapClockCache_NotFound];
+	}
+}
+
+- (NSUInteger)costLimit
+{
+	return costLimit;
+}
+
+- (void)setCostLimit:(NSUInteger)newCostLimit
+{
+	if (costLimit != newCostLimit)
+	{
+		costLimit = newCostLimit;
+		[self evictExcludingSlot:YapClockCache_NotFound];
+	}
+}
+
+- (NSUInteger)totalCost
+{
+	return totalCost;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Slots
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (BOOL)getSlotIndex:(NSUInteger *)indexPtr forKey:(id)key
+{
+	const void *value = NULL;
+	if (CFDictionaryGetValueIfPresent(cfdict, (const void *)key, &value))
+	{
+		*indexPtr = (NSUInteger)(uintptr_t)value;
+		return YES;
+	}
+
+	return NO;
+}
+
+- (NSUInteger)allocateSlot
+{
+	if (freeList != YapClockCache_NotFound)
+	{
+		NSUInteger index = freeList;
+		freeList = slots[index].nextFree;
+
+		return index;
+	}
+
+	if (slotsUsed == slotsCapacity)
+	{
+		NSUInteger newCapacity = (slotsCapacity == 0) ? 16 : (slotsCapacity * 2);
+		if (countLimit > 0) {
+			newCapacity = MIN(newCapacity, MAX(countLimit + 1, slotsCapacity + 1));
+		}
+
+		slots = reallocf(slots, newCapacity * sizeof(YapClockCacheSlot));
+		slotsCapacity = newCapacity;
+	}
+
+	return slotsUsed++;
+}
+
+- (void)releaseSlot:(NSUInteger)index
+{
+	YapClockCacheSlot *slot = &slots[index];
+
+	CFDictionaryRemoveValue(cfdict, (const void *)slot->key);
+	CFRelease(slot->value);
+
+	totalCost -= slot->cost;
+
+	slot->key = nil;
+	slot->value = NULL;
+	slot->cost = 0;
+	slot->referenced = NO;
+
+	slot->nextFree = freeList;
+	freeList = index;
+}
+
+- (void)releaseAllSlots
+{
+	for (NSUInteger i = 0; i < slotsUsed; i++)
+	{
+		if (slots[i].value) {
+			CFRelease(slots[i].value);
+		}
+	}
+
+	slotsUsed = 0;
+	freeList = YapClockCache_NotFound;
+	hand = 0;
+	totalCost = 0;
+}
+
+- (NSUInteger)costForKey:(id)key object:(id)object
+{
+	return costBlock ? costBlock(key, object) : 1;
+}
+
+- (BOOL)isOverLimit
+{
+	NSUInteger count = (NSUInteger)CFDictionaryGetCount(cfdict);
+
+	if ((countLimit != 0) && (count > countLimit)) return YES;
+	if ((costLimit != 0) && (totalCost > costLimit)) return YES;
+
+	return NO;
+}
+
+/**
+ * Sweeps the clock hand until the cache is within its limits.
+ * The excluded slot (the one just added) is never evicted.
+**/
+- (void)evictExcludingSlot:(NSUInteger)excludedIndex
+{
+	while ([self isOverLimit])
+	{
+		NSUInteger count = (NSUInteger)CFDictionaryGetCount(cfdict);
+		if (count == 0) break;
+		if (count == 1 && excludedIndex != YapClockCache_NotFound) break;
+
+		// Every item gets at most one "second chance" per eviction,
+		// so we're guaranteed to find a victim within two full sweeps.
+
+		for (;;)
+		{
+			if (hand >= slotsUsed) hand = 0;
+
+			NSUInteger index = hand++;
+			YapClockCacheSlot *slot = &slots[index];
+
+			if (slot->value == NULL || index == excludedIndex) continue;
+
+			if (slot->referenced)
+			{
+				slot->referenced = NO;
+				continue;
+			}
+
+			YDBLogVerbose(@"evicting key(%@) cost(%lu)", slot->key, (unsigned long)slot->cost);
+
+			[self releaseSlot:index];
+
+			#if YapCache_Enable_Statistics
+			evictionCount++;
+			#endif
+			break;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Cache
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (id)objectForKey:(id)key
+{
+	#ifndef NS_BLOCK_ASSERTIONS
+	AssertAllowedKeyClass(key, allowedKeyClasses);
+	#endif
+
+	NSUInteger index;
+	if ([self getSlotIndex:&index forKey:key])
+	{
+		slots[index].referenced = YES;
+
+		#if YapCache_Enable_Statistics
+		hitCount++;
+		#endif
+		return (__bridge id)slots[index].value;
+	}
+	else
+	{
+		#if YapCache_Enable_Statistics
+		missCount++;
+		#endif
+		return nil;
+	}
+}
+
+- (BOOL)containsKey:(id)key
+{
+	#ifndef NS_BLOCK_ASSERTIONS
+	AssertAllowedKeyClass(key, allowedKeyClasses);
+	#endif
+
+	return CFDictionaryContainsKey(cfdict, (const void *)key);
+}
+
+- (void)setObject:(id)object forKey:(id)key
+{
+	#ifndef NS_BLOCK_ASSERTIONS
+	AssertAllowedKeyClass(key, allowedKeyClasses);
+	AssertAllowedObjectClass(object, allowedObjectClasses);
+	#endif
+
+	NSUInteger cost = [self costForKey:key object:object];
+	NSUInteger index;
+
+	if ([self getSlotIndex:&index forKey:key])
+	{
+		YapClockCacheSlot *slot = &slots[index];
+
+		CFTypeRef oldValue = slot->value;
+		slot->value = CFBridgingRetain(object);
+		CFRelease(oldValue);
+
+		totalCost = totalCost - slot->cost + cost;
+		slot->cost = cost;
+		slot->referenced = YES;
+	}
+	else
+	{
+		index = [self allocateSlot];
+
+		// Add item to set (the cfdict retains the key)
+		CFDictionarySetValue(cfdict, (const void *)key, (const void *)(uintptr_t)index);
+
+		YapClockCacheSlot *slot = &slots[index];
+
+		// Fetch the key back out of the cfdict, in case the keyCallbacks copied it
+		const void *retainedKey = NULL;
+		CFDictionaryGetKeyIfPresent(cfdict, (const void *)key, &retainedKey);
+
+		slot->key = (__bridge id)retainedKey;
+		slot->value = CFBridgingRetain(object);
+		slot->cost = cost;
+		slot->referenced = NO; // must earn its second chance
+
+		totalCost += cost;
+	}
+
+	[self evictExcludingSlot:index];
+}
+
+- (NSUInteger)count
+{
+	return CFDictionaryGetCount(cfdict);
+}
+
+- (void)removeAllObjects
+{
+	[self releaseAllSlots];
+
+	CFDictionaryRemoveAllValues(cfdict);
+}
+
+- (void)removeObjectForKey:(id)key
+{
+	#ifndef NS_BLOCK_ASSERTIONS
+	AssertAllowedKeyClass(key, allowedKeyClasses);
+	#endif
+
+	NSUInteger index;
+	if ([self getSlotIndex:&index forKey:key])
+	{
+		[self releaseSlot:index];
+	}
+}
+
+- (void)removeObjectsForKeys:(id <NSFastEnumeration>)keys
+{
+	for (id key in keys)
+	{
+		[self removeObjectForKey:key];
+	}
+}
+
+- (void)enumerateKeysWithBlock:(void (^)(id key, BOOL *stop))block
+{
+	NSDictionary *nsdict = (__bridge NSDictionary *)cfdict;
+	BOOL stop = NO;
+
+	for (id key in [nsdict keyEnumerator])
+	{
+		block(key, &stop);
+
+		if (stop) break;
+	}
+}
+
+- (void)enumerateKeysAndObjectsWithBlock:(void (^)(id key, id obj, BOOL *stop))block
+{
+	BOOL stop = NO;
+
+	for (NSUInteger i = 0; i < slotsUsed; i++)
+	{
+		YapClockCacheSlot *slot = &slots[i];
+		if (slot->value == NULL) continue;
+
+		block(slot->key, (__bridge id)slot->value, &stop);
+
+		if (stop) break;
+	}
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"%@, count=%ld, totalCost=%lu",
+	          NSStringFromClass([self class]), CFDictionaryGetCount(cfdict), (unsigned long)totalCost];
+}
+
+#ifndef NS_BLOCK_ASSERTIONS
+static void AssertAllowedKeyClass(id key, NSSet *allowedKeyClasses)
+{
+	if (allowedKeyClasses == nil) return;
+
+	for (Class allowedKeyClass in allowedKeyClasses)
+	{
+		if ([key isKindOfClass:allowedKeyClass]) return;
+	}
+
+	NSCAssert(NO, @"Unexpected key class. Passed %@, expected: %@", [key class], allowedKeyClasses);
+}
+#endif
+
+#ifndef NS_BLOCK_ASSERTIONS
+static void AssertAllowedObjectClass(id obj, NSSet *allowedObjectClasses)
+{
+	if (allowedObjectClasses == nil) return;
+
+	for (Class allowedObjectClass in allowedObjectClasses)
+	{
+		if ([obj isKindOfClass:allowedObjectClass]) return;
+	}
+
+	NSCAssert(NO, @"Unexpected object class. Passed %@, expected: %@", [obj class], allowedObjectClasses);
+}
+#endif
+
+@end
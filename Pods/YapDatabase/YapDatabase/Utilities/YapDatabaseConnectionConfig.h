@@ -14,6 +14,11 @@
  * @see YapDatabase defaultMetadataCacheEnabled
  * @see YapDatabase defaultMetadataCacheLimit
  * 
+ * @see YapDatabase defaultCacheType
+ * @see YapDatabase defaultObjectCacheCostLimit
+ * @see YapDatabase defaultMetadataCacheCostLimit
+ * @see YapDatabase defaultCacheCostBlock
+ * 
  * @see YapDatabase defaultObjectPolicy
  * @see YapDatabase defaultMetadataPolicy
  * 
@@ -27,6 +32,13 @@
 @property (nonatomic, assign, readwrite) BOOL metadataCacheEnabled;
 @property (nonatomic, assign, readwrite) NSUInteger metadataCacheLimit;
 
+@property (nonatomic, assign, readwrite) NSUInteger statementCacheLimit;
+
+@property (nonatomic, assign, readwrite) YapDatabaseConnectionCacheType cacheType;
+@property (nonatomic, assign, readwrite) NSUInteger objectCacheCostLimit;
+@property (nonatomic, assign, readwrite) NSUInteger metadataCacheCostLimit;
+@property (nonatomic, copy, readwrite) YapDatabaseCacheCostBlock cacheCostBlock;
+
 @property (nonatomic, assign, readwrite) YapDatabasePolicy objectPolicy;
 @property (nonatomic, assign, readwrite) YapDatabasePolicy metadataPolicy;
 
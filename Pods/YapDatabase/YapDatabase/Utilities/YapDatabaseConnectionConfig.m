@@ -2,6 +2,7 @@
 
 static NSUInteger const DEFAULT_OBJECT_CACHE_LIMIT   = 250;
 static NSUInteger const DEFAULT_METADATA_CACHE_LIMIT = 250;
+static NSUInteger const DEFAULT_STATEMENT_CACHE_LIMIT = 40;
 
 
 @implementation YapDatabaseConnectionConfig
@@ -12,6 +13,13 @@ static NSUInteger const DEFAULT_METADATA_CACHE_LIMIT = 250;
 @synthesize metadataCacheEnabled = metadataCacheEnabled;
 @synthesize metadataCacheLimit = metadataCacheLimit;
 
+@synthesize statementCacheLimit = statementCacheLimit;
+
+@synthesize cacheType = cacheType;
+@synthesize objectCacheCostLimit = objectCacheCostLimit;
+@synthesize metadataCacheCostLimit = metadataCacheCostLimit;
+@synthesize cacheCostBlock = cacheCostBlock;
+
 @synthesize objectPolicy = objectPolicy;
 @synthesize metadataPolicy = metadataPolicy;
 
@@ -29,6 +37,12 @@ static NSUInteger const DEFAULT_METADATA_CACHE_LIMIT = 250;
 		metadataCacheEnabled = YES;
 		metadataCacheLimit = DEFAULT_METADATA_CACHE_LIMIT;
 		
+		statementCacheLimit = DEFAULT_STATEMENT_CACHE_LIMIT;
+		
+		cacheType = YapDatabaseConnectionCacheType_Strict;
+		objectCacheCostLimit = 0;
+		metadataCacheCostLimit = 0;
+		
 		objectPolicy = YapDatabasePolicyContainment;
 		metadataPolicy = YapDatabasePolicyContainment;
 		
@@ -49,6 +63,13 @@ static NSUInteger const DEFAULT_METADATA_CACHE_LIMIT = 250;
 	copy->metadataCacheEnabled = metadataCacheEnabled;
 	copy->metadataCacheLimit = metadataCacheLimit;
 	
+	copy->statementCacheLimit = statementCacheLimit;
+	
+	copy->cacheType = cacheType;
+	copy->objectCacheCostLimit = objectCacheCostLimit;
+	copy->metadataCacheCostLimit = metadataCacheCostLimit;
+	copy->cacheCostBlock = cacheCostBlock;
+	
 	copy->objectPolicy = objectPolicy;
 	copy->metadataPolicy = metadataPolicy;
 	
@@ -59,6 +80,17 @@ static NSUInteger const DEFAULT_METADATA_CACHE_LIMIT = 250;
 	return copy;
 }
 
+- (void)setCacheType:(YapDatabaseConnectionCacheType)newCacheType
+{
+	// sanity check
+	switch (newCacheType)
+	{
+		case YapDatabaseConnectionCacheType_Strict :
+		case YapDatabaseConnectionCacheType_Clock  : cacheType = newCacheType; break;
+		default                                    : cacheType = YapDatabaseConnectionCacheType_Strict; // revert to default
+	}
+}
+
 - (void)setObjectPolicy:(YapDatabasePolicy)newObjectPolicy
 {
 	// sanity check
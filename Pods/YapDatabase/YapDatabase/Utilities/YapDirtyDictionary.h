@@ -11,7 +11,7 @@ NS_ASSUME_NONNULL_BEGIN
  * but the final value ultimately remains the same as the original value.
  * This information allows us to skip disk IO which isn't needed.
 **/
-@interface YapDirtyDictionary<KeyType, ObjectType> : NSObject
+@interface YapDirtyDictionary<KeyType, ObjectType> : NSObject <NSCopying>
 
 - (instancetype)init;
 - (instancetype)initWithCapacity:(NSUInteger)capacity;
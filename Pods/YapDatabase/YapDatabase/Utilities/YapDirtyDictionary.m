@@ -40,6 +40,25 @@
 	return self;
 }
 
+/**
+ * The copy has its own items, so later changes to either dictionary don't show up in the other.
+**/
+- (id)copyWithZone:(NSZone __unused *)zone
+{
+	YapDirtyDictionary *copy = [[YapDirtyDictionary alloc] init];
+	
+	[dict enumerateKeysAndObjectsUsingBlock:^(id key, YapDirtyDictionaryItem *item, BOOL __unused *stop) {
+		
+		YapDirtyDictionaryItem *itemCopy = [[YapDirtyDictionaryItem alloc] init];
+		itemCopy->currentValue = item->currentValue;
+		itemCopy->originalValue = item->originalValue;
+		
+		[copy->dict setObject:itemCopy forKey:key];
+	}];
+	
+	return copy;
+}
+
 - (NSUInteger)count
 {
 	return dict.count;
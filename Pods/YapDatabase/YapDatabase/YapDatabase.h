@@ -182,6 +182,11 @@ extern NSString *const YapDatabaseConnectionKey;
 extern NSString *const YapDatabaseExtensionsKey;
 extern NSString *const YapDatabaseCustomKey;
 
+/**
+ * These keys are found in the changesets handed to extensions,
+ * but not in the userInfo of a YapDatabaseModifiedNotification, which doesn't hold on to the changed objects.
+ * Inspect the notifications with the hasChange... methods of YapDatabaseConnection instead.
+**/
 extern NSString *const YapDatabaseObjectChangesKey;
 extern NSString *const YapDatabaseMetadataChangesKey;
 extern NSString *const YapDatabaseRemovedKeysKey;
@@ -189,6 +194,80 @@ extern NSString *const YapDatabaseRemovedCollectionsKey;
 extern NSString *const YapDatabaseAllKeysRemovedKey;
 extern NSString *const YapDatabaseModifiedExternallyKey;
 
+/**
+ * This notification is posted when an extension registered with a populationBatchSize
+ * (see YapDatabaseExtension.h) has finished populating itself in the background.
+ *
+ * The notification object will be the database instance itself.
+ *
+ * The userInfo dictionary will look like this:
+ * @{
+ *     YapDatabaseExtensionNameKey : <NSString of the extension's registered name>,
+ * }
+ *
+ * This notification is always posted to the main thread.
+**/
+extern NSString *const YapDatabaseExtensionPopulatedNotification;
+
+extern NSString *const YapDatabaseExtensionNameKey;
+
+/**
+ * A point-in-time snapshot of the WAL checkpoint scheduler.
+ *
+ * YapDatabase checkpoints the WAL on its own (see YapDatabaseOptions.aggressiveWALTruncationSize),
+ * trying to keep the WAL small without making read-write transactions wait on it.
+ * These numbers let you see how well that's working for your workload.
+ *
+ * Sizes are approximations based on the number of frames sqlite reports in the WAL.
+ * All counters are cumulative since the database instance was created.
+**/
+@interface YapDatabaseCheckpointStats : NSObject
+
+/** Approximate size of the WAL (in bytes), as of the most recent checkpoint. **/
+@property (nonatomic, assign, readonly) unsigned long long walSize;
+
+/** Largest walSize observed. **/
+@property (nonatomic, assign, readonly) unsigned long long peakWALSize;
+
+/** Number of frames in the WAL, as of the most recent checkpoint. **/
+@property (nonatomic, assign, readonly) NSUInteger walFrameCount;
+
+/** Total number of WAL frames copied into the database file. **/
+@property (nonatomic, assign, readonly) uint64_t framesCheckpointed;
+
+/** Number of checkpoints performed, by sqlite checkpoint mode. **/
+@property (nonatomic, assign, readonly) NSUInteger passiveCheckpointCount;
+@property (nonatomic, assign, readonly) NSUInteger fullCheckpointCount;
+@property (nonatomic, assign, readonly) NSUInteger restartCheckpointCount;
+@property (nonatomic, assign, readonly) NSUInteger truncateCheckpointCount;
+
+/**
+ * Number of times a checkpoint couldn't finish because a reader was still using part of the WAL.
+ * Each of these causes the scheduler to back off before trying again.
+**/
+@property (nonatomic, assign, readonly) NSUInteger blockedCheckpointCount;
+
+/**
+ * Total time checkpoint work has spent holding the write lock,
+ * i.e. time during which a read-write transaction would have had to wait.
+**/
+@property (nonatomic, assign, readonly) NSTimeInterval writerStallTime;
+
+/** Longest single stretch included in writerStallTime. **/
+@property (nonatomic, assign, readonly) NSTimeInterval maxWriterStall;
+
+/** Recent rate of read-write commits (per second), as used by the scheduler. **/
+@property (nonatomic, assign, readonly) double commitRate;
+
+/**
+ * How many commits behind the latest snapshot the oldest active reader was,
+ * the last time a checkpoint was blocked.
+**/
+@property (nonatomic, assign, readonly) uint64_t oldestReaderSnapshotLag;
+
+@end
+
+
 
 @interface YapDatabase : NSObject
 
@@ -410,6 +489,13 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
 **/
 @property (atomic, readonly) NSString *sqliteVersion;
 
+/**
+ * Returns a snapshot of the WAL checkpoint statistics.
+ *
+ * @see YapDatabaseCheckpointStats
+**/
+- (YapDatabaseCheckpointStats *)checkpointStats;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Defaults
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -474,6 +560,28 @@ extern NSString *const YapDatabaseModifiedExternallyKey;
 @property (atomic, assign, readwrite) YapDatabasePolicy defaultObjectPolicy;
 @property (atomic, assign, readwrite) YapDatabasePolicy defaultMetadataPolicy;
 
+/**
+ * Allows you to set the default cacheType, cost limits & cacheCostBlock for all new connections.
+ *
+ * When you create a connection via [database newConnection], that new connection will inherit
+ * its initial configuration via the default values configured for the parent database.
+ * Of course, the connection may then override these default configuration values, and configure itself as needed.
+ *
+ * Changing the default values only affects future connections that will be created.
+ * It does not affect connections that have already been created.
+ *
+ * The default defaultCacheType is YapDatabaseConnectionCacheType_Strict.
+ * The default defaultObjectCacheCostLimit & defaultMetadataCacheCostLimit are zero (no cost limit).
+ * The default defaultCacheCostBlock is nil.
+ *
+ * For more detailed documentation on these properties, see the YapDatabaseConnection header file.
+ * @see YapDatabaseConnection cacheType
+**/
+@property (atomic, assign, readwrite) YapDatabaseConnectionCacheType defaultCacheType;
+@property (atomic, assign, readwrite) NSUInteger defaultObjectCacheCostLimit;
+@property (atomic, assign, readwrite) NSUInteger defaultMetadataCacheCostLimit;
+@property (atomic, copy, readwrite, nullable) YapDatabaseCacheCostBlock defaultCacheCostBlock;
+
 #if TARGET_OS_IOS || TARGET_OS_TV
 /**
  * Allows you to set the default autoFlushMemoryFlags for all new connections.
@@ -56,7 +56,6 @@ NSString *const YapDatabaseObjectChangesKey      = @"objectChanges";
 NSString *const YapDatabaseMetadataChangesKey    = @"metadataChanges";
 NSString *const YapDatabaseRemovedKeysKey        = @"removedKeys";
 NSString *const YapDatabaseRemovedCollectionsKey = @"removedCollections";
-NSString *const YapDatabaseRemovedRowidsKey      = @"removedRowids";
 NSString *const YapDatabaseAllKeysRemovedKey     = @"allKeysRemoved";
 NSString *const YapDatabaseModifiedExternallyKey = @"modifiedExternally";
 
@@ -65,6 +64,15 @@ NSString *const YapDatabaseRegisteredMemoryTablesKey = @"registeredMemoryTables"
 NSString *const YapDatabaseExtensionsOrderKey        = @"extensionsOrder";
 NSString *const YapDatabaseExtensionDependenciesKey  = @"extensionDependencies";
 NSString *const YapDatabaseNotificationKey           = @"notification";
+NSString *const YapDatabaseCompactChangesetKey       = @"compactChangeset";
+
+/**
+ * YapDatabaseExtensionPopulatedNotification & corresponding keys.
+**/
+
+NSString *const YapDatabaseExtensionPopulatedNotification = @"YapDatabaseExtensionPopulatedNotification";
+
+NSString *const YapDatabaseExtensionNameKey = @"extensionName";
 
 /**
  * ConnectionPool value dictionary keys.
@@ -102,6 +110,80 @@ static int connectionBusyHandler(void *ptr, int count) {
     return 1;
 }
 
+/**
+ * Bookkeeping for the checkpoint scheduler, and the source of YapDatabaseCheckpointStats.
+ * Protected by YapDatabase.checkpointLock.
+**/
+typedef struct {
+	uint64_t walFrameCount;             // as of the most recent checkpoint
+	uint64_t walCheckpointedFrameCount; // as of the most recent checkpoint (within the current WAL)
+	uint64_t peakWALSize;
+	uint64_t framesCheckpointed;
+	
+	NSUInteger passiveCheckpointCount;
+	NSUInteger fullCheckpointCount;
+	NSUInteger restartCheckpointCount;
+	NSUInteger truncateCheckpointCount;
+	NSUInteger blockedCheckpointCount;
+	
+	uint64_t writerStallTime;           // mach time
+	uint64_t maxWriterStall;            // mach time
+	
+	double commitRate;                  // commits per second, as of lastCommitTime
+	uint64_t lastCommitTime;            // mach time
+	
+	uint64_t oldestReaderSnapshotLag;
+	NSUInteger backoff;
+	
+} YapDatabaseCheckpointState;
+
+static NSTimeInterval YDBMachTimeToSeconds(uint64_t elapsed);
+
+@implementation YapDatabaseCheckpointStats
+
+- (instancetype)initWithState:(const YapDatabaseCheckpointState *)state
+                     pageSize:(uint64_t)pageSize
+                   commitRate:(double)commitRate
+{
+	if ((self = [super init]))
+	{
+		_walSize = state->walFrameCount * pageSize;
+		_peakWALSize = state->peakWALSize;
+		_walFrameCount = (NSUInteger)state->walFrameCount;
+		_framesCheckpointed = state->framesCheckpointed;
+		
+		_passiveCheckpointCount = state->passiveCheckpointCount;
+		_fullCheckpointCount = state->fullCheckpointCount;
+		_restartCheckpointCount = state->restartCheckpointCount;
+		_truncateCheckpointCount = state->truncateCheckpointCount;
+		_blockedCheckpointCount = state->blockedCheckpointCount;
+		
+		_writerStallTime = YDBMachTimeToSeconds(state->writerStallTime);
+		_maxWriterStall = YDBMachTimeToSeconds(state->maxWriterStall);
+		
+		_commitRate = commitRate;
+		_oldestReaderSnapshotLag = state->oldestReaderSnapshotLag;
+	}
+	return self;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:
+	  @"<YapDatabaseCheckpointStats[%p] walSize=%llu peakWALSize=%llu framesCheckpointed=%llu"
+	  @" passive=%lu full=%lu restart=%lu truncate=%lu blocked=%lu writerStall=%.3fs commitRate=%.1f/s>",
+	  self, _walSize, _peakWALSize, _framesCheckpointed,
+	  (unsigned long)_passiveCheckpointCount, (unsigned long)_fullCheckpointCount,
+	  (unsigned long)_restartCheckpointCount, (unsigned long)_truncateCheckpointCount,
+	  (unsigned long)_blockedCheckpointCount, _writerStallTime, _commitRate];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @implementation YapDatabase {
 @private
 	
@@ -136,7 +218,12 @@ static int connectionBusyHandler(void *ptr, int count) {
 	
 	atomic_flag pendingPassiveCheckpoint;
 	atomic_flag pendingAggressiveCheckpoint;
+	atomic_flag pendingWALReset;
+	atomic_flag pendingCheckpointRetry;
 	atomic_bool aggressiveCheckpointEnabled;
+	
+	YAPUnfairLock checkpointLock;
+	YapDatabaseCheckpointState checkpointState;
 }
 
 /**
@@ -569,6 +656,8 @@ static int connectionBusyHandler(void *ptr, int count) {
 		maxConnectionPoolCount = DEFAULT_MAX_CONNECTION_POOL_COUNT;
 		connectionPoolLifetime = DEFAULT_CONNECTION_POOL_LIFETIME;
 		
+		checkpointLock = YAP_UNFAIR_LOCK_INIT;
+		
 		YapDatabaseSerializer defaultSerializer     = nil;
 		YapDatabaseDeserializer defaultDeserializer = nil;
 		
@@ -580,6 +669,7 @@ static int connectionBusyHandler(void *ptr, int count) {
 		
 		objectSerializer = (YapDatabaseSerializer)[inObjectSerializer copy] ?: defaultSerializer;
 		objectDeserializer = (YapDatabaseDeserializer)[inObjectDeserializer copy] ?: defaultDeserializer;
+		objectBytesDeserializer = options.objectBytesDeserializer;
 		
 		metadataSerializer = (YapDatabaseSerializer)[inMetadataSerializer copy] ?: defaultSerializer;
 		metadataDeserializer = (YapDatabaseDeserializer)[inMetadataDeserializer copy] ?: defaultDeserializer;
@@ -1633,6 +1723,86 @@ static int connectionBusyHandler(void *ptr, int count) {
 	});
 }
 
+- (YapDatabaseConnectionCacheType)defaultCacheType
+{
+	__block YapDatabaseConnectionCacheType result = YapDatabaseConnectionCacheType_Strict;
+	
+	dispatch_sync(internalQueue, ^{
+		
+		result = connectionDefaults.cacheType;
+	});
+	
+	return result;
+}
+
+- (void)setDefaultCacheType:(YapDatabaseConnectionCacheType)defaultCacheType
+{
+	dispatch_sync(internalQueue, ^{
+		
+		connectionDefaults.cacheType = defaultCacheType;
+	});
+}
+
+- (NSUInteger)defaultObjectCacheCostLimit
+{
+	__block NSUInteger result = 0;
+	
+	dispatch_sync(internalQueue, ^{
+		
+		result = connectionDefaults.objectCacheCostLimit;
+	});
+	
+	return result;
+}
+
+- (void)setDefaultObjectCacheCostLimit:(NSUInteger)defaultObjectCacheCostLimit
+{
+	dispatch_sync(internalQueue, ^{
+		
+		connectionDefaults.objectCacheCostLimit = defaultObjectCacheCostLimit;
+	});
+}
+
+- (NSUInteger)defaultMetadataCacheCostLimit
+{
+	__block NSUInteger result = 0;
+	
+	dispatch_sync(internalQueue, ^{
+		
+		result = connectionDefaults.metadataCacheCostLimit;
+	});
+	
+	return result;
+}
+
+- (void)setDefaultMetadataCacheCostLimit:(NSUInteger)defaultMetadataCacheCostLimit
+{
+	dispatch_sync(internalQueue, ^{
+		
+		connectionDefaults.metadataCacheCostLimit = defaultMetadataCacheCostLimit;
+	});
+}
+
+- (YapDatabaseCacheCostBlock)defaultCacheCostBlock
+{
+	__block YapDatabaseCacheCostBlock result = nil;
+	
+	dispatch_sync(internalQueue, ^{
+		
+		result = connectionDefaults.cacheCostBlock;
+	});
+	
+	return result;
+}
+
+- (void)setDefaultCacheCostBlock:(YapDatabaseCacheCostBlock)defaultCacheCostBlock
+{
+	dispatch_sync(internalQueue, ^{
+		
+		connectionDefaults.cacheCostBlock = defaultCacheCostBlock;
+	});
+}
+
 #if TARGET_OS_IOS || TARGET_OS_TV
 
 - (YapDatabaseConnectionFlushMemoryFlags)defaultAutoFlushMemoryFlags
@@ -2175,6 +2345,11 @@ static int connectionBusyHandler(void *ptr, int count) {
 	if (result)
 	{
 		[extension didRegisterExtension];
+		
+		if (extension.populationBatchSize > 0)
+		{
+			[self _asyncPopulateExtension:extension withName:extensionName];
+		}
 	}
 	else
 	{
@@ -2186,6 +2361,46 @@ static int connectionBusyHandler(void *ptr, int count) {
 	return result;
 }
 
+/**
+ * Internal method that handles batched population of an extension (see YapDatabaseExtension.populationBatchSize).
+ *
+ * Each batch is its own readWrite transaction on the writeQueue.
+ * And each batch is queued behind whatever is already waiting on the writeQueue,
+ * so other readWrite transactions never wait on more than a single batch.
+**/
+- (void)_asyncPopulateExtension:(YapDatabaseExtension *)extension withName:(NSString *)extensionName
+{
+	dispatch_async(writeQueue, ^{ @autoreleasepool {
+		
+		if ([[self registeredExtensions] objectForKey:extensionName] != extension)
+		{
+			// The extension was unregistered in the meantime
+			return;
+		}
+		
+		YapDatabaseConnection *connection = [self registrationConnection];
+		
+		BOOL done = [connection populateExtensionWithName:extensionName batchSize:extension.populationBatchSize];
+		if (done)
+		{
+			YDBLogVerbose(@"Finished populating extension(%@)", extensionName);
+			
+			NSDictionary *userInfo = @{ YapDatabaseExtensionNameKey: extensionName };
+			
+			dispatch_async(dispatch_get_main_queue(), ^{
+				
+				[[NSNotificationCenter defaultCenter] postNotificationName:YapDatabaseExtensionPopulatedNotification
+				                                                    object:self
+				                                                  userInfo:userInfo];
+			});
+		}
+		else
+		{
+			[self _asyncPopulateExtension:extension withName:extensionName];
+		}
+	}});
+}
+
 /**
  * Internal method that handles extension unregistration.
  * This method must be invoked on the writeQueue.
@@ -2710,6 +2925,8 @@ static int connectionBusyHandler(void *ptr, int count) {
 	// which represents the most recent snapshot of the last committed readwrite transaction.
 	
 	snapshot = [[changeset objectForKey:YapDatabaseSnapshotKey] unsignedLongLongValue];
+	
+	[self noteCommitForCheckpointStats];
 
 	// Update registeredExtensions, if changed.
 	
@@ -2800,6 +3017,229 @@ static int connectionBusyHandler(void *ptr, int count) {
 #pragma mark Manual Checkpointing
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * How checkpointing works:
+ *
+ * The bulk of the work (copying frames from the WAL into the database file) is done with PASSIVE checkpoints
+ * on the checkpointQueue. These run in parallel with read-write transactions, and never block anybody.
+ *
+ * But a PASSIVE checkpoint can't shrink the WAL. Sqlite only resets the WAL when a writer finds that
+ * every frame has been checkpointed, and that no reader is still using the WAL.
+ * Under a steady stream of writes (or with long-lived read transactions) that moment may never come.
+ * So once everything has been copied, and the WAL has grown past a fraction of aggressiveWALTruncationSize,
+ * we briefly hop onto the writeQueue to RESTART or TRUNCATE it.
+ * Since there's nothing left to copy, this is quick, and the busy timeout is kept short.
+ *
+ * If a reader is holding frames we'd need, we nudge any long-lived read transactions
+ * and try again later, backing off exponentially.
+ *
+ * Only if the WAL keeps growing to twice aggressiveWALTruncationSize do we fall back to "aggressive" mode,
+ * which checkpoints after every commit until the WAL is back under control.
+**/
+
+/**
+ * The commit rate decays with this time constant (in seconds).
+**/
+static const double YDBCheckpointCommitRateTimeConstant = 1.0;
+
+/**
+ * Above this commit rate (per second) we assume the next writer is right around the corner.
+**/
+static const double YDBCheckpointBusyCommitRate = 20.0;
+
+/**
+ * Backoff used when a reader is pinning frames in the WAL: 10ms, 20ms, 40ms, ... up to 10ms << 7 (1.28s).
+**/
+static const uint64_t YDBCheckpointRetryBaseDelay = 10 * NSEC_PER_MSEC;
+static const NSUInteger YDBCheckpointRetryMaxBackoff = 7;
+
+static NSTimeInterval YDBMachTimeToSeconds(uint64_t elapsed)
+{
+	static mach_timebase_info_data_t timebase;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		mach_timebase_info(&timebase);
+	});
+	
+	return ((double)elapsed * timebase.numer / timebase.denom) / NSEC_PER_SEC;
+}
+
+/**
+ * This method is only accessible from within the snapshotQueue.
+ *
+ * Called for every commit, so the scheduler knows how busy the writers are.
+**/
+- (void)noteCommitForCheckpointStats
+{
+	uint64_t now = mach_absolute_time();
+	
+	YAPUnfairLockLock(&checkpointLock);
+	{
+		// Exponentially decaying event rate:
+		// each commit adds (1/tau), and the total decays with time constant tau.
+		// With a steady rate of N commits per second, this converges to N.
+		
+		double elapsed = checkpointState.lastCommitTime ? YDBMachTimeToSeconds(now - checkpointState.lastCommitTime) : 0.0;
+		
+		checkpointState.commitRate *= exp(-elapsed / YDBCheckpointCommitRateTimeConstant);
+		checkpointState.commitRate += (1.0 / YDBCheckpointCommitRateTimeConstant);
+		checkpointState.lastCommitTime = now;
+	}
+	YAPUnfairLockUnlock(&checkpointLock);
+}
+
+- (double)currentCommitRate
+{
+	uint64_t now = mach_absolute_time();
+	double commitRate = 0.0;
+	
+	YAPUnfairLockLock(&checkpointLock);
+	{
+		if (checkpointState.lastCommitTime)
+		{
+			double elapsed = YDBMachTimeToSeconds(now - checkpointState.lastCommitTime);
+			commitRate = checkpointState.commitRate * exp(-elapsed / YDBCheckpointCommitRateTimeConstant);
+		}
+	}
+	YAPUnfairLockUnlock(&checkpointLock);
+	
+	return commitRate;
+}
+
+/**
+ * Records the result of a successful checkpoint.
+ *
+ * The frame counts are straight from sqlite3_wal_checkpoint_v2,
+ * and writerStall is the (mach) time the checkpoint held up the writeQueue (zero if it ran elsewhere).
+**/
+- (void)noteCheckpointMode:(int)checkpointMode
+               totalFrames:(int)totalFrameCount
+        checkpointedFrames:(int)checkpointedFrameCount
+               writerStall:(uint64_t)writerStall
+{
+	if (totalFrameCount < 0 || checkpointedFrameCount < 0) return;
+	
+	YAPUnfairLockLock(&checkpointLock);
+	{
+		YapDatabaseCheckpointState *state = &checkpointState;
+		
+		// checkpointedFrameCount includes frames checkpointed by previous calls.
+		// Unless the WAL was reset in the meantime, in which case the counts start over.
+		
+		uint64_t delta;
+		if ((uint64_t)totalFrameCount < state->walFrameCount ||
+		    (uint64_t)checkpointedFrameCount < state->walCheckpointedFrameCount)
+		{
+			delta = (uint64_t)checkpointedFrameCount;
+		}
+		else
+		{
+			delta = (uint64_t)checkpointedFrameCount - state->walCheckpointedFrameCount;
+		}
+		
+		state->framesCheckpointed += delta;
+		state->walFrameCount = (uint64_t)totalFrameCount;
+		state->walCheckpointedFrameCount = (uint64_t)checkpointedFrameCount;
+		
+		if (checkpointMode == SQLITE_CHECKPOINT_TRUNCATE)
+		{
+			state->walFrameCount = 0;
+			state->walCheckpointedFrameCount = 0;
+		}
+		
+		uint64_t walSize = state->walFrameCount * pageSize;
+		state->peakWALSize = MAX(state->peakWALSize, walSize);
+		
+		switch (checkpointMode)
+		{
+			case SQLITE_CHECKPOINT_PASSIVE  : state->passiveCheckpointCount++;  break;
+			case SQLITE_CHECKPOINT_FULL     : state->fullCheckpointCount++;     break;
+			case SQLITE_CHECKPOINT_RESTART  : state->restartCheckpointCount++;  break;
+			case SQLITE_CHECKPOINT_TRUNCATE : state->truncateCheckpointCount++; break;
+		}
+		
+		state->writerStallTime += writerStall;
+		state->maxWriterStall = MAX(state->maxWriterStall, writerStall);
+	}
+	YAPUnfairLockUnlock(&checkpointLock);
+}
+
+- (void)noteWriterStall:(uint64_t)writerStall
+{
+	YAPUnfairLockLock(&checkpointLock);
+	{
+		checkpointState.writerStallTime += writerStall;
+		checkpointState.maxWriterStall = MAX(checkpointState.maxWriterStall, writerStall);
+	}
+	YAPUnfairLockUnlock(&checkpointLock);
+}
+
+/**
+ * Records that a checkpoint couldn't make progress because of a reader,
+ * and returns the delay to wait before trying again.
+**/
+- (uint64_t)noteBlockedCheckpoint
+{
+	// How far behind is the oldest reader ?
+	
+	__block uint64_t currentSnapshot = 0;
+	__block uint64_t oldestSnapshot = UINT64_MAX;
+	
+	dispatch_sync(snapshotQueue, ^{
+		
+		currentSnapshot = snapshot;
+		
+		for (YapDatabaseConnectionState *state in connectionStates)
+		{
+			if (state->activeReadTransaction)
+			{
+				oldestSnapshot = MIN(oldestSnapshot, state->lastTransactionSnapshot);
+			}
+		}
+	});
+	
+	uint64_t delay = 0;
+	
+	YAPUnfairLockLock(&checkpointLock);
+	{
+		checkpointState.blockedCheckpointCount++;
+		checkpointState.oldestReaderSnapshotLag =
+		  (oldestSnapshot < currentSnapshot) ? (currentSnapshot - oldestSnapshot) : 0;
+		
+		delay = YDBCheckpointRetryBaseDelay << checkpointState.backoff;
+		
+		if (checkpointState.backoff < YDBCheckpointRetryMaxBackoff) {
+			checkpointState.backoff++;
+		}
+	}
+	YAPUnfairLockUnlock(&checkpointLock);
+	
+	return delay;
+}
+
+- (void)resetCheckpointBackoff
+{
+	YAPUnfairLockLock(&checkpointLock);
+	{
+		checkpointState.backoff = 0;
+	}
+	YAPUnfairLockUnlock(&checkpointLock);
+}
+
+- (YapDatabaseCheckpointStats *)checkpointStats
+{
+	double commitRate = [self currentCommitRate];
+	YapDatabaseCheckpointState state;
+	
+	YAPUnfairLockLock(&checkpointLock);
+	{
+		state = checkpointState;
+	}
+	YAPUnfairLockUnlock(&checkpointLock);
+	
+	return [[YapDatabaseCheckpointStats alloc] initWithState:&state pageSize:pageSize commitRate:commitRate];
+}
+
 /**
  * This method should be called whenever the maximum checkpointable snapshot is incremented.
  * That is, the state of every connection is known to the system.
@@ -2875,12 +3315,94 @@ static int connectionBusyHandler(void *ptr, int count) {
 			return;
 		}
 		
+		uint64_t start = mach_absolute_time();
+		
 		[strongSelf aggressiveCheckpoint];
 		
+		[strongSelf noteWriterStall:(mach_absolute_time() - start)];
+		
 	#pragma clang diagnostic pop
 	});
 }
 
+/**
+ * Hops onto the writeQueue to reset the WAL (RESTART or TRUNCATE).
+ * Only worthwhile once a passive checkpoint has copied every frame.
+**/
+- (void)asyncResetWAL:(BOOL)truncate
+{
+	bool hasPendingCheckpoint = atomic_flag_test_and_set(&pendingWALReset);
+	if (hasPendingCheckpoint) {
+		return;
+	}
+	
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_async(writeQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic warning "-Wimplicit-retain-self"
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		atomic_flag_clear(&strongSelf->pendingWALReset);
+		
+		if (atomic_load(&strongSelf->aggressiveCheckpointEnabled)) {
+			return;
+		}
+		
+		uint64_t start = mach_absolute_time();
+		
+		BOOL blocked = ![strongSelf resetWAL:truncate];
+		
+		[strongSelf noteWriterStall:(mach_absolute_time() - start)];
+		
+		if (blocked) {
+			[strongSelf asyncRetryCheckpoint];
+		}
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
+/**
+ * A reader is holding onto frames we need.
+ * Nudge any long-lived read transactions, and try again later (with exponential backoff).
+**/
+- (void)asyncRetryCheckpoint
+{
+	bool hasPendingRetry = atomic_flag_test_and_set(&pendingCheckpointRetry);
+	if (hasPendingRetry) {
+		return;
+	}
+	
+	uint64_t delay = [self noteBlockedCheckpoint];
+	
+	YDBLogVerbose(@"Checkpoint blocked by reader, retrying in %llu ms", delay / NSEC_PER_MSEC);
+	
+	__weak YapDatabase *weakSelf = self;
+	
+	dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)delay), writeQueue, ^{ @autoreleasepool {
+	#pragma clang diagnostic push
+	#pragma clang diagnostic warning "-Wimplicit-retain-self"
+		
+		__strong YapDatabase *strongSelf = weakSelf;
+		if (strongSelf == nil) return;
+		
+		atomic_flag_clear(&strongSelf->pendingCheckpointRetry);
+		
+		uint64_t start = mach_absolute_time();
+		
+		[strongSelf tryResetLongLivedReadTransactions];
+		
+		[strongSelf noteWriterStall:(mach_absolute_time() - start)];
+		
+		[strongSelf asyncCheckpoint:0];
+		
+	#pragma clang diagnostic pop
+	}});
+}
+
 - (void)passiveCheckpoint
 {
 	int checkpointResult = 0;
@@ -2914,12 +3436,22 @@ static int connectionBusyHandler(void *ptr, int count) {
 		return;// from_block
 	}
 	
+	[self noteCheckpointMode:SQLITE_CHECKPOINT_PASSIVE
+	             totalFrames:totalFrameCount
+	      checkpointedFrames:checkpointedFrameCount
+	             writerStall:0];
+	
 	// Did we checkpoint the entire WAL file ?
 	
 	BOOL didCheckpointEntireWAL = (totalFrameCount == checkpointedFrameCount);
 	
+	uint64_t walApproximateFileSize = totalFrameCount * pageSize;
+	uint64_t walSizeLimit = options.aggressiveWALTruncationSize;
+	
 	if (didCheckpointEntireWAL)
 	{
+		[self resetCheckpointBackoff];
+		
 		// We've checkpointed every single frame in the WAL.
 		// This means the next read-write transaction may be able to reset the WAL (instead of appending to it).
 		//
@@ -2933,33 +3465,204 @@ static int connectionBusyHandler(void *ptr, int count) {
 		// The solution is to notify active long-lived connections, and tell them to re-begin their transaction
 		// on the same snapshot. But this time the sqlite machinery will read directly from the database,
 		// and thus unlock the WAL so it can be reset.
+		//
+		// If the WAL is already big, we don't wait for the next writer to get lucky:
+		//
+		// - Past the limit, we TRUNCATE it, so the file shrinks on disk too.
+		// - Past a quarter of the limit, with writes streaming in, we RESTART it.
+		//   The very next commit will then start over at the beginning of the WAL.
+		//   (With few writes, a reset is likely anyway, and a RESTART would be wasted effort.)
 		
-		__weak YapDatabase *weakSelf = self;
+		BOOL needsTruncate = (walApproximateFileSize >= walSizeLimit);
+		BOOL needsRestart = (walApproximateFileSize >= (walSizeLimit / 4)) &&
+		                    ([self currentCommitRate] >= YDBCheckpointBusyCommitRate);
 		
-		dispatch_async(writeQueue, ^{ @autoreleasepool {
-		#pragma clang diagnostic push
-		#pragma clang diagnostic warning "-Wimplicit-retain-self"
-			
-			__strong YapDatabase *strongSelf = weakSelf;
-			if (strongSelf == nil) return;
-			
-			[strongSelf tryResetLongLivedReadTransactions];
+		if (needsTruncate || needsRestart)
+		{
+			[self asyncResetWAL:needsTruncate];
+		}
+		else
+		{
+			__weak YapDatabase *weakSelf = self;
 			
-		#pragma clang diagnostic pop
-		}});
+			dispatch_async(writeQueue, ^{ @autoreleasepool {
+			#pragma clang diagnostic push
+			#pragma clang diagnostic warning "-Wimplicit-retain-self"
+				
+				__strong YapDatabase *strongSelf = weakSelf;
+				if (strongSelf == nil) return;
+				
+				uint64_t start = mach_absolute_time();
+				
+				[strongSelf tryResetLongLivedReadTransactions];
+				
+				[strongSelf noteWriterStall:(mach_absolute_time() - start)];
+				
+			#pragma clang diagnostic pop
+			}});
+		}
+	}
+	else if (walApproximateFileSize >= (walSizeLimit * 2))
+	{
+		// The WAL is way too big, and backing off hasn't helped.
+		// Fall back to checkpointing after every commit until it's under control.
+		
+		atomic_store(&aggressiveCheckpointEnabled, true);
+		
+		[self asyncAggressiveCheckpoint];
 	}
+	else if (walApproximateFileSize >= walSizeLimit)
+	{
+		// A reader is still using frames we'd like to checkpoint.
+		
+		[self asyncRetryCheckpoint];
+	}
+}
+
+/**
+ * Returns the checkpoint mode to use when we want the WAL file truncated.
+ * Falls back to SQLITE_CHECKPOINT_RESTART on versions of sqlite where TRUNCATE isn't reliable.
+**/
+- (int)truncateCheckpointMode
+{
+	// Can we use SQLITE_CHECKPOINT_TRUNCATE ?
+	//
+	// This feature was added in sqlite v3.8.8.
+	// But it was buggy until v3.8.8.2 when the following fix was added:
+	//
+	//   "Enhance sqlite3_wal_checkpoint_v2(TRUNCATE) interface so that it truncates the
+	//    WAL file even if there is no checkpoint work to be done."
+	//
+	//   http://www.sqlite.org/changes.html
+	//
+	// It is often the case, when we call checkpoint here, that there is no checkpoint work to be done.
+	// So we really can't depend on it until 3.8.8.2
 	
-	// Is the WAL file getting too big ?
+	int checkpointMode = SQLITE_CHECKPOINT_RESTART;
 	
-	uint64_t walApproximateFileSize = totalFrameCount * pageSize;
-	BOOL needsAggressiveCheckpoint = (walApproximateFileSize >= options.aggressiveWALTruncationSize);
+	// Remember: The compiler defines (SQLITE_VERSION, SQLITE_VERSION_NUMBER) only tell us
+	// what version we're compiling against. But we may encounter an earlier sqlite version at runtime.
+	
+#ifndef SQLITE_VERSION_NUMBER_3_8_8
+#define SQLITE_VERSION_NUMBER_3_8_8 3008008
+#endif
+	
+#if SQLITE_VERSION_NUMBER > SQLITE_VERSION_NUMBER_3_8_8
+	
+	checkpointMode = SQLITE_CHECKPOINT_TRUNCATE;
+	
+#elif SQLITE_VERSION_NUMBER == SQLITE_VERSION_NUMBER_3_8_8
 	
-	if (needsAggressiveCheckpoint)
+	NSComparisonResult cmp = [sqliteVersion compare:@"3.8.8.2" options:NSNumericSearch];
+	if (cmp != NSOrderedAscending)
 	{
-		atomic_store(&aggressiveCheckpointEnabled, true);
+		checkpointMode = SQLITE_CHECKPOINT_TRUNCATE;
+	}
+	
+#endif
+	
+	return checkpointMode;
+}
+
+/**
+ * Write something to the database to force restart the WAL.
+ * We're just going to set a random value in the yap2 table.
+**/
+- (void)forceWALRestart
+{
+	NSString *uuid = [[NSUUID UUID] UUIDString];
+	
+	[self beginTransaction];
+	
+	int status;
+	sqlite3_stmt *statement;
+	
+	char *stmt = "INSERT OR REPLACE INTO \"yap2\" (\"extension\", \"key\", \"data\") VALUES (?, ?, ?);";
+	
+	int const bind_extension = SQLITE_BIND_START + 0;
+	int const bind_key       = SQLITE_BIND_START + 1;
+	int const bind_data      = SQLITE_BIND_START + 2;
+	
+	status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+	}
+	else
+	{
+		char *extension = "";
+		sqlite3_bind_text(statement, bind_extension, extension, (int)strlen(extension), SQLITE_STATIC);
 		
-		[self asyncAggressiveCheckpoint];
+		char *key = "random";
+		sqlite3_bind_text(statement, bind_key, key, (int)strlen(key), SQLITE_STATIC);
+		
+		YapDatabaseString _uuid; MakeYapDatabaseString(&_uuid, uuid);
+		sqlite3_bind_text(statement, bind_data, _uuid.str, _uuid.length, SQLITE_STATIC);
+		
+		status = sqlite3_step(statement);
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
+		}
+		
+		sqlite3_finalize(statement);
+		FreeYapDatabaseString(&_uuid);
 	}
+	
+	[self commitTransaction];
+}
+
+/**
+ * Resets the WAL, assuming a passive checkpoint has just copied every frame.
+ * Returns NO if a reader prevented it.
+**/
+- (BOOL)resetWAL:(BOOL)truncate
+{
+	NSAssert(dispatch_get_specific(IsOnWriteQueueKey), @"Must go through writeQueue.");
+	
+	// We're holding up writers, so don't wait around for readers.
+	// And the busier the writers are, the less we're willing to wait.
+	
+	BOOL busy = ([self currentCommitRate] >= YDBCheckpointBusyCommitRate);
+	sqlite3_busy_timeout(db, (busy ? 5 : 20)); // milliseconds
+	
+	// Move any long-lived read transactions off the WAL (they'd block the reset every time).
+	
+	[self tryResetLongLivedReadTransactions];
+	
+	int checkpointMode = truncate ? [self truncateCheckpointMode] : SQLITE_CHECKPOINT_RESTART;
+	
+	int totalFrameCount = 0;
+	int checkpointedFrameCount = 0;
+	
+	int checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", checkpointMode,
+	                                                 &totalFrameCount, &checkpointedFrameCount);
+	
+	YDBLogVerbose(@"Post-checkpoint: src(e) mode(%@) result(%d) frames(%d) checkpointed(%d)",
+	              (checkpointMode == SQLITE_CHECKPOINT_RESTART ? @"restart" : @"truncate"),
+	              checkpointResult, totalFrameCount, checkpointedFrameCount);
+	
+	if (checkpointResult != SQLITE_OK)
+	{
+		if (checkpointResult != SQLITE_BUSY) {
+			YDBLogWarn(@"sqlite3_wal_checkpoint_v2 returned error code: %d", checkpointResult);
+		}
+		
+		return NO;
+	}
+	
+	if (truncate && (checkpointMode == SQLITE_CHECKPOINT_RESTART))
+	{
+		// Without TRUNCATE, the only way to shrink the WAL is to restart it right now.
+		[self forceWALRestart];
+	}
+	
+	[self noteCheckpointMode:checkpointMode
+	             totalFrames:totalFrameCount
+	      checkpointedFrames:checkpointedFrameCount
+	             writerStall:0];
+	
+	return YES;
 }
 
 - (void)aggressiveCheckpoint
@@ -2987,6 +3690,11 @@ static int connectionBusyHandler(void *ptr, int count) {
 	YDBLogInfo(@"Post-checkpoint: src(b) mode(full) result(%d) frames(%d) checkpointed(%d)",
 	           checkpointResult, totalFrameCount, checkpointedFrameCount);
 	
+	[self noteCheckpointMode:SQLITE_CHECKPOINT_FULL
+	             totalFrames:totalFrameCount
+	      checkpointedFrames:checkpointedFrameCount
+	             writerStall:0];
+	
 	if (totalFrameCount != checkpointedFrameCount)
 	{
 		return;
@@ -3011,41 +3719,7 @@ static int connectionBusyHandler(void *ptr, int count) {
 	// And every connection should be reading directly from the database.
 	// So we should be able to truncate the WAL file now.
 	
-	// Can we use SQLITE_CHECKPOINT_TRUNCATE ?
-	//
-	// This feature was added in sqlite v3.8.8.
-	// But it was buggy until v3.8.8.2 when the following fix was added:
-	//
-	//   "Enhance sqlite3_wal_checkpoint_v2(TRUNCATE) interface so that it truncates the
-	//    WAL file even if there is no checkpoint work to be done."
-	//
-	//   http://www.sqlite.org/changes.html
-	//
-	// It is often the case, when we call checkpoint here, that there is no checkpoint work to be done.
-	// So we really can't depend on it until 3.8.8.2
-	
-	int checkpointMode = SQLITE_CHECKPOINT_RESTART;
-	
-	// Remember: The compiler defines (SQLITE_VERSION, SQLITE_VERSION_NUMBER) only tell us
-	// what version we're compiling against. But we may encounter an earlier sqlite version at runtime.
-	
-#ifndef SQLITE_VERSION_NUMBER_3_8_8
-#define SQLITE_VERSION_NUMBER_3_8_8 3008008
-#endif
-	
-#if SQLITE_VERSION_NUMBER > SQLITE_VERSION_NUMBER_3_8_8
-	
-	checkpointMode = SQLITE_CHECKPOINT_TRUNCATE;
-	
-#elif SQLITE_VERSION_NUMBER == SQLITE_VERSION_NUMBER_3_8_8
-	
-	NSComparisonResult cmp = [strongSelf->sqliteVersion compare:@"3.8.8.2" options:NSNumericSearch];
-	if (cmp != NSOrderedAscending)
-	{
-		checkpointMode = SQLITE_CHECKPOINT_TRUNCATE;
-	}
-	
-#endif
+	int checkpointMode = [self truncateCheckpointMode];
 	
 	checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", checkpointMode,
 	                                             &totalFrameCount, &checkpointedFrameCount);
@@ -3058,51 +3732,16 @@ static int connectionBusyHandler(void *ptr, int count) {
 	{
 		if (checkpointMode == SQLITE_CHECKPOINT_RESTART)
 		{
-			// Write something to the database to force restart the WAL.
-			// We're just going to set a random value in the yap2 table.
-			
-			NSString *uuid = [[NSUUID UUID] UUIDString];
-			
-			[self beginTransaction];
-			
-			int status;
-			sqlite3_stmt *statement;
-			
-			char *stmt = "INSERT OR REPLACE INTO \"yap2\" (\"extension\", \"key\", \"data\") VALUES (?, ?, ?);";
-			
-			int const bind_extension = SQLITE_BIND_START + 0;
-			int const bind_key       = SQLITE_BIND_START + 1;
-			int const bind_data      = SQLITE_BIND_START + 2;
-			
-			status = sqlite3_prepare_v2(db, stmt, (int)strlen(stmt)+1, &statement, NULL);
-			if (status != SQLITE_OK)
-			{
-				YDBLogError(@"%@: Error creating statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-			}
-			else
-			{
-				char *extension = "";
-				sqlite3_bind_text(statement, bind_extension, extension, (int)strlen(extension), SQLITE_STATIC);
-				
-				char *key = "random";
-				sqlite3_bind_text(statement, bind_key, key, (int)strlen(key), SQLITE_STATIC);
-				
-				YapDatabaseString _uuid; MakeYapDatabaseString(&_uuid, uuid);
-				sqlite3_bind_text(statement, bind_data, _uuid.str, _uuid.length, SQLITE_STATIC);
-				
-				status = sqlite3_step(statement);
-				if (status != SQLITE_DONE)
-				{
-					YDBLogError(@"%@: Error in statement: %d %s", THIS_METHOD, status, sqlite3_errmsg(db));
-				}
-				
-				sqlite3_finalize(statement);
-				FreeYapDatabaseString(&_uuid);
-			}
-			
-			[self commitTransaction];
+			[self forceWALRestart];
 		}
 		
+		[self noteCheckpointMode:checkpointMode
+		             totalFrames:totalFrameCount
+		      checkpointedFrames:checkpointedFrameCount
+		             writerStall:0];
+		
+		[self resetCheckpointBackoff];
+		
 		atomic_store(&aggressiveCheckpointEnabled, false);
 	}
 }
@@ -3170,8 +3809,15 @@ static int connectionBusyHandler(void *ptr, int count) {
 	return atomic_load(&aggressiveCheckpointEnabled);
 }
 
-- (void)noteCheckpointWithTotalFrames:(int)totalFrameCount checkpointedFrames:(int)checkpointedFrameCount
+- (void)noteCheckpointWithTotalFrames:(int)totalFrameCount
+                  checkpointedFrames:(int)checkpointedFrameCount
+                         writerStall:(uint64_t)writerStall
 {
+	[self noteCheckpointMode:SQLITE_CHECKPOINT_PASSIVE
+	             totalFrames:totalFrameCount
+	      checkpointedFrames:checkpointedFrameCount
+	             writerStall:writerStall];
+	
 	uint64_t walApproximateFileSize = totalFrameCount * pageSize;
 	
 	if (walApproximateFileSize < options.aggressiveWALTruncationSize)
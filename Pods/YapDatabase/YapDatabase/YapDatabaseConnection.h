@@ -77,6 +77,28 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 	                                                    YapDatabaseConnectionFlushMemoryFlags_Internal   ),
 };
 
+/**
+ * The type of cache used for the objectCache & metadataCache.
+ *
+ * YapDatabaseConnectionCacheType_Strict:
+ *     A YapCache. Strict LRU ordering, bounded only by count.
+ *
+ * YapDatabaseConnectionCacheType_Clock:
+ *     A YapClockCache. Approximate LRU ordering (CLOCK), bounded by count and by cost.
+ *     Cache hits are cheaper, and large objects can't crowd out everything else.
+ *     @see YapDatabaseConnection cacheCostBlock
+**/
+typedef NS_ENUM(NSInteger, YapDatabaseConnectionCacheType) {
+	YapDatabaseConnectionCacheType_Strict = 0,
+	YapDatabaseConnectionCacheType_Clock  = 1,
+};
+
+/**
+ * Returns the approximate cost (in bytes) of caching the given object (or metadata).
+ * The collection is passed along so that the cost can be computed on a per-collection basis.
+**/
+typedef NSUInteger (^YapDatabaseCacheCostBlock)(NSString *collection, NSString *key, id object);
+
 
 
 @interface YapDatabaseConnection : NSObject
@@ -149,6 +171,51 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 @property (atomic, assign, readwrite) BOOL metadataCacheEnabled;
 @property (atomic, assign, readwrite) NSUInteger metadataCacheLimit;
 
+/**
+ * The cacheType determines which kind of cache is used for the objectCache & metadataCache.
+ * 
+ * The default (YapDatabaseConnectionCacheType_Strict) bounds the caches by count only.
+ * This works well when objects are roughly the same size, but a few large objects
+ * may use as much memory as thousands of small ones.
+ * 
+ * With YapDatabaseConnectionCacheType_Clock, every cached item is assigned a cost via the cacheCostBlock,
+ * and the caches are additionally bounded by the objectCacheCostLimit & metadataCacheCostLimit.
+ * A cost limit of zero means no cost limit (the cache is then bounded by count alone).
+ * If no cacheCostBlock is set, every item has a cost of 1.
+ * 
+ * Changing the cacheType empties the objectCache & metadataCache.
+ * Changing the cacheCostBlock only affects items cached afterwards.
+ * 
+ * By default the cacheType is YapDatabaseConnectionCacheType_Strict, and there are no cost limits.
+ * 
+ * @see YapDatabase defaultCacheType
+ * @see YapDatabase defaultObjectCacheCostLimit
+ * @see YapDatabase defaultMetadataCacheCostLimit
+ * @see YapDatabase defaultCacheCostBlock
+**/
+@property (atomic, assign, readwrite) YapDatabaseConnectionCacheType cacheType;
+@property (atomic, assign, readwrite) NSUInteger objectCacheCostLimit;
+@property (atomic, assign, readwrite) NSUInteger metadataCacheCostLimit;
+@property (atomic, copy, readwrite, nullable) YapDatabaseCacheCostBlock cacheCostBlock;
+
+/**
+ * Queries which aren't known ahead of time (e.g. objectsForKeys:inCollection: with N keys,
+ * secondary index & full text search queries, nested enumerations, etc) are prepared on demand.
+ * Rather than finalizing them after every use, the connection keeps the most recently used ones around,
+ * keyed by their SQL, so that repeating the same query skips sqlite3_prepare_v2.
+ *
+ * The statementCacheLimit is the maximum number of such statements to keep.
+ * Set it to zero for an unlimited cache.
+ * The cache is emptied whenever prepared statements are flushed (YapDatabaseConnectionFlushMemoryFlags_Statements).
+ *
+ * By default the statementCacheLimit is 40.
+ * 
+ * The hit & miss counts are cumulative, and may be used to tune the limit.
+**/
+@property (atomic, assign, readwrite) NSUInteger statementCacheLimit;
+@property (atomic, assign, readonly) NSUInteger statementCacheHitCount;
+@property (atomic, assign, readonly) NSUInteger statementCacheMissCount;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Policy
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -283,6 +350,55 @@ typedef NS_OPTIONS(NSUInteger, YapDatabaseConnectionFlushMemoryFlags) {
 **/
 @property (atomic, assign, readonly) uint64_t snapshot;
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Group Commit
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Group commit allows many small asyncReadWrite transactions to share a single sqlite transaction.
+ *
+ * Every read-write transaction has a fixed cost, regardless of how little it does:
+ * BEGIN IMMEDIATE, a commit (and thus a WAL write + fsync), a snapshot increment,
+ * changeset propagation to every sibling connection, and a YapDatabaseModifiedNotification.
+ * If your app issues a lot of tiny independent asyncReadWrite transactions (e.g. saving a single object),
+ * this fixed cost dominates.
+ *
+ * When group commit is enabled, asyncReadWrite blocks that are queued on this connection
+ * (up to groupCommitLimit of them, and within groupCommitWindow of the first one)
+ * are executed back-to-back within a single sqlite transaction.
+ *
+ * - Each block is still handed a transaction, and executes in the order it was queued.
+ * - Each completionBlock is still invoked (in order), once the shared transaction has been committed.
+ * - Any other transaction type queued on this connection (sync or async) closes the group,
+ *   so the FIFO ordering of this connection is unchanged.
+ *
+ * Failures are isolated:
+ * Each block runs within its own sqlite savepoint. If a block invokes [transaction rollback],
+ * then only the changes made by that block are rolled back, and the group carries on.
+ * Every block is executed exactly once.
+ *
+ * This requires every registered extension to support savepoints (secondary indexes, full text search,
+ * hooks and persistent views do). If one doesn't (e.g. non-persistent views or search results views),
+ * the blocks of a group are executed one transaction at a time.
+ *
+ * A view copies its in-memory changes for each savepoint, so the savings are smaller for connections
+ * that write to large views.
+ *
+ * groupCommitLimit:
+ *   The maximum number of asyncReadWrite blocks that may share a single transaction.
+ *   A value of 0 or 1 disables group commit.
+ *
+ * groupCommitWindow:
+ *   How long (in seconds) a group waits for additional blocks before it starts executing.
+ *   The connection isn't blocked in the meantime.
+ *   A value of zero means a group doesn't wait at all, and only contains the blocks that were queued
+ *   while the connection was busy with previous transactions (which is the common case anyway).
+ *
+ * The default values are zero (group commit is disabled).
+**/
+@property (atomic, assign, readwrite) NSUInteger groupCommitLimit;
+@property (atomic, assign, readwrite) NSTimeInterval groupCommitWindow;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Transactions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
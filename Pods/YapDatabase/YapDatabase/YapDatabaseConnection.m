@@ -1,14 +1,17 @@
 #import "YapDatabaseConnection.h"
 
 #import "YapCache.h"
+#import "YapClockCache.h"
 #import "YapCollectionKey.h"
+#import "YapDatabaseAtomic.h"
 #import "YapDatabaseConnectionState.h"
 #import "YapDatabaseExtensionPrivate.h"
 #import "YapDatabaseLogging.h"
 #import "YapDatabasePrivate.h"
+#import "YapDatabaseStatementCache.h"
 #import "YapDatabaseString.h"
 #import "YapNull.h"
-#import "YapSet.h"
+#import "YapCompactChangeset.h"
 #import "YapTouch.h"
 
 #import <objc/runtime.h>
@@ -83,6 +86,44 @@ static int connectionBusyHandler(void *ptr, int count)
 	return 1;
 }
 
+/**
+ * A single asyncReadWrite block (and its completion), queued for group commit.
+**/
+@interface YapDatabaseGroupCommitItem : NSObject {
+@public
+	void (^block)(YapDatabaseReadWriteTransaction *transaction);
+	dispatch_queue_t completionQueue;
+	dispatch_block_t completionBlock;
+}
+@end
+
+@implementation YapDatabaseGroupCommitItem
+@end
+
+/**
+ * A group of asyncReadWrite blocks that will be executed within a single read-write transaction.
+ *
+ * Items are appended (from any thread) while the group is open, and never again once it's closed.
+**/
+@interface YapDatabaseGroupCommit : NSObject {
+@public
+	NSMutableArray<YapDatabaseGroupCommitItem *> *items;
+}
+@end
+
+@implementation YapDatabaseGroupCommit
+
+- (instancetype)init
+{
+	if ((self = [super init]))
+	{
+		items = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+@end
+
 @implementation YapDatabaseConnection {
 @private
 	
@@ -147,6 +188,19 @@ static int connectionBusyHandler(void *ptr, int count)
 	sqlite3_stmt *enumerateKeysAndObjectsInAllCollectionsStatement;
 	sqlite3_stmt *enumerateRowsInCollectionStatement;
 	sqlite3_stmt *enumerateRowsInAllCollectionsStatement;
+	
+	YapDatabaseStatementCache *statementCache; // For dynamic queries, see cachedStatementForQuery:
+	NSUInteger statementCacheLimit;
+	
+	YapDatabaseConnectionCacheType cacheType;
+	NSUInteger objectCacheCostLimit;
+	NSUInteger metadataCacheCostLimit;
+	YapDatabaseCacheCostBlock cacheCostBlock;
+	
+	YAPUnfairLock groupCommitLock;
+	NSUInteger groupCommitLimit;         // must hold groupCommitLock
+	NSTimeInterval groupCommitWindow;    // must hold groupCommitLock
+	YapDatabaseGroupCommit *openGroupCommit; // must hold groupCommitLock
 }
 
 + (void)load
@@ -194,6 +248,8 @@ static int connectionBusyHandler(void *ptr, int count)
 		throwExceptionsForImplicitlyEndingLongLivedReadTransaction = NO;
 	#endif
 		
+		groupCommitLock = YAP_UNFAIR_LOCK_INIT;
+		
 		pendingChangesets = [[NSMutableArray alloc] init];
 		processedChangesets = [[NSMutableArray alloc] init];
 		
@@ -211,6 +267,12 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		objectCacheLimit = defaults.objectCacheLimit;
 		metadataCacheLimit = defaults.metadataCacheLimit;
+		statementCacheLimit = defaults.statementCacheLimit;
+		
+		cacheType = defaults.cacheType;
+		objectCacheCostLimit = defaults.objectCacheCostLimit;
+		metadataCacheCostLimit = defaults.metadataCacheCostLimit;
+		cacheCostBlock = defaults.cacheCostBlock;
 		
 		if (defaults.objectCacheEnabled)
 		{
@@ -503,6 +565,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	sqlite_finalize_null(&enumerateKeysAndObjectsInAllCollectionsStatement);
 	sqlite_finalize_null(&enumerateRowsInCollectionStatement);
 	sqlite_finalize_null(&enumerateRowsInAllCollectionsStatement);
+	
+	[statementCache removeAllStatements];
 }
 
 - (void)_flushMemoryWithFlags:(YapDatabaseConnectionFlushMemoryFlags)flags
@@ -749,6 +813,227 @@ static int connectionBusyHandler(void *ptr, int count)
 		dispatch_async(connectionQueue, block);
 }
 
+- (YapDatabaseConnectionCacheType)cacheType
+{
+	__block YapDatabaseConnectionCacheType result = YapDatabaseConnectionCacheType_Strict;
+	
+	dispatch_block_t block = ^{
+		result = cacheType;
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (void)setCacheType:(YapDatabaseConnectionCacheType)newCacheType
+{
+	dispatch_block_t block = ^{
+		
+		// sanity check
+		switch (newCacheType)
+		{
+			case YapDatabaseConnectionCacheType_Strict :
+			case YapDatabaseConnectionCacheType_Clock  : break;
+			default                                    : return; // ignore invalid value
+		}
+		
+		if (cacheType != newCacheType)
+		{
+			cacheType = newCacheType;
+			
+			// Swap out the existing caches (if enabled) for the new type.
+			// They start out empty, which is always safe.
+			
+			if (objectCache) {
+				[self initializeObjectCache];
+			}
+			if (metadataCache) {
+				[self initializeMetadataCache];
+			}
+		}
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+- (NSUInteger)objectCacheCostLimit
+{
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+		result = objectCacheCostLimit;
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (void)setObjectCacheCostLimit:(NSUInteger)newObjectCacheCostLimit
+{
+	dispatch_block_t block = ^{
+		
+		objectCacheCostLimit = newObjectCacheCostLimit;
+		
+		if ([objectCache isKindOfClass:[YapClockCache class]]) {
+			((YapClockCache *)objectCache).costLimit = objectCacheCostLimit;
+		}
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+- (NSUInteger)metadataCacheCostLimit
+{
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+		result = metadataCacheCostLimit;
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (void)setMetadataCacheCostLimit:(NSUInteger)newMetadataCacheCostLimit
+{
+	dispatch_block_t block = ^{
+		
+		metadataCacheCostLimit = newMetadataCacheCostLimit;
+		
+		if ([metadataCache isKindOfClass:[YapClockCache class]]) {
+			((YapClockCache *)metadataCache).costLimit = metadataCacheCostLimit;
+		}
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+- (YapDatabaseCacheCostBlock)cacheCostBlock
+{
+	__block YapDatabaseCacheCostBlock result = nil;
+	
+	dispatch_block_t block = ^{
+		result = cacheCostBlock;
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (void)setCacheCostBlock:(YapDatabaseCacheCostBlock)newCacheCostBlock
+{
+	YapDatabaseCacheCostBlock newBlock = [newCacheCostBlock copy];
+	
+	dispatch_block_t block = ^{
+		
+		cacheCostBlock = newBlock;
+		
+		YapClockCacheCostBlock clockCacheCostBlock = [self clockCacheCostBlock];
+		
+		if ([objectCache isKindOfClass:[YapClockCache class]]) {
+			((YapClockCache *)objectCache).costBlock = clockCacheCostBlock;
+		}
+		if ([metadataCache isKindOfClass:[YapClockCache class]]) {
+			((YapClockCache *)metadataCache).costBlock = clockCacheCostBlock;
+		}
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+- (NSUInteger)statementCacheLimit
+{
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+		result = statementCacheLimit;
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (void)setStatementCacheLimit:(NSUInteger)newStatementCacheLimit
+{
+	dispatch_block_t block = ^{
+		
+		if (statementCacheLimit != newStatementCacheLimit)
+		{
+			statementCacheLimit = newStatementCacheLimit;
+			statementCache.countLimit = statementCacheLimit;
+		}
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_async(connectionQueue, block);
+}
+
+- (NSUInteger)statementCacheHitCount
+{
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+		result = statementCache.hitCount;
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
+- (NSUInteger)statementCacheMissCount
+{
+	__block NSUInteger result = 0;
+	
+	dispatch_block_t block = ^{
+		result = statementCache.missCount;
+	};
+	
+	if (dispatch_get_specific(IsOnConnectionQueueKey))
+		block();
+	else
+		dispatch_sync(connectionQueue, block);
+	
+	return result;
+}
+
 - (YapDatabasePolicy)objectPolicy
 {
 	__block YapDatabasePolicy policy = YapDatabasePolicyContainment;
@@ -837,26 +1122,102 @@ static int connectionBusyHandler(void *ptr, int count)
 	return result;
 }
 
+- (NSUInteger)groupCommitLimit
+{
+	YAPUnfairLockLock(&groupCommitLock);
+	NSUInteger result = groupCommitLimit;
+	YAPUnfairLockUnlock(&groupCommitLock);
+	
+	return result;
+}
+
+- (void)setGroupCommitLimit:(NSUInteger)newGroupCommitLimit
+{
+	YAPUnfairLockLock(&groupCommitLock);
+	groupCommitLimit = newGroupCommitLimit;
+	YAPUnfairLockUnlock(&groupCommitLock);
+	
+	// Any group that's currently open was sized using the old limit
+	[self closeGroupCommit];
+}
+
+- (NSTimeInterval)groupCommitWindow
+{
+	YAPUnfairLockLock(&groupCommitLock);
+	NSTimeInterval result = groupCommitWindow;
+	YAPUnfairLockUnlock(&groupCommitLock);
+	
+	return result;
+}
+
+- (void)setGroupCommitWindow:(NSTimeInterval)newGroupCommitWindow
+{
+	YAPUnfairLockLock(&groupCommitLock);
+	groupCommitWindow = MAX(0.0, newGroupCommitWindow);
+	YAPUnfairLockUnlock(&groupCommitLock);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Utilities
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 - (void)initializeObjectCache
 {
-	objectCache = [[YapCache alloc] initWithCountLimit:objectCacheLimit
-	                                      keyCallbacks:[YapCollectionKey keyCallbacks]];
+	if (cacheType == YapDatabaseConnectionCacheType_Clock)
+	{
+		YapClockCache *clockCache = [[YapClockCache alloc] initWithCountLimit:objectCacheLimit
+		                                                            costLimit:objectCacheCostLimit
+		                                                         keyCallbacks:[YapCollectionKey keyCallbacks]];
+		clockCache.costBlock = [self clockCacheCostBlock];
+		
+		objectCache = clockCache;
+	}
+	else
+	{
+		objectCache = [[YapCache alloc] initWithCountLimit:objectCacheLimit
+		                                      keyCallbacks:[YapCollectionKey keyCallbacks]];
+	}
 	
 	objectCache.allowedKeyClasses = [NSSet setWithObject:[YapCollectionKey class]];
 }
 
 - (void)initializeMetadataCache
 {
-	metadataCache = [[YapCache alloc] initWithCountLimit:metadataCacheLimit
-	                                        keyCallbacks:[YapCollectionKey keyCallbacks]];
+	if (cacheType == YapDatabaseConnectionCacheType_Clock)
+	{
+		YapClockCache *clockCache = [[YapClockCache alloc] initWithCountLimit:metadataCacheLimit
+		                                                            costLimit:metadataCacheCostLimit
+		                                                         keyCallbacks:[YapCollectionKey keyCallbacks]];
+		clockCache.costBlock = [self clockCacheCostBlock];
+		
+		metadataCache = clockCache;
+	}
+	else
+	{
+		metadataCache = [[YapCache alloc] initWithCountLimit:metadataCacheLimit
+		                                        keyCallbacks:[YapCollectionKey keyCallbacks]];
+	}
 	
 	metadataCache.allowedKeyClasses = [NSSet setWithObject:[YapCollectionKey class]];
 }
 
+/**
+ * Adapts the (public) cacheCostBlock, which deals in collection/key pairs,
+ * to the YapClockCache costBlock, which deals in YapCollectionKeys.
+**/
+- (YapClockCacheCostBlock)clockCacheCostBlock
+{
+	YapDatabaseCacheCostBlock costBlock = cacheCostBlock;
+	if (costBlock == nil) return nil;
+	
+	return ^NSUInteger (id key, id object){
+		
+		__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+		
+		return costBlock(cacheKey.collection, cacheKey.key, object);
+	};
+}
+
 - (NSUInteger)calculateKeyCacheLimit
 {
 	NSUInteger keyCacheLimit = MIN_KEY_CACHE_LIMIT;
@@ -898,6 +1259,13 @@ static int connectionBusyHandler(void *ptr, int count)
 		config.metadataCacheEnabled = (metadataCache != nil);
 		config.metadataCacheLimit = metadataCacheLimit;
 		
+		config.statementCacheLimit = statementCacheLimit;
+		
+		config.cacheType = cacheType;
+		config.objectCacheCostLimit = objectCacheCostLimit;
+		config.metadataCacheCostLimit = metadataCacheCostLimit;
+		config.cacheCostBlock = cacheCostBlock;
+		
 		config.objectPolicy = objectPolicy;
 		config.metadataPolicy = metadataPolicy;
 		
@@ -922,6 +1290,13 @@ static int connectionBusyHandler(void *ptr, int count)
 	self.metadataCacheEnabled = config.metadataCacheEnabled;
 	self.metadataCacheLimit = config.metadataCacheLimit;
 	
+	self.statementCacheLimit = config.statementCacheLimit;
+	
+	self.cacheType = config.cacheType;
+	self.objectCacheCostLimit = config.objectCacheCostLimit;
+	self.metadataCacheCostLimit = config.metadataCacheCostLimit;
+	self.cacheCostBlock = config.cacheCostBlock;
+	
 	self.objectPolicy = config.objectPolicy;
 	self.metadataPolicy = config.metadataPolicy;
 	
@@ -934,6 +1309,24 @@ static int connectionBusyHandler(void *ptr, int count)
 #pragma mark Statements
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Returns a prepared statement for the given (dynamic) query, via the connection's statement cache.
+ * 
+ * The statement remains owned by the cache.
+ * When done with it, the caller must reset it (sqlite3_clear_bindings + sqlite3_reset), and must NOT finalize it.
+ * 
+ * Returns NULL if the statement couldn't be prepared (the error is logged).
+**/
+- (sqlite3_stmt *)cachedStatementForQuery:(NSString *)query
+{
+	if (statementCache == nil)
+	{
+		statementCache = [[YapDatabaseStatementCache alloc] initWithDatabase:db countLimit:statementCacheLimit];
+	}
+	
+	return [statementCache statementForQuery:query];
+}
+
 - (sqlite3_stmt *)beginTransactionStatement
 {
 	sqlite3_stmt **statement = &beginTransactionStatement;
@@ -1450,8 +1843,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1491,8 +1884,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1532,8 +1925,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1573,8 +1966,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1614,8 +2007,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1656,8 +2049,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1697,8 +2090,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1739,8 +2132,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1781,8 +2174,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1823,8 +2216,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else if (sqlite3_stmt_busy(*statement))
 	{
-		result = CreateStatement();
-		needsFinalize = YES;
+		// Nested enumeration. Borrow another statement from the cache rather than preparing a throwaway one.
+		result = [self cachedStatementForQuery:@(sqlite3_sql(*statement))];
 	}
 	else
 	{
@@ -1878,6 +2271,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 #endif
 	
+	[self closeGroupCommit];
+	
 	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
 		
 		if (longLivedReadTransaction)
@@ -1938,6 +2333,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	// Once we're inside the database writeQueue, we know that we are the only write transaction.
 	// No other transaction can possibly modify the database except us, even in other connections.
 	
+	[self closeGroupCommit];
+	
 	dispatch_sync(connectionQueue, ^{
 		
 		if (longLivedReadTransaction)
@@ -2041,6 +2438,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (completionQueue == NULL && completionBlock != NULL)
 		completionQueue = dispatch_get_main_queue();
 	
+	[self closeGroupCommit];
+	
 	dispatch_async(connectionQueue, ^{ @autoreleasepool {
 		
 		if (longLivedReadTransaction)
@@ -2124,6 +2523,12 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (completionQueue == NULL && completionBlock != NULL)
 		completionQueue = dispatch_get_main_queue();
 	
+	if ([self enqueueGroupCommitBlock:block completionQueue:completionQueue completionBlock:completionBlock])
+	{
+		// The block will be executed as part of a group commit.
+		return;
+	}
+	
 	// Order matters.
 	// First go through the serial connection queue.
 	// Then go through serial write queue for the database.
@@ -2204,10 +2609,326 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (completionQueue == NULL && completionBlock != NULL)
 		completionQueue = dispatch_get_main_queue();
 	
-	dispatch_async(connectionQueue, ^{
-		
-		dispatch_async(completionQueue, completionBlock);
-	});
+	[self closeGroupCommit];
+	
+	dispatch_async(connectionQueue, ^{
+		
+		dispatch_async(completionQueue, completionBlock);
+	});
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Group Commit
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Invoked by asyncReadWriteWithBlock:completionQueue:completionBlock:.
+ *
+ * If group commit is enabled, adds the block to the open group (creating a new group if needed),
+ * and returns YES. Otherwise returns NO, and the caller should execute the block in its own transaction.
+**/
+- (BOOL)enqueueGroupCommitBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+                completionQueue:(dispatch_queue_t)completionQueue
+                completionBlock:(dispatch_block_t)completionBlock
+{
+	BOOL enqueued = NO;
+	YapDatabaseGroupCommit *newGroup = nil;
+	dispatch_time_t deadline = 0;
+	
+	YAPUnfairLockLock(&groupCommitLock);
+	{
+		if (groupCommitLimit > 1)
+		{
+			YapDatabaseGroupCommitItem *item = [[YapDatabaseGroupCommitItem alloc] init];
+			item->block = block;
+			item->completionQueue = completionQueue;
+			item->completionBlock = completionBlock;
+			
+			if (openGroupCommit == nil)
+			{
+				newGroup = [[YapDatabaseGroupCommit alloc] init];
+				deadline = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(groupCommitWindow * NSEC_PER_SEC));
+				
+				openGroupCommit = newGroup;
+			}
+			
+			[openGroupCommit->items addObject:item];
+			enqueued = YES;
+			
+			if (openGroupCommit->items.count >= groupCommitLimit)
+			{
+				[self _closeOpenGroupCommit];
+			}
+		}
+		else if (openGroupCommit)
+		{
+			// Group commit was disabled while a group was open.
+			[self _closeOpenGroupCommit];
+		}
+	}
+	YAPUnfairLockUnlock(&groupCommitLock);
+	
+	if (newGroup)
+	{
+		// Give other blocks a chance to join the group (until the window expires).
+		//
+		// Nothing sits on the connectionQueue in the meantime, so reads (and changesets from sibling connections)
+		// aren't held up by an open group. The timer fires on the connectionQueue, so with a zero window
+		// the group still picks up every block that gets queued while the connection is busy.
+		
+		dispatch_after(deadline, connectionQueue, ^{ @autoreleasepool {
+			
+			BOOL isOpen = NO;
+			
+			YAPUnfairLockLock(&groupCommitLock);
+			if (openGroupCommit == newGroup)
+			{
+				openGroupCommit = nil;
+				isOpen = YES;
+			}
+			YAPUnfairLockUnlock(&groupCommitLock);
+			
+			// If the group was closed by someone else, it has already been queued for execution.
+			
+			if (isOpen) {
+				[self executeGroupCommit:newGroup];
+			}
+		}});
+	}
+	
+	return enqueued;
+}
+
+/**
+ * Closes the open group (if any), so that subsequent asyncReadWrite blocks start a new group.
+ * This must be invoked before queueing any other type of transaction on the connectionQueue.
+**/
+- (void)closeGroupCommit
+{
+	YAPUnfairLockLock(&groupCommitLock);
+	{
+		if (openGroupCommit) {
+			[self _closeOpenGroupCommit];
+		}
+	}
+	YAPUnfairLockUnlock(&groupCommitLock);
+}
+
+/**
+ * Closes the open group, and queues it for execution.
+ * Must hold groupCommitLock.
+ *
+ * Order matters.
+ * The group is queued while the lock is held, so that it goes onto the connectionQueue before anything
+ * queued by whoever sees the group closed next. (Which is why every other type of transaction invokes
+ * closeGroupCommit before going through the queue.)
+**/
+- (void)_closeOpenGroupCommit
+{
+	YapDatabaseGroupCommit *group = openGroupCommit;
+	openGroupCommit = nil;
+	
+	dispatch_async(connectionQueue, ^{ @autoreleasepool {
+		
+		[self executeGroupCommit:group];
+	}});
+}
+
+- (void)executeGroupCommit:(YapDatabaseGroupCommit *)group
+{
+	NSAssert(dispatch_get_specific(IsOnConnectionQueueKey), @"Must go through connectionQueue.");
+	
+	// The group is closed, so group->items is no longer mutated.
+	
+	NSArray<YapDatabaseGroupCommitItem *> *items = group->items;
+	NSUInteger itemCount = items.count;
+	
+	if (longLivedReadTransaction)
+	{
+		if (throwExceptionsForImplicitlyEndingLongLivedReadTransaction)
+		{
+			@throw [self implicitlyEndingLongLivedReadTransactionException];
+		}
+		else
+		{
+			YDBLogWarn(@"Implicitly ending long-lived read transaction on connection %@, database %@",
+			           self, database);
+			
+			[self endLongLivedReadTransaction];
+		}
+	}
+	
+	__block NSUInteger index = 0;
+	while (index < itemCount)
+	{
+		dispatch_sync(database->writeQueue, ^{ @autoreleasepool {
+			
+			YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
+			
+			[self preReadWriteTransaction:transaction];
+			
+			// Blocks can only share the transaction if each one of them can be rolled back on its own.
+			// Otherwise they're executed one transaction at a time.
+			
+			BOOL useSavepoints = ((itemCount - index) > 1) && [self extensionsSupportSavepoints:transaction];
+			NSUInteger firstIndex = index;
+			
+			do
+			{
+				void (^block)(YapDatabaseReadWriteTransaction *) = items[index]->block;
+				
+				if (useSavepoints && [self executeBlock:block withinSavepointOfTransaction:transaction])
+				{
+					// Done. (If the block was rolled back, only its own changes were undone.)
+				}
+				else
+				{
+					if (useSavepoints)
+					{
+						// Couldn't create the savepoint.
+						// So this block goes last, and a rollback applies to the transaction as a whole.
+						
+						useSavepoints = NO;
+						
+						if (index > firstIndex) break;
+					}
+					
+					@autoreleasepool {
+						block(transaction);
+					}
+				}
+				
+				index++;
+				
+			} while (useSavepoints && !transaction->rollback && index < itemCount);
+			
+			[self postReadWriteTransaction:transaction];
+			
+			if (transaction->completionBlockStack)
+			{
+				NSUInteger count = transaction->completionBlockStack.count;
+				for (NSUInteger i = 0; i < count; i++)
+				{
+					dispatch_queue_t stackItemQueue = transaction->completionQueueStack[i];
+					dispatch_block_t stackItemBlock = transaction->completionBlockStack[i];
+					
+					dispatch_async(stackItemQueue, stackItemBlock);
+				}
+			}
+			
+			for (NSUInteger i = firstIndex; i < index; i++)
+			{
+				YapDatabaseGroupCommitItem *item = items[i];
+				
+				if (item->completionBlock)
+					dispatch_async(item->completionQueue, item->completionBlock);
+			}
+			
+		}}); // End dispatch_sync(database->writeQueue)
+	}
+}
+
+/**
+ * Returns YES if every extension in the transaction can be rolled back to a savepoint.
+**/
+- (BOOL)extensionsSupportSavepoints:(YapDatabaseReadWriteTransaction *)transaction
+{
+	for (YapDatabaseExtensionTransaction *extTransaction in [transaction orderedExtensions])
+	{
+		if (![extTransaction supportsSavepoints]) return NO;
+	}
+	
+	return YES;
+}
+
+- (BOOL)executeSavepointStatement:(const char *)stmt
+{
+	int status = sqlite3_exec(db, stmt, NULL, NULL, NULL);
+	if (status != SQLITE_OK)
+	{
+		YDBLogError(@"Error executing '%s': %d %s", stmt, status, sqlite3_errmsg(db));
+		return NO;
+	}
+	
+	return YES;
+}
+
+/**
+ * Executes a block from a group commit within its own sqlite savepoint.
+ * If the block invokes [transaction rollback], then only the changes made by the block are rolled back,
+ * and the shared transaction carries on.
+ *
+ * Returns NO (without executing the block) if the savepoint couldn't be created.
+**/
+- (BOOL)executeBlock:(void (^)(YapDatabaseReadWriteTransaction *transaction))block
+    withinSavepointOfTransaction:(YapDatabaseReadWriteTransaction *)transaction
+{
+	if (![self executeSavepointStatement:"SAVEPOINT yap_group_commit;"])
+	{
+		return NO;
+	}
+	
+	// Remember everything the block may change in memory, so that it can be put back.
+	
+	NSDictionary *prevObjectChanges   = [objectChanges copy];
+	NSDictionary *prevMetadataChanges = [metadataChanges copy];
+	NSSet *prevRemovedKeys            = [removedKeys copy];
+	NSSet *prevRemovedCollections     = [removedCollections copy];
+	NSSet *prevRemovedRowids          = [removedRowids copy];
+	NSDictionary *prevChangedRowids   = [changedRowids copy];
+	BOOL prevAllKeysRemoved           = allKeysRemoved;
+	id prevCustomObject               = transaction->customObjectForNotification;
+	
+	NSArray<YapDatabaseExtensionTransaction *> *extTransactions = [transaction orderedExtensions];
+	NSMutableArray *extStates = [NSMutableArray arrayWithCapacity:extTransactions.count];
+	
+	for (YapDatabaseExtensionTransaction *extTransaction in extTransactions)
+	{
+		[extStates addObject:([extTransaction savepointState] ?: [NSNull null])];
+	}
+	
+	@autoreleasepool {
+		block(transaction);
+	}
+	
+	if (transaction->rollback)
+	{
+		if ([self executeSavepointStatement:"ROLLBACK TO SAVEPOINT yap_group_commit;"])
+		{
+			[objectChanges setDictionary:prevObjectChanges];
+			[metadataChanges setDictionary:prevMetadataChanges];
+			[removedKeys setSet:prevRemovedKeys];
+			[removedCollections setSet:prevRemovedCollections];
+			[removedRowids setSet:prevRemovedRowids];
+			[changedRowids setDictionary:prevChangedRowids];
+			allKeysRemoved = prevAllKeysRemoved;
+			transaction->customObjectForNotification = prevCustomObject;
+			
+			[extTransactions enumerateObjectsUsingBlock:
+			    ^(YapDatabaseExtensionTransaction *extTransaction, NSUInteger idx, BOOL __unused *stop)
+			{
+				id state = extStates[idx];
+				[extTransaction rollbackToSavepointState:((state == [NSNull null]) ? nil : state)];
+			}];
+			
+			// The caches may hold values written by the block, and rowids of rows it inserted.
+			
+			[objectCache removeAllObjects];
+			[metadataCache removeAllObjects];
+			[keyCache removeAllObjects];
+			
+			transaction->rollback = NO;
+		}
+		else
+		{
+			// We can't undo just this block, so the whole transaction gets rolled back.
+			
+			return YES;
+		}
+	}
+	
+	[self executeSavepointStatement:"RELEASE SAVEPOINT yap_group_commit;"];
+	return YES;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2757,6 +3478,9 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (removedRowids == nil)
 		removedRowids = [[NSMutableSet alloc] init];
 	
+	if (changedRowids == nil)
+		changedRowids = [[NSMutableDictionary alloc] init];
+	
 	allKeysRemoved = NO;
 	
 	if (mutationStack == nil)
@@ -3075,16 +3799,22 @@ static int connectionBusyHandler(void *ptr, int count)
 			int totalFrameCount = 0;
 			int checkpointedFrameCount = 0;
 			
+			uint64_t start = mach_absolute_time();
+			
 			int checkpointResult = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_PASSIVE,
 			                                                 &totalFrameCount, &checkpointedFrameCount);
 			
+			uint64_t writerStall = mach_absolute_time() - start;
+			
 			YDBLogInfo(@"Post-checkpoint: src(d) mode(passive) result(%d) frames(%d) checkpointed(%d)",
 			           checkpointResult, totalFrameCount, checkpointedFrameCount);
 
 			
 			if (checkpointResult == SQLITE_OK)
 			{
-				[database noteCheckpointWithTotalFrames:totalFrameCount checkpointedFrames:checkpointedFrameCount];
+				[database noteCheckpointWithTotalFrames:totalFrameCount
+				                    checkpointedFrames:checkpointedFrameCount
+				                           writerStall:writerStall];
 			}
 		}
 		
@@ -3119,6 +3849,9 @@ static int connectionBusyHandler(void *ptr, int count)
 	if ([removedRowids count] > 0)
 		removedRowids = nil;
 	
+	if ([changedRowids count] > 0)
+		changedRowids = nil;
+	
 	[mutationStack clear];
 	
 	// Drop IsOnConnectionQueueKey flag from writeQueue since we're exiting writeQueue.
@@ -3518,6 +4251,8 @@ static int connectionBusyHandler(void *ptr, int count)
 		[processedChangesets removeAllObjects];
 	}};
 	
+	[self closeGroupCommit];
+	
 	if (dispatch_get_specific(IsOnConnectionQueueKey))
 		block();
 	else
@@ -3558,6 +4293,8 @@ static int connectionBusyHandler(void *ptr, int count)
 		}
 	}};
 	
+	[self closeGroupCommit];
+	
 	if (dispatch_get_specific(IsOnConnectionQueueKey))
 		block();
 	else
@@ -3664,8 +4401,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	          YapDatabaseMetadataChangesKey,
 	          YapDatabaseRemovedKeysKey,
 	          YapDatabaseRemovedCollectionsKey,
-	          YapDatabaseRemovedRowidsKey,
 	          YapDatabaseAllKeysRemovedKey,
+	          YapDatabaseCompactChangesetKey,
 	          YapDatabaseModifiedExternallyKey ];
 }
 
@@ -3681,11 +4418,7 @@ static int connectionBusyHandler(void *ptr, int count)
 	          YapDatabaseConnectionKey,
 	          YapDatabaseExtensionsKey,
 	          YapDatabaseCustomKey,
-	          YapDatabaseObjectChangesKey,
-	          YapDatabaseMetadataChangesKey,
-	          YapDatabaseRemovedKeysKey,
-	          YapDatabaseRemovedCollectionsKey,
-	          YapDatabaseAllKeysRemovedKey,
+	          YapDatabaseCompactChangesetKey,
 	          YapDatabaseModifiedExternallyKey ];
 }
 
@@ -3793,49 +4526,36 @@ static int connectionBusyHandler(void *ptr, int count)
 		if (externalChangeset == nil)
 			externalChangeset = [NSMutableDictionary dictionaryWithSharedKeySet:sharedKeySetForExternalChangeset];
 		
+		// The dictionaries & sets go to our sibling connections, which need the changed objects & metadata.
+		// The notification only gets the compact changeset, which is all the hasChange... methods need.
+		// Both share the same instance.
+		
 		if ([objectChanges count] > 0)
-		{
 			internalChangeset[YapDatabaseObjectChangesKey] = objectChanges;
-			
-			YapSet *immutableObjectChanges = [[YapSet alloc] initWithDictionary:objectChanges];
-			externalChangeset[YapDatabaseObjectChangesKey] = immutableObjectChanges;
-		}
 		
 		if ([metadataChanges count] > 0)
-		{
 			internalChangeset[YapDatabaseMetadataChangesKey] = metadataChanges;
-			
-			YapSet *immutableMetadataChanges = [[YapSet alloc] initWithDictionary:metadataChanges];
-			externalChangeset[YapDatabaseMetadataChangesKey] = immutableMetadataChanges;
-		}
 		
 		if ([removedKeys count] > 0)
-		{
 			internalChangeset[YapDatabaseRemovedKeysKey] = removedKeys;
-			
-			YapSet *immutableRemovedKeys = [[YapSet alloc] initWithSet:removedKeys];
-			externalChangeset[YapDatabaseRemovedKeysKey] = immutableRemovedKeys;
-		}
 		
 		if ([removedCollections count] > 0)
-		{
 			internalChangeset[YapDatabaseRemovedCollectionsKey] = removedCollections;
-			
-			YapSet *immutableRemovedCollections = [[YapSet alloc] initWithSet:removedCollections];
-			externalChangeset[YapDatabaseRemovedCollectionsKey] = immutableRemovedCollections;
-		}
-		
-		if ([removedRowids count] > 0)
-		{
-			internalChangeset[YapDatabaseRemovedRowidsKey] = removedRowids;
-		}
 		
 		if (allKeysRemoved)
-		{
 			internalChangeset[YapDatabaseAllKeysRemovedKey] = @(YES);
-			externalChangeset[YapDatabaseAllKeysRemovedKey] = @(YES);
-		}
-        
+		
+		YapCompactChangeset *compactChangeset =
+		  [[YapCompactChangeset alloc] initWithChangedRowids:changedRowids
+		                                       objectChanges:objectChanges
+		                                     metadataChanges:metadataChanges
+		                                       removedRowids:removedRowids
+		                                  removedCollections:removedCollections
+		                                      allKeysRemoved:allKeysRemoved];
+		
+		internalChangeset[YapDatabaseCompactChangesetKey] = compactChangeset;
+		externalChangeset[YapDatabaseCompactChangesetKey] = compactChangeset;
+		
         if (externallyModified)
         {
             internalChangeset[YapDatabaseModifiedExternallyKey] = @(YES);
@@ -3894,20 +4614,26 @@ static int connectionBusyHandler(void *ptr, int count)
 	
 	// Process normal database changeset information
 	
+	// The dictionaries hold the new values for our caches.
+	// Everything else (what was changed or removed) is answered by the compact changeset.
+	
 	NSDictionary *changeset_objectChanges   =  [changeset objectForKey:YapDatabaseObjectChangesKey];
 	NSDictionary *changeset_metadataChanges =  [changeset objectForKey:YapDatabaseMetadataChangesKey];
 	
-	NSSet *changeset_removedRowids      = [changeset objectForKey:YapDatabaseRemovedRowidsKey];
-	NSSet *changeset_removedKeys        = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-	NSSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
+	YapCompactChangeset *changeset_compact = [changeset objectForKey:YapDatabaseCompactChangesetKey];
 	
 	BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-	BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
+	BOOL changeset_allKeysRemoved = changeset_compact.allKeysRemoved;
 	
 	BOOL hasObjectChanges      = [changeset_objectChanges count] > 0;
 	BOOL hasMetadataChanges    = [changeset_metadataChanges count] > 0;
-	BOOL hasRemovedKeys        = [changeset_removedKeys count] > 0;
-	BOOL hasRemovedCollections = [changeset_removedCollections count] > 0;
+	BOOL hasRemovedKeys        = (changeset_compact.flags & YapCompactChangesetFlags_Removed) != 0;
+	BOOL hasRemovedCollections = [changeset_compact hasRemovedCollections];
+	
+	// When only individual keys were removed, and our cache holds more items than the changeset,
+	// it's cheaper to look up each change in the cache than to look up each cached item in the changeset.
+	
+	BOOL walkChangeset = !hasRemovedCollections && !changeset_allKeysRemoved;
 	
 	// Check for external modification (special case)
 	
@@ -3929,10 +4655,10 @@ static int connectionBusyHandler(void *ptr, int count)
 	}
 	else
 	{
-		if (changeset_removedRowids)
-		{
-			[keyCache removeObjectsForKeys:changeset_removedRowids];
-		}
+		[changeset_compact enumerateRemovedRowidsUsingBlock:^(int64_t rowid, BOOL __unused *stop) {
+			
+			[keyCache removeObjectForKey:@(rowid)];
+		}];
 		
 		if (hasRemovedCollections)
 		{
@@ -3942,7 +4668,7 @@ static int connectionBusyHandler(void *ptr, int count)
 				__unsafe_unretained NSNumber *rowidNumber = (NSNumber *)key;
 				__unsafe_unretained YapCollectionKey *collectionKey = (YapCollectionKey *)obj;
 				
-				if ([changeset_removedCollections containsObject:collectionKey.collection])
+				if ([changeset_compact didRemoveCollection:collectionKey.collection])
 				{
 					if (toRemove == nil)
 						toRemove = [NSMutableArray array];
@@ -4006,31 +4732,50 @@ static int connectionBusyHandler(void *ptr, int count)
 	else if (hasObjectChanges || hasRemovedKeys || hasRemovedCollections)
 	{
 		NSUInteger updateCapacity = MIN([objectCache count], [changeset_objectChanges count]);
-		NSUInteger removeCapacity = MIN([objectCache count], [changeset_removedKeys count]);
+		NSUInteger removeCapacity = MIN([objectCache count], changeset_compact.count);
 		
 		NSMutableArray *keysToUpdate = [NSMutableArray arrayWithCapacity:updateCapacity];
 		NSMutableArray *keysToRemove = [NSMutableArray arrayWithCapacity:removeCapacity];
 		
-		[objectCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
-			
-			// Order matters.
-			// Consider the following database change:
-			//
-			// [transaction removeAllObjectsInAllCollections];
-			// [transaction setObject:obj forKey:key inCollection:collection];
-			
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
-			
-			if ([changeset_objectChanges objectForKey:cacheKey])
-			{
-				[keysToUpdate addObject:key];
-			}
-			else if ([changeset_removedKeys containsObject:cacheKey] ||
-					 [changeset_removedCollections containsObject:cacheKey.collection] || changeset_allKeysRemoved)
+		if (walkChangeset && (changeset_compact.count < [objectCache count]))
+		{
+			[changeset_compact enumerateCollectionKeysUsingBlock:
+			    ^(YapCollectionKey *cacheKey, YapCompactChangesetFlags flags, BOOL __unused *stop)
 			{
-				[keysToRemove addObject:key];
-			}
-		}];
+				if ((flags & YapCompactChangesetFlags_ObjectChanged) && [objectCache containsKey:cacheKey])
+				{
+					[keysToUpdate addObject:cacheKey];
+				}
+				else if ((flags & YapCompactChangesetFlags_Removed) && [objectCache containsKey:cacheKey])
+				{
+					[keysToRemove addObject:cacheKey];
+				}
+			}];
+		}
+		else
+		{
+			[objectCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+				
+				// Order matters.
+				// Consider the following database change:
+				//
+				// [transaction removeAllObjectsInAllCollections];
+				// [transaction setObject:obj forKey:key inCollection:collection];
+				
+				__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+				
+				if ([changeset_objectChanges objectForKey:cacheKey])
+				{
+					[keysToUpdate addObject:key];
+				}
+				else if (changeset_allKeysRemoved ||
+				         [changeset_compact didRemoveCollection:cacheKey.collection] ||
+				         ([changeset_compact flagsForCollectionKey:cacheKey] & YapCompactChangesetFlags_Removed))
+				{
+					[keysToRemove addObject:key];
+				}
+			}];
+		}
 		
 		[objectCache removeObjectsForKeys:keysToRemove];
 		
@@ -4118,31 +4863,50 @@ static int connectionBusyHandler(void *ptr, int count)
 	else if (hasMetadataChanges || hasRemovedKeys || hasRemovedCollections)
 	{
 		NSUInteger updateCapacity = MIN([metadataCache count], [changeset_metadataChanges count]);
-		NSUInteger removeCapacity = MIN([metadataCache count], [changeset_removedKeys count]);
+		NSUInteger removeCapacity = MIN([metadataCache count], changeset_compact.count);
 		
 		NSMutableArray *keysToUpdate = [NSMutableArray arrayWithCapacity:updateCapacity];
 		NSMutableArray *keysToRemove = [NSMutableArray arrayWithCapacity:removeCapacity];
 		
-		[metadataCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
-			
-			// Order matters.
-			// Consider the following database change:
-			//
-			// [transaction removeAllObjectsInAllCollections];
-			// [transaction setObject:obj forKey:key inCollection:collection];
-			
-			__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
-			
-			if ([changeset_metadataChanges objectForKey:cacheKey])
-			{
-				[keysToUpdate addObject:key];
-			}
-			else if ([changeset_removedKeys containsObject:cacheKey] ||
-					 [changeset_removedCollections containsObject:cacheKey.collection] || changeset_allKeysRemoved)
+		if (walkChangeset && (changeset_compact.count < [metadataCache count]))
+		{
+			[changeset_compact enumerateCollectionKeysUsingBlock:
+			    ^(YapCollectionKey *cacheKey, YapCompactChangesetFlags flags, BOOL __unused *stop)
 			{
-				[keysToRemove addObject:key];
-			}
-		}];
+				if ((flags & YapCompactChangesetFlags_MetadataChanged) && [metadataCache containsKey:cacheKey])
+				{
+					[keysToUpdate addObject:cacheKey];
+				}
+				else if ((flags & YapCompactChangesetFlags_Removed) && [metadataCache containsKey:cacheKey])
+				{
+					[keysToRemove addObject:cacheKey];
+				}
+			}];
+		}
+		else
+		{
+			[metadataCache enumerateKeysWithBlock:^(id key, BOOL __unused *stop) {
+				
+				// Order matters.
+				// Consider the following database change:
+				//
+				// [transaction removeAllObjectsInAllCollections];
+				// [transaction setObject:obj forKey:key inCollection:collection];
+				
+				__unsafe_unretained YapCollectionKey *cacheKey = (YapCollectionKey *)key;
+				
+				if ([changeset_metadataChanges objectForKey:cacheKey])
+				{
+					[keysToUpdate addObject:key];
+				}
+				else if (changeset_allKeysRemoved ||
+				         [changeset_compact didRemoveCollection:cacheKey.collection] ||
+				         ([changeset_compact flagsForCollectionKey:cacheKey] & YapCompactChangesetFlags_Removed))
+				{
+					[keysToRemove addObject:key];
+				}
+			}];
+		}
 		
 		[metadataCache removeObjectsForKeys:keysToRemove];
 		
@@ -4282,6 +5046,22 @@ static int connectionBusyHandler(void *ptr, int count)
 #pragma mark Changeset Inspection
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * The flags of the compact changeset that count as a change, given what the caller is interested in.
+ * Removals always count.
+**/
+NS_INLINE YapCompactChangesetFlags YapChangesetInspectionMask(BOOL includeObjectChanges, BOOL includeMetadataChanges)
+{
+	YapCompactChangesetFlags mask = YapCompactChangesetFlags_Removed;
+	
+	if (includeObjectChanges)
+		mask |= YapCompactChangesetFlags_ObjectChanged;
+	if (includeMetadataChanges)
+		mask |= YapCompactChangesetFlags_MetadataChanged;
+	
+	return mask;
+}
+
 - (BOOL)hasChangeForCollection:(NSString *)collection
                inNotifications:(NSArray *)notifications
         includingObjectChanges:(BOOL)includeObjectChanges
@@ -4290,6 +5070,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (collection == nil)
 		collection = @"";
 	
+	YapCompactChangesetFlags mask = YapChangesetInspectionMask(includeObjectChanges, includeMetadataChanges);
+	
 	for (NSNotification *notification in notifications)
 	{
 		if (![notification isKindOfClass:[NSNotification class]])
@@ -4300,49 +5082,19 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		NSDictionary *changeset = notification.userInfo;
 		
-		if (includeObjectChanges)
-		{
-			YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-			for (YapCollectionKey *collectionKey in changeset_objectChanges)
-			{
-				if ([collectionKey.collection isEqualToString:collection])
-				{
-					return YES;
-				}
-			}
-		}
+		BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
+		if (changeset_modifiedExternally)
+			return YES;
 		
-		if (includeMetadataChanges)
-		{
-			YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-			for (YapCollectionKey *collectionKey in changeset_metadataChanges)
-			{
-				if ([collectionKey.collection isEqualToString:collection])
-				{
-					return YES;
-				}
-			}
-		}
+		YapCompactChangeset *changeset_compact = [changeset objectForKey:YapDatabaseCompactChangesetKey];
 		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		for (YapCollectionKey *collectionKey in changeset_removedKeys)
-		{
-			if ([collectionKey.collection isEqualToString:collection])
-			{
-				return YES;
-			}
-		}
+		if (changeset_compact.allKeysRemoved)
+			return YES;
 		
-		YapSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-		if ([changeset_removedCollections containsObject:collection])
+		if ([changeset_compact didRemoveCollection:collection])
 			return YES;
 		
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
-        
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
+		if ([changeset_compact flagsForCollection:collection] & mask)
 			return YES;
 	}
 	
@@ -4386,6 +5138,7 @@ static int connectionBusyHandler(void *ptr, int count)
 		collection = @"";
 	
 	YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+	YapCompactChangesetFlags mask = YapChangesetInspectionMask(includeObjectChanges, includeMetadataChanges);
 	
 	for (NSNotification *notification in notifications)
 	{
@@ -4397,34 +5150,19 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		NSDictionary *changeset = notification.userInfo;
 		
-		if (includeObjectChanges)
-		{
-			YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-			if ([changeset_objectChanges containsObject:collectionKey])
-				return YES;
-		}
+		BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
+		if (changeset_modifiedExternally)
+			return YES;
 		
-		if (includeMetadataChanges)
-		{
-			YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-			if ([changeset_metadataChanges containsObject:collectionKey])
-				return YES;
-		}
+		YapCompactChangeset *changeset_compact = [changeset objectForKey:YapDatabaseCompactChangesetKey];
 		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		if ([changeset_removedKeys containsObject:collectionKey])
+		if (changeset_compact.allKeysRemoved)
 			return YES;
 		
-		YapSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-		if ([changeset_removedCollections containsObject:collection])
+		if ([changeset_compact didRemoveCollection:collection])
 			return YES;
 		
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
-        
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
+		if ([changeset_compact flagsForCollectionKey:collectionKey] & mask)
 			return YES;
 	}
 	
@@ -4476,6 +5214,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (collection == nil)
 		collection = @"";
 	
+	YapCompactChangesetFlags mask = YapChangesetInspectionMask(includeObjectChanges, includeMetadataChanges);
+	
 	for (NSNotification *notification in notifications)
 	{
 		if (![notification isKindOfClass:[NSNotification class]])
@@ -4486,59 +5226,29 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		NSDictionary *changeset = notification.userInfo;
 		
-		if (includeObjectChanges)
-		{
-			YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-			for (YapCollectionKey *collectionKey in changeset_objectChanges)
-			{
-				if ([collectionKey.collection isEqualToString:collection])
-				{
-					if ([keys containsObject:collectionKey.key])
-					{
-						return YES;
-					}
-				}
-			}
-		}
-		
-		if (includeMetadataChanges)
-		{
-			YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-			for (YapCollectionKey *collectionKey in changeset_metadataChanges)
-			{
-				if ([collectionKey.collection isEqualToString:collection])
-				{
-					if ([keys containsObject:collectionKey.key])
-					{
-						return YES;
-					}
-				}
-			}
-		}
+		BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
+		if (changeset_modifiedExternally)
+			return YES;
 		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		for (YapCollectionKey *collectionKey in changeset_removedKeys)
-		{
-			if ([collectionKey.collection isEqualToString:collection])
-			{
-				if ([keys containsObject:collectionKey.key])
-				{
-					return YES;
-				}
-			}
-		}
+		YapCompactChangeset *changeset_compact = [changeset objectForKey:YapDatabaseCompactChangesetKey];
 		
-		YapSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-		if ([changeset_removedCollections containsObject:collection])
+		if (changeset_compact.allKeysRemoved)
 			return YES;
-        
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
 		
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
+		if ([changeset_compact didRemoveCollection:collection])
 			return YES;
+		
+		// Most commits don't touch the collection at all.
+		if (([changeset_compact flagsForCollection:collection] & mask) == 0)
+			continue;
+		
+		for (NSString *key in keys)
+		{
+			YapCollectionKey *collectionKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+			
+			if ([changeset_compact flagsForCollectionKey:collectionKey] & mask)
+				return YES;
+		}
 	}
 	
 	return NO;
@@ -4605,16 +5315,16 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		NSDictionary *changeset = notification.userInfo;
 		
-		YapSet *changeset_removedCollections = [changeset objectForKey:YapDatabaseRemovedCollectionsKey];
-		if ([changeset_removedCollections containsObject:collection])
+		BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
+		if (changeset_modifiedExternally)
 			return YES;
-        
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
 		
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
+		YapCompactChangeset *changeset_compact = [changeset objectForKey:YapDatabaseCompactChangesetKey];
+		
+		if (changeset_compact.allKeysRemoved)
+			return YES;
+		
+		if ([changeset_compact didRemoveCollection:collection])
 			return YES;
 	}
 	
@@ -4643,12 +5353,13 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		NSDictionary *changeset = notification.userInfo;
 		
-        BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
-        if (changeset_modifiedExternally)
-            return YES;
-        
-		BOOL changeset_allKeysRemoved = [[changeset objectForKey:YapDatabaseAllKeysRemovedKey] boolValue];
-		if (changeset_allKeysRemoved)
+		BOOL changeset_modifiedExternally = [[changeset objectForKey:YapDatabaseModifiedExternallyKey] boolValue];
+		if (changeset_modifiedExternally)
+			return YES;
+		
+		YapCompactChangeset *changeset_compact = [changeset objectForKey:YapDatabaseCompactChangesetKey];
+		
+		if (changeset_compact.allKeysRemoved)
 			return YES;
 	}
 	
@@ -4676,7 +5387,7 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (collection == nil)
 		collection = @"";
 	
-	BOOL stop = NO;
+	__block BOOL stop = NO;
 	NSMutableSet *keys = [NSMutableSet set];
 	
 	for (NSNotification *notification in notifications)
@@ -4689,50 +5400,22 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		NSDictionary *changeset = notification.userInfo;
 		
-		YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-		for (YapCollectionKey *ck in changeset_objectChanges)
-		{
-			if ([ck.collection isEqualToString:collection])
-			{
-				if (![keys containsObject:ck.key])
-				{
-					block(ck.key, &stop);
-					if (stop) return;
-					
-					[keys addObject:ck.key];
-				}
-			}
-		}
+		YapCompactChangeset *changeset_compact = [changeset objectForKey:YapDatabaseCompactChangesetKey];
 		
-		YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-		for (YapCollectionKey *ck in changeset_metadataChanges)
+		[changeset_compact enumerateCollectionKeysInCollection:collection
+		                                            usingBlock:
+		    ^(YapCollectionKey *ck, YapCompactChangesetFlags __unused flags, BOOL *innerStop)
 		{
-			if ([ck.collection isEqualToString:collection])
+			if (![keys containsObject:ck.key])
 			{
-				if (![keys containsObject:ck.key])
-				{
-					block(ck.key, &stop);
-					if (stop) return;
-					
-					[keys addObject:ck.key];
-				}
+				block(ck.key, &stop);
+				if (stop) *innerStop = YES;
+				
+				[keys addObject:ck.key];
 			}
-		}
+		}];
 		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		for (YapCollectionKey *ck in changeset_removedKeys)
-		{
-			if ([ck.collection isEqualToString:collection])
-			{
-				if (![keys containsObject:ck.key])
-				{
-					block(ck.key, &stop);
-					if (stop) return;
-					
-					[keys addObject:ck.key];
-				}
-			}
-		}
+		if (stop) return;
 	}
 }
 
@@ -4754,7 +5437,7 @@ static int connectionBusyHandler(void *ptr, int count)
 {
 	if (block == NULL) return;
 	
-	BOOL stop = NO;
+	__block BOOL stop = NO;
 	NSMutableSet *collectionKeys = [NSMutableSet set];
 	
 	for (NSNotification *notification in notifications)
@@ -4767,41 +5450,21 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		NSDictionary *changeset = notification.userInfo;
 		
-		YapSet *changeset_objectChanges = [changeset objectForKey:YapDatabaseObjectChangesKey];
-		for (YapCollectionKey *ck in changeset_objectChanges)
-		{
-			if (![collectionKeys containsObject:ck])
-			{
-				block(ck, &stop);
-				if (stop) return;
-				
-				[collectionKeys addObject:ck];
-			}
-		}
+		YapCompactChangeset *changeset_compact = [changeset objectForKey:YapDatabaseCompactChangesetKey];
 		
-		YapSet *changeset_metadataChanges = [changeset objectForKey:YapDatabaseMetadataChangesKey];
-		for (YapCollectionKey *ck in changeset_metadataChanges)
+		[changeset_compact enumerateCollectionKeysUsingBlock:
+		    ^(YapCollectionKey *ck, YapCompactChangesetFlags __unused flags, BOOL *innerStop)
 		{
 			if (![collectionKeys containsObject:ck])
 			{
 				block(ck, &stop);
-				if (stop) return;
+				if (stop) *innerStop = YES;
 				
 				[collectionKeys addObject:ck];
 			}
-		}
+		}];
 		
-		YapSet *changeset_removedKeys = [changeset objectForKey:YapDatabaseRemovedKeysKey];
-		for (YapCollectionKey *ck in changeset_removedKeys)
-		{
-			if (![collectionKeys containsObject:ck])
-			{
-				block(ck, &stop);
-				if (stop) return;
-				
-				[collectionKeys addObject:ck];
-			}
-		}
+		if (stop) return;
 	}
 }
 
@@ -4919,6 +5582,14 @@ static int connectionBusyHandler(void *ptr, int count)
 		
 		result = [extensionTransaction createIfNeeded];
 		
+		if (result && (extension.populationBatchSize == 0) && ![extensionTransaction isPopulated])
+		{
+			// A previous registration was populating the extension in batches, and didn't finish.
+			// This registration doesn't use batches, so finish the job now.
+			
+			[extensionTransaction populateNextBatchOfSize:NSUIntegerMax];
+		}
+		
 		if (result)
 		{
 			[self didRegisterExtension:extension
@@ -4943,6 +5614,34 @@ static int connectionBusyHandler(void *ptr, int count)
 	return result;
 }
 
+/**
+ * Populates the next batch of rows for an extension registered with a populationBatchSize.
+ *
+ * Returns YES if the extension is fully populated (or is no longer registered).
+**/
+- (BOOL)populateExtensionWithName:(NSString *)extensionName batchSize:(NSUInteger)batchSize
+{
+	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must go through writeQueue.");
+	
+	__block BOOL done = YES;
+	
+	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
+		
+		YapDatabaseReadWriteTransaction *transaction = [self newReadWriteTransaction];
+		[self preReadWriteTransaction:transaction];
+		
+		YapDatabaseExtensionTransaction *extensionTransaction = [transaction extension:extensionName];
+		if (extensionTransaction)
+		{
+			done = [extensionTransaction populateNextBatchOfSize:batchSize];
+		}
+		
+		[self postReadWriteTransaction:transaction];
+	}});
+	
+	return done;
+}
+
 - (void)unregisterExtensionWithName:(NSString *)extensionName
 {
 	NSAssert(dispatch_get_specific(database->IsOnWriteQueueKey), @"Must go through writeQueue.");
@@ -5419,6 +6118,8 @@ static int connectionBusyHandler(void *ptr, int count)
 **/
 - (void)vacuum
 {
+	[self closeGroupCommit];
+	
 	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
 		
 		if (longLivedReadTransaction)
@@ -5510,6 +6211,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	if (completionQueue == NULL && completionBlock != NULL)
 		completionQueue = dispatch_get_main_queue();
 	
+	[self closeGroupCommit];
+	
 	dispatch_async(connectionQueue, ^{ @autoreleasepool {
 		
 		if (longLivedReadTransaction)
@@ -5584,6 +6287,8 @@ static int connectionBusyHandler(void *ptr, int count)
 {
 	__block NSError *error = nil;
 	
+	[self closeGroupCommit];
+	
 	dispatch_sync(connectionQueue, ^{ @autoreleasepool {
 		
 		if (longLivedReadTransaction)
@@ -5677,6 +6382,8 @@ static int connectionBusyHandler(void *ptr, int count)
 	
 	NSProgress *progress = [NSProgress progressWithTotalUnitCount:0];
 	
+	[self closeGroupCommit];
+	
 	dispatch_async(connectionQueue, ^{ @autoreleasepool {
 		
 		if (longLivedReadTransaction)
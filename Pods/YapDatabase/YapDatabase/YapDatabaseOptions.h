@@ -31,6 +31,13 @@ typedef NS_ENUM(NSInteger, YapDatabasePragmaSynchronous) {
 typedef NSData *_Nonnull (^YapDatabaseCipherKeyBlock)(void);
 #endif
 
+/**
+ * A deserializer that's handed the raw bytes of a row (as stored by sqlite), rather than an NSData.
+ * See YapDatabaseOptions.objectBytesDeserializer.
+**/
+typedef id _Nullable (^YapDatabaseBytesDeserializer)(NSString *collection, NSString *key,
+                                                     const void *bytes, NSUInteger length);
+
 @interface YapDatabaseOptions : NSObject <NSCopying>
 
 /**
@@ -244,9 +251,16 @@ typedef NSData *_Nonnull (^YapDatabaseCipherKeyBlock)(void);
  *    allow the checkpoint operation to catch up.
  * 
  * If the WAL file ever reaches the configured aggressiveWALTruncationSize,
- * then YapDatabase will effectively insert a checkpoint operation as a readWriteTransction.
+ * then YapDatabase will briefly insert a checkpoint operation as a readWriteTransction, to truncate the WAL.
+ * This only happens once its normal checkpoint operations (which run in parallel with db writes)
+ * have caught up, so the interruption is short.
+ * Under a heavy stream of writes, the WAL is reset this way once it reaches a quarter of this size.
  *
- * (This is in contrast to its normal optimized checkpoint operations, which can run in parallel with db writes.)
+ * If readers keep the WAL from being truncated, YapDatabase retries with exponential backoff.
+ * And if the WAL grows to twice this size anyway, read-write transactions will start performing
+ * a checkpoint after every commit, until the WAL is back under control.
+ *
+ * You can monitor all of this via -[YapDatabase checkpointStats].
  * 
  * Note: The internals approximate the file size based on the number of reported frames in the WAL.
  * The approximation is generally a bit smaller than the actual file size (as reported by the file system).
@@ -289,6 +303,28 @@ typedef NSData *_Nonnull (^YapDatabaseCipherKeyBlock)(void);
 **/
 @property (nonatomic, assign, readwrite) BOOL enableMultiProcessSupport;
 
+/**
+ * An optional deserializer for objects, which parses rows in place.
+ *
+ * Normally each row is wrapped in an NSData (which points directly at sqlite's buffer, without copying it),
+ * and handed to the database's objectDeserializer. That's an extra object (and autorelease) per row,
+ * which shows up when enumerating large collections. If your deserializer doesn't need an NSData,
+ * set this block, and it will be handed the bytes directly instead.
+ *
+ * The bytes are borrowed from sqlite, and are only valid for the duration of the block.
+ * The deserialized object must not reference them once the block returns.
+ * A deserializer that can't parse a particular row in place (e.g. because it's in a format that requires
+ * NSKeyedUnarchiver) should copy the bytes into an NSData first.
+ *
+ * When set, it's used for every object read by a transaction, so it must understand everything the
+ * objectSerializer writes. The objectDeserializer is still used in a few places (e.g. batch fetches
+ * that deserialize rows concurrently), so both must produce equivalent objects.
+ * Like the objectDeserializer, it must be thread-safe.
+ *
+ * The default value is nil.
+**/
+@property (nonatomic, copy, readwrite, nullable) YapDatabaseBytesDeserializer objectBytesDeserializer;
+
 @end
 
 NS_ASSUME_NONNULL_END
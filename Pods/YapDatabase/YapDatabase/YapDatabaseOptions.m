@@ -27,6 +27,7 @@
 #endif
 @synthesize aggressiveWALTruncationSize = aggressiveWALTruncationSize;
 @synthesize enableMultiProcessSupport = enableMultiProcessSupport;
+@synthesize objectBytesDeserializer = objectBytesDeserializer;
 
 - (id)init
 {
@@ -59,6 +60,7 @@
 #endif
 	copy->aggressiveWALTruncationSize = aggressiveWALTruncationSize;
     copy->enableMultiProcessSupport = enableMultiProcessSupport;
+	copy->objectBytesDeserializer = objectBytesDeserializer;
 	
 	return copy;
 }
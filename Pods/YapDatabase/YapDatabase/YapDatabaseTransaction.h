@@ -119,6 +119,23 @@ NS_ASSUME_NONNULL_BEGIN
 **/
 - (nullable id)objectForKey:(NSString *)key inCollection:(nullable NSString *)collection;
 
+/**
+ * Batch object access.
+ *
+ * This method is considerably faster than invoking objectForKey:inCollection: in a loop.
+ * Items already in the objectCache are returned directly.
+ * The remaining keys are resolved to rowids in bulk, and then fetched in ascending rowid order,
+ * which keeps sqlite's page access sequential. Large fetches are deserialized concurrently.
+ *
+ * @return
+ *   A dictionary of the objects that were found, keyed by key.
+ *   Keys that don't exist in the database are simply absent from the result.
+ *
+ * @see enumerateObjectsForKeys:inCollection:unorderedUsingBlock:
+**/
+- (NSDictionary<NSString *, id> *)objectsForKeys:(NSArray<NSString *> *)keys
+                                    inCollection:(nullable NSString *)collection;
+
 /**
  * Returns whether or not the given key/collection exists in the database.
 **/
@@ -240,6 +257,24 @@ NS_ASSUME_NONNULL_BEGIN
                                  usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
                                  withFilter:(nullable BOOL (^)(NSString *key))filter;
 
+/**
+ * Enumerates a bounded range of key/object pairs in the given collection, in ascending rowid order.
+ *
+ * This allows very large collections to be walked in chunks, with each chunk in its own transaction,
+ * so that neither memory usage nor transaction duration grows with the size of the collection.
+ * Pass 0 as the rowid to start from the beginning, and the returned rowid to continue from there.
+ *
+ * Rows inserted after the enumeration has passed them are not visited.
+ * Since new rows are generally assigned increasing rowids, they're typically picked up by a later chunk.
+ *
+ * @return
+ *   The rowid of the last row enumerated, or the given rowid if there are no more rows.
+**/
+- (int64_t)enumerateKeysAndObjectsInCollection:(nullable NSString *)collection
+                                    afterRowid:(int64_t)afterRowid
+                                         limit:(NSUInteger)limit
+                                    usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block;
+
 /**
  * Enumerates all key/object pairs in all collections.
  * 
@@ -25,6 +25,31 @@
 #endif
 #pragma unused(ydbLogLevel)
 
+/**
+ * Batch fetches of at least this many rows are deserialized concurrently.
+ * Below this, the cost of copying blobs out of sqlite outweighs the gain.
+**/
+static NSUInteger const YDB_MinConcurrentDeserializationCount = 32;
+
+/**
+ * Deserializes an object directly from an sqlite row.
+ *
+ * The blob is owned by sqlite, and is only valid until the statement is stepped or reset.
+ * If the database has an objectBytesDeserializer, it's handed the bytes as-is.
+ * Otherwise the bytes are wrapped (without copying) in an NSData for the objectDeserializer.
+**/
+NS_INLINE id YapDatabaseDeserializeObjectBlob(YapDatabase *database,
+                                              NSString *collection, NSString *key, const void *blob, int blobSize)
+{
+	if (database->objectBytesDeserializer)
+	{
+		return database->objectBytesDeserializer(collection, key, blob, (NSUInteger)blobSize);
+	}
+	
+	NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
+	return database->objectDeserializer(collection, key, data);
+}
+
 
 @implementation YapDatabaseReadTransaction
 
@@ -586,11 +611,7 @@
 		const void *blob = sqlite3_column_blob(statement, column_idx_data);
 		int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 		
-		// Performance tuning:
-		// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-		
-		NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-		object = connection->database->objectDeserializer(cacheKey.collection, cacheKey.key, data);
+		object = YapDatabaseDeserializeObjectBlob(connection->database, cacheKey.collection, cacheKey.key, blob, blobSize);
 		
 		if (object)
 			[connection->objectCache setObject:object forKey:cacheKey];
@@ -730,11 +751,7 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				// Performance tuning:
-				// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(cacheKey.collection, cacheKey.key, oData);
+				object = YapDatabaseDeserializeObjectBlob(connection->database, cacheKey.collection, cacheKey.key, oBlob, oBlobSize);
 				
 				if (object)
 					[connection->objectCache setObject:object forKey:cacheKey];
@@ -831,11 +848,7 @@
 			const void *blob = sqlite3_column_blob(statement, column_idx_data);
 			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
-			// Performance tuning:
-			// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-			
-			NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			object = connection->database->objectDeserializer(cacheKey.collection, cacheKey.key, data);
+			object = YapDatabaseDeserializeObjectBlob(connection->database, cacheKey.collection, cacheKey.key, blob, blobSize);
 			
 			if (object)
 				[connection->objectCache setObject:object forKey:cacheKey];
@@ -874,11 +887,7 @@
 			const void *blob = sqlite3_column_blob(statement, column_idx_data);
 			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
-			// Performance tuning:
-			// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-			
-			NSData *data = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			object = connection->database->objectDeserializer(collection, key, data);
+			object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, blob, blobSize);
 			
 			// Update caches
 			
@@ -903,6 +912,268 @@
 	return object;
 }
 
+/**
+ * Batch object access.
+ * 
+ * Items in the objectCache are returned directly, and rowids from the keyCache are reused.
+ * Remaining keys are resolved to rowids via the (collection, key) index, which is a covering index for this query.
+ * The rows are then fetched in ascending rowid order, so sqlite walks the table b-tree sequentially
+ * rather than bouncing between pages for every key.
+ * 
+ * Large fetches copy the blobs out of sqlite and deserialize them concurrently.
+ * The objectDeserializer is already required to be thread-safe, as it's shared by every connection.
+**/
+- (NSDictionary *)objectsForKeys:(NSArray *)keys inCollection:(NSString *)collection
+{
+	NSUInteger keysCount = [keys count];
+	if (keysCount == 0) return [NSDictionary dictionary];
+	if (collection == nil) collection = @"";
+	
+	NSMutableDictionary *results = [NSMutableDictionary dictionaryWithCapacity:keysCount];
+	
+	// Check the caches first.
+	
+	NSMutableDictionary *rowidToKey = [NSMutableDictionary dictionaryWithCapacity:keysCount];
+	NSMutableArray *unresolvedKeys = [NSMutableArray arrayWithCapacity:keysCount];
+	
+	for (NSString *key in keys)
+	{
+		if ([results objectForKey:key]) continue; // duplicate key
+		
+		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		id object = [connection->objectCache objectForKey:cacheKey];
+		if (object)
+		{
+			[results setObject:object forKey:key];
+			continue;
+		}
+		
+		NSNumber *cachedRowid = [connection->keyCache keyForObject:cacheKey];
+		if (cachedRowid)
+			[rowidToKey setObject:key forKey:cachedRowid];
+		else
+			[unresolvedKeys addObject:key];
+	}
+	
+	if (([rowidToKey count] == 0) && ([unresolvedKeys count] == 0)) {
+		return results;
+	}
+	
+	// Sqlite has an upper bound on the number of host parameters that may be used in a single query.
+	// We need to watch out for this in case a large array of keys is passed.
+	
+	NSUInteger maxHostParams = (NSUInteger) sqlite3_limit(connection->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+	
+	// Pass 1: Resolve keys to rowids.
+	//
+	// SELECT "rowid", "key" FROM "database2" WHERE "collection" = ? AND "key" IN (?, ?, ...);
+	
+	if ([unresolvedKeys count] > 0)
+	{
+		YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+		
+		NSUInteger offset = 0;
+		while (offset < [unresolvedKeys count])
+		{
+			NSUInteger numKeyParams = MIN([unresolvedKeys count] - offset, (maxHostParams-1)); // minus 1 for collection
+			
+			int const column_idx_rowid = SQLITE_COLUMN_START + 0;
+			int const column_idx_key   = SQLITE_COLUMN_START + 1;
+			
+			NSMutableString *query = [NSMutableString stringWithCapacity:(80 + (numKeyParams * 3))];
+			[query appendString:@"SELECT \"rowid\", \"key\" FROM \"database2\""];
+			[query appendString:@" WHERE \"collection\" = ? AND \"key\" IN ("];
+			
+			for (NSUInteger i = 0; i < numKeyParams; i++)
+			{
+				if (i == 0)
+					[query appendString:@"?"];
+				else
+					[query appendString:@", ?"];
+			}
+			
+			[query appendString:@");"];
+			
+			int status;
+			sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+			if (statement == NULL)
+			{
+				break;
+			}
+			
+			sqlite3_bind_text(statement, SQLITE_BIND_START, _collection.str, _collection.length, SQLITE_STATIC);
+			
+			for (NSUInteger i = 0; i < numKeyParams; i++)
+			{
+				NSString *key = [unresolvedKeys objectAtIndex:(offset + i)];
+				sqlite3_bind_text(statement, (int)(SQLITE_BIND_START + 1 + i), [key UTF8String], -1, SQLITE_TRANSIENT);
+			}
+			
+			while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+			{
+				int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+				
+				const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+				int textSize = sqlite3_column_bytes(statement, column_idx_key);
+				
+				NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+				NSNumber *rowidNumber = @(rowid);
+				
+				[rowidToKey setObject:key forKey:rowidNumber];
+				
+				YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+				[connection->keyCache setObject:cacheKey forKey:rowidNumber];
+			}
+			
+			if (status != SQLITE_DONE)
+			{
+				YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+			}
+			
+			sqlite3_clear_bindings(statement);
+			sqlite3_reset(statement);
+			statement = NULL;
+			
+			offset += numKeyParams;
+		}
+		
+		FreeYapDatabaseString(&_collection);
+	}
+	
+	// Pass 2: Fetch the data in ascending rowid order.
+	//
+	// SELECT "rowid", "data" FROM "database2" WHERE "rowid" IN (?, ?, ...);
+	
+	NSArray *sortedRowids = [[rowidToKey allKeys] sortedArrayUsingSelector:@selector(compare:)];
+	NSUInteger rowidsCount = [sortedRowids count];
+	
+	YapDatabaseDeserializer deserializer = connection->database->objectDeserializer;
+	BOOL deserializeConcurrently = (rowidsCount >= YDB_MinConcurrentDeserializationCount);
+	
+	NSMutableArray *fetchedKeys = nil;
+	NSMutableArray *fetchedData = nil;
+	if (deserializeConcurrently)
+	{
+		fetchedKeys = [NSMutableArray arrayWithCapacity:rowidsCount];
+		fetchedData = [NSMutableArray arrayWithCapacity:rowidsCount];
+	}
+	
+	NSUInteger offset = 0;
+	while (offset < rowidsCount)
+	{
+		NSUInteger numRowidParams = MIN(rowidsCount - offset, maxHostParams);
+		
+		int const column_idx_rowid = SQLITE_COLUMN_START + 0;
+		int const column_idx_data  = SQLITE_COLUMN_START + 1;
+		
+		NSMutableString *query = [NSMutableString stringWithCapacity:(60 + (numRowidParams * 3))];
+		[query appendString:@"SELECT \"rowid\", \"data\" FROM \"database2\" WHERE \"rowid\" IN ("];
+		
+		for (NSUInteger i = 0; i < numRowidParams; i++)
+		{
+			if (i == 0)
+				[query appendString:@"?"];
+			else
+				[query appendString:@", ?"];
+		}
+		
+		[query appendString:@");"];
+		
+		int status;
+		sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+		if (statement == NULL)
+		{
+			break;
+		}
+		
+		for (NSUInteger i = 0; i < numRowidParams; i++)
+		{
+			int64_t rowid = [[sortedRowids objectAtIndex:(offset + i)] longLongValue];
+			sqlite3_bind_int64(statement, (int)(SQLITE_BIND_START + i), rowid);
+		}
+		
+		while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+		{
+			int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+			NSString *key = [rowidToKey objectForKey:@(rowid)];
+			
+			const void *blob = sqlite3_column_blob(statement, column_idx_data);
+			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
+			
+			if (deserializeConcurrently)
+			{
+				// The blob is only valid until the next step, so it must be copied.
+				
+				[fetchedKeys addObject:key];
+				[fetchedData addObject:[NSData dataWithBytes:blob length:blobSize]];
+			}
+			else
+			{
+				id object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, blob, blobSize);
+				
+				if (object)
+				{
+					YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+					[connection->objectCache setObject:object forKey:cacheKey];
+					
+					[results setObject:object forKey:key];
+				}
+			}
+		}
+		
+		if (status != SQLITE_DONE)
+		{
+			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+		}
+		
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
+		statement = NULL;
+		
+		offset += numRowidParams;
+	}
+	
+	if (deserializeConcurrently && ([fetchedKeys count] > 0))
+	{
+		NSUInteger fetchedCount = [fetchedKeys count];
+		
+		// The workers hand back retained pointers, which we take ownership of below.
+		// This avoids any locking around a shared mutable container.
+		
+		void **objects = calloc(fetchedCount, sizeof(void *));
+		
+		dispatch_apply(fetchedCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+			@autoreleasepool {
+				
+				id object = deserializer(collection, [fetchedKeys objectAtIndex:i], [fetchedData objectAtIndex:i]);
+				if (object) {
+					objects[i] = (void *)CFBridgingRetain(object);
+				}
+			}
+		});
+		
+		// The caches aren't thread-safe, so they're updated here on the transaction's thread.
+		
+		for (NSUInteger i = 0; i < fetchedCount; i++)
+		{
+			if (objects[i] == NULL) continue;
+			
+			id object = CFBridgingRelease(objects[i]);
+			NSString *key = [fetchedKeys objectAtIndex:i];
+			
+			YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+			[connection->objectCache setObject:object forKey:cacheKey];
+			
+			[results setObject:object forKey:key];
+		}
+		
+		free(objects);
+	}
+	
+	return results;
+}
+
 - (id)metadataForKey:(NSString *)key inCollection:(NSString *)collection
 {
 	if (key == nil) return nil;
@@ -1091,11 +1362,7 @@
 					const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 					
-					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-					
-					NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-					object = connection->database->objectDeserializer(cacheKey.collection, cacheKey.key, oData);
+					object = YapDatabaseDeserializeObjectBlob(connection->database, cacheKey.collection, cacheKey.key, oBlob, oBlobSize);
 					
 					if (object)
 						[connection->objectCache setObject:object forKey:cacheKey];
@@ -1166,8 +1433,7 @@
 					const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-					NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-					object = connection->database->objectDeserializer(collection, key, oData);
+					object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
 					
 					if (object)
 						[connection->objectCache setObject:object forKey:cacheKey];
@@ -1742,6 +2008,109 @@
 	}
 }
 
+/**
+ * Enumerates a bounded range of key/object pairs in the given collection, in ascending rowid order.
+ *
+ * The query walks the table b-tree from the given rowid, rather than the (collection, key) index,
+ * so each chunk costs roughly the number of rows it skips over, independent of the chunk's position.
+**/
+- (int64_t)enumerateKeysAndObjectsInCollection:(NSString *)collection
+                                    afterRowid:(int64_t)afterRowid
+                                         limit:(NSUInteger)limit
+                                    usingBlock:(void (^)(NSString *key, id object, BOOL *stop))block
+{
+	if (block == NULL) return afterRowid;
+	if (limit == 0) return afterRowid;
+	if (collection == nil) collection = @"";
+	
+	// SELECT "rowid", "key", "data" FROM "database2"
+	//   WHERE "rowid" > ? AND +"collection" = ? ORDER BY "rowid" ASC LIMIT ?;
+	//
+	// The unary '+' prevents sqlite from choosing the collection index,
+	// which would require sorting the entire collection by rowid for every chunk.
+	
+	// This is called repeatedly (once per chunk), so it goes through the statement cache.
+	NSString *query = @"SELECT \"rowid\", \"key\", \"data\" FROM \"database2\""
+	                  @" WHERE \"rowid\" > ? AND +\"collection\" = ? ORDER BY \"rowid\" ASC LIMIT ?;";
+	
+	int status;
+	sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+	if (statement == NULL)
+	{
+		return afterRowid;
+	}
+	
+	int const column_idx_rowid    = SQLITE_COLUMN_START + 0;
+	int const column_idx_key      = SQLITE_COLUMN_START + 1;
+	int const column_idx_data     = SQLITE_COLUMN_START + 2;
+	int const bind_idx_rowid      = SQLITE_BIND_START + 0;
+	int const bind_idx_collection = SQLITE_BIND_START + 1;
+	int const bind_idx_limit      = SQLITE_BIND_START + 2;
+	
+	sqlite3_bind_int64(statement, bind_idx_rowid, afterRowid);
+	
+	YapDatabaseString _collection; MakeYapDatabaseString(&_collection, collection);
+	sqlite3_bind_text(statement, bind_idx_collection, _collection.str, _collection.length, SQLITE_STATIC);
+	
+	sqlite3_bind_int64(statement, bind_idx_limit, (int64_t)MIN(limit, (NSUInteger)INT64_MAX));
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
+	int64_t lastRowid = afterRowid;
+	
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		lastRowid = sqlite3_column_int64(statement, column_idx_rowid);
+		
+		const unsigned char *text = sqlite3_column_text(statement, column_idx_key);
+		int textSize = sqlite3_column_bytes(statement, column_idx_key);
+		
+		NSString *key = [[NSString alloc] initWithBytes:text length:textSize encoding:NSUTF8StringEncoding];
+		
+		YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+		
+		id object = [connection->objectCache objectForKey:cacheKey];
+		if (object == nil)
+		{
+			const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+			int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+			
+			object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
+			
+			// Same cache considerations as a full enumeration:
+			// don't crowd out explicitly fetched items.
+			
+			if (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit)
+			{
+				if (object)
+					[connection->objectCache setObject:object forKey:cacheKey];
+			}
+		}
+		
+		block(key, object, &stop);
+		
+		if (stop || mutation.isMutated) break;
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	FreeYapDatabaseString(&_collection);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+	
+	return lastRowid;
+}
+
 /**
  * Enumerates all key/object pairs in all collections.
  *
@@ -2118,13 +2487,10 @@
 		
 		[query appendString:@");"];
 		
-		sqlite3_stmt *statement;
-		
-		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-		if (status != SQLITE_OK)
+		int status;
+		sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+		if (statement == NULL)
 		{
-			YDBLogError(@"Error creating 'objectsForKeys' statement: %d %s",
-						status, sqlite3_errmsg(connection->db));
 			break; // Break from do/while. Still need to free _collection.
 		}
 		
@@ -2166,8 +2532,7 @@
 			const void *blob = sqlite3_column_blob(statement, column_idx_data);
 			int blobSize = sqlite3_column_bytes(statement, column_idx_data);
 			
-			NSData *objectData = [NSData dataWithBytesNoCopy:(void *)blob length:blobSize freeWhenDone:NO];
-			id object = connection->database->objectDeserializer(collection, key, objectData);
+			id object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, blob, blobSize);
 			
 			if (object)
 			{
@@ -2187,7 +2552,8 @@
 			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 		}
 		
-		sqlite3_finalize(statement);
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
 		statement = NULL;
 		
 		if (stop) {
@@ -2330,13 +2696,10 @@
 		
 		[query appendString:@");"];
 		
-		sqlite3_stmt *statement;
-		
-		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-		if (status != SQLITE_OK)
+		int status;
+		sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+		if (statement == NULL)
 		{
-			YDBLogError(@"Error creating 'metadataForKeys' statement: %d %s",
-						status, sqlite3_errmsg(connection->db));
 			break; // Break from do/while. Still need to free _collection.
 		}
 		
@@ -2398,7 +2761,8 @@
 			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 		}
 		
-		sqlite3_finalize(statement);
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
 		statement = NULL;
 		
 		if (stop) {
@@ -2550,13 +2914,10 @@
 		
 		[query appendString:@");"];
 		
-		sqlite3_stmt *statement;
-		
-		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-		if (status != SQLITE_OK)
+		int status;
+		sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+		if (statement == NULL)
 		{
-			YDBLogError(@"Error creating 'objectsAndMetadataForKeys' statement: %d %s",
-						status, sqlite3_errmsg(connection->db));
 			break; // Break from do/while. Still need to free _collection.
 		}
 		
@@ -2604,8 +2965,7 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
 				
 				if (object)
 					[connection->objectCache setObject:object forKey:cacheKey];
@@ -2646,7 +3006,8 @@
 			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 		}
 		
-		sqlite3_finalize(statement);
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
 		statement = NULL;
 		
 		if (stop) {
@@ -2943,11 +3304,7 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				// Performance tuning:
-				// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
 				
 				// Cache considerations:
 				// Do we want to add the objects/metadata to the cache here?
@@ -3056,11 +3413,7 @@
 					const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 					
-					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-					
-					NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-					object = connection->database->objectDeserializer(collection, key, oData);
+					object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
 					
 					// Cache considerations:
 					// Do we want to add the objects/metadata to the cache here?
@@ -3183,8 +3536,7 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
 				
 				if (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit)
 				{
@@ -3672,11 +4024,7 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				// Performance tuning:
-				// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
 				
 				// Cache considerations:
 				// Do we want to add the objects/metadata to the cache here?
@@ -3824,11 +4172,7 @@
 					const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 					int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 					
-					// Performance tuning:
-					// Use dataWithBytesNoCopy to avoid an extra allocation and memcpy.
-					
-					NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-					object = connection->database->objectDeserializer(collection, key, oData);
+					object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
 					
 					// Cache considerations:
 					// Do we want to add the objects/metadata to the cache here?
@@ -3990,8 +4334,7 @@
 				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
 				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
 				
-				NSData *oData = [NSData dataWithBytesNoCopy:(void *)oBlob length:oBlobSize freeWhenDone:NO];
-				object = connection->database->objectDeserializer(collection, key, oData);
+				object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
 				
 				if (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit)
 				{
@@ -4046,6 +4389,168 @@
 	}
 }
 
+/**
+ * Enumerates the rows whose rowid is greater than minRowid (and no greater than maxRowid), in rowid order,
+ * stopping after the given number of rows.
+ * 
+ * This allows the rows of the database to be processed in batches, across multiple transactions,
+ * by passing the returned rowid as the minRowid of the next batch.
+ * 
+ * The filter block allows you to skip the deserialization step for rows you're not interested in.
+ * Rows which are filtered out still count towards the limit.
+ * 
+ * Returns the rowid of the last row that was enumerated (whether filtered or not),
+ * or minRowid if there were no such rows.
+**/
+- (int64_t)_enumerateRowsAfterRowid:(int64_t)minRowid
+                          upToRowid:(int64_t)maxRowid
+                              limit:(NSUInteger)limit
+     usingBlock:(void (^)(int64_t rowid, NSString *collection, NSString *key, id object, id metadata, BOOL *stop))block
+     withFilter:(BOOL (^)(int64_t rowid, NSString *collection, NSString *key))filter
+{
+	if (block == NULL) return minRowid;
+	if (limit == 0) return minRowid;
+	
+	NSString *query =
+	  @"SELECT \"rowid\", \"collection\", \"key\", \"data\", \"metadata\" FROM \"database2\""
+	  @" WHERE \"rowid\" > ? AND \"rowid\" <= ? ORDER BY \"rowid\" ASC LIMIT ?;";
+	
+	sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+	if (statement == NULL) return minRowid;
+	
+	YapMutationStackItem_Bool *mutation = [connection->mutationStack push]; // mutation during enumeration protection
+	BOOL stop = NO;
+	
+	int const column_idx_rowid      = SQLITE_COLUMN_START + 0;
+	int const column_idx_collection = SQLITE_COLUMN_START + 1;
+	int const column_idx_key        = SQLITE_COLUMN_START + 2;
+	int const column_idx_data       = SQLITE_COLUMN_START + 3;
+	int const column_idx_metadata   = SQLITE_COLUMN_START + 4;
+	
+	int const bind_idx_minRowid     = SQLITE_BIND_START + 0;
+	int const bind_idx_maxRowid     = SQLITE_BIND_START + 1;
+	int const bind_idx_limit        = SQLITE_BIND_START + 2;
+	
+	sqlite3_bind_int64(statement, bind_idx_minRowid, minRowid);
+	sqlite3_bind_int64(statement, bind_idx_maxRowid, maxRowid);
+	sqlite3_bind_int64(statement, bind_idx_limit, (sqlite3_int64)MIN(limit, (NSUInteger)INT64_MAX));
+	
+	BOOL unlimitedObjectCacheLimit = (connection->objectCacheLimit == 0);
+	BOOL unlimitedMetadataCacheLimit = (connection->metadataCacheLimit == 0);
+	
+	int64_t lastRowid = minRowid;
+	
+	int status;
+	while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		int64_t rowid = sqlite3_column_int64(statement, column_idx_rowid);
+		lastRowid = rowid;
+		
+		const unsigned char *text1 = sqlite3_column_text(statement, column_idx_collection);
+		int textSize1 = sqlite3_column_bytes(statement, column_idx_collection);
+		
+		const unsigned char *text2 = sqlite3_column_text(statement, column_idx_key);
+		int textSize2 = sqlite3_column_bytes(statement, column_idx_key);
+		
+		NSString *collection, *key;
+		
+		collection = [[NSString alloc] initWithBytes:text1 length:textSize1 encoding:NSUTF8StringEncoding];
+		key        = [[NSString alloc] initWithBytes:text2 length:textSize2 encoding:NSUTF8StringEncoding];
+		
+		BOOL invokeBlock = (filter == NULL) ? YES : filter(rowid, collection, key);
+		if (invokeBlock)
+		{
+			YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
+			
+			id object = [connection->objectCache objectForKey:cacheKey];
+			if (object == nil)
+			{
+				const void *oBlob = sqlite3_column_blob(statement, column_idx_data);
+				int oBlobSize = sqlite3_column_bytes(statement, column_idx_data);
+				
+				object = YapDatabaseDeserializeObjectBlob(connection->database, collection, key, oBlob, oBlobSize);
+				
+				if (unlimitedObjectCacheLimit || [connection->objectCache count] < connection->objectCacheLimit)
+				{
+					if (object)
+						[connection->objectCache setObject:object forKey:cacheKey];
+				}
+			}
+			
+			id metadata = [connection->metadataCache objectForKey:cacheKey];
+			if (metadata)
+			{
+				if (metadata == [YapNull null])
+					metadata = nil;
+			}
+			else
+			{
+				const void *mBlob = sqlite3_column_blob(statement, column_idx_metadata);
+				int mBlobSize = sqlite3_column_bytes(statement, column_idx_metadata);
+				
+				if (mBlobSize > 0)
+				{
+					NSData *mData = [NSData dataWithBytesNoCopy:(void *)mBlob length:mBlobSize freeWhenDone:NO];
+					metadata = connection->database->metadataDeserializer(collection, key, mData);
+				}
+				
+				if (unlimitedMetadataCacheLimit ||
+				    [connection->metadataCache count] < connection->metadataCacheLimit)
+				{
+					if (metadata)
+						[connection->metadataCache setObject:metadata forKey:cacheKey];
+					else
+						[connection->metadataCache setObject:[YapNull null] forKey:cacheKey];
+				}
+			}
+			
+			block(rowid, collection, key, object, metadata, &stop);
+			
+			if (stop || mutation.isMutated) break;
+		}
+	}
+	
+	if ((status != SQLITE_DONE) && !stop && !mutation.isMutated)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	
+	if (!stop && mutation.isMutated)
+	{
+		@throw [self mutationDuringEnumerationException];
+	}
+	
+	return lastRowid;
+}
+
+/**
+ * Returns the largest rowid in the database, or zero if the database is empty.
+**/
+- (int64_t)_maxRowid
+{
+	sqlite3_stmt *statement = [connection cachedStatementForQuery:@"SELECT MAX(\"rowid\") FROM \"database2\";"];
+	if (statement == NULL) return 0;
+	
+	int64_t result = 0;
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		result = sqlite3_column_int64(statement, SQLITE_COLUMN_START);
+	}
+	else if (status == SQLITE_ERROR)
+	{
+		YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_reset(statement);
+	
+	return result;
+}
+
 /**
  * Fetches the rowid for each given key.
  *
@@ -4116,13 +4621,10 @@
 		
 		[query appendString:@");"];
 		
-		sqlite3_stmt *statement;
-		
-		int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-		if (status != SQLITE_OK)
+		int status;
+		sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+		if (statement == NULL)
 		{
-			YDBLogError(@"Error creating 'objectsForKeys' statement: %d %s",
-						status, sqlite3_errmsg(connection->db));
 			break; // Break from do/while. Still need to free _collection.
 		}
 		
@@ -4171,7 +4673,8 @@
 			YDBLogError(@"%@ - sqlite_step error: %d %s", THIS_METHOD, status, sqlite3_errmsg(connection->db));
 		}
 		
-		sqlite3_finalize(statement);
+		sqlite3_clear_bindings(statement);
+		sqlite3_reset(statement);
 		statement = NULL;
 		
 		if (stop) {
@@ -4423,6 +4926,52 @@
 	return result;
 }
 
+- (BOOL)getInt64Value:(int64_t *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	if (extensionName == nil)
+		extensionName = @"";
+	
+	sqlite3_stmt *statement = [connection yapGetDataForKeyStatement];
+	if (statement == NULL) {
+		if (valuePtr) *valuePtr = 0;
+		return NO;
+	}
+	
+	BOOL result = NO;
+	int64_t value = 0;
+	
+	// SELECT "data" FROM "yap2" WHERE "extension" = ? AND "key" = ? ;
+	
+	int const column_idx_data    = SQLITE_COLUMN_START;
+	int const bind_idx_extension = SQLITE_BIND_START + 0;
+	int const bind_idx_key       = SQLITE_BIND_START + 1;
+	
+	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
+	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	
+	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
+	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_ROW)
+	{
+		result = YES;
+		value = sqlite3_column_int64(statement, column_idx_data);
+	}
+	else if (status == SQLITE_ERROR)
+	{
+		YDBLogError(@"Error executing 'yapGetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	FreeYapDatabaseString(&_extension);
+	FreeYapDatabaseString(&_key);
+	
+	if (valuePtr) *valuePtr = value;
+	return result;
+}
+
 - (BOOL)getDoubleValue:(double *)valuePtr forKey:(NSString *)key extension:(NSString *)extensionName
 {
 	if (extensionName == nil)
@@ -4895,6 +5444,7 @@
 	
 	[connection->objectCache setObject:object forKey:cacheKey];
 	[connection->objectChanges setObject:_object forKey:cacheKey];
+	[connection->changedRowids setObject:cacheKey forKey:@(rowid)];
 	
 	if (metadata)
 	{
@@ -5116,6 +5666,7 @@
 	
 	[connection->objectCache setObject:object forKey:cacheKey];
 	[connection->objectChanges setObject:_object forKey:cacheKey];
+	[connection->changedRowids setObject:cacheKey forKey:@(rowid)];
 	
 	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
 	{
@@ -5305,6 +5856,8 @@
 		[connection->metadataChanges setObject:[YapNull null] forKey:cacheKey];
 	}
 	
+	[connection->changedRowids setObject:cacheKey forKey:@(rowid)];
+	
 	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
 	{
 		[extTransaction didReplaceMetadata:metadata forCollectionKey:cacheKey withRowid:rowid];
@@ -5332,6 +5885,8 @@
 	if ([connection->objectChanges objectForKey:cacheKey] == nil)
 		[connection->objectChanges setObject:[YapTouch touch] forKey:cacheKey];
 	
+	[connection->changedRowids setObject:cacheKey forKey:@(rowid)];
+	
 	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
 	{
 		[extTransaction didTouchObjectForCollectionKey:cacheKey withRowid:rowid];
@@ -5350,6 +5905,8 @@
 	if ([connection->metadataChanges objectForKey:cacheKey] == nil)
 		[connection->metadataChanges setObject:[YapTouch touch] forKey:cacheKey];
 	
+	[connection->changedRowids setObject:cacheKey forKey:@(rowid)];
+	
 	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
 	{
 		[extTransaction didTouchMetadataForCollectionKey:cacheKey withRowid:rowid];
@@ -5371,6 +5928,8 @@
 	if ([connection->metadataChanges objectForKey:cacheKey] == nil)
 		[connection->metadataChanges setObject:[YapTouch touch] forKey:cacheKey];
 	
+	[connection->changedRowids setObject:cacheKey forKey:@(rowid)];
+	
 	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
 	{
 		[extTransaction didTouchRowForCollectionKey:cacheKey withRowid:rowid];
@@ -5430,6 +5989,7 @@
 	[connection->metadataChanges removeObjectForKey:cacheKey];
 	[connection->removedKeys addObject:cacheKey];
 	[connection->removedRowids addObject:@(rowid)];
+	[connection->changedRowids setObject:cacheKey forKey:@(rowid)];
 	
 	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
 	{
@@ -5524,13 +6084,10 @@
 			
 			[query appendString:@");"];
 			
-			sqlite3_stmt *statement;
-			
-			int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-			if (status != SQLITE_OK)
+			int status;
+			sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+			if (statement == NULL)
 			{
-				YDBLogError(@"Error creating 'removeKeys:inCollection:' statement (A): %d %s",
-				                                                              status, sqlite3_errmsg(connection->db));
 				FreeYapDatabaseString(&_collection);
 				return;
 			}
@@ -5562,7 +6119,8 @@
 				                                                               status, sqlite3_errmsg(connection->db));
 			}
 			
-			sqlite3_finalize(statement);
+			sqlite3_clear_bindings(statement);
+			sqlite3_reset(statement);
 			statement = NULL;
 		}
 		
@@ -5590,13 +6148,10 @@
 			
 			[query appendString:@");"];
 			
-			sqlite3_stmt *statement;
-			
-			int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-			if (status != SQLITE_OK)
+			int status;
+			sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+			if (statement == NULL)
 			{
-				YDBLogError(@"Error creating 'removeKeys:inCollection:' statement (B): %d %s",
-							status, sqlite3_errmsg(connection->db));
 				return;
 			}
 			
@@ -5621,7 +6176,8 @@
 							status, sqlite3_errmsg(connection->db));
 			}
 			
-			sqlite3_finalize(statement);
+			sqlite3_clear_bindings(statement);
+			sqlite3_reset(statement);
 			statement = NULL;
 			
 			connection->hasDiskChanges = YES;
@@ -5630,8 +6186,9 @@
 			[connection->keyCache removeObjectsForKeys:foundRowids];
 			[connection->removedRowids addObjectsFromArray:foundRowids];
 			
-			for (NSString *key in foundKeys)
+			for (i = 0; i < foundCount; i++)
 			{
+				NSString *key = [foundKeys objectAtIndex:i];
 				YapCollectionKey *cacheKey = [[YapCollectionKey alloc] initWithCollection:collection key:key];
 				
 				[connection->objectCache removeObjectForKey:cacheKey];
@@ -5640,6 +6197,7 @@
 				[connection->objectChanges removeObjectForKey:cacheKey];
 				[connection->metadataChanges removeObjectForKey:cacheKey];
 				[connection->removedKeys addObject:cacheKey];
+				[connection->changedRowids setObject:cacheKey forKey:[foundRowids objectAtIndex:i]];
 			}
 			
 			for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
@@ -5880,14 +6438,10 @@
 			
 			[query appendString:@");"];
 			
-			sqlite3_stmt *statement;
-			
-			int status = sqlite3_prepare_v2(connection->db, [query UTF8String], -1, &statement, NULL);
-			if (status != SQLITE_OK)
+			int status;
+			sqlite3_stmt *statement = [connection cachedStatementForQuery:query];
+			if (statement == NULL)
 			{
-				YDBLogError(@"Error creating 'removeAllObjectsInCollection:' statement: %d %s",
-				            status, sqlite3_errmsg(connection->db));
-				
 				FreeYapDatabaseString(&_collection);
 				return;
 			}
@@ -5913,7 +6467,8 @@
 				            status, sqlite3_errmsg(connection->db));
 			}
 			
-			sqlite3_finalize(statement);
+			sqlite3_clear_bindings(statement);
+			sqlite3_reset(statement);
 			statement = NULL;
 			
 			connection->hasDiskChanges = YES;
@@ -5969,6 +6524,7 @@
 	[connection->removedKeys removeAllObjects];
 	[connection->removedCollections removeAllObjects];
 	[connection->removedRowids removeAllObjects];
+	[connection->changedRowids removeAllObjects];
 	connection->allKeysRemoved = YES;
 	
 	for (YapDatabaseExtensionTransaction *extTransaction in [self orderedExtensions])
@@ -6078,6 +6634,44 @@
 	FreeYapDatabaseString(&_key);
 }
 
+- (void)setInt64Value:(int64_t)value forKey:(NSString *)key extension:(NSString *)extensionName
+{
+	if (extensionName == nil)
+		extensionName = @"";
+	
+	sqlite3_stmt *statement = [connection yapSetDataForKeyStatement];
+	if (statement == NULL) return;
+	
+	// INSERT OR REPLACE INTO "yap2" ("extension", "key", "data") VALUES (?, ?, ?);
+	
+	int const bind_idx_extension = SQLITE_BIND_START + 0;
+	int const bind_idx_key       = SQLITE_BIND_START + 1;
+	int const bind_idx_data      = SQLITE_BIND_START + 2;
+	
+	YapDatabaseString _extension; MakeYapDatabaseString(&_extension, extensionName);
+	sqlite3_bind_text(statement, bind_idx_extension, _extension.str, _extension.length, SQLITE_STATIC);
+	
+	YapDatabaseString _key; MakeYapDatabaseString(&_key, key);
+	sqlite3_bind_text(statement, bind_idx_key, _key.str, _key.length, SQLITE_STATIC);
+	
+	sqlite3_bind_int64(statement, bind_idx_data, (sqlite3_int64)value);
+	
+	int status = sqlite3_step(statement);
+	if (status == SQLITE_DONE)
+	{
+		connection->hasDiskChanges = YES;
+	}
+	else
+	{
+		YDBLogError(@"Error executing 'yapSetDataForKeyStatement': %d %s", status, sqlite3_errmsg(connection->db));
+	}
+	
+	sqlite3_clear_bindings(statement);
+	sqlite3_reset(statement);
+	FreeYapDatabaseString(&_extension);
+	FreeYapDatabaseString(&_key);
+}
+
 - (void)setDoubleValue:(double)value forKey:(NSString *)key extension:(NSString *)extensionName
 {
 	if (extensionName == nil)
@@ -0,0 +1,116 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class AttachmentDecryptionTests: XCTestCase {
+
+    private let plaintext = Data((0..<100_000).map { UInt8(truncatingIfNeeded: $0 &* 31) })
+
+    private var directoryPath: String!
+    private var encryptedFilePath: String!
+    private var plaintextFilePath: String!
+    private var key = NSData()
+    private var digest = NSData()
+
+    override func setUp() {
+        super.setUp()
+
+        directoryPath = (NSTemporaryDirectory() as NSString).appendingPathComponent(UUID().uuidString)
+        try! FileManager.default.createDirectory(atPath: directoryPath, withIntermediateDirectories: true, attributes: nil)
+
+        encryptedFilePath = (directoryPath as NSString).appendingPathComponent("attachment.encrypted")
+        plaintextFilePath = (directoryPath as NSString).appendingPathComponent("attachment.jpg")
+
+        try! Cryptography.encryptAttachmentStream(InputStream(data: plaintext), toPath: encryptedFilePath, outKey: &key, outDigest: &digest)
+    }
+
+    override func tearDown() {
+        try? FileManager.default.removeItem(atPath: directoryPath)
+
+        super.tearDown()
+    }
+
+    private func decrypt(digest: Data? = nil) -> Bool {
+        do {
+            try Cryptography.decryptAttachment(atPath: encryptedFilePath,
+                                               toPath: plaintextFilePath,
+                                               withKey: key as Data,
+                                               digest: digest ?? self.digest as Data,
+                                               unpaddedSize: UInt32(plaintext.count))
+            return true
+        } catch {
+            return false
+        }
+    }
+
+    private func modifyEncryptedFile(_ block: (inout Data) -> Void) {
+        var data = try! Data(contentsOf: URL(fileURLWithPath: encryptedFilePath))
+        block(&data)
+        try! data.write(to: URL(fileURLWithPath: encryptedFilePath))
+    }
+
+    // Only the encrypted file may be left behind: no plaintext, and no partially written temporary file.
+    private func assertNoPlaintextWritten(file: StaticString = #file, line: UInt = #line) {
+        let contents = try! FileManager.default.contentsOfDirectory(atPath: directoryPath)
+        XCTAssertEqual(contents, ["attachment.encrypted"], file: file, line: line)
+    }
+
+    func testDecryptsToPath() {
+        XCTAssertTrue(decrypt())
+
+        XCTAssertEqual(try! Data(contentsOf: URL(fileURLWithPath: plaintextFilePath)), plaintext)
+        XCTAssertEqual(Set(try! FileManager.default.contentsOfDirectory(atPath: directoryPath)), ["attachment.encrypted", "attachment.jpg"])
+    }
+
+    func testTamperedMACLeavesNoPlaintext() {
+        modifyEncryptedFile { data in data[data.count - 1] ^= 0x01 }
+
+        XCTAssertFalse(decrypt())
+        assertNoPlaintextWritten()
+    }
+
+    func testTamperedCiphertextLeavesNoPlaintext() {
+        modifyEncryptedFile { data in data[data.count / 2] ^= 0x01 }
+
+        XCTAssertFalse(decrypt())
+        assertNoPlaintextWritten()
+    }
+
+    func testTamperedDigestLeavesNoPlaintext() {
+        var tamperedDigest = digest as Data
+        tamperedDigest[0] ^= 0x01
+
+        XCTAssertFalse(decrypt(digest: tamperedDigest))
+        assertNoPlaintextWritten()
+    }
+
+    func testTruncatedFileLeavesNoPlaintext() {
+        modifyEncryptedFile { data in data.removeLast(16) }
+
+        XCTAssertFalse(decrypt())
+        assertNoPlaintextWritten()
+    }
+
+    func testFailedDecryptionKeepsExistingFile() {
+        let existing = Data("existing".utf8)
+        try! existing.write(to: URL(fileURLWithPath: plaintextFilePath))
+        modifyEncryptedFile { data in data[data.count - 1] ^= 0x01 }
+
+        XCTAssertFalse(decrypt())
+        XCTAssertEqual(try! Data(contentsOf: URL(fileURLWithPath: plaintextFilePath)), existing)
+    }
+}
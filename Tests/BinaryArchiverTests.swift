@@ -0,0 +1,131 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class BinaryArchiverTests: XCTestCase {
+
+    private let iterations = 1000
+
+    private lazy var incomingMessage: TSIncomingMessage = {
+        let thread = TSContactThread(uniqueId: "SomeUser")!
+        let body = "SOFA::Message:{\"body\":\"\(String(repeating: "o hai ", count: 40))\"}"
+
+        return TSIncomingMessage(timestamp: 1514764800000,
+                                 in: thread,
+                                 authorId: "SomeUser",
+                                 sourceDeviceId: 1,
+                                 messageBody: body)
+    }()
+
+    private lazy var sessionRecord: SessionRecord = {
+        let record = SessionRecord()
+
+        // A few archived states make this closer in size to a long-lived session.
+        for _ in 0..<3 {
+            let state = record.sessionState()
+            state.version = 3
+            state.aliceBaseKey = Randomness.generateRandomBytes(33)
+            state.remoteIdentityKey = Randomness.generateRandomBytes(33)
+            state.localIdentityKey = Randomness.generateRandomBytes(33)
+            state.rootKey = RootKey(data: Randomness.generateRandomBytes(32))
+            state.remoteRegistrationId = 1234
+            state.localRegistrationId = 5678
+
+            for index in 0..<4 {
+                state.addReceiverChain(Randomness.generateRandomBytes(33),
+                                       chainKey: ChainKey(data: Randomness.generateRandomBytes(32), index: Int32(index)))
+            }
+
+            record.archiveCurrentState()
+        }
+
+        return record
+    }()
+
+    func testIncomingMessageRoundTrip() {
+        let data = OWSBinaryArchiver.archivedData(withRootObject: incomingMessage)
+        XCTAssertTrue(OWSBinaryUnarchiver.isBinaryArchive(data))
+
+        let decoded = OWSBinaryUnarchiver.unarchiveObject(with: data, unknownClassBlock: nil) as? TSIncomingMessage
+        XCTAssertNotNil(decoded)
+        XCTAssertEqual(decoded?.uniqueId, incomingMessage.uniqueId)
+        XCTAssertEqual(decoded?.timestamp, incomingMessage.timestamp)
+        XCTAssertEqual(decoded?.body, incomingMessage.body)
+        XCTAssertEqual(decoded?.uniqueThreadId, incomingMessage.uniqueThreadId)
+    }
+
+    func testSessionRecordRoundTrip() {
+        let data = OWSBinaryArchiver.archivedData(withRootObject: sessionRecord)
+        let decoded = OWSBinaryUnarchiver.unarchiveObject(with: data, unknownClassBlock: nil) as? SessionRecord
+
+        XCTAssertNotNil(decoded)
+        XCTAssertEqual(decoded?.previousSessionStates().count, sessionRecord.previousSessionStates().count)
+
+        let state = decoded?.previousSessionStates().firstObject as? SessionState
+        let expectedState = sessionRecord.previousSessionStates().firstObject as? SessionState
+        XCTAssertEqual(state?.rootKey.keyData, expectedState?.rootKey.keyData)
+        XCTAssertEqual(state?.remoteRegistrationId, expectedState?.remoteRegistrationId)
+    }
+
+    func testKeyedArchiveIsNotBinaryArchive() {
+        let data = NSKeyedArchiver.archivedData(withRootObject: incomingMessage)
+        XCTAssertFalse(OWSBinaryUnarchiver.isBinaryArchive(data))
+    }
+
+    func testBinaryArchiveIsSmallerThanKeyedArchive() {
+        let keyed = NSKeyedArchiver.archivedData(withRootObject: sessionRecord)
+        let binary = OWSBinaryArchiver.archivedData(withRootObject: sessionRecord)
+
+        XCTAssertLessThan(binary.count, keyed.count)
+    }
+
+    func testPerformanceKeyedArchiverIncomingMessage() {
+        measure {
+            for _ in 0..<self.iterations {
+                let data = NSKeyedArchiver.archivedData(withRootObject: self.incomingMessage)
+                _ = NSKeyedUnarchiver.unarchiveObject(with: data)
+            }
+        }
+    }
+
+    func testPerformanceBinaryArchiverIncomingMessage() {
+        measure {
+            for _ in 0..<self.iterations {
+                let data = OWSBinaryArchiver.archivedData(withRootObject: self.incomingMessage)
+                _ = OWSBinaryUnarchiver.unarchiveObject(with: data, unknownClassBlock: nil)
+            }
+        }
+    }
+
+    func testPerformanceKeyedArchiverSessionRecord() {
+        measure {
+            for _ in 0..<self.iterations {
+                let data = NSKeyedArchiver.archivedData(withRootObject: self.sessionRecord)
+                _ = NSKeyedUnarchiver.unarchiveObject(with: data)
+            }
+        }
+    }
+
+    func testPerformanceBinaryArchiverSessionRecord() {
+        measure {
+            for _ in 0..<self.iterations {
+                let data = OWSBinaryArchiver.archivedData(withRootObject: self.sessionRecord)
+                _ = OWSBinaryUnarchiver.unarchiveObject(with: data, unknownClassBlock: nil)
+            }
+        }
+    }
+}
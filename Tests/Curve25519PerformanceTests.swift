@@ -0,0 +1,129 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class Curve25519PerformanceTests: XCTestCase {
+
+    // TSPreKeyManager refills one-time prekeys 100 at a time.
+    private let keyCount = 100
+    private let signedData = Data(count: 33)
+
+    // The Curve25519 base point. A shared secret with it is the public key, computed with the Montgomery ladder,
+    // which is how generateKeyPair used to derive public keys.
+    private let basePoint = Data([9] + [UInt8](repeating: 0, count: 31))
+
+    // MARK: - Key generation
+
+    func testGeneratedPublicKeysMatchTheLadder() {
+        for _ in 0..<keyCount {
+            let keyPair = Curve25519.generateKeyPair()!
+
+            XCTAssertEqual(Curve25519.generateSharedSecret(fromPublicKey: basePoint, andKeyPair: keyPair), keyPair.publicKey())
+        }
+    }
+
+    func testKeyGeneration() {
+        measure {
+            for _ in 0..<self.keyCount {
+                XCTAssertNotNil(Curve25519.generateKeyPair())
+            }
+        }
+    }
+
+    func testKeyGenerationWithTheLadder() {
+        let keyPairs = (0..<keyCount).map { _ in Curve25519.generateKeyPair()! }
+
+        measure {
+            for keyPair in keyPairs {
+                XCTAssertNotNil(Curve25519.generateSharedSecret(fromPublicKey: self.basePoint, andKeyPair: keyPair))
+            }
+        }
+    }
+
+    // MARK: - Verification
+
+    func testVerifierMatchesVerifySignature() {
+        let identityKeyPair = Curve25519.generateKeyPair()!
+        let otherKeyPair = Curve25519.generateKeyPair()!
+        let verifier = Ed25519Verifier(publicKey: identityKeyPair.publicKey())
+
+        for _ in 0..<keyCount {
+            let signedPreKey = Curve25519.generateKeyPair()!.publicKey()!
+            let signature = Ed25519.sign(signedPreKey, with: identityKeyPair)!
+
+            var tamperedSignature = signature
+            tamperedSignature[Int(arc4random_uniform(64))] ^= 1 << UInt8(arc4random_uniform(8))
+
+            var tamperedData = signedPreKey
+            tamperedData[Int(arc4random_uniform(32))] ^= 1
+
+            XCTAssertTrue(verifier.verifySignature(signature, data: signedPreKey))
+            XCTAssertTrue(Ed25519.verifySignature(signature, publicKey: identityKeyPair.publicKey(), data: signedPreKey))
+
+            XCTAssertFalse(verifier.verifySignature(tamperedSignature, data: signedPreKey))
+            XCTAssertFalse(Ed25519.verifySignature(tamperedSignature, publicKey: identityKeyPair.publicKey(), data: signedPreKey))
+
+            XCTAssertFalse(verifier.verifySignature(signature, data: tamperedData))
+            XCTAssertFalse(Ed25519.verifySignature(signature, publicKey: otherKeyPair.publicKey(), data: signedPreKey))
+        }
+    }
+
+    func testVerifierOfLongMessages() {
+        let keyPair = Curve25519.generateKeyPair()!
+        let verifier = Ed25519Verifier(publicKey: keyPair.publicKey())
+
+        // Longer than the verifier hashes from a stack buffer.
+        let data = Randomness.generateRandomBytes(4096)!
+        let signature = Ed25519.sign(data, with: keyPair)!
+
+        XCTAssertTrue(verifier.verifySignature(signature, data: data))
+        XCTAssertFalse(verifier.verifySignature(signature, data: data.subdata(in: 0..<4095)))
+    }
+
+    // Checking the signed prekeys of a recipient's devices, which share an identity key.
+
+    private func signedPreKeys() -> (identityKey: Data, signedPreKeys: [(Data, Data)]) {
+        let identityKeyPair = Curve25519.generateKeyPair()!
+        let signedPreKeys = (0..<keyCount).map { _ -> (Data, Data) in
+            let signedPreKey = Curve25519.generateKeyPair()!.publicKey()!
+            return (signedPreKey, Ed25519.sign(signedPreKey, with: identityKeyPair)!)
+        }
+
+        return (identityKeyPair.publicKey()!, signedPreKeys)
+    }
+
+    func testVerifyingWithANewVerifierEachTime() {
+        let (identityKey, signedPreKeys) = self.signedPreKeys()
+
+        // What every verification used to do: convert and decompress the identity key again.
+        measure {
+            for (signedPreKey, signature) in signedPreKeys {
+                XCTAssertTrue(Ed25519Verifier(publicKey: identityKey).verifySignature(signature, data: signedPreKey))
+            }
+        }
+    }
+
+    func testVerifyingWithACachedVerifier() {
+        let (identityKey, signedPreKeys) = self.signedPreKeys()
+
+        measure {
+            for (signedPreKey, signature) in signedPreKeys {
+                XCTAssertTrue(Ed25519.verifySignature(signature, publicKey: identityKey, data: signedPreKey))
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class DatabaseConnectionPoolTests: TemporaryDatabaseTestCase {
+
+    private let collection = "pool"
+    private let keyCount = 2000
+
+    override func setUp() {
+        super.setUp()
+
+        database.newConnection().readWrite { transaction in
+            for index in 0..<self.keyCount {
+                transaction.setObject(String(repeating: "x", count: 256), forKey: "key-\(index)", inCollection: self.collection)
+            }
+        }
+    }
+
+    private func makePool(maxConnections: UInt) -> OWSDatabaseConnectionPool {
+        return OWSDatabaseConnectionPool(database: database, maxConnections: maxConnections, objectCacheCostLimit: 2 * 1024 * 1024)
+    }
+
+    // Each thread reads every key, one read transaction per key, like UI data sources do.
+    private func readConcurrently(threads: Int, read: @escaping (@escaping (YapDatabaseReadTransaction) -> Void) -> Void) {
+        DispatchQueue.concurrentPerform(iterations: threads) { _ in
+            for index in 0..<self.keyCount {
+                read { transaction in
+                    _ = transaction.object(forKey: "key-\(index)", inCollection: self.collection)
+                }
+            }
+        }
+    }
+
+    func testReadsSeeCompletedWrites() {
+        let pool = makePool(maxConnections: 4)
+        let writer = database.newConnection()
+
+        for index in 0..<20 {
+            writer.readWrite { transaction in
+                transaction.setObject(index, forKey: "counter", inCollection: self.collection)
+            }
+
+            pool.read { transaction in
+                XCTAssertEqual(transaction.object(forKey: "counter", inCollection: self.collection) as? Int, index)
+            }
+        }
+    }
+
+    func testNestedReadsDoNotDeadlock() {
+        let pool = makePool(maxConnections: 1)
+        var value: String?
+
+        pool.read { _ in
+            pool.read { transaction in
+                value = transaction.object(forKey: "key-0", inCollection: self.collection) as? String
+            }
+        }
+
+        XCTAssertNotNil(value)
+        XCTAssertEqual(pool.stats().connectionCount, 1)
+    }
+
+    func testAsyncReadCallsCompletion() {
+        let pool = makePool(maxConnections: 2)
+        let done = expectation(description: "completion")
+        var value: String?
+
+        pool.asyncRead({ transaction in
+            value = transaction.object(forKey: "key-1", inCollection: self.collection) as? String
+        }, completionBlock: {
+            XCTAssertNotNil(value)
+            done.fulfill()
+        })
+
+        waitForExpectations(timeout: 5)
+    }
+
+    func testConcurrentReadsRunInParallel() {
+        let pool = makePool(maxConnections: 4)
+
+        readConcurrently(threads: 8) { block in pool.read(block) }
+
+        let stats = pool.stats()
+        XCTAssertEqual(stats.readCount, UInt(8 * keyCount))
+        XCTAssertLessThanOrEqual(stats.connectionCount, 4)
+        XCTAssertGreaterThan(stats.peakConcurrentReads, 1)
+    }
+
+    func testConcurrentReadsPerformanceOnSingleConnection() {
+        let connection = database.newConnection()
+
+        measure {
+            readConcurrently(threads: 8) { block in connection.read(block) }
+        }
+    }
+
+    func testConcurrentReadsPerformanceOnPool() {
+        let pool = makePool(maxConnections: 4)
+
+        measure {
+            readConcurrently(threads: 8) { block in pool.read(block) }
+        }
+
+        let stats = pool.stats()
+        XCTAssertEqual(stats.readCount % UInt(8 * keyCount), 0)
+        XCTAssertLessThanOrEqual(stats.connectionCount, 4)
+        XCTAssertLessThanOrEqual(stats.peakConcurrentReads, 4)
+    }
+}
@@ -0,0 +1,124 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+// Message processing doesn't wait for the async indexes to be populated, so messages arrive,
+// start expiring and are removed while the disappearing messages index is still being built.
+class DisappearingMessagesPopulationTests: TemporaryDatabaseTestCase {
+
+    private let address = "0xa2a0134f1df987bc388dbcb635dfeed4ce497e2a"
+    private let messageCount = 5000
+    private let batchSize: UInt = 100
+
+    private let finder = OWSDisappearingMessagesFinder()
+    private var thread: TSContactThread!
+
+    override func setUp() {
+        super.setUp()
+
+        thread = TSContactThread(uniqueId: "c\(address)")!
+
+        // Every other message has been read and has expired; the rest haven't been read yet.
+        database.newConnection().readWrite { transaction in
+            self.thread.save(with: transaction)
+
+            for index in 0..<self.messageCount {
+                self.expiringMessage(uniqueId: "message-\(index)", hasExpired: index % 2 == 0).save(with: transaction)
+            }
+        }
+    }
+
+    private func expiringMessage(uniqueId: String, hasExpired: Bool) -> TSIncomingMessage {
+        let message = TSIncomingMessage(timestamp: NSDate.ows_millisecondTimeStamp(), in: thread, authorId: address, sourceDeviceId: 1, messageBody: "hi", attachmentIds: [], expiresInSeconds: 60)
+        message.uniqueId = uniqueId
+        if hasExpired {
+            message.expireStartedAt = NSDate.ows_millisecondTimeStamp() - 3600 * 1000
+        }
+
+        return message
+    }
+
+    private func expiredMessageIds(_ transaction: YapDatabaseReadTransaction) -> Set<String> {
+        var messageIds = Set<String>()
+        finder.enumerateExpiredMessages(block: { message in
+            messageIds.insert(message.uniqueId!)
+        }, transaction: transaction)
+
+        return messageIds
+    }
+
+    // The expired messages, found without the index.
+    private func expectedExpiredMessageIds(_ transaction: YapDatabaseReadTransaction) -> Set<String> {
+        let now = NSDate.ows_millisecondTimeStamp()
+
+        var messageIds = Set<String>()
+        transaction.enumerateKeysAndObjects(inCollection: TSInteraction.collection()) { key, object, _ in
+            guard let message = object as? TSMessage, message.expiresAt > 0, message.expiresAt <= now else { return }
+            messageIds.insert(key)
+        }
+
+        return messageIds
+    }
+
+    func testProcessingMessagesDuringPopulation() {
+        let index = OWSDisappearingMessagesFinder.indexDatabaseExtension()
+        index.populationBatchSize = batchSize
+        XCTAssertTrue(database.register(index, withName: OWSDisappearingMessagesFinder.databaseExtensionName()))
+
+        let populated = expectation(forNotification: NSNotification.Name.YapDatabaseExtensionPopulated, object: database) { notification in
+            return notification.userInfo?[YapDatabaseExtensionNameKey] as? String == OWSDisappearingMessagesFinder.databaseExtensionName()
+        }
+
+        // Small transactions, interleaved with the batches, like those of message processing: a new message
+        // arrives already read, an unread one is read and starts expiring, and an expired one is removed.
+        var sawUnpopulated = false
+        let connection = database.newConnection()
+        for step in 0..<50 {
+            connection.readWrite { transaction in
+                if !self.finder.isIndexPopulated(with: transaction) {
+                    sawUnpopulated = true
+
+                    // Partial, but never wrong.
+                    XCTAssertTrue(self.expiredMessageIds(transaction).isSubset(of: self.expectedExpiredMessageIds(transaction)))
+                }
+
+                self.expiringMessage(uniqueId: "new-\(step)", hasExpired: true).save(with: transaction)
+
+                let unreadKey = "message-\(self.messageCount - 1 - step * 2)"
+                if let message = transaction.object(forKey: unreadKey, inCollection: TSInteraction.collection()) as? TSMessage {
+                    message.expireStartedAt = NSDate.ows_millisecondTimeStamp() - 3600 * 1000
+                    message.save(with: transaction)
+                }
+
+                transaction.removeObject(forKey: "message-\(step * 2)", inCollection: TSInteraction.collection())
+            }
+        }
+
+        wait(for: [populated], timeout: 60)
+
+        XCTAssertTrue(sawUnpopulated)
+
+        connection.read { transaction in
+            XCTAssertTrue(self.finder.isIndexPopulated(with: transaction))
+
+            let expected = self.expectedExpiredMessageIds(transaction)
+            XCTAssertEqual(expected.count, self.messageCount / 2 + 50)
+            XCTAssertEqual(self.expiredMessageIds(transaction), expected)
+            XCTAssertNotNil(self.finder.nextExpirationTimestamp(with: transaction))
+        }
+    }
+}
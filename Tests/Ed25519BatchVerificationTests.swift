@@ -0,0 +1,121 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class Ed25519BatchVerificationTests: XCTestCase {
+
+    // Signed prekeys, each signed by a different identity key, like the prekey bundles of a group's members.
+    private struct SignedPreKeys {
+        var signatures = [Data]()
+        var identityKeys = [Data]()
+        var preKeys = [Data]()
+    }
+
+    private func signedPreKeys(count: Int) -> SignedPreKeys {
+        var signedPreKeys = SignedPreKeys()
+
+        for _ in 0..<count {
+            let identityKeyPair = Curve25519.generateKeyPair()!
+            let preKey = Curve25519.generateKeyPair()!.publicKey()!
+
+            signedPreKeys.signatures.append(Ed25519.sign(preKey, with: identityKeyPair)!)
+            signedPreKeys.identityKeys.append(identityKeyPair.publicKey()!)
+            signedPreKeys.preKeys.append(preKey)
+        }
+
+        return signedPreKeys
+    }
+
+    private func invalidIndexes(_ signedPreKeys: SignedPreKeys) -> IndexSet {
+        return Ed25519.indexesOfInvalidSignatures(signedPreKeys.signatures,
+                                                  publicKeys: signedPreKeys.identityKeys,
+                                                  data: signedPreKeys.preKeys)
+    }
+
+    func testValidBatch() {
+        XCTAssertTrue(invalidIndexes(signedPreKeys(count: 100)).isEmpty)
+        XCTAssertTrue(invalidIndexes(signedPreKeys(count: 1)).isEmpty)
+        XCTAssertTrue(invalidIndexes(SignedPreKeys()).isEmpty)
+    }
+
+    func testBatchFindsInvalidSignatures() {
+        var signedPreKeys = self.signedPreKeys(count: 100)
+
+        // A bit flipped in R, in S, and in the sign bit; data signed by someone else; a key swapped with another's.
+        signedPreKeys.signatures[3][7] ^= 0x10
+        signedPreKeys.signatures[40][40] ^= 0x01
+        signedPreKeys.signatures[41][63] ^= 0x80
+        signedPreKeys.preKeys[70] = signedPreKeys.preKeys[71]
+        signedPreKeys.identityKeys[99] = signedPreKeys.identityKeys[0]
+
+        XCTAssertEqual(invalidIndexes(signedPreKeys), IndexSet([3, 40, 41, 70, 99]))
+
+        for index in 0..<100 {
+            let isValid = Ed25519.verifySignature(signedPreKeys.signatures[index],
+                                                  publicKey: signedPreKeys.identityKeys[index],
+                                                  data: signedPreKeys.preKeys[index])
+            XCTAssertEqual(isValid, ![3, 40, 41, 70, 99].contains(index))
+        }
+    }
+
+    // MARK: - Throughput
+
+    // The same number of signatures in every benchmark, so they compare directly.
+    private let signatureCount = 1024
+
+    private func measureOneByOne() {
+        let signedPreKeys = self.signedPreKeys(count: signatureCount)
+
+        measure {
+            for index in 0..<self.signatureCount {
+                XCTAssertTrue(Ed25519.verifySignature(signedPreKeys.signatures[index],
+                                                      publicKey: signedPreKeys.identityKeys[index],
+                                                      data: signedPreKeys.preKeys[index]))
+            }
+        }
+    }
+
+    private func measureBatches(of batchSize: Int) {
+        let signedPreKeys = self.signedPreKeys(count: signatureCount)
+
+        measure {
+            for start in stride(from: 0, to: self.signatureCount, by: batchSize) {
+                let range = start..<(start + batchSize)
+                let invalidIndexes = Ed25519.indexesOfInvalidSignatures(Array(signedPreKeys.signatures[range]),
+                                                                        publicKeys: Array(signedPreKeys.identityKeys[range]),
+                                                                        data: Array(signedPreKeys.preKeys[range]))
+                XCTAssertTrue(invalidIndexes.isEmpty)
+            }
+        }
+    }
+
+    func testVerifyingOneByOne() {
+        measureOneByOne()
+    }
+
+    func testVerifyingInBatchesOf16() {
+        measureBatches(of: 16)
+    }
+
+    func testVerifyingInBatchesOf64() {
+        measureBatches(of: 64)
+    }
+
+    func testVerifyingInBatchesOf256() {
+        measureBatches(of: 256)
+    }
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import Foundation
+
+// A thread safe, in memory store for the sending side of sessions with many recipients.
+class InMemoryAxolotlStore: NSObject, AxolotlStore {
+
+    private let lock = NSLock()
+    private let localIdentityKeyPair = Curve25519.generateKeyPair()
+    private var sessions = [String: SessionRecord]()
+    private var remoteIdentities = [String: Data]()
+
+    private func withLock<T>(_ block: () -> T) -> T {
+        lock.lock()
+        defer { lock.unlock() }
+
+        return block()
+    }
+
+    private func sessionKey(_ contactIdentifier: String, _ deviceId: Int32) -> String {
+        return "\(contactIdentifier).\(deviceId)"
+    }
+
+    // MARK: - SessionStore
+
+    func loadSession(_ contactIdentifier: String!, deviceId: Int32) -> SessionRecord! {
+        return withLock { sessions[sessionKey(contactIdentifier, deviceId)] } ?? SessionRecord()
+    }
+
+    func subDevicesSessions(_ contactIdentifier: String!) -> [Any]! {
+        return []
+    }
+
+    func storeSession(_ contactIdentifier: String!, deviceId: Int32, session: SessionRecord!) {
+        session.markAsUnFresh()
+        withLock { sessions[sessionKey(contactIdentifier, deviceId)] = session }
+    }
+
+    func containsSession(_ contactIdentifier: String!, deviceId: Int32) -> Bool {
+        return loadSession(contactIdentifier, deviceId: deviceId).sessionState().hasSenderChain()
+    }
+
+    func deleteSession(forContact contactIdentifier: String!, deviceId: Int32) {
+        withLock { sessions[sessionKey(contactIdentifier, deviceId)] = nil }
+    }
+
+    func deleteAllSessions(forContact contactIdentifier: String!) {
+        withLock { sessions = sessions.filter { !$0.key.hasPrefix("\(contactIdentifier!).") } }
+    }
+
+    // MARK: - IdentityKeyStore
+
+    func identityKeyPair() -> ECKeyPair? {
+        return localIdentityKeyPair
+    }
+
+    func localRegistrationId() -> Int32 {
+        return 1
+    }
+
+    func saveRemoteIdentity(_ identityKey: Data, recipientId: String) -> Bool {
+        return withLock {
+            let previousIdentityKey = remoteIdentities.updateValue(identityKey, forKey: recipientId)
+            return previousIdentityKey != nil && previousIdentityKey != identityKey
+        }
+    }
+
+    func isTrustedIdentityKey(_ identityKey: Data, recipientId: String, direction: TSMessageDirection) -> Bool {
+        return withLock { remoteIdentities[recipientId].map { $0 == identityKey } ?? true }
+    }
+
+    // MARK: - PreKeyStore, SignedPreKeyStore; only used to receive.
+
+    func loadPreKey(_ preKeyId: Int32) -> PreKeyRecord! {
+        return nil
+    }
+
+    func storePreKey(_ preKeyId: Int32, preKeyRecord record: PreKeyRecord!) {}
+
+    func containsPreKey(_ preKeyId: Int32) -> Bool {
+        return false
+    }
+
+    func removePreKey(_ preKeyId: Int32) {}
+
+    func loadSignedPrekey(_ signedPreKeyId: Int32) -> SignedPreKeyRecord {
+        fatalError("Not used to send.")
+    }
+
+    func loadSignedPrekeyOrNil(_ signedPreKeyId: Int32) -> SignedPreKeyRecord? {
+        return nil
+    }
+
+    func loadSignedPreKeys() -> [SignedPreKeyRecord] {
+        return []
+    }
+
+    func storeSignedPreKey(_ signedPreKeyId: Int32, signedPreKeyRecord: SignedPreKeyRecord) {}
+
+    func containsSignedPreKey(_ signedPreKeyId: Int32) -> Bool {
+        return false
+    }
+
+    func removeSignedPreKey(_ signedPrekeyId: Int32) {}
+}
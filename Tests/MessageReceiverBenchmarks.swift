@@ -0,0 +1,137 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+// Decrypts an envelope to its content right away, so that replaying a backlog only measures the receiver's commits.
+private class ReplayDecrypter: NSObject, OWSMessageReceiverDecrypter {
+
+    private let lock = NSLock()
+    private var _flushCount = 0
+
+    var flushCount: Int {
+        lock.lock()
+        defer { lock.unlock() }
+
+        return _flushCount
+    }
+
+    func decryptEnvelope(_ envelope: OWSSignalServiceProtosEnvelope, successBlock: @escaping (Data?) -> Void, failureBlock: @escaping () -> Void) {
+        DispatchQueue.global().async {
+            successBlock(envelope.content)
+        }
+    }
+
+    func flushDirtySessions() {
+        lock.lock()
+        _flushCount += 1
+        lock.unlock()
+    }
+}
+
+// Persists the plaintexts the way the batch processor does, and tells us once all of them have been committed.
+private class ReplayProcessor: NSObject, OWSMessageReceiverProcessor {
+
+    private let lock = NSLock()
+    private var enqueuedCount = 0
+    private var isReplayed = false
+    private let expectedCount: Int
+    private let replayed: XCTestExpectation
+
+    init(expectedCount: Int, replayed: XCTestExpectation) {
+        self.expectedCount = expectedCount
+        self.replayed = replayed
+    }
+
+    func enqueueEnvelopeData(_ envelopeData: Data, plaintextData: Data?, transaction: YapDatabaseReadWriteTransaction) {
+        transaction.setObject(plaintextData ?? envelopeData, forKey: UUID().uuidString, inCollection: "ReplayedEnvelopes")
+
+        lock.lock()
+        enqueuedCount += 1
+        lock.unlock()
+    }
+
+    // Only called once the transaction holding the enqueued envelopes has been committed.
+    func handleAnyUnprocessedEnvelopesAsync() {
+        lock.lock()
+        let shouldFulfill = !isReplayed && enqueuedCount == expectedCount
+        if shouldFulfill {
+            isReplayed = true
+        }
+        lock.unlock()
+
+        if shouldFulfill {
+            replayed.fulfill()
+        }
+    }
+}
+
+// Replays a backlog of 10k envelopes, as when the app is opened after a long time offline, through a receiver with
+// a decrypter that does no work. Each round of the receiver is committed in one transaction, and holds one envelope
+// per sender, so a backlog from a single sender is committed one envelope at a time, as every backlog used to be.
+class MessageReceiverBenchmarks: TemporaryDatabaseTestCase {
+
+    private let envelopeCount = 10000
+
+    private func envelope(source: String, timestamp: UInt64) -> OWSSignalServiceProtosEnvelope {
+        return OWSSignalServiceProtosEnvelopeBuilder()
+            .setType(.ciphertext)
+            .setSource(source)
+            .setSourceDevice(1)
+            .setTimestamp(timestamp)
+            .setContent(Data(count: 256))
+            .build()
+    }
+
+    private func measureReplay(senderCount: Int) {
+        let senders = (0..<senderCount).map { String(format: "0x%040lx", $0) }
+
+        measureMetrics([.wallClockTime], automaticallyStartMeasuring: false) {
+            let database = YapDatabase(path: makeDatabasePath())
+            let replayed = expectation(description: "replayed")
+            let decrypter = ReplayDecrypter()
+            let receiver = OWSMessageReceiver(dbConnection: database.newConnection(), messageDecrypter: decrypter, batchMessageProcessor: ReplayProcessor(expectedCount: envelopeCount, replayed: replayed))
+
+            // The receiver doesn't drain the backlog until its extension is registered.
+            for index in 0..<envelopeCount {
+                receiver.handleReceivedEnvelope(envelope(source: senders[index % senderCount], timestamp: UInt64(index)))
+            }
+            OWSMessageReceiver.syncRegisterDatabaseExtension(database)
+
+            startMeasuring()
+            receiver.handleAnyUnprocessedEnvelopesAsync()
+            wait(for: [replayed], timeout: 600)
+            stopMeasuring()
+
+            XCTAssertLessThanOrEqual(decrypter.flushCount, envelopeCount)
+            if senderCount > 1 {
+                XCTAssertLessThan(decrypter.flushCount, envelopeCount)
+            }
+        }
+    }
+
+    func testReplayBacklogFromOneSender() {
+        measureReplay(senderCount: 1)
+    }
+
+    func testReplayBacklogFromTenSenders() {
+        measureReplay(senderCount: 10)
+    }
+
+    func testReplayBacklogFromHundredSenders() {
+        measureReplay(senderCount: 100)
+    }
+}
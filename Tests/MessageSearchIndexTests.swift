@@ -0,0 +1,202 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class MessageSearchIndexTests: TemporaryDatabaseTestCase {
+
+    private let address = "0xa2a0134f1df987bc388dbcb635dfeed4ce497e2a"
+
+    private var thread: TSContactThread!
+
+    override func setUp() {
+        super.setUp()
+
+        thread = TSContactThread(uniqueId: "c\(address)")!
+        database.newConnection().readWrite { transaction in
+            transaction.setObject(self.thread, forKey: self.thread.uniqueId!, inCollection: TSThread.collection())
+        }
+    }
+
+    private func writeMessages(_ bodies: [String], keyPrefix: String = "message", to database: YapDatabase? = nil) {
+        (database ?? self.database).newConnection().readWrite { transaction in
+            for (index, body) in bodies.enumerated() {
+                let message = TSOutgoingMessage(timestamp: UInt64(1514764800000 + index), in: self.thread, messageBody: body)
+                transaction.setObject(message, forKey: "\(keyPrefix)-\(index)", inCollection: TSInteraction.collection())
+            }
+        }
+    }
+
+    private func search(_ index: OWSMessageSearchIndex, _ text: String, offset: UInt = 0, limit: UInt = 0) -> [OWSMessageSearchResult] {
+        var results = [OWSMessageSearchResult]()
+        database.newConnection().read { transaction in
+            results = index.results(forSearchText: text, offset: offset, limit: limit, snippetOptions: nil, transaction: transaction)
+        }
+
+        return results
+    }
+
+    private func waitUntilIndexed(_ database: YapDatabase? = nil) {
+        let indexed = expectation(forNotification: NSNotification.Name.YapDatabaseExtensionPopulated, object: database ?? self.database) { notification in
+            return notification.userInfo?[YapDatabaseExtensionNameKey] as? String == OWSMessageSearchIndexExtensionName
+        }
+
+        wait(for: [indexed], timeout: 120)
+    }
+
+    func testIndexesExistingMessagesOnRegistration() {
+        writeMessages(["Lunch at the Café?", "SOFA::Message:{\"body\":\"see you at the park\"}", "SOFA::Status:{\"type\":\"park\"}"])
+
+        let index = OWSMessageSearchIndex(database: database)
+        index.blockingRegisterExtension()
+
+        database.newConnection().read { transaction in
+            XCTAssertTrue(index.hasIndexedExistingMessages(with: transaction))
+        }
+
+        XCTAssertEqual(search(index, "cafe").map { $0.uniqueId }, ["message-0"])
+        XCTAssertEqual(search(index, "park").map { $0.uniqueId }, ["message-1"])
+        XCTAssertTrue(search(index, "SOFA").isEmpty)
+    }
+
+    // The app registers the index async, and the existing messages are indexed in batches afterwards,
+    // while new messages keep being written.
+    func testIndexesExistingMessagesInBatches() {
+        writeMessages(messageBodies(count: 3000))
+
+        let index = OWSMessageSearchIndex(database: database)
+        index.asyncRegisterExtension()
+
+        writeMessages(["coffee later?"], keyPrefix: "new")
+        waitUntilIndexed()
+
+        database.newConnection().read { transaction in
+            XCTAssertTrue(index.hasIndexedExistingMessages(with: transaction))
+        }
+
+        XCTAssertEqual(search(index, "coffee later").map { $0.uniqueId }, ["new-0"])
+        XCTAssertEqual(search(index, "message").count, 3000)
+    }
+
+    func testIndexesMessagesWrittenAfterRegistration() {
+        let index = OWSMessageSearchIndex(database: database)
+        index.blockingRegisterExtension()
+
+        writeMessages(["Pizza tonight 👍🏽", "no thanks"])
+
+        XCTAssertEqual(search(index, "piz").map { $0.uniqueId }, ["message-0"])
+        XCTAssertEqual(search(index, "👍").map { $0.uniqueId }, ["message-0"])
+
+        database.newConnection().readWrite { transaction in
+            let message = transaction.object(forKey: "message-0", inCollection: TSInteraction.collection()) as! TSMessage
+            message.body = "Sushi tonight"
+            transaction.setObject(message, forKey: "message-0", inCollection: TSInteraction.collection())
+        }
+
+        XCTAssertTrue(search(index, "pizza").isEmpty)
+        XCTAssertEqual(search(index, "sushi").map { $0.uniqueId }, ["message-0"])
+    }
+
+    func testFindsThreadsAndPaymentsByAddress() {
+        writeMessages(["SOFA::Payment:{\"toAddress\":\"\(address)\",\"value\":\"0x10\"}"])
+
+        let index = OWSMessageSearchIndex(database: database)
+        index.blockingRegisterExtension()
+
+        for text in [address, "A2A0134F1DF987BC"] {
+            let results = search(index, text)
+            XCTAssertEqual(Set(results.map { $0.collection }), [TSThread.collection(), TSInteraction.collection()])
+        }
+    }
+
+    func testPagesDoNotOverlap() {
+        writeMessages((0..<25).map { "meeting number \($0)" })
+
+        let index = OWSMessageSearchIndex(database: database)
+        index.blockingRegisterExtension()
+
+        let options = YapDatabaseFullTextSearchSnippetOptions()
+        options.startMatchText = "["
+        options.endMatchText = "]"
+
+        var rowids = [Int64]()
+        var pageSizes = [Int]()
+        database.newConnection().read { transaction in
+            for offset in stride(from: 0, to: 30, by: 10) {
+                let page = index.results(forSearchText: "meeting", offset: UInt(offset), limit: 10, snippetOptions: options, transaction: transaction)
+                pageSizes.append(page.count)
+                rowids.append(contentsOf: page.map { $0.rowid })
+                XCTAssertTrue(page.filter { !$0.snippet.contains("[meeting]") }.isEmpty)
+            }
+        }
+
+        XCTAssertEqual(pageSizes, [10, 10, 5])
+        XCTAssertEqual(Set(rowids).count, 25)
+    }
+
+    func testQueryForSearchText() {
+        XCTAssertNil(OWSMessageSearchIndex.query(forSearchText: "  \n "))
+        XCTAssertEqual(OWSMessageSearchIndex.query(forSearchText: "see you"), "\"see\" \"you\"*")
+        XCTAssertEqual(OWSMessageSearchIndex.query(forSearchText: "say \"hi\" OR"), "\"say\" \"\"\"hi\"\"\" \"OR\"*")
+    }
+
+    private let words = ["lunch", "meeting", "payment", "tomorrow", "café", "party", "invoice", "coffee", "train", "weekend"]
+
+    private func messageBodies(count: Int) -> [String] {
+        return (0..<count).map { "\(words[$0 % words.count]) \(words[($0 / 7) % words.count]) message \($0)" }
+    }
+
+    // 500k messages, searched a page at a time as the user types.
+    func testSearchPerformance() {
+        let index = OWSMessageSearchIndex(database: database)
+        index.blockingRegisterExtension()
+
+        for batch in 0..<50 {
+            writeMessages(messageBodies(count: 10000), keyPrefix: "message-\(batch)")
+        }
+
+        let connection = database.newConnection()
+        measure {
+            connection.read { transaction in
+                for prefix in ["c", "co", "cof", "coff", "coffee", "coffee tr"] {
+                    let page = index.results(forSearchText: prefix, offset: 0, limit: 50, snippetOptions: nil, transaction: transaction)
+                    XCTAssertEqual(page.count, 50)
+                }
+            }
+        }
+    }
+
+    // Indexing 50k existing messages in batches, as on the first launch after updating. Each run gets a database
+    // of its own, written before the clock starts, so that there's something left to index.
+    func testBackfillPerformance() {
+        let bodies = messageBodies(count: 50000)
+
+        measureMetrics([.wallClockTime], automaticallyStartMeasuring: false) {
+            let database = YapDatabase(path: self.makeDatabasePath())
+            self.writeMessages(bodies, to: database)
+
+            let index = OWSMessageSearchIndex(database: database)
+            self.startMeasuring()
+            index.asyncRegisterExtension()
+            self.waitUntilIndexed(database)
+            self.stopMeasuring()
+
+            database.newConnection().read { transaction in
+                XCTAssertTrue(index.hasIndexedExistingMessages(with: transaction))
+            }
+        }
+    }
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class RatchetKeyDerivationTests: XCTestCase {
+
+    private func data(hex: String) -> Data {
+        var data = Data()
+        var index = hex.startIndex
+        while index < hex.endIndex {
+            let next = hex.index(index, offsetBy: 2)
+            data.append(UInt8(hex[index..<next], radix: 16)!)
+            index = next
+        }
+
+        return data
+    }
+
+    private func bytes<T>(of value: T, count: Int) -> Data {
+        var value = value
+        return withUnsafeBytes(of: &value) { Data($0.prefix(count)) }
+    }
+
+    private func randomChainKey() -> ChainKey {
+        return ChainKey(data: Randomness.generateRandomBytes(32), index: 0)
+    }
+
+    // MARK: - HKDF
+
+    func testHKDFMatchesRFC5869() {
+        let seed = data(hex: String(repeating: "0b", count: 22))
+
+        // Test case 1.
+        XCTAssertEqual(HKDFKit.deriveKey(seed,
+                                         info: data(hex: "f0f1f2f3f4f5f6f7f8f9"),
+                                         salt: data(hex: "000102030405060708090a0b0c"),
+                                         outputSize: 42),
+                       data(hex: "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865"))
+
+        // Test case 3, with neither salt nor info.
+        XCTAssertEqual(HKDFKit.deriveKey(seed, info: Data(), salt: Data(), outputSize: 42),
+                       data(hex: "8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d9d201395faa4b61a96c8"))
+    }
+
+    func testHKDFRejectsOversizedOutput() {
+        var output = [UInt8](repeating: 0, count: 256 * 32)
+        XCTAssertFalse(HKDFKitDeriveKey([1], 1, nil, 0, nil, 0, &output, output.count))
+        XCTAssertTrue(HKDFKitDeriveKey([1], 1, nil, 0, nil, 0, &output, 255 * 32))
+    }
+
+    // MARK: - Chain keys
+
+    func testChainKeyMaterialMatchesDerivedSecrets() {
+        var chainKey = randomChainKey()
+        var material = ChainKeyMaterial()
+        chainKey.getMaterial(&material)
+
+        for index in 0..<10 {
+            // The derivations as they were written before the chain moved onto the stack.
+            let secrets = TSDerivedSecrets.derivedMessageKeys(with: chainKey.baseMaterial(Data([1])))!
+            let nextKey = chainKey.baseMaterial(Data([2]))
+
+            var messageKeys = MessageKeysMaterial()
+            ChainKeyMaterialMessageKeys(&material, &messageKeys)
+
+            XCTAssertEqual(messageKeys.index, Int32(index))
+            XCTAssertEqual(bytes(of: messageKeys.cipherKey, count: 32), secrets.cipherKey)
+            XCTAssertEqual(bytes(of: messageKeys.macKey, count: 32), secrets.macKey)
+            XCTAssertEqual(bytes(of: messageKeys.iv, count: 16), secrets.iv)
+
+            let wrapped = chainKey.messageKeys()!
+            XCTAssertEqual(wrapped.cipherKey, secrets.cipherKey)
+            XCTAssertEqual(wrapped.macKey, secrets.macKey)
+            XCTAssertEqual(wrapped.iv, secrets.iv)
+            XCTAssertEqual(wrapped.index, Int32(index))
+
+            var next = ChainKeyMaterial()
+            ChainKeyMaterialNext(&material, &next)
+            material = next
+            chainKey = chainKey.nextChainKey()
+
+            XCTAssertEqual(bytes(of: material.key, count: 32), nextKey)
+            XCTAssertEqual(chainKey.key, nextKey)
+            XCTAssertEqual(chainKey.index, Int32(index + 1))
+        }
+    }
+
+    func testMessageKeysSurviveArchiving() {
+        let messageKeys = randomChainKey().nextChainKey().messageKeys()!
+
+        let unarchived = NSKeyedUnarchiver.unarchiveObject(with: NSKeyedArchiver.archivedData(withRootObject: messageKeys)) as? MessageKeys
+
+        XCTAssertEqual(unarchived?.cipherKey, messageKeys.cipherKey)
+        XCTAssertEqual(unarchived?.macKey, messageKeys.macKey)
+        XCTAssertEqual(unarchived?.iv, messageKeys.iv)
+        XCTAssertEqual(unarchived?.index, 1)
+    }
+
+    // MARK: - Catching up skipped messages
+
+    // The most messages SessionCipher will skip ahead to decrypt a message.
+    private let skippedMessageCount = 2000
+
+    // What SessionCipher did for every skipped message: step the chain with objects.
+    func testCatchingUpWithChainKeyObjects() {
+        let start = randomChainKey()
+
+        measure {
+            var chainKey = start
+            var skippedMessageKeys = [MessageKeys]()
+            while Int(chainKey.index) < self.skippedMessageCount {
+                skippedMessageKeys.append(chainKey.messageKeys())
+                chainKey = chainKey.nextChainKey()
+            }
+
+            XCTAssertEqual(skippedMessageKeys.count, self.skippedMessageCount)
+        }
+    }
+
+    // What SessionCipher does now: step the chain on the stack, and only keep the skipped keys as objects.
+    func testCatchingUpWithChainKeyMaterial() {
+        let start = randomChainKey()
+
+        measure {
+            var chainKey = ChainKeyMaterial()
+            var next = ChainKeyMaterial()
+            var messageKeys = MessageKeysMaterial()
+            start.getMaterial(&chainKey)
+
+            var skippedMessageKeys = [MessageKeys]()
+            while Int(chainKey.index) < self.skippedMessageCount {
+                ChainKeyMaterialMessageKeys(&chainKey, &messageKeys)
+                skippedMessageKeys.append(MessageKeys(material: &messageKeys))
+                ChainKeyMaterialNext(&chainKey, &next)
+                chainKey = next
+            }
+
+            XCTAssertEqual(skippedMessageKeys.count, self.skippedMessageCount)
+        }
+    }
+}
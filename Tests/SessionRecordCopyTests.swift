@@ -0,0 +1,123 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+// The session cache hands out copies of its records, so that a failed encryption or decryption,
+// which mutates its record part way, can't corrupt the cached session.
+class SessionRecordCopyTests: XCTestCase {
+
+    private let recipientId = "recipient"
+    private let deviceId: Int32 = 1
+
+    private var store: InMemoryAxolotlStore!
+    private var record: SessionRecord!
+
+    override func setUp() {
+        super.setUp()
+
+        SessionCipher.setSessionCipherDispatchQueueBlock { recipientId in
+            OWSDispatch.sessionStoreQueue(forRecipientId: recipientId)
+        }
+
+        store = InMemoryAxolotlStore()
+
+        let identityKeyPair = Curve25519.generateKeyPair()!
+        let signedPreKeyPair = Curve25519.generateKeyPair()!
+        let signedPreKeyPublic = (signedPreKeyPair.publicKey()! as NSData).prependKeyType()! as Data
+        let bundle = PreKeyBundle(registrationId: 1,
+                                  deviceId: deviceId,
+                                  preKeyId: 1,
+                                  preKeyPublic: (Curve25519.generateKeyPair()!.publicKey()! as NSData).prependKeyType()! as Data,
+                                  signedPreKeyPublic: signedPreKeyPublic,
+                                  signedPreKeyId: 1,
+                                  signedPreKeySignature: Ed25519.sign(signedPreKeyPublic, with: identityKeyPair) as Data,
+                                  identityKey: (identityKeyPair.publicKey()! as NSData).prependKeyType()! as Data)
+
+        OWSDispatch.sessionStoreQueue(forRecipientId: recipientId).sync {
+            SessionBuilder(axolotlStore: store, recipientId: recipientId, deviceId: deviceId)?.processPrekeyBundle(bundle)
+
+            // Advance the chain, and give the record a previous state, so there's something in every part to copy.
+            let cipher = SessionCipher(axolotlStore: store, recipientId: recipientId, deviceId: deviceId)
+            XCTAssertNotNil(cipher?.encryptMessage(Data(count: 160)))
+        }
+
+        record = store.loadSession(recipientId, deviceId: deviceId)
+        record.archiveCurrentState()
+        record.promoteState(record.previousSessionStates().firstObject as! SessionState)
+    }
+
+    override func tearDown() {
+        store = nil
+        record = nil
+
+        super.tearDown()
+    }
+
+    func testCopyMatchesOriginal() {
+        let copy = record.copy() as! SessionRecord
+
+        XCTAssertFalse(copy === record)
+        XCTAssertFalse(copy.sessionState() === record.sessionState())
+        XCTAssertEqual(copy.isFresh(), record.isFresh())
+        XCTAssertEqual(copy.previousSessionStates().count, record.previousSessionStates().count)
+
+        XCTAssertEqual(copy.sessionState().senderChainKey().index, record.sessionState().senderChainKey().index)
+        XCTAssertEqual(copy.sessionState().senderChainKey().key, record.sessionState().senderChainKey().key)
+        XCTAssertEqual(copy.sessionState().rootKey.keyData, record.sessionState().rootKey.keyData)
+        XCTAssertEqual(copy.sessionState().remoteIdentityKey, record.sessionState().remoteIdentityKey)
+        XCTAssertEqual(copy.sessionState().hasUnacknowledgedPreKeyMessage(), record.sessionState().hasUnacknowledgedPreKeyMessage())
+    }
+
+    func testMutatingCopyLeavesOriginalUntouched() {
+        let index = record.sessionState().senderChainKey().index
+        let previousStateCount = record.previousSessionStates().count
+
+        let copy = record.copy() as! SessionRecord
+        copy.sessionState().setSenderChainKey(copy.sessionState().senderChainKey().nextChainKey())
+        copy.sessionState().clearUnacknowledgedPreKeyMessage()
+        copy.archiveCurrentState()
+        copy.markAsUnFresh()
+
+        XCTAssertEqual(record.sessionState().senderChainKey().index, index)
+        XCTAssertTrue(record.sessionState().hasUnacknowledgedPreKeyMessage())
+        XCTAssertEqual(record.previousSessionStates().count, previousStateCount)
+    }
+
+    // MARK: - Loading a session
+
+    private let loadCount = 1000
+
+    // What every load used to cost: deserializing the record from the keys database.
+    func testLoadingByUnarchiving() {
+        let data = NSKeyedArchiver.archivedData(withRootObject: record)
+
+        measure {
+            for _ in 0..<self.loadCount {
+                XCTAssertNotNil(NSKeyedUnarchiver.unarchiveObject(with: data) as? SessionRecord)
+            }
+        }
+    }
+
+    // What a load costs once the session is cached.
+    func testLoadingByCopying() {
+        measure {
+            for _ in 0..<self.loadCount {
+                XCTAssertNotNil(self.record.copy() as? SessionRecord)
+            }
+        }
+    }
+}
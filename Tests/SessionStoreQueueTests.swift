@@ -0,0 +1,152 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class SessionStoreQueueTests: XCTestCase {
+
+    // A group send to 100 members with 3 devices each.
+    private let recipientIds = (0..<100).map { "recipient-\($0)" }
+    private let deviceIds: [Int32] = [1, 2, 3]
+    private let plainText = Data(count: 160)
+
+    private var store: InMemoryAxolotlStore!
+
+    override func setUp() {
+        super.setUp()
+
+        useSessionStoreQueues()
+
+        store = InMemoryAxolotlStore()
+        for recipientId in recipientIds {
+            let identityKeyPair = Curve25519.generateKeyPair()!
+
+            OWSDispatch.sessionStoreQueue(forRecipientId: recipientId).sync {
+                for deviceId in deviceIds {
+                    let builder = SessionBuilder(axolotlStore: store, recipientId: recipientId, deviceId: deviceId)
+                    builder?.processPrekeyBundle(preKeyBundle(deviceId: deviceId, identityKeyPair: identityKeyPair))
+                }
+            }
+        }
+    }
+
+    override func tearDown() {
+        // Leave the queues as the app sets them up.
+        useSessionStoreQueues()
+        store = nil
+
+        super.tearDown()
+    }
+
+    private func useSessionStoreQueues() {
+        SessionCipher.setSessionCipherDispatchQueueBlock { recipientId in
+            OWSDispatch.sessionStoreQueue(forRecipientId: recipientId)
+        }
+    }
+
+    private func preKeyBundle(deviceId: Int32, identityKeyPair: ECKeyPair) -> PreKeyBundle {
+        let preKeyPair = Curve25519.generateKeyPair()!
+        let signedPreKeyPair = Curve25519.generateKeyPair()!
+
+        let signedPreKeyPublic = (signedPreKeyPair.publicKey()! as NSData).prependKeyType()! as Data
+        let signature = Ed25519.sign(signedPreKeyPublic, with: identityKeyPair) as Data
+
+        return PreKeyBundle(registrationId: 1,
+                            deviceId: deviceId,
+                            preKeyId: 1,
+                            preKeyPublic: (preKeyPair.publicKey()! as NSData).prependKeyType()! as Data,
+                            signedPreKeyPublic: signedPreKeyPublic,
+                            signedPreKeyId: 1,
+                            signedPreKeySignature: signature,
+                            identityKey: (identityKeyPair.publicKey()! as NSData).prependKeyType()! as Data)
+    }
+
+    // Must be called on the recipient's session cipher queue.
+    private func encrypt(forRecipientId recipientId: String) {
+        for deviceId in deviceIds {
+            let cipher = SessionCipher(axolotlStore: store, recipientId: recipientId, deviceId: deviceId)
+            XCTAssertNotNil(cipher?.encryptMessage(plainText))
+        }
+    }
+
+    private func senderChainIndex(recipientId: String, deviceId: Int32) -> Int32 {
+        return store.loadSession(recipientId, deviceId: deviceId).sessionState().senderChainKey().index
+    }
+
+    func testRecipientAlwaysGetsTheSameQueue() {
+        let queues = recipientIds.map { OWSDispatch.sessionStoreQueue(forRecipientId: $0) }
+
+        for (recipientId, queue) in zip(recipientIds, queues) {
+            XCTAssertTrue(OWSDispatch.sessionStoreQueue(forRecipientId: recipientId) === queue)
+            XCTAssertTrue(SessionCipher.getSessionCipherDispatchQueue(forRecipientId: recipientId) === queue)
+        }
+
+        XCTAssertGreaterThan(Set(queues.map { ObjectIdentifier($0) }).count, 1)
+    }
+
+    func testParallelEncryptionKeepsEachSessionInOrder() {
+        let messageCount: Int32 = 5
+        let group = DispatchGroup()
+
+        // Interleave the messages, so that every queue has several recipients' messages in flight at once.
+        for _ in 0..<messageCount {
+            for recipientId in recipientIds {
+                OWSDispatch.sessionStoreQueue(forRecipientId: recipientId).async(group: group) {
+                    self.encrypt(forRecipientId: recipientId)
+                }
+            }
+        }
+
+        group.wait()
+
+        for recipientId in recipientIds {
+            for deviceId in deviceIds {
+                XCTAssertEqual(senderChainIndex(recipientId: recipientId, deviceId: deviceId), messageCount)
+            }
+        }
+    }
+
+    // MARK: - Group send
+
+    func testGroupSendEncryptionOnOneQueue() {
+        let queue = DispatchQueue(label: "org.toshi.sessionStoreQueueTests.serial")
+        SessionCipher.setSessionCipherDispatchQueue(queue)
+
+        // What a group send used to do: every recipient's encryption on the one, global, session store queue.
+        measure {
+            for recipientId in self.recipientIds {
+                queue.sync {
+                    self.encrypt(forRecipientId: recipientId)
+                }
+            }
+        }
+    }
+
+    func testGroupSendEncryptionFannedOutToSessionStoreQueues() {
+        // What OWSMessageSender does for a group send: every recipient's encryption on its own queue, at once.
+        measure {
+            let group = DispatchGroup()
+
+            for recipientId in self.recipientIds {
+                OWSDispatch.sessionStoreQueue(forRecipientId: recipientId).async(group: group) {
+                    self.encrypt(forRecipientId: recipientId)
+                }
+            }
+
+            group.wait()
+        }
+    }
+}
@@ -0,0 +1,165 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class SessionStoreTests: TemporaryDatabaseTestCase {
+
+    private let contactIdentifier = "0xa2a0134f1df987bc388dbcb635dfeed4ce497e2a"
+
+    // The registration id tells sessions apart.
+    private func session(_ registrationId: Int32) -> SessionRecord {
+        let record = SessionRecord()
+        record.sessionState().remoteRegistrationId = registrationId
+
+        return record
+    }
+
+    private func registrationId(_ store: OWSSessionStore, _ contactIdentifier: String, _ deviceId: Int32) -> Int32? {
+        return store.session(forContact: contactIdentifier, deviceId: deviceId)?.sessionState().remoteRegistrationId
+    }
+
+    private func deviceIds(_ store: OWSSessionStore, _ contactIdentifier: String) -> [Int32] {
+        return store.deviceIds(forContact: contactIdentifier).map { $0.int32Value }
+    }
+
+    private func storedSessionCount() -> UInt {
+        var count: UInt = 0
+        database.newConnection().read { transaction in
+            count = transaction.numberOfKeys(inCollection: TSStorageManagerDeviceSessionStoreCollection)
+        }
+
+        return count
+    }
+
+    func testLegacySessionsAreMigrated() {
+        database.newConnection().readWrite { transaction in
+            let sessions: NSDictionary = [NSNumber(value: 1): self.session(11), NSNumber(value: 2): self.session(12)]
+            transaction.setObject(sessions, forKey: self.contactIdentifier, inCollection: TSStorageManagerSessionStoreCollection)
+            transaction.setObject([NSNumber(value: 1): self.session(21)] as NSDictionary, forKey: "other", inCollection: TSStorageManagerSessionStoreCollection)
+        }
+
+        let store = OWSSessionStore(database: database)
+
+        XCTAssertEqual(registrationId(store, contactIdentifier, 1), 11)
+        XCTAssertEqual(registrationId(store, contactIdentifier, 2), 12)
+        XCTAssertNil(registrationId(store, contactIdentifier, 3))
+        XCTAssertEqual(deviceIds(store, contactIdentifier), [1, 2])
+        XCTAssertEqual(deviceIds(store, "other"), [1])
+
+        database.newConnection().read { transaction in
+            XCTAssertEqual(transaction.numberOfKeys(inCollection: TSStorageManagerSessionStoreCollection), 0)
+        }
+
+        // What's migrated round-trips through a store of its own.
+        store.setSession(session(13), forContact: contactIdentifier, deviceId: 3)
+        store.removeSession(forContact: contactIdentifier, deviceId: 1)
+        store.flush()
+
+        let reopened = OWSSessionStore(database: database)
+        XCTAssertNil(registrationId(reopened, contactIdentifier, 1))
+        XCTAssertEqual(registrationId(reopened, contactIdentifier, 2), 12)
+        XCTAssertEqual(registrationId(reopened, contactIdentifier, 3), 13)
+        XCTAssertEqual(deviceIds(reopened, contactIdentifier), [2, 3])
+        XCTAssertEqual(registrationId(reopened, "other", 1), 21)
+    }
+
+    func testDeviceListsAreBuiltForSessionsMigratedWithoutThem() {
+        database.newConnection().readWrite { transaction in
+            transaction.setObject(self.session(11), forKey: "\(self.contactIdentifier).1", inCollection: TSStorageManagerDeviceSessionStoreCollection)
+            transaction.setObject(self.session(14), forKey: "\(self.contactIdentifier).4", inCollection: TSStorageManagerDeviceSessionStoreCollection)
+        }
+
+        let store = OWSSessionStore(database: database)
+
+        XCTAssertEqual(deviceIds(store, contactIdentifier), [1, 4])
+    }
+
+    func testFlushPersistsDirtySessions() {
+        let store = OWSSessionStore(database: database)
+        store.setSession(session(11), forContact: contactIdentifier, deviceId: 1)
+        store.setSession(session(12), forContact: contactIdentifier, deviceId: 2)
+
+        XCTAssertEqual(store.dirtySessionCount(), 2)
+        XCTAssertEqual(storedSessionCount(), 0)
+
+        store.flush()
+
+        XCTAssertEqual(store.dirtySessionCount(), 0)
+        XCTAssertEqual(storedSessionCount(), 2)
+
+        // Storing a flushed session again makes it dirty again.
+        store.setSession(session(21), forContact: contactIdentifier, deviceId: 1)
+        XCTAssertEqual(store.dirtySessionCount(), 1)
+        store.flush()
+
+        let reopened = OWSSessionStore(database: database)
+        XCTAssertEqual(registrationId(reopened, contactIdentifier, 1), 21)
+        XCTAssertEqual(registrationId(reopened, contactIdentifier, 2), 12)
+        XCTAssertEqual(deviceIds(reopened, contactIdentifier), [1, 2])
+    }
+
+    func testCacheKeepsDirtySessionsUntilFlushed() {
+        // Well past the count limit of the clean sessions.
+        let contactIdentifiers = (0..<1000).map { "contact-\($0)" }
+
+        let store = OWSSessionStore(database: database)
+        for (index, contactIdentifier) in contactIdentifiers.enumerated() {
+            store.setSession(session(Int32(index)), forContact: contactIdentifier, deviceId: 1)
+        }
+
+        XCTAssertEqual(store.dirtySessionCount(), UInt(contactIdentifiers.count))
+        XCTAssertEqual(storedSessionCount(), 0)
+        for (index, contactIdentifier) in contactIdentifiers.enumerated() {
+            XCTAssertEqual(registrationId(store, contactIdentifier, 1), Int32(index))
+            XCTAssertEqual(deviceIds(store, contactIdentifier), [1])
+        }
+
+        store.flush()
+
+        XCTAssertEqual(storedSessionCount(), UInt(contactIdentifiers.count))
+        for (index, contactIdentifier) in contactIdentifiers.enumerated() {
+            XCTAssertEqual(registrationId(store, contactIdentifier, 1), Int32(index))
+        }
+    }
+
+    func testLoadedSessionsAreCopies() {
+        let store = OWSSessionStore(database: database)
+        store.setSession(session(11), forContact: contactIdentifier, deviceId: 1)
+
+        // A failed decryption mutates its copy, and never stores it.
+        store.session(forContact: contactIdentifier, deviceId: 1)?.sessionState().remoteRegistrationId = 99
+
+        XCTAssertEqual(registrationId(store, contactIdentifier, 1), 11)
+    }
+
+    func testRemovingAllSessionsOfAContact() {
+        let store = OWSSessionStore(database: database)
+        store.setSession(session(11), forContact: contactIdentifier, deviceId: 1)
+        store.setSession(session(12), forContact: contactIdentifier, deviceId: 2)
+        store.setSession(session(21), forContact: "other", deviceId: 1)
+        store.flush()
+        store.setSession(session(13), forContact: contactIdentifier, deviceId: 3)
+
+        store.removeAllSessions(forContact: contactIdentifier)
+
+        XCTAssertEqual(deviceIds(store, contactIdentifier), [])
+        XCTAssertNil(registrationId(store, contactIdentifier, 3))
+        XCTAssertEqual(store.dirtySessionCount(), 0)
+        XCTAssertEqual(storedSessionCount(), 1)
+        XCTAssertEqual(deviceIds(store, "other"), [1])
+    }
+}
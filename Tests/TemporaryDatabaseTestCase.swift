@@ -0,0 +1,55 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+import XCTest
+
+// A test case with a scratch database, opened before each test and removed with its WAL files after it.
+class TemporaryDatabaseTestCase: XCTestCase {
+
+    private var databasePaths = [String]()
+
+    private(set) var database: YapDatabase!
+
+    // Subclasses override this to open the database with other options.
+    var databaseOptions: YapDatabaseOptions? {
+        return nil
+    }
+
+    override func setUp() {
+        super.setUp()
+
+        database = YapDatabase(path: makeDatabasePath(), options: databaseOptions)
+    }
+
+    override func tearDown() {
+        database = nil
+        for path in databasePaths {
+            for suffix in ["", "-wal", "-shm"] {
+                try? FileManager.default.removeItem(atPath: path + suffix)
+            }
+        }
+        databasePaths.removeAll()
+
+        super.tearDown()
+    }
+
+    // For tests that open more databases of their own; these are removed in tearDown as well.
+    func makeDatabasePath() -> String {
+        let path = (NSTemporaryDirectory() as NSString).appendingPathComponent("\(UUID().uuidString).sqlite")
+        databasePaths.append(path)
+
+        return path
+    }
+}
@@ -0,0 +1,143 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class ThreadSummaryTests: TemporaryDatabaseTestCase {
+
+    private let address = "0xa2a0134f1df987bc388dbcb635dfeed4ce497e2a"
+
+    private var connection: YapDatabaseConnection!
+    private var thread: TSContactThread!
+
+    override func setUp() {
+        super.setUp()
+
+        // Stand-ins for the message and unread views the summary hooks read from, registered before them as in the app.
+        let messageGrouping = YapDatabaseViewGrouping.withObjectBlock { (_, _, _, object) -> String? in
+            return (object as? TSInteraction)?.uniqueThreadId
+        }
+        let unreadGrouping = YapDatabaseViewGrouping.withObjectBlock { (_, _, _, object) -> String? in
+            guard let message = object as? TSIncomingMessage, !message.wasRead else { return nil }
+            return message.uniqueThreadId
+        }
+        let sorting = YapDatabaseViewSorting.withObjectBlock { (_, _, _, _, object1, _, _, object2) -> ComparisonResult in
+            guard let interaction1 = object1 as? TSInteraction, let interaction2 = object2 as? TSInteraction else { return .orderedSame }
+            return interaction1.dateForSorting().compare(interaction2.dateForSorting())
+        }
+
+        XCTAssertTrue(database.register(YapDatabaseAutoView(grouping: messageGrouping, sorting: sorting), withName: TSMessageDatabaseViewExtensionName))
+        XCTAssertTrue(database.register(YapDatabaseAutoView(grouping: unreadGrouping, sorting: sorting), withName: TSUnreadDatabaseViewExtensionName))
+        OWSThreadSummary.syncRegisterDatabaseExtension(database)
+
+        connection = database.newConnection()
+        thread = TSContactThread(uniqueId: "c\(address)")!
+        connection.readWrite { transaction in
+            self.thread.save(with: transaction)
+        }
+    }
+
+    override func tearDown() {
+        connection = nil
+
+        super.tearDown()
+    }
+
+    private func timestamp(secondsFromNow seconds: TimeInterval) -> UInt64 {
+        return UInt64(Date(timeIntervalSinceNow: seconds).timeIntervalSince1970 * 1000)
+    }
+
+    private func incomingMessage(uniqueId: String, secondsFromNow seconds: TimeInterval) -> TSIncomingMessage {
+        let message = TSIncomingMessage(timestamp: timestamp(secondsFromNow: seconds), in: thread, authorId: address, sourceDeviceId: 1, messageBody: "SOFA::Message:{\"body\":\"hi\"}")
+        message.uniqueId = uniqueId
+
+        return message
+    }
+
+    private func read<T>(_ block: @escaping (YapDatabaseReadTransaction) -> T) -> T {
+        var result: T!
+        connection.read { transaction in
+            result = block(transaction)
+        }
+
+        return result
+    }
+
+    private func summary() -> OWSThreadSummary? {
+        return read { OWSThreadSummary.summary(threadId: self.thread.uniqueId!, transaction: $0) }
+    }
+
+    private func storedThread() -> TSThread? {
+        return read { TSThread.fetch(uniqueId: self.thread.uniqueId!, transaction: $0) }
+    }
+
+    func testSortDateIsTheThreadsEvenWhenAnInteractionIsLater() {
+        let threadDate = storedThread()!.lastMessageDate()
+
+        // Written without going through -[TSInteraction saveWithTransaction:], so the thread keeps its date.
+        let message = incomingMessage(uniqueId: "message-1", secondsFromNow: 3600)
+        connection.readWrite { transaction in
+            transaction.setObject(message, forKey: message.uniqueId!, inCollection: TSInteraction.collection())
+        }
+
+        XCTAssertEqual(storedThread()?.lastMessageDate(), threadDate)
+        XCTAssertEqual(summary()?.lastMessageDate, threadDate)
+        XCTAssertEqual(summary()?.lastInboxInteractionId, "message-1")
+    }
+
+    func testSortDateFollowsTheThread() {
+        let message = incomingMessage(uniqueId: "message-1", secondsFromNow: 60)
+        connection.readWrite { transaction in
+            message.save(with: transaction)
+        }
+
+        XCTAssertEqual(storedThread()?.lastMessageDate(), message.dateForSorting())
+        XCTAssertEqual(summary()?.lastMessageDate, message.dateForSorting())
+
+        // An older message doesn't move the thread back, nor become its inbox preview.
+        let olderMessage = incomingMessage(uniqueId: "message-0", secondsFromNow: 30)
+        connection.readWrite { transaction in
+            olderMessage.save(with: transaction)
+        }
+
+        XCTAssertEqual(summary()?.lastMessageDate, message.dateForSorting())
+        XCTAssertEqual(summary()?.lastInboxInteractionId, "message-1")
+    }
+
+    func testHasUnreadMessagesWhenTheLastInteractionIsUnread() {
+        connection.readWrite { transaction in
+            self.incomingMessage(uniqueId: "message-1", secondsFromNow: 60).save(with: transaction)
+        }
+
+        XCTAssertTrue(read { self.thread.hasUnreadMessages(with: $0) })
+        XCTAssertEqual(summary()?.unreadCount, 1)
+    }
+
+    func testHasUnreadMessagesOnlyConsidersTheLastInteraction() {
+        connection.readWrite { transaction in
+            self.incomingMessage(uniqueId: "message-1", secondsFromNow: 60).save(with: transaction)
+
+            let reply = TSOutgoingMessage(timestamp: self.timestamp(secondsFromNow: 120), in: self.thread, messageBody: "SOFA::Message:{\"body\":\"hello\"}")
+            reply.uniqueId = "message-2"
+            reply.save(with: transaction)
+        }
+
+        // The earlier message is still unread, but something has been added after it.
+        XCTAssertFalse(read { self.thread.hasUnreadMessages(with: $0) })
+        XCTAssertEqual(summary()?.unreadCount, 1)
+        XCTAssertEqual(summary()?.lastInboxInteractionId, "message-2")
+    }
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapClockCacheTests: TemporaryDatabaseTestCase {
+
+    private func dataCache(countLimit: UInt, costLimit: UInt) -> YapClockCache<NSString, NSData> {
+        let cache = YapClockCache<NSString, NSData>(countLimit: countLimit, costLimit: costLimit, keyCallbacks: kCFTypeDictionaryKeyCallBacks)
+        cache.costBlock = { _, object in
+            return UInt((object as? NSData)?.length ?? 1)
+        }
+
+        return cache
+    }
+
+    func testCountLimitEvictsUnreferencedItems() {
+        let cache = dataCache(countLimit: 3, costLimit: 0)
+
+        cache.setObject(Data(count: 1) as NSData, forKey: "a")
+        cache.setObject(Data(count: 1) as NSData, forKey: "b")
+        cache.setObject(Data(count: 1) as NSData, forKey: "c")
+
+        // Give "a" its second chance, so "b" is the one to go.
+        XCTAssertNotNil(cache.object(forKey: "a"))
+
+        cache.setObject(Data(count: 1) as NSData, forKey: "d")
+
+        XCTAssertEqual(cache.count(), 3)
+        XCTAssertTrue(cache.containsKey("a"))
+        XCTAssertFalse(cache.containsKey("b"))
+        XCTAssertTrue(cache.containsKey("d"))
+    }
+
+    func testCostLimitEvictsUntilWithinBudget() {
+        let cache = dataCache(countLimit: 0, costLimit: 100)
+
+        for index in 0..<10 {
+            cache.setObject(Data(count: 10) as NSData, forKey: "small-\(index)" as NSString)
+        }
+        XCTAssertEqual(cache.totalCost, 100)
+
+        cache.setObject(Data(count: 60) as NSData, forKey: "large")
+
+        XCTAssertTrue(cache.containsKey("large"))
+        XCTAssertLessThanOrEqual(cache.totalCost, 100)
+        XCTAssertEqual(cache.count(), 5)
+    }
+
+    func testOversizedItemIsKeptAlone() {
+        let cache = dataCache(countLimit: 0, costLimit: 100)
+
+        cache.setObject(Data(count: 10) as NSData, forKey: "small")
+        cache.setObject(Data(count: 500) as NSData, forKey: "huge")
+
+        XCTAssertEqual(cache.count(), 1)
+        XCTAssertTrue(cache.containsKey("huge"))
+    }
+
+    func testReplacingAndRemovingUpdatesTotalCost() {
+        let cache = dataCache(countLimit: 0, costLimit: 0)
+
+        cache.setObject(Data(count: 10) as NSData, forKey: "a")
+        cache.setObject(Data(count: 30) as NSData, forKey: "a")
+        cache.setObject(Data(count: 5) as NSData, forKey: "b")
+        XCTAssertEqual(cache.totalCost, 35)
+
+        cache.removeObject(forKey: "a")
+        XCTAssertEqual(cache.totalCost, 5)
+
+        cache.removeAllObjects()
+        XCTAssertEqual(cache.totalCost, 0)
+        XCTAssertEqual(cache.count(), 0)
+    }
+
+    func testConnectionWithClockCacheReadsBackObjects() {
+        database.defaultCacheType = .clock
+        database.defaultObjectCacheCostLimit = 64
+        database.defaultCacheCostBlock = { _, _, object in
+            return UInt(((object as? String) ?? "").utf16.count)
+        }
+
+        let connection = database.newConnection()
+        connection.readWrite { transaction in
+            for index in 0..<20 {
+                transaction.setObject(String(repeating: "x", count: 16), forKey: "key-\(index)", inCollection: "clock")
+            }
+        }
+
+        XCTAssertEqual(connection.cacheType, .clock)
+
+        connection.read { transaction in
+            for index in 0..<20 {
+                XCTAssertEqual(transaction.object(forKey: "key-\(index)", inCollection: "clock") as? String, String(repeating: "x", count: 16))
+            }
+        }
+    }
+}
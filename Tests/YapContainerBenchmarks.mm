@@ -0,0 +1,253 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#import <XCTest/XCTest.h>
+
+// Private YapDatabase headers, found through the Tests target's header search paths.
+#import "YapDatabaseViewPage.h"
+#import "YapRowidSet.h"
+
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+// Compares YapRowidSet and YapDatabaseViewPage with the std::unordered_set and std::vector containers they replaced,
+// which are reproduced here as they were, with 10k to 1M rowids.
+
+typedef NS_ENUM(NSUInteger, YapBenchmarkRowids) {
+    // 1...n, the way sqlite hands out rowids.
+    YapBenchmarkRowidsSequential,
+    // n distinct rowids in [0, 10n), in random order, like the rowids of an old collection.
+    YapBenchmarkRowidsRandom,
+};
+
+static std::vector<int64_t> YapBenchmarkMakeRowids(NSUInteger count, YapBenchmarkRowids kind)
+{
+    std::vector<int64_t> rowids;
+    rowids.reserve(count);
+
+    if (kind == YapBenchmarkRowidsSequential) {
+        for (NSUInteger i = 1; i <= count; i++) {
+            rowids.push_back((int64_t)i);
+        }
+        return rowids;
+    }
+
+    std::mt19937_64 generator(42);
+    std::uniform_int_distribution<int64_t> distribution(0, (int64_t)count * 10 - 1);
+    std::unordered_set<int64_t> seen;
+    while (rowids.size() < count) {
+        int64_t rowid = distribution(generator);
+        if (seen.insert(rowid).second) {
+            rowids.push_back(rowid);
+        }
+    }
+    return rowids;
+}
+
+#pragma mark - The replaced containers
+
+// YapDatabaseViewPage's serialization before the compact format: little-endian int64_t's.
+static NSData *YapBenchmarkLegacySerialize(const std::vector<int64_t> &vector)
+{
+    NSUInteger count = vector.size();
+    NSUInteger numBytes = count * sizeof(int64_t);
+
+    int64_t *buffer = (int64_t *)malloc(numBytes);
+    memcpy(buffer, vector.data(), numBytes);
+
+    if (CFByteOrderGetCurrent() == CFByteOrderBigEndian) {
+        for (NSUInteger i = 0; i < count; i++) {
+            buffer[i] = CFSwapInt64HostToLittle(buffer[i]);
+        }
+    }
+
+    return [NSData dataWithBytesNoCopy:buffer length:numBytes freeWhenDone:YES];
+}
+
+static void YapBenchmarkLegacyDeserialize(NSData *data, std::vector<int64_t> &vector)
+{
+    vector.clear();
+
+    NSUInteger count = [data length] / sizeof(int64_t);
+    const int64_t *bytes = (const int64_t *)[data bytes];
+
+    if (vector.capacity() < count) {
+        vector.reserve(count);
+    }
+
+    for (NSUInteger i = 0; i < count; i++) {
+        int64_t rowid = bytes[i];
+
+        if (CFByteOrderGetCurrent() == CFByteOrderBigEndian) {
+            vector.push_back(CFSwapInt64LittleToHost(rowid));
+        } else {
+            vector.push_back(rowid);
+        }
+    }
+}
+
+#pragma mark -
+
+@interface YapContainerBenchmarks : XCTestCase
+@end
+
+@implementation YapContainerBenchmarks
+
+#pragma mark Rowid sets
+
+// Adds every rowid, looks each one up along with a miss, then enumerates the set.
+- (void)measureRowidSetWithCount:(NSUInteger)count rowids:(YapBenchmarkRowids)kind
+{
+    std::vector<int64_t> rowids = YapBenchmarkMakeRowids(count, kind);
+
+    [self measureBlock:^{
+        YapRowidSet *set = YapRowidSetCreate(0);
+        for (int64_t rowid : rowids) {
+            YapRowidSetAdd(set, rowid);
+        }
+
+        NSUInteger found = 0;
+        for (int64_t rowid : rowids) {
+            found += YapRowidSetContains(set, rowid) ? 1 : 0;
+            found += YapRowidSetContains(set, -rowid - 1) ? 1 : 0;
+        }
+
+        __block NSUInteger enumerated = 0;
+        YapRowidSetEnumerate(set, ^(int64_t rowid, BOOL *stop) {
+            enumerated++;
+        });
+
+        XCTAssertEqual(YapRowidSetCount(set), count);
+        XCTAssertEqual(found, count);
+        XCTAssertEqual(enumerated, count);
+
+        YapRowidSetRelease(set);
+    }];
+}
+
+- (void)measureUnorderedSetWithCount:(NSUInteger)count rowids:(YapBenchmarkRowids)kind
+{
+    std::vector<int64_t> rowids = YapBenchmarkMakeRowids(count, kind);
+
+    [self measureBlock:^{
+        std::unordered_set<int64_t> *set = new std::unordered_set<int64_t>();
+        for (int64_t rowid : rowids) {
+            set->insert(rowid);
+        }
+
+        NSUInteger found = 0;
+        for (int64_t rowid : rowids) {
+            found += set->find(rowid) != set->end() ? 1 : 0;
+            found += set->find(-rowid - 1) != set->end() ? 1 : 0;
+        }
+
+        NSUInteger enumerated = 0;
+        for (std::unordered_set<int64_t>::iterator it = set->begin(); it != set->end(); it++) {
+            enumerated++;
+        }
+
+        XCTAssertEqual(set->size(), count);
+        XCTAssertEqual(found, count);
+        XCTAssertEqual(enumerated, count);
+
+        delete set;
+    }];
+}
+
+- (void)testRowidSetSequential10k    { [self measureRowidSetWithCount:10000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testRowidSetSequential100k   { [self measureRowidSetWithCount:100000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testRowidSetSequential1M     { [self measureRowidSetWithCount:1000000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testRowidSetRandom10k        { [self measureRowidSetWithCount:10000 rowids:YapBenchmarkRowidsRandom]; }
+- (void)testRowidSetRandom100k       { [self measureRowidSetWithCount:100000 rowids:YapBenchmarkRowidsRandom]; }
+- (void)testRowidSetRandom1M         { [self measureRowidSetWithCount:1000000 rowids:YapBenchmarkRowidsRandom]; }
+
+- (void)testUnorderedSetSequential10k  { [self measureUnorderedSetWithCount:10000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testUnorderedSetSequential100k { [self measureUnorderedSetWithCount:100000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testUnorderedSetSequential1M   { [self measureUnorderedSetWithCount:1000000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testUnorderedSetRandom10k      { [self measureUnorderedSetWithCount:10000 rowids:YapBenchmarkRowidsRandom]; }
+- (void)testUnorderedSetRandom100k     { [self measureUnorderedSetWithCount:100000 rowids:YapBenchmarkRowidsRandom]; }
+- (void)testUnorderedSetRandom1M       { [self measureUnorderedSetWithCount:1000000 rowids:YapBenchmarkRowidsRandom]; }
+
+#pragma mark View pages
+
+// Serializes a page holding every rowid and reads it back, as a view does when a page is written and then loaded.
+- (void)measureViewPageWithCount:(NSUInteger)count rowids:(YapBenchmarkRowids)kind
+{
+    std::vector<int64_t> rowids = YapBenchmarkMakeRowids(count, kind);
+
+    YapDatabaseViewPage *page = [[YapDatabaseViewPage alloc] initWithCapacity:count];
+    for (int64_t rowid : rowids) {
+        [page addRowid:rowid];
+    }
+
+    NSData *legacyData = YapBenchmarkLegacySerialize(rowids);
+
+    [self measureBlock:^{
+        NSData *data = [page serialize];
+
+        YapDatabaseViewPage *readPage = [[YapDatabaseViewPage alloc] initWithCapacity:count];
+        [readPage deserialize:data];
+
+        XCTAssertEqual([readPage count], count);
+        XCTAssertEqual([readPage rowidAtIndex:count - 1], rowids[count - 1]);
+        XCTAssertLessThan([data length], [legacyData length]);
+    }];
+}
+
+- (void)measureLegacyViewPageWithCount:(NSUInteger)count rowids:(YapBenchmarkRowids)kind
+{
+    std::vector<int64_t> rowids = YapBenchmarkMakeRowids(count, kind);
+
+    [self measureBlock:^{
+        NSData *data = YapBenchmarkLegacySerialize(rowids);
+
+        std::vector<int64_t> readRowids;
+        YapBenchmarkLegacyDeserialize(data, readRowids);
+
+        XCTAssertEqual(readRowids.size(), count);
+        XCTAssertEqual(readRowids[count - 1], rowids[count - 1]);
+    }];
+}
+
+// Pages written in the original format are still read.
+- (void)testViewPageReadsLegacyFormat
+{
+    std::vector<int64_t> rowids = YapBenchmarkMakeRowids(1000, YapBenchmarkRowidsRandom);
+
+    YapDatabaseViewPage *page = [[YapDatabaseViewPage alloc] init];
+    [page deserialize:YapBenchmarkLegacySerialize(rowids)];
+
+    XCTAssertEqual([page count], rowids.size());
+    for (NSUInteger i = 0; i < rowids.size(); i++) {
+        XCTAssertEqual([page rowidAtIndex:i], rowids[i]);
+    }
+}
+
+- (void)testViewPageSequential10k    { [self measureViewPageWithCount:10000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testViewPageSequential100k   { [self measureViewPageWithCount:100000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testViewPageSequential1M     { [self measureViewPageWithCount:1000000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testViewPageRandom10k        { [self measureViewPageWithCount:10000 rowids:YapBenchmarkRowidsRandom]; }
+- (void)testViewPageRandom100k       { [self measureViewPageWithCount:100000 rowids:YapBenchmarkRowidsRandom]; }
+- (void)testViewPageRandom1M         { [self measureViewPageWithCount:1000000 rowids:YapBenchmarkRowidsRandom]; }
+
+- (void)testLegacyViewPageSequential10k  { [self measureLegacyViewPageWithCount:10000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testLegacyViewPageSequential100k { [self measureLegacyViewPageWithCount:100000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testLegacyViewPageSequential1M   { [self measureLegacyViewPageWithCount:1000000 rowids:YapBenchmarkRowidsSequential]; }
+- (void)testLegacyViewPageRandom10k      { [self measureLegacyViewPageWithCount:10000 rowids:YapBenchmarkRowidsRandom]; }
+- (void)testLegacyViewPageRandom100k     { [self measureLegacyViewPageWithCount:100000 rowids:YapBenchmarkRowidsRandom]; }
+- (void)testLegacyViewPageRandom1M       { [self measureLegacyViewPageWithCount:1000000 rowids:YapBenchmarkRowidsRandom]; }
+
+@end
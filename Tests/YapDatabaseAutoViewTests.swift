@@ -0,0 +1,172 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseAutoViewTests: TemporaryDatabaseTestCase {
+
+    private let collection = "rows"
+    private let rowCount = 20000
+
+    override func setUp() {
+        super.setUp()
+
+        // Plenty of duplicate sort values, spread over two groups, inserted out of order.
+        database.newConnection().readWrite { transaction in
+            for index in 0..<self.rowCount {
+                let value = (index * 7919) % self.rowCount
+                transaction.setObject(NSNumber(value: value), forKey: "key-\(value)", inCollection: self.collection)
+            }
+        }
+    }
+
+    private func view(withSortKey: Bool) -> YapDatabaseAutoView {
+        let grouping = YapDatabaseViewGrouping.withObjectBlock { (_, _, _, object) -> String? in
+            guard let number = object as? NSNumber else { return nil }
+            return number.intValue % 2 == 0 ? "even" : "odd"
+        }
+
+        let sorting = YapDatabaseViewSorting.withObjectBlock { (_, _, _, _, object1, _, _, object2) -> ComparisonResult in
+            guard let number1 = object1 as? NSNumber, let number2 = object2 as? NSNumber else { return .orderedSame }
+            return NSNumber(value: number1.intValue % 100).compare(NSNumber(value: number2.intValue % 100))
+        }
+
+        if withSortKey {
+            sorting.sortKeyBlock = { _, _, _, _, object, _ in
+                return Int64(((object as? NSNumber)?.intValue ?? 0) % 100)
+            }
+        }
+
+        return YapDatabaseAutoView(grouping: grouping, sorting: sorting, versionTag: "1", options: nil)
+    }
+
+    private func keys(inView viewName: String, group: String) -> [String] {
+        var keys = [String]()
+
+        database.newConnection().read { transaction in
+            guard let viewTransaction = transaction.ext(viewName) as? YapDatabaseViewTransaction else { return }
+
+            viewTransaction.enumerateKeys(inGroup: group) { _, key, _, _ in
+                keys.append(key)
+            }
+        }
+
+        return keys
+    }
+
+    func testBulkPopulationMatchesSortingBlock() {
+        XCTAssertTrue(database.register(view(withSortKey: false), withName: "sorted"))
+        XCTAssertTrue(database.register(view(withSortKey: true), withName: "bulk"))
+
+        for group in ["even", "odd"] {
+            let expected = keys(inView: "sorted", group: group)
+
+            XCTAssertEqual(expected.count, rowCount / 2)
+            XCTAssertEqual(keys(inView: "bulk", group: group), expected)
+        }
+    }
+
+    func testIncrementalInsertsMatchSortingBlock() {
+        XCTAssertTrue(database.register(view(withSortKey: false), withName: "sorted"))
+        XCTAssertTrue(database.register(view(withSortKey: true), withName: "keyed"))
+
+        // Updates move rows between groups and positions, inserts land all over the place.
+        database.newConnection().readWrite { transaction in
+            for index in 0..<2000 {
+                let value = (index * 104729) % (self.rowCount * 2)
+                let key = index % 2 == 0 ? "key-\(index * 3)" : "new-\(index)"
+                transaction.setObject(NSNumber(value: value), forKey: key, inCollection: self.collection)
+            }
+        }
+
+        for group in ["even", "odd"] {
+            XCTAssertEqual(keys(inView: "keyed", group: group), keys(inView: "sorted", group: group))
+        }
+    }
+
+    func testFindRangeBySortKey() {
+        XCTAssertTrue(database.register(view(withSortKey: true), withName: "keyed"))
+
+        database.newConnection().read { transaction in
+            guard let viewTransaction = transaction.ext("keyed") as? YapDatabaseAutoViewTransaction else {
+                XCTFail("View isn't registered")
+                return
+            }
+
+            // Even values modulo 100 are 0, 2, 4, ..., each shared by rowCount / 100 rows.
+            let range = viewTransaction.findRange(inGroup: "even", minSortKey: 10, maxSortKey: 20)
+            XCTAssertEqual(range.location, 5 * self.rowCount / 100)
+            XCTAssertEqual(range.length, 6 * self.rowCount / 100)
+
+            viewTransaction.enumerateKeysAndObjects(inGroup: "even", with: [], range: range) { _, _, object, _, _ in
+                let sortValue = ((object as? NSNumber)?.intValue ?? -1) % 100
+                XCTAssertTrue((10...20).contains(sortValue))
+            }
+
+            let missing = viewTransaction.findRange(inGroup: "odd", minSortKey: 200, maxSortKey: 300)
+            XCTAssertEqual(missing.location, NSNotFound)
+        }
+    }
+
+    func testInsertIntoLargeGroupPerformance() {
+        let largeCollection = "messages"
+        let existingCount = 100000
+        let insertCount = 10000
+
+        let grouping = YapDatabaseViewGrouping.withKeyBlock { (_, collection, _) -> String? in
+            return collection == largeCollection ? "thread" : nil
+        }
+
+        let sorting = YapDatabaseViewSorting.withObjectBlock { (_, _, _, _, object1, _, _, object2) -> ComparisonResult in
+            guard let number1 = object1 as? NSNumber, let number2 = object2 as? NSNumber else { return .orderedSame }
+            return number1.compare(number2)
+        }
+        sorting.sortKeyBlock = { _, _, _, _, object, _ in
+            return (object as? NSNumber)?.int64Value ?? 0
+        }
+
+        let connection = database.newConnection()
+        connection.readWrite { transaction in
+            for index in 0..<existingCount {
+                transaction.setObject(NSNumber(value: index * 2), forKey: "existing-\(index)", inCollection: largeCollection)
+            }
+        }
+
+        XCTAssertTrue(database.register(YapDatabaseAutoView(grouping: grouping, sorting: sorting, versionTag: "1", options: nil), withName: "thread"))
+
+        var iteration = 0
+
+        // Every new message lands between two existing ones, away from either end of the view.
+        measure {
+            connection.readWrite { transaction in
+                for index in 0..<insertCount {
+                    let value = ((index * 7919) % existingCount) * 2 + 1
+                    transaction.setObject(NSNumber(value: value), forKey: "new-\(iteration)-\(index)", inCollection: largeCollection)
+                }
+            }
+            iteration += 1
+        }
+    }
+
+    func testBulkPopulationPerformance() {
+        var index = 0
+
+        measure {
+            XCTAssertTrue(database.register(view(withSortKey: true), withName: "bulk-\(index)"))
+            index += 1
+        }
+    }
+}
@@ -0,0 +1,227 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseBatchPopulationTests: TemporaryDatabaseTestCase {
+
+    private let collection = "rows"
+    private let otherCollection = "other"
+    private let rowCount = 20000
+    private let batchSize: UInt = 100
+
+    override func setUp() {
+        super.setUp()
+
+        database.newConnection().readWrite { transaction in
+            for index in 0..<self.rowCount {
+                let value = (index * 7919) % self.rowCount
+                transaction.setObject(NSNumber(value: value), forKey: "key-\(value)", inCollection: self.collection)
+                if index % 10 == 0 {
+                    transaction.setObject(NSNumber(value: value), forKey: "key-\(value)", inCollection: self.otherCollection)
+                }
+            }
+        }
+    }
+
+    private func view(batchSize: UInt, onGrouping: ((YapDatabaseReadTransaction) -> Void)? = nil) -> YapDatabaseAutoView {
+        let grouping = YapDatabaseViewGrouping.withObjectBlock { (transaction, _, _, object) -> String? in
+            onGrouping?(transaction)
+
+            guard let number = object as? NSNumber else { return nil }
+            return number.intValue % 2 == 0 ? "even" : "odd"
+        }
+
+        let sorting = YapDatabaseViewSorting.withObjectBlock { (_, _, _, _, object1, _, _, object2) -> ComparisonResult in
+            guard let number1 = object1 as? NSNumber, let number2 = object2 as? NSNumber else { return .orderedSame }
+            return number1.compare(number2)
+        }
+
+        let options = YapDatabaseViewOptions()
+        options.allowedCollections = YapWhitelistBlacklist(whitelist: [collection])
+
+        let view = YapDatabaseAutoView(grouping: grouping, sorting: sorting, versionTag: "1", options: options)
+        view.populationBatchSize = batchSize
+
+        return view
+    }
+
+    private func index(batchSize: UInt) -> YapDatabaseSecondaryIndex {
+        let setup = YapDatabaseSecondaryIndexSetup()
+        setup.addColumn("value", with: .integer)
+
+        let handler = YapDatabaseSecondaryIndexHandler.withObjectBlock { _, dict, _, _, object in
+            guard let number = object as? NSNumber, number.intValue % 3 == 0 else { return }
+            dict["value"] = number
+        }
+
+        let index = YapDatabaseSecondaryIndex(setup: setup, handler: handler)
+        index.populationBatchSize = batchSize
+
+        return index
+    }
+
+    private func waitUntilPopulated(_ extensionName: String) {
+        let populated = expectation(forNotification: NSNotification.Name.YapDatabaseExtensionPopulated, object: database) { notification in
+            return notification.userInfo?[YapDatabaseExtensionNameKey] as? String == extensionName
+        }
+
+        wait(for: [populated], timeout: 60)
+    }
+
+    private func keys(inView viewName: String, group: String) -> [String] {
+        var keys = [String]()
+
+        database.newConnection().read { transaction in
+            guard let viewTransaction = transaction.ext(viewName) as? YapDatabaseViewTransaction else { return }
+
+            viewTransaction.enumerateKeys(inGroup: group) { _, key, _, _ in
+                keys.append(key)
+            }
+        }
+
+        return keys
+    }
+
+    private func indexedKeys(inIndex indexName: String) -> Set<String> {
+        var keys = Set<String>()
+
+        database.newConnection().read { transaction in
+            guard let indexTransaction = transaction.ext(indexName) as? YapDatabaseSecondaryIndexTransaction else { return }
+
+            let query = YapDatabaseQuery(string: "WHERE value >= ?", parameters: [0])
+            indexTransaction.enumerateKeys(matching: query) { collection, key, _ in
+                keys.insert("\(collection)/\(key)")
+            }
+        }
+
+        return keys
+    }
+
+    private func isPopulated(_ extensionName: String) -> Bool {
+        var isPopulated = false
+
+        database.newConnection().read { transaction in
+            isPopulated = (transaction.ext(extensionName) as? YapDatabaseExtensionTransaction)?.isPopulated() ?? false
+        }
+
+        return isPopulated
+    }
+
+    func testBatchedViewMatchesBlockingPopulation() {
+        var sawUnpopulated = false
+        let batched = view(batchSize: batchSize) { transaction in
+            if (transaction.ext("batched") as? YapDatabaseExtensionTransaction)?.isPopulated() == false {
+                sawUnpopulated = true
+            }
+        }
+
+        XCTAssertTrue(database.register(batched, withName: "batched"))
+        waitUntilPopulated("batched")
+
+        XCTAssertTrue(sawUnpopulated)
+        XCTAssertTrue(isPopulated("batched"))
+
+        XCTAssertTrue(database.register(view(batchSize: 0), withName: "blocking"))
+        XCTAssertTrue(isPopulated("blocking"))
+
+        for group in ["even", "odd"] {
+            let expected = keys(inView: "blocking", group: group)
+
+            XCTAssertEqual(expected.count, rowCount / 2)
+            XCTAssertEqual(keys(inView: "batched", group: group), expected)
+        }
+    }
+
+    func testBatchedIndexMatchesBlockingPopulation() {
+        XCTAssertTrue(database.register(index(batchSize: batchSize), withName: "batched"))
+        waitUntilPopulated("batched")
+
+        XCTAssertTrue(database.register(index(batchSize: 0), withName: "blocking"))
+
+        let expected = indexedKeys(inIndex: "blocking")
+        XCTAssertFalse(expected.isEmpty)
+        XCTAssertEqual(indexedKeys(inIndex: "batched"), expected)
+    }
+
+    func testChangesDuringPopulation() {
+        XCTAssertTrue(database.register(view(batchSize: batchSize), withName: "batched"))
+        XCTAssertTrue(database.register(index(batchSize: batchSize), withName: "batchedIndex"))
+
+        let viewPopulated = expectation(forNotification: NSNotification.Name.YapDatabaseExtensionPopulated, object: database) { notification in
+            return notification.userInfo?[YapDatabaseExtensionNameKey] as? String == "batched"
+        }
+        let indexPopulated = expectation(forNotification: NSNotification.Name.YapDatabaseExtensionPopulated, object: database) { notification in
+            return notification.userInfo?[YapDatabaseExtensionNameKey] as? String == "batchedIndex"
+        }
+
+        // Small transactions, interleaved with the batches: updates of rows on either side of the cursor,
+        // removals of rows which haven't been reached yet, and inserts beyond the end of the range.
+        let connection = database.newConnection()
+        for step in 0..<50 {
+            connection.readWrite { transaction in
+                for index in 0..<40 {
+                    let value = ((step * 40 + index) * 104729) % self.rowCount
+                    switch index % 4 {
+                    case 0:
+                        transaction.removeObject(forKey: "key-\(value)", inCollection: self.collection)
+                    case 1:
+                        transaction.setObject(NSNumber(value: value + 1), forKey: "key-\(value)", inCollection: self.collection)
+                    default:
+                        transaction.setObject(NSNumber(value: value), forKey: "new-\(step)-\(index)", inCollection: self.collection)
+                    }
+                }
+            }
+        }
+
+        wait(for: [viewPopulated, indexPopulated], timeout: 60)
+
+        XCTAssertTrue(database.register(view(batchSize: 0), withName: "blocking"))
+        XCTAssertTrue(database.register(index(batchSize: 0), withName: "blockingIndex"))
+
+        for group in ["even", "odd"] {
+            XCTAssertEqual(keys(inView: "batched", group: group), keys(inView: "blocking", group: group))
+        }
+        XCTAssertEqual(indexedKeys(inIndex: "batchedIndex"), indexedKeys(inIndex: "blockingIndex"))
+    }
+
+    func testEmptyDatabaseIsPopulatedImmediately() {
+        database.newConnection().readWrite { transaction in
+            transaction.removeAllObjectsInAllCollections()
+        }
+
+        XCTAssertTrue(database.register(view(batchSize: batchSize), withName: "batched"))
+        XCTAssertTrue(isPopulated("batched"))
+
+        waitUntilPopulated("batched")
+    }
+
+    func testWritesDontWaitForPopulation() {
+        XCTAssertTrue(database.register(view(batchSize: batchSize), withName: "batched"))
+
+        // This write is queued behind at most one batch, not behind the whole population.
+        var populatedDuringWrite = true
+        database.newConnection().readWrite { transaction in
+            populatedDuringWrite = (transaction.ext("batched") as? YapDatabaseExtensionTransaction)?.isPopulated() ?? true
+            transaction.setObject(NSNumber(value: 1), forKey: "during", inCollection: self.collection)
+        }
+
+        XCTAssertFalse(populatedDuringWrite)
+
+        waitUntilPopulated("batched")
+        XCTAssertTrue(keys(inView: "batched", group: "odd").contains("during"))
+    }
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseBatchReadTests: TemporaryDatabaseTestCase {
+
+    private let collection = "BatchReadTests"
+    private let rowCount = 1000
+
+    private lazy var keys: [String] = {
+        return (0..<self.rowCount).map { "key-\($0)" }
+    }()
+
+    override func setUp() {
+        super.setUp()
+
+        database.newConnection().readWrite { transaction in
+            for (index, key) in self.keys.enumerated() {
+                let object: NSDictionary = ["index": index, "body": String(repeating: "o hai ", count: 20)]
+                transaction.setObject(object, forKey: key, inCollection: self.collection)
+            }
+        }
+    }
+
+    func testBatchFetchReturnsExistingObjects() {
+        let requestedKeys = ["key-1", "key-999", "missing", "key-500"]
+        var objects: [String: Any] = [:]
+
+        database.newConnection().read { transaction in
+            objects = transaction.objects(forKeys: requestedKeys, inCollection: self.collection)
+        }
+
+        XCTAssertEqual(objects.count, 3)
+        XCTAssertNil(objects["missing"])
+        XCTAssertEqual((objects["key-999"] as? NSDictionary)?["index"] as? Int, 999)
+    }
+
+    func testBatchFetchUsesObjectCache() {
+        let connection = database.newConnection()
+        var cachedObject: Any?
+        var batchedObject: Any?
+
+        connection.read { transaction in
+            cachedObject = transaction.object(forKey: "key-7", inCollection: self.collection)
+            batchedObject = transaction.objects(forKeys: ["key-7", "key-8"], inCollection: self.collection)["key-7"]
+        }
+
+        XCTAssertNotNil(cachedObject)
+        XCTAssertTrue((cachedObject as AnyObject) === (batchedObject as AnyObject))
+    }
+
+    func testPerformanceSingleFetches() {
+        measure {
+            // A fresh connection per iteration keeps the object cache cold.
+            self.database.newConnection().read { transaction in
+                for key in self.keys {
+                    _ = transaction.object(forKey: key, inCollection: self.collection)
+                }
+            }
+        }
+    }
+
+    func testPerformanceBatchFetch() {
+        measure {
+            self.database.newConnection().read { transaction in
+                let objects = transaction.objects(forKeys: self.keys, inCollection: self.collection)
+                XCTAssertEqual(objects.count, self.rowCount)
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseBytesDeserializerTests: TemporaryDatabaseTestCase {
+
+    private let messageCount = 2000
+
+    // An interactions collection like the app's: binary archived messages, read without the object cache,
+    // so that every enumerated row is deserialized.
+    private func makeDatabase(parseInPlace: Bool) -> YapDatabase {
+        let options = YapDatabaseOptions()
+        if parseInPlace {
+            options.objectBytesDeserializer = { _, _, bytes, length in
+                return OWSBinaryUnarchiver.unarchiveObject(withBytes: bytes, length: length, unknownClassBlock: nil)
+            }
+        }
+
+        let database = YapDatabase(path: makeDatabasePath(),
+                                   serializer: { _, _, object in OWSBinaryArchiver.archivedData(withRootObject: object) },
+                                   deserializer: { _, _, data in OWSBinaryUnarchiver.unarchiveObject(with: data, unknownClassBlock: nil) as Any },
+                                   options: options)!
+
+        let thread = TSContactThread(uniqueId: "SomeUser")!
+        let body = "SOFA::Message:{\"body\":\"\(String(repeating: "o hai ", count: 40))\"}"
+
+        database.newConnection().readWrite { transaction in
+            for index in 0..<self.messageCount {
+                let message = TSIncomingMessage(timestamp: UInt64(1514764800000 + index),
+                                                in: thread,
+                                                authorId: "SomeUser",
+                                                sourceDeviceId: 1,
+                                                messageBody: body)
+                transaction.setObject(message, forKey: "message-\(index)", inCollection: TSInteraction.collection())
+            }
+        }
+
+        return database
+    }
+
+    private func enumerateInteractions(in database: YapDatabase) -> Int {
+        let connection = database.newConnection()
+        connection.objectCacheEnabled = false
+
+        var count = 0
+        connection.read { transaction in
+            transaction.enumerateKeysAndObjects(inCollection: TSInteraction.collection()) { _, object, _ in
+                if object is TSIncomingMessage {
+                    count += 1
+                }
+            }
+        }
+
+        return count
+    }
+
+    func testParseInPlaceReadsSameObjects() {
+        let database = makeDatabase(parseInPlace: true)
+        let connection = database.newConnection()
+        connection.objectCacheEnabled = false
+
+        connection.read { transaction in
+            let message = transaction.object(forKey: "message-7", inCollection: TSInteraction.collection()) as? TSIncomingMessage
+            XCTAssertEqual(message?.timestamp, 1514764800007)
+            XCTAssertEqual(message?.authorId, "SomeUser")
+        }
+
+        XCTAssertEqual(enumerateInteractions(in: database), messageCount)
+    }
+
+    func testEnumerateInteractionsPerformanceWithData() {
+        let database = makeDatabase(parseInPlace: false)
+
+        measure {
+            XCTAssertEqual(self.enumerateInteractions(in: database), self.messageCount)
+        }
+    }
+
+    func testEnumerateInteractionsPerformanceParsingInPlace() {
+        let database = makeDatabase(parseInPlace: true)
+
+        measure {
+            XCTAssertEqual(self.enumerateInteractions(in: database), self.messageCount)
+        }
+    }
+}
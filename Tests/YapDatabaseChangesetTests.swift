@@ -0,0 +1,165 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseChangesetTests: TemporaryDatabaseTestCase {
+
+    private var readConnection: YapDatabaseConnection!
+    private var writeConnection: YapDatabaseConnection!
+
+    override func setUp() {
+        super.setUp()
+
+        readConnection = database.newConnection()
+        writeConnection = database.newConnection()
+
+        writeConnection.readWrite { transaction in
+            for index in 0..<1000 {
+                transaction.setObject("value-\(index)", forKey: "key-\(index)", inCollection: "objects")
+            }
+            transaction.setObject("value", forKey: "key", inCollection: "cleared")
+        }
+
+        readConnection.beginLongLivedReadTransaction()
+    }
+
+    override func tearDown() {
+        readConnection = nil
+        writeConnection = nil
+
+        super.tearDown()
+    }
+
+    func testChangeQueries() {
+        writeConnection.readWrite { transaction in
+            transaction.setObject("updated", forKey: "key-1", inCollection: "objects")
+            transaction.replaceMetadata("metadata", forKey: "key-2", inCollection: "objects")
+            transaction.removeObject(forKey: "key-3", inCollection: "objects")
+            transaction.removeAllObjects(inCollection: "cleared")
+        }
+
+        let notifications = readConnection.beginLongLivedReadTransaction()
+
+        XCTAssertTrue(readConnection.hasChange(forCollection: "objects", in: notifications))
+        XCTAssertFalse(readConnection.hasChange(forCollection: "untouched", in: notifications))
+
+        XCTAssertTrue(readConnection.hasObjectChange(forKey: "key-1", inCollection: "objects", in: notifications))
+        XCTAssertFalse(readConnection.hasMetadataChange(forKey: "key-1", inCollection: "objects", in: notifications))
+        XCTAssertTrue(readConnection.hasMetadataChange(forKey: "key-2", inCollection: "objects", in: notifications))
+        XCTAssertFalse(readConnection.hasObjectChange(forKey: "key-2", inCollection: "objects", in: notifications))
+        XCTAssertTrue(readConnection.hasChange(forKey: "key-3", inCollection: "objects", in: notifications))
+        XCTAssertFalse(readConnection.hasChange(forKey: "key-4", inCollection: "objects", in: notifications))
+
+        XCTAssertTrue(readConnection.hasChange(forAnyKeys: ["key-0", "key-3"], inCollection: "objects", in: notifications))
+        XCTAssertFalse(readConnection.hasChange(forAnyKeys: ["key-0", "key-4"], inCollection: "objects", in: notifications))
+
+        XCTAssertTrue(readConnection.didClearCollection("cleared", in: notifications))
+        XCTAssertTrue(readConnection.hasChange(forKey: "key", inCollection: "cleared", in: notifications))
+        XCTAssertFalse(readConnection.didClearCollection("objects", in: notifications))
+
+        var changedKeys = Set<String>()
+        readConnection.enumerateChangedKeys(inCollection: "objects", in: notifications) { key, _ in
+            changedKeys.insert(key)
+        }
+        XCTAssertEqual(changedKeys, ["key-1", "key-2", "key-3"])
+    }
+
+    func testRemovedAndReinsertedKey() {
+        writeConnection.readWrite { transaction in
+            transaction.removeObject(forKey: "key-5", inCollection: "objects")
+            transaction.setObject("reinserted", forKey: "key-5", inCollection: "objects")
+        }
+
+        let notifications = readConnection.beginLongLivedReadTransaction()
+
+        XCTAssertTrue(readConnection.hasObjectChange(forKey: "key-5", inCollection: "objects", in: notifications))
+        XCTAssertTrue(readConnection.hasMetadataChange(forKey: "key-5", inCollection: "objects", in: notifications))
+        XCTAssertFalse(readConnection.hasChange(forKey: "key-6", inCollection: "objects", in: notifications))
+
+        var changedKeys = [String]()
+        readConnection.enumerateChangedKeys(inCollection: "objects", in: notifications) { key, _ in
+            changedKeys.append(key)
+        }
+        XCTAssertEqual(changedKeys, ["key-5"])
+
+        readConnection.read { transaction in
+            XCTAssertEqual(transaction.object(forKey: "key-5", inCollection: "objects") as? String, "reinserted")
+        }
+    }
+
+    func testNotificationDoesNotHoldChangedObjects() {
+        writeConnection.readWrite { transaction in
+            transaction.setObject("updated", forKey: "key-1", inCollection: "objects")
+            transaction.removeObject(forKey: "key-2", inCollection: "objects")
+        }
+
+        let notifications = readConnection.beginLongLivedReadTransaction()
+        XCTAssertEqual(notifications.count, 1)
+
+        let userInfo = (notifications.first as? Notification)?.userInfo
+        XCTAssertNotNil(userInfo)
+        XCTAssertNil(userInfo?[YapDatabaseObjectChangesKey])
+        XCTAssertNil(userInfo?[YapDatabaseMetadataChangesKey])
+        XCTAssertNil(userInfo?[YapDatabaseRemovedKeysKey])
+    }
+
+    func testSiblingCacheReflectsRemovalsAndUpdates() {
+        // Fill the reader's cache, so it holds far more objects than the changeset touches.
+        readConnection.read { transaction in
+            for index in 0..<1000 {
+                _ = transaction.object(forKey: "key-\(index)", inCollection: "objects")
+            }
+        }
+
+        writeConnection.readWrite { transaction in
+            for index in 0..<10 {
+                transaction.removeObject(forKey: "key-\(index)", inCollection: "objects")
+            }
+            transaction.removeObject(forKey: "key-10", inCollection: "objects")
+            transaction.setObject("replaced", forKey: "key-10", inCollection: "objects")
+            transaction.setObject("updated", forKey: "key-11", inCollection: "objects")
+        }
+
+        readConnection.beginLongLivedReadTransaction()
+
+        readConnection.read { transaction in
+            for index in 0..<10 {
+                XCTAssertNil(transaction.object(forKey: "key-\(index)", inCollection: "objects"))
+            }
+            XCTAssertEqual(transaction.object(forKey: "key-10", inCollection: "objects") as? String, "replaced")
+            XCTAssertEqual(transaction.object(forKey: "key-11", inCollection: "objects") as? String, "updated")
+            XCTAssertEqual(transaction.object(forKey: "key-12", inCollection: "objects") as? String, "value-12")
+        }
+    }
+
+    func testLargeChangesetQueryPerformance() {
+        writeConnection.readWrite { transaction in
+            for index in 0..<20000 {
+                transaction.setObject(index, forKey: "bulk-\(index)", inCollection: "bulk-\(index % 50)")
+            }
+        }
+
+        let notifications = readConnection.beginLongLivedReadTransaction()
+
+        measure {
+            for index in 0..<1000 {
+                XCTAssertFalse(readConnection.hasChange(forCollection: "objects-\(index)", in: notifications))
+                XCTAssertTrue(readConnection.hasChange(forKey: "bulk-\(index)", inCollection: "bulk-\(index % 50)", in: notifications))
+            }
+        }
+    }
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseCheckpointTests: TemporaryDatabaseTestCase {
+
+    private let walSizeLimit: UInt64 = 256 * 1024
+
+    override var databaseOptions: YapDatabaseOptions? {
+        let options = YapDatabaseOptions()
+        options.aggressiveWALTruncationSize = walSizeLimit
+
+        return options
+    }
+
+    private func writeBursts(count: Int, writesPerBurst: Int) {
+        let writer = database.newConnection()
+        let reader = database.newConnection()
+        let payload = String(repeating: "x", count: 2048)
+
+        for burst in 0..<count {
+            for index in 0..<writesPerBurst {
+                writer.readWrite { transaction in
+                    transaction.setObject(payload, forKey: "key-\(burst)-\(index)", inCollection: "checkpoint")
+                }
+
+                // Readers come and go while the writes are happening.
+                reader.asyncRead { transaction in
+                    _ = transaction.object(forKey: "key-\(burst)-\(index)", inCollection: "checkpoint")
+                }
+            }
+
+            Thread.sleep(forTimeInterval: 0.01)
+        }
+
+        reader.read { _ in }
+    }
+
+    private func waitForWALToSettle(timeout: TimeInterval = 5.0) -> YapDatabaseCheckpointStats {
+        let deadline = Date(timeIntervalSinceNow: timeout)
+        var stats = database.checkpointStats()
+
+        while stats.walSize > walSizeLimit && Date() < deadline {
+            // An empty write gives the scheduler another chance to catch up.
+            database.newConnection().readWrite { _ in }
+            Thread.sleep(forTimeInterval: 0.05)
+            stats = database.checkpointStats()
+        }
+
+        return stats
+    }
+
+    func testBurstyWritesKeepWALWithinBound() {
+        writeBursts(count: 50, writesPerBurst: 40)
+
+        let stats = waitForWALToSettle()
+
+        XCTAssertGreaterThan(stats.passiveCheckpointCount, 0)
+        XCTAssertGreaterThan(stats.framesCheckpointed, 0)
+        XCTAssertLessThanOrEqual(stats.walSize, walSizeLimit)
+        XCTAssertGreaterThanOrEqual(stats.peakWALSize, stats.walSize)
+    }
+
+    func testCommitRateTracksWrites() {
+        writeBursts(count: 5, writesPerBurst: 20)
+
+        XCTAssertGreaterThan(database.checkpointStats().commitRate, 0)
+    }
+
+    func testBurstyWritesPerformance() {
+        measure {
+            writeBursts(count: 10, writesPerBurst: 40)
+        }
+
+        let stats = database.checkpointStats()
+        XCTAssertLessThan(stats.maxWriterStall, 0.5)
+    }
+}
@@ -0,0 +1,289 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseGroupCommitTests: TemporaryDatabaseTestCase {
+
+    private let collection = "groupCommit"
+
+    private func writeSingleKeys(count: Int, groupCommitLimit: UInt) -> UInt64 {
+        let connection = database.newConnection()
+        connection.groupCommitLimit = groupCommitLimit
+
+        let snapshotBefore = database.snapshot
+        let completions = DispatchGroup()
+        let completionQueue = DispatchQueue(label: "groupCommit.completion")
+
+        for index in 0..<count {
+            completions.enter()
+            connection.asyncReadWrite({ transaction in
+                transaction.setObject(index, forKey: "key-\(index)", inCollection: self.collection)
+            }, completionQueue: completionQueue, completionBlock: {
+                completions.leave()
+            })
+        }
+
+        XCTAssertEqual(completions.wait(timeout: .now() + 60), .success)
+
+        return database.snapshot - snapshotBefore
+    }
+
+    func testCompletionBlocksFirePerBlockInOrder() {
+        let connection = database.newConnection()
+        connection.groupCommitLimit = 16
+        connection.groupCommitWindow = 0.05
+
+        let completionQueue = DispatchQueue(label: "groupCommit.completion")
+        let done = expectation(description: "all completions")
+        var completed = [Int]()
+
+        for index in 0..<100 {
+            connection.asyncReadWrite({ transaction in
+                transaction.setObject(index, forKey: "key-\(index)", inCollection: self.collection)
+            }, completionQueue: completionQueue, completionBlock: {
+                completed.append(index)
+                if completed.count == 100 {
+                    done.fulfill()
+                }
+            })
+        }
+
+        waitForExpectations(timeout: 10)
+
+        XCTAssertEqual(completed, Array(0..<100))
+
+        database.newConnection().read { transaction in
+            XCTAssertEqual(transaction.numberOfKeys(inCollection: self.collection), 100)
+        }
+    }
+
+    func testRollbackIsIsolatedToItsBlock() {
+        let connection = database.newConnection()
+        connection.groupCommitLimit = 8
+        connection.groupCommitWindow = 0.05
+
+        let done = expectation(description: "all completions")
+        done.expectedFulfillmentCount = 8
+
+        for index in 0..<8 {
+            connection.asyncReadWrite({ transaction in
+                transaction.setObject(index, forKey: "key-\(index)", inCollection: self.collection)
+
+                if index == 3 {
+                    transaction.rollback()
+                }
+            }, completionBlock: {
+                done.fulfill()
+            })
+        }
+
+        waitForExpectations(timeout: 10)
+
+        database.newConnection().read { transaction in
+            XCTAssertNil(transaction.object(forKey: "key-3", inCollection: self.collection))
+
+            for index in [0, 1, 2, 4, 5, 6, 7] {
+                XCTAssertEqual(transaction.object(forKey: "key-\(index)", inCollection: self.collection) as? Int, index)
+            }
+        }
+    }
+
+    func testSucceededBlocksRunOnceWhenAnotherRollsBack() {
+        let connection = database.newConnection()
+        connection.groupCommitLimit = 8
+        connection.groupCommitWindow = 0.05
+
+        let snapshotBefore = database.snapshot
+        let done = expectation(description: "all completions")
+        done.expectedFulfillmentCount = 8
+
+        // Blocks in a group run one after another on the write queue.
+        var runCounts = [Int](repeating: 0, count: 8)
+
+        for index in 0..<8 {
+            connection.asyncReadWrite({ transaction in
+                runCounts[index] += 1
+                transaction.setObject(index, forKey: "key-\(index)", inCollection: self.collection)
+
+                if index == 2 || index == 5 {
+                    transaction.rollback()
+                }
+            }, completionBlock: {
+                done.fulfill()
+            })
+        }
+
+        waitForExpectations(timeout: 10)
+
+        XCTAssertEqual(runCounts, [Int](repeating: 1, count: 8))
+        XCTAssertEqual(database.snapshot - snapshotBefore, 1)
+
+        database.newConnection().read { transaction in
+            XCTAssertEqual(transaction.numberOfKeys(inCollection: self.collection), 6)
+            XCTAssertNil(transaction.object(forKey: "key-2", inCollection: self.collection))
+            XCTAssertNil(transaction.object(forKey: "key-5", inCollection: self.collection))
+        }
+    }
+
+    func testRolledBackBlockLeavesNoTraceInTheCache() {
+        let connection = database.newConnection()
+        connection.readWrite { transaction in
+            transaction.setObject("original", forKey: "key", inCollection: self.collection)
+        }
+
+        connection.groupCommitLimit = 2
+        connection.groupCommitWindow = 0.05
+
+        let done = expectation(description: "all completions")
+        done.expectedFulfillmentCount = 2
+
+        connection.asyncReadWrite({ transaction in
+            transaction.setObject("kept", forKey: "other", inCollection: self.collection)
+        }, completionBlock: {
+            done.fulfill()
+        })
+        connection.asyncReadWrite({ transaction in
+            transaction.setObject("discarded", forKey: "key", inCollection: self.collection)
+            transaction.removeObject(forKey: "other", inCollection: self.collection)
+            transaction.rollback()
+        }, completionBlock: {
+            done.fulfill()
+        })
+
+        waitForExpectations(timeout: 10)
+
+        connection.read { transaction in
+            XCTAssertEqual(transaction.object(forKey: "key", inCollection: self.collection) as? String, "original")
+            XCTAssertEqual(transaction.object(forKey: "other", inCollection: self.collection) as? String, "kept")
+        }
+    }
+
+    func testRolledBackBlockLeavesNoTraceInAView() {
+        let grouping = YapDatabaseViewGrouping.withObjectBlock { (_, _, _, _) -> String? in
+            return "all"
+        }
+        let sorting = YapDatabaseViewSorting.withObjectBlock { (_, _, _, _, object1, _, _, object2) -> ComparisonResult in
+            guard let number1 = object1 as? NSNumber, let number2 = object2 as? NSNumber else { return .orderedSame }
+            return number1.compare(number2)
+        }
+        XCTAssertTrue(database.register(YapDatabaseAutoView(grouping: grouping, sorting: sorting), withName: "view"))
+
+        let connection = database.newConnection()
+        connection.groupCommitLimit = 8
+        connection.groupCommitWindow = 0.05
+
+        let snapshotBefore = database.snapshot
+        let done = expectation(description: "all completions")
+        done.expectedFulfillmentCount = 8
+
+        // Each block adds more than a page's worth of rows, interleaved with those of the other blocks,
+        // so a rolled back block has split existing pages and created new ones.
+        for block in 0..<8 {
+            connection.asyncReadWrite({ transaction in
+                for index in 0..<60 {
+                    let value = index * 8 + block
+                    transaction.setObject(NSNumber(value: value), forKey: "key-\(value)", inCollection: self.collection)
+                }
+
+                if block == 2 || block == 5 {
+                    transaction.rollback()
+                }
+            }, completionBlock: {
+                done.fulfill()
+            })
+        }
+
+        waitForExpectations(timeout: 10)
+
+        XCTAssertEqual(database.snapshot - snapshotBefore, 1)
+
+        let expected = (0..<480).filter { $0 % 8 != 2 && $0 % 8 != 5 }
+
+        // The connection's own pages, and those a new connection reads from the view's tables.
+        for readConnection in [connection, database.newConnection()] {
+            readConnection.read { transaction in
+                guard let viewTransaction = transaction.ext("view") as? YapDatabaseViewTransaction else {
+                    XCTFail("view isn't registered")
+                    return
+                }
+
+                var values = [Int]()
+                viewTransaction.enumerateKeysAndObjects(inGroup: "all") { _, _, object, _, _ in
+                    values.append((object as! NSNumber).intValue)
+                }
+                XCTAssertEqual(values, expected)
+            }
+        }
+    }
+
+    func testOpenGroupDoesNotHoldUpTheConnection() {
+        let connection = database.newConnection()
+        connection.groupCommitLimit = 64
+        connection.groupCommitWindow = 1.0
+
+        let done = expectation(description: "completion")
+        connection.asyncReadWrite({ transaction in
+            transaction.setObject("grouped", forKey: "key", inCollection: self.collection)
+        }, completionBlock: {
+            done.fulfill()
+        })
+
+        // Goes through the connection queue without closing the group.
+        let start = Date()
+        _ = connection.objectCacheLimit
+        XCTAssertLessThan(Date().timeIntervalSince(start), 0.5)
+
+        waitForExpectations(timeout: 10)
+    }
+
+    func testOtherTransactionsCloseTheGroup() {
+        let connection = database.newConnection()
+        connection.groupCommitLimit = 64
+        connection.groupCommitWindow = 1.0
+
+        connection.asyncReadWrite { transaction in
+            transaction.setObject("grouped", forKey: "key", inCollection: self.collection)
+        }
+
+        // The sync read is queued behind the group, so it must see the write, without waiting for the window.
+        let start = Date()
+        connection.read { transaction in
+            XCTAssertEqual(transaction.object(forKey: "key", inCollection: self.collection) as? String, "grouped")
+        }
+        XCTAssertLessThan(Date().timeIntervalSince(start), 0.5)
+    }
+
+    func testGroupCommitReducesCommitCount() {
+        let ungroupedCommits = writeSingleKeys(count: 1000, groupCommitLimit: 0)
+        let groupedCommits = writeSingleKeys(count: 1000, groupCommitLimit: 64)
+
+        XCTAssertEqual(ungroupedCommits, 1000)
+        XCTAssertLessThan(groupedCommits, ungroupedCommits)
+    }
+
+    func testSingleKeyWritesPerformanceWithoutGroupCommit() {
+        measure {
+            _ = writeSingleKeys(count: 10000, groupCommitLimit: 0)
+        }
+    }
+
+    func testSingleKeyWritesPerformanceWithGroupCommit() {
+        measure {
+            _ = writeSingleKeys(count: 10000, groupCommitLimit: 64)
+        }
+    }
+}
@@ -0,0 +1,257 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseTypedSecondaryIndexTests: TemporaryDatabaseTestCase {
+
+    private let collection = "messages"
+    private let otherCollection = "threads"
+    private let column = "expires_at"
+
+    // Rows whose object is a positive number are indexed by it, like expiring messages by their expiration.
+
+    private func typedIndex() -> YapDatabaseSecondaryIndex {
+        let setup = YapDatabaseSecondaryIndexSetup()
+        setup.addColumn(column, with: .integer)
+
+        let handler = YapDatabaseSecondaryIndexHandler.withObjectIntegersBlock { _, values, _, _, object in
+            guard let number = object as? NSNumber, number.int64Value > 0 else { return false }
+            values[0] = number.int64Value
+            return true
+        }
+
+        let options = YapDatabaseSecondaryIndexOptions()
+        options.includesKeys = true
+
+        return YapDatabaseSecondaryIndex(setup: setup, handler: handler, versionTag: "1", options: options)
+    }
+
+    private func genericIndex() -> YapDatabaseSecondaryIndex {
+        let setup = YapDatabaseSecondaryIndexSetup()
+        setup.addColumn(column, with: .integer)
+
+        let handler = YapDatabaseSecondaryIndexHandler.withObjectBlock { _, dict, _, _, object in
+            guard let number = object as? NSNumber, number.int64Value > 0 else { return }
+            dict[self.column] = number
+        }
+
+        return YapDatabaseSecondaryIndex(setup: setup, handler: handler)
+    }
+
+    private func registerIndexes() {
+        XCTAssertTrue(database.register(typedIndex(), withName: "typed"))
+        XCTAssertTrue(database.register(genericIndex(), withName: "generic"))
+    }
+
+    private func expiredKeys(in indexName: String, at time: Int64, transaction: YapDatabaseReadTransaction) -> Set<String> {
+        var keys = Set<String>()
+
+        let query = YapDatabaseQuery(string: "WHERE \(column) > 0 AND \(column) <= ?", parameters: [NSNumber(value: time)])
+        (transaction.ext(indexName) as? YapDatabaseSecondaryIndexTransaction)?.enumerateKeys(matching: query) { collection, key, _ in
+            keys.insert("\(collection)/\(key)")
+        }
+
+        return keys
+    }
+
+    private func writeRows(count: Int, startingAt start: Int = 0, transaction: YapDatabaseReadWriteTransaction) {
+        for index in start..<(start + count) {
+            // Every other row doesn't expire.
+            let expiresAt = index % 2 == 0 ? Int64(index) : 0
+            transaction.setObject(NSNumber(value: expiresAt), forKey: "message-\(index)", inCollection: collection)
+        }
+    }
+
+    func testTypedIndexMatchesGenericIndex() {
+        registerIndexes()
+
+        let connection = database.newConnection()
+        connection.readWrite { transaction in
+            self.writeRows(count: 1000, transaction: transaction)
+            transaction.setObject(NSNumber(value: 10), forKey: "thread", inCollection: self.otherCollection)
+        }
+
+        connection.readWrite { transaction in
+            // Several changes to the same rows, within a single transaction.
+            for index in 0..<100 {
+                transaction.setObject(NSNumber(value: 5000 + index), forKey: "message-\(index)", inCollection: self.collection)
+                transaction.setObject(NSNumber(value: index + 1), forKey: "message-\(index)", inCollection: self.collection)
+            }
+            for index in 100..<200 {
+                transaction.removeObject(forKey: "message-\(index)", inCollection: self.collection)
+            }
+            for index in 200..<300 {
+                transaction.setObject(NSNumber(value: 0), forKey: "message-\(index)", inCollection: self.collection)
+            }
+
+            // Inserted, then removed, before anything was written.
+            transaction.setObject(NSNumber(value: 1), forKey: "transient", inCollection: self.collection)
+            transaction.removeObject(forKey: "transient", inCollection: self.collection)
+
+            // Queries within the transaction see its changes.
+            let typed = self.expiredKeys(in: "typed", at: 1000, transaction: transaction)
+            XCTAssertEqual(typed, self.expiredKeys(in: "generic", at: 1000, transaction: transaction))
+            XCTAssertTrue(typed.contains("\(self.collection)/message-1"))
+            XCTAssertFalse(typed.contains("\(self.collection)/message-150"))
+            XCTAssertFalse(typed.contains("\(self.collection)/message-250"))
+            XCTAssertFalse(typed.contains("\(self.collection)/transient"))
+        }
+
+        connection.read { transaction in
+            let typed = self.expiredKeys(in: "typed", at: Int64.max, transaction: transaction)
+
+            XCTAssertEqual(typed, self.expiredKeys(in: "generic", at: Int64.max, transaction: transaction))
+            XCTAssertTrue(typed.contains("\(self.otherCollection)/thread"))
+            XCTAssertEqual(typed.count, 1 + 100 + (1000 - 300) / 2)
+        }
+    }
+
+    func testIndexPopulatesExistingRows() {
+        database.newConnection().readWrite { transaction in
+            self.writeRows(count: 3000, transaction: transaction)
+        }
+
+        registerIndexes()
+
+        database.newConnection().read { transaction in
+            let typed = self.expiredKeys(in: "typed", at: 2000, transaction: transaction)
+
+            XCTAssertEqual(typed.count, 1000)
+            XCTAssertEqual(typed, self.expiredKeys(in: "generic", at: 2000, transaction: transaction))
+        }
+    }
+
+    func testRollbackDiscardsQueuedChanges() {
+        registerIndexes()
+
+        let connection = database.newConnection()
+        connection.readWrite { transaction in
+            self.writeRows(count: 10, transaction: transaction)
+        }
+
+        connection.readWrite { transaction in
+            transaction.setObject(NSNumber(value: 4), forKey: "rolled-back", inCollection: self.collection)
+            XCTAssertTrue(self.expiredKeys(in: "typed", at: 5, transaction: transaction).contains("\(self.collection)/rolled-back"))
+
+            // Still queued up when the transaction is rolled back.
+            transaction.setObject(NSNumber(value: 3), forKey: "queued", inCollection: self.collection)
+
+            transaction.rollback()
+        }
+
+        // The next transaction on the connection mustn't write what was queued up before the rollback.
+        connection.readWrite { transaction in
+            transaction.setObject(NSNumber(value: 0), forKey: "unrelated", inCollection: self.collection)
+        }
+
+        connection.read { transaction in
+            let expected: Set<String> = ["\(self.collection)/message-2", "\(self.collection)/message-4"]
+            XCTAssertEqual(self.expiredKeys(in: "typed", at: 5, transaction: transaction), expected)
+        }
+    }
+
+    func testAggregateQueryReadsIndexedValues() {
+        registerIndexes()
+
+        let connection = database.newConnection()
+        connection.readWrite { transaction in
+            self.writeRows(count: 100, startingAt: 10, transaction: transaction)
+        }
+
+        connection.read { transaction in
+            let query = YapDatabaseQuery(aggregateFunction: "MIN(\(self.column))", string: "WHERE \(self.column) > 0", parameters: [])
+            let minimum = (transaction.ext("typed") as? YapDatabaseSecondaryIndexTransaction)?.performAggregateQuery(query) as? NSNumber
+
+            XCTAssertEqual(minimum?.int64Value, 10)
+        }
+    }
+
+    // MARK: - Expiration sweep
+
+    private let sweepRowCount = 100_000
+    private let sweepBatchSize = 100
+
+    private func populateForSweep(indexName: String, index: YapDatabaseSecondaryIndex) {
+        XCTAssertTrue(database.register(index, withName: indexName))
+
+        database.newConnection().readWrite { transaction in
+            self.writeRows(count: self.sweepRowCount, transaction: transaction)
+        }
+    }
+
+    // Finds the expired rows with a range scan of the index, then fetches them in batches, like
+    // OWSDisappearingMessagesFinder does for expired messages.
+    private func measureSweep(indexName: String) {
+        let connection = database.newConnection()
+        connection.objectCacheEnabled = false
+
+        measure {
+            var fetched = 0
+
+            connection.read { transaction in
+                var keys = [String]()
+
+                let cutoff = NSNumber(value: self.sweepRowCount / 2)
+                let query = YapDatabaseQuery(string: "WHERE \(self.column) > 0 AND \(self.column) <= ?", parameters: [cutoff])
+                (transaction.ext(indexName) as? YapDatabaseSecondaryIndexTransaction)?.enumerateKeys(matching: query) { _, key, _ in
+                    keys.append(key)
+                }
+
+                for offset in stride(from: 0, to: keys.count, by: self.sweepBatchSize) {
+                    let batch = Array(keys[offset..<min(offset + self.sweepBatchSize, keys.count)])
+                    fetched += transaction.objects(forKeys: batch, inCollection: self.collection).count
+                }
+            }
+
+            XCTAssertEqual(fetched, self.sweepRowCount / 4)
+        }
+    }
+
+    func testExpirationSweepWithTypedCoveringIndex() {
+        populateForSweep(indexName: "typed", index: typedIndex())
+        measureSweep(indexName: "typed")
+    }
+
+    func testExpirationSweepWithGenericIndex() {
+        populateForSweep(indexName: "generic", index: genericIndex())
+        measureSweep(indexName: "generic")
+    }
+
+    func testWritingExpiringRowsWithTypedCoveringIndex() {
+        XCTAssertTrue(database.register(typedIndex(), withName: "typed"))
+
+        measureWrites()
+    }
+
+    func testWritingExpiringRowsWithGenericIndex() {
+        XCTAssertTrue(database.register(genericIndex(), withName: "generic"))
+
+        measureWrites()
+    }
+
+    private func measureWrites() {
+        let connection = database.newConnection()
+        var start = 0
+
+        measure {
+            connection.readWrite { transaction in
+                self.writeRows(count: self.sweepRowCount / 10, startingAt: start, transaction: transaction)
+            }
+            start += self.sweepRowCount / 10
+        }
+    }
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2018 Token Browser, Inc
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+@testable import Toshi
+import XCTest
+
+class YapDatabaseViewPageTests: TemporaryDatabaseTestCase {
+
+    private let collection = "pages"
+    private let viewName = "pagesView"
+    private let group = "all"
+
+    private func registerView(in database: YapDatabase) -> Bool {
+        let grouping = YapDatabaseViewGrouping.withObjectBlock { [group] (_, _, _, _) -> String? in
+            return group
+        }
+
+        let sorting = YapDatabaseViewSorting.withObjectBlock { (_, _, _, _, object1, _, _, object2) -> ComparisonResult in
+            guard let number1 = object1 as? NSNumber, let number2 = object2 as? NSNumber else { return .orderedSame }
+            return number1.compare(number2)
+        }
+
+        let view = YapDatabaseAutoView(grouping: grouping, sorting: sorting, versionTag: "1", options: nil)
+        return database.register(view, withName: viewName)
+    }
+
+    private func populate(_ database: YapDatabase, count: Int) {
+        // Insert in a scrambled order, so rows land in the middle of existing pages too.
+        database.newConnection().readWrite { transaction in
+            for index in 0..<count {
+                let value = (index * 7919) % count
+                transaction.setObject(NSNumber(value: value), forKey: "key-\(value)", inCollection: self.collection)
+            }
+        }
+    }
+
+    private func sortedValues(in database: YapDatabase) -> [Int] {
+        var values = [Int]()
+
+        database.newConnection().read { transaction in
+            guard let viewTransaction = transaction.ext(self.viewName) as? YapDatabaseViewTransaction else { return }
+
+            viewTransaction.enumerateKeysAndObjects(inGroup: self.group) { _, _, object, _, _ in
+                values.append((object as? NSNumber)?.intValue ?? -1)
+            }
+        }
+
+        return values
+    }
+
+    func testPagesRoundTripThroughDisk() {
+        let databasePath = makeDatabasePath()
+        let count = 10000
+
+        do {
+            let database = YapDatabase(path: databasePath)
+            XCTAssertTrue(registerView(in: database))
+            populate(database, count: count)
+        }
+
+        // A fresh database instance has to deserialize every page from disk.
+        let reopened = YapDatabase(path: databasePath)
+        XCTAssertTrue(registerView(in: reopened))
+
+        XCTAssertEqual(sortedValues(in: reopened), Array(0..<count))
+    }
+
+    func testViewPopulationPerformance() {
+        measure {
+            let database = YapDatabase(path: makeDatabasePath())
+            _ = registerView(in: database)
+            populate(database, count: 10000)
+        }
+    }
+}
@@ -96,7 +96,7 @@ extension MessagesRequestsViewController: UITableViewDataSource {
             title = recipient.nameOrDisplayName
         }
 
-        if let message = thread.messages.last, let messageBody = message.body {
+        if let message = dataSource.lastVisibleMessage(in: thread), let messageBody = message.body {
             switch SofaType(sofa: messageBody) {
             case .message:
                 if message.hasAttachments() {
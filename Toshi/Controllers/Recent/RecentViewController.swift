@@ -207,7 +207,8 @@ extension RecentViewController: UITableViewDataSource {
         if isMessagesRequestsRow {
             cell = messagesRequestsCell(for: indexPath)
         } else if let thread = dataSource.acceptedThread(at: indexPath.row, in: 0) {
-            let threadCellConfigurator = ThreadCellConfigurator(thread: thread)
+            let contents = dataSource.cellContents(for: thread)
+            let threadCellConfigurator = ThreadCellConfigurator(thread: thread, summary: contents.summary, lastVisibleMessage: contents.lastVisibleMessage, unreadCount: contents.unreadCount)
             let cellData = threadCellConfigurator.cellData
             cell = tableView.dequeueReusableCell(withIdentifier: AvatarTitleSubtitleDetailsBadgeCell.reuseIdentifier, for: indexPath)
 
@@ -18,6 +18,9 @@ import UIKit
 final class ThreadCellConfigurator: CellConfigurator {
 
     private var thread: TSThread
+    private var summary: OWSThreadSummary?
+    private var lastVisibleMessage: TSMessage?
+    private var unreadCount: Int
 
     lazy var messageAttributes: [NSAttributedStringKey: Any] = {
         let paragraphStyle = NSMutableParagraphStyle()
@@ -33,8 +36,11 @@ final class ThreadCellConfigurator: CellConfigurator {
         ]
     }()
 
-    init(thread: TSThread) {
+    init(thread: TSThread, summary: OWSThreadSummary?, lastVisibleMessage: TSMessage?, unreadCount: Int) {
         self.thread = thread
+        self.summary = summary
+        self.lastVisibleMessage = lastVisibleMessage
+        self.unreadCount = unreadCount
     }
 
     lazy var cellData: TableCellData = {
@@ -51,12 +57,11 @@ final class ThreadCellConfigurator: CellConfigurator {
             title = recipient.nameOrDisplayName
         }
 
-        if thread.hasUnreadMessages() {
-            let unreadMessagesInThread = SignalNotificationManager.unreadMessagesCount(in: thread)
-            badgeText = "\(unreadMessagesInThread)"
+        if unreadCount > 0 {
+            badgeText = "\(unreadCount)"
         }
 
-        if let message = thread.messages.last, let messageBody = message.body {
+        if let message = lastVisibleMessage, let messageBody = message.body {
             switch SofaType(sofa: messageBody) {
             case .message:
                 if message.hasAttachments() {
@@ -73,7 +78,7 @@ final class ThreadCellConfigurator: CellConfigurator {
             }
         }
 
-        let date = self.thread.lastMessageDate()
+        let date = summary?.lastMessageDate ?? thread.lastMessageDate()
 
         if DateTimeFormatter.isDate(date, sameDayAs: Date()) {
             details = DateTimeFormatter.timeFormatter.string(from: date)
@@ -227,6 +227,38 @@ final class ThreadsDataSource: NSObject {
         return thread
     }
 
+    /// The thread's inbox summary, last visible message and unread count, read in one transaction on the same
+    /// snapshot as the thread view, so that they all agree.
+    func cellContents(for thread: TSThread) -> (summary: OWSThreadSummary?, lastVisibleMessage: TSMessage?, unreadCount: Int) {
+        var summary: OWSThreadSummary?
+        var message: TSMessage?
+        var unreadCount = 0
+
+        viewModel.uiDatabaseConnection.read { transaction in
+            summary = OWSThreadSummary.summary(threadId: thread.uniqueId, transaction: transaction)
+            message = thread.lastVisibleMessage(with: transaction)
+
+            if let summary = summary {
+                unreadCount = Int(summary.unreadCount)
+            } else if let unreadView = transaction.ext(TSUnreadDatabaseViewExtensionName) as? YapDatabaseViewTransaction {
+                // Summaries of threads which predate them are still being built.
+                unreadCount = Int(unreadView.numberOfItems(inGroup: thread.uniqueId))
+            }
+        }
+
+        return (summary, message, unreadCount)
+    }
+
+    func lastVisibleMessage(in thread: TSThread) -> TSMessage? {
+        var message: TSMessage?
+
+        viewModel.uiDatabaseConnection.read { transaction in
+            message = thread.lastVisibleMessage(with: transaction)
+        }
+
+        return message
+    }
+
     func updateNewThreadRecepientsIfNeeded(_ thread: TSThread) {
         DispatchQueue.main.async {
             if let contactId = thread.contactIdentifier() {
@@ -24,6 +24,9 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, readonly) NSArray<TSMessage *> *messages;
 
+/// The last of `messages`, found through the thread's summary so that the thread's interactions aren't loaded.
+- (nullable TSMessage *)lastVisibleMessageWithTransaction:(YapDatabaseReadTransaction *)transaction;
+
 @end
 
 @interface TSThread (Exposed)
@@ -1,24 +1,54 @@
 #import "TSThread+Additions.h"
 #import <objc/runtime.h>
+#import <SignalServiceKit/OWSThreadSummary.h>
+#import <SignalServiceKit/TSDatabaseView.h>
 #import "Toshi-Swift.h"
 
 @implementation TSThread (Additions)
 
++ (BOOL)isVisibleMessage:(nullable TSInteraction *)interaction {
+    if (![interaction isKindOfClass:[TSMessage class]]) {
+        return NO;
+    }
+
+    NSString *body = ((TSMessage *)interaction).body;
+    // We use hard-coded strings here since the constants for them are declared inside a swift enum
+    // hence inaccessible through Objective C. Since we only use it here, I left them as literals.g
+    return [body hasPrefix:[SofaTypes message]] || [body hasPrefix:[SofaTypes paymentRequest]];
+}
+
 - (NSArray<TSMessage *> *)messages {
     NSMutableArray *visible = [NSMutableArray array];
 
     for (TSInteraction *interaction in self.allInteractions) {
-        if ([interaction isKindOfClass:[TSMessage class]]) {
-            NSString *body = ((TSMessage *)interaction).body;
-            // We use hard-coded strings here since the constants for them are declared inside a swift enum
-            // hence inaccessible through Objective C. Since we only use it here, I left them as literals.g
-            if ([body hasPrefix:[SofaTypes message]] || [body hasPrefix:[SofaTypes paymentRequest]]) {
-                [visible addObject:interaction];
-            }
+        if ([TSThread isVisibleMessage:interaction]) {
+            [visible addObject:interaction];
         }
     }
 
     return visible;
 }
 
+- (nullable TSMessage *)lastVisibleMessageWithTransaction:(YapDatabaseReadTransaction *)transaction {
+    // The summary's last inbox interaction is almost always the message we want, so try it first.
+    OWSThreadSummary *summary = [OWSThreadSummary summaryForThreadId:self.uniqueId transaction:transaction];
+    if (summary.lastInboxInteractionId) {
+        TSInteraction *interaction = [TSInteraction fetchObjectWithUniqueID:summary.lastInboxInteractionId transaction:transaction];
+        if ([TSThread isVisibleMessage:interaction]) {
+            return (TSMessage *)interaction;
+        }
+    }
+
+    // Otherwise walk back from the newest interaction, stopping at the first visible message.
+    __block TSMessage *lastMessage = nil;
+    [[transaction ext:TSMessageDatabaseViewExtensionName] enumerateRowsInGroup:self.uniqueId withOptions:NSEnumerationReverse usingBlock:^(NSString *collection, NSString *key, id object, id metadata, NSUInteger index, BOOL *stop) {
+        if ([TSThread isVisibleMessage:object]) {
+            lastMessage = (TSMessage *)object;
+            *stop = YES;
+        }
+    }];
+
+    return lastMessage;
+}
+
 @end
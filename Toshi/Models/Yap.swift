@@ -156,6 +156,9 @@ final class Yap: NSObject, Singleton {
         database = YapDatabase(path: UserDB.dbFilePath, options: options)
 
         mainConnection = database?.newConnection()
+        // Inserts and removals are tiny async writes, often several at once (e.g. storing the contacts),
+        // so the ones that are queued while the connection is busy share a transaction.
+        mainConnection?.groupCommitLimit = 16
 
         if database == nil {
             CrashlyticsLogger.log("Failed to create user database")
@@ -33,6 +33,9 @@
 #import <YapDatabase/YapDatabaseFilteredViewConnection.h>
 #import <YapDatabase/YapDatabaseFilteredViewTransaction.h>
 #import <YapDatabase/YapDatabaseAutoView.h>
+#import <YapDatabase/YapClockCache.h>
+#import <YapDatabase/YapDatabaseFullTextSearch.h>
+#import <YapDatabase/YapDatabaseSecondaryIndex.h>
 
 #import <SignalServiceKit/NotificationsProtocol.h>
 #import <SignalServiceKit/OWSGetMessagesRequest.h>
@@ -43,7 +46,13 @@
 #import <SignalServiceKit/TSAccountManager.h>
 #import <SignalServiceKit/OWSError.h>
 #import <SignalServiceKit/TSDatabaseView.h>
+#import <SignalServiceKit/OWSThreadSummary.h>
+#import <SignalServiceKit/OWSDatabaseConnectionPool.h>
+#import <SignalServiceKit/OWSMessageSearchIndex.h>
+#import <SignalServiceKit/OWSDisappearingMessagesFinder.h>
 #import <SignalServiceKit/OWSMessageSender.h>
+#import <SignalServiceKit/OWSMessageReceiver.h>
+#import <SignalServiceKit/OWSSignalServiceProtos.pb.h>
 #import <SignalServiceKit/ContactsUpdater.h>
 #import <SignalServiceKit/TSGroupModel.h>
 
@@ -67,9 +76,12 @@
 
 #import <SignalServiceKit/SignalAccount.h>
 #import <SignalServiceKit/TSStorageManager.h>
+#import <SignalServiceKit/OWSBinaryArchiver.h>
+#import <SignalServiceKit/Cryptography.h>
 #import <SignalServiceKit/OWSIdentityManager.h>
 #import <SignalServiceKit/OWSMessageManager.h>
 #import <SignalServiceKit/TSStorageManager+SessionStore.h>
+#import <SignalServiceKit/OWSSessionStore.h>
 #import <SignalServiceKit/TSAccountManager.h>
 #import <SignalServiceKit/TSStorageManager+PreKeyStore.h>
 #import <SignalServiceKit/TSStorageManager+SignedPreKeyStore.h>
@@ -92,6 +104,13 @@
 #import <AxolotlKit/SignedPreKeyRecord.h>
 #import <AxolotlKit/NSData+keyVersionByte.h>
 #import <AxolotlKit/SessionCipher.h>
+#import <AxolotlKit/SessionBuilder.h>
+#import <AxolotlKit/SessionRecord.h>
+#import <AxolotlKit/SessionState.h>
+#import <AxolotlKit/RootKey.h>
+#import <AxolotlKit/ChainKey.h>
+#import <AxolotlKit/TSDerivedSecrets.h>
+#import <HKDFKit/HKDFKit.h>
 
 #import <Fabric/Fabric.h>
 #import <Crashlytics/Crashlytics.h>
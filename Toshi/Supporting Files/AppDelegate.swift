@@ -193,9 +193,11 @@ class AppDelegate: UIResponder, UIApplicationDelegate {
     }
 
     private func setupSignalService() {
-        // Encryption/Decryption mutates session state and must be synchronized on a serial queue.
+        // Encryption/Decryption mutates session state and must be synchronized on a serial queue per recipient.
 
-        SessionCipher.setSessionCipherDispatchQueue(OWSDispatch.sessionStoreQueue())
+        SessionCipher.setSessionCipherDispatchQueueBlock { recipientId in
+            OWSDispatch.sessionStoreQueue(forRecipientId: recipientId)
+        }
 
         CrashlyticsClient.setupForUser(with: Cereal.shared.address)
 